@@ -0,0 +1,32 @@
+// Array-heavy: a bubble sort of a symbolic array, with symbolic indices
+// into a lookup table.
+
+#include <klee/klee.h>
+
+#define N 6
+
+static int table[16] = { 3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5, 8, 9, 7, 9, 3 };
+
+int main() {
+  int array[N];
+  int i, j, t, total = 0;
+
+  klee_make_symbolic(array, sizeof(array), "array");
+
+  for (i = 0; i < N; ++i)
+    for (j = 0; j + 1 < N - i; ++j)
+      if (array[j + 1] < array[j]) {
+        t = array[j + 1];
+        array[j + 1] = array[j];
+        array[j] = t;
+      }
+
+  for (i = 0; i < N; ++i)
+    total += table[array[i] & 15];
+
+  for (i = 0; i + 1 < N; ++i)
+    if (array[i] > array[i + 1])
+      klee_assert(0);
+
+  return total > 9 * N;
+}
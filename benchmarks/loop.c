@@ -0,0 +1,24 @@
+// Loop-heavy: a loop whose iterations branch on independent symbolic
+// inputs, such that most of the paths are subsumed with interpolation.
+
+#include <klee/klee.h>
+
+#define N 24
+
+int main() {
+  int input[N];
+  int sum = 0, i;
+
+  klee_make_symbolic(input, sizeof(input), "input");
+
+  for (i = 0; i < N; ++i) {
+    if (input[i] > 0)
+      sum += 2;
+    else
+      sum += 1;
+  }
+
+  if (sum > 2 * N)
+    klee_assert(0);
+  return 0;
+}
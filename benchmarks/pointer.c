@@ -0,0 +1,45 @@
+// Pointer-heavy: a linked list built on the heap and traversed with
+// branches on the symbolic values of its nodes.
+
+#include <klee/klee.h>
+
+#include <stdlib.h>
+
+#define N 12
+
+struct node {
+  int value;
+  struct node *next;
+};
+
+int main() {
+  int values[N];
+  struct node *head = 0, *p;
+  int count = 0, i;
+
+  klee_make_symbolic(values, sizeof(values), "values");
+
+  for (i = 0; i < N; ++i) {
+    p = malloc(sizeof(struct node));
+    p->value = values[i];
+    p->next = head;
+    head = p;
+  }
+
+  for (p = head; p; p = p->next) {
+    if (p->value % 2)
+      ++count;
+    if (p->next && p->next->value > p->value)
+      p->value = p->next->value;
+  }
+
+  if (count > N)
+    klee_assert(0);
+
+  while (head) {
+    p = head->next;
+    free(head);
+    head = p;
+  }
+  return 0;
+}
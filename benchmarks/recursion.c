@@ -0,0 +1,24 @@
+// Deep recursion: a recursive descent whose every call branches on a
+// symbolic input, such that the call stacks of the paths are deep.
+
+#include <klee/klee.h>
+
+#define DEPTH 20
+
+static int input[DEPTH];
+
+static int descend(int depth, int acc) {
+  if (depth == DEPTH)
+    return acc;
+  if (input[depth] < depth)
+    return descend(depth + 1, acc + 1);
+  return descend(depth + 1, acc);
+}
+
+int main() {
+  klee_make_symbolic(input, sizeof(input), "input");
+
+  if (descend(0, 0) > DEPTH)
+    klee_assert(0);
+  return 0;
+}
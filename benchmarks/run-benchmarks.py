@@ -0,0 +1,194 @@
+#!/usr/bin/env python
+# -*- encoding: utf-8 -*-
+
+# ===-- run-benchmarks.py -------------------------------------------------===##
+#
+#               The Tracer-X KLEE Symbolic Virtual Machine
+#
+#  This file is distributed under the University of Illinois Open Source
+#  License. See LICENSE.TXT for details.
+#
+# ===----------------------------------------------------------------------===##
+
+"""Run the benchmark programs under each configuration of KLEE, and compare
+the measurements with a stored baseline."""
+
+from __future__ import print_function
+
+import argparse
+import ast
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import time
+
+CONFIGURATIONS = [
+    ('no-interpolation', ['-no-interpolation']),
+    ('interpolation', []),
+    ('wp', ['-wp-interpolant']),
+    ('speculation', ['-spec-type=safety', '-spec-strategy=aggressive']),
+]
+
+# The metrics, whether a larger value is better, and the smallest difference
+# reported as a regression, to ignore the noise of the short runs
+METRICS = [
+    ('wall', 'Wall time (s)', False, 0.05),
+    ('ips', 'Instructions/s', True, 0.0),
+    ('solver', 'Solver time (s)', False, 0.05),
+    ('subsumption', 'Subsumption rate', True, 0.01),
+    ('rss', 'Peak RSS (MB)', False, 1.0),
+]
+
+
+def readInfo(outputDir):
+    """Return the instructions, completed paths and subsumed paths."""
+    values = {}
+    patterns = {
+        'instructions': r'KLEE: done: total instructions = (\d+)',
+        'paths': r'KLEE: done: completed paths = (\d+)',
+        'subsumed': r'KLEE: done:\s+subsumed paths = (\d+)',
+    }
+    with open(os.path.join(outputDir, 'info')) as info:
+        text = info.read()
+    for key, pattern in patterns.items():
+        match = re.search(pattern, text)
+        values[key] = int(match.group(1)) if match else 0
+    return values
+
+
+def readSolverTime(outputDir):
+    """Return the solver time of the last line of run.stats."""
+    with open(os.path.join(outputDir, 'run.stats')) as stats:
+        lines = [line for line in stats if line.strip()]
+    header = ast.literal_eval(lines[0])
+    last = ast.literal_eval(lines[-1])
+    return float(last[header.index('SolverTime')])
+
+
+def runKlee(klee, bitcode, flags, outputDir, maxTime):
+    if os.path.exists(outputDir):
+        shutil.rmtree(outputDir)
+    command = [klee, '-output-dir=' + outputDir, '-no-output',
+               '-max-time=%d' % maxTime] + flags + [bitcode]
+    with open(os.devnull, 'w') as devnull:
+        start = time.time()
+        process = subprocess.Popen(command, stdout=devnull, stderr=devnull)
+        # The resource usage of this child only
+        _, status, usage = os.wait4(process.pid, 0)
+        wall = time.time() - start
+    if not os.WIFEXITED(status) or os.WEXITSTATUS(status) != 0:
+        raise RuntimeError('%s failed with wait status %d' %
+                           (' '.join(command), status))
+
+    info = readInfo(outputDir)
+    return {
+        'wall': wall,
+        'ips': info['instructions'] / wall if wall > 0 else 0.0,
+        'solver': readSolverTime(outputDir),
+        'subsumption': (float(info['subsumed']) / info['paths']
+                        if info['paths'] else 0.0),
+        # ru_maxrss is in kilobytes on Linux
+        'rss': usage.ru_maxrss / 1024.0,
+    }
+
+
+def compare(results, baseline, tolerance):
+    """Print the results against the baseline, and return the regressions."""
+    regressions = []
+    for key in sorted(results):
+        print(key)
+        for metric, name, largerIsBetter, floor in METRICS:
+            value = results[key][metric]
+            line = '  %-18s %12.2f' % (name, value)
+            if key in baseline and metric in baseline[key]:
+                old = baseline[key][metric]
+                line += '  (baseline %.2f)' % old
+                if largerIsBetter:
+                    regressed = value < old * (1 - tolerance) - floor
+                else:
+                    regressed = value > old * (1 + tolerance) + floor
+                if regressed:
+                    line += '  REGRESSION'
+                    regressions.append('%s: %s' % (key, name))
+            print(line)
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Run the benchmark programs under each configuration of '
+                    'KLEE, and compare the measurements with a baseline.')
+    parser.add_argument('bitcode', nargs='+', help='benchmark bitcode files')
+    parser.add_argument('--klee', default='klee', help='KLEE executable')
+    parser.add_argument('--output', default='Output',
+                        help='directory of the KLEE runs and the results')
+    parser.add_argument('--baseline', help='baseline results file')
+    parser.add_argument('--update-baseline', action='store_true',
+                        help='write the results into the baseline file')
+    parser.add_argument('--configs',
+                        help='comma-separated configurations to run '
+                             '(default: all of %s)' %
+                             ', '.join(c[0] for c in CONFIGURATIONS))
+    parser.add_argument('--tolerance', type=float, default=0.1,
+                        help='relative difference from the baseline reported '
+                             'as a regression (default: 0.1)')
+    parser.add_argument('--max-time', type=int, default=300,
+                        help='time limit of each KLEE run in seconds '
+                             '(default: 300)')
+    args = parser.parse_args()
+
+    configurations = CONFIGURATIONS
+    if args.configs:
+        names = args.configs.split(',')
+        for name in names:
+            if name not in dict(CONFIGURATIONS):
+                parser.error('unknown configuration "%s"' % name)
+        configurations = [c for c in CONFIGURATIONS if c[0] in names]
+
+    if not os.path.exists(args.output):
+        os.makedirs(args.output)
+
+    results = {}
+    for bitcode in args.bitcode:
+        program = os.path.splitext(os.path.basename(bitcode))[0]
+        for name, flags in configurations:
+            key = '%s/%s' % (program, name)
+            print('Running %s' % key, file=sys.stderr)
+            outputDir = os.path.join(args.output, '%s-%s' % (program, name))
+            results[key] = runKlee(args.klee, bitcode, flags, outputDir,
+                                   args.max_time)
+
+    with open(os.path.join(args.output, 'results.json'), 'w') as out:
+        json.dump(results, out, indent=2, sort_keys=True)
+
+    baseline = {}
+    if args.baseline and os.path.exists(args.baseline):
+        with open(args.baseline) as stream:
+            baseline = json.load(stream)
+    elif not args.update_baseline:
+        print('No baseline to compare with; write one with '
+              '--update-baseline', file=sys.stderr)
+
+    regressions = compare(results, baseline, args.tolerance)
+
+    if args.update_baseline:
+        if not args.baseline:
+            parser.error('--update-baseline requires --baseline')
+        baseline.update(results)
+        with open(args.baseline, 'w') as out:
+            json.dump(baseline, out, indent=2, sort_keys=True)
+        return 0
+
+    if regressions:
+        print('\n%d regressions:' % len(regressions))
+        for regression in regressions:
+            print('  ' + regression)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,38 @@
+//===-- SMTLIB2Parser.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPR_SMTLIB2PARSER_H
+#define KLEE_EXPR_SMTLIB2PARSER_H
+
+#include <string>
+
+namespace llvm {
+class MemoryBuffer;
+}
+
+namespace klee {
+class ExprBuilder;
+
+namespace expr {
+class Parser;
+
+/// isSMTLIB2Script - Return whether the input is an SMT-LIB v2 script, by
+/// the .smt2 extension of its name or by its first command.
+bool isSMTLIB2Script(const std::string &Filename, const llvm::MemoryBuffer *MB);
+
+/// createSMTLIB2Parser - Create a parser of an SMT-LIB v2 script, which
+/// returns each of its (check-sat) commands as the query command of whether
+/// the assertions are unsatisfiable.
+Parser *createSMTLIB2Parser(const std::string &Filename,
+                            const llvm::MemoryBuffer *MB,
+                            ExprBuilder *Builder);
+}
+}
+
+#endif
@@ -11,9 +11,10 @@
 
 #ifdef ENABLE_Z3
 #ifdef ENABLE_STP
-#define INTERPOLATION_ENABLED (CoreSolverToUse == Z3_SOLVER && !NoInterpolation)
+#define INTERPOLATION_ENABLED                                                  \
+  (CoreSolverToUse == Z3_SOLVER && !NoInterpolation && !ConcreteReplay)
 #else
-#define INTERPOLATION_ENABLED (!NoInterpolation)
+#define INTERPOLATION_ENABLED (!NoInterpolation && !ConcreteReplay)
 #endif
 #define OUTPUT_INTERPOLATION_TREE (INTERPOLATION_ENABLED &&OutputTree)
 #else
@@ -29,8 +30,14 @@ extern llvm::cl::opt<bool> UseCexCache;
 
 extern llvm::cl::opt<bool> UseCache;
 
+extern llvm::cl::opt<std::string> SolverCacheFile;
+
+extern llvm::cl::opt<unsigned> SolverCacheSize;
+
 extern llvm::cl::opt<bool> UseIndependentSolver;
 
+extern llvm::cl::opt<bool> SliceConstantArrays;
+
 extern llvm::cl::opt<bool> DebugValidateSolver;
 
 extern llvm::cl::opt<int> MinQueryTimeToLog;
@@ -47,8 +54,11 @@ enum QueryLoggingSolverType {
   ALL_SMTLIB, ///< Log all queries (un-optimised)  .smt2 (SMT-LIBv2) format
   SOLVER_PC,  ///< Log queries passed to solver (optimised) in .pc (KQuery)
   /// format
-  SOLVER_SMTLIB ///< Log queries passed to solver (optimised) in .smt2
-                ///(SMT-LIBv2) format
+  SOLVER_SMTLIB, ///< Log queries passed to solver (optimised) in .smt2
+                 ///(SMT-LIBv2) format
+  ALL_BINARY,    ///< Log all queries (un-optimised) in the binary format
+  SOLVER_BINARY  ///< Log queries passed to solver (optimised) in the binary
+                 /// format
 };
 
 /* Using cl::list<> instead of cl::bits<> results in quite a bit of ugliness
@@ -83,20 +93,46 @@ extern llvm::cl::opt<CoreSolverType> CoreSolverToUse;
 
 extern llvm::cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith;
 
+extern llvm::cl::opt<CoreSolverType> PortfolioCoreSolverWith;
+
 // We should compile in this option even when ENABLE_Z3
 // was undefined to avoid regression test failure.
 extern llvm::cl::opt<bool> NoInterpolation;
 
+extern llvm::cl::opt<bool> ConcreteReplay;
+
+extern llvm::cl::opt<bool> PinWorkers;
+
 #ifdef ENABLE_Z3
 
 extern llvm::cl::opt<bool> OutputTree;
 
+extern llvm::cl::opt<bool> OutputTreeStream;
+
 extern llvm::cl::opt<bool> SubsumedTest;
 
 extern llvm::cl::opt<bool> NoExistential;
 
 extern llvm::cl::opt<int> MaxFailSubsumption;
 
+extern llvm::cl::opt<unsigned> MaxSubsumptionTableEntries;
+
+extern llvm::cl::opt<bool> MergeSubsumptionEntries;
+
+extern llvm::cl::opt<bool> EliminateRedundantEntries;
+
+extern llvm::cl::opt<unsigned> RedundantEntrySolverChecks;
+
+extern llvm::cl::opt<bool> LoopWidening;
+
+extern llvm::cl::opt<bool> FunctionSummaries;
+
+extern llvm::cl::opt<unsigned> AdaptiveInterpolationWarmup;
+
+extern llvm::cl::opt<double> AdaptiveInterpolationThreshold;
+
+extern llvm::cl::opt<unsigned> AdaptiveInterpolationResample;
+
 extern llvm::cl::opt<int> DebugState;
 
 extern llvm::cl::opt<int> DebugSubsumption;
@@ -117,10 +153,34 @@ extern llvm::cl::opt<SpecStrategy> SpecStrategyToUse;
 
 extern llvm::cl::opt<std::string> DependencyFolder;
 
+extern llvm::cl::opt<std::string> SpecDependencyCache;
+
 extern llvm::cl::opt<bool> WPInterpolant;
 
+extern llvm::cl::opt<unsigned> DeferWPInterpolant;
+
+extern llvm::cl::opt<bool> SkipPendingWPEntries;
+
 extern llvm::cl::opt<bool> MarkGlobal;
 
+extern llvm::cl::opt<bool> SubsumptionQueryCache;
+
+extern llvm::cl::opt<bool> SubsumptionModelCheck;
+
+extern llvm::cl::opt<bool> SubsumptionPartitioning;
+
+extern llvm::cl::opt<bool> ExistentialElimination;
+
+extern llvm::cl::opt<bool> SubsumptionProfile;
+
+extern llvm::cl::opt<std::string> SubsumptionTableFile;
+
+extern llvm::cl::opt<double> SubsumptionTableSyncInterval;
+
+extern llvm::cl::opt<bool> HashConsShadowExpressions;
+
+extern llvm::cl::opt<bool> DependencySlicing;
+
 #endif
 
 #ifdef ENABLE_METASMT
@@ -21,12 +21,16 @@ namespace klee {
     const char SOLVER_QUERIES_SMT2_FILE_NAME[]="solver-queries.smt2";
     const char ALL_QUERIES_PC_FILE_NAME[]="all-queries.pc";
     const char SOLVER_QUERIES_PC_FILE_NAME[]="solver-queries.pc";
+    const char ALL_QUERIES_BINARY_FILE_NAME[]="all-queries.kqb";
+    const char SOLVER_QUERIES_BINARY_FILE_NAME[]="solver-queries.kqb";
 
     Solver *constructSolverChain(Solver *coreSolver,
                                  std::string querySMT2LogPath,
                                  std::string baseSolverQuerySMT2LogPath,
                                  std::string queryPCLogPath,
-                                 std::string baseSolverQueryPCLogPath);
+                                 std::string baseSolverQueryPCLogPath,
+                                 std::string queryBinaryLogPath,
+                                 std::string baseSolverQueryBinaryLogPath);
 }
 
 
@@ -12,6 +12,8 @@
 
 #include "klee/Expr.h"
 
+#include <map>
+
 // FIXME: Currently we use ConstraintManager for two things: to pass
 // sets of constraints around, and to optimize constraints. We should
 // move the first usage into a separate data structure
@@ -26,14 +28,22 @@ public:
   typedef constraints_ty::iterator iterator;
   typedef constraints_ty::const_iterator const_iterator;
 
-  ConstraintManager() {}
+  ConstraintManager() : fingerprint(0), equalitiesValid(false) {}
 
   // create from constraints with no optimization
   explicit
   ConstraintManager(const std::vector< ref<Expr> > &_constraints) :
-    constraints(_constraints) {}
+    constraints(_constraints), fingerprint(0),
+    arrayMasks(_constraints.size(), 0), equalitiesValid(false) {
+    for (constraint_iterator it = constraints.begin(), ie = constraints.end();
+         it != ie; ++it)
+      fingerprint += (*it)->hash();
+  }
 
-  ConstraintManager(const ConstraintManager &cs) : constraints(cs.constraints) {}
+  // the equalities are not copied, as most copies are not simplified with
+  ConstraintManager(const ConstraintManager &cs)
+      : constraints(cs.constraints), fingerprint(cs.fingerprint),
+        arrayMasks(cs.arrayMasks), equalitiesValid(false) {}
 
   typedef std::vector< ref<Expr> >::const_iterator constraint_iterator;
 
@@ -63,9 +73,11 @@ public:
     return constraints.size();
   }
 
-  bool operator==(const ConstraintManager &other) const {
-    return constraints == other.constraints;
-  }
+  /// The sum of the hashes of the constraints, which does not depend on
+  /// their order, and is maintained as the constraints are added
+  uint64_t getFingerprint() const { return fingerprint; }
+
+  bool operator==(const ConstraintManager &other) const;
   
   constraints_ty getConstraints() const{
 	  return constraints;
@@ -74,8 +86,36 @@ public:
 private:
   std::vector< ref<Expr> > constraints;
 
-  // returns true iff the constraints were modified
-  bool rewriteConstraints(ExprVisitor &visitor);
+  uint64_t fingerprint;
+
+  /// For each constraint, a bit for each hash of the arrays it reads, or
+  /// zero when not computed yet, such that a rewrite skips the constraints
+  /// that do not read the arrays of the rewritten expression
+  std::vector<uint64_t> arrayMasks;
+
+  typedef std::map<ref<Expr>, std::pair<ref<Expr>, ref<Expr> > >
+  equalities_ty;
+
+  /// The replacements that simplifyExpr derives from the constraints, built
+  /// on its first use and then extended as constraints are added
+  mutable equalities_ty equalities;
+  mutable bool equalitiesValid;
+
+  static uint64_t getArrayMask(ref<Expr> e);
+
+  static void addEquality(equalities_ty &equalities, ref<Expr> e);
+
+  void append(ref<Expr> e, uint64_t mask = 0) {
+    constraints.push_back(e);
+    arrayMasks.push_back(mask);
+    fingerprint += e->hash();
+    if (equalitiesValid)
+      addEquality(equalities, e);
+  }
+
+  // returns true iff the constraints were modified; only the constraints
+  // that share an array with the given mask are visited
+  bool rewriteConstraints(ExprVisitor &visitor, uint64_t mask);
 
   void addConstraintInternal(ref<Expr> e);
 };
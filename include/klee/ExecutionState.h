@@ -12,12 +12,15 @@
 
 #include "klee/Constraints.h"
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
+#include "klee/Internal/ADT/ImmutableSet.h"
 #include "klee/Internal/ADT/TreeStream.h"
 
 // FIXME: We do not want to be exposing these? :(
 #include "../../lib/Core/AddressSpace.h"
 #include "klee/Internal/Module/KInstIterator.h"
 #include "klee/Internal/Module/KInstruction.h"
+#include "klee/util/Assignment.h"
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
 #include "llvm/IR/Instructions.h"
@@ -48,7 +51,15 @@ struct StackFrame {
   CallPathNode *callPathNode;
 
   std::vector<const MemoryObject *> allocas;
-  Cell *locals;
+
+  /// The registers of the function. They are shared by the copies of the
+  /// frame, such as the frames of a forked state, until one of them writes
+  /// them through getWritableLocals(), so that forking a state with a deep
+  /// stack does not copy the registers of all of its frames. Their storage,
+  /// with the reference count, is recycled from the frames of the functions
+  /// of the same number of registers.
+  const Cell *locals;
+  unsigned *localsRefCount;
 
   /// Minimum distance to an uncovered instruction once the function
   /// returns. This is not a good place for this but is used to
@@ -66,7 +77,95 @@ struct StackFrame {
 
   StackFrame(KInstIterator caller, KFunction *kf);
   StackFrame(const StackFrame &s);
+  StackFrame &operator=(const StackFrame &s);
   ~StackFrame();
+
+  /// Return the registers of the function for writing, first copying them
+  /// when they are shared with another frame.
+  Cell *getWritableLocals() {
+    if (*localsRefCount > 1)
+      unshareLocals();
+    return const_cast<Cell *>(locals);
+  }
+
+private:
+  void unshareLocals();
+  void releaseLocals();
+};
+
+/// @brief A satisfying assignment of the constraints of a state, shared with
+/// the states branched from it
+struct StateModel {
+  RefCount refCount;
+  Assignment assignment;
+
+  /// The assignment of zero to every array, a model of no constraints
+  StateModel() : refCount(0), assignment(false) {}
+
+  /// A model found by the solver, leaving the arrays not in objects free
+  StateModel(const std::vector<const Array *> &objects,
+             std::vector<std::vector<unsigned char> > &values)
+      : refCount(0), assignment(objects, values, true) {}
+};
+
+/// @brief The ordered list of the symbolic objects of a state, shared with
+/// the states branched from it.
+///
+/// The list is a prefix of an append-only storage: a copy shares the
+/// storage, and appending extends the storage in place when the list is its
+/// longest prefix, copying the prefix only when another list already
+/// appended beyond it. The storage holds the references to the memory
+/// objects.
+class SymbolicList {
+public:
+  typedef std::pair<const MemoryObject *, const Array *> value_type;
+  typedef std::vector<value_type>::const_iterator const_iterator;
+
+private:
+  struct Storage {
+    RefCount refCount;
+    std::vector<value_type> elements;
+
+    Storage() : refCount(0) {}
+    ~Storage();
+
+    /// Drop the elements from the given index, releasing their objects
+    void truncate(unsigned length);
+  };
+
+  ref<Storage> storage;
+
+  unsigned length;
+
+  static void retain(const MemoryObject *mo);
+  static void release(const MemoryObject *mo);
+
+public:
+  SymbolicList() : length(0) {}
+
+  unsigned size() const { return length; }
+
+  bool empty() const { return length == 0; }
+
+  const value_type &operator[](unsigned i) const {
+    assert(i < length && "symbolic index out of range");
+    return storage->elements[i];
+  }
+
+  const_iterator begin() const {
+    return storage.isNull() ? const_iterator() : storage->elements.begin();
+  }
+
+  const_iterator end() const {
+    return storage.isNull() ? const_iterator()
+                            : storage->elements.begin() + length;
+  }
+
+  void push_back(const value_type &value);
+
+  bool operator==(const SymbolicList &b) const;
+
+  bool operator!=(const SymbolicList &b) const { return !(*this == b); }
 };
 
 /// @brief ExecutionState representing a path under exploration
@@ -78,7 +177,8 @@ private:
   // unsupported, use copy constructor
   ExecutionState &operator=(const ExecutionState &);
 
-  std::map<std::string, std::string> fnAliases;
+  /// Shared with the states branched from this one, like arrayNames
+  ImmutableMap<std::string, std::string> fnAliases;
 
   void addTxTreeConstraint(ref<Expr> e, llvm::Instruction *instr);
 
@@ -107,6 +207,15 @@ public:
   /// @brief Constraints collected so far
   ConstraintManager constraints;
 
+  /// @brief Branch conditions of a fast-forwarded replay path, with their
+  /// branch instructions, not yet added to the constraints
+  std::vector<std::pair<ref<Expr>, llvm::Instruction *> > deferredConstraints;
+
+  /// @brief The latest models of the constraints, found by the queries on
+  /// this state or inherited from its parents, which answer the feasibility
+  /// queries they decide without the solver
+  mutable std::vector<ref<StateModel> > models;
+
   /// Statistics and information
 
   /// @brief Costs for all queries issued for this state, in seconds
@@ -119,6 +228,14 @@ public:
   /// @brief Exploration depth, i.e., number of times KLEE branched for this state
   unsigned depth;
 
+  /// @brief The branches taken at the first symbolic branches, one bit each,
+  /// used to partition the exploration among processes
+  uint64_t partitionPrefix;
+
+  /// @brief The node of the state in the tree of the splits recorded by the
+  /// checkpoints of the exploration
+  uint32_t checkpointId;
+
   /// @brief History of complete path: represents branches taken to
   /// reach/create this state (both concrete and symbolic)
   TreeOStream pathOS;
@@ -146,20 +263,26 @@ public:
   /// @brief Pointer to the interpolation tree of the current state
   TxTreeNode *txTreeNode;
 
+  /// @brief The slot of the state in the registry of the states, taken from
+  /// those of the deleted states, with which the searchers index the states
+  const unsigned slot;
+
   /// @brief Ordered list of symbolics: used to generate test cases.
-  //
-  // FIXME: Move to a shared list structure (not critical).
-  std::vector<std::pair<const MemoryObject *, const Array *> > symbolics;
+  SymbolicList symbolics;
 
   /// @brief Set of used array names for this state.  Used to avoid collisions.
-  std::set<std::string> arrayNames;
+  /// Persistent, such that branching the state does not copy it.
+  ImmutableSet<std::string> arrayNames;
 
-  std::string getFnAlias(std::string fn);
-  void addFnAlias(std::string old_fn, std::string new_fn);
-  void removeFnAlias(std::string fn);
+  /// Whether klee_alias_function replaced some function on this path, such
+  /// that the callees are to be looked up in the aliases.
+  bool hasFnAliases() const { return !fnAliases.empty(); }
+  std::string getFnAlias(const std::string &fn);
+  void addFnAlias(const std::string &old_fn, const std::string &new_fn);
+  void removeFnAlias(const std::string &fn);
 
 private:
-  ExecutionState() : ptreeNode(0), txTreeNode(0) {}
+  ExecutionState();
 
 public:
   ExecutionState(KFunction *kf);
@@ -177,19 +300,34 @@ public:
 
   ~ExecutionState();
 
+  /// @brief The number of slots of the registry of the states, above those of
+  /// all the states alive
+  static unsigned getSlotCount();
+
   ExecutionState *branch();
 
   void pushFrame(KInstIterator caller, KFunction *kf);
   void popFrame(KInstruction *ki, ref<Expr> returnValue);
 
   void addSymbolic(const MemoryObject *mo, const Array *array);
-  void addConstraint(ref<Expr> e) {
+  void addConstraint(ref<Expr> e) { addConstraint(e, prevPC->inst); }
+
+  /// @brief Add a constraint of the given instruction, which need not be the
+  /// current one
+  void addConstraint(ref<Expr> e, llvm::Instruction *instr) {
 #ifdef ENABLE_Z3
-    addTxTreeConstraint(e, prevPC->inst);
+    addTxTreeConstraint(e, instr);
 #endif
     constraints.addConstraint(e);
+    retainModelsOf(e);
   }
 
+  /// @brief Record a model of the constraints, dropping the oldest one
+  void addModel(StateModel *model) const;
+
+  /// @brief Drop the models that do not satisfy a new constraint
+  void retainModelsOf(ref<Expr> e);
+
   bool merge(const ExecutionState &b);
   void dumpStack(llvm::raw_ostream &out) const;
   void debugSubsumption(uint64_t level);
@@ -98,6 +98,23 @@ public:
   static unsigned count;
   static const unsigned MAGIC_HASH_CONSTANT = 39;
 
+  /// Mix the bits of a hash, with the finalizer of MurmurHash3, such that
+  /// each bit of the result depends on all the bits of the argument
+  static uint64_t mixHash(uint64_t h) {
+    h ^= h >> 33;
+    h *= UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    h *= UINT64_C(0xc4ceb9fe1a85ec53);
+    h ^= h >> 33;
+    return h;
+  }
+
+  /// Combine a hash into the hash of a sequence, depending on the order
+  static uint64_t combineHash(uint64_t seed, uint64_t h) {
+    return mixHash(seed ^ (h + UINT64_C(0x9e3779b97f4a7c15) + (seed << 6) +
+                           (seed >> 2)));
+  }
+
   /// The type of an expression is simply its width, in bits. 
   typedef unsigned Width; 
   
@@ -178,10 +195,10 @@ public:
     CmpKindLast = Sge
   };
 
-  unsigned refCount;
+  RefCount refCount;
 
 protected:  
-  unsigned hashValue;
+  uint64_t hashValue;
   
 public:
   Expr() : refCount(0) { Expr::count++; }
@@ -199,11 +216,11 @@ public:
   void dump() const;
 
   /// Returns the pre-computed hash of the current expression
-  virtual unsigned hash() const { return hashValue; }
+  virtual uint64_t hash() const { return hashValue; }
 
   /// (Re)computes the hash of the current expression.
   /// Returns the hash value. 
-  virtual unsigned computeHash();
+  virtual uint64_t computeHash();
   
   /// Returns 0 iff b is structuraly equivalent to *this
   typedef llvm::DenseSet<std::pair<const Expr *, const Expr *> > ExprEquivSet;
@@ -411,7 +428,7 @@ public:
     return create(variables, kids[0]);
   }
 
-  unsigned computeHash();
+  uint64_t computeHash();
 
   static bool classof(const Expr *E) { return E->getKind() == Expr::Exists; }
 
@@ -456,7 +473,7 @@ public:
 
   void print(llvm::raw_ostream &os) const;
 
-  virtual unsigned computeHash();
+  virtual uint64_t computeHash();
 
 private:
   WPVarExpr(llvm::Value *_address, std::string _name, const ref<Expr> &_index)
@@ -507,7 +524,7 @@ public:
 
   void print(llvm::raw_ostream &os) const;
 
-  virtual unsigned computeHash();
+  virtual uint64_t computeHash();
 
 private:
   UpdExpr(const ref<Expr> &_array, const ref<Expr> &_index,
@@ -551,7 +568,7 @@ public:
 
   void print(llvm::raw_ostream &os) const;
 
-  virtual unsigned computeHash();
+  virtual uint64_t computeHash();
 
 private:
   SelExpr(const ref<Expr> &_array, const ref<Expr> &_index) : array(_array) {
@@ -601,10 +618,17 @@ public:
 /// Class representing a byte update of an array.
 class UpdateNode {
   friend class UpdateList;  
+  friend class ArrayCache; // for the reference count of the shared nodes
 
-  mutable unsigned refCount;
-  // cache instead of recalc
-  unsigned hashValue;
+  mutable RefCount refCount;
+  // cache instead of recalc, including the hashes of the next updates
+  uint64_t hashValue;
+
+  struct ConstantIndex;
+
+  /// The latest updates at the constant indices of this update sequence,
+  /// down to its first update at a symbolic index, built on demand.
+  mutable ConstantIndex *constantIndex;
 
 public:
   const UpdateNode *next;
@@ -613,28 +637,41 @@ public:
 private:
   /// size of this update sequence, including this update
   unsigned size;
+
+  const ConstantIndex *getConstantIndex() const;
   
 public:
+  /// The size from which sequences are worth looking up by constant index
+  enum { ConstantIndexThreshold = 16 };
+
   UpdateNode(const UpdateNode *_next, 
              const ref<Expr> &_index, 
              const ref<Expr> &_value);
 
   unsigned getSize() const { return size; }
 
+  /// lookupConstantIndex - Find the latest update at the given constant index
+  /// without scanning the sequence. Returns the update, or null if the updates
+  /// down to the first one at a symbolic index are all at other indices; the
+  /// sequence from that first update on is returned in \a rest.
+  const UpdateNode *lookupConstantIndex(uint64_t index,
+                                        const UpdateNode *&rest) const;
+
   int compare(const UpdateNode &b) const;  
-  unsigned hash() const { return hashValue; }
+  uint64_t hash() const { return hashValue; }
 
 private:
-  UpdateNode() : refCount(0) {}
+  UpdateNode() : refCount(0), constantIndex(0) {}
   ~UpdateNode();
 
-  unsigned computeHash();
+  uint64_t computeHash();
 };
 
 class Array {
 public:
-  // Name of the array
-  const std::string name;
+  // Name of the array, interned such that the arrays of the same name share
+  // the string
+  const std::string &name;
 
   // FIXME: Not 64-bit clean.
   const unsigned size;
@@ -649,7 +686,10 @@ public:
   const std::vector<ref<ConstantExpr> > constantValues;
 
 private:
-  unsigned hashValue;
+  uint64_t hashValue;
+
+  /// The id given by the ArrayCache that created the array, see getId
+  unsigned id;
 
   // FIXME: Make =delete when we switch to C++11
   Array(const Array& array);
@@ -675,14 +715,19 @@ public:
   bool isSymbolicArray() const { return constantValues.empty(); }
   bool isConstantArray() const { return !isSymbolicArray(); }
 
-  const std::string getName() const { return name; }
+  const std::string &getName() const { return name; }
   unsigned getSize() const { return size; }
+
+  /// getId - The id of the array, distinct for the arrays of all the array
+  /// caches and dense from 0, such that the arrays can key containers by an
+  /// integer rather than by their name.
+  unsigned getId() const { return id; }
   Expr::Width getDomain() const { return domain; }
   Expr::Width getRange() const { return range; }
 
   /// ComputeHash must take into account the name, the size, the domain, and the range
-  unsigned computeHash();
-  unsigned hash() const { return hashValue; }
+  uint64_t computeHash();
+  uint64_t hash() const { return hashValue; }
   friend class ArrayCache;
 };
 
@@ -709,7 +754,7 @@ public:
   void extend(const ref<Expr> &index, const ref<Expr> &value);
 
   int compare(const UpdateList &b) const;
-  unsigned hash() const;
+  uint64_t hash() const;
 private:
   void tryFreeNodes();
 };
@@ -739,7 +784,7 @@ public:
   unsigned getNumKids() const { return numKids; }
   ref<Expr> getKid(unsigned i) const { return !i ? index : 0; }
 
-  std::string getName() const { return updates.root->name; }
+  const std::string &getName() const { return updates.root->name; }
 
   const Array *getArray() const { return updates.root; }
 
@@ -751,7 +796,7 @@ public:
     return create(updates, kids[0]);
   }
 
-  virtual unsigned computeHash();
+  virtual uint64_t computeHash();
 
 private:
   ReadExpr(const UpdateList &_updates, const ref<Expr> &_index) : 
@@ -917,7 +962,7 @@ public:
     return create(kids[0], offset, width);
   }
 
-  virtual unsigned computeHash();
+  virtual uint64_t computeHash();
 
 private:
   ExtractExpr(const ref<Expr> &e, unsigned b, Width w) 
@@ -966,7 +1011,7 @@ public:
     return create(kids[0]);
   }
 
-  virtual unsigned computeHash();
+  virtual uint64_t computeHash();
 
 public:
   static bool classof(const Expr *E) {
@@ -1003,7 +1048,7 @@ public:
     return 0;
   }
 
-  virtual unsigned computeHash();
+  virtual uint64_t computeHash();
 
   static bool classof(const Expr *E) {
     Expr::Kind k = E->getKind();
@@ -1191,12 +1236,43 @@ public:
     return const_cast<ConstantExpr *>(this);
   }
 
-  virtual unsigned computeHash();
+  virtual uint64_t computeHash();
 
   static ref<Expr> fromMemory(void *address, Width w);
   void toMemory(void *address);
 
+  /// SmallConstantCount - The number of the smallest values of each of the
+  /// standard widths whose constants are shared, see getSmallConstant().
+  static const uint64_t SmallConstantCount = 256;
+
+  /// SmallNegativeCount - The number of the largest values of each of the
+  /// standard widths, -1 downwards, whose constants are also shared. The
+  /// subtractions of constants are canonicalized into additions of their
+  /// negations, which makes these as frequent as the small values.
+  static const uint64_t SmallNegativeCount = 16;
+
+  /// isSmallValue - Return whether the value is one of the shared values of
+  /// the width, in which case getSmallConstant() has its constant if the
+  /// width is a standard one.
+  static bool isSmallValue(uint64_t v, Width w) {
+    return v < SmallConstantCount ||
+           (w <= Expr::Int64 &&
+            bits64::maxValueOfNBits(w) - v < SmallNegativeCount);
+  }
+
+  /// getSmallConstant - Return the shared constant of the given value and
+  /// width, or null if it is not of a shared value or width. The constants of
+  /// the small values are created once and kept for the whole run, such that
+  /// the concrete evaluation does not allocate them over and over.
+  static ConstantExpr *getSmallConstant(uint64_t v, Width w);
+
   static ref<ConstantExpr> alloc(const llvm::APInt &v) {
+    if (v.getBitWidth() <= Expr::Int64) {
+      uint64_t z = v.getZExtValue();
+      if (isSmallValue(z, v.getBitWidth()))
+        if (ConstantExpr *c = getSmallConstant(z, v.getBitWidth()))
+          return c;
+    }
     ref<ConstantExpr> r(new ConstantExpr(v));
     r->computeHash();
     return r;
@@ -1207,6 +1283,9 @@ public:
   }
 
   static ref<ConstantExpr> alloc(uint64_t v, Width w) {
+    if (isSmallValue(v, w))
+      if (ConstantExpr *c = getSmallConstant(v, w))
+        return c;
     return alloc(llvm::APInt(w, v));
   }
 
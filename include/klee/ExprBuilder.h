@@ -86,6 +86,13 @@ namespace klee {
   ///
   /// Base - The base builder to use when constructing expressions.
   ExprBuilder *createSimplifyingExprBuilder(ExprBuilder *Base);
+
+  /// createHashConsingExprBuilder - Create an expression builder which
+  /// returns a single shared node for all the structurally-equal expressions
+  /// it builds (see ExprHashConsing).
+  ///
+  /// Base - The base builder to use when constructing expressions.
+  ExprBuilder *createHashConsingExprBuilder(ExprBuilder *Base);
 }
 
 #endif
@@ -0,0 +1,160 @@
+//===-- FenwickPDF.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_FENWICKPDF_H
+#define KLEE_FENWICKPDF_H
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <cassert>
+#include <vector>
+
+namespace klee {
+
+  /// A discrete probability distribution over items, with the interface of
+  /// DiscretePDF, kept in flat arrays: the items and their weights are held
+  /// densely, in the slots 0 to size() - 1, and the prefix sums of the
+  /// weights in a Fenwick tree over the slots. Insertion, update, removal
+  /// and choice all take a logarithmic number of steps over contiguous
+  /// memory, and the items can be walked in order to be re-weighted.
+  template <class T>
+  class FenwickPDF {
+    typedef double weight_type;
+
+    std::vector<T> items;
+    std::vector<weight_type> weights;
+
+    /// The Fenwick tree, with the sum of the weights of the slots
+    /// (i - (i & -i), i] at index i, from 1 to the capacity
+    std::vector<weight_type> tree;
+
+    /// The slot of each item
+    llvm::DenseMap<T, unsigned> slots;
+
+    /// The number of updates of the tree since it was last built from the
+    /// weights, after which rounding errors may have accumulated
+    unsigned updateCount;
+
+    void add(unsigned slot, weight_type delta) {
+      for (unsigned i = slot + 1, e = tree.size(); i < e; i += i & -i)
+        tree[i] += delta;
+      ++updateCount;
+    }
+
+    /// Build the tree from the weights, for the given capacity
+    void rebuild(unsigned capacity) {
+      tree.assign(capacity + 1, 0.);
+      for (unsigned i = 0, e = weights.size(); i != e; ++i)
+        tree[i + 1] = weights[i];
+      for (unsigned i = 1; i <= capacity; ++i) {
+        unsigned parent = i + (i & -i);
+        if (parent <= capacity)
+          tree[parent] += tree[i];
+      }
+      updateCount = 0;
+    }
+
+    void set(unsigned slot, weight_type weight) {
+      add(slot, weight - weights[slot]);
+      weights[slot] = weight;
+    }
+
+    void maybeRebuild() {
+      if (updateCount > 2 * tree.size())
+        rebuild(tree.size() - 1);
+    }
+
+  public:
+    typedef typename std::vector<T>::const_iterator iterator;
+
+    FenwickPDF() : tree(1, 0.), updateCount(0) {}
+
+    bool empty() const { return items.empty(); }
+    unsigned size() const { return items.size(); }
+
+    iterator begin() const { return items.begin(); }
+    iterator end() const { return items.end(); }
+
+    void insert(T item, weight_type weight) {
+      assert(!slots.count(item) && "item already in the distribution");
+      unsigned slot = items.size();
+      slots[item] = slot;
+      items.push_back(item);
+      weights.push_back(0.);
+      if (tree.size() <= slot + 1) {
+        weights[slot] = weight;
+        rebuild(2 * tree.size());
+        return;
+      }
+      set(slot, weight);
+      maybeRebuild();
+    }
+
+    void update(T item, weight_type newWeight) {
+      typename llvm::DenseMap<T, unsigned>::iterator it = slots.find(item);
+      assert(it != slots.end() && "item not in the distribution");
+      set(it->second, newWeight);
+      maybeRebuild();
+    }
+
+    /// Remove an item, moving the item of the last slot into its slot
+    void remove(T item) {
+      typename llvm::DenseMap<T, unsigned>::iterator it = slots.find(item);
+      assert(it != slots.end() && "item not in the distribution");
+      unsigned slot = it->second, last = items.size() - 1;
+      slots.erase(it);
+      if (slot != last) {
+        items[slot] = items[last];
+        slots[items[slot]] = slot;
+        set(slot, weights[last]);
+      }
+      set(last, 0.);
+      items.pop_back();
+      weights.pop_back();
+      maybeRebuild();
+    }
+
+    bool inTree(T item) const { return slots.count(item); }
+
+    weight_type getWeight(T item) const {
+      typename llvm::DenseMap<T, unsigned>::const_iterator it =
+          slots.find(item);
+      assert(it != slots.end() && "item not in the distribution");
+      return weights[it->second];
+    }
+
+    /// Pick an item according to its weight. p should be in [0,1).
+    T choose(double p) const {
+      assert(!empty() && "choose on an empty distribution");
+      unsigned capacity = tree.size() - 1, pos = 0, step = 1;
+      weight_type total = 0.;
+      for (unsigned i = items.size(); i; i -= i & -i)
+        total += tree[i];
+
+      // Find the first slot whose prefix sum exceeds p times the total
+      weight_type w = p * total;
+      while (2 * step <= capacity)
+        step *= 2;
+      for (; step; step /= 2) {
+        if (pos + step <= capacity && tree[pos + step] <= w) {
+          pos += step;
+          w -= tree[pos];
+        }
+      }
+
+      // Rounding errors, or weights that are all zero, can lead past the last
+      // item
+      if (pos >= items.size())
+        pos = items.size() - 1;
+      return items[pos];
+    }
+  };
+}
+
+#endif
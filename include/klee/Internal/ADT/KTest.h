@@ -50,11 +50,51 @@ extern "C" {
   /* returns 1 on success, 0 on (unspecified) error */
   int   kTest_toFile(KTest *, const char *path);
   
+  /* returns a malloc'ed buffer holding the .ktest file contents, and sets
+     size_out to its size; returns NULL on (unspecified) error */
+  unsigned char *kTest_toBuffer(KTest *, unsigned *size_out);
+
+  /* returns NULL on (unspecified) error */
+  KTest* kTest_fromBuffer(const unsigned char *buffer, unsigned size);
+
   /* returns total number of object bytes */
   unsigned kTest_numBytes(KTest *);
 
   void  kTest_free(KTest *);
 
+  /* A test archive holds many tests in a single append-only file.  It
+     consists of a header followed by one record per test, each made of the
+     test id, a flags word, the stored and the original size of the test, and
+     the .ktest file contents of the test, possibly compressed.  The index of
+     the records is rebuilt from the record headers when opening the
+     archive; a truncated last record is ignored. */
+  typedef struct KTestArchive KTestArchive;
+
+  /* return true iff file at path matches the test archive header */
+  int   kTest_isKTestArchive(const char *path);
+
+  /* appends the test to the archive at path, creating it if needed; the
+     test is compressed if compress is true and compression is supported.
+     Concurrent writers are serialized using a lock on the archive.
+     returns 1 on success, 0 on (unspecified) error */
+  int   kTest_appendToArchive(KTest *, const char *path, unsigned id,
+                              int compress);
+
+  /* returns NULL on (unspecified) error */
+  KTestArchive* kTest_openArchive(const char *path);
+
+  /* returns the number of tests in the archive */
+  unsigned kTest_archiveNumTests(KTestArchive *);
+
+  /* returns the id of the test at the given position */
+  unsigned kTest_archiveTestId(KTestArchive *, unsigned index);
+
+  /* returns the test at the given position, to be released with
+     kTest_free; returns NULL on (unspecified) error */
+  KTest* kTest_fromArchive(KTestArchive *, unsigned index);
+
+  void  kTest_closeArchive(KTestArchive *);
+
 #ifdef __cplusplus
 }
 #endif
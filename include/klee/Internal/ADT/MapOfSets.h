@@ -40,6 +40,10 @@ namespace klee {
 
     V *lookup(const std::set<K> &set);
 
+    /// Remove the set, and the nodes only it used. Returns whether the set
+    /// was in the map.
+    bool remove(const std::set<K> &set);
+
     iterator begin();
     iterator end();
 
@@ -58,6 +62,10 @@ namespace klee {
 
     Node root;
 
+    bool remove(Node *n,
+                typename std::set<K>::const_iterator begin,
+                typename std::set<K>::const_iterator end);
+
     template<class Iterator, class Vector>
     void findSubsets(Node *n, 
                      const std::set<K> &accum,
@@ -213,6 +221,34 @@ namespace klee {
     }
   }
 
+  template<class K, class V>
+  bool MapOfSets<K,V>::remove(const std::set<K> &set) {
+    return remove(&root, set.begin(), set.end());
+  }
+
+  template<class K, class V>
+  bool MapOfSets<K,V>::remove(Node *n,
+                              typename std::set<K>::const_iterator begin,
+                              typename std::set<K>::const_iterator end) {
+    if (begin == end) {
+      if (!n->isEndOfSet)
+        return false;
+      n->isEndOfSet = false;
+      n->value = V();
+      return true;
+    }
+
+    typename Node::children_ty::iterator kit = n->children.find(*begin);
+    if (kit == n->children.end())
+      return false;
+    Node &child = kit->second;
+    if (!remove(&child, ++begin, end))
+      return false;
+    if (!child.isEndOfSet && child.children.empty())
+      n->children.erase(kit);
+    return true;
+  }
+
   template<class K, class V>
   typename MapOfSets<K,V>::iterator 
   MapOfSets<K,V>::begin() { return iterator(&root); }
@@ -10,6 +10,7 @@
 #ifndef __UTIL_TREESTREAM_H__
 #define __UTIL_TREESTREAM_H__
 
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -18,8 +19,17 @@ namespace klee {
   typedef unsigned TreeStreamID;
   class TreeOStream;
 
+  /// TreeStreamWriter - Writes a tree of byte streams into a file, where each
+  /// stream continues the stream it was opened from.
+  ///
+  /// The records are written into a logical byte sequence that is cut into
+  /// blocks, each compressed on its own (when zlib is available), with the
+  /// index of the blocks in a footer. Each record links to the previous
+  /// record of its stream, including the records of the streams it was
+  /// opened from, such that reading a stream only follows its own chain.
   class TreeStreamWriter {
     static const unsigned bufferSize = 4*4096;
+    static const unsigned blockSize = 64*1024;
 
     friend class TreeOStream;
 
@@ -31,8 +41,32 @@ namespace klee {
     std::ofstream *output;
     unsigned ids;
 
+    /// The logical offset of the last record of each stream
+    std::vector<uint64_t> lastRecords;
+
+    /// The uncompressed contents of the block being filled
+    std::vector<char> block;
+
+    /// The logical offset of the block being filled
+    uint64_t blockStart;
+
+    /// The logical and the file offsets of the written blocks
+    std::vector<uint64_t> blockStarts, blockOffsets;
+
+    /// The last block read back, to follow a chain within a block cheaply
+    unsigned cachedBlock;
+    std::vector<char> cachedData;
+
     void write(TreeOStream &os, const char *s, unsigned size);
+    void writeRecord(unsigned id, const char *s, unsigned size);
+    void append(const char *s, unsigned size);
     void flushBuffer();
+    void flushBlock();
+    void close();
+
+    bool readBlock(std::ifstream &is, unsigned index);
+    bool readLogical(std::ifstream &is, uint64_t offset, char *s,
+                     unsigned size);
 
   public:
     TreeStreamWriter(const std::string &_path);
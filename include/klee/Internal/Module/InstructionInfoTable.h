@@ -10,14 +10,17 @@
 #ifndef KLEE_LIB_INSTRUCTIONINFOTABLE_H
 #define KLEE_LIB_INSTRUCTIONINFOTABLE_H
 
-#include <map>
+#include "llvm/ADT/DenseMap.h"
+
 #include <string>
 #include <set>
+#include <vector>
 
 namespace llvm {
   class Function;
   class Instruction;
   class Module; 
+  class raw_ostream;
 }
 
 namespace klee {
@@ -50,7 +53,9 @@ namespace klee {
 
     std::string dummyString;
     InstructionInfo dummyInfo;
-    std::map<const llvm::Instruction*, InstructionInfo> infos;
+    /// The infos of the instructions, indexed by their ids
+    std::vector<InstructionInfo> infos;
+    llvm::DenseMap<const llvm::Instruction*, unsigned> ids;
     std::set<const std::string *, ltstr> internedStrings;
 
   private:
@@ -59,7 +64,13 @@ namespace klee {
                                  const std::string *&File, unsigned &Line);
 
   public:
-    InstructionInfoTable(llvm::Module *m);
+    /// Build the infos of the instructions of a module. When assemblyOutput
+    /// is given, the module is printed into it, with the lines longer than
+    /// 254 characters truncated if truncateLines is set, and the assembly
+    /// lines of the instructions are those of this print. They are zero
+    /// otherwise.
+    InstructionInfoTable(llvm::Module *m, llvm::raw_ostream *assemblyOutput = 0,
+                         bool truncateLines = false);
     ~InstructionInfoTable();
 
     unsigned getMaxID() const;
@@ -38,6 +38,31 @@ namespace klee {
     /// Destination register index.
     unsigned dest;
 
+    /// The opcode of the instruction, decoded when the function is built such
+    /// that the dispatch of the interpreter does not touch the LLVM
+    /// instruction.
+    unsigned opcode;
+
+    /// The width in bits of the result type, or 0 if the result type has no
+    /// size.
+    unsigned width;
+
+    /// Whether the Tracer-X subsumption table has entries whose program point
+    /// is this instruction. The interpreter only performs subsumption checks
+    /// before instructions with this flag set.
+    bool hasTableEntry;
+
+    /// Whether this instruction begins the header block of a natural loop, as
+    /// identified by LoopInfo when the function is built. The Tracer-X table
+    /// entries of these program points are widened with -loop-widening.
+    bool isLoopHeader;
+
+    /// Whether the value of this instruction cannot reach a branch
+    /// condition, a memory access, a call or a return, such that Tracer-X
+    /// does not build its dependency. Only set for the instructions without
+    /// side effects, with -dependency-slicing.
+    bool isDependencyIrrelevant;
+
   public:
     virtual ~KInstruction(); 
   };
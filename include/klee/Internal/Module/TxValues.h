@@ -34,6 +34,12 @@
 #include <llvm/Value.h>
 #endif
 
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
+
+#include <deque>
+#include <map>
+#include <string>
 #include <vector>
 
 namespace klee {
@@ -46,26 +52,122 @@ class TxStoreEntry;
 
 class TxStore;
 
+/// \brief A sorted list of distinct store entries, inlining the few entries a
+/// value typically depends upon
+typedef llvm::SmallVector<ref<TxStoreEntry>, 2> TxStoreEntryList;
+
 const uint64_t symbolicBoundId = ULONG_MAX;
 
+/// \brief A set of the reasons for the interpolant marking of a value.
+///
+/// The reasons are strings describing the program point that caused the
+/// marking, which are only built when debugging subsumption. They are
+/// interned into small integer tags, with the zero tag standing for no
+/// reason, such that the marking passes the tags down the recursion and the
+/// values store them as bits. The table of the strings is only consulted when
+/// printing.
+class TxCoreReasons {
+  /// \brief The bits of the tags in the set
+  std::vector<uint64_t> bits;
+
+  /// \brief The strings of the interned tags, indexed by the tags
+  static std::vector<std::string> names;
+
+  /// \brief The tags of the interned strings
+  static std::map<std::string, unsigned> tags;
+
+public:
+  /// \brief Get the tag of a reason, interning it when not yet seen. The
+  /// empty reason is the zero tag.
+  static unsigned intern(const std::string &reason);
+
+  /// \brief Get the string of an interned tag
+  static const std::string &getName(unsigned tag) { return names[tag]; }
+
+  void insert(unsigned tag) {
+    if (!tag)
+      return;
+    if (bits.size() <= tag / 64)
+      bits.resize(tag / 64 + 1, 0);
+    bits[tag / 64] |= (uint64_t)1 << (tag % 64);
+  }
+
+  bool empty() const { return bits.empty(); }
+
+  bool operator==(const TxCoreReasons &other) const {
+    return bits == other.bits;
+  }
+
+  /// \brief Get the tags in the set, in the order of their interning
+  void getTags(std::vector<unsigned> &result) const;
+};
+
+/// \brief The call histories, interned as the nodes of a tree of call
+/// strings.
+///
+/// Each distinct call history is held once, and identified by a 32-bit id,
+/// such that the values and allocation contexts of the same history share it
+/// and compare it in constant time. The empty history is the zero id.
+class TxCallHistory {
+  struct Node {
+    /// \brief The id of the history without the last call
+    unsigned parent;
+
+    /// \brief The calls of the history, from the outermost
+    std::vector<llvm::Instruction *> history;
+  };
+
+  /// \brief The nodes of the tree, indexed by their ids, which are not moved
+  /// as the tree grows
+  static std::deque<Node> nodes;
+
+  /// \brief The ids of the histories extended by a call
+  static llvm::DenseMap<std::pair<unsigned, llvm::Instruction *>, unsigned>
+  children;
+
+public:
+  /// \brief Get the id of a history, interning it when not yet seen
+  static unsigned intern(const std::vector<llvm::Instruction *> &history);
+
+  /// \brief Get the id of a history extended by a call
+  static unsigned extend(unsigned id, llvm::Instruction *site);
+
+  /// \brief Get the id of a history without its last call
+  static unsigned retract(unsigned id) { return nodes[id].parent; }
+
+  /// \brief Get the calls of an interned history
+  static const std::vector<llvm::Instruction *> &get(unsigned id) {
+    return nodes[id].history;
+  }
+};
+
 class TxAllocationContext {
 
 public:
-  unsigned refCount;
+  RefCount refCount;
 
 private:
   /// \brief The location's LLVM value
   llvm::Value *value;
 
-  /// \brief The call history by which the allocation is reached
-  std::vector<llvm::Instruction *> callHistory;
+  /// \brief The id of the call history by which the allocation is reached,
+  /// interned by TxCallHistory
+  unsigned callHistoryId;
+
+  /// \brief The hash of the value and the call history, which orders the
+  /// contexts before their full comparison
+  unsigned hashValue;
 
   TxAllocationContext(llvm::Value *_value,
                       const std::vector<llvm::Instruction *> &_callHistory)
-      : refCount(0), value(_value), callHistory(_callHistory) {}
+      : refCount(0), value(_value),
+        callHistoryId(TxCallHistory::intern(_callHistory)) {
+    hashValue = reinterpret_cast<uintptr_t>(value) * Expr::MAGIC_HASH_CONSTANT +
+                callHistoryId;
+  }
 
 public:
-  ~TxAllocationContext() { callHistory.clear(); }
+  ~TxAllocationContext() {}
 
   static ref<TxAllocationContext>
   create(llvm::Value *_value,
@@ -74,40 +176,26 @@ public:
   llvm::Value *getValue() const { return value; }
 
   const std::vector<llvm::Instruction *> &getCallHistory() const {
-    return callHistory;
+    return TxCallHistory::get(callHistoryId);
   }
 
+  unsigned getCallHistoryId() const { return callHistoryId; }
+
+  unsigned hash() const { return hashValue; }
+
+  /// \brief The comparator of this class' objects. The contexts are ordered
+  /// by their hashes first, then by their values and the ids of their call
+  /// histories.
   int compare(const TxAllocationContext &other) const {
-    if (value == other.value) {
-      // Please note the use of reverse iterator here, which improves
-      // performance.
-      for (std::vector<llvm::Instruction *>::const_reverse_iterator
-               it1 = callHistory.rbegin(),
-               ie1 = callHistory.rend(), it2 = other.callHistory.rbegin(),
-               ie2 = other.callHistory.rend();
-           ; ++it1, ++it2) {
-        if (it1 == ie1) {
-          if (it2 == ie2) {
-            break;
-          } else
-            return -1;
-        }
-        if (it2 == ie2)
-          return 1;
-        if (it1 == ie1)
-          return 1;
-        if ((*it1) > (*it2))
-          return 2;
-        if (it2 == ie2)
-          return -1;
-        if ((*it1) < (*it2))
-          return -2;
-      }
+    if (this == &other)
       return 0;
-    } else if (value < other.value) {
-      return -3;
-    }
-    return 3;
+    if (hashValue != other.hashValue)
+      return hashValue < other.hashValue ? -4 : 4;
+    if (value != other.value)
+      return value < other.value ? -3 : 3;
+    if (callHistoryId != other.callHistoryId)
+      return callHistoryId < other.callHistoryId ? -2 : 2;
+    return 0;
   }
 
   /// \brief Print the content of the object to the LLVM error stream
@@ -133,7 +221,7 @@ public:
 
 class TxAllocationInfo {
 public:
-  unsigned refCount;
+  RefCount refCount;
 
 private:
   ref<TxAllocationContext> context;
@@ -206,7 +294,7 @@ public:
 /// checking.
 class TxVariable {
 public:
-  unsigned refCount;
+  RefCount refCount;
 
 private:
   /// \brief The allocation information of this variable
@@ -221,10 +309,15 @@ private:
   /// \brief The value of the concrete offset
   uint64_t concreteOffset;
 
+  /// \brief The hash of the allocation base, size and offset, which orders
+  /// the variables before their full comparison
+  unsigned hashValue;
+
   /// \brief The copy constructor.
   TxVariable(const TxVariable &src)
       : refCount(0), allocInfo(src.allocInfo), offset(src.offset),
-        isConcrete(src.isConcrete), concreteOffset(src.concreteOffset) {}
+        isConcrete(src.isConcrete), concreteOffset(src.concreteOffset),
+        hashValue(src.hashValue) {}
 
   /// \brief The normal constructor.
   TxVariable(ref<TxAllocationInfo> _allocInfo, ref<Expr> _offset)
@@ -236,6 +329,12 @@ private:
       isConcrete = true;
       concreteOffset = ce->getZExtValue();
     }
+
+    // Equal variables have structurally equal bases and offsets
+    hashValue = (allocInfo->getBase()->hash() * Expr::MAGIC_HASH_CONSTANT +
+                 (unsigned)allocInfo->getSize()) *
+                    Expr::MAGIC_HASH_CONSTANT +
+                offset->hash();
   }
 
 public:
@@ -271,7 +370,16 @@ public:
   /// but of different loop iterations. This does not make sense when comparing
   /// states for subsumption as in subsumption, related allocations in different
   /// paths may have different base addresses.
+  ///
+  /// The variables are ordered by their hashes first, such that the
+  /// comparison of different variables mostly does not compare their
+  /// allocations and offsets.
   int compare(const TxVariable &other) const {
+    if (this == &other)
+      return 0;
+    if (hashValue != other.hashValue)
+      return hashValue < other.hashValue ? -1 : 1;
+
     int res = allocInfo->compare(*(other.allocInfo.get()));
     if (res)
       return res;
@@ -303,7 +411,7 @@ public:
 /// \brief A processed form of a value to be stored in the subsumption table
 class TxInterpolantValue {
 public:
-  unsigned refCount;
+  RefCount refCount;
 
 private:
   ref<Expr> expr;
@@ -321,6 +429,27 @@ private:
   /// bounds.
   std::map<ref<TxAllocationInfo>, std::set<ref<Expr> > > allocationOffsets;
 
+  /// \brief The bounds of an allocation in
+  /// TxInterpolantValue#allocationBounds, prepared for the bounds check
+  struct BoundsCheck {
+    /// \brief The concrete bounds, in ascending order
+    std::vector<uint64_t> bounds;
+
+    /// \brief The concrete bounds as pointer constants
+    std::vector<ref<Expr> > boundExprs;
+
+    /// \brief Whether the allocation also has a symbolic bound
+    bool symbolicBound;
+  };
+
+  /// \brief The bounds checks of TxInterpolantValue#allocationBounds, built
+  /// at the first bounds check of this tabled value, such that the repeated
+  /// checks against the states only instantiate them with the state offsets
+  mutable std::map<ref<TxAllocationInfo>, BoundsCheck> boundsChecks;
+
+  /// \brief Whether TxInterpolantValue#boundsChecks is built
+  mutable bool boundsChecksBuilt;
+
   /// \brief The id of this object
   uint64_t id;
 
@@ -331,21 +460,45 @@ private:
   bool doNotUseBound;
 
   /// \brief Reason this was stored as needed value
-  std::set<std::string> coreReasons;
+  TxCoreReasons coreReasons;
 
   /// \brief The original state value, which is used in subsumption check
   /// interpolation to propagate this value to interpolation marking
   ref<TxStateValue> originalValue;
 
   void init(llvm::Value *_value, ref<Expr> _expr, bool canInterpolateBound,
-            const std::set<std::string> &_coreReasons,
+            const TxCoreReasons &_coreReasons,
             ref<TxStateAddress> _locations,
             const std::map<ref<Expr>, ref<Expr> > &substitution,
             std::set<const Array *> &replacements, bool shadowing = false);
 
+  /// \brief Build TxInterpolantValue#boundsChecks, if not yet built
+  void buildBoundsChecks() const;
+
+  /// \brief The shared values of TxInterpolantValue#intern, by their hash
+  static std::map<unsigned, std::vector<ref<TxInterpolantValue> > >
+  sharedValues;
+
+  /// \brief The number of the values in TxInterpolantValue#sharedValues
+  static size_t sharedValuesSize;
+
+  /// \brief The size of TxInterpolantValue#sharedValues at which the values
+  /// no longer used by the table entries are released
+  static size_t sharedValuesThreshold;
+
+  /// \brief Release the shared values only referenced by
+  /// TxInterpolantValue#sharedValues
+  static void collectSharedValues();
+
+  unsigned hash() const;
+
+  /// \brief Whether the other value holds the same expression, bounds and
+  /// offsets, such that either can stand for the other in the table
+  bool equals(const TxInterpolantValue &other) const;
+
   TxInterpolantValue(llvm::Value *value, ref<Expr> expr,
                      bool canInterpolateBound,
-                     const std::set<std::string> &coreReasons,
+                     const TxCoreReasons &coreReasons,
                      ref<TxStateAddress> location,
                      const std::map<ref<Expr>, ref<Expr> > &substitution,
                      std::set<const Array *> &replacements) {
@@ -355,7 +508,7 @@ private:
 
   TxInterpolantValue(llvm::Value *value, ref<Expr> expr,
                      bool canInterpolateBound,
-                     const std::set<std::string> &coreReasons,
+                     const TxCoreReasons &coreReasons,
                      ref<TxStateAddress> location) {
     const std::map<ref<Expr>, ref<Expr> > dummySubstitution;
     std::set<const Array *> dummyReplacements;
@@ -366,7 +519,7 @@ private:
 public:
   static ref<TxInterpolantValue>
   create(llvm::Value *value, ref<Expr> expr, bool canInterpolateBound,
-         const std::set<std::string> &coreReasons, ref<TxStateAddress> location,
+         const TxCoreReasons &coreReasons, ref<TxStateAddress> location,
          const std::map<ref<Expr>, ref<Expr> > &substitution,
          std::set<const Array *> &replacements) {
     ref<TxInterpolantValue> sv(
@@ -375,9 +528,17 @@ public:
     return sv;
   }
 
+  static ref<TxInterpolantValue>
+  create(llvm::Value *value, ref<Expr> expr, bool canInterpolateBound,
+         const TxCoreReasons &coreReasons, ref<TxStateAddress> location) {
+    ref<TxInterpolantValue> sv(new TxInterpolantValue(
+        value, expr, canInterpolateBound, coreReasons, location));
+    return sv;
+  }
+
   static ref<TxInterpolantValue> create(llvm::Value *value, ref<Expr> expr,
                                         ref<TxStateAddress> location) {
-    std::set<std::string> dummyCoreReasons;
+    TxCoreReasons dummyCoreReasons;
     ref<TxInterpolantValue> sv(
         new TxInterpolantValue(value, expr, false, dummyCoreReasons, location));
     return sv;
@@ -385,6 +546,20 @@ public:
 
   ~TxInterpolantValue() {}
 
+  /// \brief Get the shared value equal to a shadowed value, sharing the value
+  /// when there is none. The entries along a path and at the iterations of a
+  /// loop mostly store the same values, which are then held once.
+  static ref<TxInterpolantValue> intern(ref<TxInterpolantValue> value);
+
+  /// \brief The number of the values replaced by an equal shared value
+  static uint64_t sharedHitCount;
+
+  /// \brief Replace the symbolic arrays of the expression and offsets of an
+  /// unshadowed value with their shadow arrays, and apply the substitution
+  /// to the expression, as the shadowing constructor does
+  void shadow(const std::map<ref<Expr>, ref<Expr> > &substitution,
+              std::set<const Array *> &replacements);
+
   int compare(const TxInterpolantValue other) const {
     if (id == other.id)
       return 0;
@@ -441,7 +616,7 @@ public:
 class TxStateAddress {
 
 public:
-  unsigned refCount;
+  RefCount refCount;
 
 private:
   /// \brief This address as a variable, with less information
@@ -633,7 +808,7 @@ public:
 /// updated (versioned).
 class TxStateValue {
 public:
-  unsigned refCount;
+  RefCount refCount;
 
 private:
   llvm::Value *value;
@@ -646,42 +821,51 @@ private:
   /// \brief The id of this object
   uint64_t id;
 
-  /// \brief The context of this value
-  std::vector<llvm::Instruction *> callHistory;
+  /// \brief The id of the context of this value, interned by TxCallHistory
+  unsigned callHistoryId;
 
   /// \brief Store entries this value is dependent upon, on which memory bound
   /// interpolation may be enabled.
-  std::set<ref<TxStoreEntry> > allowBoundEntryList;
+  TxStoreEntryList allowBoundEntryList;
 
   /// \brief Store entries this value is dependent upon, upon which memory bound
   /// interpolation may not be enabled.
-  std::set<ref<TxStoreEntry> > disableBoundEntryList;
+  TxStoreEntryList disableBoundEntryList;
 
   /// \brief The creation depth of this value.
   uint64_t depth;
 
-  TxStateValue(llvm::Value *value,
-               const std::vector<llvm::Instruction *> &_callHistory,
+  /// \brief Disable the bound interpolation on the entries an address used
+  /// by this value depends upon
+  void disableEntries(ref<TxStateValue> address);
+
+  TxStateValue(llvm::Value *value, unsigned _callHistoryId,
                ref<Expr> _valueExpr, uint64_t _depth)
       : refCount(0), value(value), valueExpr(_valueExpr),
-        id(reinterpret_cast<uint64_t>(this)), callHistory(_callHistory),
+        id(reinterpret_cast<uint64_t>(this)), callHistoryId(_callHistoryId),
         depth(_depth) {}
 
 public:
   ~TxStateValue() {}
 
+  /// \brief Allocation from the free-list pool of TxStateValue objects, as a
+  /// value is created for nearly every executed instruction
+  static void *operator new(size_t size);
+
+  static void operator delete(void *object, size_t size);
+
   static ref<TxStateValue>
   create(uint64_t depth, llvm::Value *value,
          const std::vector<llvm::Instruction *> &_callHistory,
          ref<Expr> valueExpr) {
-    ref<TxStateValue> vvalue(
-        new TxStateValue(value, _callHistory, valueExpr, depth));
+    ref<TxStateValue> vvalue(new TxStateValue(
+        value, TxCallHistory::intern(_callHistory), valueExpr, depth));
     return vvalue;
   }
 
   ref<TxStateValue> copy(uint64_t depth) const {
     ref<TxStateValue> vvalue(
-        new TxStateValue(value, callHistory, valueExpr, depth));
+        new TxStateValue(value, callHistoryId, valueExpr, depth));
     vvalue->allowBoundEntryList = allowBoundEntryList;
     vvalue->disableBoundEntryList = disableBoundEntryList;
     return vvalue;
@@ -712,9 +896,9 @@ public:
     disableBoundEntryList.clear();
   }
 
-  const std::set<ref<TxStoreEntry> > &getAllowBoundEntryList() const;
+  const TxStoreEntryList &getAllowBoundEntryList() const;
 
-  const std::set<ref<TxStoreEntry> > &getDisableBoundEntryList() const;
+  const TxStoreEntryList &getDisableBoundEntryList() const;
 
   int compare(const TxStateValue other) const {
     if (id == other.id)
@@ -738,7 +922,7 @@ public:
   llvm::Value *getValue() const { return value; }
 
   const std::vector<llvm::Instruction *> &getCallHistory() const {
-    return callHistory;
+    return TxCallHistory::get(callHistoryId);
   }
 
   /// \brief Print minimal information about this object.
@@ -786,7 +970,7 @@ public:
 /// TxStoreEntry#leftCoreReasons, TxStoreEntry#rightCoreReasons).
 class TxStoreEntry {
 public:
-  unsigned refCount;
+  RefCount refCount;
 
 private:
   ref<TxStateAddress> address;
@@ -833,11 +1017,19 @@ private:
 
   /// \brief Reasons for the interpolant marking, from the subtree of the
   /// immediate left child. This is used for debugging.
-  std::set<std::string> leftCoreReasons;
+  TxCoreReasons leftCoreReasons;
 
   /// \brief Reasons for the interpolant marking, from the subtree of the
   /// immediate right child. This is used for debugging.
-  std::set<std::string> rightCoreReasons;
+  TxCoreReasons rightCoreReasons;
+
+  /// \brief The last pointer marking traversal that visited this entry from
+  /// the subtree of the immediate left child
+  uint64_t leftMarkingEpoch;
+
+  /// \brief The last pointer marking traversal that visited this entry from
+  /// the subtree of the immediate right child
+  uint64_t rightMarkingEpoch;
 
   /// \brief Cached interpolant-style value for left querying in subsumption
   /// check.
@@ -854,6 +1046,11 @@ public:
 
   ~TxStoreEntry() {}
 
+  /// \brief Allocation from the free-list pool of TxStoreEntry objects
+  static void *operator new(size_t size);
+
+  static void operator delete(void *object, size_t size);
+
   ref<TxVariable> getIndex() { return address->getAsVariable(); }
 
   ref<TxStateAddress> getAddress() { return address; }
@@ -894,16 +1091,14 @@ public:
     rightDoNotInterpolateBound = true;
   }
 
-  void setAsCore(bool leftMarking, const std::string &reason) {
+  void setAsCore(bool leftMarking, unsigned reason) {
     if (leftMarking) {
       leftCore = true;
-      if (!reason.empty())
-        leftCoreReasons.insert(reason);
+      leftCoreReasons.insert(reason);
       return;
     }
     rightCore = true;
-    if (!reason.empty())
-      rightCoreReasons.insert(reason);
+    rightCoreReasons.insert(reason);
   }
 
   bool isCore(bool leftMarking) const {
@@ -912,6 +1107,16 @@ public:
     return rightCore;
   }
 
+  /// \brief Stamp the entry as visited by the given marking traversal.
+  /// Returns false if it was already visited by the traversal.
+  bool visitMarking(bool leftMarking, uint64_t epoch) {
+    uint64_t &stamp = leftMarking ? leftMarkingEpoch : rightMarkingEpoch;
+    if (stamp == epoch)
+      return false;
+    stamp = epoch;
+    return true;
+  }
+
   bool isPointer() const { return !leftPointerInfo.isNull(); }
 
   uint64_t getDepth() { return depth; }
@@ -933,6 +1138,19 @@ public:
     return rightInterpolantStyleValue;
   }
 
+  /// \brief Get the interpolant value without shadowing its symbolic
+  /// arrays, which is to be done by TxInterpolantValue#shadow before its use
+  ref<TxInterpolantValue> getRawInterpolantValue(bool leftUse) const {
+    if (leftUse) {
+      return TxInterpolantValue::create(value, valueExpr,
+                                        !leftDoNotInterpolateBound,
+                                        leftCoreReasons, leftPointerInfo);
+    }
+    return TxInterpolantValue::create(value, valueExpr,
+                                      !rightDoNotInterpolateBound,
+                                      rightCoreReasons, rightPointerInfo);
+  }
+
   ref<TxInterpolantValue> getInterpolantValue(bool leftUse) const {
     const std::map<ref<Expr>, ref<Expr> > dummySubstitution;
     std::set<const Array *> dummyReplacements;
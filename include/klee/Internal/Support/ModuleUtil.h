@@ -11,6 +11,7 @@
 #define KLEE_TRANSFORM_UTIL_H
 
 #include <string>
+#include <vector>
 
 namespace llvm {
   class Function;
@@ -36,6 +37,13 @@ namespace klee {
   /// terminates in a direct call).
   bool functionEscapes(const llvm::Function *f);
 
+  /// Remove the bodies of the functions that cannot be reached from the
+  /// named root functions, the initializers of the global variables and the
+  /// aliases, through the functions referenced by reachable functions, and
+  /// erase those left unused. Return the number of bodies removed.
+  unsigned removeUnreachableFunctions(llvm::Module *module,
+                                      const std::vector<std::string> &roots);
+
 }
 
 #endif
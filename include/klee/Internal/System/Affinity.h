@@ -0,0 +1,25 @@
+//===-- Affinity.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_UTIL_AFFINITY_H
+#define KLEE_UTIL_AFFINITY_H
+
+namespace klee {
+  namespace util {
+
+    /// Pin this process to the CPU of the given worker index. The CPUs this
+    /// process may run on are taken in turn from each NUMA node, such that
+    /// consecutive workers are spread over the nodes, and the memory a
+    /// worker allocates stays on the node of its CPU. Returns false when the
+    /// affinity cannot be set.
+    bool pinToWorkerCPU(unsigned worker);
+  }
+}
+
+#endif
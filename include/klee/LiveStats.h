@@ -0,0 +1,66 @@
+//===-- LiveStats.h ---------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_LIVESTATS_H
+#define KLEE_LIVESTATS_H
+
+#include <stdint.h>
+
+namespace klee {
+
+/// LiveStats - The layout of the file of -live-stats-file, which a running
+/// klee keeps mapped in memory and updates every -live-stats-interval
+/// seconds, such that monitors can read its current statistics by mapping
+/// the file, without parsing the files of its output directory.
+///
+/// The file is best put on a memory file system, as /dev/shm. The sequence
+/// is odd while the fields are being written: a reader copies the fields
+/// between two reads of an even and unchanged sequence. A run that stalls
+/// leaves its update time behind, and a run that ended has finished set.
+struct LiveStats {
+  /// "KLST"
+  static const uint32_t Magic = 0x54534c4b;
+  static const uint32_t Version = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  volatile uint64_t sequence;
+  uint64_t pid;
+  uint64_t finished;
+
+  /// The wall time of the last update, in seconds since the epoch, and the
+  /// seconds since the start of the run
+  double updateTime;
+  double elapsed;
+
+  uint64_t instructions;
+  uint64_t states;
+  uint64_t queries;
+  uint64_t forks;
+
+  /// The rates over the last interval, per second
+  double instructionsPerSecond;
+  double queriesPerSecond;
+
+  /// The share of the wall time of the last interval spent in the solver
+  double solverTimeShare;
+
+  /// The subsumption checks of the states, and those that terminated them
+  uint64_t subsumptionChecks;
+  uint64_t subsumptionHits;
+
+  /// The memory in bytes: of the heap in total, and of the memory objects
+  uint64_t heapMemory;
+  uint64_t objectMemory;
+  /// The number of live expressions
+  uint64_t expressions;
+};
+}
+
+#endif
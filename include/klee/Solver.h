@@ -195,6 +195,17 @@ namespace klee {
                           std::vector<std::vector<unsigned char> > &result,
                           std::vector<ref<Expr> > &unsatCore);
 
+    /// getInitialValues - Compute the initial values for a list of objects,
+    /// telling a query without a satisfying assignment, for which hasSolution
+    /// is set to false, apart from a failure.
+    ///
+    /// \return True on success.
+    bool getInitialValues(const Query &,
+                          const std::vector<const Array *> &objects,
+                          std::vector<std::vector<unsigned char> > &result,
+                          bool &hasSolution,
+                          std::vector<ref<Expr> > &unsatCore);
+
     /// getRange - Compute a tight range of possible values for a given
     /// expression.
     ///
@@ -209,6 +220,10 @@ namespace klee {
     
     virtual char *getConstraintLog(const Query& query);
     virtual void setCoreSolverTimeout(double timeout);
+
+    /// releaseMemory - Drop the caches of the solver chain, which are rebuilt
+    /// by the later queries.
+    void releaseMemory();
   };
 
   #ifdef ENABLE_STP
@@ -291,6 +306,17 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createCachingSolver(Solver *s);
 
+  /// createPersistentCachingSolver - Create a solver which will cache the
+  /// queries in a file, such that their results are reused across runs. The
+  /// file can be shared by several runs at once.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param path - The path of the cache file.
+  /// \param maxSizeMB - The size from which the file is compacted when it is
+  /// opened, in megabytes, or 0 for no limit.
+  Solver *createPersistentCachingSolver(Solver *s, std::string path,
+                                        unsigned maxSizeMB);
+
   /// createCexCachingSolver - Create a counterexample caching solver. This is a
   /// more sophisticated cache which records counterexamples for a constraint
   /// set and uses subset/superset relations among constraints to try and
@@ -312,6 +338,14 @@ namespace klee {
   ///
   /// \param s - The underlying solver to use.
   Solver *createIndependentSolver(Solver *s);
+
+  /// createArraySlicingSolver - Create a solver which restricts the symbolic
+  /// reads of constant arrays to the slices of the arrays at the indices
+  /// feasible under the constraints, before propogating the query to the
+  /// underlying solver.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createArraySlicingSolver(Solver *s);
   
   /// createPCLoggingSolver - Create a solver which will forward all queries
   /// after writing them to the given path in .pc format.
@@ -323,6 +357,22 @@ namespace klee {
   Solver *createSMTLIBLoggingSolver(Solver *s, std::string path,
                                     int minQueryTimeToLog);
 
+  /// createBinaryLoggingSolver - Create a solver which will forward all
+  /// queries after writing them to the given path in the binary query log
+  /// format, which kleaver reads as well as .pc files.
+  Solver *createBinaryLoggingSolver(Solver *s, std::string path,
+                                    int minQueryTimeToLog);
+
+
+  /// createPortfolioSolver - Create a solver which runs two core solvers on
+  /// each query in forked processes, and returns the answer of the first one
+  /// to finish. Unsatisfiability cores are only taken from the primary
+  /// solver, which is asked again when a core is needed for interpolation
+  /// but the secondary solver finished first.
+  ///
+  /// \param primary - The core solver that provides the cores.
+  /// \param secondary - The core solver to race against the primary one.
+  Solver *createPortfolioSolver(Solver *primary, Solver *secondary);
 
   /// createDummySolver - Create a dummy solver implementation which always
   /// fails.
@@ -105,6 +105,10 @@ namespace klee {
     }
 
     virtual void setCoreSolverTimeout(double timeout) {};
+
+    /// releaseMemory - Drop the caches of the solver, and of the solvers it
+    /// is built on, to free memory near the memory cap.
+    virtual void releaseMemory() {}
   };
 
 }
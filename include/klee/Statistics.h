@@ -39,11 +39,21 @@ namespace klee {
 
   class StatisticManager {
   private:
+    static const unsigned CacheLineSize = 64;
+
     bool enabled;
     std::vector<Statistic*> stats;
     uint64_t *globalStats;
+    /// The statistics of each index, in rows of indexedStride counters
+    /// aligned to cache lines, such that the counters of an instruction share
+    /// their lines with no other instruction.
     uint64_t *indexedStats;
+    unsigned indexedStride;
     StatisticRecord *contextStats;
+    /// The slots of the statistics in the context records, or -1 for those
+    /// they do not count, and the number of those they count
+    std::vector<int> contextSlots;
+    unsigned numContextStats;
     unsigned index;
 
   public:
@@ -55,6 +65,12 @@ namespace klee {
     StatisticRecord *getContext();
     void setContext(StatisticRecord *sr); /* null to reset */
 
+    /// Count only the given statistics in the context records, which must
+    /// be set before any record is created.
+    void setContextStatistics(const std::vector<Statistic *> &selected);
+    unsigned getNumContextStatistics() const { return numContextStats; }
+    int getContextSlot(const Statistic &s) const { return contextSlots[s.id]; }
+
     void setIndex(unsigned i) { index = i; }
     unsigned getIndex() { return index; }
     unsigned getNumStatistics() { return stats.size(); }
@@ -78,9 +94,9 @@ namespace klee {
     if (enabled) {
       globalStats[s.id] += addend;
       if (indexedStats) {
-        indexedStats[index*stats.size() + s.id] += addend;
-        if (contextStats)
-          contextStats->data[s.id] += addend;
+        indexedStats[index*indexedStride + s.id] += addend;
+        if (contextStats && contextSlots[s.id] >= 0)
+          contextStats->data[contextSlots[s.id]] += addend;
       }
     }
   }
@@ -93,37 +109,41 @@ namespace klee {
   }
 
   inline void StatisticRecord::zero() {
-    ::memset(data, 0, sizeof(*data)*theStatisticManager->getNumStatistics());
+    ::memset(data, 0,
+             sizeof(*data)*theStatisticManager->getNumContextStatistics());
   }
 
   inline StatisticRecord::StatisticRecord() 
-    : data(new uint64_t[theStatisticManager->getNumStatistics()]) {
+    : data(new uint64_t[theStatisticManager->getNumContextStatistics()]) {
     zero();
   }
 
   inline StatisticRecord::StatisticRecord(const StatisticRecord &s) 
-    : data(new uint64_t[theStatisticManager->getNumStatistics()]) {
+    : data(new uint64_t[theStatisticManager->getNumContextStatistics()]) {
     ::memcpy(data, s.data, 
-             sizeof(*data)*theStatisticManager->getNumStatistics());
+             sizeof(*data)*theStatisticManager->getNumContextStatistics());
   }
 
   inline StatisticRecord &StatisticRecord::operator=(const StatisticRecord &s) {
     ::memcpy(data, s.data, 
-             sizeof(*data)*theStatisticManager->getNumStatistics());
+             sizeof(*data)*theStatisticManager->getNumContextStatistics());
     return *this;
   }
 
   inline void StatisticRecord::incrementValue(const Statistic &s, 
                                               uint64_t addend) const {
-    data[s.id] += addend;
+    int slot = theStatisticManager->getContextSlot(s);
+    if (slot >= 0)
+      data[slot] += addend;
   }
   inline uint64_t StatisticRecord::getValue(const Statistic &s) const { 
-    return data[s.id]; 
+    int slot = theStatisticManager->getContextSlot(s);
+    return slot >= 0 ? data[slot] : 0;
   }
 
   inline StatisticRecord &
   StatisticRecord::operator +=(const StatisticRecord &sr) {
-    unsigned nStats = theStatisticManager->getNumStatistics();
+    unsigned nStats = theStatisticManager->getNumContextStatistics();
     for (unsigned i=0; i<nStats; i++)
       data[i] += sr.data[i];
     return *this;
@@ -136,18 +156,18 @@ namespace klee {
   inline void StatisticManager::incrementIndexedValue(const Statistic &s, 
                                                       unsigned index,
                                                       uint64_t addend) const {
-    indexedStats[index*stats.size() + s.id] += addend;
+    indexedStats[index*indexedStride + s.id] += addend;
   }
 
   inline uint64_t StatisticManager::getIndexedValue(const Statistic &s, 
                                                     unsigned index) const {
-    return indexedStats[index*stats.size() + s.id];
+    return indexedStats[index*indexedStride + s.id];
   }
 
   inline void StatisticManager::setIndexedValue(const Statistic &s, 
                                                 unsigned index,
                                                 uint64_t value) {
-    indexedStats[index*stats.size() + s.id] = value;
+    indexedStats[index*indexedStride + s.id] = value;
   }
 }
 
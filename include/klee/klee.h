@@ -135,6 +135,12 @@ extern "C" {
      constants and that the range lie within a single object. */
   void klee_check_memory_access(const void *address, size_t size);
 
+  /* Copy size bytes from src to dest in the executor, without executing the
+     instructions of the copy. Returns zero, leaving the copy to the caller,
+     unless both addresses and the size are constants and each range lies
+     within a single object. */
+  int klee_copy_bytes(void *dest, const void *src, size_t size);
+
   /* Enable/disable forking. */
   void klee_set_forking(unsigned enable);
 
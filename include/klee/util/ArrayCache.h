@@ -31,14 +31,60 @@ struct EquivArrayCmpFn {
   bool operator()(const Array *array1, const Array *array2) const {
     if (array1 == NULL || array2 == NULL)
       return false;
-    return (array1->size == array2->size) && (array1->name == array2->name);
+    // The names are interned, hence equal names are the same string
+    return (array1->size == array2->size) && (&array1->name == &array2->name);
+  }
+};
+
+struct ConstantArrayHashFn {
+  size_t operator()(const Array *array) const {
+    uint64_t res = array->size ^ (array->getDomain() << 16) ^
+                   (array->getRange() << 24);
+    for (std::vector<ref<ConstantExpr> >::const_iterator
+             it = array->constantValues.begin(),
+             ie = array->constantValues.end();
+         it != ie; ++it)
+      res = Expr::combineHash(res, (*it)->hash());
+    return res;
+  }
+};
+
+/// Constant arrays are equivalent when they have the same contents, whatever
+/// their names.
+struct EquivConstantArrayCmpFn {
+  bool operator()(const Array *array1, const Array *array2) const {
+    return (array1->size == array2->size) &&
+           (array1->getDomain() == array2->getDomain()) &&
+           (array1->getRange() == array2->getRange()) &&
+           (array1->constantValues == array2->constantValues);
+  }
+};
+
+struct UpdateListHashFn {
+  size_t operator()(const UpdateList &updates) const {
+    return Expr::combineHash(updates.root->hash(), updates.head->hash());
+  }
+};
+
+/// Update lists are equivalent when their heads write the same value at the
+/// same index of the same sequence of updates of the same array. The array
+/// matters as the solver builders cache the arrays built for the update nodes.
+struct EquivUpdateListCmpFn {
+  bool operator()(const UpdateList &updates1,
+                  const UpdateList &updates2) const {
+    const UpdateNode *un1 = updates1.head, *un2 = updates2.head;
+    if (updates1.root != updates2.root)
+      return false;
+    return (un1 == un2) || ((un1->next == un2->next) &&
+                            (un1->index == un2->index) &&
+                            (un1->value == un2->value));
   }
 };
 
 /// Provides an interface for creating and destroying Array objects.
 class ArrayCache {
 public:
-  ArrayCache() {}
+  ArrayCache() : sharedUpdatesToRelease(MinSharedUpdatesToRelease) {}
   ~ArrayCache();
   /// Create an Array object.
   //
@@ -67,12 +113,47 @@ public:
                            Expr::Width _domain = Expr::Int32,
                            Expr::Width _range = Expr::Int8);
 
+  /// Create a constant Array object, or return the cached one with the same
+  /// contents, domain and range, which may have another name.
+  ///
+  /// Unlike those of CreateArray(), the constant arrays are shared, such
+  /// that the states writing the same constant contents, as the sibling
+  /// states after a fork do, use a single Array object.
+  const Array *CreateSharedConstantArray(
+      const std::string &_name, uint64_t _size,
+      const ref<ConstantExpr> *constantValuesBegin,
+      const ref<ConstantExpr> *constantValuesEnd,
+      Expr::Width _domain = Expr::Int32, Expr::Width _range = Expr::Int8);
+
+  /// Extend the update list with a write, reusing the update node of an
+  /// equivalent write to the same list, such that the states writing the
+  /// same values after a fork share their update nodes.
+  ///
+  /// The cache holds references to these nodes, which it releases once they
+  /// are not referenced by any other update list.
+  void extendUpdates(UpdateList &updates, const ref<Expr> &index,
+                     const ref<Expr> &value);
+
 private:
+  /// The minimum number of shared update nodes before those only referenced
+  /// by the cache are released
+  enum { MinSharedUpdatesToRelease = 1024 };
+
+  /// Release the shared update nodes only referenced by the cache.
+  void releaseSharedUpdates();
+
   typedef unordered_set<const Array *, klee::ArrayHashFn,
                         klee::EquivArrayCmpFn> ArrayHashMap;
   ArrayHashMap cachedSymbolicArrays;
   typedef std::vector<const Array *> ArrayPtrVec;
   ArrayPtrVec concreteArrays;
+  typedef unordered_set<const Array *, klee::ConstantArrayHashFn,
+                        klee::EquivConstantArrayCmpFn> ConstantArrayHashMap;
+  ConstantArrayHashMap sharedConstantArrays;
+  typedef unordered_set<UpdateList, klee::UpdateListHashFn,
+                        klee::EquivUpdateListCmpFn> UpdateListHashMap;
+  UpdateListHashMap sharedUpdates;
+  size_t sharedUpdatesToRelease;
 };
 }
 
@@ -64,6 +64,8 @@ namespace klee {
     AssignmentEvaluator(const Assignment &_a) : a(_a) {}    
   };
 
+  /// The cached result of a query: a satisfying assignment, owned by the
+  /// cache that shares it between its entries, or the unsatisfiability core.
   class AssignmentCacheWrapper {
     Assignment *a;
     std::vector< ref<Expr> > unsatCore;
@@ -75,7 +77,6 @@ namespace klee {
         : a(0), unsatCore(_unsatCore) {}
 
     ~AssignmentCacheWrapper() {
-      delete a;
       unsatCore.clear();
     }
 
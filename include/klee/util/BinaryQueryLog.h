@@ -0,0 +1,142 @@
+//===-- BinaryQueryLog.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A compact binary format of the query logs. The file starts with a magic
+// number and a version, followed by records, each a tag byte and a payload
+// of variable-length (LEB128) integers and length-prefixed strings:
+//
+//   'E' expression: kind, then the kind-specific payload, with the kids as
+//       the ids of previously written expressions
+//   'A' array: name, size, domain, range, whether it is symbolic, and the
+//       values of a constant array
+//   'U' update node: array id, next update node id plus one (zero for none),
+//       index and value expression ids
+//   'Q' query: constraint ids, query expression id, value expression ids and
+//       objects array ids, as the (query ...) command of the .pc language
+//   'C' comment
+//   'R' reset of the tables of the expressions, arrays and update nodes
+//
+// The expressions, arrays and update nodes are numbered in the order of
+// their records, and each is written once across the queries, such that the
+// shared sub-expressions and the constraints common to many queries cost one
+// id each time they recur.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BINARYQUERYLOG_H
+#define KLEE_BINARYQUERYLOG_H
+
+#include "klee/Expr.h"
+#include "klee/util/ExprHashMap.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class MemoryBuffer;
+class raw_ostream;
+}
+
+namespace klee {
+class ConstraintManager;
+class ExprBuilder;
+
+namespace expr {
+class Parser;
+}
+
+/// BinaryQueryWriter - Writes queries in the binary query log format.
+///
+/// The records are accumulated until they are either committed to the
+/// output, or discarded, in which case the expressions, arrays and update
+/// nodes they defined are forgotten, so that the committed log stays
+/// self-contained.
+class BinaryQueryWriter {
+public:
+  static const char Magic[4];
+  static const unsigned Version = 1;
+
+  enum RecordTag {
+    ExprRecord = 'E',
+    ArrayRecord = 'A',
+    UpdateRecord = 'U',
+    QueryRecord = 'Q',
+    CommentRecord = 'C',
+    ResetRecord = 'R'
+  };
+
+private:
+  /// The number of expressions after which the tables are reset, to bound
+  /// the memory kept alive by the writer
+  static const unsigned ResetThreshold = 1 << 20;
+
+  struct Marks {
+    unsigned exprs, arrays, updates;
+  };
+
+  std::string pending;
+  bool headerWritten;
+
+  ExprHashMap<unsigned> exprIds;
+  std::vector<ref<Expr> > exprs;
+  std::map<const Array *, unsigned> arrayIds;
+  std::vector<const Array *> arrays;
+  std::map<const UpdateNode *, unsigned> updateIds;
+  /// The update lists keep the written update nodes alive
+  std::vector<UpdateList> updates;
+  Marks committed;
+
+  Marks getMarks() const;
+  void rollback(const Marks &marks);
+
+  void writeUnsigned(uint64_t value);
+  void writeString(const std::string &s);
+
+  /// Write the expression and its unwritten sub-expressions, and return
+  /// whether all could be represented.
+  bool writeExpr(const ref<Expr> &e, unsigned &id);
+  unsigned writeArray(const Array *array);
+  /// Write the unwritten update nodes of the list, and set the id plus one of
+  /// its head, or zero when it is empty.
+  bool writeUpdates(const UpdateList &ul, unsigned &id);
+
+public:
+  BinaryQueryWriter();
+
+  /// Write a query, and return false, having written nothing, when it
+  /// contains expressions that the format does not represent.
+  bool writeQuery(const ConstraintManager &constraints, const ref<Expr> &q,
+                  const ref<Expr> *evalExprsBegin = 0,
+                  const ref<Expr> *evalExprsEnd = 0,
+                  const Array *const *evalArraysBegin = 0,
+                  const Array *const *evalArraysEnd = 0);
+
+  void writeComment(const std::string &comment);
+
+  /// Write the pending records to the output.
+  void commit(llvm::raw_ostream &os);
+
+  /// Drop the pending records.
+  void discard();
+};
+
+namespace expr {
+/// isBinaryQueryLog - Return whether the buffer holds a binary query log.
+bool isBinaryQueryLog(const llvm::MemoryBuffer *MB);
+
+/// createBinaryQueryParser - Create a parser of a binary query log, which
+/// returns its queries as query commands.
+Parser *createBinaryQueryParser(const std::string &Filename,
+                                const llvm::MemoryBuffer *MB,
+                                ExprBuilder *Builder);
+}
+}
+
+#endif
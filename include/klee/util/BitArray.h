@@ -10,6 +10,9 @@
 #ifndef KLEE_UTIL_BITARRAY_H
 #define KLEE_UTIL_BITARRAY_H
 
+#include <stdint.h>
+#include <string.h>
+
 namespace klee {
 
   // XXX would be nice not to have
@@ -17,24 +20,98 @@ namespace klee {
   // BitArrays
 class BitArray {
 private:
-  uint32_t *bits;
-  
+  uint64_t *bits;
+
+  /// The mask of the n bits from shift within a word, where shift + n is at
+  /// most 64
+  static uint64_t mask(unsigned shift, unsigned n) {
+    return (n == 64 ? ~UINT64_C(0) : (UINT64_C(1) << n) - 1) << shift;
+  }
+
+  /// The number of the bits from idx to end, but at most those up to the end
+  /// of the word of idx
+  static unsigned wordCount(unsigned idx, unsigned end) {
+    unsigned shift = idx & 0x3F;
+    return end - idx < 64 - shift ? end - idx : 64 - shift;
+  }
+
 protected:
-  static uint32_t length(unsigned size) { return (size+31)/32; }
+  static uint32_t length(unsigned size) { return (size+63)/64; }
 
 public:
-  BitArray(unsigned size, bool value = false) : bits(new uint32_t[length(size)]) {
+  BitArray(unsigned size, bool value = false) : bits(new uint64_t[length(size)]) {
     memset(bits, value?0xFF:0, sizeof(*bits)*length(size));
   }
-  BitArray(const BitArray &b, unsigned size) : bits(new uint32_t[length(size)]) {
+  BitArray(const BitArray &b, unsigned size) : bits(new uint64_t[length(size)]) {
     memcpy(bits, b.bits, sizeof(*bits)*length(size));
   }
   ~BitArray() { delete[] bits; }
 
-  bool get(unsigned idx) { return (bool) ((bits[idx/32]>>(idx&0x1F))&1); }
-  void set(unsigned idx) { bits[idx/32] |= 1<<(idx&0x1F); }
-  void unset(unsigned idx) { bits[idx/32] &= ~(1<<(idx&0x1F)); }
+  bool get(unsigned idx) { return (bool) ((bits[idx/64]>>(idx&0x3F))&1); }
+  void set(unsigned idx) { bits[idx/64] |= UINT64_C(1)<<(idx&0x3F); }
+  void unset(unsigned idx) { bits[idx/64] &= ~(UINT64_C(1)<<(idx&0x3F)); }
   void set(unsigned idx, bool value) { if (value) set(idx); else unset(idx); }
+
+  /// Set, or unset, the bits from idx to idx + count, a word at a time.
+  void setRange(unsigned idx, unsigned count) {
+    for (unsigned end = idx + count; idx < end;) {
+      unsigned n = wordCount(idx, end);
+      bits[idx/64] |= mask(idx & 0x3F, n);
+      idx += n;
+    }
+  }
+  void unsetRange(unsigned idx, unsigned count) {
+    for (unsigned end = idx + count; idx < end;) {
+      unsigned n = wordCount(idx, end);
+      bits[idx/64] &= ~mask(idx & 0x3F, n);
+      idx += n;
+    }
+  }
+
+  /// Return whether the bits from idx to idx + count are all set, or all
+  /// unset, testing them a word at a time.
+  bool isAllSet(unsigned idx, unsigned count) const {
+    for (unsigned end = idx + count; idx < end;) {
+      unsigned n = wordCount(idx, end);
+      uint64_t m = mask(idx & 0x3F, n);
+      if ((bits[idx/64] & m) != m)
+        return false;
+      idx += n;
+    }
+    return true;
+  }
+  bool isAllUnset(unsigned idx, unsigned count) const {
+    for (unsigned end = idx + count; idx < end;) {
+      unsigned n = wordCount(idx, end);
+      if (bits[idx/64] & mask(idx & 0x3F, n))
+        return false;
+      idx += n;
+    }
+    return true;
+  }
+
+  /// Return the first set, or unset, bit from idx to idx + count, or
+  /// idx + count when there is none.
+  unsigned findFirstSet(unsigned idx, unsigned count) const {
+    for (unsigned end = idx + count; idx < end;) {
+      unsigned n = wordCount(idx, end);
+      uint64_t word = bits[idx/64] & mask(idx & 0x3F, n);
+      if (word)
+        return (idx & ~0x3FU) + __builtin_ctzll(word);
+      idx += n;
+    }
+    return idx;
+  }
+  unsigned findFirstUnset(unsigned idx, unsigned count) const {
+    for (unsigned end = idx + count; idx < end;) {
+      unsigned n = wordCount(idx, end);
+      uint64_t word = ~bits[idx/64] & mask(idx & 0x3F, n);
+      if (word)
+        return (idx & ~0x3FU) + __builtin_ctzll(word);
+      idx += n;
+    }
+    return idx;
+  }
 };
 
 } // End klee namespace
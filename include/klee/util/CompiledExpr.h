@@ -0,0 +1,98 @@
+//===-- CompiledExpr.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_UTIL_COMPILEDEXPR_H
+#define KLEE_UTIL_COMPILEDEXPR_H
+
+#include "klee/Expr.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace klee {
+  class Array;
+  class Assignment;
+
+  /// CompiledExpr - An expression compiled to a flat program over the values
+  /// of its nodes, of at most 64 bits, such that it is evaluated under an
+  /// assignment without visiting its nodes or building constant expressions.
+  ///
+  /// The program has an instruction per distinct node, the operands of which
+  /// come first, and the value of each instruction is held in the register
+  /// of the same index. All the operands are evaluated, so that a division
+  /// by zero in the unselected value of a select leaves the value unknown,
+  /// where the interpreter of Assignment yields the selected one.
+  class CompiledExpr {
+  public:
+    enum Opcode {
+      Constant, Read, Select, Concat, Extract, ZExt, SExt, Not,
+      Add, Sub, Mul, UDiv, SDiv, URem, SRem, And, Or, Xor, Shl, LShr, AShr,
+      Eq, Ne, Ult, Ule, Ugt, Uge, Slt, Sle, Sgt, Sge
+    };
+
+  private:
+    struct Instruction {
+      Opcode opcode;
+      unsigned width;
+      /// The registers of the operands. A read has its index register, its
+      /// array and the number of its updates.
+      unsigned operands[3];
+      /// The value of a constant, the offset of an extract, or the first
+      /// update of a read
+      uint64_t value;
+    };
+
+    /// The registers of the index and value of an update
+    struct Update {
+      unsigned index;
+      unsigned value;
+    };
+
+    std::vector<Instruction> code;
+
+    /// The updates of the reads, the latest first
+    std::vector<Update> updates;
+
+    std::vector<const Array *> arrays;
+
+    /// The registers and the bindings of the arrays, kept between the
+    /// evaluations
+    mutable std::vector<uint64_t> registers;
+    mutable std::vector<const std::vector<unsigned char> *> bindings;
+
+    CompiledExpr() {}
+
+    class Compiler;
+
+  public:
+    /// The bound of the instructions and updates of a program
+    enum { MaxSize = 1 << 16 };
+
+    /// Compile the given expression. Returns null for the expressions with
+    /// nodes wider than 64 bits or of the kinds of Tracer-X, and for those
+    /// too large.
+    static CompiledExpr *compile(const ref<Expr> &e);
+
+    /// Evaluate the expression under the given assignment. Returns false
+    /// when its value is unknown, as for a division by zero or a byte left
+    /// free by the assignment.
+    bool evaluate(const Assignment &a, uint64_t &result) const;
+
+    /// Whether the boolean expression is known to be true under the given
+    /// assignment.
+    bool isTrue(const Assignment &a) const {
+      uint64_t result;
+      return evaluate(a, result) && result;
+    }
+
+    size_t size() const { return code.size(); }
+  };
+}
+
+#endif
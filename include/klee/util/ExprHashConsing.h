@@ -0,0 +1,50 @@
+//===-- ExprHashConsing.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRHASHCONSING_H
+#define KLEE_EXPRHASHCONSING_H
+
+#include "klee/Expr.h"
+#include "klee/util/ExprHashMap.h"
+
+namespace klee {
+
+  /// ExprHashConsing - A table of canonical expression nodes. Interning an
+  /// expression returns the node of the table that is structurally equal to
+  /// it, if any, so that equal expressions share a single node.
+  ///
+  /// When the children of an expression are themselves interned, finding its
+  /// canonical node only compares the contents and the child pointers of the
+  /// nodes, as Expr::compare returns at once on pointer equality. Expressions
+  /// built bottom-up from interned nodes hence never need a deep comparison,
+  /// and the canonical nodes are compared by pointer afterwards.
+  ///
+  /// The table keeps its nodes alive. The nodes that are no longer used
+  /// outside of the table are released whenever the table has doubled in
+  /// size since the last collection.
+  class ExprHashConsing {
+    ExprHashSet table;
+
+    /// collectThreshold - The table size that triggers the next collection.
+    size_t collectThreshold;
+
+  public:
+    ExprHashConsing();
+
+    /// intern - Return the canonical node of the given expression.
+    ref<Expr> intern(const ref<Expr> &e);
+
+    /// collect - Release the nodes that are only referenced by the table.
+    void collect();
+
+    size_t size() const { return table.size(); }
+  };
+}
+
+#endif
@@ -29,7 +29,7 @@ namespace klee {
 
   namespace util {
     struct ExprHash  {
-      unsigned operator()(const ref<Expr> e) const {
+      size_t operator()(const ref<Expr> e) const {
         return e->hash();
       }
     };
@@ -16,6 +16,7 @@
 #include <map>
 #include <klee/Constraints.h>
 #include <klee/Expr.h>
+#include <klee/util/ExprHashMap.h>
 #include <klee/util/PrintContext.h>
 #include <klee/Solver.h>
 
@@ -113,7 +114,8 @@ public:
   enum AbbreviationMode {
     ABBR_NONE, ///< Do not abbreviate.
     ABBR_LET,  ///< Abbreviate with let.
-    ABBR_NAMED ///< Abbreviate with :named annotations.
+    ABBR_NAMED, ///< Abbreviate with :named annotations.
+    ABBR_DEFINE_FUN ///< Abbreviate with define-fun commands.
   };
 
   /// Different supported SMTLIBv2 sorts (a.k.a type) in QF_AUFBV
@@ -214,7 +216,7 @@ protected:
   std::set<const Array *> usedArrays;
 
   /// Set of expressions seen during scan.
-  std::set<ref<Expr> > seenExprs;
+  ExprHashSet seenExprs;
 
   typedef std::map<const ref<Expr>, int> BindingMap;
 
@@ -228,6 +230,17 @@ protected:
   /// Exprs in orderedBindings[0] have no dependencies.
   std::vector<BindingMap> orderedBindings;
 
+  /// Under the define-fun abbreviation mode, the number of occurrences of the
+  /// expressions and the update nodes in the query. Those occurring more than
+  /// once are defined by a define-fun command before their first use.
+  ExprHashMap<unsigned> references;
+  std::map<const UpdateNode *, unsigned> updateReferences;
+
+  /// The numbers of the defined expressions and update nodes, printed as
+  /// ?B<n> and ?U<n>
+  ExprHashMap<unsigned> definitions;
+  std::map<const UpdateNode *, unsigned> updateDefinitions;
+
   /// Output stream to write to
   llvm::raw_ostream *o;
 
@@ -268,6 +281,21 @@ protected:
 
   void printQueryInSingleAssert();
 
+  /// Print each constraint and the query in its own assert, after the
+  /// define-fun commands of the shared expressions and update nodes that they
+  /// use.
+  void printQueryWithDefinitions();
+
+  /// Count the occurrences of the expression and, on its first occurrence,
+  /// of its sub-expressions.
+  void countReferences(const ref<Expr> &e);
+  void countUpdateReferences(const UpdateNode *un);
+
+  /// Print the define-fun commands of the shared sub-expressions of the
+  /// expression that are not yet defined, each after those it uses.
+  void printDefinitions(const ref<Expr> &e);
+  void printUpdateDefinitions(const UpdateNode *un, const Array *root);
+
   /// Print the SMTLIBv2 command to check satisfiability and also optionally
   /// request for values
   /// \sa setArrayValuesToGet()
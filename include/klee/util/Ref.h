@@ -10,6 +10,8 @@
 #ifndef KLEE_REF_H
 #define KLEE_REF_H
 
+#include "klee/Config/config.h"
+
 #include "llvm/Support/Casting.h"
 using llvm::isa;
 using llvm::cast;
@@ -26,6 +28,52 @@ namespace llvm {
 
 namespace klee {
 
+#ifdef KLEE_THREAD_SAFE_REFCOUNT
+/// RefCount - The reference count of the objects held by ref<T>, updated
+/// atomically such that the objects can be shared between threads. The
+/// increments need no ordering, as a thread can only copy a reference it
+/// already holds; the decrement that releases the object synchronizes with
+/// the other decrements, such that the deletion sees all the uses of the
+/// object.
+class RefCount {
+  unsigned count;
+
+public:
+  RefCount(unsigned _count = 0) : count(_count) {}
+
+  RefCount(const RefCount &b) : count(b) {}
+
+  RefCount &operator=(unsigned _count) {
+    __atomic_store_n(&count, _count, __ATOMIC_RELAXED);
+    return *this;
+  }
+
+  operator unsigned() const {
+    return __atomic_load_n(&count, __ATOMIC_RELAXED);
+  }
+
+  unsigned operator++() {
+    return __atomic_add_fetch(&count, 1, __ATOMIC_RELAXED);
+  }
+
+  unsigned operator--() {
+    return __atomic_sub_fetch(&count, 1, __ATOMIC_ACQ_REL);
+  }
+
+  unsigned operator++(int) {
+    return __atomic_fetch_add(&count, 1, __ATOMIC_RELAXED);
+  }
+
+  unsigned operator--(int) {
+    return __atomic_fetch_sub(&count, 1, __ATOMIC_ACQ_REL);
+  }
+};
+#else
+/// RefCount - The reference count of the objects held by ref<T>. Configure
+/// with --enable-thread-safe-refcount to share the objects between threads.
+typedef unsigned RefCount;
+#endif
+
 template<class T>
 class ref {
   T *ptr;
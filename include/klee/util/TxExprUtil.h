@@ -15,10 +15,71 @@
 #ifndef KLEE_TXEXPRUTIL_H
 #define KLEE_TXEXPRUTIL_H
 
+#include "klee/util/ExprHashMap.h"
 #include "klee/util/ExprVisitor.h"
 
 namespace klee {
 
+/// \brief Memoized rewriting of expression DAGs
+///
+/// A derived class implements rewriteNode, which computes the rewriting of a
+/// node, calling rewrite on the kids it recurses into. The result of every
+/// node is cached for as long as the rewriter lives, so that a subexpression
+/// shared by many parents is rewritten only once. A rewriter object is meant
+/// to be used for a single rewriting, as the cache keeps all rewritten nodes
+/// alive.
+class TxExprRewriter {
+  ExprHashMap<ref<Expr> > cache;
+
+protected:
+  /// \brief Compute the rewriting of a node not yet in the cache
+  virtual ref<Expr> rewriteNode(const ref<Expr> &e) = 0;
+
+public:
+  virtual ~TxExprRewriter() {}
+
+  /// \brief Return the rewriting of an expression, computing it only when the
+  /// expression has not been rewritten before
+  ref<Expr> rewrite(const ref<Expr> &e) {
+    ExprHashMap<ref<Expr> >::iterator it = cache.find(e);
+    if (it != cache.end())
+      return it->second;
+
+    ref<Expr> ret = rewriteNode(e);
+    cache.insert(std::make_pair(e, ret));
+    return ret;
+  }
+};
+
+/// \brief Memoized traversal of expression DAGs
+///
+/// A derived class implements foldNode, which accumulates the information of
+/// a node into the state of the derived class, calling fold on the kids it
+/// recurses into. Every distinct subexpression is folded only once, which is
+/// sound for folds whose result does not depend on the number of occurrences
+/// of a subexpression, such as the collection of its variables.
+class TxExprFolder {
+  ExprHashSet visited;
+
+protected:
+  /// \brief Fold a node not yet visited
+  ///
+  /// \return false to stop the traversal, true otherwise.
+  virtual bool foldNode(const ref<Expr> &e) = 0;
+
+public:
+  virtual ~TxExprFolder() {}
+
+  /// \brief Fold an expression, unless it has been folded before
+  ///
+  /// \return false when the traversal has been stopped, true otherwise.
+  bool fold(const ref<Expr> &e) {
+    if (!visited.insert(e).second)
+      return true;
+    return foldNode(e);
+  }
+};
+
 /// \brief General substitution mechanism
 class TxSubstitutionVisitor : public ExprVisitor {
 private:
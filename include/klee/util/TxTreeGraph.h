@@ -21,6 +21,7 @@
 
 #include "llvm/Support/raw_ostream.h"
 
+#include <fstream>
 #include <map>
 
 namespace klee {
@@ -145,6 +146,34 @@ private:
 
   uint64_t internalNodeId;
 
+  /// \brief A node of the tree in the event stream
+  struct StreamNode {
+    /// \brief The id of the node in the event records
+    uint64_t id;
+
+    /// \brief Indicates that the visit of the node was recorded
+    bool visited;
+
+    StreamNode() : id(0), visited(false) {}
+  };
+
+  /// \brief The event stream of -output-tree-stream, or null
+  static std::ofstream *eventStream;
+
+  /// \brief The nodes of the tree in the event stream, removed with them
+  static std::map<TxTreeNode *, StreamNode> streamNodes;
+
+  /// \brief The ids of the nodes of the table entries in the event stream
+  static std::map<TxSubsumptionTableEntry *, uint64_t> streamEntries;
+
+  static uint64_t streamNodeCount;
+
+  static uint64_t getStreamNodeId(TxTreeNode *txTreeNode);
+
+  /// \brief Write a string as the last field of an event record, escaping
+  /// backslashes and newlines
+  static void writeStreamString(const std::string &s);
+
   std::string recurseRender(TxTreeGraph::Node *node);
 
   std::string render();
@@ -190,6 +219,8 @@ public:
   static void addTableEntryMapping(TxTreeNode *txTreeNode,
                                    TxSubsumptionTableEntry *entry);
 
+  static void removeTableEntryMapping(TxSubsumptionTableEntry *entry);
+
   static void setAsCore(TxPCConstraint *pathCondition);
 
   static void setError(const ExecutionState &state,
@@ -197,6 +228,23 @@ public:
 
   /// \brief Save the graph
   static void save(std::string dotFileName);
+
+  /// \brief Start writing the events of the tree into a file as they happen,
+  /// with -output-tree-stream.
+  ///
+  /// Unlike the graph saved by TxTreeGraph::save, which mirrors the whole tree
+  /// in memory until the end of the run, the stream only keeps the ids of the
+  /// live nodes and table entries. Each event is a line starting with a
+  /// letter: R (root), S (split), V (visit), M (mark), C (path condition), I
+  /// (path condition in interpolant), T (table entry), U (table entry
+  /// removal), B (subsumption), E (error) or X (node removal). The
+  /// tx-tree-convert tool converts the stream into a .dot file offline.
+  static void openEventStream(const std::string &fileName, TxTreeNode *root);
+
+  static void closeEventStream();
+
+  /// \brief Record the removal of a node from the tree
+  static void removeNode(TxTreeNode *txTreeNode);
 };
 }
 
@@ -28,10 +28,27 @@ llvm::cl::opt<bool>
 UseCache("use-cache", llvm::cl::init(true),
          llvm::cl::desc("Use validity caching (default=on)"));
 
+llvm::cl::opt<std::string> SolverCacheFile(
+    "solver-cache-file", llvm::cl::init(""),
+    llvm::cl::value_desc("path"),
+    llvm::cl::desc("Cache the results of the solver queries in the given "
+                   "file, shared across runs (default=off)"));
+
+llvm::cl::opt<unsigned> SolverCacheSize(
+    "solver-cache-size", llvm::cl::init(256), llvm::cl::value_desc("MB"),
+    llvm::cl::desc("Compact the solver cache file when it exceeds this size "
+                   "at startup, keeping its most recently used entries, or 0 "
+                   "for no limit (default=256)"));
+
 llvm::cl::opt<bool> UseIndependentSolver(
     "use-independent-solver", llvm::cl::init(true),
     llvm::cl::desc("Use constraint independence (default=on)"));
 
+llvm::cl::opt<bool> SliceConstantArrays(
+    "slice-constant-arrays", llvm::cl::init(false),
+    llvm::cl::desc("Restrict the symbolic reads of constant arrays to the "
+                   "indices feasible under the constraints (default=off)"));
+
 llvm::cl::opt<bool> DebugValidateSolver("debug-validate-solver",
                                         llvm::cl::init(false));
 
@@ -79,6 +96,10 @@ llvm::cl::list<QueryLoggingSolverType> queryLoggingOptions(
         clEnumValN(
             SOLVER_SMTLIB, "solver:smt2",
             "All queries reaching the solver in .smt2 (SMT-LIBv2) format"),
+        clEnumValN(ALL_BINARY, "all:bin",
+                   "All queries in the binary .kqb format"),
+        clEnumValN(SOLVER_BINARY, "solver:bin",
+                   "All queries reaching the solver in the binary .kqb format"),
         clEnumValEnd),
     llvm::cl::CommaSeparated);
 
@@ -90,6 +111,20 @@ llvm::cl::opt<bool> NoInterpolation(
                    "Interpolation is enabled by default when Z3 was the solver "
                    "used. This option has no effect when Z3 was not used."));
 
+llvm::cl::opt<bool> PinWorkers(
+    "pin-workers",
+    llvm::cl::desc("Pin each forked worker process, the speculation workers "
+                   "of klee and the batch jobs of kleaver, to a CPU of its "
+                   "own, spreading the workers over the NUMA nodes "
+                   "(default=off)."));
+
+llvm::cl::opt<bool> ConcreteReplay(
+    "concrete-replay",
+    llvm::cl::desc("Replay the tests of -replay-ktest-file and "
+                   "-replay-ktest-dir concretely: without interpolation, and "
+                   "without a solver, terminating early any state which "
+                   "would need to query one (default=off)."));
+
 #ifdef ENABLE_Z3
 llvm::cl::opt<bool> OutputTree(
     "output-tree",
@@ -97,6 +132,14 @@ llvm::cl::opt<bool> OutputTree(
                    "format. At present, this feature is only available when "
                    "Z3 is compiled in and interpolation is enabled."));
 
+llvm::cl::opt<bool> OutputTreeStream(
+    "output-tree-stream",
+    llvm::cl::desc("Write the events of the execution tree into tree.events "
+                   "as they happen, without keeping the tree in memory. Use "
+                   "tx-tree-convert to produce a .dot file from it. This is "
+                   "only available when Z3 is compiled in and interpolation "
+                   "is enabled."));
+
 llvm::cl::opt<bool>
 SubsumedTest("subsumed-test",
              llvm::cl::desc("Enables generation of test cases for subsumed "
@@ -127,6 +170,80 @@ llvm::cl::opt<int> MaxFailSubsumption(
                    "value, the oldest entry will be deleted (default=0 (off))"),
     llvm::cl::init(0));
 
+llvm::cl::opt<unsigned> MaxSubsumptionTableEntries(
+    "max-subsumption-table-entries",
+    llvm::cl::desc("When the subsumption tables of all program points hold "
+                   "more than the given number of entries together, evict the "
+                   "entries that subsumed the fewest states for the time "
+                   "spent checking them (default=0 (off))."),
+    llvm::cl::init(0));
+
+llvm::cl::opt<bool> MergeSubsumptionEntries(
+    "merge-subsumption-entries",
+    llvm::cl::desc("Merge a new subsumption table entry with the latest "
+                   "entries of the same program point and call history that "
+                   "only differ from it by their interpolants, keeping the "
+                   "more general one or their disjunction (default=off)."),
+    llvm::cl::init(false));
+
+llvm::cl::opt<bool> EliminateRedundantEntries(
+    "eliminate-redundant-entries",
+    llvm::cl::desc("Do not store a new subsumption table entry that an entry "
+                   "of the same program point and call history already "
+                   "generalizes, and remove the entries that the new entry "
+                   "generalizes (default=off)."),
+    llvm::cl::init(false));
+
+llvm::cl::opt<unsigned> RedundantEntrySolverChecks(
+    "redundant-entry-solver-checks",
+    llvm::cl::desc("With -eliminate-redundant-entries, the number of solver "
+                   "calls allowed per new entry to decide the implication of "
+                   "interpolants that are not implied syntactically "
+                   "(default=0)."),
+    llvm::cl::init(0));
+
+llvm::cl::opt<bool> LoopWidening(
+    "loop-widening",
+    llvm::cl::desc("Widen a new subsumption table entry at a loop header with "
+                   "the entries of the same program point and call history "
+                   "that only differ from it by the constant value of one "
+                   "memory location, such as an induction variable, into an "
+                   "entry for the range of these values (default=off)."),
+    llvm::cl::init(false));
+
+llvm::cl::opt<bool> FunctionSummaries(
+    "function-summaries",
+    llvm::cl::desc("Also check the states against the subsumption table "
+                   "entries of their program points made in other call "
+                   "histories, for the entries whose paths never returned "
+                   "from their functions and that have no stores "
+                   "(default=off)."),
+    llvm::cl::init(false));
+
+llvm::cl::opt<unsigned> AdaptiveInterpolationWarmup(
+    "adaptive-interpolation-warmup",
+    llvm::cl::desc("After the given number of subsumption checks of the "
+                   "states of a function, stop checking and tabling the "
+                   "nodes of the function while its checks succeed less "
+                   "often than -adaptive-interpolation-threshold "
+                   "(default=0 (off))."),
+    llvm::cl::init(0));
+
+llvm::cl::opt<double> AdaptiveInterpolationThreshold(
+    "adaptive-interpolation-threshold",
+    llvm::cl::desc("The ratio of successful subsumption checks below which "
+                   "-adaptive-interpolation-warmup disables a function "
+                   "(default=0.01)."),
+    llvm::cl::init(0.01));
+
+llvm::cl::opt<unsigned> AdaptiveInterpolationResample(
+    "adaptive-interpolation-resample",
+    llvm::cl::desc("Enable a function disabled by "
+                   "-adaptive-interpolation-warmup again, for a new warm-up, "
+                   "after it skipped the given number of nodes "
+                   "(default=10000, 0 never)."),
+    llvm::cl::init(10000));
+
 llvm::cl::opt<int>
 DebugState("debug-state",
            llvm::cl::desc("Dump information on symbolic execution state when "
@@ -197,23 +314,115 @@ llvm::cl::opt<SpecStrategy> SpecStrategyToUse(
 llvm::cl::opt<std::string> DependencyFolder(
     "spec-dependency",
     llvm::cl::desc(
-        "Path to a folder containing basic blocks' dependency."
-        "One file for each BB with name format: \"BB_Dep_{order}.txt\""
+        "Path to a folder containing basic blocks' dependency. "
+        "One file for each BB with name format: \"SpecAvoid_{order}\". "
         "An initial file containing visited BBs with name "
-        "\"InitialVisitedBB.txt\""
-        "also must be put in this folder"),
+        "\"InitialVisitedBB.txt\" "
+        "also must be put in this folder. When not given, the dependency "
+        "is computed by a static analysis of the module."),
     llvm::cl::init("."));
 
+llvm::cl::opt<std::string> SpecDependencyCache(
+    "spec-dependency-cache",
+    llvm::cl::desc("Directory where the basic blocks' dependency computed "
+                   "for speculation is cached, keyed by the hash of the "
+                   "module (default=none)."),
+    llvm::cl::init(""));
+
 llvm::cl::opt<bool>
 WPInterpolant("wp-interpolant",
               llvm::cl::desc("Perform weakest-precondition interpolation"),
               llvm::cl::init(false));
 
+llvm::cl::opt<unsigned> DeferWPInterpolant(
+    "defer-wp-interpolant",
+    llvm::cl::desc("Keep up to the given number of removed nodes whose "
+                   "weakest-precondition interpolants are computed later, "
+                   "when a subsumption check first needs their table entries "
+                   "or when more nodes are removed (default=0 (off))."),
+    llvm::cl::init(0));
+
+llvm::cl::opt<bool> SkipPendingWPEntries(
+    "skip-pending-wp-entries",
+    llvm::cl::desc("With -defer-wp-interpolant, do not use the table entries "
+                   "whose weakest-precondition interpolants are not computed "
+                   "yet in subsumption checks, instead of computing them "
+                   "(default=off)."),
+    llvm::cl::init(false));
+
 llvm::cl::opt<bool>
 MarkGlobal("mark-global",
            llvm::cl::desc("Decide whether global variables are marked or not"),
            llvm::cl::init(true));
 
+llvm::cl::opt<bool> SubsumptionQueryCache(
+    "subsumption-query-cache",
+    llvm::cl::desc("Cache the results of existentially-quantified subsumption "
+                   "check queries, which are not cached by the solver chain "
+                   "(default=on)."),
+    llvm::cl::init(true));
+
+llvm::cl::opt<bool> SubsumptionModelCheck(
+    "subsumption-model-check",
+    llvm::cl::desc("Reject a subsumption check without calling the solver "
+                   "when a model of the path condition falsifies the query "
+                   "(default=on)."),
+    llvm::cl::init(true));
+
+llvm::cl::opt<bool> SubsumptionPartitioning(
+    "subsumption-partitioning",
+    llvm::cl::desc("Decide a subsumption check query by the groups of its "
+                   "conjuncts that share no variables, stopping at the first "
+                   "invalid one (default=on)."),
+    llvm::cl::init(true));
+
+llvm::cl::opt<bool> ExistentialElimination(
+    "existential-elimination",
+    llvm::cl::desc("Eliminate the existentially-quantified variables of "
+                   "subsumption check queries by solving their equalities "
+                   "and combining their bounds, so that fewer queries are "
+                   "quantified (default=on)."),
+    llvm::cl::init(true));
+
+llvm::cl::opt<bool> SubsumptionProfile(
+    "subsumption-profile",
+    llvm::cl::desc("Write the subsumption checks of each program point, their "
+                   "outcomes and time into subsumption-profile.csv in the "
+                   "output directory (default=off)."),
+    llvm::cl::init(false));
+
+llvm::cl::opt<std::string> SubsumptionTableFile(
+    "subsumption-table-file",
+    llvm::cl::desc("Load the unconditional subsumption table entries from the "
+                   "given file at startup when it was saved for the same "
+                   "module, and save them into the file at exit."),
+    llvm::cl::init(""));
+
+llvm::cl::opt<double> SubsumptionTableSyncInterval(
+    "subsumption-table-sync-interval",
+    llvm::cl::desc("Periodically merge the entries of the subsumption table "
+                   "file into the table and save the table back into the "
+                   "file, at the given interval in seconds. This shares "
+                   "subsumption results among processes exploring the same "
+                   "module (default=0 (off))."),
+    llvm::cl::init(0));
+
+llvm::cl::opt<bool> HashConsShadowExpressions(
+    "hash-cons-shadow-expressions",
+    llvm::cl::desc("Share the nodes of structurally-equal shadow expressions "
+                   "of the interpolants, so that they are compared by pointer "
+                   "in the subsumption checks and the solver caches "
+                   "(default=on)."),
+    llvm::cl::init(true));
+
+llvm::cl::opt<bool> DependencySlicing(
+    "dependency-slicing",
+    llvm::cl::desc("Do not build the dependency of the instructions whose "
+                   "values cannot reach a branch condition, a memory access, "
+                   "a call or a return, as computed when the module is "
+                   "loaded. Ignored with -wp-interpolant (default=on)."),
+    llvm::cl::init(true));
+
 #endif // ENABLE_Z3
 
 #ifdef ENABLE_METASMT
@@ -288,6 +497,19 @@ llvm::cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith(
                                 "Do not cross check (default)"),
                      clEnumValEnd),
     llvm::cl::init(NO_SOLVER));
+
+llvm::cl::opt<CoreSolverType> PortfolioCoreSolverWith(
+    "portfolio-core-solver",
+    llvm::cl::desc("Specify a solver to race against the core solver on each "
+                   "query in forked processes, taking the first answer. "
+                   "Unsatisfiability cores are taken from the core solver."),
+    llvm::cl::values(clEnumValN(STP_SOLVER, "stp", "stp"),
+                     clEnumValN(METASMT_SOLVER, "metasmt", "metaSMT"),
+                     clEnumValN(Z3_SOLVER, "z3", "Z3"),
+                     clEnumValN(NO_SOLVER, "none",
+                                "Use the core solver alone (default)"),
+                     clEnumValEnd),
+    llvm::cl::init(NO_SOLVER));
 }
 #undef STP_IS_DEFAULT_STR
 #undef METASMT_IS_DEFAULT_STR
@@ -19,9 +19,15 @@ namespace klee {
 Solver *constructSolverChain(Solver *coreSolver, std::string querySMT2LogPath,
                              std::string baseSolverQuerySMT2LogPath,
                              std::string queryPCLogPath,
-                             std::string baseSolverQueryPCLogPath) {
+                             std::string baseSolverQueryPCLogPath,
+                             std::string queryBinaryLogPath,
+                             std::string baseSolverQueryBinaryLogPath) {
   Solver *solver = coreSolver;
 
+  if (!SolverCacheFile.empty())
+    solver = createPersistentCachingSolver(solver, SolverCacheFile,
+                                           SolverCacheSize);
+
   if (optionIsSet(queryLoggingOptions, SOLVER_PC)) {
     solver = createPCLoggingSolver(solver, baseSolverQueryPCLogPath,
                                    MinQueryTimeToLog);
@@ -36,6 +42,16 @@ Solver *constructSolverChain(Solver *coreSolver, std::string querySMT2LogPath,
                  baseSolverQuerySMT2LogPath.c_str());
   }
 
+  if (optionIsSet(queryLoggingOptions, SOLVER_BINARY)) {
+    solver = createBinaryLoggingSolver(solver, baseSolverQueryBinaryLogPath,
+                                       MinQueryTimeToLog);
+    klee_message("Logging queries that reach solver in .kqb format to %s\n",
+                 baseSolverQueryBinaryLogPath.c_str());
+  }
+
+  if (SliceConstantArrays)
+    solver = createArraySlicingSolver(solver);
+
   if (UseFastCexSolver)
     solver = createFastCexSolver(solver);
 
@@ -63,6 +79,13 @@ Solver *constructSolverChain(Solver *coreSolver, std::string querySMT2LogPath,
     klee_message("Logging all queries in .smt2 format to %s\n",
                  querySMT2LogPath.c_str());
   }
+
+  if (optionIsSet(queryLoggingOptions, ALL_BINARY)) {
+    solver = createBinaryLoggingSolver(solver, queryBinaryLogPath,
+                                       MinQueryTimeToLog);
+    klee_message("Logging all queries in .kqb format to %s\n",
+                 queryBinaryLogPath.c_str());
+  }
   if (DebugCrossCheckCoreSolverWith != NO_SOLVER) {
     Solver *oracleSolver = createCoreSolver(DebugCrossCheckCoreSolverWith);
     solver = createValidatingSolver(/*s=*/solver, /*oracle=*/oracleSolver);
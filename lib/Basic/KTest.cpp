@@ -91,13 +91,10 @@ int kTest_isKTestFile(const char *path) {
   return res;
 }
 
-KTest *kTest_fromFile(const char *path) {
-  FILE *f = fopen(path, "rb");
+static KTest *kTest_fromStream(FILE *f) {
   KTest *res = 0;
   unsigned i, version;
 
-  if (!f) 
-    goto error;
   if (!kTest_checkHeader(f)) 
     goto error;
 
@@ -146,8 +143,6 @@ KTest *kTest_fromFile(const char *path) {
       goto error;
   }
 
-  fclose(f);
-
   return res;
  error:
   if (res) {
@@ -170,17 +165,36 @@ KTest *kTest_fromFile(const char *path) {
     free(res);
   }
 
-  if (f) fclose(f);
-
   return 0;
 }
 
-int kTest_toFile(KTest *bo, const char *path) {
-  FILE *f = fopen(path, "wb");
+KTest *kTest_fromFile(const char *path) {
+  FILE *f = fopen(path, "rb");
+  KTest *res;
+
+  if (!f)
+    return 0;
+  res = kTest_fromStream(f);
+  fclose(f);
+
+  return res;
+}
+
+KTest *kTest_fromBuffer(const unsigned char *buffer, unsigned size) {
+  FILE *f = fmemopen((void*) buffer, size, "rb");
+  KTest *res;
+
+  if (!f)
+    return 0;
+  res = kTest_fromStream(f);
+  fclose(f);
+
+  return res;
+}
+
+static int kTest_toStream(KTest *bo, FILE *f) {
   unsigned i;
 
-  if (!f) 
-    goto error;
   if (fwrite(KTEST_MAGIC, strlen(KTEST_MAGIC), 1, f)!=1)
     goto error;
   if (!write_uint32(f, KTEST_VERSION))
@@ -210,15 +224,44 @@ int kTest_toFile(KTest *bo, const char *path) {
       goto error;
   }
 
-  fclose(f);
-
   return 1;
  error:
-  if (f) fclose(f);
-  
   return 0;
 }
 
+int kTest_toFile(KTest *bo, const char *path) {
+  FILE *f = fopen(path, "wb");
+  int res;
+
+  if (!f)
+    return 0;
+  res = kTest_toStream(bo, f);
+  if (fclose(f))
+    res = 0;
+
+  return res;
+}
+
+unsigned char *kTest_toBuffer(KTest *bo, unsigned *size_out) {
+  char *buffer = 0;
+  size_t size = 0;
+  FILE *f = open_memstream(&buffer, &size);
+  int res;
+
+  if (!f)
+    return 0;
+  res = kTest_toStream(bo, f);
+  if (fclose(f))
+    res = 0;
+  if (!res) {
+    free(buffer);
+    return 0;
+  }
+
+  *size_out = size;
+  return (unsigned char*) buffer;
+}
+
 unsigned kTest_numBytes(KTest *bo) {
   unsigned i, res = 0;
   for (i=0; i<bo->numObjects; i++)
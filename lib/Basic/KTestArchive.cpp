@@ -0,0 +1,292 @@
+//===-- KTestArchive.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/ADT/KTest.h"
+#include "klee/Config/config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
+
+#define KTAR_VERSION 1
+#define KTAR_MAGIC_SIZE 4
+#define KTAR_MAGIC "KTAR"
+#define KTAR_HEADER_SIZE (KTAR_MAGIC_SIZE + 4)
+#define KTAR_RECORD_HEADER_SIZE 16
+
+// record flags
+#define KTAR_COMPRESSED 1
+
+// The archive is mapped in memory, and its tests are decoded from the
+// mapping on demand, so that opening an archive of many tests reads their
+// record headers only.
+struct KTestArchive {
+  const unsigned char *data;
+  size_t size;
+  unsigned numTests;
+  unsigned *ids;
+  unsigned *flags;
+  unsigned *storedSizes;
+  unsigned *sizes;
+  long *offsets;
+};
+
+/***/
+
+static unsigned get_uint32(const unsigned char *data) {
+  return (((((data[0]<<8) + data[1])<<8) + data[2])<<8) + data[3];
+}
+
+static void put_uint32(unsigned char *data, unsigned value) {
+  data[0] = value>>24;
+  data[1] = value>>16;
+  data[2] = value>> 8;
+  data[3] = value>> 0;
+}
+
+static int write_fully(int fd, const unsigned char *data, size_t size) {
+  while (size) {
+    ssize_t res = write(fd, data, size);
+    if (res < 0) {
+      if (errno == EINTR)
+        continue;
+      return 0;
+    }
+    data += res;
+    size -= res;
+  }
+  return 1;
+}
+
+static int kTest_checkArchiveHeader(FILE *f) {
+  unsigned char header[KTAR_HEADER_SIZE];
+  if (fread(header, KTAR_HEADER_SIZE, 1, f)!=1)
+    return 0;
+  if (memcmp(header, KTAR_MAGIC, KTAR_MAGIC_SIZE))
+    return 0;
+  if (get_uint32(header + KTAR_MAGIC_SIZE) > KTAR_VERSION)
+    return 0;
+  return 1;
+}
+
+/***/
+
+int kTest_isKTestArchive(const char *path) {
+  FILE *f = fopen(path, "rb");
+  int res;
+
+  if (!f)
+    return 0;
+  res = kTest_checkArchiveHeader(f);
+  fclose(f);
+
+  return res;
+}
+
+int kTest_appendToArchive(KTest *bo, const char *path, unsigned id,
+                          int compress) {
+  unsigned size, storedSize, flags = 0;
+  unsigned char *data = kTest_toBuffer(bo, &size);
+  unsigned char *record = 0;
+  struct flock lock;
+  struct stat st;
+  int fd = -1, res = 0;
+
+  if (!data)
+    return 0;
+
+  record = (unsigned char*) malloc(KTAR_HEADER_SIZE + KTAR_RECORD_HEADER_SIZE +
+                                   size + size / 1000 + 64);
+  if (!record)
+    goto error;
+
+  storedSize = size;
+#ifdef HAVE_ZLIB_H
+  if (compress) {
+    uLongf compressedSize = size + size / 1000 + 64;
+    if (compress2(record + KTAR_HEADER_SIZE + KTAR_RECORD_HEADER_SIZE,
+                  &compressedSize, data, size, Z_DEFAULT_COMPRESSION) == Z_OK &&
+        compressedSize < size) {
+      storedSize = compressedSize;
+      flags |= KTAR_COMPRESSED;
+    }
+  }
+#else
+  (void) compress;
+#endif
+  if (!(flags & KTAR_COMPRESSED))
+    memcpy(record + KTAR_HEADER_SIZE + KTAR_RECORD_HEADER_SIZE, data, size);
+
+  fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0666);
+  if (fd < 0)
+    goto error;
+
+  // Writers in other processes append to the same archive
+  memset(&lock, 0, sizeof(lock));
+  lock.l_type = F_WRLCK;
+  lock.l_whence = SEEK_SET;
+  while (fcntl(fd, F_SETLKW, &lock) < 0)
+    if (errno != EINTR)
+      goto error;
+
+  if (fstat(fd, &st) < 0)
+    goto error;
+
+  {
+    // Write the record, preceded by the archive header for a new archive,
+    // with a single write so that readers never see a partial header.
+    unsigned char *start = record + KTAR_HEADER_SIZE;
+    put_uint32(start, id);
+    put_uint32(start + 4, flags);
+    put_uint32(start + 8, storedSize);
+    put_uint32(start + 12, size);
+    if (st.st_size == 0) {
+      start = record;
+      memcpy(start, KTAR_MAGIC, KTAR_MAGIC_SIZE);
+      put_uint32(start + KTAR_MAGIC_SIZE, KTAR_VERSION);
+    }
+    res = write_fully(fd, start,
+                      record + KTAR_HEADER_SIZE + KTAR_RECORD_HEADER_SIZE +
+                          storedSize - start);
+  }
+
+ error:
+  if (fd >= 0 && close(fd))
+    res = 0;
+  free(record);
+  free(data);
+
+  return res;
+}
+
+KTestArchive *kTest_openArchive(const char *path) {
+  KTestArchive *res = 0;
+  unsigned capacity = 0;
+  size_t offset = KTAR_HEADER_SIZE;
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0)
+    return 0;
+  if (fstat(fd, &st) < 0 || (size_t) st.st_size < KTAR_HEADER_SIZE)
+    goto error;
+
+  res = (KTestArchive*) calloc(1, sizeof(*res));
+  if (!res)
+    goto error;
+  res->data = (const unsigned char*) mmap(0, st.st_size, PROT_READ,
+                                          MAP_PRIVATE, fd, 0);
+  if (res->data == MAP_FAILED) {
+    res->data = 0;
+    goto error;
+  }
+  res->size = st.st_size;
+  if (memcmp(res->data, KTAR_MAGIC, KTAR_MAGIC_SIZE) ||
+      get_uint32(res->data + KTAR_MAGIC_SIZE) > KTAR_VERSION)
+    goto error;
+
+  while (offset + KTAR_RECORD_HEADER_SIZE <= res->size) {
+    const unsigned char *header = res->data + offset;
+    unsigned storedSize = get_uint32(header + 8);
+    if (res->size - offset - KTAR_RECORD_HEADER_SIZE < storedSize)
+      break; // truncated last record
+
+    if (res->numTests == capacity) {
+      capacity = capacity ? 2 * capacity : 64;
+      res->ids = (unsigned*) realloc(res->ids, capacity * sizeof(unsigned));
+      res->flags = (unsigned*) realloc(res->flags, capacity * sizeof(unsigned));
+      res->storedSizes =
+          (unsigned*) realloc(res->storedSizes, capacity * sizeof(unsigned));
+      res->sizes = (unsigned*) realloc(res->sizes, capacity * sizeof(unsigned));
+      res->offsets = (long*) realloc(res->offsets, capacity * sizeof(long));
+      if (!res->ids || !res->flags || !res->storedSizes || !res->sizes ||
+          !res->offsets)
+        goto error;
+    }
+    res->ids[res->numTests] = get_uint32(header);
+    res->flags[res->numTests] = get_uint32(header + 4);
+    res->storedSizes[res->numTests] = storedSize;
+    res->sizes[res->numTests] = get_uint32(header + 12);
+    res->offsets[res->numTests] = offset + KTAR_RECORD_HEADER_SIZE;
+    ++res->numTests;
+
+    offset += KTAR_RECORD_HEADER_SIZE + storedSize;
+  }
+
+  // The mapping outlives the descriptor
+  close(fd);
+  return res;
+ error:
+  if (res)
+    kTest_closeArchive(res);
+  close(fd);
+
+  return 0;
+}
+
+unsigned kTest_archiveNumTests(KTestArchive *ar) {
+  return ar->numTests;
+}
+
+unsigned kTest_archiveTestId(KTestArchive *ar, unsigned index) {
+  return ar->ids[index];
+}
+
+KTest *kTest_fromArchive(KTestArchive *ar, unsigned index) {
+  const unsigned char *stored;
+  unsigned storedSize, size;
+  unsigned char *data = 0;
+  KTest *res = 0;
+
+  if (index >= ar->numTests)
+    return 0;
+  stored = ar->data + ar->offsets[index];
+  storedSize = ar->storedSizes[index];
+  size = ar->sizes[index];
+
+  if (ar->flags[index] & KTAR_COMPRESSED) {
+#ifdef HAVE_ZLIB_H
+    uLongf uncompressedSize = size;
+    data = (unsigned char*) malloc(size ? size : 1);
+    if (!data)
+      goto error;
+    if (uncompress(data, &uncompressedSize, stored, storedSize) != Z_OK ||
+        uncompressedSize != size)
+      goto error;
+    res = kTest_fromBuffer(data, size);
+#endif
+  } else {
+    res = kTest_fromBuffer(stored, storedSize);
+  }
+
+ error:
+  free(data);
+
+  return res;
+}
+
+void kTest_closeArchive(KTestArchive *ar) {
+  if (ar->data)
+    munmap((void*) ar->data, ar->size);
+  free(ar->ids);
+  free(ar->flags);
+  free(ar->storedSizes);
+  free(ar->sizes);
+  free(ar->offsets);
+  free(ar);
+}
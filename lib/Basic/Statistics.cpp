@@ -9,6 +9,8 @@
 
 #include "klee/Statistics.h"
 
+#include <assert.h>
+#include <stdlib.h>
 #include <vector>
 
 using namespace klee;
@@ -17,29 +19,53 @@ StatisticManager::StatisticManager()
   : enabled(true),
     globalStats(0),
     indexedStats(0),
+    indexedStride(0),
     contextStats(0),
+    numContextStats(0),
     index(0) {
 }
 
 StatisticManager::~StatisticManager() {
   if (globalStats) delete[] globalStats;
-  if (indexedStats) delete[] indexedStats;
+  if (indexedStats) free(indexedStats);
 }
 
 void StatisticManager::useIndexedStats(unsigned totalIndices) {  
-  if (indexedStats) delete[] indexedStats;
-  indexedStats = new uint64_t[totalIndices * stats.size()];
-  memset(indexedStats, 0, sizeof(*indexedStats) * totalIndices * stats.size());
+  if (indexedStats) free(indexedStats);
+
+  // Round the rows up to whole cache lines
+  const unsigned countersPerLine = CacheLineSize / sizeof(*indexedStats);
+  indexedStride =
+      (stats.size() + countersPerLine - 1) / countersPerLine * countersPerLine;
+  size_t size = sizeof(*indexedStats) * totalIndices * indexedStride;
+  void *memory = 0;
+  if (posix_memalign(&memory, CacheLineSize, size ? size : CacheLineSize))
+    memory = 0;
+  assert(memory && "out of memory for the indexed statistics");
+  indexedStats = static_cast<uint64_t *>(memory);
+  memset(indexedStats, 0, size);
 }
 
 void StatisticManager::registerStatistic(Statistic &s) {
   if (globalStats) delete[] globalStats;
   s.id = stats.size();
   stats.push_back(&s);
+  contextSlots.push_back(numContextStats++);
   globalStats = new uint64_t[stats.size()];
   memset(globalStats, 0, sizeof(*globalStats)*stats.size());
 }
 
+void StatisticManager::setContextStatistics(
+    const std::vector<Statistic *> &selected) {
+  contextSlots.assign(stats.size(), -1);
+  numContextStats = 0;
+  for (std::vector<Statistic *>::const_iterator it = selected.begin(),
+                                                ie = selected.end();
+       it != ie; ++it)
+    if (contextSlots[(*it)->id] < 0)
+      contextSlots[(*it)->id] = numContextStats++;
+}
+
 int StatisticManager::getStatisticID(const std::string &name) const {
   for (unsigned i=0; i<stats.size(); i++)
     if (stats[i]->getName() == name)
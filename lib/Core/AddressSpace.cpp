@@ -15,18 +15,59 @@
 #include "klee/Expr.h"
 #include "klee/TimerStatIncrementer.h"
 
+#include "llvm/Support/CommandLine.h"
+
+#include <algorithm>
+
 using namespace klee;
 
+namespace {
+  llvm::cl::opt<bool>
+  ResolveByRange("resolve-by-range",
+                 llvm::cl::desc("Resolve symbolic pointers by first bounding "
+                                "them with interval arithmetic, and then "
+                                "bisecting the objects within the bounds "
+                                "with one query per group of objects "
+                                "(default=on)."),
+                 llvm::cl::init(true));
+
+  llvm::cl::opt<bool>
+  CopyInExposedOnly("copy-in-exposed-only",
+                    llvm::cl::desc("After an external call, only copy back "
+                                   "the objects reachable from the arguments "
+                                   "of an external call, and the fixed "
+                                   "objects (default=on)."),
+                    llvm::cl::init(true));
+}
+
 ///
 
+void AddressSpace::updateResolutionCache(const MemoryObject *mo,
+                                         const ObjectState *os) {
+  for (unsigned i = 0; i != ResolutionCacheSize; ++i) {
+    if (resolutionCache[i].first != mo)
+      continue;
+    if (os) {
+      resolutionCache[i].second = os;
+    } else {
+      std::copy(resolutionCache + i + 1,
+                resolutionCache + ResolutionCacheSize, resolutionCache + i);
+      resolutionCache[ResolutionCacheSize - 1] = ObjectPair(0, 0);
+    }
+    return;
+  }
+}
+
 void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
   assert(os->copyOnWriteOwner==0 && "object already has owner");
   os->copyOnWriteOwner = cowKey;
   objects = objects.replace(std::make_pair(mo, os));
+  updateResolutionCache(mo, os);
 }
 
 void AddressSpace::unbindObject(const MemoryObject *mo) {
   objects = objects.remove(mo);
+  updateResolutionCache(mo, 0);
 }
 
 const ObjectState *AddressSpace::findObject(const MemoryObject *mo) const {
@@ -45,6 +86,7 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
     ObjectState *n = new ObjectState(*os);
     n->copyOnWriteOwner = cowKey;
     objects = objects.replace(std::make_pair(mo, n));
+    updateResolutionCache(mo, n);
     return n;    
   }
 }
@@ -54,6 +96,21 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
 bool AddressSpace::resolveOne(const ref<ConstantExpr> &addr, 
                               ObjectPair &result) {
   uint64_t address = addr->getZExtValue();
+
+  for (unsigned i = 0; i != ResolutionCacheSize; ++i) {
+    const MemoryObject *mo = resolutionCache[i].first;
+    if (!mo)
+      break;
+    if (address - mo->address < mo->size) {
+      result = resolutionCache[i];
+      // Move the entry to the front
+      std::copy_backward(resolutionCache, resolutionCache + i,
+                         resolutionCache + i + 1);
+      resolutionCache[0] = result;
+      return true;
+    }
+  }
+
   MemoryObject hack(address);
 
   if (const MemoryMap::value_type *res = objects.lookup_previous(&hack)) {
@@ -63,6 +120,14 @@ bool AddressSpace::resolveOne(const ref<ConstantExpr> &addr,
     if ((mo->size==0 && address==mo->address) ||
         (address - mo->address < mo->size)) {
       result = *res;
+      // The 0-sized objects are not cached, as they may share their address
+      // with another object
+      if (mo->size == 0)
+        return true;
+      std::copy_backward(resolutionCache,
+                         resolutionCache + ResolutionCacheSize - 1,
+                         resolutionCache + ResolutionCacheSize);
+      resolutionCache[0] = result;
       return true;
     }
   }
@@ -160,6 +225,277 @@ bool AddressSpace::resolveOne(ExecutionState &state,
   }
 }
 
+/// Compute a sound unsigned range [min, max] of the values of an expression
+/// of width at most 64 by interval arithmetic on its structure.
+static void getUnsignedRange(const ref<Expr> &e, uint64_t &min,
+                             uint64_t &max) {
+  Expr::Width width = e->getWidth();
+  uint64_t widthMax = (width == 64) ? ~((uint64_t) 0)
+                                    : ((((uint64_t) 1) << width) - 1);
+  min = 0;
+  max = widthMax;
+
+  switch (e->getKind()) {
+  case Expr::Constant:
+    min = max = cast<ConstantExpr>(e)->getZExtValue();
+    return;
+
+  case Expr::ZExt:
+    if (e->getKid(0)->getWidth() <= 64)
+      getUnsignedRange(e->getKid(0), min, max);
+    return;
+
+  case Expr::SExt: {
+    // Only the nonnegative values are preserved
+    Expr::Width kidWidth = e->getKid(0)->getWidth();
+    uint64_t kidMin, kidMax;
+    getUnsignedRange(e->getKid(0), kidMin, kidMax);
+    if (kidMax < (((uint64_t) 1) << (kidWidth - 1))) {
+      min = kidMin;
+      max = kidMax;
+    }
+    return;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    if (ee->offset != 0 || ee->expr->getWidth() > 64)
+      return;
+    uint64_t kidMin, kidMax;
+    getUnsignedRange(ee->expr, kidMin, kidMax);
+    if (kidMax <= widthMax) {
+      min = kidMin;
+      max = kidMax;
+    }
+    return;
+  }
+
+  case Expr::Select: {
+    uint64_t min1, max1, min2, max2;
+    getUnsignedRange(e->getKid(1), min1, max1);
+    getUnsignedRange(e->getKid(2), min2, max2);
+    min = std::min(min1, min2);
+    max = std::max(max1, max2);
+    return;
+  }
+
+  case Expr::Add: {
+    uint64_t min1, max1, min2, max2;
+    getUnsignedRange(e->getKid(0), min1, max1);
+    getUnsignedRange(e->getKid(1), min2, max2);
+    if (max1 <= widthMax - max2) {
+      min = min1 + min2;
+      max = max1 + max2;
+    }
+    return;
+  }
+
+  case Expr::Mul: {
+    uint64_t min1, max1, min2, max2;
+    getUnsignedRange(e->getKid(0), min1, max1);
+    getUnsignedRange(e->getKid(1), min2, max2);
+    if (!max2 || max1 <= widthMax / max2) {
+      min = min1 * min2;
+      max = max1 * max2;
+    }
+    return;
+  }
+
+  case Expr::Shl:
+  case Expr::LShr:
+  case Expr::UDiv:
+  case Expr::URem: {
+    const ConstantExpr *ce = dyn_cast<ConstantExpr>(e->getKid(1));
+    if (!ce)
+      return;
+    uint64_t amount = ce->getZExtValue();
+    uint64_t kidMin, kidMax;
+    getUnsignedRange(e->getKid(0), kidMin, kidMax);
+    if (e->getKind() == Expr::Shl) {
+      if (amount < width && kidMax <= (widthMax >> amount)) {
+        min = kidMin << amount;
+        max = kidMax << amount;
+      }
+    } else if (e->getKind() == Expr::LShr) {
+      if (amount < width) {
+        min = kidMin >> amount;
+        max = kidMax >> amount;
+      }
+    } else if (e->getKind() == Expr::UDiv) {
+      if (amount) {
+        min = kidMin / amount;
+        max = kidMax / amount;
+      }
+    } else if (amount) {
+      max = std::min(kidMax, amount - 1);
+    }
+    return;
+  }
+
+  case Expr::And: {
+    uint64_t min1, max1, min2, max2;
+    getUnsignedRange(e->getKid(0), min1, max1);
+    getUnsignedRange(e->getKid(1), min2, max2);
+    max = std::min(max1, max2);
+    return;
+  }
+
+  default:
+    return;
+  }
+}
+
+namespace {
+  enum ResolutionStatus {
+    ResolutionContinue,
+    ResolutionComplete,
+    ResolutionIncomplete
+  };
+
+  /// A resolution of a symbolic pointer against the objects within its
+  /// range, which are sorted by address.
+  struct RangeResolution {
+    ExecutionState &state;
+    TimingSolver *solver;
+    ref<Expr> p;
+    ResolutionList &rl;
+    unsigned maxResolutions;
+    uint64_t timeout_us;
+    TimerStatIncrementer &timer;
+    const ResolutionList &candidates;
+
+    RangeResolution(ExecutionState &_state, TimingSolver *_solver,
+                    ref<Expr> _p, ResolutionList &_rl,
+                    unsigned _maxResolutions, uint64_t _timeout_us,
+                    TimerStatIncrementer &_timer,
+                    const ResolutionList &_candidates)
+      : state(_state), solver(_solver), p(_p), rl(_rl),
+        maxResolutions(_maxResolutions), timeout_us(_timeout_us),
+        timer(_timer), candidates(_candidates) {}
+
+    /// Add the candidate at the given index, which the pointer may point
+    /// to, to the resolutions.
+    ResolutionStatus add(unsigned index) {
+      const MemoryObject *mo = candidates[index].first;
+      rl.push_back(candidates[index]);
+
+      // fast path check
+      unsigned size = rl.size();
+      if (size==1) {
+        bool mustBeTrue;
+        if (!solver->mustBeTrue(state, mo->getBoundsCheckPointer(p),
+                                mustBeTrue))
+          return ResolutionIncomplete;
+        if (mustBeTrue)
+          return ResolutionComplete;
+      } else if (size==maxResolutions) {
+        return ResolutionIncomplete;
+      }
+      return ResolutionContinue;
+    }
+
+    /// Add the candidates in [begin, end) which the pointer may point to,
+    /// discarding groups of adjacent candidates with a single query on the
+    /// address range they span.
+    ResolutionStatus bisect(unsigned begin, unsigned end) {
+      if (begin == end)
+        return ResolutionContinue;
+      if (timeout_us && timeout_us < timer.check())
+        return ResolutionIncomplete;
+
+      ref<Expr> inBounds;
+      if (end - begin == 1) {
+        inBounds = candidates[begin].first->getBoundsCheckPointer(p);
+      } else {
+        const MemoryObject *first = candidates[begin].first;
+        const MemoryObject *last = candidates[end - 1].first;
+        uint64_t limit = last->address + std::max(last->size, 1U);
+        inBounds = AndExpr::create(
+            UgeExpr::create(p, first->getBaseExpr()),
+            UltExpr::create(p, ConstantExpr::create(limit, p->getWidth())));
+      }
+
+      bool mayBeTrue;
+      if (!solver->mayBeTrue(state, inBounds, mayBeTrue))
+        return ResolutionIncomplete;
+      if (!mayBeTrue)
+        return ResolutionContinue;
+      if (end - begin == 1)
+        return add(begin);
+
+      unsigned middle = begin + (end - begin) / 2;
+      ResolutionStatus status = bisect(begin, middle);
+      if (status != ResolutionContinue)
+        return status;
+      return bisect(middle, end);
+    }
+  };
+}
+
+/// Resolve a symbolic pointer by only considering the objects within its
+/// unsigned range. The object containing an example value of the pointer is
+/// resolved first, and the remaining objects are bisected.
+static bool resolveByRange(const MemoryMap &objects, ExecutionState &state,
+                           TimingSolver *solver, ref<Expr> p,
+                           ResolutionList &rl, unsigned maxResolutions,
+                           uint64_t timeout_us, TimerStatIncrementer &timer) {
+  uint64_t min, max;
+  getUnsignedRange(p, min, max);
+
+  ResolutionList candidates;
+  MemoryObject hack(min);
+  MemoryMap::iterator oi = objects.upper_bound(&hack);
+  if (oi != objects.begin()) {
+    MemoryMap::iterator previous = oi;
+    --previous;
+    const MemoryObject *mo = previous->first;
+    if (min - mo->address < std::max(mo->size, 1U))
+      candidates.push_back(*previous);
+  }
+  for (MemoryMap::iterator ie = objects.end();
+       oi != ie && oi->first->address <= max; ++oi)
+    candidates.push_back(*oi);
+
+  if (candidates.empty())
+    return false;
+
+  ref<ConstantExpr> cex;
+  if (!solver->getValue(state, p, cex))
+    return true;
+  uint64_t example = cex->getZExtValue();
+
+  // Find the candidate containing the example, which the pointer may point
+  // to without the need of a query
+  unsigned exampleIndex = candidates.size();
+  for (unsigned lo = 0, hi = candidates.size(); lo < hi;) {
+    unsigned mid = lo + (hi - lo) / 2;
+    const MemoryObject *mo = candidates[mid].first;
+    if (example < mo->address) {
+      hi = mid;
+    } else if ((mo->size==0 && example==mo->address) ||
+               (example - mo->address < mo->size)) {
+      exampleIndex = mid;
+      break;
+    } else {
+      lo = mid + 1;
+    }
+  }
+
+  RangeResolution resolution(state, solver, p, rl, maxResolutions, timeout_us,
+                             timer, candidates);
+  ResolutionStatus status = ResolutionContinue;
+  if (exampleIndex < candidates.size()) {
+    status = resolution.add(exampleIndex);
+    if (status == ResolutionContinue)
+      status = resolution.bisect(0, exampleIndex);
+    if (status == ResolutionContinue)
+      status = resolution.bisect(exampleIndex + 1, candidates.size());
+  } else {
+    status = resolution.bisect(0, candidates.size());
+  }
+  return status == ResolutionIncomplete;
+}
+
 bool AddressSpace::resolve(ExecutionState &state,
                            TimingSolver *solver, 
                            ref<Expr> p, 
@@ -175,6 +511,10 @@ bool AddressSpace::resolve(ExecutionState &state,
     TimerStatIncrementer timer(stats::resolveTime);
     uint64_t timeout_us = (uint64_t) (timeout*1000000.);
 
+    if (ResolveByRange && p->getWidth() <= 64)
+      return resolveByRange(objects, state, solver, p, rl, maxResolutions,
+                            timeout_us, timer);
+
     // XXX in general this isn't exactly what we want... for
     // a multiple resolution case (or for example, a \in {b,c,0})
     // we want to find the first object, find a cex assuming
@@ -291,6 +631,61 @@ bool AddressSpace::resolve(ExecutionState &state,
 // transparently avoid screwing up symbolics (if the byte is symbolic
 // then its concrete cache byte isn't being used) but is just a hack.
 
+void AddressSpace::exposeReachable(const std::vector<uint64_t> &roots) {
+  if (objects.empty())
+    return;
+
+  unsigned pointerBytes = Context::get().getPointerWidth() / 8;
+  bool littleEndian = Context::get().isLittleEndian();
+  uint64_t lowest = objects.min().first->address;
+  uint64_t highest = objects.max().first->address + objects.max().first->size;
+
+  // The exposed objects modified since they were last scanned may point to
+  // further objects.
+  std::vector<ObjectPair> worklist;
+  for (MemoryMap::iterator it = objects.begin(), ie = objects.end(); it != ie;
+       ++it) {
+    const MemoryObject *mo = it->first;
+    const ObjectState *os = it->second;
+    if ((mo->exposed || mo->isFixed) && mo->scannedVersion != os->concreteVersion)
+      worklist.push_back(ObjectPair(mo, os));
+  }
+
+  std::vector<uint64_t> pointers(roots);
+  while (true) {
+    for (std::vector<uint64_t>::iterator it = pointers.begin(),
+                                         ie = pointers.end();
+         it != ie; ++it) {
+      ObjectPair op;
+      if (*it >= lowest && *it < highest &&
+          resolveOne(ConstantExpr::alloc(*it, Context::get().getPointerWidth()),
+                     op) &&
+          !op.first->exposed) {
+        op.first->exposed = true;
+        worklist.push_back(op);
+      }
+    }
+    pointers.clear();
+
+    if (worklist.empty())
+      break;
+
+    ObjectPair op = worklist.back();
+    worklist.pop_back();
+    const ObjectState *os = op.second;
+    op.first->scannedVersion = os->concreteVersion;
+    for (unsigned offset = 0; offset + pointerBytes <= os->size;
+         offset += pointerBytes) {
+      uint64_t value = 0;
+      for (unsigned i = 0; i < pointerBytes; ++i) {
+        unsigned byte = littleEndian ? pointerBytes - 1 - i : i;
+        value = (value << 8) | os->concreteStore.get(offset + byte);
+      }
+      pointers.push_back(value);
+    }
+  }
+}
+
 void AddressSpace::copyOutConcretes() {
   for (MemoryMap::iterator it = objects.begin(), ie = objects.end(); 
        it != ie; ++it) {
@@ -300,8 +695,12 @@ void AddressSpace::copyOutConcretes() {
       ObjectState *os = it->second;
       uint8_t *address = (uint8_t*) (unsigned long) mo->address;
 
-      if (!os->readOnly)
-        memcpy(address, os->concreteStore, mo->size);
+      // The actual memory still holds these contents when they were the
+      // last ones copied to or from it.
+      if (!os->readOnly && mo->hostVersion != os->concreteVersion) {
+        os->concreteStore.copyTo(address);
+        mo->hostVersion = os->concreteVersion;
+      }
     }
   }
 }
@@ -311,17 +710,22 @@ bool AddressSpace::copyInConcretes() {
        it != ie; ++it) {
     const MemoryObject *mo = it->first;
 
-    if (!mo->isUserSpecified) {
+    if (!mo->isUserSpecified &&
+        (!CopyInExposedOnly || mo->exposed || mo->isFixed)) {
       const ObjectState *os = it->second;
       uint8_t *address = (uint8_t*) (unsigned long) mo->address;
 
-      if (memcmp(address, os->concreteStore, mo->size)!=0) {
+      if (!os->concreteStore.equals(address)) {
         if (os->readOnly) {
           return false;
         } else {
           ObjectState *wos = getWriteable(mo, os);
-          memcpy(wos->concreteStore, address, mo->size);
+          wos->concreteStore.copyFrom(address);
+          wos->updateConcreteVersion();
+          mo->hostVersion = wos->concreteVersion;
         }
+      } else if (!os->readOnly) {
+        mo->hostVersion = os->concreteVersion;
       }
     }
   }
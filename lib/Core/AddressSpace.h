@@ -15,6 +15,8 @@
 #include "klee/Expr.h"
 #include "klee/Internal/ADT/ImmutableMap.h"
 
+#include <algorithm>
+
 namespace klee {
   class ExecutionState;
   class MemoryObject;
@@ -40,6 +42,16 @@ namespace klee {
 
     /// Unsupported, use copy constructor
     AddressSpace &operator=(const AddressSpace&); 
+
+    enum { ResolutionCacheSize = 4 };
+
+    /// The objects that concrete addresses were last resolved to, the most
+    /// recent first, as the accesses mostly hit a few objects such as the
+    /// current stack frame. The unused entries are null.
+    ObjectPair resolutionCache[ResolutionCacheSize];
+
+    /// Replace the binding of a cached object, or drop it when os is null.
+    void updateResolutionCache(const MemoryObject *mo, const ObjectState *os);
     
   public:
     /// The MemoryObject -> ObjectState map that constitutes the
@@ -52,8 +64,14 @@ namespace klee {
     MemoryMap objects;
     
   public:
-    AddressSpace() : cowKey(1) {}
-    AddressSpace(const AddressSpace &b) : cowKey(++b.cowKey), objects(b.objects) { }
+    AddressSpace() : cowKey(1) {
+      std::fill(resolutionCache, resolutionCache + ResolutionCacheSize,
+                ObjectPair(0, 0));
+    }
+    AddressSpace(const AddressSpace &b) : cowKey(++b.cowKey), objects(b.objects) {
+      std::copy(b.resolutionCache, b.resolutionCache + ResolutionCacheSize,
+                resolutionCache);
+    }
     ~AddressSpace() {}
 
     /// Resolve address to an ObjectPair in result.
@@ -112,15 +130,22 @@ namespace klee {
     /// \return A writeable ObjectState (\a os or a copy).
     ObjectState *getWriteable(const MemoryObject *mo, const ObjectState *os);
 
+    /// Mark the objects reachable from the given addresses, directly or
+    /// through the pointers in the concrete values of reachable objects, as
+    /// exposed to external code.
+    void exposeReachable(const std::vector<uint64_t> &roots);
+
     /// Copy the concrete values of all managed ObjectStates into the
-    /// actual system memory location they were allocated at.
+    /// actual system memory location they were allocated at, unless that
+    /// memory still holds them.
     void copyOutConcretes();
 
     /// Copy the concrete values of all managed ObjectStates back from
     /// the actual system memory location they were allocated
     /// at. ObjectStates will only be written to (and thus,
     /// potentially copied) if the memory values are different from
-    /// the current concrete values.
+    /// the current concrete values. Unless -copy-in-exposed-only=false,
+    /// only the exposed and fixed objects are considered.
     ///
     /// \retval true The copy succeeded. 
     /// \retval false The copy failed because a read-only object was modified.
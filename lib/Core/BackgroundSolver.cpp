@@ -0,0 +1,165 @@
+//===-- BackgroundSolver.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "BackgroundSolver.h"
+
+#include "TimingSolver.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+/// The codes of the results sent by the children, zero being a failure
+enum ResultCode {
+  Failed = 0,
+  ValidityTrue,
+  ValidityFalse,
+  ValidityUnknown
+};
+}
+
+static void reap(pid_t pid) {
+  int status;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    ;
+}
+
+BackgroundSolver::~BackgroundSolver() {
+  for (std::map<ExecutionState *, Query>::iterator it = pending.begin(),
+                                                   ie = pending.end();
+       it != ie; ++it) {
+    kill(it->second.pid, SIGKILL);
+    close(it->second.fd);
+    reap(it->second.pid);
+  }
+}
+
+bool BackgroundSolver::start(ExecutionState &state, ref<Expr> condition) {
+  if (pending.size() >= maxQueries || pending.count(&state))
+    return false;
+
+  int fds[2];
+  if (pipe(fds) < 0) {
+    klee_warning("pipe failed (for the background solver)");
+    return false;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    klee_warning("fork failed (for the background solver)");
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    close(fds[0]);
+    Solver::Validity validity;
+    std::vector<ref<Expr> > unsatCore;
+    int code = Failed;
+    solver->setTimeout(timeout);
+    if (solver->evaluate(state, condition, validity, unsatCore))
+      code = validity == Solver::True
+                 ? ValidityTrue
+                 : (validity == Solver::False ? ValidityFalse
+                                              : ValidityUnknown);
+    ssize_t written = write(fds[1], &code, sizeof(code));
+    (void)written;
+    // Leave the buffers of this process to the executor
+    _exit(0);
+  }
+
+  close(fds[1]);
+  Query &query = pending[&state];
+  query.pid = pid;
+  query.fd = fds[0];
+  query.condition = condition;
+  results.erase(&state);
+  return true;
+}
+
+void BackgroundSolver::poll(std::vector<ExecutionState *> &resumed,
+                            bool wait) {
+  if (pending.empty())
+    return;
+
+  std::vector<struct pollfd> fds;
+  std::vector<ExecutionState *> states;
+  for (std::map<ExecutionState *, Query>::iterator it = pending.begin(),
+                                                   ie = pending.end();
+       it != ie; ++it) {
+    struct pollfd fd;
+    fd.fd = it->second.fd;
+    fd.events = POLLIN;
+    fd.revents = 0;
+    fds.push_back(fd);
+    states.push_back(it->first);
+  }
+
+  int ready = ::poll(&fds[0], fds.size(), wait ? -1 : 0);
+  if (ready <= 0)
+    return;
+
+  for (unsigned i = 0; i != fds.size(); ++i) {
+    if (!fds[i].revents)
+      continue;
+
+    std::map<ExecutionState *, Query>::iterator it = pending.find(states[i]);
+    int code = Failed;
+    // A child that died without sending a result failed
+    if (read(it->second.fd, &code, sizeof(code)) != sizeof(code))
+      code = Failed;
+    close(it->second.fd);
+    reap(it->second.pid);
+
+    Result &result = results[it->first];
+    result.condition = it->second.condition;
+    result.success = code != Failed;
+    result.validity = code == ValidityTrue
+                          ? Solver::True
+                          : (code == ValidityFalse ? Solver::False
+                                                   : Solver::Unknown);
+    resumed.push_back(it->first);
+    pending.erase(it);
+  }
+}
+
+bool BackgroundSolver::takeResult(ExecutionState &state, ref<Expr> condition,
+                                  bool &success, Solver::Validity &validity) {
+  std::map<ExecutionState *, Result>::iterator it = results.find(&state);
+  if (it == results.end())
+    return false;
+
+  bool same = it->second.condition == condition;
+  success = it->second.success;
+  validity = it->second.validity;
+  results.erase(it);
+  return same;
+}
+
+bool BackgroundSolver::cancel(ExecutionState &state) {
+  results.erase(&state);
+  std::map<ExecutionState *, Query>::iterator it = pending.find(&state);
+  if (it == pending.end())
+    return false;
+
+  kill(it->second.pid, SIGKILL);
+  close(it->second.fd);
+  reap(it->second.pid);
+  pending.erase(it);
+  return true;
+}
@@ -0,0 +1,89 @@
+//===-- BackgroundSolver.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BACKGROUNDSOLVER_H
+#define KLEE_BACKGROUNDSOLVER_H
+
+#include "klee/Expr.h"
+#include "klee/Solver.h"
+
+#include <map>
+#include <sys/types.h>
+#include <vector>
+
+namespace klee {
+class ExecutionState;
+class TimingSolver;
+
+/// BackgroundSolver - Evaluates the branch conditions of parked states in
+/// forked processes, while the executor steps the other states.
+///
+/// The executor parks a state when its branch query times out, with its pc
+/// back at the branch, and resumes it once the query has been solved in the
+/// background. The branch is then executed again, and takes the result of the
+/// query instead of calling the solver. The forked processes share no memory
+/// with the executor, such that neither the expressions nor the solvers need
+/// to be thread-safe.
+class BackgroundSolver {
+  struct Query {
+    pid_t pid;
+    /// The read end of the pipe through which the child sends the result
+    int fd;
+    ref<Expr> condition;
+  };
+
+  struct Result {
+    ref<Expr> condition;
+    bool success;
+    Solver::Validity validity;
+  };
+
+  std::map<ExecutionState *, Query> pending;
+  std::map<ExecutionState *, Result> results;
+
+  TimingSolver *solver;
+
+  /// The time limit of the queries, in seconds
+  double timeout;
+
+  /// The maximal number of queries solved at once
+  unsigned maxQueries;
+
+public:
+  BackgroundSolver(TimingSolver *_solver, double _timeout,
+                   unsigned _maxQueries)
+      : solver(_solver), timeout(_timeout), maxQueries(_maxQueries) {}
+
+  /// Kills the processes of the pending queries.
+  ~BackgroundSolver();
+
+  unsigned size() const { return pending.size(); }
+
+  bool isPending(ExecutionState &state) const { return pending.count(&state); }
+
+  /// Start evaluating the condition in the state in a forked process. Returns
+  /// false when too many queries are pending or the fork fails.
+  bool start(ExecutionState &state, ref<Expr> condition);
+
+  /// Collect the results of the queries that have been solved, waiting for
+  /// at least one when wait is set, and add their states to resumed.
+  void poll(std::vector<ExecutionState *> &resumed, bool wait);
+
+  /// Take the result of the query of the state, when it was solved for the
+  /// same condition. success is false when the query timed out again.
+  bool takeResult(ExecutionState &state, ref<Expr> condition, bool &success,
+                  Solver::Validity &validity);
+
+  /// Forget the query and result of a state being terminated. Returns true
+  /// when its query was pending, that is, when the state was parked.
+  bool cancel(ExecutionState &state);
+};
+}
+
+#endif
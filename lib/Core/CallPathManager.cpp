@@ -28,11 +28,14 @@ using namespace klee;
 
 CallPathNode::CallPathNode(CallPathNode *_parent, 
                            Instruction *_callSite,
-                           Function *_function)
+                           Function *_function,
+                           unsigned _id)
   : parent(_parent),
     callSite(_callSite),
     function(_function),
-    count(0) {
+    count(0),
+    id(_id),
+    depth(_parent ? _parent->depth + 1 : 0) {
 }
 
 void CallPathNode::print() {
@@ -48,8 +51,8 @@ void CallPathNode::print() {
 
 ///
 
-CallPathManager::CallPathManager() : root(0, 0, 0) {
-}
+CallPathManager::CallPathManager(unsigned _maxDepth)
+    : root(0, 0, 0, ~0U), maxDepth(_maxDepth) {}
 
 CallPathManager::~CallPathManager() {
   for (std::vector<CallPathNode*>::iterator it = paths.begin(),
@@ -60,19 +63,24 @@ CallPathManager::~CallPathManager() {
 void CallPathManager::getSummaryStatistics(CallSiteSummaryTable &results) {
   results.clear();
 
+  // The summaries are only kept while the table is built, such that the
+  // nodes hold a single record
+  std::vector<StatisticRecord> summaries(paths.size());
   for (std::vector<CallPathNode*>::iterator it = paths.begin(),
          ie = paths.end(); it != ie; ++it)
-    (*it)->summaryStatistics = (*it)->statistics;
+    summaries[(*it)->id] = (*it)->statistics;
 
-  // compute summary bottom up, while building result table
+  // compute summary bottom up, while building result table, the parents
+  // coming before their children
   for (std::vector<CallPathNode*>::reverse_iterator it = paths.rbegin(),
          ie = paths.rend(); it != ie; ++it) {
     CallPathNode *cp = *it;
-    cp->parent->summaryStatistics += cp->summaryStatistics;
+    if (cp->parent != &root)
+      summaries[cp->parent->id] += summaries[cp->id];
 
     CallSiteInfo &csi = results[cp->callSite][cp->function];
     csi.count += cp->count;
-    csi.statistics += cp->summaryStatistics;
+    csi.statistics += summaries[cp->id];
   }
 }
 
@@ -84,7 +92,7 @@ CallPathNode *CallPathManager::computeCallPath(CallPathNode *parent,
     if (cs==p->callSite && f==p->function)
       return p;
   
-  CallPathNode *cp = new CallPathNode(parent, cs, f);
+  CallPathNode *cp = new CallPathNode(parent, cs, f, paths.size());
   paths.push_back(cp);
   return cp;
 }
@@ -95,6 +103,9 @@ CallPathNode *CallPathManager::getCallPath(CallPathNode *parent,
   std::pair<Instruction*,Function*> key(cs, f);
   if (!parent)
     parent = &root;
+  if (maxDepth)
+    while (parent->depth >= maxDepth)
+      parent = parent->parent;
   
   CallPathNode::children_ty::iterator it = parent->children.find(key);
   if (it==parent->children.end()) {
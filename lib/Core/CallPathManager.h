@@ -48,20 +48,34 @@ namespace klee {
     children_ty children;
 
     StatisticRecord statistics;
-    StatisticRecord summaryStatistics;
     unsigned count;
 
+    /// The index of the node in the paths of its manager, and its number of
+    /// calls from the root
+    unsigned id;
+    unsigned depth;
+
   public:
     CallPathNode(CallPathNode *parent, 
                  llvm::Instruction *callSite,
-                 llvm::Function *function);
+                 llvm::Function *function,
+                 unsigned id);
 
     void print();
   };
 
+  /// CallPathManager - The call paths of the stack frames, which are
+  /// interned, such that all the frames of a path share its node.
+  ///
+  /// A call to a pair of a call site and a function already on the path is
+  /// given the node of that call, which collapses the cycles of recursion.
+  /// For a maximum depth, the calls deeper than it are recorded as calls from
+  /// the node at the depth below it, which bounds the paths but leaves the
+  /// statistics they gather out of the summaries of their real callers.
   class CallPathManager {
     CallPathNode root;
     std::vector<CallPathNode*> paths;
+    unsigned maxDepth;
 
   private:
     CallPathNode *computeCallPath(CallPathNode *parent, 
@@ -69,7 +83,8 @@ namespace klee {
                                   llvm::Function *f);
     
   public:
-    CallPathManager();
+    /// The paths are unbounded for a maximum depth of 0.
+    explicit CallPathManager(unsigned maxDepth = 0);
     ~CallPathManager();
 
     void getSummaryStatistics(CallSiteSummaryTable &result);
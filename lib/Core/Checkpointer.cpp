@@ -0,0 +1,241 @@
+//===-- Checkpointer.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Checkpointer.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace klee;
+
+/// Identifies the files listing the live states of a checkpoint
+static const uint32_t CheckpointFileMagic = 0x54584350; // "TXCP"
+
+static const uint32_t CheckpointFileVersion = 1;
+
+static const char *const CheckpointFileName = "checkpoint";
+
+static const char *const SplitsFileName = "splits";
+
+static void writeUInt32(std::ofstream &os, uint32_t value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void writeUInt64(std::ofstream &os, uint64_t value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static bool readUInt32(std::ifstream &is, uint32_t &value) {
+  return is.read(reinterpret_cast<char *>(&value), sizeof(value)).good();
+}
+
+static bool readUInt64(std::ifstream &is, uint64_t &value) {
+  return is.read(reinterpret_cast<char *>(&value), sizeof(value)).good();
+}
+
+Checkpointer::Checkpointer(const std::string &_directory)
+    : directory(_directory), nextId(1), loggedSplits(0), resumedRoot(true) {
+  if (mkdir(directory.c_str(), 0775) < 0 && errno != EEXIST)
+    klee_error("could not create checkpoint directory %s", directory.c_str());
+}
+
+void Checkpointer::writeSplits(const std::string &fileName,
+                               const std::vector<Split> &splits, bool append) {
+  // A log written anew replaces the old one at once, while the splits
+  // appended past the end of the last checkpoint are ignored when it is read.
+  std::ostringstream tmpName;
+  tmpName << fileName << ".tmp." << getpid();
+  std::string name = append ? fileName : tmpName.str();
+  std::ofstream os(name.c_str(), std::ios::out | std::ios::binary |
+                                     (append ? std::ios::app : std::ios::trunc));
+  for (std::vector<Split>::const_iterator it = splits.begin(),
+                                          ie = splits.end();
+       it != ie; ++it) {
+    writeUInt32(os, it->parent);
+    writeUInt32(os, it->index);
+    writeUInt32(os, it->child);
+  }
+  os.close();
+  if (!os.good()) {
+    klee_warning("could not write checkpoint file %s", name.c_str());
+    return;
+  }
+  if (!append && rename(name.c_str(), fileName.c_str()) < 0)
+    klee_warning("could not replace checkpoint file %s", fileName.c_str());
+}
+
+bool Checkpointer::resume(const std::string &fromDirectory) {
+  std::string fileName = getFileName(fromDirectory, CheckpointFileName);
+  std::ifstream is(fileName.c_str(), std::ios::in | std::ios::binary);
+  uint32_t magic, version, count;
+  uint64_t splitCount;
+  if (!readUInt32(is, magic) || magic != CheckpointFileMagic ||
+      !readUInt32(is, version) || version != CheckpointFileVersion ||
+      !readUInt32(is, nextId) || !readUInt64(is, splitCount) ||
+      !readUInt32(is, count)) {
+    klee_warning("could not read checkpoint file %s", fileName.c_str());
+    return false;
+  }
+
+  std::set<uint32_t> live;
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t id;
+    if (!readUInt32(is, id)) {
+      klee_warning("truncated checkpoint file %s", fileName.c_str());
+      return false;
+    }
+    live.insert(id);
+  }
+
+  // Only the splits of the checkpoint are read, the log may hold later ones
+  fileName = getFileName(fromDirectory, SplitsFileName);
+  std::ifstream splitsIs(fileName.c_str(), std::ios::in | std::ios::binary);
+  std::vector<Split> splits;
+  std::map<uint32_t, uint32_t> parents;
+  for (uint64_t i = 0; i < splitCount; ++i) {
+    Split split;
+    if (!readUInt32(splitsIs, split.parent) ||
+        !readUInt32(splitsIs, split.index) ||
+        !readUInt32(splitsIs, split.child)) {
+      klee_warning("truncated checkpoint file %s", fileName.c_str());
+      return false;
+    }
+    splits.push_back(split);
+    parents[split.child] = split.parent;
+  }
+
+  // The nodes on the paths of the live states, from the live states up to
+  // the root
+  std::set<uint32_t> kept;
+  for (std::set<uint32_t>::iterator it = live.begin(), ie = live.end();
+       it != ie; ++it) {
+    for (uint32_t id = *it; kept.insert(id).second;) {
+      std::map<uint32_t, uint32_t>::iterator parent = parents.find(id);
+      if (parent == parents.end())
+        break;
+      id = parent->second;
+    }
+  }
+
+  std::vector<Split> keptSplits;
+  for (std::vector<Split>::iterator it = splits.begin(), ie = splits.end();
+       it != ie; ++it) {
+    // The children off the paths are dropped with the other ones, their
+    // parents being split
+    recordedParents.insert(it->parent);
+    if (kept.count(it->child)) {
+      recordedChildren[std::make_pair(it->parent, it->index)] = it->child;
+      keptSplits.push_back(*it);
+    }
+  }
+  for (std::set<uint32_t>::iterator it = recordedParents.begin();
+       it != recordedParents.end();) {
+    if (kept.count(*it))
+      ++it;
+    else
+      recordedParents.erase(it++);
+  }
+  resumedRoot = kept.count(0);
+
+  // The log of this checkpointer starts with the splits still needed
+  writeSplits(getFileName(directory, SplitsFileName), keptSplits, false);
+  loggedSplits = keptSplits.size();
+
+  klee_message("resuming %u states of checkpoint %s, through %u splits",
+               count, fromDirectory.c_str(), (unsigned)keptSplits.size());
+  return true;
+}
+
+bool Checkpointer::isDropped(const ExecutionState &state) {
+  return state.checkpointId == DroppedId;
+}
+
+void Checkpointer::split(const std::vector<ExecutionState *> &children) {
+  uint32_t parent = DroppedId;
+  for (std::vector<ExecutionState *>::const_iterator it = children.begin(),
+                                                     ie = children.end();
+       it != ie; ++it) {
+    if (*it) {
+      assert((parent == DroppedId || parent == (*it)->checkpointId) &&
+             "children of different states");
+      parent = (*it)->checkpointId;
+    }
+  }
+  if (parent == DroppedId)
+    return;
+
+  bool recorded = recordedParents.count(parent);
+  for (unsigned i = 0, e = children.size(); i != e; ++i) {
+    ExecutionState *child = children[i];
+    if (!child)
+      continue;
+    if (recorded) {
+      std::map<std::pair<uint32_t, uint32_t>, uint32_t>::iterator it =
+          recordedChildren.find(std::make_pair(parent, i));
+      child->checkpointId =
+          it == recordedChildren.end() ? DroppedId : it->second;
+    } else {
+      Split split;
+      split.parent = parent;
+      split.index = i;
+      split.child = child->checkpointId = nextId++;
+      pendingSplits.push_back(split);
+    }
+  }
+}
+
+void Checkpointer::split(ExecutionState *falseState,
+                         ExecutionState *trueState) {
+  std::vector<ExecutionState *> children;
+  children.push_back(falseState);
+  children.push_back(trueState);
+  split(children);
+}
+
+void Checkpointer::save(const std::set<ExecutionState *> &states) {
+  writeSplits(getFileName(directory, SplitsFileName), pendingSplits,
+              loggedSplits != 0);
+  loggedSplits += pendingSplits.size();
+  pendingSplits.clear();
+
+  // As for the splits written anew, the list replaces the old one at once
+  std::string fileName = getFileName(directory, CheckpointFileName);
+  std::ostringstream tmpName;
+  tmpName << fileName << ".tmp." << getpid();
+  std::ofstream os(tmpName.str().c_str(), std::ios::out | std::ios::binary);
+
+  std::vector<uint32_t> live;
+  for (std::set<ExecutionState *>::const_iterator it = states.begin(),
+                                                  ie = states.end();
+       it != ie; ++it) {
+    if (!isDropped(**it))
+      live.push_back((*it)->checkpointId);
+  }
+
+  writeUInt32(os, CheckpointFileMagic);
+  writeUInt32(os, CheckpointFileVersion);
+  writeUInt32(os, nextId);
+  writeUInt64(os, loggedSplits);
+  writeUInt32(os, live.size());
+  for (std::vector<uint32_t>::iterator it = live.begin(), ie = live.end();
+       it != ie; ++it)
+    writeUInt32(os, *it);
+  os.close();
+
+  if (!os.good() || rename(tmpName.str().c_str(), fileName.c_str()) < 0)
+    klee_warning("could not write checkpoint file %s", fileName.c_str());
+}
@@ -0,0 +1,107 @@
+//===-- Checkpointer.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CHECKPOINTER_H
+#define KLEE_CHECKPOINTER_H
+
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace klee {
+class ExecutionState;
+
+/// Checkpointer - Records the exploration in a checkpoint directory, such
+/// that an interrupted run can be resumed where it was.
+///
+/// The states are not written themselves: their memory, constraints and
+/// nodes in the process and Tracer-X trees are rebuilt by executing their
+/// paths again. Each state is a node of the tree of the splits of the
+/// exploration, and the checkpoint holds the splits, appended to a log as
+/// they are made, and the nodes of the live states. Taking a checkpoint hence
+/// only writes the splits made since the last one, and the list of the live
+/// states.
+///
+/// A resumed run follows the recorded splits, dropping the children that are
+/// not on the path of a live state, as their subtrees have already been
+/// explored, until its states reach the nodes of the live states, from which
+/// they are explored anew.
+class Checkpointer {
+public:
+  /// The node of the states that are not on the path of a live state of the
+  /// resumed checkpoint
+  static const uint32_t DroppedId = ~0U;
+
+private:
+  struct Split {
+    uint32_t parent;
+    /// The index of the child within the split, which is the index of its
+    /// branch condition, the false branch being 0 for a two-way fork
+    uint32_t index;
+    uint32_t child;
+  };
+
+  std::string directory;
+
+  uint32_t nextId;
+
+  /// The number of splits in the log of the directory, for the last
+  /// checkpoint
+  uint64_t loggedSplits;
+
+  /// The splits made since the last checkpoint
+  std::vector<Split> pendingSplits;
+
+  /// The children of the recorded splits on the paths of the live states of
+  /// the resumed checkpoint, by parent and index
+  std::map<std::pair<uint32_t, uint32_t>, uint32_t> recordedChildren;
+
+  /// The parents of the recorded splits
+  std::set<uint32_t> recordedParents;
+
+  /// Whether the root is on the path of a live state of the resumed
+  /// checkpoint, which is false when the run it was taken from completed
+  bool resumedRoot;
+
+  std::string getFileName(const std::string &dir,
+                          const std::string &name) const {
+    return dir + "/" + name;
+  }
+
+  void writeSplits(const std::string &fileName, const std::vector<Split> &splits,
+                   bool append);
+
+public:
+  explicit Checkpointer(const std::string &_directory);
+
+  /// Resume the checkpoint of the given directory. The splits on the paths
+  /// of its live states are copied to the log of this checkpointer. Returns
+  /// false when the checkpoint cannot be read.
+  bool resume(const std::string &fromDirectory);
+
+  /// The node of the initial state.
+  uint32_t getRootId() const { return resumedRoot ? 0 : DroppedId; }
+
+  static bool isDropped(const ExecutionState &state);
+
+  /// Give their nodes to the children of a split, which are all copies of the
+  /// same state. The children may be null.
+  void split(const std::vector<ExecutionState *> &children);
+  void split(ExecutionState *falseState, ExecutionState *trueState);
+
+  /// Take a checkpoint with the given live states.
+  void save(const std::set<ExecutionState *> &states);
+
+  const std::string &getDirectory() const { return directory; }
+};
+}
+
+#endif
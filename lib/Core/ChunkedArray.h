@@ -0,0 +1,186 @@
+//===-- ChunkedArray.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CHUNKEDARRAY_H
+#define KLEE_CHUNKEDARRAY_H
+
+#include <algorithm>
+#include <cassert>
+
+namespace klee {
+
+/// ChunkedArray - A fixed-size array whose elements are stored in
+/// reference-counted chunks. Copying the array shares its chunks, and a
+/// chunk is only duplicated when it is written while shared, so that a
+/// write to a copy of a large array only copies the written chunk.
+///
+/// A filled array shares a single chunk between all its indices, such that
+/// a large array only takes the memory of the chunks written since it was
+/// last filled, as for the zero-initialized objects that are mostly left
+/// untouched.
+template <class T> class ChunkedArray {
+public:
+  enum { ChunkBits = 12, ChunkSize = 1 << ChunkBits };
+
+private:
+  struct Chunk {
+    unsigned refCount;
+    T *data;
+
+    explicit Chunk(unsigned size) : refCount(1), data(new T[size]) {}
+    ~Chunk() { delete[] data; }
+  };
+
+  unsigned size;
+  unsigned numChunks;
+  Chunk **chunks;
+
+  unsigned getChunkSize(unsigned index) const {
+    return std::min(size - (index << ChunkBits), (unsigned) ChunkSize);
+  }
+
+  /// unshare - Replace the shared chunk at the given index by a copy.
+  void unshare(unsigned index) {
+    Chunk *chunk = chunks[index];
+    unsigned chunkSize = getChunkSize(index);
+    Chunk *copy = new Chunk(chunkSize);
+    std::copy(chunk->data, chunk->data + chunkSize, copy->data);
+    --chunk->refCount;
+    chunks[index] = copy;
+  }
+
+  /// share - Set all the chunks to a single chunk filled with the value.
+  void share(const T &value) {
+    if (!numChunks)
+      return;
+    Chunk *chunk = new Chunk(getChunkSize(0));
+    std::fill(chunk->data, chunk->data + getChunkSize(0), value);
+    chunk->refCount = numChunks;
+    for (unsigned i = 0; i < numChunks; ++i)
+      chunks[i] = chunk;
+  }
+
+  void release() {
+    for (unsigned i = 0; i < numChunks; ++i)
+      if (--chunks[i]->refCount == 0)
+        delete chunks[i];
+  }
+
+  // DO NOT IMPLEMENT
+  ChunkedArray &operator=(const ChunkedArray &);
+
+public:
+  /// Create an array of the given size with value-initialized elements.
+  explicit ChunkedArray(unsigned _size)
+      : size(_size), numChunks((_size + ChunkSize - 1) >> ChunkBits),
+        chunks(new Chunk *[numChunks]) {
+    share(T());
+  }
+
+  ChunkedArray(const ChunkedArray &other)
+      : size(other.size), numChunks(other.numChunks),
+        chunks(new Chunk *[numChunks]) {
+    for (unsigned i = 0; i < numChunks; ++i) {
+      chunks[i] = other.chunks[i];
+      ++chunks[i]->refCount;
+    }
+  }
+
+  ~ChunkedArray() {
+    release();
+    delete[] chunks;
+  }
+
+  /// isShared - Return whether any chunk is shared, with another array or
+  /// between the indices of a filled array.
+  bool isShared() const {
+    for (unsigned i = 0; i < numChunks; ++i)
+      if (chunks[i]->refCount > 1)
+        return true;
+    return false;
+  }
+
+  const T &get(unsigned offset) const {
+    assert(offset < size && "offset out of bounds");
+    return chunks[offset >> ChunkBits]->data[offset & (ChunkSize - 1)];
+  }
+
+  /// getWritable - Return the element at the given offset for writing,
+  /// first duplicating its chunk when shared.
+  T &getWritable(unsigned offset) {
+    assert(offset < size && "offset out of bounds");
+    unsigned index = offset >> ChunkBits;
+    if (chunks[index]->refCount > 1)
+      unshare(index);
+    return chunks[index]->data[offset & (ChunkSize - 1)];
+  }
+
+  void set(unsigned offset, const T &value) { getWritable(offset) = value; }
+
+  /// getRange - Return the count elements from the given offset as a
+  /// contiguous buffer, or null when they span several chunks.
+  const T *getRange(unsigned offset, unsigned count) const {
+    assert(offset + count <= size && "range out of bounds");
+    if (count && (offset >> ChunkBits) != ((offset + count - 1) >> ChunkBits))
+      return 0;
+    return &chunks[offset >> ChunkBits]->data[offset & (ChunkSize - 1)];
+  }
+
+  /// getWritableRange - Return the count elements from the given offset as a
+  /// contiguous buffer for writing, under the conditions of getRange.
+  T *getWritableRange(unsigned offset, unsigned count) {
+    if (!getRange(offset, count))
+      return 0;
+    return &getWritable(offset);
+  }
+
+  /// fill - Set all elements to the given value, with a single chunk.
+  void fill(const T &value) {
+    release();
+    share(value);
+  }
+
+  /// copyTo - Copy the elements into the given contiguous buffer.
+  void copyTo(T *dest) const {
+    for (unsigned i = 0; i < numChunks; ++i)
+      dest = std::copy(chunks[i]->data, chunks[i]->data + getChunkSize(i),
+                       dest);
+  }
+
+  /// copyFrom - Set the elements from the given contiguous buffer, only
+  /// duplicating the shared chunks that change.
+  void copyFrom(const T *src) {
+    for (unsigned i = 0; i < numChunks; ++i) {
+      unsigned chunkSize = getChunkSize(i);
+      if (!std::equal(src, src + chunkSize, chunks[i]->data)) {
+        if (chunks[i]->refCount > 1) {
+          --chunks[i]->refCount;
+          chunks[i] = new Chunk(chunkSize);
+        }
+        std::copy(src, src + chunkSize, chunks[i]->data);
+      }
+      src += chunkSize;
+    }
+  }
+
+  /// equals - Return whether the elements are equal to the ones of the given
+  /// contiguous buffer.
+  bool equals(const T *src) const {
+    for (unsigned i = 0; i < numChunks; ++i) {
+      unsigned chunkSize = getChunkSize(i);
+      if (!std::equal(src, src + chunkSize, chunks[i]->data))
+        return false;
+      src += chunkSize;
+    }
+    return true;
+  }
+};
+}
+
+#endif
@@ -16,6 +16,10 @@ Statistic stats::coveredInstructions("CoveredInstructions", "Icov");
 Statistic stats::falseBranches("FalseBranches", "Bf");
 Statistic stats::forkTime("ForkTime", "Ftime");
 Statistic stats::forks("Forks", "Forks");
+Statistic stats::hwBranchMisses("HwBranchMisses", "HwBmiss");
+Statistic stats::hwCacheMisses("HwCacheMisses", "HwCmiss");
+Statistic stats::hwCycles("HwCycles", "HwCyc");
+Statistic stats::hwInstructions("HwInstructions", "HwI");
 Statistic stats::instructionRealTime("InstructionRealTimes", "Ireal");
 Statistic stats::instructionTime("InstructionTimes", "Itime");
 Statistic stats::instructions("Instructions", "I");
@@ -25,5 +29,7 @@ Statistic stats::reachableUncovered("ReachableUncovered", "IuncovReach");
 Statistic stats::resolveTime("ResolveTime", "Rtime");
 Statistic stats::solverTime("SolverTime", "Stime");
 Statistic stats::states("States", "States");
+Statistic stats::subsumptionChecks("SubsumptionChecks", "SubChecks");
+Statistic stats::subsumptionHits("SubsumptionHits", "SubHits");
 Statistic stats::trueBranches("TrueBranches", "Bt");
 Statistic stats::uncoveredInstructions("UncoveredInstructions", "Iuncov");
@@ -33,6 +33,15 @@ namespace stats {
   /// Number of states, this is a "fake" statistic used by istats, it
   /// isn't normally up-to-date.
   extern Statistic states;
+  extern Statistic subsumptionChecks;
+  extern Statistic subsumptionHits;
+
+  /// The counts of the hardware counters of the sampled instructions, by
+  /// HardwareCounters.
+  extern Statistic hwCycles;
+  extern Statistic hwInstructions;
+  extern Statistic hwCacheMisses;
+  extern Statistic hwBranchMisses;
 
   /// Instruction level statistic for tracking number of reachable
   /// uncovered instructions.
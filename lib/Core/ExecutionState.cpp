@@ -28,6 +28,7 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <iomanip>
+#include <new>
 #include <sstream>
 #include <cassert>
 #include <map>
@@ -44,10 +45,79 @@ namespace {
 
 /***/
 
+/// The blocks of the registers of the frames, each made of the reference
+/// count of the registers followed by the registers, are recycled by their
+/// number of registers, such that calls and returns do not allocate memory
+/// once a function has been called at that depth before. The lists are never
+/// destroyed, as frames may be released during the exit.
+static std::vector<std::vector<char *> > &getFreeLocalsBlocks() {
+  static std::vector<std::vector<char *> > *blocks =
+      new std::vector<std::vector<char *> >();
+  return *blocks;
+}
+
+/// The number of free blocks kept for each number of registers
+static const unsigned MaxFreeLocalsBlocks = 64;
+
+/// The size of the header of a block, keeping its registers aligned
+static const size_t LocalsHeaderSize =
+    sizeof(Cell) > sizeof(unsigned) ? sizeof(Cell) : sizeof(unsigned);
+
+static Cell *allocateLocals(unsigned count, unsigned *&refCount) {
+  std::vector<std::vector<char *> > &freeLocalsBlocks = getFreeLocalsBlocks();
+  char *block;
+  if (count < freeLocalsBlocks.size() && !freeLocalsBlocks[count].empty()) {
+    block = freeLocalsBlocks[count].back();
+    freeLocalsBlocks[count].pop_back();
+  } else {
+    block = static_cast<char *>(
+        ::operator new(LocalsHeaderSize + count * sizeof(Cell)));
+  }
+  refCount = new (block) unsigned(1);
+  Cell *cells = reinterpret_cast<Cell *>(block + LocalsHeaderSize);
+  for (unsigned i = 0; i != count; ++i)
+    new (&cells[i]) Cell();
+  return cells;
+}
+
+static void freeLocals(const Cell *locals, unsigned count) {
+  std::vector<std::vector<char *> > &freeLocalsBlocks = getFreeLocalsBlocks();
+  for (unsigned i = 0; i != count; ++i)
+    locals[i].~Cell();
+  char *block =
+      const_cast<char *>(reinterpret_cast<const char *>(locals)) -
+      LocalsHeaderSize;
+  if (count >= freeLocalsBlocks.size())
+    freeLocalsBlocks.resize(count + 1);
+  if (freeLocalsBlocks[count].size() < MaxFreeLocalsBlocks)
+    freeLocalsBlocks[count].push_back(block);
+  else
+    ::operator delete(block);
+}
+
+/// The slots of the deleted states, reused by the new ones such that the
+/// slots stay fewer than the most states alive at once. Never destroyed, as
+/// states may be deleted during the exit.
+static std::vector<unsigned> &getFreeSlots() {
+  static std::vector<unsigned> *slots = new std::vector<unsigned>();
+  return *slots;
+}
+
+static unsigned slotCount = 0;
+
+static unsigned acquireSlot() {
+  std::vector<unsigned> &freeSlots = getFreeSlots();
+  if (freeSlots.empty())
+    return slotCount++;
+  unsigned slot = freeSlots.back();
+  freeSlots.pop_back();
+  return slot;
+}
+
 StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
   : caller(_caller), kf(_kf), callPathNode(0), 
     minDistToUncoveredOnReturn(0), varargs(0) {
-  locals = new Cell[kf->numRegisters];
+  locals = allocateLocals(kf->numRegisters, localsRefCount);
 }
 
 StackFrame::StackFrame(const StackFrame &s) 
@@ -55,63 +125,93 @@ StackFrame::StackFrame(const StackFrame &s)
     kf(s.kf),
     callPathNode(s.callPathNode),
     allocas(s.allocas),
+    locals(s.locals),
+    localsRefCount(s.localsRefCount),
     minDistToUncoveredOnReturn(s.minDistToUncoveredOnReturn),
     varargs(s.varargs) {
-  locals = new Cell[s.kf->numRegisters];
-  for (unsigned i=0; i<s.kf->numRegisters; i++)
-    locals[i] = s.locals[i];
+  ++*localsRefCount;
+}
+
+StackFrame &StackFrame::operator=(const StackFrame &s) {
+  if (this != &s) {
+    ++*s.localsRefCount;
+    releaseLocals();
+    caller = s.caller;
+    kf = s.kf;
+    callPathNode = s.callPathNode;
+    allocas = s.allocas;
+    locals = s.locals;
+    localsRefCount = s.localsRefCount;
+    minDistToUncoveredOnReturn = s.minDistToUncoveredOnReturn;
+    varargs = s.varargs;
+  }
+  return *this;
 }
 
 StackFrame::~StackFrame() { 
-  delete[] locals; 
+  releaseLocals();
+}
+
+void StackFrame::unshareLocals() {
+  unsigned *copyRefCount;
+  Cell *copy = allocateLocals(kf->numRegisters, copyRefCount);
+  for (unsigned i=0; i<kf->numRegisters; i++)
+    copy[i] = locals[i];
+  --*localsRefCount;
+  locals = copy;
+  localsRefCount = copyRefCount;
+}
+
+void StackFrame::releaseLocals() {
+  if (--*localsRefCount == 0)
+    freeLocals(locals, kf->numRegisters);
 }
 
 /***/
 
 ExecutionState::ExecutionState(KFunction *kf)
     : pc(kf->instructions), prevPC(pc), queryCost(0.), weight(1), depth(0),
-      instsSinceCovNew(0), coveredNew(false), forkDisabled(false), ptreeNode(0),
-      txTreeNode(0) {
+      partitionPrefix(0), checkpointId(0), instsSinceCovNew(0),
+      coveredNew(false), forkDisabled(false), ptreeNode(0), txTreeNode(0),
+      slot(acquireSlot()) {
   pushFrame(0, kf);
+  models.push_back(new StateModel());
 }
 
 #ifdef ENABLE_Z3
 ExecutionState::ExecutionState(const KInstIterator &srcPrevPC,
                                const std::vector<ref<Expr> > &assumptions)
     : prevPC(srcPrevPC), constraints(assumptions), queryCost(0.), ptreeNode(0),
-      txTreeNode(0) {}
+      txTreeNode(0), slot(acquireSlot()) {}
 #else
 ExecutionState::ExecutionState(const std::vector<ref<Expr> > &assumptions)
-    : constraints(assumptions), queryCost(0.), ptreeNode(0), txTreeNode(0) {}
+    : constraints(assumptions), queryCost(0.), ptreeNode(0), txTreeNode(0),
+      slot(acquireSlot()) {}
 #endif
 
 ExecutionState::~ExecutionState() {
-  for (unsigned int i=0; i<symbolics.size(); i++)
-  {
-    const MemoryObject *mo = symbolics[i].first;
-    assert(mo->refCount > 0);
-    mo->refCount--;
-    if (mo->refCount == 0)
-      delete mo;
-  }
-
   while (!stack.empty())
     popFrame(0, ConstantExpr::alloc(0, Expr::Bool));
+
+  getFreeSlots().push_back(slot);
 }
 
+unsigned ExecutionState::getSlotCount() { return slotCount; }
+
 ExecutionState::ExecutionState(const ExecutionState &state)
     : fnAliases(state.fnAliases), pc(state.pc), prevPC(state.prevPC),
       stack(state.stack), incomingBBIndex(state.incomingBBIndex),
       addressSpace(state.addressSpace), constraints(state.constraints),
+      deferredConstraints(state.deferredConstraints), models(state.models),
       queryCost(state.queryCost), weight(state.weight), depth(state.depth),
-      pathOS(state.pathOS), symPathOS(state.symPathOS),
+      partitionPrefix(state.partitionPrefix),
+      checkpointId(state.checkpointId), pathOS(state.pathOS),
+      symPathOS(state.symPathOS),
       instsSinceCovNew(state.instsSinceCovNew), coveredNew(state.coveredNew),
       forkDisabled(state.forkDisabled), coveredLines(state.coveredLines),
       ptreeNode(state.ptreeNode), txTreeNode(state.txTreeNode),
-      symbolics(state.symbolics), arrayNames(state.arrayNames) {
-  for (unsigned int i=0; i<symbolics.size(); i++)
-    symbolics[i].first->refCount++;
-}
+      slot(acquireSlot()), symbolics(state.symbolics),
+      arrayNames(state.arrayNames) {}
 
 void ExecutionState::addTxTreeConstraint(ref<Expr> e,
                                          llvm::Instruction *instr) {
@@ -131,9 +231,14 @@ void ExecutionState::addTxTreeConstraint(ref<Expr> e,
 ExecutionState *ExecutionState::branch() {
   depth++;
 
+  // The lines covered are those of the path since the last test case, which
+  // the branched state starts afresh: they are moved aside for the copy
+  // rather than copied and cleared
+  std::map<const std::string *, std::set<unsigned> > lines;
+  lines.swap(coveredLines);
   ExecutionState *falseState = new ExecutionState(*this);
+  coveredLines.swap(lines);
   falseState->coveredNew = false;
-  falseState->coveredLines.clear();
 
   weight *= .5;
   falseState->weight -= weight;
@@ -156,27 +261,101 @@ void ExecutionState::popFrame(KInstruction *ki, ref<Expr> returnValue) {
 
   if (INTERPOLATION_ENABLED && site && ki)
     txTreeNode->bindReturnValue(site, ki->inst, returnValue);
+
+  if (INTERPOLATION_ENABLED && txTreeNode)
+    txTreeNode->recordReturn(stack.size());
 }
 
 void ExecutionState::addSymbolic(const MemoryObject *mo, const Array *array) { 
-  mo->refCount++;
   symbolics.push_back(std::make_pair(mo, array));
 }
 ///
 
-std::string ExecutionState::getFnAlias(std::string fn) {
-  std::map < std::string, std::string >::iterator it = fnAliases.find(fn);
-  if (it != fnAliases.end())
-    return it->second;
+/// The number of models kept by a state: the branches of a feasible fork
+/// each keep one of the models of the forking state
+static const unsigned MaxModels = 2;
+
+void ExecutionState::addModel(StateModel *model) const {
+  models.insert(models.begin(), model);
+  if (models.size() > MaxModels)
+    models.pop_back();
+}
+
+void ExecutionState::retainModelsOf(ref<Expr> e) {
+  for (unsigned i = 0; i < models.size();) {
+    if (models[i]->assignment.evaluate(e)->isTrue())
+      ++i;
+    else
+      models.erase(models.begin() + i);
+  }
+}
+
+std::string ExecutionState::getFnAlias(const std::string &fn) {
+  const std::pair<std::string, std::string> *alias = fnAliases.lookup(fn);
+  if (alias)
+    return alias->second;
   else return "";
 }
 
-void ExecutionState::addFnAlias(std::string old_fn, std::string new_fn) {
-  fnAliases[old_fn] = new_fn;
+void ExecutionState::addFnAlias(const std::string &old_fn,
+                                const std::string &new_fn) {
+  fnAliases = fnAliases.replace(std::make_pair(old_fn, new_fn));
 }
 
-void ExecutionState::removeFnAlias(std::string fn) {
-  fnAliases.erase(fn);
+void ExecutionState::removeFnAlias(const std::string &fn) {
+  fnAliases = fnAliases.remove(fn);
+}
+
+/**/
+
+void SymbolicList::retain(const MemoryObject *mo) { mo->refCount++; }
+
+void SymbolicList::release(const MemoryObject *mo) {
+  assert(mo->refCount > 0);
+  if (--mo->refCount == 0)
+    delete mo;
+}
+
+SymbolicList::Storage::~Storage() { truncate(0); }
+
+void SymbolicList::Storage::truncate(unsigned length) {
+  while (elements.size() > length) {
+    release(elements.back().first);
+    elements.pop_back();
+  }
+}
+
+void SymbolicList::push_back(const value_type &value) {
+  if (storage.isNull()) {
+    storage = new Storage();
+  } else if (storage->elements.size() > length) {
+    if (storage->refCount == 1) {
+      // The lists which appended beyond this one are gone
+      storage->truncate(length);
+    } else {
+      // Another list appended beyond this one: copy the shared prefix
+      Storage *copy = new Storage();
+      copy->elements.assign(storage->elements.begin(),
+                            storage->elements.begin() + length);
+      for (unsigned i = 0; i < length; ++i)
+        retain(copy->elements[i].first);
+      storage = copy;
+    }
+  }
+  retain(value.first);
+  storage->elements.push_back(value);
+  ++length;
+}
+
+bool SymbolicList::operator==(const SymbolicList &b) const {
+  if (length != b.length)
+    return false;
+  if (storage.get() == b.storage.get())
+    return true;
+  for (unsigned i = 0; i < length; ++i)
+    if (storage->elements[i] != b.storage->elements[i])
+      return false;
+  return true;
 }
 
 /**/
@@ -194,6 +373,23 @@ llvm::raw_ostream &klee::operator<<(llvm::raw_ostream &os, const MemoryMap &mm)
   return os;
 }
 
+/// Map the registers of a function to the arguments and instructions whose
+/// values they hold.
+static void getRegisterValues(KFunction *kf,
+                              std::vector<llvm::Value *> &values) {
+  values.assign(kf->numRegisters, 0);
+  unsigned index = 0;
+  for (llvm::Function::arg_iterator it = kf->function->arg_begin(),
+                                    ie = kf->function->arg_end();
+       it != ie; ++it, ++index)
+    values[kf->getArgRegister(index)] = it;
+  for (unsigned i = 0; i < kf->numInstructions; ++i) {
+    KInstruction *ki = kf->instructions[i];
+    if (ki->dest < kf->numRegisters)
+      values[ki->dest] = ki->inst;
+  }
+}
+
 bool ExecutionState::merge(const ExecutionState &b) {
   if (DebugLogStateMerge)
     llvm::errs() << "-- attempting merge of A:" << this << " with B:" << &b
@@ -312,19 +508,30 @@ bool ExecutionState::merge(const ExecutionState &b) {
   // it seems like it can make a difference, even though logically
   // they must contradict each other and so inA => !inB
 
+  // With interpolation, the merged locals get new versions in the dependency
+  // of the node, flowing from their versions in the two states
+  bool interpolated = INTERPOLATION_ENABLED && txTreeNode && b.txTreeNode;
+
   std::vector<StackFrame>::iterator itA = stack.begin();
   std::vector<StackFrame>::const_iterator itB = b.stack.begin();
   for (; itA!=stack.end(); ++itA, ++itB) {
     StackFrame &af = *itA;
     const StackFrame &bf = *itB;
+    std::vector<llvm::Value *> registerValues;
+    if (interpolated)
+      getRegisterValues(af.kf, registerValues);
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
+      const ref<Expr> &av = af.locals[i].value;
       const ref<Expr> &bv = bf.locals[i].value;
       if (av.isNull() || bv.isNull()) {
         // if one is null then by implication (we are at same pc)
         // we cannot reuse this local, so just ignore
       } else {
-        av = SelectExpr::create(inA, av, bv);
+        ref<Expr> merged = SelectExpr::create(inA, av, bv);
+        if (interpolated && merged != av && registerValues[i])
+          txTreeNode->mergeValue(registerValues[i], merged, av, b.txTreeNode,
+                                 bv);
+        af.getWritableLocals()[i].value = merged;
       }
     }
   }
@@ -352,6 +559,9 @@ bool ExecutionState::merge(const ExecutionState &b) {
     constraints.addConstraint(*it);
   constraints.addConstraint(OrExpr::create(inA, inB));
 
+  if (interpolated)
+    txTreeNode->mergeWith(b.txTreeNode);
+
   return true;
 }
 
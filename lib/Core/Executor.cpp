@@ -8,6 +8,8 @@
 //===----------------------------------------------------------------------===//
 
 #include "Executor.h"
+#include "BackgroundSolver.h"
+#include "Checkpointer.h"
 #include "Context.h"
 #include "CoreStats.h"
 #include "ExternalDispatcher.h"
@@ -15,9 +17,12 @@
 #include "Memory.h"
 #include "MemoryManager.h"
 #include "PTree.h"
+#include "SamplingProfiler.h"
 #include "Searcher.h"
 #include "SeedInfo.h"
 #include "SpecialFunctionHandler.h"
+#include "SpeculationWorkers.h"
+#include "StateSpiller.h"
 #include "StatsTracker.h"
 #include "TimingSolver.h"
 #include "UserSearcher.h"
@@ -47,6 +52,8 @@
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/System/MemoryUsage.h"
 #include "klee/SolverStats.h"
+#include "TxDebugLog.h"
+#include "TxMemoryCensus.h"
 #include "TxShadowArray.h"
 #include "TxTree.h"
 #include "TxSpeculation.h"
@@ -99,6 +106,7 @@
 #endif
 
 #include <cassert>
+#include <cmath>
 #include <algorithm>
 #include <iomanip>
 #include <iosfwd>
@@ -120,11 +128,23 @@ cl::opt<bool> DumpStatesOnHalt(
     "dump-states-on-halt", cl::init(true),
     cl::desc("Dump test cases for all active states on exit (default=on)"));
 
+cl::opt<bool> KeepProcessTree(
+    "keep-process-tree", cl::init(false),
+    cl::desc("Maintain the process tree even when no searcher needs it, to "
+             "dump it through dumpPTree or print it in the debug output "
+             "(default=off)"));
+
 cl::opt<bool> RandomizeFork(
     "randomize-fork", cl::init(false),
     cl::desc(
         "Randomly swap the true and false states on a fork (default=off)"));
 
+cl::opt<bool> SwitchEnumeration(
+    "switch-enumeration", cl::init(false),
+    cl::desc("Find the feasible targets of a symbolic switch by enumerating "
+             "the values of its condition, with one query per feasible "
+             "target instead of one per case (default=off)"));
+
 cl::opt<bool> AllowExternalSymCalls(
     "allow-external-sym-calls", cl::init(false),
     cl::desc("Allow calls with symbolic arguments to external functions.  This "
@@ -170,6 +190,12 @@ cl::opt<bool> DebugCompressInstructions(
 
 cl::opt<bool> DebugCheckForImpliedValues("debug-check-for-implied-values");
 
+cl::opt<bool> ImpliedValueConcretization(
+    "implied-value-concretization", cl::init(false),
+    cl::desc("Write the values that the branch conditions imply for the "
+             "bytes of the symbolic objects to these bytes, such that their "
+             "later reads are concrete (default=off)"));
+
 cl::opt<bool>
 SimplifySymIndices("simplify-sym-indices", cl::init(false),
                    cl::desc("Simplify symbolic accesses using equalities "
@@ -182,6 +208,13 @@ EqualitySubstitution("equality-substitution", cl::init(true),
 
 cl::opt<unsigned> MaxSymArraySize("max-sym-array-size", cl::init(0));
 
+cl::opt<unsigned> MaxMergedResolutions(
+    "max-merged-resolutions", cl::init(0),
+    cl::desc("Access the objects that a symbolic pointer may point to, when "
+             "they are at most this many, in a single state through a "
+             "selection among their values instead of forking a state for "
+             "each of them. Ignored with interpolation (default=0 (off))."));
+
 cl::opt<bool> SuppressExternalWarnings(
     "suppress-external-warnings", cl::init(false),
     cl::desc("Supress warnings about calling external functions."));
@@ -200,6 +233,24 @@ EmitAllErrors("emit-all-errors", cl::init(false),
               cl::desc("Generate tests cases for all errors "
                        "(default=off, i.e. one per (error,instruction) pair)"));
 
+enum ErrorMemoType {
+  SITE_ERROR_MEMO,        ///< One test per error and instruction
+  CALL_HISTORY_ERROR_MEMO ///< One test per error, instruction and call stack
+};
+
+cl::opt<ErrorMemoType> ErrorMemo(
+    "error-memo",
+    cl::desc("Without -emit-all-errors, the occurrences of an error that "
+             "are given a test (default=site)"),
+    cl::values(clEnumValN(SITE_ERROR_MEMO, "site",
+                          "the first at each instruction"),
+               clEnumValN(CALL_HISTORY_ERROR_MEMO, "call-history",
+                          "the first at each instruction under each call "
+                          "stack, which interpolation keeps apart in its "
+                          "subsumption table"),
+               clEnumValEnd),
+    cl::init(SITE_ERROR_MEMO));
+
 cl::opt<bool>
 NoExternals("no-externals",
             cl::desc("Do not allow external function calls (default=off)"));
@@ -292,16 +343,119 @@ MaxDepth("max-depth",
          cl::desc("Only allow this many symbolic branches (default=0 (off))"),
          cl::init(0));
 
+cl::opt<bool> TestInputsFromModels(
+    "test-inputs-from-models",
+    cl::desc("Take the inputs of a test from a model of the constraints of "
+             "its state, found by an earlier query, when there is one, and "
+             "only query the solver for the objects in the constraints "
+             "(default=on)."),
+    cl::init(true));
+
+cl::opt<unsigned> SamplingProfileInterval(
+    "sampling-profile-interval",
+    cl::desc("Sample the phase of the executor and the instruction being "
+             "interpreted every given number of microseconds of CPU time, and "
+             "write the samples into profile.folded in the folded stack format "
+             "of the flame graph tools (default=0 (off))."),
+    cl::init(0));
+
+cl::opt<unsigned> PartitionCount(
+    "partition-count",
+    cl::desc("Split the exploration among the given number of processes, by "
+             "the branches taken at the first -partition-depth symbolic "
+             "branches. Each process explores the paths of its own prefixes "
+             "(default=1 (off))."),
+    cl::init(1));
+
+cl::opt<unsigned> PartitionIndex(
+    "partition-index",
+    cl::desc("The index of the partition explored by this process, from 0 to "
+             "-partition-count minus 1 (default=0)."),
+    cl::init(0));
+
+cl::opt<unsigned> PartitionDepth(
+    "partition-depth",
+    cl::desc("The number of symbolic branches whose outcomes decide the "
+             "partition of a path, at most 63 (default=8)."),
+    cl::init(8));
+
+cl::opt<unsigned> ReplayPathFastForward(
+    "replay-path-fast-forward",
+    cl::desc("Follow the first given number of branches of the path replayed "
+             "with -replay-path without querying the solver, and add their "
+             "conditions to the state only after the last of them "
+             "(default=0 (off))."),
+    cl::init(0));
+
 cl::opt<unsigned> MaxMemory("max-memory",
                             cl::desc("Refuse to fork when above this amount of "
                                      "memory (in MB, default=2000)"),
                             cl::init(2000));
 
+cl::opt<bool> ShedMemory(
+    "shed-memory",
+    cl::desc("Above the memory cap, evict the quarter of the subsumption table "
+             "entries of the lowest utility, then drop the solver caches, "
+             "before terminating states (default=on)"),
+    cl::init(true));
+
 cl::opt<bool> MaxMemoryInhibit(
     "max-memory-inhibit",
     cl::desc(
         "Inhibit forking at memory cap (vs. random terminate) (default=on)"),
     cl::init(true));
+
+cl::opt<bool> SpillStates(
+    "spill-states",
+    cl::desc("Near the memory cap, move the concrete memory of the states to "
+             "be selected last to disk, and back when they are selected, "
+             "before terminating states (default=off)"),
+    cl::init(false));
+
+cl::opt<std::string> CheckpointDir(
+    "checkpoint-dir",
+    cl::desc("Take checkpoints of the exploration in the given directory, "
+             "every -checkpoint-interval seconds and when the run ends, from "
+             "which it can be resumed with -resume-from (default=off)"));
+
+cl::opt<std::string> ResumeFrom(
+    "resume-from",
+    cl::desc("Resume the exploration from the last checkpoint in the given "
+             "directory, by executing the paths of its states again, and "
+             "take the next checkpoints there too unless -checkpoint-dir is "
+             "given"));
+
+cl::opt<unsigned> BackgroundQueries(
+    "background-queries",
+    cl::desc("When a branch query times out, solve it in a forked process "
+             "while the other states are explored, and resume its state once "
+             "it is solved, instead of terminating the state. Up to the given "
+             "number of queries are solved at once. Not used with "
+             "interpolation, with seeds, or with a core solver forking into "
+             "shared memory (default=0 (off))"),
+    cl::init(0));
+
+cl::opt<double> BackgroundQueryTime(
+    "background-query-time",
+    cl::desc("Time limit in seconds of the queries solved in the background "
+             "(default=60)"),
+    cl::init(60));
+
+cl::opt<unsigned> SpeculationWorkerCount(
+    "speculation-workers",
+    cl::desc("Explore the subtree of a new speculation in a forked process "
+             "while the other states are explored, and roll it back without "
+             "exploring it when it fails there. Up to the given number of "
+             "speculations are explored at once. Only used with speculation "
+             "(default=0 (off))"),
+    cl::init(0));
+
+cl::opt<double> SpeculationWorkerTime(
+    "speculation-worker-time",
+    cl::desc("Time limit in seconds of the explorations of the speculation "
+             "workers, after which the speculation is explored as usual "
+             "(default=10)"),
+    cl::init(10));
 } // namespace
 
 namespace klee {
@@ -320,7 +474,9 @@ Executor::Executor(const InterpreterOptions &opts, InterpreterHandler *ih)
     : Interpreter(opts), kmodule(0), interpreterHandler(ih), searcher(0),
       externalDispatcher(new ExternalDispatcher()), statsTracker(0),
       pathWriter(0), symPathWriter(0), specialFunctionHandler(0),
-      processTree(0), txTree(0), replayKTest(0), replayPath(0), usingSeeds(0),
+      processTree(0), txTree(0), stateSpiller(0), backgroundSolver(0),
+      speculationWorkers(0), checkpointer(0), impliedValueCache(0),
+      replayKTest(0), replayPath(0), usingSeeds(0),
       atMemoryLimit(false), inhibitForking(false), haltExecution(false),
       ivcEnabled(false),
       coreSolverTimeout(MaxCoreSolverTime != 0 && MaxInstructionTime != 0
@@ -337,22 +493,92 @@ Executor::Executor(const InterpreterOptions &opts, InterpreterHandler *ih)
     coveredICMPCount = 0;
   }
 
-  if (coreSolverTimeout)
-    UseForkedCoreSolver = true;
-  Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
-  if (!coreSolver) {
-    klee_error("Failed to create core solver\n");
+  if (!CheckpointDir.empty() || !ResumeFrom.empty()) {
+    checkpointer = new Checkpointer(CheckpointDir.empty() ? ResumeFrom
+                                                          : CheckpointDir);
+    if (!ResumeFrom.empty() && !checkpointer->resume(ResumeFrom))
+      klee_error("could not resume from %s", ResumeFrom.c_str());
+  }
+
+  if (PartitionCount > 1) {
+    if (PartitionIndex >= PartitionCount)
+      klee_error("-partition-index must be less than -partition-count");
+    if (PartitionDepth == 0 || PartitionDepth > 63)
+      klee_error("-partition-depth must be from 1 to 63");
+    if ((1ULL << PartitionDepth) < PartitionCount)
+      klee_warning("-partition-depth %u gives fewer prefixes than partitions",
+                   PartitionDepth.getValue());
   }
-  Solver *solver = constructSolverChain(
-      coreSolver,
-      interpreterHandler->getOutputFilename(ALL_QUERIES_SMT2_FILE_NAME),
-      interpreterHandler->getOutputFilename(SOLVER_QUERIES_SMT2_FILE_NAME),
-      interpreterHandler->getOutputFilename(ALL_QUERIES_PC_FILE_NAME),
-      interpreterHandler->getOutputFilename(SOLVER_QUERIES_PC_FILE_NAME));
 
-  this->solver = new TimingSolver(solver, EqualitySubstitution);
+  if (ConcreteReplay) {
+    // The replayed inputs are concrete, and so are the queries, which the
+    // timing solver answers without a solver. The dummy solver fails any
+    // other, terminating its state early.
+    this->solver = new TimingSolver(createDummySolver(), false);
+  } else {
+    if (coreSolverTimeout)
+      UseForkedCoreSolver = true;
+    Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
+    if (!coreSolver) {
+      klee_error("Failed to create core solver\n");
+    }
+    Solver *solver = constructSolverChain(
+        coreSolver,
+        interpreterHandler->getOutputFilename(ALL_QUERIES_SMT2_FILE_NAME),
+        interpreterHandler->getOutputFilename(SOLVER_QUERIES_SMT2_FILE_NAME),
+        interpreterHandler->getOutputFilename(ALL_QUERIES_PC_FILE_NAME),
+        interpreterHandler->getOutputFilename(SOLVER_QUERIES_PC_FILE_NAME),
+        interpreterHandler->getOutputFilename(ALL_QUERIES_BINARY_FILE_NAME),
+        interpreterHandler->getOutputFilename(
+            SOLVER_QUERIES_BINARY_FILE_NAME));
+
+    this->solver = new TimingSolver(solver, EqualitySubstitution);
+  }
   memory = new MemoryManager(&arrayCache);
 
+  if (SpillStates)
+    stateSpiller =
+        new StateSpiller(interpreterHandler->getOutputFilename("state"));
+
+  // STP and metaSMT return the results of their forked runs through a region
+  // of memory that the processes of the background queries would share
+  if (BackgroundQueries) {
+    if (INTERPOLATION_ENABLED)
+      klee_warning("-background-queries is not used with interpolation");
+    else if (UseForkedCoreSolver && (CoreSolverToUse == STP_SOLVER ||
+                                     CoreSolverToUse == METASMT_SOLVER))
+      klee_warning("-background-queries is not used with the forked core "
+                   "solver, see -use-forked-solver");
+    else
+      backgroundSolver = new BackgroundSolver(
+          this->solver, BackgroundQueryTime, BackgroundQueries);
+  }
+
+  if (SpeculationWorkerCount) {
+    if (!INTERPOLATION_ENABLED || SpecTypeToUse == NO_SPEC)
+      klee_warning("-speculation-workers is only used with speculation, see "
+                   "-spec-type");
+    else if (UseForkedCoreSolver && (CoreSolverToUse == STP_SOLVER ||
+                                     CoreSolverToUse == METASMT_SOLVER))
+      klee_warning("-speculation-workers is not used with the forked core "
+                   "solver, see -use-forked-solver");
+    else
+      speculationWorkers = new SpeculationWorkers(
+          *this, SpeculationWorkerTime, SpeculationWorkerCount);
+  }
+
+  // The concretized bytes are loaded as constants, which the interpolants
+  // would not relate to the conditions that implied them
+  if (ImpliedValueConcretization) {
+    if (INTERPOLATION_ENABLED) {
+      klee_warning("-implied-value-concretization is not used with "
+                   "interpolation");
+    } else {
+      ivcEnabled = true;
+      impliedValueCache = new ImpliedValueCache();
+    }
+  }
+
   if (optionIsSet(DebugPrintInstructions, FILE_ALL) ||
       optionIsSet(DebugPrintInstructions, FILE_COMPACT) ||
       optionIsSet(DebugPrintInstructions, FILE_SRC)) {
@@ -403,6 +629,7 @@ const Module *Executor::setModule(llvm::Module *module,
   specialFunctionHandler->prepare();
   kmodule->prepare(opts, interpreterHandler);
   specialFunctionHandler->bind();
+  specialFunctionHandler->loadMemoTable();
 
   if (StatsTracker::useStatistics() || userSearcherRequiresMD2U()) {
     statsTracker = new StatsTracker(
@@ -414,6 +641,11 @@ const Module *Executor::setModule(llvm::Module *module,
 }
 
 Executor::~Executor() {
+  delete checkpointer;
+  delete impliedValueCache;
+  delete backgroundSolver;
+  delete speculationWorkers;
+  delete stateSpiller;
   delete memory;
   delete externalDispatcher;
   if (processTree)
@@ -657,6 +889,90 @@ void Executor::initializeGlobals(ExecutionState &state) {
   }
 }
 
+void Executor::findSwitchTargets(
+    ExecutionState &state, SwitchInst *si, ref<Expr> cond,
+    const std::map<ref<Expr>, BasicBlock *> &expressionOrder,
+    std::vector<BasicBlock *> &bbOrder,
+    std::map<BasicBlock *, ref<Expr> > &branchTargets) {
+  // The condition of each target, with the default values given to the
+  // default destination, which may also be the target of some cases
+  std::map<BasicBlock *, ref<Expr> > candidates;
+  std::vector<BasicBlock *> candidateOrder;
+  ref<Expr> defaultValue = ConstantExpr::alloc(1, Expr::Bool);
+  for (std::map<ref<Expr>, BasicBlock *>::const_iterator
+           it = expressionOrder.begin(),
+           ie = expressionOrder.end();
+       it != ie; ++it) {
+    ref<Expr> match = EqExpr::create(cond, it->first);
+    defaultValue = AndExpr::create(defaultValue, Expr::createIsZero(match));
+    std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> res =
+        candidates.insert(
+            std::make_pair(it->second, ConstantExpr::alloc(0, Expr::Bool)));
+    res.first->second = OrExpr::create(match, res.first->second);
+    if (res.second)
+      candidateOrder.push_back(it->second);
+  }
+  std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> res =
+      candidates.insert(std::make_pair(si->getDefaultDest(),
+                                       ConstantExpr::alloc(0, Expr::Bool)));
+  res.first->second = OrExpr::create(defaultValue, res.first->second);
+  if (res.second)
+    candidateOrder.push_back(si->getDefaultDest());
+
+  // Ask for a value of the condition taking one of the targets not found
+  // yet, until none of them is feasible
+  std::set<BasicBlock *> feasible;
+  while (feasible.size() != candidates.size()) {
+    ref<Expr> remaining = ConstantExpr::alloc(0, Expr::Bool);
+    for (std::map<BasicBlock *, ref<Expr> >::iterator it = candidates.begin(),
+                                                      ie = candidates.end();
+         it != ie; ++it) {
+      if (!feasible.count(it->first))
+        remaining = OrExpr::create(it->second, remaining);
+    }
+
+    std::vector<ref<Expr> > unsatCore;
+    ref<ConstantExpr> value;
+    bool hasSolution;
+    bool success = solver->getFeasibleValue(state, remaining, cond, value,
+                                            hasSolution, unsatCore);
+    assert(success && "FIXME: Unhandled solver failure");
+    (void)success;
+    if (!hasSolution) {
+      // The remaining targets cannot be taken: Mark the unsatisfiability core
+      if (INTERPOLATION_ENABLED)
+        state.txTreeNode->unsatCoreInterpolation(unsatCore);
+      break;
+    }
+
+    std::map<ref<Expr>, BasicBlock *>::const_iterator match =
+        expressionOrder.find(value);
+    feasible.insert(match == expressionOrder.end() ? si->getDefaultDest()
+                                                   : match->second);
+  }
+
+  for (std::vector<BasicBlock *>::iterator it = candidateOrder.begin(),
+                                           ie = candidateOrder.end();
+       it != ie; ++it) {
+    if (feasible.count(*it)) {
+      bbOrder.push_back(*it);
+      branchTargets[*it] = candidates[*it];
+    }
+  }
+}
+
+void Executor::splitProcessTree(ExecutionState &current, ExecutionState *left,
+                                ExecutionState *right) {
+  if (!processTree)
+    return;
+  PTree::Node *node = current.ptreeNode;
+  node->data = 0;
+  std::pair<PTree::Node *, PTree::Node *> res =
+      processTree->split(node, left, right);
+  left->ptreeNode = res.first;
+  right->ptreeNode = res.second;
+}
+
 void Executor::branch(ExecutionState &state,
                       const std::vector<ref<Expr> > &conditions,
                       std::vector<ExecutionState *> &result) {
@@ -683,11 +999,7 @@ void Executor::branch(ExecutionState &state,
       ExecutionState *ns = es->branch();
       addedStates.push_back(ns);
       result.push_back(ns);
-      es->ptreeNode->data = 0;
-      std::pair<PTree::Node *, PTree::Node *> res =
-          processTree->split(es->ptreeNode, ns, es);
-      ns->ptreeNode = res.first;
-      es->ptreeNode = res.second;
+      splitProcessTree(*es, ns, es);
 
       if (INTERPOLATION_ENABLED) {
         std::pair<TxTreeNode *, TxTreeNode *> ires =
@@ -696,6 +1008,11 @@ void Executor::branch(ExecutionState &state,
         es->txTreeNode = ires.second;
       }
     }
+
+    // The children are recorded by the index of their condition, as the
+    // states they were split from are chosen at random
+    if (checkpointer)
+      checkpointer->split(result);
   }
 
   // If necessary redistribute seeds to match conditions, killing
@@ -752,11 +1069,21 @@ void Executor::branch(ExecutionState &state,
 
 Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
                                    bool isInternal) {
+  SamplingProfiler::Scope phase(SamplingProfiler::Fork);
+  StatePair fastForwarded;
+  if (fastForwardReplay(current, condition, isInternal, fastForwarded))
+    return fastForwarded;
+
   Solver::Validity res;
   std::map<ExecutionState *, std::vector<SeedInfo> >::iterator it =
       seedMap.find(&current);
   bool isSeeding = it != seedMap.end();
 
+  // Whether each seed satisfies the condition, when known
+  std::vector<bool> seedValues;
+  bool seedsConcrete =
+      isSeeding && evaluateSeedsConcretely(it->second, condition, seedValues);
+
   if (!isSeeding && !isa<ConstantExpr>(condition) &&
       (MaxStaticForkPct != 1. || MaxStaticSolvePct != 1. ||
        MaxStaticCPForkPct != 1. || MaxStaticCPSolvePct != 1.) &&
@@ -791,10 +1118,19 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
   // llvm::errs() << "Calling solver->evaluate on query:\n";
   // ExprPPrinter::printQuery(llvm::errs(), current.constraints, condition);
 
-  solver->setTimeout(timeout);
   std::vector<ref<Expr> > unsatCore;
-  bool success = solver->evaluate(current, condition, res, unsatCore);
-  solver->setTimeout(0);
+  bool success = true;
+  if (seedsConcrete &&
+      ((hasSeedValue(seedValues, true) && hasSeedValue(seedValues, false)) ||
+       current.forkDisabled || OnlyReplaySeeds)) {
+    // The seeds satisfy the constraints, hence a seed on each side shows
+    // that both are feasible, and a fixed branch follows the seeds anyway
+    res = Solver::Unknown;
+  } else {
+    solver->setTimeout(timeout);
+    success = solver->evaluate(current, condition, res, unsatCore);
+    solver->setTimeout(0);
+  }
 
   if (!success) {
     current.pc = current.prevPC;
@@ -853,24 +1189,11 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
   // and false seeds.
   if (isSeeding && (current.forkDisabled || OnlyReplaySeeds) &&
       res == Solver::Unknown) {
-    bool trueSeed = false, falseSeed = false;
     // Is seed extension still ok here?
-    for (std::vector<SeedInfo>::iterator siit = it->second.begin(),
-                                         siie = it->second.end();
-         siit != siie; ++siit) {
-      ref<ConstantExpr> res;
-      bool success =
-          solver->getValue(current, siit->assignment.evaluate(condition), res);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void)success;
-      if (res->isTrue()) {
-        trueSeed = true;
-      } else {
-        falseSeed = true;
-      }
-      if (trueSeed && falseSeed)
-        break;
-    }
+    if (!seedsConcrete)
+      evaluateSeeds(current, it->second, condition, seedValues);
+    bool trueSeed = hasSeedValue(seedValues, true),
+         falseSeed = hasSeedValue(seedValues, false);
     if (!(trueSeed && falseSeed)) {
       assert(trueSeed || falseSeed);
 
@@ -931,22 +1254,17 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
       std::swap(trueState, falseState);
 
     if (it != seedMap.end()) {
+      if (seedValues.size() != it->second.size())
+        evaluateSeeds(current, it->second, condition, seedValues);
       std::vector<SeedInfo> seeds = it->second;
       it->second.clear();
       std::vector<SeedInfo> &trueSeeds = seedMap[trueState];
       std::vector<SeedInfo> &falseSeeds = seedMap[falseState];
-      for (std::vector<SeedInfo>::iterator siit = seeds.begin(),
-                                           siie = seeds.end();
-           siit != siie; ++siit) {
-        ref<ConstantExpr> res;
-        bool success = solver->getValue(
-            current, siit->assignment.evaluate(condition), res);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void)success;
-        if (res->isTrue()) {
-          trueSeeds.push_back(*siit);
+      for (unsigned i = 0; i < seeds.size(); ++i) {
+        if (seedValues[i]) {
+          trueSeeds.push_back(seeds[i]);
         } else {
-          falseSeeds.push_back(*siit);
+          falseSeeds.push_back(seeds[i]);
         }
       }
 
@@ -967,11 +1285,9 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
       }
     }
 
-    current.ptreeNode->data = 0;
-    std::pair<PTree::Node *, PTree::Node *> res =
-        processTree->split(current.ptreeNode, falseState, trueState);
-    falseState->ptreeNode = res.first;
-    trueState->ptreeNode = res.second;
+    splitProcessTree(current, falseState, trueState);
+    if (checkpointer)
+      checkpointer->split(falseState, trueState);
 
     if (!isInternal) {
       if (pathWriter) {
@@ -1003,10 +1319,147 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
       return StatePair(0, 0);
     }
 
+    if (PartitionCount > 1 && trueState->depth <= PartitionDepth) {
+      trueState->partitionPrefix = (trueState->partitionPrefix << 1) | 1;
+      falseState->partitionPrefix <<= 1;
+      if (trueState->depth == PartitionDepth) {
+        // The paths of the prefixes of the other processes are dropped
+        // silently, and not marked as explored for the interpolation
+        if (trueState->partitionPrefix % PartitionCount != PartitionIndex) {
+          terminateStateOutOfPartition(*trueState);
+          trueState = 0;
+        }
+        if (falseState->partitionPrefix % PartitionCount != PartitionIndex) {
+          terminateStateOutOfPartition(*falseState);
+          falseState = 0;
+        }
+      }
+    }
+
     return StatePair(trueState, falseState);
   }
 }
 
+bool Executor::fastForwardReplay(ExecutionState &current,
+                                 ref<Expr> condition, bool isInternal,
+                                 StatePair &result) {
+  if (!replayPath || isInternal || replayPosition >= ReplayPathFastForward ||
+      seedMap.count(&current))
+    return false;
+
+  assert(replayPosition < replayPath->size() &&
+         "ran out of branches in replay path mode");
+  bool branch = (*replayPath)[replayPosition++];
+
+  // The conditions are only checked together once the prefix is done, and
+  // neither are the unsatisfiability cores marked in the tree: the path
+  // does not split while it is replayed
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(condition)) {
+    assert(CE->isTrue() == branch && "hit invalid branch in replay path mode");
+    (void)CE;
+  } else {
+    current.deferredConstraints.push_back(
+        std::make_pair(branch ? condition : Expr::createIsZero(condition),
+                       current.prevPC->inst));
+  }
+
+  if (pathWriter)
+    current.pathOS << (branch ? "1" : "0");
+
+  if (replayPosition == ReplayPathFastForward && !materializeState(current)) {
+    result = StatePair(0, 0);
+    return true;
+  }
+
+  result = branch ? StatePair(&current, 0) : StatePair(0, &current);
+  return true;
+}
+
+bool Executor::materializeState(ExecutionState &state) {
+  if (state.deferredConstraints.empty())
+    return true;
+
+  ref<Expr> conjunction = ConstantExpr::alloc(1, Expr::Bool);
+  for (std::vector<std::pair<ref<Expr>, llvm::Instruction *> >::iterator
+           it = state.deferredConstraints.begin(),
+           ie = state.deferredConstraints.end();
+       it != ie; ++it)
+    conjunction = AndExpr::create(conjunction, it->first);
+
+  bool feasible;
+  solver->setTimeout(coreSolverTimeout);
+  bool success = solver->mayBeTrue(state, conjunction, feasible);
+  solver->setTimeout(0);
+
+  if (!success || !feasible) {
+    state.pc = state.prevPC;
+    terminateStateEarly(state, success ? "infeasible replay path."
+                                       : "Query timed out (replay path).");
+    return false;
+  }
+
+  for (std::vector<std::pair<ref<Expr>, llvm::Instruction *> >::iterator
+           it = state.deferredConstraints.begin(),
+           ie = state.deferredConstraints.end();
+       it != ie; ++it) {
+    state.addConstraint(it->first, it->second);
+    if (ivcEnabled)
+      doImpliedValueConcretization(state, it->first,
+                                   ConstantExpr::alloc(1, Expr::Bool));
+  }
+  state.deferredConstraints.clear();
+  return true;
+}
+
+bool Executor::evaluateSeedsConcretely(std::vector<SeedInfo> &seeds,
+                                       ref<Expr> condition,
+                                       std::vector<bool> &values) {
+  values.clear();
+  for (std::vector<SeedInfo>::iterator siit = seeds.begin(),
+                                       siie = seeds.end();
+       siit != siie; ++siit) {
+    ConstantExpr *CE =
+        dyn_cast<ConstantExpr>(siit->assignment.evaluate(condition));
+    if (!CE) {
+      values.clear();
+      return false;
+    }
+    values.push_back(CE->isTrue());
+  }
+  return true;
+}
+
+void Executor::evaluateSeeds(ExecutionState &state,
+                             std::vector<SeedInfo> &seeds,
+                             ref<Expr> condition, std::vector<bool> &values) {
+  values.clear();
+  std::map<ref<Expr>, bool> residues;
+  for (std::vector<SeedInfo>::iterator siit = seeds.begin(),
+                                       siie = seeds.end();
+       siit != siie; ++siit) {
+    ref<Expr> residue = siit->assignment.evaluate(condition);
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(residue)) {
+      values.push_back(CE->isTrue());
+      continue;
+    }
+    // The seeds that leave the same part of the condition symbolic share
+    // the query
+    std::map<ref<Expr>, bool>::iterator rit = residues.find(residue);
+    if (rit == residues.end()) {
+      ref<ConstantExpr> value;
+      bool success = solver->getValue(state, residue, value);
+      assert(success && "FIXME: Unhandled solver failure");
+      (void)success;
+      rit = residues.insert(std::make_pair(residue, value->isTrue())).first;
+    }
+    values.push_back(rit->second);
+  }
+}
+
+bool Executor::hasSeedValue(const std::vector<bool> &values, bool value) {
+  return std::find(values.begin(), values.end(), value) != values.end();
+}
+
 std::set<std::string> Executor::extractVarNames(ExecutionState &current,
                                                 llvm::Value *v) {
   std::set<std::string> res;
@@ -1042,8 +1495,29 @@ std::set<std::string> Executor::extractVarNames(ExecutionState &current,
   return res;
 }
 
+bool Executor::isSpecIndependent(ExecutionState &current,
+                                 llvm::Instruction *binst) {
+  // The variables of a branch are determined by the program alone, and the
+  // avoidance sets are fixed at startup, hence the result is memoised.
+  std::map<llvm::Instruction *, bool>::const_iterator it =
+      specIndependence.find(binst);
+  if (it != specIndependence.end())
+    return it->second;
+
+  std::set<std::string> vars = extractVarNames(current, binst);
+  bool independent =
+      TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid);
+  specIndependence[binst] = independent;
+  return independent;
+}
+
 Executor::StatePair Executor::branchFork(ExecutionState &current,
                                          ref<Expr> condition, bool isInternal) {
+  SamplingProfiler::Scope phase(SamplingProfiler::Fork);
+  StatePair fastForwarded;
+  if (fastForwardReplay(current, condition, isInternal, fastForwarded))
+    return fastForwarded;
+
   start = clock();
   // The current node is in the speculation node
   if (INTERPOLATION_ENABLED && SpecTypeToUse != NO_SPEC &&
@@ -1061,6 +1535,11 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
       seedMap.find(&current);
   bool isSeeding = it != seedMap.end();
 
+  // Whether each seed satisfies the condition, when known
+  std::vector<bool> seedValues;
+  bool seedsConcrete =
+      isSeeding && evaluateSeedsConcretely(it->second, condition, seedValues);
+
   if (!isSeeding && !isa<ConstantExpr>(condition) &&
       (MaxStaticForkPct != 1. || MaxStaticSolvePct != 1. ||
        MaxStaticCPForkPct != 1. || MaxStaticCPSolvePct != 1.) &&
@@ -1095,13 +1574,35 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
   // llvm::errs() << "Calling solver->evaluate on query:\n";
   // ExprPPrinter::printQuery(llvm::errs(), current.constraints, condition);
 
-  solver->setTimeout(timeout);
   std::vector<ref<Expr> > unsatCore;
-  bool success = solver->evaluate(current, condition, res, unsatCore);
-  solver->setTimeout(0);
+  bool success = true, solvedInBackground = false;
+  if (seedsConcrete &&
+      ((hasSeedValue(seedValues, true) && hasSeedValue(seedValues, false)) ||
+       current.forkDisabled || OnlyReplaySeeds)) {
+    // The seeds satisfy the constraints, hence a seed on each side shows
+    // that both are feasible, and a fixed branch follows the seeds anyway
+    res = Solver::Unknown;
+  } else if (backgroundSolver &&
+             backgroundSolver->takeResult(current, condition, success, res)) {
+    // The state was parked at this branch while its query was solved
+    solvedInBackground = true;
+  } else {
+    solver->setTimeout(timeout);
+    success = solver->evaluate(current, condition, res, unsatCore);
+    solver->setTimeout(0);
+  }
 
   if (!success) {
     current.pc = current.prevPC;
+    // Park the state at the branch, which is executed again once the query
+    // is solved in the background
+    if (backgroundSolver && !isSeeding && !isInternal && !solvedInBackground &&
+        backgroundSolver->start(current, condition)) {
+      klee_warning_once(0, "solving a timed-out branch query in the "
+                           "background");
+      parkedStates.push_back(&current);
+      return StatePair(0, 0);
+    }
     terminateStateEarly(current, "Query timed out (fork).");
     return StatePair(0, 0);
   }
@@ -1157,24 +1658,11 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
   // and false seeds.
   if (isSeeding && (current.forkDisabled || OnlyReplaySeeds) &&
       res == Solver::Unknown) {
-    bool trueSeed = false, falseSeed = false;
     // Is seed extension still ok here?
-    for (std::vector<SeedInfo>::iterator siit = it->second.begin(),
-                                         siie = it->second.end();
-         siit != siie; ++siit) {
-      ref<ConstantExpr> res;
-      bool success =
-          solver->getValue(current, siit->assignment.evaluate(condition), res);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void)success;
-      if (res->isTrue()) {
-        trueSeed = true;
-      } else {
-        falseSeed = true;
-      }
-      if (trueSeed && falseSeed)
-        break;
-    }
+    if (!seedsConcrete)
+      evaluateSeeds(current, it->second, condition, seedValues);
+    bool trueSeed = hasSeedValue(seedValues, true),
+         falseSeed = hasSeedValue(seedValues, false);
     if (!(trueSeed && falseSeed)) {
       assert(trueSeed || falseSeed);
 
@@ -1200,7 +1688,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
           // open speculation & result may be success or fail
           StatsTracker::increaseEle(curBB, 0, true);
           return addSpeculationNode(current, condition, binst, isInternal,
-                                    true);
+                                    true, unsatCore);
         } else if (SpecStrategyToUse == CUSTOM) {
           // open speculation & result may be success or fail and Now second
           // check
@@ -1208,7 +1696,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
             dynamicYes++;
             StatsTracker::increaseEle(curBB, 0, true);
             return addSpeculationNode(current, condition, binst, isInternal,
-                                      true);
+                                      true, unsatCore);
           } else {
             dynamicNo++;
             // then close speculation & do marking as deletion
@@ -1218,8 +1706,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
         }
       } else {
         if (SpecStrategyToUse == TIMID) {
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             independenceYes++;
             StatsTracker::increaseEle(curBB, 0, true);
             StatsTracker::increaseEle(curBB, 2, false);
@@ -1230,8 +1717,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
           return StatePair(&current, 0);
         } else if (SpecStrategyToUse == AGGRESSIVE) {
           // check independency
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             // open speculation & assume success
             independenceYes++;
             StatsTracker::increaseEle(curBB, 0, true);
@@ -1242,12 +1728,11 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
             independenceNo++;
             StatsTracker::increaseEle(curBB, 0, true);
             return addSpeculationNode(current, condition, binst, isInternal,
-                                      true);
+                                      true, unsatCore);
           }
         } else if (SpecStrategyToUse == CUSTOM) {
           // check independency
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             // open speculation & assume success
             independenceYes++;
             //          StatsTracker::increaseEle(curBB, 0, true);
@@ -1261,7 +1746,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
               dynamicYes++;
               StatsTracker::increaseEle(curBB, 0, true);
               return addSpeculationNode(current, condition, binst, isInternal,
-                                        true);
+                                        true, unsatCore);
             } else {
               dynamicNo++;
               // then close speculation & do marking as deletion
@@ -1288,7 +1773,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
           // open speculation & result may be success or fail
           StatsTracker::increaseEle(curBB, 0, true);
           return addSpeculationNode(current, condition, binst, isInternal,
-                                    false);
+                                    false, unsatCore);
         } else if (SpecStrategyToUse == CUSTOM) {
           // open speculation & result may be success or fail and Now second
           // check
@@ -1296,7 +1781,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
             dynamicYes++;
             StatsTracker::increaseEle(curBB, 0, true);
             return addSpeculationNode(current, condition, binst, isInternal,
-                                      false);
+                                      false, unsatCore);
           } else {
             dynamicNo++;
             // then close speculation & do marking as deletion
@@ -1306,8 +1791,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
         }
       } else {
         if (SpecStrategyToUse == TIMID) {
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             independenceYes++;
             StatsTracker::increaseEle(curBB, 0, true);
             StatsTracker::increaseEle(curBB, 2, false);
@@ -1317,8 +1801,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
           }
           return StatePair(0, &current);
         } else if (SpecStrategyToUse == AGGRESSIVE) {
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             // open speculation & assume success
             independenceYes++;
             StatsTracker::increaseEle(curBB, 0, true);
@@ -1329,11 +1812,10 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
             independenceNo++;
             StatsTracker::increaseEle(curBB, 0, true);
             return addSpeculationNode(current, condition, binst, isInternal,
-                                      false);
+                                      false, unsatCore);
           }
         } else if (SpecStrategyToUse == CUSTOM) {
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             // open speculation & assume success
             independenceYes++;
             //          StatsTracker::increaseEle(curBB, 0, true);
@@ -1347,7 +1829,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
               dynamicYes++;
               StatsTracker::increaseEle(curBB, 0, true);
               return addSpeculationNode(current, condition, binst, isInternal,
-                                        false);
+                                        false, unsatCore);
             } else {
               dynamicNo++;
               // then close speculation & do marking as deletion
@@ -1391,7 +1873,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
           StatsTracker::increaseEle(curBB, 0, true);
           txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
           return addSpeculationNode(current, condition, binst, isInternal,
-                                    true);
+                                    true, unsatCore);
         } else if (SpecStrategyToUse == CUSTOM) {
           // save unsat core
           // open speculation & result may be success or fail
@@ -1400,7 +1882,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
             StatsTracker::increaseEle(curBB, 0, true);
             txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
             return addSpeculationNode(current, condition, binst, isInternal,
-                                      true);
+                                      true, unsatCore);
           } else {
             dynamicNo++;
             // then close speculation & do marking as deletion
@@ -1410,8 +1892,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
         }
       } else {
         if (SpecStrategyToUse == TIMID) {
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             // open speculation & assume success
             independenceYes++;
             StatsTracker::increaseEle(curBB, 0, true);
@@ -1425,8 +1906,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
             return StatePair(&current, 0);
           }
         } else if (SpecStrategyToUse == AGGRESSIVE) {
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             // open speculation & assume success
             independenceYes++;
             StatsTracker::increaseEle(curBB, 0, true);
@@ -1439,11 +1919,10 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
             StatsTracker::increaseEle(curBB, 0, true);
             txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
             return addSpeculationNode(current, condition, binst, isInternal,
-                                      true);
+                                      true, unsatCore);
           }
         } else if (SpecStrategyToUse == CUSTOM) {
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             // open speculation & assume success
             independenceYes++;
             //          StatsTracker::increaseEle(curBB, 0, true);
@@ -1458,7 +1937,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
               StatsTracker::increaseEle(curBB, 0, true);
               txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
               return addSpeculationNode(current, condition, binst, isInternal,
-                                        true);
+                                        true, unsatCore);
             } else {
               dynamicNo++;
               // then close speculation & do marking as deletion
@@ -1504,7 +1983,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
           StatsTracker::increaseEle(curBB, 0, true);
           txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
           return addSpeculationNode(current, condition, binst, isInternal,
-                                    false);
+                                    false, unsatCore);
         } else if (SpecStrategyToUse == CUSTOM) {
           // save unsat core
           // open speculation & result may be success or fail
@@ -1513,7 +1992,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
             StatsTracker::increaseEle(curBB, 0, true);
             txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
             return addSpeculationNode(current, condition, binst, isInternal,
-                                      false);
+                                      false, unsatCore);
           } else {
             dynamicNo++;
             // then close speculation & do marking as deletion
@@ -1523,8 +2002,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
         }
       } else {
         if (SpecStrategyToUse == TIMID) {
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             // open speculation & assume success
             independenceYes++;
             StatsTracker::increaseEle(curBB, 0, true);
@@ -1538,8 +2016,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
             return StatePair(0, &current);
           }
         } else if (SpecStrategyToUse == AGGRESSIVE) {
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             // open speculation & assume success
             independenceYes++;
             StatsTracker::increaseEle(curBB, 0, true);
@@ -1552,12 +2029,11 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
             StatsTracker::increaseEle(curBB, 0, true);
             txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
             return addSpeculationNode(current, condition, binst, isInternal,
-                                      false);
+                                      false, unsatCore);
           }
         } else if (SpecStrategyToUse == CUSTOM) {
 
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             // open speculation & assume success
             independenceYes++;
             //          StatsTracker::increaseEle(curBB, 0, true);
@@ -1572,7 +2048,7 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
               StatsTracker::increaseEle(curBB, 0, true);
               txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
               return addSpeculationNode(current, condition, binst, isInternal,
-                                        false);
+                                        false, unsatCore);
             } else {
               dynamicNo++;
               // then close speculation & do marking as deletion
@@ -1608,22 +2084,17 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
       std::swap(trueState, falseState);
 
     if (it != seedMap.end()) {
+      if (seedValues.size() != it->second.size())
+        evaluateSeeds(current, it->second, condition, seedValues);
       std::vector<SeedInfo> seeds = it->second;
       it->second.clear();
       std::vector<SeedInfo> &trueSeeds = seedMap[trueState];
       std::vector<SeedInfo> &falseSeeds = seedMap[falseState];
-      for (std::vector<SeedInfo>::iterator siit = seeds.begin(),
-                                           siie = seeds.end();
-           siit != siie; ++siit) {
-        ref<ConstantExpr> res;
-        bool success = solver->getValue(
-            current, siit->assignment.evaluate(condition), res);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void)success;
-        if (res->isTrue()) {
-          trueSeeds.push_back(*siit);
+      for (unsigned i = 0; i < seeds.size(); ++i) {
+        if (seedValues[i]) {
+          trueSeeds.push_back(seeds[i]);
         } else {
-          falseSeeds.push_back(*siit);
+          falseSeeds.push_back(seeds[i]);
         }
       }
 
@@ -1644,11 +2115,9 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
       }
     }
 
-    current.ptreeNode->data = 0;
-    std::pair<PTree::Node *, PTree::Node *> res =
-        processTree->split(current.ptreeNode, falseState, trueState);
-    falseState->ptreeNode = res.first;
-    trueState->ptreeNode = res.second;
+    splitProcessTree(current, falseState, trueState);
+    if (checkpointer)
+      checkpointer->split(falseState, trueState);
 
     if (!isInternal) {
       if (pathWriter) {
@@ -1684,11 +2153,59 @@ Executor::StatePair Executor::branchFork(ExecutionState &current,
   }
 }
 
-Executor::StatePair Executor::addSpeculationNode(ExecutionState &current,
-                                                 ref<Expr> condition,
-                                                 llvm::Instruction *binst,
-                                                 bool isInternal,
-                                                 bool falseBranchIsInfeasible) {
+bool Executor::isSpecBoundToFail(llvm::BasicBlock *target) {
+  std::set<llvm::BasicBlock *> seen;
+  for (llvm::BasicBlock *bb = target; bb;) {
+    if (SpecTypeToUse == COVERAGE &&
+        visitedBlocks.find(bb) == visitedBlocks.end())
+      return true;
+    if (!seen.insert(bb).second)
+      return true;
+
+    KFunction *kf = kmodule->functionMap[bb->getParent()];
+    if (kf->instructions[kf->basicBlockEntry[bb]]->hasTableEntry)
+      return false;
+    for (llvm::BasicBlock::iterator it = bb->begin(), ie = bb->end(); it != ie;
+         ++it) {
+      if (isa<CallInst>(it) || isa<InvokeInst>(it) || isa<LoadInst>(it) ||
+          isa<StoreInst>(it) || isa<AllocaInst>(it))
+        return false;
+      if (it->getOpcode() == Instruction::UDiv ||
+          it->getOpcode() == Instruction::SDiv ||
+          it->getOpcode() == Instruction::URem ||
+          it->getOpcode() == Instruction::SRem)
+        return false;
+    }
+
+    BranchInst *bi = dyn_cast<BranchInst>(bb->getTerminator());
+    bb = bi && bi->isUnconditional() ? bi->getSuccessor(0) : 0;
+  }
+  return false;
+}
+
+Executor::StatePair Executor::addSpeculationNode(
+    ExecutionState &current, ref<Expr> condition, llvm::Instruction *binst,
+    bool isInternal, bool falseBranchIsInfeasible,
+    std::vector<ref<Expr> > &unsatCore) {
+  // Only the opening of a speculation tree is controlled, not the branching
+  // inside it. A speculation bound to fail is not opened at all, as its
+  // failure would roll back the whole speculation tree it is in.
+  llvm::BranchInst *bi = llvm::dyn_cast_or_null<llvm::BranchInst>(binst);
+  bool boundToFail =
+      bi && isSpecBoundToFail(bi->getSuccessor(falseBranchIsInfeasible ? 1 : 0));
+  if (boundToFail ||
+      (!current.txTreeNode->isSpeculationNode() &&
+       !TxSpeculationController::shouldSpeculate(binst))) {
+    if (boundToFail)
+      ++specBoundToFail;
+    // Undo the count of the speculation taken as opened
+    --StatsTracker::bbSpecCount[current.txTreeNode->getBasicBlock()][0];
+    // then close speculation & do marking as deletion
+    txTree->markPathCondition(current, unsatCore);
+    return falseBranchIsInfeasible ? StatePair(&current, 0)
+                                   : StatePair(0, &current);
+  }
+
   current.txTreeNode->secondCheckInst = binst;
   if (falseBranchIsInfeasible == true) {
     // At this point the speculation node should be created and
@@ -1703,11 +2220,9 @@ Executor::StatePair Executor::addSpeculationNode(ExecutionState &current,
     trueState = speculationFalseState->branch();
     addedStates.push_back(trueState);
 
-    current.ptreeNode->data = 0;
-    std::pair<PTree::Node *, PTree::Node *> res =
-        processTree->split(current.ptreeNode, speculationFalseState, trueState);
-    speculationFalseState->ptreeNode = res.first;
-    trueState->ptreeNode = res.second;
+    splitProcessTree(current, speculationFalseState, trueState);
+    if (checkpointer)
+      checkpointer->split(speculationFalseState, trueState);
 
     if (!isInternal) {
       if (pathWriter) {
@@ -1732,6 +2247,8 @@ Executor::StatePair Executor::addSpeculationNode(ExecutionState &current,
       speculationFalseState->txTreeNode->visitedProgramPoints =
           new std::set<uintptr_t>();
       speculationFalseState->txTreeNode->specTime = new double(0.0);
+      if (speculationWorkers)
+        speculationRoots.push_back(speculationFalseState);
     }
     trueState->txTreeNode = ires.second;
 
@@ -1753,11 +2270,9 @@ Executor::StatePair Executor::addSpeculationNode(ExecutionState &current,
     falseState = speculationTrueState->branch();
     addedStates.push_back(falseState);
 
-    current.ptreeNode->data = 0;
-    std::pair<PTree::Node *, PTree::Node *> res =
-        processTree->split(current.ptreeNode, speculationTrueState, falseState);
-    speculationTrueState->ptreeNode = res.first;
-    falseState->ptreeNode = res.second;
+    splitProcessTree(current, speculationTrueState, falseState);
+    if (checkpointer)
+      checkpointer->split(falseState, speculationTrueState);
 
     if (!isInternal) {
       if (pathWriter) {
@@ -1782,6 +2297,8 @@ Executor::StatePair Executor::addSpeculationNode(ExecutionState &current,
       speculationTrueState->txTreeNode->visitedProgramPoints =
           new std::set<uintptr_t>();
       speculationTrueState->txTreeNode->specTime = new double(0.0);
+      if (speculationWorkers)
+        speculationRoots.push_back(speculationTrueState);
     }
 
     falseState->txTreeNode = ires.second;
@@ -1831,13 +2348,13 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
         } else if (SpecStrategyToUse == AGGRESSIVE) {
           // open speculation & result may be success or fail
           return addSpeculationNode(current, condition, binst, isInternal,
-                                    true);
+                                    true, unsatCore);
         } else if (SpecStrategyToUse == CUSTOM) {
           // open speculation & result may be success or fail
           if (specSnap[binst] != visitedBlocks.size()) {
             //            dynamicYes++;
             return addSpeculationNode(current, condition, binst, isInternal,
-                                      true);
+                                      true, unsatCore);
           } else {
             //            dynamicNo++;
             // then close speculation & do marking as deletion
@@ -1852,11 +2369,10 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
         } else if (SpecStrategyToUse == AGGRESSIVE) {
           // open speculation & result may be success or fail
           return addSpeculationNode(current, condition, binst, isInternal,
-                                    true);
+                                    true, unsatCore);
         } else if (SpecStrategyToUse == CUSTOM) {
 
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             // open speculation & assume success
             //          independenceYes++;
             return StatePair(&current, 0);
@@ -1866,7 +2382,7 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
             if (specSnap[binst] != visitedBlocks.size()) {
               //            dynamicYes++;
               return addSpeculationNode(current, condition, binst, isInternal,
-                                        true);
+                                        true, unsatCore);
             } else {
               //            dynamicNo++;
               // then close speculation & do marking as deletion
@@ -1887,13 +2403,13 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
         } else if (SpecStrategyToUse == AGGRESSIVE) {
           // open speculation & result may be success or fail
           return addSpeculationNode(current, condition, binst, isInternal,
-                                    false);
+                                    false, unsatCore);
         } else if (SpecStrategyToUse == CUSTOM) {
           // open speculation & result may be success or fail
           if (specSnap[binst] != visitedBlocks.size()) {
             //            dynamicYes++;
             return addSpeculationNode(current, condition, binst, isInternal,
-                                      false);
+                                      false, unsatCore);
           } else {
             //            dynamicNo++;
             // then close speculation & do marking as deletion
@@ -1908,10 +2424,9 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
         } else if (SpecStrategyToUse == AGGRESSIVE) {
           // open speculation & result may be success or fail
           return addSpeculationNode(current, condition, binst, isInternal,
-                                    false);
+                                    false, unsatCore);
         } else if (SpecStrategyToUse == CUSTOM) {
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             // open speculation & assume success
             //          independenceYes++;
             return StatePair(0, &current);
@@ -1921,7 +2436,7 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
             if (specSnap[binst] != visitedBlocks.size()) {
               //            dynamicYes++;
               return addSpeculationNode(current, condition, binst, isInternal,
-                                        false);
+                                        false, unsatCore);
             } else {
               //            dynamicNo++;
               // then close speculation & do marking as deletion
@@ -1955,7 +2470,7 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
         } else if (SpecStrategyToUse == AGGRESSIVE) {
           txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
           return addSpeculationNode(current, condition, binst, isInternal,
-                                    true);
+                                    true, unsatCore);
         } else if (SpecStrategyToUse == CUSTOM) {
           // save unsat core
           // open speculation & result may be success or fail
@@ -1963,7 +2478,7 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
             //            dynamicYes++;
             txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
             return addSpeculationNode(current, condition, binst, isInternal,
-                                      true);
+                                      true, unsatCore);
           } else {
             //            dynamicNo++;
             // then close speculation & do marking as deletion
@@ -1978,10 +2493,9 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
         } else if (SpecStrategyToUse == AGGRESSIVE) {
           txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
           return addSpeculationNode(current, condition, binst, isInternal,
-                                    true);
+                                    true, unsatCore);
         } else if (SpecStrategyToUse == CUSTOM) {
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             // open speculation & assume success
             //          independenceYes++;
             return StatePair(&current, 0);
@@ -1993,7 +2507,7 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
               //            dynamicYes++;
               txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
               return addSpeculationNode(current, condition, binst, isInternal,
-                                        true);
+                                        true, unsatCore);
             } else {
               //            dynamicNo++;
               // then close speculation & do marking as deletion
@@ -2033,7 +2547,7 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
         } else if (SpecStrategyToUse == AGGRESSIVE) {
           txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
           return addSpeculationNode(current, condition, binst, isInternal,
-                                    false);
+                                    false, unsatCore);
         } else if (SpecStrategyToUse == CUSTOM) {
           // save unsat core
           // open speculation & result may be success or fail
@@ -2041,7 +2555,7 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
             //            dynamicYes++;
             txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
             return addSpeculationNode(current, condition, binst, isInternal,
-                                      false);
+                                      false, unsatCore);
           } else {
             //            dynamicNo++;
             // then close speculation & do marking as deletion
@@ -2056,10 +2570,9 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
         } else if (SpecStrategyToUse == AGGRESSIVE) {
           txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
           return addSpeculationNode(current, condition, binst, isInternal,
-                                    false);
+                                    false, unsatCore);
         } else if (SpecStrategyToUse == CUSTOM) {
-          std::set<std::string> vars = extractVarNames(current, binst);
-          if (TxSpeculationHelper::isIndependent(vars, bbOrderToSpecAvoid)) {
+          if (isSpecIndependent(current, binst)) {
             // open speculation & assume success
             //          independenceYes++;
             return StatePair(0, &current);
@@ -2071,7 +2584,7 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
               //            dynamicYes++;
               txTree->storeSpeculationUnsatCore(solver, unsatCore, binst);
               return addSpeculationNode(current, condition, binst, isInternal,
-                                        false);
+                                        false, unsatCore);
             } else {
               //            dynamicNo++;
               // then close speculation & do marking as deletion
@@ -2108,11 +2621,9 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
     if (RandomizeFork && theRNG.getBool())
       std::swap(trueState, falseState);
 
-    current.ptreeNode->data = 0;
-    std::pair<PTree::Node *, PTree::Node *> resNode =
-        processTree->split(current.ptreeNode, falseState, trueState);
-    falseState->ptreeNode = resNode.first;
-    trueState->ptreeNode = resNode.second;
+    splitProcessTree(current, falseState, trueState);
+    if (checkpointer)
+      checkpointer->split(falseState, trueState);
 
     if (!isInternal) {
       if (pathWriter) {
@@ -2150,6 +2661,9 @@ Executor::StatePair Executor::speculationFork(ExecutionState &current,
 }
 
 void Executor::speculativeBackJump(ExecutionState &current) {
+  // A worker only decides the outcome, which the executor acts upon
+  if (isSpeculationWorker())
+    speculationWorkers->finish(SpeculationWorkers::Failure);
 
   double thisSpecTreeTime = *(current.txTreeNode->specTime);
   // identify the speculation root
@@ -2171,13 +2685,15 @@ void Executor::speculativeBackJump(ExecutionState &current) {
   // collect & mark speculation fail all nodes in the sub tree
   std::vector<TxTreeNode *> deletedNodes = collectSpeculationNodes(currentNode);
 
-  // collect removed states which pointing to speculation fail node
+  // collect removed states which pointing to speculation fail node: these
+  // are at the leaves of the subtree, as a node is removed with its state
   std::vector<ExecutionState *> removedSpeculationStates;
-  for (std::set<ExecutionState *>::const_iterator it = states.begin(),
-                                                  ie = states.end();
+  for (std::vector<TxTreeNode *>::iterator it = deletedNodes.begin(),
+                                           ie = deletedNodes.end();
        it != ie; ++it) {
-    ExecutionState *tmp = (*it);
-    if (tmp->txTreeNode->isSpeculationFailedNode()) {
+    ExecutionState *tmp = (*it)->state;
+    if (!(*it)->getLeft() && !(*it)->getRight() && tmp &&
+        states.count(tmp) && tmp->txTreeNode == *it) {
       removedSpeculationStates.push_back(tmp);
     }
   }
@@ -2206,21 +2722,30 @@ void Executor::speculativeBackJump(ExecutionState &current) {
 
   // add fail time for spec subtree
   totalSpecFailTime += thisSpecTreeTime;
+  TxSpeculationController::recordFailure(parent->secondCheckInst,
+                                         thisSpecTreeTime);
 }
 
 std::vector<TxTreeNode *> Executor::collectSpeculationNodes(TxTreeNode *root) {
-  if (!root)
-    return std::vector<TxTreeNode *>();
-  std::vector<TxTreeNode *> leftNodes =
-      collectSpeculationNodes(root->getLeft());
-  std::vector<TxTreeNode *> rightNodes =
-      collectSpeculationNodes(root->getRight());
   std::vector<TxTreeNode *> result;
-  result.insert(result.end(), leftNodes.begin(), leftNodes.end());
-  result.insert(result.end(), rightNodes.begin(), rightNodes.end());
-  // mark root fail & add to result
-  root->setSpeculationFailed();
-  result.insert(result.end(), root);
+  if (!root)
+    return result;
+
+  // Collect the nodes in preorder, whose reverse has the children before
+  // their parent, as required for their removal
+  std::vector<TxTreeNode *> worklist(1, root);
+  while (!worklist.empty()) {
+    TxTreeNode *node = worklist.back();
+    worklist.pop_back();
+    // mark fail & add to result
+    node->setSpeculationFailed();
+    result.push_back(node);
+    if (node->getRight())
+      worklist.push_back(node->getRight());
+    if (node->getLeft())
+      worklist.push_back(node->getLeft());
+  }
+  std::reverse(result.begin(), result.end());
   return result;
 }
 
@@ -2236,14 +2761,27 @@ void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
       seedMap.find(&state);
   if (it != seedMap.end()) {
     bool warn = false;
+    // The seeds that leave the same part of the condition symbolic share
+    // the query
+    std::map<ref<Expr>, bool> violations;
     for (std::vector<SeedInfo>::iterator siit = it->second.begin(),
                                          siie = it->second.end();
          siit != siie; ++siit) {
+      ref<Expr> residue = siit->assignment.evaluate(condition);
       bool res;
-      bool success =
-          solver->mustBeFalse(state, siit->assignment.evaluate(condition), res);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void)success;
+      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(residue)) {
+        res = CE->isFalse();
+      } else {
+        std::map<ref<Expr>, bool>::iterator vit = violations.find(residue);
+        if (vit != violations.end()) {
+          res = vit->second;
+        } else {
+          bool success = solver->mustBeFalse(state, residue, res);
+          assert(success && "FIXME: Unhandled solver failure");
+          (void)success;
+          violations[residue] = res;
+        }
+      }
       if (res) {
         siit->patchSeed(state, condition, solver);
         warn = true;
@@ -2570,6 +3108,15 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
     if (InvokeInst *ii = dyn_cast<InvokeInst>(i))
       transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
   } else {
+    // The bulk memory functions are run in the executor when their ranges
+    // allow, their bodies being run otherwise
+    if (specialFunctionHandler->handleMemoryFunction(state, f, ki,
+                                                     arguments)) {
+      if (InvokeInst *ii = dyn_cast<InvokeInst>(i))
+        transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
+      return;
+    }
+
     // FIXME: I'm not really happy about this reliance on prevPC but it is ok, I
     // guess. This just done to avoid having to pass KInstIterator everywhere
     // instead of the actual instruction, since we can't make a KInstIterator
@@ -2806,12 +3353,14 @@ Function *Executor::getTargetFunction(Value *calledVal, ExecutionState &state) {
   if (!c)
     return 0;
 
+  // The names of the callees are only built for the paths with aliases
+  bool hasAliases = state.hasFnAliases();
   while (true) {
     if (GlobalValue *gv = dyn_cast<GlobalValue>(c)) {
       if (!Visited.insert(gv))
         return 0;
 
-      std::string alias = state.getFnAlias(gv->getName());
+      std::string alias = hasAliases ? state.getFnAlias(gv->getName()) : "";
       if (alias != "") {
         llvm::Module *currModule = kmodule->module;
         GlobalValue *old_gv = gv;
@@ -2854,6 +3403,93 @@ static inline const llvm::fltSemantics *fpWidthToSemantics(unsigned width) {
   }
 }
 
+/// Whether the host computes the float and double operations in their own
+/// formats. Its rounding mode is left at round to nearest even, as in the
+/// APFloat operations of the interpreter, such that the concrete operations
+/// of the IEEE single and double formats are computed natively.
+#if defined(__FLT_EVAL_METHOD__) && __FLT_EVAL_METHOD__ == 0
+static const bool NativeFloatEvaluation = true;
+#else
+static const bool NativeFloatEvaluation = false;
+#endif
+
+static inline bool isNativeFloat(unsigned width) {
+  return NativeFloatEvaluation &&
+         (width == floats::FLT_BITS || width == floats::DBL_BITS);
+}
+
+/// Compute a concrete floating point binary operation natively. Returns null
+/// when it is left to APFloat, also when the result is a NaN, whose payload
+/// the host may choose otherwise.
+static ref<Expr> evalNativeFloat(unsigned opcode,
+                                 const ref<klee::ConstantExpr> &left,
+                                 const ref<klee::ConstantExpr> &right) {
+  unsigned width = left->getWidth();
+  if (!isNativeFloat(width) || right->getWidth() != width)
+    return ref<Expr>();
+
+  uint64_t l = left->getZExtValue(), r = right->getZExtValue(), res;
+  switch (opcode) {
+  case Instruction::FAdd:
+    res = floats::add(l, r, width);
+    break;
+  case Instruction::FSub:
+    res = floats::sub(l, r, width);
+    break;
+  case Instruction::FMul:
+    res = floats::mul(l, r, width);
+    break;
+  case Instruction::FDiv:
+    res = floats::div(l, r, width);
+    break;
+  default:
+    return ref<Expr>();
+  }
+  if (floats::isNaN(res, width))
+    return ref<Expr>();
+  return klee::ConstantExpr::alloc(res, width);
+}
+
+/// Whether a concrete float or double is converted natively to an integer of
+/// the given width, that is, when it is in the range of the integer once
+/// rounded toward zero, the conversion of the host being undefined otherwise.
+static bool isNativeFloatToInt(const ref<klee::ConstantExpr> &arg,
+                               unsigned resultWidth, bool isSigned) {
+  unsigned width = arg->getWidth();
+  if (!isNativeFloat(width) || !resultWidth || resultWidth > 64)
+    return false;
+
+  uint64_t bits = arg->getZExtValue();
+  double value = (width == floats::FLT_BITS ? floats::UInt64AsFloat(bits)
+                                            : floats::UInt64AsDouble(bits));
+  if (floats::isNaN(bits, width))
+    return false;
+  double limit = std::ldexp(1.0, isSigned ? resultWidth - 1 : resultWidth);
+  return isSigned ? value > -limit - 1 && value < limit
+                  : value > -1 && value < limit;
+}
+
+/// Compare two concrete floats or doubles natively, returning false when the
+/// comparison is left to APFloat
+static bool compareNativeFloat(const ref<klee::ConstantExpr> &left,
+                               const ref<klee::ConstantExpr> &right,
+                               APFloat::cmpResult &res) {
+  unsigned width = left->getWidth();
+  if (!isNativeFloat(width) || right->getWidth() != width)
+    return false;
+
+  uint64_t l = left->getZExtValue(), r = right->getZExtValue();
+  if (floats::isNaN(l, width) || floats::isNaN(r, width))
+    res = APFloat::cmpUnordered;
+  else if (floats::lt(l, r, width))
+    res = APFloat::cmpLessThan;
+  else if (floats::gt(l, r, width))
+    res = APFloat::cmpGreaterThan;
+  else
+    res = APFloat::cmpEqual;
+  return true;
+}
+
 void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   Instruction *i = ki->inst;
   // if this is starting a new BB then
@@ -2920,7 +3556,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   if (INTERPOLATION_ENABLED && WPInterpolant)
     txTree->storeInstruction(ki, state.incomingBBIndex);
 
-  switch (i->getOpcode()) {
+  SamplingProfiler::instruction = ki;
+
+  switch (ki->opcode) {
   // Control flow
   case Instruction::Ret: {
     ReturnInst *ri = cast<ReturnInst>(i);
@@ -3115,70 +3753,79 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         expressionOrder.insert(std::make_pair(value, caseSuccessor));
       }
 
-      // Track default branch values
-      ref<Expr> defaultValue = ConstantExpr::alloc(1, Expr::Bool);
+      if (SwitchEnumeration) {
+        findSwitchTargets(state, si, cond, expressionOrder, bbOrder,
+                          branchTargets);
+      } else {
+        // Track default branch values
+        ref<Expr> defaultValue = ConstantExpr::alloc(1, Expr::Bool);
+
+        // iterate through all non-default cases but in order of the
+        // expressions
+        for (std::map<ref<Expr>, BasicBlock *>::iterator
+                 it = expressionOrder.begin(),
+                 itE = expressionOrder.end();
+             it != itE; ++it) {
+          std::vector<ref<Expr> > unsatCore;
+          ref<Expr> match = EqExpr::create(cond, it->first);
+
+          // Make sure that the default value does not contain this target's
+          // value
+          defaultValue =
+              AndExpr::create(defaultValue, Expr::createIsZero(match));
+
+          // Check if control flow could take this case
+          bool result;
+          bool success = solver->mayBeTrue(state, match, result, unsatCore);
+          assert(success && "FIXME: Unhandled solver failure");
+          (void)success;
+          if (result) {
+            BasicBlock *caseSuccessor = it->second;
+
+            // Handle the case that a basic block might be the target of
+            // multiple switch cases.
+            // Currently we generate an expression containing all switch-case
+            // values for the same target basic block. We spare us forking too
+            // many times but we generate more complex condition expressions
+            // TODO Add option to allow to choose between those behaviors
+            std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool>
+                res = branchTargets.insert(std::make_pair(
+                    caseSuccessor, ConstantExpr::alloc(0, Expr::Bool)));
+
+            res.first->second = OrExpr::create(match, res.first->second);
+
+            // Only add basic blocks which have not been target of a branch
+            // yet
+            if (res.second) {
+              bbOrder.push_back(caseSuccessor);
+            }
+          } else if (INTERPOLATION_ENABLED) {
+            // The solver returned no solution, which means there is an
+            // infeasible branch: Mark the unsatisfiability core
+            state.txTreeNode->unsatCoreInterpolation(unsatCore);
+          }
+        }
 
-      // iterate through all non-default cases but in order of the expressions
-      for (std::map<ref<Expr>, BasicBlock *>::iterator
-               it = expressionOrder.begin(),
-               itE = expressionOrder.end();
-           it != itE; ++it) {
+        // Check if control could take the default case
         std::vector<ref<Expr> > unsatCore;
-        ref<Expr> match = EqExpr::create(cond, it->first);
-
-        // Make sure that the default value does not contain this target's value
-        defaultValue = AndExpr::create(defaultValue, Expr::createIsZero(match));
-
-        // Check if control flow could take this case
-        bool result;
-        bool success = solver->mayBeTrue(state, match, result, unsatCore);
+        bool res;
+        bool success = solver->mayBeTrue(state, defaultValue, res, unsatCore);
         assert(success && "FIXME: Unhandled solver failure");
         (void)success;
-        if (result) {
-          BasicBlock *caseSuccessor = it->second;
-
-          // Handle the case that a basic block might be the target of multiple
-          // switch cases.
-          // Currently we generate an expression containing all switch-case
-          // values for the same target basic block. We spare us forking too
-          // many times but we generate more complex condition expressions
-          // TODO Add option to allow to choose between those behaviors
-          std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> res =
-              branchTargets.insert(std::make_pair(
-                  caseSuccessor, ConstantExpr::alloc(0, Expr::Bool)));
-
-          res.first->second = OrExpr::create(match, res.first->second);
-
-          // Only add basic blocks which have not been target of a branch yet
-          if (res.second) {
-            bbOrder.push_back(caseSuccessor);
+        if (res) {
+          std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> ret =
+              branchTargets.insert(
+                  std::make_pair(si->getDefaultDest(), defaultValue));
+          if (ret.second) {
+            bbOrder.push_back(si->getDefaultDest());
           }
         } else if (INTERPOLATION_ENABLED) {
-          // The solver returned no solution, which means there is an infeasible
-          // branch: Mark the unsatisfiability core
+          // The solver returned no solution, which means the default branch
+          // cannot be taken: Mark the unsatisfiability core
           state.txTreeNode->unsatCoreInterpolation(unsatCore);
         }
       }
 
-      // Check if control could take the default case
-      std::vector<ref<Expr> > unsatCore;
-      bool res;
-      bool success = solver->mayBeTrue(state, defaultValue, res, unsatCore);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void)success;
-      if (res) {
-        std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> ret =
-            branchTargets.insert(
-                std::make_pair(si->getDefaultDest(), defaultValue));
-        if (ret.second) {
-          bbOrder.push_back(si->getDefaultDest());
-        }
-      } else if (INTERPOLATION_ENABLED) {
-        // The solver returned no solution, which means the default branch
-        // cannot be taken: Mark the unsatisfiability core
-        state.txTreeNode->unsatCoreInterpolation(unsatCore);
-      }
-
       // Fork the current state with each state having one of the possible
       // successors of this switch
       std::vector<ref<Expr> > conditions;
@@ -3326,11 +3973,13 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     // Update dependency
     if (INTERPOLATION_ENABLED) {
+      if (!ki->isDependencyIrrelevant) {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 0)
-      txTree->executePHI(i, state.incomingBBIndex, result);
+        txTree->executePHI(i, state.incomingBBIndex, result);
 #else
-      txTree->executePHI(i, state.incomingBBIndex * 2, result);
+        txTree->executePHI(i, state.incomingBBIndex * 2, result);
 #endif
+      }
       if (txTree->getPhiValuesFlag())
         txTree->setPhiValue(i, result);
     }
@@ -3347,7 +3996,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, tExpr, fExpr);
     break;
   }
@@ -3365,7 +4014,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3377,7 +4026,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3389,7 +4038,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3401,7 +4050,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3413,7 +4062,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3425,7 +4074,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3437,7 +4086,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3449,7 +4098,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3461,7 +4110,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3473,7 +4122,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3485,7 +4134,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3497,7 +4146,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3509,7 +4158,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3607,7 +4256,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     }
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3642,97 +4291,83 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::GetElementPtr: {
     KGEPInstruction *kgepi = static_cast<KGEPInstruction *>(ki);
     ref<Expr> base = eval(ki, 0, state).value;
-    ref<Expr> address(base);
-    ref<Expr> offset(Expr::createPointer(0));
 
+    // The constant part of the offset is computed once by
+    // bindInstructionConstants, and is the whole offset of the static GEPs
+    ref<Expr> offset(Expr::createPointer(kgepi->offset));
     for (std::vector<std::pair<unsigned, uint64_t> >::iterator
              it = kgepi->indices.begin(),
              ie = kgepi->indices.end();
          it != ie; ++it) {
       uint64_t elementSize = it->second;
       ref<Expr> index = eval(ki, it->first, state).value;
-      address = AddExpr::create(
-          address, MulExpr::create(Expr::createSExtToPointerWidth(index),
-                                   Expr::createPointer(elementSize)));
-      if (INTERPOLATION_ENABLED) {
-        offset = AddExpr::create(
-            offset, MulExpr::create(Expr::createSExtToPointerWidth(index),
-                                    Expr::createPointer(elementSize)));
-      }
-    }
-    if (kgepi->offset) {
-      address = AddExpr::create(address, Expr::createPointer(kgepi->offset));
-      if (INTERPOLATION_ENABLED) {
-        offset = AddExpr::create(offset, Expr::createPointer(kgepi->offset));
-      }
+      offset = AddExpr::create(
+          offset, MulExpr::create(Expr::createSExtToPointerWidth(index),
+                                  Expr::createPointer(elementSize)));
     }
+    ref<Expr> address(base);
+    if (!offset->isZero())
+      address = AddExpr::create(base, offset);
     bindLocal(ki, state, address);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, address, base, offset);
     break;
   }
 
   // Conversion
   case Instruction::Trunc: {
-    CastInst *ci = cast<CastInst>(i);
     ref<Expr> arg = eval(ki, 0, state).value;
-    ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).value, 0,
-                                           getWidthForLLVMType(ci->getType()));
+    ref<Expr> result =
+        ExtractExpr::create(eval(ki, 0, state).value, 0, ki->width);
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, arg);
     break;
   }
   case Instruction::ZExt: {
-    CastInst *ci = cast<CastInst>(i);
     ref<Expr> arg = eval(ki, 0, state).value;
-    ref<Expr> result =
-        ZExtExpr::create(arg, getWidthForLLVMType(ci->getType()));
+    ref<Expr> result = ZExtExpr::create(arg, ki->width);
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, arg);
     break;
   }
   case Instruction::SExt: {
-    CastInst *ci = cast<CastInst>(i);
     ref<Expr> arg = eval(ki, 0, state).value;
-    ref<Expr> result =
-        SExtExpr::create(arg, getWidthForLLVMType(ci->getType()));
+    ref<Expr> result = SExtExpr::create(arg, ki->width);
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, arg);
     break;
   }
 
   case Instruction::IntToPtr: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width pType = getWidthForLLVMType(ci->getType());
+    Expr::Width pType = ki->width;
     ref<Expr> arg = eval(ki, 0, state).value;
     ref<Expr> result = ZExtExpr::create(arg, pType);
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, arg);
     break;
   }
   case Instruction::PtrToInt: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width iType = getWidthForLLVMType(ci->getType());
+    Expr::Width iType = ki->width;
     ref<Expr> arg = eval(ki, 0, state).value;
     ref<Expr> result = ZExtExpr::create(arg, iType);
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, arg);
     break;
   }
@@ -3742,7 +4377,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result);
     break;
   }
@@ -3758,21 +4393,24 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         !fpWidthToSemantics(right->getWidth()))
       return terminateStateOnExecError(state, "Unsupported FAdd operation");
 
+    ref<Expr> result = evalNativeFloat(i->getOpcode(), left, right);
+    if (result.isNull()) {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()),
-                      left->getAPValue());
-    Res.add(
-        APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()),
-        APFloat::rmNearestTiesToEven);
+      llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()),
+                        left->getAPValue());
+      Res.add(
+          APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()),
+          APFloat::rmNearestTiesToEven);
 #else
-    llvm::APFloat Res(left->getAPValue());
-    Res.add(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
+      llvm::APFloat Res(left->getAPValue());
+      Res.add(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
 #endif
-    ref<Expr> result = ConstantExpr::alloc(Res.bitcastToAPInt());
+      result = ConstantExpr::alloc(Res.bitcastToAPInt());
+    }
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3785,21 +4423,25 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
       return terminateStateOnExecError(state, "Unsupported FSub operation");
+
+    ref<Expr> result = evalNativeFloat(i->getOpcode(), left, right);
+    if (result.isNull()) {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()),
-                      left->getAPValue());
-    Res.subtract(
-        APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()),
-        APFloat::rmNearestTiesToEven);
+      llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()),
+                        left->getAPValue());
+      Res.subtract(
+          APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()),
+          APFloat::rmNearestTiesToEven);
 #else
-    llvm::APFloat Res(left->getAPValue());
-    Res.subtract(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
+      llvm::APFloat Res(left->getAPValue());
+      Res.subtract(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
 #endif
-    ref<Expr> result = ConstantExpr::alloc(Res.bitcastToAPInt());
+      result = ConstantExpr::alloc(Res.bitcastToAPInt());
+    }
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3813,21 +4455,24 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         !fpWidthToSemantics(right->getWidth()))
       return terminateStateOnExecError(state, "Unsupported FMul operation");
 
+    ref<Expr> result = evalNativeFloat(i->getOpcode(), left, right);
+    if (result.isNull()) {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()),
-                      left->getAPValue());
-    Res.multiply(
-        APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()),
-        APFloat::rmNearestTiesToEven);
+      llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()),
+                        left->getAPValue());
+      Res.multiply(
+          APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()),
+          APFloat::rmNearestTiesToEven);
 #else
-    llvm::APFloat Res(left->getAPValue());
-    Res.multiply(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
+      llvm::APFloat Res(left->getAPValue());
+      Res.multiply(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
 #endif
-    ref<Expr> result = ConstantExpr::alloc(Res.bitcastToAPInt());
+      result = ConstantExpr::alloc(Res.bitcastToAPInt());
+    }
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3841,21 +4486,24 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         !fpWidthToSemantics(right->getWidth()))
       return terminateStateOnExecError(state, "Unsupported FDiv operation");
 
+    ref<Expr> result = evalNativeFloat(i->getOpcode(), left, right);
+    if (result.isNull()) {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()),
-                      left->getAPValue());
-    Res.divide(
-        APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()),
-        APFloat::rmNearestTiesToEven);
+      llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()),
+                        left->getAPValue());
+      Res.divide(
+          APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()),
+          APFloat::rmNearestTiesToEven);
 #else
-    llvm::APFloat Res(left->getAPValue());
-    Res.divide(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
+      llvm::APFloat Res(left->getAPValue());
+      Res.divide(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
 #endif
-    ref<Expr> result = ConstantExpr::alloc(Res.bitcastToAPInt());
+      result = ConstantExpr::alloc(Res.bitcastToAPInt());
+    }
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -3882,150 +4530,192 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
 
   case Instruction::FPTrunc: {
-    FPTruncInst *fi = cast<FPTruncInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<Expr> origArg = eval(ki, 0, state).value;
     ref<ConstantExpr> arg = toConstant(state, origArg, "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > arg->getWidth())
       return terminateStateOnExecError(state, "Unsupported FPTrunc operation");
 
+    ref<Expr> result;
+    if (isNativeFloat(arg->getWidth()) && isNativeFloat(resultType) &&
+        resultType < arg->getWidth() &&
+        !floats::isNaN(arg->getZExtValue(), arg->getWidth())) {
+      result = ConstantExpr::alloc(
+          floats::trunc(arg->getZExtValue(), resultType, arg->getWidth()),
+          resultType);
+    } else {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
+      llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()),
+                        arg->getAPValue());
 #else
-    llvm::APFloat Res(arg->getAPValue());
+      llvm::APFloat Res(arg->getAPValue());
 #endif
-    bool losesInfo = false;
-    Res.convert(*fpWidthToSemantics(resultType),
-                llvm::APFloat::rmNearestTiesToEven, &losesInfo);
-    ref<Expr> result = ConstantExpr::alloc(Res);
+      bool losesInfo = false;
+      Res.convert(*fpWidthToSemantics(resultType),
+                  llvm::APFloat::rmNearestTiesToEven, &losesInfo);
+      result = ConstantExpr::alloc(Res);
+    }
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, origArg);
     break;
   }
 
   case Instruction::FPExt: {
-    FPExtInst *fi = cast<FPExtInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<Expr> origArg = eval(ki, 0, state).value;
     ref<ConstantExpr> arg = toConstant(state, origArg, "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || arg->getWidth() > resultType)
       return terminateStateOnExecError(state, "Unsupported FPExt operation");
+
+    ref<Expr> result;
+    if (isNativeFloat(arg->getWidth()) && isNativeFloat(resultType) &&
+        arg->getWidth() < resultType &&
+        !floats::isNaN(arg->getZExtValue(), arg->getWidth())) {
+      result = ConstantExpr::alloc(
+          floats::ext(arg->getZExtValue(), resultType, arg->getWidth()),
+          resultType);
+    } else {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
+      llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()),
+                        arg->getAPValue());
 #else
-    llvm::APFloat Res(arg->getAPValue());
+      llvm::APFloat Res(arg->getAPValue());
 #endif
-    bool losesInfo = false;
-    Res.convert(*fpWidthToSemantics(resultType),
-                llvm::APFloat::rmNearestTiesToEven, &losesInfo);
-    ref<Expr> result = ConstantExpr::alloc(Res);
+      bool losesInfo = false;
+      Res.convert(*fpWidthToSemantics(resultType),
+                  llvm::APFloat::rmNearestTiesToEven, &losesInfo);
+      result = ConstantExpr::alloc(Res);
+    }
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, origArg);
     break;
   }
 
   case Instruction::FPToUI: {
-    FPToUIInst *fi = cast<FPToUIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<Expr> origArg = eval(ki, 0, state).value;
     ref<ConstantExpr> arg = toConstant(state, origArg, "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
       return terminateStateOnExecError(state, "Unsupported FPToUI operation");
 
+    uint64_t value = 0;
+    if (isNativeFloatToInt(arg, resultType, false)) {
+      value = floats::toUnsignedInt(arg->getZExtValue(), resultType,
+                                    arg->getWidth());
+    } else {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Arg(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
+      llvm::APFloat Arg(*fpWidthToSemantics(arg->getWidth()),
+                        arg->getAPValue());
 #else
-    llvm::APFloat Arg(arg->getAPValue());
+      llvm::APFloat Arg(arg->getAPValue());
 #endif
-    uint64_t value = 0;
-    bool isExact = true;
-    Arg.convertToInteger(&value, resultType, false, llvm::APFloat::rmTowardZero,
-                         &isExact);
+      bool isExact = true;
+      Arg.convertToInteger(&value, resultType, false,
+                           llvm::APFloat::rmTowardZero, &isExact);
+    }
     ref<Expr> result = ConstantExpr::alloc(value, resultType);
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, origArg);
     break;
   }
 
   case Instruction::FPToSI: {
-    FPToSIInst *fi = cast<FPToSIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<Expr> origArg = eval(ki, 0, state).value;
     ref<ConstantExpr> arg = toConstant(state, origArg, "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
       return terminateStateOnExecError(state, "Unsupported FPToSI operation");
+
+    uint64_t value = 0;
+    if (isNativeFloatToInt(arg, resultType, true)) {
+      value = floats::toSignedInt(arg->getZExtValue(), resultType,
+                                  arg->getWidth());
+    } else {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Arg(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
+      llvm::APFloat Arg(*fpWidthToSemantics(arg->getWidth()),
+                        arg->getAPValue());
 #else
-    llvm::APFloat Arg(arg->getAPValue());
-
+      llvm::APFloat Arg(arg->getAPValue());
 #endif
-    uint64_t value = 0;
-    bool isExact = true;
-    Arg.convertToInteger(&value, resultType, true, llvm::APFloat::rmTowardZero,
-                         &isExact);
+      bool isExact = true;
+      Arg.convertToInteger(&value, resultType, true,
+                           llvm::APFloat::rmTowardZero, &isExact);
+    }
     ref<Expr> result = ConstantExpr::alloc(value, resultType);
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, origArg);
     break;
   }
 
   case Instruction::UIToFP: {
-    UIToFPInst *fi = cast<UIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<Expr> origArg = eval(ki, 0, state).value;
     ref<ConstantExpr> arg = toConstant(state, origArg, "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
     if (!semantics)
       return terminateStateOnExecError(state, "Unsupported UIToFP operation");
-    llvm::APFloat f(*semantics, 0);
-    f.convertFromAPInt(arg->getAPValue(), false,
-                       llvm::APFloat::rmNearestTiesToEven);
 
-    ref<Expr> result = ConstantExpr::alloc(f);
+    ref<Expr> result;
+    if (isNativeFloat(resultType) && arg->getWidth() <= 64) {
+      result = ConstantExpr::alloc(
+          floats::UnsignedIntToFP(arg->getZExtValue(), resultType),
+          resultType);
+    } else {
+      llvm::APFloat f(*semantics, 0);
+      f.convertFromAPInt(arg->getAPValue(), false,
+                         llvm::APFloat::rmNearestTiesToEven);
+      result = ConstantExpr::alloc(f);
+    }
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, origArg);
     break;
   }
 
   case Instruction::SIToFP: {
-    SIToFPInst *fi = cast<SIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<Expr> origArg = eval(ki, 0, state).value;
     ref<ConstantExpr> arg = toConstant(state, origArg, "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
     if (!semantics)
       return terminateStateOnExecError(state, "Unsupported SIToFP operation");
-    llvm::APFloat f(*semantics, 0);
-    f.convertFromAPInt(arg->getAPValue(), true,
-                       llvm::APFloat::rmNearestTiesToEven);
 
-    ref<Expr> result = ConstantExpr::alloc(f);
+    ref<Expr> result;
+    if (isNativeFloat(resultType) && arg->getWidth() <= 64) {
+      result = ConstantExpr::alloc(floats::SignedIntToFP(arg->getZExtValue(),
+                                                         resultType,
+                                                         arg->getWidth()),
+                                   resultType);
+    } else {
+      llvm::APFloat f(*semantics, 0);
+      f.convertFromAPInt(arg->getAPValue(), true,
+                         llvm::APFloat::rmNearestTiesToEven);
+      result = ConstantExpr::alloc(f);
+    }
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, origArg);
     break;
   }
@@ -4040,14 +4730,17 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         !fpWidthToSemantics(right->getWidth()))
       return terminateStateOnExecError(state, "Unsupported FCmp operation");
 
+    APFloat::cmpResult CmpRes;
+    if (!compareNativeFloat(left, right, CmpRes)) {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    APFloat LHS(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
-    APFloat RHS(*fpWidthToSemantics(right->getWidth()), right->getAPValue());
+      APFloat LHS(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
+      APFloat RHS(*fpWidthToSemantics(right->getWidth()), right->getAPValue());
 #else
-    APFloat LHS(left->getAPValue());
-    APFloat RHS(right->getAPValue());
+      APFloat LHS(left->getAPValue());
+      APFloat RHS(right->getAPValue());
 #endif
-    APFloat::cmpResult CmpRes = LHS.compare(RHS);
+      CmpRes = LHS.compare(RHS);
+    }
 
     bool Result = false;
     switch (fi->getPredicate()) {
@@ -4128,7 +4821,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, left, right);
     break;
   }
@@ -4160,7 +4853,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, agg, val);
     break;
   }
@@ -4169,13 +4862,12 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     ref<Expr> agg = eval(ki, 0, state).value;
 
-    ref<Expr> result = ExtractExpr::create(agg, kgepi->offset * 8,
-                                           getWidthForLLVMType(i->getType()));
+    ref<Expr> result = ExtractExpr::create(agg, kgepi->offset * 8, ki->width);
 
     bindLocal(ki, state, result);
 
     // Update dependency
-    if (INTERPOLATION_ENABLED)
+    if (INTERPOLATION_ENABLED && !ki->isDependencyIrrelevant)
       txTree->execute(i, result, agg);
     break;
   }
@@ -4202,7 +4894,33 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 }
 
 void Executor::updateStates(ExecutionState *current) {
-  if (searcher) {
+  if (speculationWorkers) {
+    for (std::vector<ExecutionState *>::iterator
+             it = speculationRoots.begin(),
+             ie = speculationRoots.end();
+         it != ie; ++it)
+      if (speculationWorkers->start(**it))
+        parkedStates.push_back(*it);
+    speculationRoots.clear();
+  }
+
+  if (backgroundSolver || speculationWorkers) {
+    // The parked states leave the searcher but not the executor, and the
+    // parked states being terminated, as at the memory cap, already left it
+    std::vector<ExecutionState *> searcherRemoved(parkedStates);
+    for (std::vector<ExecutionState *>::iterator it = removedStates.begin(),
+                                                 ie = removedStates.end();
+         it != ie; ++it) {
+      bool parked = backgroundSolver && backgroundSolver->cancel(**it);
+      if (speculationWorkers && speculationWorkers->cancel(**it))
+        parked = true;
+      if (!parked)
+        searcherRemoved.push_back(*it);
+    }
+    parkedStates.clear();
+    if (searcher)
+      searcher->update(current, addedStates, searcherRemoved);
+  } else if (searcher) {
     searcher->update(current, addedStates, removedStates);
   }
 
@@ -4220,7 +4938,8 @@ void Executor::updateStates(ExecutionState *current) {
         seedMap.find(es);
     if (it3 != seedMap.end())
       seedMap.erase(it3);
-    processTree->remove(es->ptreeNode);
+    if (processTree)
+      processTree->remove(es->ptreeNode);
     if (INTERPOLATION_ENABLED)
       txTree->remove(es, solver, (current == 0));
     delete es;
@@ -4228,6 +4947,94 @@ void Executor::updateStates(ExecutionState *current) {
   removedStates.clear();
 }
 
+void Executor::resumeStates(bool wait) {
+  std::vector<ExecutionState *> resumed;
+  backgroundSolver->poll(resumed, wait);
+  if (!resumed.empty())
+    searcher->update(0, resumed, std::vector<ExecutionState *>());
+}
+
+void Executor::resumeSpeculations(bool wait) {
+  std::vector<std::pair<ExecutionState *, SpeculationWorkers::Outcome> >
+      outcomes;
+  speculationWorkers->poll(outcomes, wait);
+
+  std::vector<ExecutionState *> resumed;
+  for (std::vector<std::pair<ExecutionState *,
+                             SpeculationWorkers::Outcome> >::iterator
+           it = outcomes.begin(),
+           ie = outcomes.end();
+       it != ie; ++it) {
+    if (it->second != SpeculationWorkers::Failure) {
+      resumed.push_back(it->first);
+      continue;
+    }
+
+    // The rollback removes the state from the searcher, which it rejoins for
+    // that
+    ExecutionState *state = it->first;
+    searcher->update(0, std::vector<ExecutionState *>(1, state),
+                     std::vector<ExecutionState *>());
+    txTree->setCurrentINode(*state);
+    specFail++;
+    specWorkerFail++;
+    speculativeBackJump(*state);
+
+    // Its node has been removed with the subtree
+    if (processTree)
+      processTree->remove(state->ptreeNode);
+    state->txTreeNode = 0;
+    delete state;
+  }
+  if (!resumed.empty())
+    searcher->update(0, resumed, std::vector<ExecutionState *>());
+}
+
+bool Executor::isSpeculationWorker() const {
+  return speculationWorkers && speculationWorkers->isWorker();
+}
+
+bool Executor::exploreSpeculation(ExecutionState &root, double timeout) {
+  // The copy of the executor in this process only explores the subtree of
+  // the speculation, writing neither test cases nor paths
+  backgroundSolver = 0;
+  checkpointer = 0;
+  pathWriter = 0;
+  symPathWriter = 0;
+  states.clear();
+  addedStates.clear();
+  removedStates.clear();
+  parkedStates.clear();
+  speculationRoots.clear();
+  states.insert(&root);
+  searcher = new DFSSearcher();
+  searcher->update(0, std::vector<ExecutionState *>(1, &root),
+                   std::vector<ExecutionState *>());
+
+  double deadline = util::getWallTime() + timeout;
+  while (!states.empty()) {
+    if (util::getWallTime() > deadline)
+      return false;
+
+    ExecutionState &state = searcher->selectState();
+    if (stateSpiller)
+      stateSpiller->restore(state);
+    txTree->setCurrentINode(state);
+
+    if (state.pc->hasTableEntry &&
+        txTree->subsumptionCheck(solver, state, coreSolverTimeout)) {
+      terminateStateOnSubsumption(state);
+    } else {
+      KInstruction *ki = state.pc;
+      stepInstruction(state);
+      executeInstruction(state, ki);
+      state.txTreeNode->incInstructionsDepth();
+    }
+    updateStates(&state);
+  }
+  return true;
+}
+
 template <typename TypeIt>
 void Executor::computeOffsets(KGEPInstruction *kgepi, TypeIt ib, TypeIt ie) {
   ref<ConstantExpr> constantOffset =
@@ -4300,7 +5107,14 @@ void Executor::checkMemoryUsage() {
     unsigned mbs = (util::GetTotalMallocUsage() >> 20) +
                    (memory->getUsedDeterministicSize() >> 20);
 
+    // Spill down to 80% of the cap on reaching 90% of it, so that states are
+    // only terminated when spilling does not free enough memory.
+    if (stateSpiller && mbs > MaxMemory * 9 / 10)
+      spillStates((uint64_t)(mbs - MaxMemory * 8 / 10) << 20);
+
     if (mbs > MaxMemory) {
+      if (ShedMemory && mbs > MaxMemory + 100)
+        mbs = shedMemory(mbs);
       if (mbs > MaxMemory + 100) {
         // just guess at how many to kill
         unsigned numStates = states.size();
@@ -4325,6 +5139,58 @@ void Executor::checkMemoryUsage() {
   }
 }
 
+unsigned Executor::shedMemory(unsigned mbs) {
+  // The memory held by each of them is reported as the memory freed by
+  // dropping it.
+  if (INTERPOLATION_ENABLED) {
+    if (unsigned evicted = TxSubsumptionTable::shed()) {
+      unsigned after = (util::GetTotalMallocUsage() >> 20) +
+                       (memory->getUsedDeterministicSize() >> 20);
+      klee_message("evicted %u subsumption table entries, freeing %d MB "
+                   "(over memory cap)",
+                   evicted, (int)mbs - (int)after);
+      mbs = after;
+      if (mbs <= MaxMemory + 100)
+        return mbs;
+    }
+  }
+
+  solver->releaseMemory();
+  unsigned after = (util::GetTotalMallocUsage() >> 20) +
+                   (memory->getUsedDeterministicSize() >> 20);
+  klee_message("dropped the solver caches, freeing %d MB (over memory cap)",
+               (int)mbs - (int)after);
+  return after;
+}
+
+void Executor::spillStates(uint64_t bytes) {
+  // The searchers that expose their states list them in reverse order of
+  // selection.
+  std::vector<ExecutionState *> candidates = searcher->getStates();
+  if (candidates.empty())
+    candidates.assign(states.begin(), states.end());
+
+  uint64_t spilled = 0;
+  unsigned count = 0;
+  for (std::vector<ExecutionState *>::iterator it = candidates.begin(),
+                                               ie = candidates.end();
+       it != ie && spilled < bytes; ++it) {
+    ExecutionState *es = *it;
+    if (stateSpiller->isSpilled(*es) ||
+        std::find(removedStates.begin(), removedStates.end(), es) !=
+            removedStates.end())
+      continue;
+    if (uint64_t size = stateSpiller->spill(*es)) {
+      spilled += size;
+      ++count;
+    }
+  }
+
+  if (count)
+    klee_message("spilled %lu bytes of %u states to disk (near memory cap)",
+                 (unsigned long)spilled, count);
+}
+
 void Executor::doDumpStates() {
   if (!DumpStatesOnHalt || states.empty())
     return;
@@ -4409,6 +5275,8 @@ void Executor::run(ExecutionState &initialState) {
     dynamicYes = 0;
     dynamicNo = 0;
     specFail = 0;
+    specBoundToFail = 0;
+    specWorkerFail = 0;
     totalSpecFailTime = 0.0;
     for (std::map<llvm::Instruction *, unsigned int>::iterator
              it = specSnap.begin(),
@@ -4416,9 +5284,6 @@ void Executor::run(ExecutionState &initialState) {
          it != ie; ++it) {
       it->second = 0;
     }
-    // load avoid BB
-    bbOrderToSpecAvoid = readBBOrderToSpecAvoid(DependencyFolder);
-    visitedBlocks = readVisitedBB(DependencyFolder + "/InitialVisitedBB.txt");
   }
 
   startingBBPlottingTime = time(0);
@@ -4476,6 +5341,33 @@ void Executor::run(ExecutionState &initialState) {
     }
   }
 
+  // load avoid BB, after the BB order is known
+  if (INTERPOLATION_ENABLED && SpecTypeToUse != NO_SPEC) {
+    if (DependencyFolder.getNumOccurrences()) {
+      bbOrderToSpecAvoid = readBBOrderToSpecAvoid(DependencyFolder);
+      std::set<llvm::BasicBlock *> initialVisited =
+          readVisitedBB(DependencyFolder + "/InitialVisitedBB.txt");
+      visitedBlocks.insert(initialVisited.begin(), initialVisited.end());
+    } else {
+      bbOrderToSpecAvoid.clear();
+      for (std::map<llvm::Function *, std::map<llvm::BasicBlock *, int> >::
+               iterator it = fBBOrder.begin(),
+                        ie = fBBOrder.end();
+           it != ie; ++it) {
+        for (std::map<llvm::BasicBlock *, int>::iterator
+                 it1 = it->second.begin(),
+                 ie1 = it->second.end();
+             it1 != ie1; ++it1) {
+          std::map<llvm::BasicBlock *, std::set<std::string> >::iterator
+          avoidIt = kmodule->speculationAvoid.find(it1->first);
+          if (avoidIt != kmodule->speculationAvoid.end() &&
+              !avoidIt->second.empty())
+            bbOrderToSpecAvoid[it1->second] = avoidIt->second;
+        }
+      }
+    }
+  }
+
   // first BB of main()
   KInstruction *ki = initialState.pc;
   BasicBlock *firstBB = ki->inst->getParent();
@@ -4574,7 +5466,36 @@ void Executor::run(ExecutionState &initialState) {
   searcher->update(0, newStates, std::vector<ExecutionState *>());
 
   while (!states.empty() && !haltExecution) {
+    if (backgroundSolver && backgroundSolver->size()) {
+      resumeStates(searcher->empty());
+      if (searcher->empty())
+        continue;
+    }
+    if (speculationWorkers && speculationWorkers->size()) {
+      resumeSpeculations(searcher->empty());
+      if (searcher->empty())
+        continue;
+    }
+
     ExecutionState &state = searcher->selectState();
+    // The searchers walking the process tree, as random-path, select the
+    // parked states too, which then wait for their queries
+    if (backgroundSolver && backgroundSolver->isPending(state)) {
+      resumeStates(true);
+      continue;
+    }
+    if (speculationWorkers && speculationWorkers->isPending(state)) {
+      resumeSpeculations(true);
+      continue;
+    }
+    // The paths off the states of the resumed checkpoint have been explored
+    if (checkpointer && Checkpointer::isDropped(state)) {
+      terminateStateOutOfPartition(state);
+      updateStates(&state);
+      continue;
+    }
+    if (stateSpiller)
+      stateSpiller->restore(state);
 
 #ifdef ENABLE_Z3
     if (INTERPOLATION_ENABLED) {
@@ -4590,8 +5511,10 @@ void Executor::run(ExecutionState &initialState) {
         llvm::raw_string_ostream stream(debugMessage);
         if (debugLevel > 1) {
           stream << "\nCurrent state:\n";
-          processTree->print(stream);
-          stream << "\n";
+          if (processTree) {
+            processTree->print(stream);
+            stream << "\n";
+          }
           txTree->print(stream);
           stream << "\n";
           stream << "--------------------------- Current Node "
@@ -4612,8 +5535,14 @@ void Executor::run(ExecutionState &initialState) {
     }
 #endif
 
-    if (INTERPOLATION_ENABLED &&
-        txTree->subsumptionCheck(solver, state, coreSolverTimeout)) {
+    // Subsumption checks are only performed at instructions that are program
+    // points of subsumption table entries.
+    bool subsumed = false;
+    if (INTERPOLATION_ENABLED && state.pc->hasTableEntry) {
+      ++stats::subsumptionChecks;
+      subsumed = txTree->subsumptionCheck(solver, state, coreSolverTimeout);
+    }
+    if (subsumed) {
       terminateStateOnSubsumption(state);
     } else {
       KInstruction *ki = state.pc;
@@ -4633,9 +5562,55 @@ void Executor::run(ExecutionState &initialState) {
   delete searcher;
   searcher = 0;
 
+  if (checkpointer)
+    checkpoint();
+
   doDumpStates();
 }
 
+void Executor::checkpoint() {
+  // The states removed during the current step are still in the set
+  std::set<ExecutionState *> live(states);
+  for (std::vector<ExecutionState *>::iterator it = removedStates.begin(),
+                                               ie = removedStates.end();
+       it != ie; ++it)
+    live.erase(*it);
+  checkpointer->save(live);
+
+#ifdef ENABLE_Z3
+  if (txTree)
+    TxSubsumptionTable::save(
+        checkpointer->getDirectory() + "/subsumption.table", kmodule);
+#endif
+}
+
+void Executor::syncSubsumptionTable() {
+#ifdef ENABLE_Z3
+  if (!txTree || SubsumptionTableFile.empty())
+    return;
+  TxSubsumptionTable::load(SubsumptionTableFile, kmodule);
+  TxSubsumptionTable::save(SubsumptionTableFile, kmodule);
+#endif
+}
+
+void Executor::takeTxMemoryCensus() {
+  if (!txTree)
+    return;
+
+  TxMemoryCensus census;
+  census.addTree(txTree);
+  census.addTable();
+  census.updatePeaks();
+
+  char name[32];
+  sprintf(name, "txmemory%08d.csv", (int)stats::instructions);
+  llvm::raw_ostream *os = interpreterHandler->openOutputFile(name);
+  if (os) {
+    census.print(*os, kmodule);
+    delete os;
+  }
+}
+
 std::string Executor::getAddressInfo(ExecutionState &state,
                                      ref<Expr> address) const {
   std::string Str;
@@ -4685,6 +5660,9 @@ std::string Executor::getAddressInfo(ExecutionState &state,
 }
 
 void Executor::terminateState(ExecutionState &state) {
+  if (stateSpiller)
+    stateSpiller->restore(state);
+
   if (replayKTest && replayPosition != replayKTest->numObjects) {
     klee_warning_once(replayKTest,
                       "replay did not consume all objects in test input.");
@@ -4705,7 +5683,8 @@ void Executor::terminateState(ExecutionState &state) {
     if (it3 != seedMap.end())
       seedMap.erase(it3);
     addedStates.erase(it);
-    processTree->remove(state.ptreeNode);
+    if (processTree)
+      processTree->remove(state.ptreeNode);
 
     if (INTERPOLATION_ENABLED)
       txTree->remove(&state, solver, false);
@@ -4720,13 +5699,15 @@ void Executor::terminateStateOnSubsumption(ExecutionState &state) {
   // but with different statistics functions called, and empty error
   // message as this is not an error.
   interpreterHandler->incSubsumptionTermination();
+  ++stats::subsumptionHits;
   interpreterHandler->incInstructionsDepthOnSubsumption(state.depth);
   interpreterHandler->incTotalInstructionsOnSubsumption(
       state.txTreeNode->getInstructionsDepth());
 
 #ifdef ENABLE_Z3
-  if (SubsumedTest && (!OnlyOutputStatesCoveringNew || state.coveredNew ||
-                       (AlwaysOutputSeeds && seedMap.count(&state)))) {
+  if (SubsumedTest && !isSpeculationWorker() &&
+      (!OnlyOutputStatesCoveringNew || state.coveredNew ||
+       (AlwaysOutputSeeds && seedMap.count(&state)))) {
     interpreterHandler->incSubsumptionTerminationTest();
     interpreterHandler->processTestCase(state, 0, "early");
   }
@@ -4736,6 +5717,9 @@ void Executor::terminateStateOnSubsumption(ExecutionState &state) {
 
 void Executor::terminateStateEarly(ExecutionState &state,
                                    const Twine &message) {
+  if (stateSpiller)
+    stateSpiller->restore(state);
+
   interpreterHandler->incEarlyTermination();
   if (INTERPOLATION_ENABLED) {
     interpreterHandler->incBranchingDepthOnEarlyTermination(state.depth);
@@ -4744,8 +5728,9 @@ void Executor::terminateStateEarly(ExecutionState &state,
     state.txTreeNode->setGenericEarlyTermination();
   }
 
-  if (!OnlyOutputStatesCoveringNew || state.coveredNew ||
-      (AlwaysOutputSeeds && seedMap.count(&state))) {
+  if (!isSpeculationWorker() &&
+      (!OnlyOutputStatesCoveringNew || state.coveredNew ||
+       (AlwaysOutputSeeds && seedMap.count(&state)))) {
     interpreterHandler->incEarlyTerminationTest();
     interpreterHandler->processTestCase(state, (message + "\n").str().c_str(),
                                         "early");
@@ -4753,6 +5738,14 @@ void Executor::terminateStateEarly(ExecutionState &state,
   terminateState(state);
 }
 
+void Executor::terminateStateOutOfPartition(ExecutionState &state) {
+  // The path is explored by another process, hence its subtree must not be
+  // summarized by an interpolant here
+  if (INTERPOLATION_ENABLED)
+    state.txTreeNode->setGenericEarlyTermination();
+  terminateState(state);
+}
+
 void Executor::terminateStateOnExit(ExecutionState &state) {
   interpreterHandler->incExitTermination();
   if (INTERPOLATION_ENABLED) {
@@ -4761,8 +5754,9 @@ void Executor::terminateStateOnExit(ExecutionState &state) {
         state.txTreeNode->getInstructionsDepth());
   }
 
-  if (!OnlyOutputStatesCoveringNew || state.coveredNew ||
-      (AlwaysOutputSeeds && seedMap.count(&state))) {
+  if (!isSpeculationWorker() &&
+      (!OnlyOutputStatesCoveringNew || state.coveredNew ||
+       (AlwaysOutputSeeds && seedMap.count(&state)))) {
     interpreterHandler->incExitTerminationTest();
     interpreterHandler->processTestCase(state, 0, 0);
   }
@@ -4825,13 +5819,36 @@ bool Executor::shouldExitOn(enum TerminateReason termReason) {
   return false;
 }
 
+bool Executor::isNewError(const ExecutionState &state,
+                          llvm::Instruction *lastInst,
+                          const std::string &message) {
+  typedef std::pair<Instruction *, std::string> ErrorSite;
+  static std::set<ErrorSite> emittedErrors;
+  static std::set<std::pair<ErrorSite, std::vector<Instruction *> > >
+      emittedErrorsByCallHistory;
+
+  ErrorSite site(lastInst, message);
+  if (ErrorMemo == SITE_ERROR_MEMO)
+    return emittedErrors.insert(site).second;
+
+  // The call sites of the frames, as the call histories of the subsumption
+  // table entries of interpolation
+  std::vector<Instruction *> callHistory;
+  for (ExecutionState::stack_ty::const_iterator it = state.stack.begin(),
+                                                ie = state.stack.end();
+       it != ie; ++it)
+    if (it->caller)
+      callHistory.push_back(it->caller->inst);
+  return emittedErrorsByCallHistory.insert(std::make_pair(site, callHistory))
+      .second;
+}
+
 void Executor::terminateStateOnError(ExecutionState &state,
                                      const llvm::Twine &messaget,
                                      enum TerminateReason termReason,
                                      const char *suffix,
                                      const llvm::Twine &info) {
   std::string message = messaget.str();
-  static std::set<std::pair<Instruction *, std::string> > emittedErrors;
   Instruction *lastInst;
   const InstructionInfo &ii =
       getLastNonKleeInternalInstruction(state, &lastInst);
@@ -4865,8 +5882,9 @@ void Executor::terminateStateOnError(ExecutionState &state,
       state.txTreeNode->setAssertionFail(EmitAllErrors);
   }
 
-  if (EmitAllErrors ||
-      emittedErrors.insert(std::make_pair(lastInst, message)).second) {
+  // The paths of a speculation worker are not to be reported
+  if (!isSpeculationWorker() &&
+      (EmitAllErrors || isNewError(state, lastInst, message))) {
     if (ii.file != "") {
       klee_message("ERROR: %s:%d: %s", ii.file.c_str(), ii.line,
                    message.c_str());
@@ -4874,7 +5892,10 @@ void Executor::terminateStateOnError(ExecutionState &state,
       klee_message("ERROR: (location information missing) %s", message.c_str());
     }
     if (!EmitAllErrors)
-      klee_message("NOTE: now ignoring this error at this location");
+      klee_message(ErrorMemo == CALL_HISTORY_ERROR_MEMO
+                       ? "NOTE: now ignoring this error at this location "
+                         "under this call stack"
+                       : "NOTE: now ignoring this error at this location");
 
     std::string MsgString;
     llvm::raw_string_ostream msg(MsgString);
@@ -4939,6 +5960,8 @@ void Executor::callExternalFunction(ExecutionState &state, KInstruction *target,
       (uint64_t *)alloca(2 * sizeof(*args) * (arguments.size() + 1));
   memset(args, 0, 2 * sizeof(*args) * (arguments.size() + 1));
   unsigned wordIndex = 2;
+  // The arguments that may be pointers to the objects the call can access
+  std::vector<uint64_t> roots;
   for (std::vector<ref<Expr> >::iterator ai = arguments.begin(),
                                          ae = arguments.end();
        ai != ae; ++ai) {
@@ -4949,12 +5972,16 @@ void Executor::callExternalFunction(ExecutionState &state, KInstruction *target,
       (void)success;
       ce->toMemory(&args[wordIndex]);
       wordIndex += (ce->getWidth() + 63) / 64;
+      if (ce->getWidth() == Context::get().getPointerWidth())
+        roots.push_back(ce->getZExtValue());
     } else {
       ref<Expr> arg = toUnique(state, *ai);
       if (ConstantExpr *ce = dyn_cast<ConstantExpr>(arg)) {
         // XXX kick toMemory functions from here
         ce->toMemory(&args[wordIndex]);
         wordIndex += (ce->getWidth() + 63) / 64;
+        if (ce->getWidth() == Context::get().getPointerWidth())
+          roots.push_back(ce->getZExtValue());
       } else {
         terminateStateOnExecError(state,
                                   "external call with symbolic argument: " +
@@ -4964,6 +5991,7 @@ void Executor::callExternalFunction(ExecutionState &state, KInstruction *target,
     }
   }
 
+  state.addressSpace.exposeReachable(roots);
   state.addressSpace.copyOutConcretes();
 
   if (!SuppressExternalWarnings) {
@@ -5110,31 +6138,48 @@ void Executor::executeAlloc(ExecutionState &state, ref<Expr> size, bool isLocal,
     // return argument first). This shows up in pcre when llvm
     // collapses the size expression with a select.
 
+    // Try and start with a small example: a feasible size of at most 128,
+    // or else one at most half of the last one found while it is above 256.
+    // The sizes are those of the models of the state when they satisfy the
+    // bounds, and each model found is kept for the queries that follow, so
+    // that the checks below rarely reach the solver.
+    Expr::Width W = size->getWidth();
+    std::vector<ref<Expr> > unsatCore;
     ref<ConstantExpr> example;
-    bool success = solver->getValue(state, size, example);
+    bool hasSolution;
+    bool success = solver->getFeasibleValue(
+        state, UleExpr::create(size, ConstantExpr::alloc(128, W)), size,
+        example, hasSolution, unsatCore);
     assert(success && "FIXME: Unhandled solver failure");
-    (void)success;
-
-    // Try and start with a small example.
-    Expr::Width W = example->getWidth();
-    while (example->Ugt(ConstantExpr::alloc(128, W))->isTrue()) {
-      ref<ConstantExpr> tmp = example->LShr(ConstantExpr::alloc(1, W));
-      bool res;
-      bool success = solver->mayBeTrue(state, EqExpr::create(tmp, size), res);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void)success;
-      if (!res)
-        break;
-      example = tmp;
+    if (!hasSolution) {
+      success = solver->getFeasibleValue(
+          state, ConstantExpr::alloc(1, Expr::Bool), size, example,
+          hasSolution, unsatCore);
+      assert(success && hasSolution && "FIXME: Unhandled solver failure");
+      while (example->Ugt(ConstantExpr::alloc(256, W))->isTrue()) {
+        ref<ConstantExpr> tmp;
+        success = solver->getFeasibleValue(
+            state,
+            UleExpr::create(size, example->LShr(ConstantExpr::alloc(1, W))),
+            size, tmp, hasSolution, unsatCore);
+        assert(success && "FIXME: Unhandled solver failure");
+        if (!hasSolution)
+          break;
+        example = tmp;
+      }
     }
+    (void)success;
 
     StatePair fixedSize = fork(state, EqExpr::create(example, size), true);
 
     if (fixedSize.second) {
-      // Check for exactly two values
+      // Check for exactly two values, with the other size given by the model
+      // of the fork when it has one
       ref<ConstantExpr> tmp;
-      bool success = solver->getValue(*fixedSize.second, size, tmp);
-      assert(success && "FIXME: Unhandled solver failure");
+      bool success = solver->getFeasibleValue(
+          *fixedSize.second, ConstantExpr::alloc(1, Expr::Bool), size, tmp,
+          hasSolution, unsatCore);
+      assert(success && hasSolution && "FIXME: Unhandled solver failure");
       (void)success;
       bool res;
       success =
@@ -5335,43 +6380,50 @@ void Executor::executeMemoryOperation(ExecutionState &state, bool isWrite,
   // XXX there is some query wasteage here. who cares?
   ExecutionState *unbound = &state;
 
-  for (ResolutionList::iterator i = rl.begin(), ie = rl.end(); i != ie; ++i) {
-    const MemoryObject *mo = i->first;
-    const ObjectState *os = i->second;
-    ref<Expr> inBounds = mo->getBoundsCheckPointer(address, bytes);
-
-    StatePair branches = fork(*unbound, inBounds, true);
-    ExecutionState *bound = branches.first;
+  if (canMergeResolutions(isWrite, rl) && !incomplete) {
+    unbound =
+        executeMergedMemoryOperation(state, isWrite, address, value, target,
+                                     type, rl);
+  } else {
+    for (ResolutionList::iterator i = rl.begin(), ie = rl.end(); i != ie;
+         ++i) {
+      const MemoryObject *mo = i->first;
+      const ObjectState *os = i->second;
+      ref<Expr> inBounds = mo->getBoundsCheckPointer(address, bytes);
+
+      StatePair branches = fork(*unbound, inBounds, true);
+      ExecutionState *bound = branches.first;
+
+      // bound can be 0 on failure or overlapped
+      if (bound) {
+        if (isWrite) {
+          if (os->readOnly) {
+            terminateStateOnError(*bound, "memory error: object read only",
+                                  ReadOnly);
+          } else {
+            ObjectState *wos = bound->addressSpace.getWriteable(mo, os);
+            wos->write(mo->getOffsetExpr(address), value);
 
-    // bound can be 0 on failure or overlapped
-    if (bound) {
-      if (isWrite) {
-        if (os->readOnly) {
-          terminateStateOnError(*bound, "memory error: object read only",
-                                ReadOnly);
+            // Update dependency
+            if (INTERPOLATION_ENABLED && target)
+              TxTree::executeOnNode(bound->txTreeNode, target->inst, value,
+                                    address);
+          }
         } else {
-          ObjectState *wos = bound->addressSpace.getWriteable(mo, os);
-          wos->write(mo->getOffsetExpr(address), value);
+          ref<Expr> result = os->read(mo->getOffsetExpr(address), type);
+          bindLocal(target, *bound, result);
 
           // Update dependency
           if (INTERPOLATION_ENABLED && target)
-            TxTree::executeOnNode(bound->txTreeNode, target->inst, value,
+            TxTree::executeOnNode(bound->txTreeNode, target->inst, result,
                                   address);
         }
-      } else {
-        ref<Expr> result = os->read(mo->getOffsetExpr(address), type);
-        bindLocal(target, *bound, result);
-
-        // Update dependency
-        if (INTERPOLATION_ENABLED && target)
-          TxTree::executeOnNode(bound->txTreeNode, target->inst, result,
-                                address);
       }
-    }
 
-    unbound = branches.second;
-    if (!unbound)
-      break;
+      unbound = branches.second;
+      if (!unbound)
+        break;
+    }
   }
 
   // XXX should we distinguish out of bounds and overlapped cases?
@@ -5394,6 +6446,64 @@ void Executor::executeMemoryOperation(ExecutionState &state, bool isWrite,
   }
 }
 
+bool Executor::canMergeResolutions(bool isWrite, const ResolutionList &rl) {
+  // The dependencies of Tracer-X are of the accesses to single objects
+  if (!MaxMergedResolutions || INTERPOLATION_ENABLED || rl.size() < 2 ||
+      rl.size() > MaxMergedResolutions)
+    return false;
+  if (isWrite) {
+    for (ResolutionList::const_iterator it = rl.begin(), ie = rl.end();
+         it != ie; ++it)
+      if (it->second->readOnly)
+        return false;
+  }
+  return true;
+}
+
+ExecutionState *Executor::executeMergedMemoryOperation(
+    ExecutionState &state, bool isWrite, ref<Expr> address, ref<Expr> value,
+    KInstruction *target, Expr::Width type, const ResolutionList &rl) {
+  unsigned bytes = Expr::getMinBytesForWidth(type);
+  std::vector<ref<Expr> > inBounds;
+  ref<Expr> inAny = ConstantExpr::alloc(0, Expr::Bool);
+  for (ResolutionList::const_iterator it = rl.begin(), ie = rl.end();
+       it != ie; ++it) {
+    inBounds.push_back(it->first->getBoundsCheckPointer(address, bytes));
+    inAny = OrExpr::create(inAny, inBounds.back());
+  }
+
+  StatePair branches = fork(state, inAny, true);
+  ExecutionState *bound = branches.first;
+  if (!bound)
+    return branches.second;
+
+  if (isWrite) {
+    // Each object is written the value where the pointer is within it, and
+    // its own bytes elsewhere. Where the pointer is outside of the object,
+    // the offset is truncated to the index of the same bytes in both the
+    // read and the write, which then leaves them as they were.
+    for (unsigned i = 0, n = rl.size(); i != n; ++i) {
+      const MemoryObject *mo = rl[i].first;
+      ObjectState *wos = bound->addressSpace.getWriteable(mo, rl[i].second);
+      ref<Expr> offset = mo->getOffsetExpr(address);
+      wos->write(offset,
+                 SelectExpr::create(inBounds[i], value,
+                                    wos->read(offset, type)));
+    }
+  } else {
+    ref<Expr> result =
+        rl.back().second->read(rl.back().first->getOffsetExpr(address), type);
+    for (unsigned i = rl.size() - 1; i-- != 0;) {
+      const MemoryObject *mo = rl[i].first;
+      result = SelectExpr::create(
+          inBounds[i], rl[i].second->read(mo->getOffsetExpr(address), type),
+          result);
+    }
+    bindLocal(target, *bound, result);
+  }
+  return branches.second;
+}
+
 void Executor::executeMakeSymbolic(ExecutionState &state,
                                    const MemoryObject *mo,
                                    const std::string &name) {
@@ -5403,9 +6513,10 @@ void Executor::executeMakeSymbolic(ExecutionState &state,
     // or if that fails try adding a unique identifier.
     unsigned id = 0;
     std::string uniqueName = name;
-    while (!state.arrayNames.insert(uniqueName).second) {
+    while (state.arrayNames.count(uniqueName)) {
       uniqueName = name + "_" + llvm::utostr(++id);
     }
+    state.arrayNames = state.arrayNames.insert(uniqueName);
     const Array *array = arrayCache.CreateArray(uniqueName, mo->size);
     if (INTERPOLATION_ENABLED) {
       // We create shadow array as existentially-quantified
@@ -5528,6 +6639,8 @@ void Executor::runFunctionAsMain(Function *f, int argc, char **argv,
   }
 
   ExecutionState *state = new ExecutionState(kmodule->functionMap[f]);
+  if (checkpointer)
+    state->checkpointId = checkpointer->getRootId();
 
   if (pathWriter)
     state->pathOS = pathWriter->open();
@@ -5568,22 +6681,66 @@ void Executor::runFunctionAsMain(Function *f, int argc, char **argv,
 
   initializeGlobals(*state);
 
-  processTree = new PTree(state);
-  state->ptreeNode = processTree->root;
+  // Only the random path searcher reads the process tree
+  if (userSearcherRequiresPTree() || KeepProcessTree) {
+    processTree = new PTree(state);
+    state->ptreeNode = processTree->root;
+  }
 
   if (INTERPOLATION_ENABLED) {
     txTree = new TxTree(state, kmodule->targetData, &globalAddresses);
     state->txTreeNode = txTree->root;
     TxTreeGraph::initialize(txTree->root);
+#ifdef ENABLE_Z3
+    if (WPInterpolant)
+      TxWPTrace::initialize(kmodule);
+    if (OutputTreeStream)
+      TxTreeGraph::openEventStream(
+          interpreterHandler->getOutputFilename("tree.events"), txTree->root);
+    if (!SubsumptionTableFile.empty())
+      TxSubsumptionTable::load(SubsumptionTableFile, kmodule);
+    if (!ResumeFrom.empty())
+      TxSubsumptionTable::load(ResumeFrom + "/subsumption.table", kmodule);
+#endif
   }
 
+  if (SamplingProfileInterval)
+    SamplingProfiler::start(SamplingProfileInterval);
   run(*state);
+  if (SamplingProfileInterval) {
+    SamplingProfiler::stop();
+    llvm::raw_ostream *os = interpreterHandler->openOutputFile("profile.folded");
+    if (os) {
+      SamplingProfiler::dump(*os, kmodule);
+      delete os;
+    }
+  }
   delete processTree;
   processTree = 0;
 
+  specialFunctionHandler->saveMemoTable();
+
   if (INTERPOLATION_ENABLED) {
     TxTreeGraph::save(interpreterHandler->getOutputFilename("tree.dot"));
     TxTreeGraph::deallocate();
+    TxTreeGraph::closeEventStream();
+
+#ifdef ENABLE_Z3
+    if (!SubsumptionTableFile.empty())
+      TxSubsumptionTable::save(SubsumptionTableFile, kmodule);
+    if (SubsumptionProfile) {
+      llvm::raw_ostream *os =
+          interpreterHandler->openOutputFile("subsumption-profile.csv");
+      if (os) {
+        TxSubsumptionTable::saveProfile(*os, kmodule);
+        delete os;
+      }
+    }
+    if (TxDebugLog::isEnabled())
+      TxDebugLog::dump(
+          interpreterHandler->getOutputFilename("subsumption-log.bin"),
+          kmodule);
+#endif
 
     delete txTree;
     txTree = 0;
@@ -5601,18 +6758,24 @@ void Executor::runFunctionAsMain(Function *f, int argc, char **argv,
     outSpec << "Total Independence Yes: " << independenceYes << "\n";
     outSpec << "Total Independence No: " << independenceNo << "\n";
 
+    // The declined speculations, and the ones bound to fail, were neither
+    // successes nor failures
+    unsigned declineCount =
+        TxSpeculationController::declineCount + specBoundToFail;
     if (SpecStrategyToUse == AGGRESSIVE) {
       outSpec << "Total Independence No & Success: "
-              << (independenceNo - specFail) << "\n";
+              << (independenceNo - specFail - declineCount) << "\n";
       outSpec << "Total Independence No & Fail: " << specFail << "\n";
     } else if (SpecStrategyToUse == CUSTOM) {
       outSpec << "Total Dynamic Yes: " << dynamicYes << "\n";
       outSpec << "Total Dynamic No: " << dynamicNo << "\n";
       outSpec << "Total Independence No, Dynamic Yes & Success: "
-              << (dynamicYes - specFail) << "\n";
+              << (dynamicYes - specFail - declineCount) << "\n";
       outSpec << "Total Independence No, Dynamic Yes & Fail: " << specFail
               << "\n";
     }
+    if (speculationWorkers)
+      outSpec << "Total Fail Decided By Workers: " << specWorkerFail << "\n";
 
     unsigned int statsTrackerTotal = 0;
     unsigned int statsTrackerFail = 0;
@@ -5628,6 +6791,9 @@ void Executor::runFunctionAsMain(Function *f, int argc, char **argv,
     outSpec << "StatsTracker Total: " << statsTrackerTotal << "\n";
     outSpec << "StatsTracker Fail: " << statsTrackerFail << "\n";
     outSpec << "StatsTracker Success: " << statsTrackerSucc << "\n";
+    outSpec << "Total Adaptive Declines: "
+            << TxSpeculationController::declineCount << "\n";
+    outSpec << "Total Bound to Fail: " << specBoundToFail << "\n";
 
     // total fail
     // fail because of new BBs
@@ -5815,6 +6981,65 @@ void Executor::getConstraintLog(const ExecutionState &state, std::string &res,
   }
 }
 
+bool Executor::getModelSolution(
+    const ExecutionState &state, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values,
+    std::vector<ref<Expr> > &unsatCore) {
+  // A model evaluating every constraint to true gives the values of all the
+  // objects, those it leaves free being in none of the constraints
+  for (std::vector<ref<StateModel> >::iterator it = state.models.begin(),
+                                               ie = state.models.end();
+       it != ie; ++it) {
+    Assignment &assignment = (*it)->assignment;
+    ConstraintManager::constraint_iterator ci = state.constraints.begin(),
+                                           ce = state.constraints.end();
+    for (; ci != ce; ++ci)
+      if (!assignment.evaluate(*ci)->isTrue())
+        break;
+    if (ci != ce)
+      continue;
+
+    values.clear();
+    for (std::vector<const Array *>::const_iterator oi = objects.begin(),
+                                                    oe = objects.end();
+         oi != oe; ++oi) {
+      Assignment::bindings_ty::iterator bi = assignment.bindings.find(*oi);
+      values.push_back(bi != assignment.bindings.end()
+                           ? bi->second
+                           : std::vector<unsigned char>((*oi)->size, 0));
+    }
+    return true;
+  }
+
+  // The objects in none of the constraints are zero, without a query
+  std::vector<const Array *> constrained;
+  findSymbolicObjects(state.constraints.begin(), state.constraints.end(),
+                      constrained);
+  std::set<const Array *> inConstraints(constrained.begin(),
+                                        constrained.end());
+  std::vector<const Array *> queried;
+  for (std::vector<const Array *>::const_iterator it = objects.begin(),
+                                                  ie = objects.end();
+       it != ie; ++it)
+    if (inConstraints.count(*it))
+      queried.push_back(*it);
+
+  std::vector<std::vector<unsigned char> > queriedValues;
+  if (!solver->getInitialValues(state, queried, queriedValues, unsatCore))
+    return false;
+
+  values.clear();
+  std::vector<std::vector<unsigned char> >::iterator vi =
+      queriedValues.begin();
+  for (std::vector<const Array *>::const_iterator it = objects.begin(),
+                                                  ie = objects.end();
+       it != ie; ++it)
+    values.push_back(inConstraints.count(*it)
+                         ? *vi++
+                         : std::vector<unsigned char>((*it)->size, 0));
+  return true;
+}
+
 bool Executor::getSymbolicSolution(
     const ExecutionState &state,
     std::vector<std::pair<std::string, std::vector<unsigned char> > > &res) {
@@ -5822,6 +7047,15 @@ bool Executor::getSymbolicSolution(
 
   ExecutionState tmp(state);
 
+  // A state terminated within the fast-forwarded prefix of a replay path
+  for (std::vector<std::pair<ref<Expr>, llvm::Instruction *> >::iterator
+           it = tmp.deferredConstraints.begin(),
+           ie = tmp.deferredConstraints.end();
+       it != ie; ++it) {
+    tmp.constraints.addConstraint(it->first);
+    tmp.retainModelsOf(it->first);
+  }
+
   // Go through each byte in every test case and attempt to restrict
   // it to the constraints contained in cexPreferences.  (Note:
   // usually this means trying to make it an ASCII character (0-127)
@@ -5829,7 +7063,23 @@ bool Executor::getSymbolicSolution(
   // the preferred constraints.  See test/Features/PreferCex.c for
   // an example) While this process can be very expensive, it can
   // also make understanding individual test cases much easier.
+  //
+  // All the preferences are first tried at once, by a single query, and
+  // only one by one when they do not hold together.
+  ref<Expr> preferences = ConstantExpr::alloc(1, Expr::Bool);
   for (unsigned i = 0; i != state.symbolics.size(); ++i) {
+    const MemoryObject *mo = state.symbolics[i].first;
+    for (std::vector<ref<Expr> >::const_iterator
+             pi = mo->cexPreferences.begin(),
+             pie = mo->cexPreferences.end();
+         pi != pie; ++pi)
+      preferences = AndExpr::create(preferences, *pi);
+  }
+  bool preferred = false;
+  if (!preferences->isTrue() &&
+      solver->mayBeTrue(tmp, preferences, preferred) && preferred)
+    tmp.addConstraint(preferences);
+  for (unsigned i = 0; !preferred && i != state.symbolics.size(); ++i) {
     const MemoryObject *mo = state.symbolics[i].first;
     std::vector<ref<Expr> >::const_iterator pi = mo->cexPreferences.begin(),
                                             pie = mo->cexPreferences.end();
@@ -5858,7 +7108,10 @@ bool Executor::getSymbolicSolution(
   std::vector<ref<Expr> > unsatCore;
   for (unsigned i = 0; i != state.symbolics.size(); ++i)
     objects.push_back(state.symbolics[i].second);
-  bool success = solver->getInitialValues(tmp, objects, values, unsatCore);
+  bool success = TestInputsFromModels
+                     ? getModelSolution(tmp, objects, values, unsatCore)
+                     : solver->getInitialValues(tmp, objects, values,
+                                                unsatCore);
   solver->setTimeout(0);
   if (!success) {
     klee_warning("unable to compute initial values (invalid constraints?)!");
@@ -5880,34 +7133,60 @@ void Executor::getCoveredLines(
 
 void Executor::doImpliedValueConcretization(ExecutionState &state, ref<Expr> e,
                                             ref<ConstantExpr> value) {
-
-  abort(); // FIXME: Broken until we sort out how to do the write back.
-
   if (DebugCheckForImpliedValues)
     ImpliedValue::checkForImpliedValues(solver->solver, e, value);
 
-  ImpliedValueList results;
-  ImpliedValue::getImpliedValues(e, value, results);
-  for (ImpliedValueList::iterator it = results.begin(), ie = results.end();
+  const ImpliedValueList &results =
+      impliedValueCache->getImpliedValues(e, value);
+  if (results.empty())
+    return;
+
+  // The implied values are grouped by object, such that each object is made
+  // writeable once
+  std::map<const Array *, const MemoryObject *> objects;
+  for (SymbolicList::const_iterator it = state.symbolics.begin(),
+                                    ie = state.symbolics.end();
+       it != ie; ++it)
+    objects[it->second] = it->first;
+
+  std::map<const MemoryObject *, ImpliedValueList> writes;
+  for (ImpliedValueList::const_iterator it = results.begin(),
+                                        ie = results.end();
        it != ie; ++it) {
     ReadExpr *re = it->first.get();
+    if (!isa<ConstantExpr>(re->index))
+      continue;
+    std::map<const Array *, const MemoryObject *>::iterator object =
+        objects.find(re->updates.root);
+    if (object != objects.end())
+      writes[object->second].push_back(*it);
+  }
 
-    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
-      // FIXME: This is the sole remaining usage of the Array object
-      // variable. Kill me.
-      const MemoryObject *mo = 0; // re->updates.root->object;
-      const ObjectState *os = state.addressSpace.findObject(mo);
+  for (std::map<const MemoryObject *, ImpliedValueList>::iterator
+           it = writes.begin(),
+           ie = writes.end();
+       it != ie; ++it) {
+    const MemoryObject *mo = it->first;
+    const ObjectState *os = state.addressSpace.findObject(mo);
+    // The object may have been freed, and its reads cannot be concretized
+    if (!os || os->readOnly)
+      continue;
 
-      if (!os) {
-        // object has been free'd, no need to concretize (although as
-        // in other cases we would like to concretize the outstanding
-        // reads, but we have no facility for that yet)
-      } else {
-        assert(!os->readOnly &&
-               "not possible? read only object with static read?");
-        ObjectState *wos = state.addressSpace.getWriteable(mo, os);
-        wos->write(CE, it->second);
-      }
+    ObjectState *wos = 0;
+    for (ImpliedValueList::iterator vit = it->second.begin(),
+                                    vie = it->second.end();
+         vit != vie; ++vit) {
+      uint64_t offset = cast<ConstantExpr>(vit->first->index)->getZExtValue();
+      if (offset >= mo->size)
+        continue;
+      // Only the bytes the object still holds are concretized, the others
+      // were overwritten since they were read
+      const ObjectState *current = wos ? wos : os;
+      if (current->read8(offset) != ref<Expr>(vit->first))
+        continue;
+      if (!wos)
+        wos = state.addressSpace.getWriteable(mo, os);
+      wos->write(offset, vit->second);
     }
   }
 }
@@ -48,15 +48,19 @@ class TargetData;
 #else
 class DataLayout;
 #endif
+class SwitchInst;
 class Twine;
 class Value;
 }
 
 namespace klee {
 class Array;
+class BackgroundSolver;
 struct Cell;
+class Checkpointer;
 class ExecutionState;
 class ExternalDispatcher;
+class ImpliedValueCache;
 class Expr;
 class InstructionInfoTable;
 struct KFunction;
@@ -72,7 +76,9 @@ class TxTreeNode;
 class Searcher;
 class SeedInfo;
 class SpecialFunctionHandler;
+class SpeculationWorkers;
 struct StackFrame;
+class StateSpiller;
 class StatsTracker;
 class TimingSolver;
 class TreeStreamWriter;
@@ -89,6 +95,7 @@ class Executor : public Interpreter {
   friend class OwningSearcher;
   friend class WeightedRandomSearcher;
   friend class SpecialFunctionHandler;
+  friend class SpeculationWorkers;
   friend class StatsTracker;
 
 public:
@@ -104,6 +111,8 @@ public:
 
   std::map<int, std::set<std::string> > bbOrderToSpecAvoid; // used in the
                                                             // speculation mode.
+  // Memoised results of isSpecIndependent for each branch instruction
+  std::map<llvm::Instruction *, bool> specIndependence;
   int independenceYes;
   int independenceNo;
   int dynamicYes;
@@ -112,6 +121,11 @@ public:
   // int specSnap;
   std::map<llvm::Instruction *, unsigned int> specSnap;
   int specFail;
+  // Speculations not opened, as they would fail before any branch
+  int specBoundToFail;
+  // Failed speculations rolled back before their exploration, as decided by
+  // the speculation workers
+  int specWorkerFail;
   std::map<uintptr_t, unsigned int> specFailNew;     // fail because of new BB
   std::map<uintptr_t, unsigned int> specFailNoInter; // fail because of new BB &
                                                      // no interpolant
@@ -168,6 +182,27 @@ private:
   std::vector<TimerInfo *> timers;
   PTree *processTree;
   TxTree *txTree;
+  /// Moves the memory of suspended states to disk near the memory cap, when
+  /// -spill-states is set
+  StateSpiller *stateSpiller;
+  /// Solves the timed-out branch queries of parked states in forked
+  /// processes, when -background-queries is set
+  BackgroundSolver *backgroundSolver;
+  /// Explores the subtrees of new speculations in forked processes, when
+  /// -speculation-workers is set
+  SpeculationWorkers *speculationWorkers;
+  /// The states of the speculations opened during the current instructions
+  /// step, which are parked while the speculation workers explore them
+  std::vector<ExecutionState *> speculationRoots;
+  /// Records the exploration for resuming it, when -checkpoint-dir or
+  /// -resume-from is set
+  Checkpointer *checkpointer;
+  /// The implied values of the branch conditions, when implied-value
+  /// concretization is enabled
+  ImpliedValueCache *impliedValueCache;
+  /// The states parked during the current instructions step, which leave
+  /// the searcher until their queries are solved
+  std::vector<ExecutionState *> parkedStates;
   ref<Expr> latestBaseLeft;
   ref<Expr> latestBaseRight;
   /// Used to track states that have been added during the current
@@ -225,8 +260,8 @@ private:
   /// step.
   bool haltExecution;
 
-  /// Whether implied-value concretization is enabled. Currently
-  /// false, it is buggy (it needs to validate its writes).
+  /// Whether implied-value concretization is enabled, see
+  /// -implied-value-concretization.
   bool ivcEnabled;
 
   /// The maximum time to allow for a single core solver query.
@@ -279,6 +314,18 @@ private:
 
   void stepInstruction(ExecutionState &state);
   void updateStates(ExecutionState *current);
+  /// Give the parked states whose queries have been solved back to the
+  /// searcher, waiting for one when wait is set.
+  void resumeStates(bool wait);
+  /// Roll back the parked speculations whose exploration failed, and give
+  /// the other explored ones back to the searcher, waiting for one when wait
+  /// is set.
+  void resumeSpeculations(bool wait);
+  /// Explore the subtree of the speculation of the state alone, in a process
+  /// of the speculation workers. Returns false when the time is out first.
+  bool exploreSpeculation(ExecutionState &root, double timeout);
+  /// Whether this process is a speculation worker, which writes no output.
+  bool isSpeculationWorker() const;
   void transferToBasicBlock(llvm::BasicBlock *dst, llvm::BasicBlock *src,
                             ExecutionState &state);
   void processBBCoverage(int BBCoverage, llvm::BasicBlock *bb,
@@ -342,9 +389,42 @@ private:
                               ref<Expr> value /* undef if read */,
                               KInstruction *target /* undef if write */);
 
+  /// Whether the objects of the resolution of a symbolic pointer are to be
+  /// accessed together by executeMergedMemoryOperation, with
+  /// -max-merged-resolutions
+  bool canMergeResolutions(bool isWrite, const ResolutionList &rl);
+
+  /// Access the objects of the resolution of a symbolic pointer in a single
+  /// state, forked where the pointer is within one of them: a read is the
+  /// selection among the values of the objects by the bounds of the pointer,
+  /// and each object is written such a selection between the value and its
+  /// own. Return the state where the pointer is out of the objects, if any.
+  ExecutionState *executeMergedMemoryOperation(ExecutionState &state,
+                                               bool isWrite, ref<Expr> address,
+                                               ref<Expr> value,
+                                               KInstruction *target,
+                                               Expr::Width type,
+                                               const ResolutionList &rl);
+
   void executeMakeSymbolic(ExecutionState &state, const MemoryObject *mo,
                            const std::string &name);
 
+  /// Find the feasible targets of a switch on a symbolic condition, with
+  /// their branch conditions, by enumerating the values of the condition
+  /// that take the targets not found yet: one query per feasible target and
+  /// one for all the infeasible ones.
+  void findSwitchTargets(
+      ExecutionState &state, llvm::SwitchInst *si, ref<Expr> cond,
+      const std::map<ref<Expr>, llvm::BasicBlock *> &expressionOrder,
+      std::vector<llvm::BasicBlock *> &bbOrder,
+      std::map<llvm::BasicBlock *, ref<Expr> > &branchTargets);
+
+  /// Split the process tree node of the current state into the nodes of the
+  /// left and right states, one of them being the current state, when the
+  /// process tree is maintained.
+  void splitProcessTree(ExecutionState &current, ExecutionState *left,
+                        ExecutionState *right);
+
   /// Create a new state where each input condition has been added as
   /// a constraint and return the results. The input state is included
   /// as one of the results. Note that the output vector may included
@@ -361,16 +441,59 @@ private:
   StatePair branchFork(ExecutionState &current, ref<Expr> condition,
                        bool isInternal);
 
+  // Evaluate the condition under each seed without the solver, into whether
+  // the seed satisfies it. Returns false, with no values, when a seed does
+  // not bind all the arrays of the condition.
+  static bool evaluateSeedsConcretely(std::vector<SeedInfo> &seeds,
+                                      ref<Expr> condition,
+                                      std::vector<bool> &values);
+
+  // Evaluate the condition under each seed, querying the solver once for
+  // each distinct condition the seeds leave symbolic.
+  void evaluateSeeds(ExecutionState &state, std::vector<SeedInfo> &seeds,
+                     ref<Expr> condition, std::vector<bool> &values);
+
+  static bool hasSeedValue(const std::vector<bool> &values, bool value);
+
+  // Take the branch of the replay path without querying the solver, while
+  // within the -replay-path-fast-forward prefix. Returns false when the
+  // branch is to be forked as usual.
+  bool fastForwardReplay(ExecutionState &current, ref<Expr> condition,
+                         bool isInternal, StatePair &result);
+
+  // Add the deferred branch conditions of a fast-forwarded state, and
+  // terminate it when they are unsatisfiable. Returns false when the state
+  // was terminated.
+  bool materializeState(ExecutionState &state);
+
   std::set<std::string> extractVarNames(ExecutionState &current,
                                         llvm::Value *v);
 
+  /// \brief Test if the variables of a speculated branch are independent of
+  /// the variables to avoid in Executor#bbOrderToSpecAvoid.
+  bool isSpecIndependent(ExecutionState &current, llvm::Instruction *binst);
+
+  /// \brief Test if a speculation opened into the given block is bound to
+  /// fail, before reaching a branch or anything that may end its path.
+  ///
+  /// The blocks are followed along their unconditional branches, as long as
+  /// they may not end the path, as by a call, a memory error or a
+  /// subsumption. The speculation fails when they reach a block not in
+  /// Executor#visitedBlocks, in coverage speculation, or loop back, as the
+  /// revisit of a program point fails it.
+  bool isSpecBoundToFail(llvm::BasicBlock *target);
+
   // Generally the nodes are in normal mode. In case an infeasible path
   // is found, an speculation node is generated for the infeasible path
   // excluding the last constraint and the execution of the speculation
   // node will be continued in speculationFork.
+  /// \brief Open a speculation node, unless declined by
+  /// TxSpeculationController, in which case the path condition is marked
+  /// with the unsatisfiability core of the infeasible branch
   StatePair addSpeculationNode(ExecutionState &current, ref<Expr> condition,
                                llvm::Instruction *binst, bool isInternal,
-                               bool falseBranchIsInfeasible);
+                               bool falseBranchIsInfeasible,
+                               std::vector<ref<Expr> > &unsatCore);
 
   void speculativeBackJump(ExecutionState &current);
   bool checkSpeculation(ExecutionState &current);
@@ -395,11 +518,12 @@ private:
                    ExecutionState &state) const;
 
   Cell &getArgumentCell(ExecutionState &state, KFunction *kf, unsigned index) {
-    return state.stack.back().locals[kf->getArgRegister(index)];
+    return state.stack.back()
+        .getWritableLocals()[kf->getArgRegister(index)];
   }
 
   Cell &getDestCell(ExecutionState &state, KInstruction *target) {
-    return state.stack.back().locals[target->dest];
+    return state.stack.back().getWritableLocals()[target->dest];
   }
 
   void bindLocal(KInstruction *target, ExecutionState &state, ref<Expr> value);
@@ -444,8 +568,14 @@ private:
   void terminateStateOnSubsumption(ExecutionState &state);
   // call exit handler and terminate state
   void terminateStateEarly(ExecutionState &state, const llvm::Twine &message);
+  // terminate a state whose path belongs to the partition of another process
+  void terminateStateOutOfPartition(ExecutionState &state);
   // call exit handler and terminate state
   void terminateStateOnExit(ExecutionState &state);
+  // whether an error is to be given a test, the first at its instruction, or
+  // the first at its instruction under the call stack with -error-memo
+  bool isNewError(const ExecutionState &state, llvm::Instruction *lastInst,
+                  const std::string &message);
   // call error handler and terminate state
   void terminateStateOnError(ExecutionState &state, const llvm::Twine &message,
                              enum TerminateReason termReason,
@@ -486,6 +616,13 @@ private:
   void initTimers();
   void processTimers(ExecutionState *current, double maxInstTime);
   void checkMemoryUsage();
+  /// Spill the states to be selected last, until about the given number of
+  /// bytes are spilled.
+  void spillStates(uint64_t bytes);
+  /// Free the memory held by the subsumption table and by the solver caches,
+  /// down to the memory cap, given the memory used in MB. Returns the memory
+  /// used afterwards.
+  unsigned shedMemory(unsigned mbs);
   void printDebugInstructions(ExecutionState &state);
   void doDumpStates();
 
@@ -529,6 +666,17 @@ public:
 
   virtual void setHaltExecution(bool value) { haltExecution = value; }
 
+  /// \brief Merge the entries of the subsumption table file into the
+  /// subsumption table, and save the table back into the file.
+  void syncSubsumptionTable();
+
+  /// \brief Take a checkpoint of the exploration, with the live states.
+  void checkpoint();
+
+  /// \brief Write the census of the memory of the interpolation tree and the
+  /// subsumption table into the output directory.
+  void takeTxMemoryCensus();
+
   virtual void setInhibitForking(bool value) { inhibitForking = value; }
 
   /*** State accessor methods ***/
@@ -541,6 +689,14 @@ public:
   getConstraintLog(const ExecutionState &state, std::string &res,
                    Interpreter::LogType logFormat = Interpreter::STP);
 
+  /// Compute the values of the objects satisfying the constraints of the
+  /// state, from one of its models when there is one, querying the solver
+  /// only for the objects in the constraints otherwise.
+  bool getModelSolution(const ExecutionState &state,
+                        const std::vector<const Array *> &objects,
+                        std::vector<std::vector<unsigned char> > &values,
+                        std::vector<ref<Expr> > &unsatCore);
+
   virtual bool getSymbolicSolution(
       const ExecutionState &state,
       std::vector<std::pair<std::string, std::vector<unsigned char> > > &res);
@@ -12,7 +12,9 @@
 #include "PTree.h"
 #include "StatsTracker.h"
 #include "ExecutorTimerInfo.h"
+#include "TxMemoryCensus.h"
 
+#include "klee/CommandLine.h"
 #include "klee/ExecutionState.h"
 #include "klee/Internal/Module/InstructionInfoTable.h"
 #include "klee/Internal/Module/KInstruction.h"
@@ -28,10 +30,10 @@
 
 #include "llvm/Support/CommandLine.h"
 
-#include <unistd.h>
-#include <signal.h>
-#include <sys/time.h>
 #include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
 
 
 using namespace llvm;
@@ -42,6 +44,13 @@ cl::opt<double> MaxTime("max-time",
                                  "seconds (default=0 (off))"),
                         cl::init(0));
 
+cl::opt<double>
+    CheckpointInterval("checkpoint-interval",
+                       cl::desc("The number of seconds between the "
+                                "checkpoints of -checkpoint-dir "
+                                "(default=300)"),
+                       cl::init(300));
+
 ///
 
 class HaltTimer : public Executor::Timer {
@@ -59,29 +68,83 @@ public:
 
 ///
 
+class SubsumptionTableSyncTimer : public Executor::Timer {
+  Executor *executor;
+
+public:
+  SubsumptionTableSyncTimer(Executor *_executor) : executor(_executor) {}
+  ~SubsumptionTableSyncTimer() {}
+
+  void run() { executor->syncSubsumptionTable(); }
+};
+
+///
+
+class CheckpointTimer : public Executor::Timer {
+  Executor *executor;
+
+public:
+  CheckpointTimer(Executor *_executor) : executor(_executor) {}
+  ~CheckpointTimer() {}
+
+  void run() { executor->checkpoint(); }
+};
+
+///
+
+class TxMemoryCensusTimer : public Executor::Timer {
+  Executor *executor;
+
+public:
+  TxMemoryCensusTimer(Executor *_executor) : executor(_executor) {}
+  ~TxMemoryCensusTimer() {}
+
+  void run() { executor->takeTxMemoryCensus(); }
+};
+
+///
+
 static const double kSecondsPerTick = .1;
+
+/// The ticks of the timer thread since the timers were last processed, which
+/// the interpreter tests after each instruction
 static volatile unsigned timerTicks = 0;
 
 // XXX hack
-extern "C" unsigned dumpStates, dumpPTree;
-unsigned dumpStates = 0, dumpPTree = 0;
-
-static void onAlarm(int) {
-  ++timerTicks;
+extern "C" unsigned dumpStates, dumpPTree, dumpTxMemory;
+unsigned dumpStates = 0, dumpPTree = 0, dumpTxMemory = 0;
+
+static void *runTimerThread(void *) {
+  struct timespec tick;
+  tick.tv_sec = (time_t) kSecondsPerTick;
+  tick.tv_nsec = (long) (fmod(kSecondsPerTick, 1.)*1000000000);
+
+  // An interrupted sleep only makes the tick early
+  for (;;) {
+    nanosleep(&tick, 0);
+    __sync_fetch_and_add(&timerTicks, 1);
+  }
+  return 0;
 }
 
-// oooogalay
-static void setupHandler() {
-  struct itimerval t;
-  struct timeval tv;
-  
-  tv.tv_sec = (long) kSecondsPerTick;
-  tv.tv_usec = (long) (fmod(kSecondsPerTick, 1.)*1000000);
-  
-  t.it_interval = t.it_value = tv;
-  
-  ::setitimer(ITIMER_REAL, &t, 0);
-  ::signal(SIGALRM, onAlarm);
+// The ticks come from a thread rather than from SIGALRM, such that they
+// neither interrupt the system calls of the interpreter nor need rearming when
+// a signal gets lost.
+static void startTimerThread() {
+  // The signals are left to the interpreter thread
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  pthread_t thread;
+  if (pthread_create(&thread, &attr, runTimerThread, 0))
+    klee_error("could not start the timer thread");
+  pthread_attr_destroy(&attr);
+
+  pthread_sigmask(SIG_SETMASK, &old, 0);
 }
 
 void Executor::initTimers() {
@@ -89,12 +152,26 @@ void Executor::initTimers() {
 
   if (first) {
     first = false;
-    setupHandler();
+    startTimerThread();
   }
 
   if (MaxTime) {
     addTimer(new HaltTimer(this), MaxTime.getValue());
   }
+
+  if (checkpointer && CheckpointInterval > 0)
+    addTimer(new CheckpointTimer(this), CheckpointInterval.getValue());
+
+  if (TxMemoryCensus::getInterval() > 0)
+    addTimer(new TxMemoryCensusTimer(this), TxMemoryCensus::getInterval());
+
+#ifdef ENABLE_Z3
+  if (INTERPOLATION_ENABLED && !SubsumptionTableFile.empty() &&
+      SubsumptionTableSyncInterval > 0) {
+    addTimer(new SubsumptionTableSyncTimer(this),
+             SubsumptionTableSyncInterval.getValue());
+  }
+#endif
 }
 
 ///
@@ -109,102 +186,106 @@ void Executor::addTimer(Timer *timer, double rate) {
 
 void Executor::processTimers(ExecutionState *current,
                              double maxInstTime) {
-  static unsigned callsWithoutCheck = 0;
-  unsigned ticks = timerTicks;
+  if (!timerTicks && !dumpPTree && !dumpStates && !dumpTxMemory)
+    return;
 
-  if (!ticks && ++callsWithoutCheck > 1000) {
-    setupHandler();
-    ticks = 1;
+  unsigned ticks = __sync_lock_test_and_set(&timerTicks, 0);
+  if (dumpPTree && !processTree) {
+    klee_warning("no process tree to dump (use -keep-process-tree)");
+    dumpPTree = 0;
   }
 
-  if (ticks || dumpPTree || dumpStates) {
-    if (dumpPTree) {
-      char name[32];
-      sprintf(name, "ptree%08d.dot", (int) stats::instructions);
-      llvm::raw_ostream *os = interpreterHandler->openOutputFile(name);
-      if (os) {
-        processTree->dump(*os);
-        delete os;
-      }
-      
-      dumpPTree = 0;
+  if (dumpPTree) {
+    char name[32];
+    sprintf(name, "ptree%08d.dot", (int) stats::instructions);
+    llvm::raw_ostream *os = interpreterHandler->openOutputFile(name);
+    if (os) {
+      processTree->dump(*os);
+      delete os;
     }
+    
+    dumpPTree = 0;
+  }
 
-    if (dumpStates) {
-      llvm::raw_ostream *os = interpreterHandler->openOutputFile("states.txt");
-      
-      if (os) {
-        for (std::set<ExecutionState*>::const_iterator it = states.begin(), 
-               ie = states.end(); it != ie; ++it) {
-          ExecutionState *es = *it;
-          *os << "(" << es << ",";
-          *os << "[";
-          ExecutionState::stack_ty::iterator next = es->stack.begin();
-          ++next;
-          for (ExecutionState::stack_ty::iterator sfIt = es->stack.begin(),
-                 sf_ie = es->stack.end(); sfIt != sf_ie; ++sfIt) {
-            *os << "('" << sfIt->kf->function->getName().str() << "',";
-            if (next == es->stack.end()) {
-              *os << es->prevPC->info->line << "), ";
-            } else {
-              *os << next->caller->info->line << "), ";
-              ++next;
-            }
+  if (dumpTxMemory) {
+    if (txTree)
+      takeTxMemoryCensus();
+    else
+      klee_warning("no interpolation tree to take the memory census of");
+    dumpTxMemory = 0;
+  }
+
+  if (dumpStates) {
+    llvm::raw_ostream *os = interpreterHandler->openOutputFile("states.txt");
+    
+    if (os) {
+      for (std::set<ExecutionState*>::const_iterator it = states.begin(), 
+             ie = states.end(); it != ie; ++it) {
+        ExecutionState *es = *it;
+        *os << "(" << es << ",";
+        *os << "[";
+        ExecutionState::stack_ty::iterator next = es->stack.begin();
+        ++next;
+        for (ExecutionState::stack_ty::iterator sfIt = es->stack.begin(),
+               sf_ie = es->stack.end(); sfIt != sf_ie; ++sfIt) {
+          *os << "('" << sfIt->kf->function->getName().str() << "',";
+          if (next == es->stack.end()) {
+            *os << es->prevPC->info->line << "), ";
+          } else {
+            *os << next->caller->info->line << "), ";
+            ++next;
           }
-          *os << "], ";
-
-          StackFrame &sf = es->stack.back();
-          uint64_t md2u = computeMinDistToUncovered(es->pc,
-                                                    sf.minDistToUncoveredOnReturn);
-          uint64_t icnt = theStatisticManager->getIndexedValue(stats::instructions,
-                                                               es->pc->info->id);
-          uint64_t cpicnt = sf.callPathNode->statistics.getValue(stats::instructions);
-
-          *os << "{";
-          *os << "'depth' : " << es->depth << ", ";
-          *os << "'weight' : " << es->weight << ", ";
-          *os << "'queryCost' : " << es->queryCost << ", ";
-          *os << "'coveredNew' : " << es->coveredNew << ", ";
-          *os << "'instsSinceCovNew' : " << es->instsSinceCovNew << ", ";
-          *os << "'md2u' : " << md2u << ", ";
-          *os << "'icnt' : " << icnt << ", ";
-          *os << "'CPicnt' : " << cpicnt << ", ";
-          *os << "}";
-          *os << ")\n";
         }
-        
-        delete os;
+        *os << "], ";
+
+        StackFrame &sf = es->stack.back();
+        uint64_t md2u = computeMinDistToUncovered(es->pc,
+                                                  sf.minDistToUncoveredOnReturn);
+        uint64_t icnt = theStatisticManager->getIndexedValue(stats::instructions,
+                                                             es->pc->info->id);
+        uint64_t cpicnt = sf.callPathNode->statistics.getValue(stats::instructions);
+
+        *os << "{";
+        *os << "'depth' : " << es->depth << ", ";
+        *os << "'weight' : " << es->weight << ", ";
+        *os << "'queryCost' : " << es->queryCost << ", ";
+        *os << "'coveredNew' : " << es->coveredNew << ", ";
+        *os << "'instsSinceCovNew' : " << es->instsSinceCovNew << ", ";
+        *os << "'md2u' : " << md2u << ", ";
+        *os << "'icnt' : " << icnt << ", ";
+        *os << "'CPicnt' : " << cpicnt << ", ";
+        *os << "}";
+        *os << ")\n";
       }
-
-      dumpStates = 0;
+      
+      delete os;
     }
 
-    if (maxInstTime > 0 && current &&
-        std::find(removedStates.begin(), removedStates.end(), current) ==
-            removedStates.end()) {
-      if (timerTicks*kSecondsPerTick > maxInstTime) {
-        klee_warning("max-instruction-time exceeded: %.2fs",
-                     timerTicks*kSecondsPerTick);
-        terminateStateEarly(*current, "max-instruction-time exceeded");
-      }
+    dumpStates = 0;
+  }
+
+  if (maxInstTime > 0 && current &&
+      std::find(removedStates.begin(), removedStates.end(), current) ==
+          removedStates.end()) {
+    if (ticks*kSecondsPerTick > maxInstTime) {
+      klee_warning("max-instruction-time exceeded: %.2fs",
+                   ticks*kSecondsPerTick);
+      terminateStateEarly(*current, "max-instruction-time exceeded");
     }
+  }
 
-    if (!timers.empty()) {
-      double time = util::getWallTime();
+  if (!timers.empty()) {
+    double time = util::getWallTime();
 
-      for (std::vector<TimerInfo*>::iterator it = timers.begin(), 
-             ie = timers.end(); it != ie; ++it) {
-        TimerInfo *ti = *it;
-        
-        if (time >= ti->nextFireTime) {
-          ti->timer->run();
-          ti->nextFireTime = time + ti->rate;
-        }
+    for (std::vector<TimerInfo*>::iterator it = timers.begin(), 
+           ie = timers.end(); it != ie; ++it) {
+      TimerInfo *ti = *it;
+      
+      if (time >= ti->nextFireTime) {
+        ti->timer->run();
+        ti->nextFireTime = time + ti->rate;
       }
     }
-
-    timerTicks = 0;
-    callsWithoutCheck = 0;
   }
 }
 
@@ -137,17 +137,33 @@ bool ExternalDispatcher::executeCall(Function *f, Instruction *i, uint64_t *args
     }
 #endif
 
-    dispatcher = createDispatcher(f,i);
+    // The stub only depends on the target and on the types of the arguments
+    // at the call site, so it is compiled once for all such call sites.
+    CallSite cs(i);
+    std::vector<LLVM_TYPE_Q Type *> argTypes;
+    for (CallSite::arg_iterator ai = cs.arg_begin(), ae = cs.arg_end();
+         ai != ae; ++ai)
+      argTypes.push_back((*ai)->getType());
+    const FunctionType *callType =
+        FunctionType::get(i->getType(), argTypes, false);
+
+    stubs_ty::iterator stubIt = stubs.find(std::make_pair(f, callType));
+    if (stubIt != stubs.end()) {
+      dispatcher = stubIt->second;
+    } else {
+      dispatcher = createDispatcher(f, i);
+      stubs.insert(std::make_pair(std::make_pair(f, callType), dispatcher));
+
+      if (dispatcher) {
+        // Force the JIT execution engine to go ahead and build the function.
+        // This ensures that any errors or assertions in the compilation
+        // process will trigger crashes instead of being caught as aborts in
+        // the external function.
+        executionEngine->recompileAndRelinkFunction(dispatcher);
+      }
+    }
 
     dispatchers.insert(std::make_pair(i, dispatcher));
-
-    if (dispatcher) {
-      // Force the JIT execution engine to go ahead and build the function. This
-      // ensures that any errors or assertions in the compilation process will
-      // trigger crashes instead of being caught as aborts in the external
-      // function.
-      executionEngine->recompileAndRelinkFunction(dispatcher);
-    }
   } else {
     dispatcher = it->second;
   }
@@ -27,6 +27,12 @@ namespace klee {
   private:
     typedef std::map<const llvm::Instruction*,llvm::Function*> dispatchers_ty;
     dispatchers_ty dispatchers;
+    /// The dispatchers by target function and type of the call site, shared
+    /// by the call sites that pass the same argument types
+    typedef std::map<std::pair<const llvm::Function *,
+                               const llvm::FunctionType *>,
+                     llvm::Function *> stubs_ty;
+    stubs_ty stubs;
     llvm::Module *dispatchModule;
     llvm::ExecutionEngine *executionEngine;
     std::map<std::string, void*> preboundFunctions;
@@ -0,0 +1,130 @@
+//===-- HardwareCounters.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "HardwareCounters.h"
+
+#include "CoreStats.h"
+#include "SamplingProfiler.h"
+
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace klee;
+
+namespace {
+/// The descriptor of the group of the counters, led by the cycles
+int groupFd = -1;
+
+/// The values of the counters at the last read
+uint64_t last[HardwareCounters::CounterCount];
+
+Statistic *const counterStats[HardwareCounters::CounterCount] = {
+  &stats::hwCycles, &stats::hwInstructions, &stats::hwCacheMisses,
+  &stats::hwBranchMisses
+};
+}
+
+bool HardwareCounters::enabled = false;
+
+bool HardwareCounters::attributing = false;
+
+uint64_t HardwareCounters::totals[PhaseCount][CounterCount];
+
+const char *const HardwareCounters::names[CounterCount] = {
+  "HwCycles", "HwInstructions", "HwCacheMisses", "HwBranchMisses"
+};
+
+bool HardwareCounters::open() {
+#ifdef __linux__
+  static const uint64_t configs[CounterCount] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+  };
+
+  for (unsigned i = 0; i < CounterCount; ++i) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = configs[i];
+    attr.read_format = PERF_FORMAT_GROUP;
+    // Only the user space of the process is counted, which the default
+    // paranoia level of the kernel allows
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.disabled = i == 0;
+
+    int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+    if (fd < 0) {
+      klee_warning("hardware counters: cannot open the counter of %s",
+                   names[i]);
+      if (groupFd >= 0)
+        ::close(groupFd);
+      groupFd = -1;
+      return false;
+    }
+    if (i == 0)
+      groupFd = fd;
+  }
+
+  memset(totals, 0, sizeof(totals));
+  memset(last, 0, sizeof(last));
+  ioctl(groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  enabled = true;
+  return true;
+#else
+  klee_warning("hardware counters: not supported on this system");
+  return false;
+#endif
+}
+
+void HardwareCounters::update(uint32_t phases) {
+  // The number of the counters, followed by their values
+  uint64_t values[1 + CounterCount];
+  if (::read(groupFd, values, sizeof(values)) != (ssize_t)sizeof(values))
+    return;
+
+  unsigned phase = phases & ((1 << SamplingProfiler::PhaseBits) - 1);
+  for (unsigned i = 0; i < CounterCount; ++i) {
+    uint64_t delta = values[1 + i] - last[i];
+    last[i] = values[1 + i];
+    totals[phase][i] += delta;
+    if (attributing)
+      *counterStats[i] += delta;
+  }
+}
+
+uint64_t HardwareCounters::total(Counter counter) {
+  uint64_t res = 0;
+  for (unsigned i = 0; i < PhaseCount; ++i)
+    res += totals[i][counter];
+  return res;
+}
+
+void HardwareCounters::print() {
+  for (unsigned i = 0; i < PhaseCount; ++i) {
+    if (!totals[i][Cycles])
+      continue;
+    klee_message("hardware counters: %s: %llu cycles, %llu instructions, "
+                 "%llu cache misses, %llu branch misses",
+                 i ? SamplingProfiler::getPhaseName(i) : "other",
+                 (unsigned long long)totals[i][Cycles],
+                 (unsigned long long)totals[i][Instructions],
+                 (unsigned long long)totals[i][CacheMisses],
+                 (unsigned long long)totals[i][BranchMisses]);
+  }
+}
@@ -0,0 +1,61 @@
+//===-- HardwareCounters.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_HARDWARECOUNTERS_H
+#define KLEE_HARDWARECOUNTERS_H
+
+#include <stdint.h>
+
+namespace klee {
+
+/// HardwareCounters - Counts the cycles, the instructions retired, the last
+/// level cache misses and the branch misses of the process, with the
+/// perf_event counters of Linux, by phase of the executor.
+///
+/// The counters are read whenever the innermost phase of SamplingProfiler
+/// changes, and the counts since the last read are added to the totals of
+/// the phase left. The counts of the sampled instructions are also added to
+/// the statistics of their instructions, for istats.
+class HardwareCounters {
+public:
+  enum Counter { Cycles, Instructions, CacheMisses, BranchMisses, CounterCount };
+
+  /// The phases are those of SamplingProfiler, zero being none
+  static const unsigned PhaseCount = 8;
+
+  /// Whether the counters are open
+  static bool enabled;
+
+  /// Whether the counts are added to the statistics of the current
+  /// instruction, set while a sampled instruction runs
+  static bool attributing;
+
+  /// The counts by phase
+  static uint64_t totals[PhaseCount][CounterCount];
+
+  /// The names of the counters, as used in run.stats
+  static const char *const names[CounterCount];
+
+  /// Open the counters. Returns false, with a warning, when the system does
+  /// not provide them.
+  static bool open();
+
+  /// Read the counters, and add the counts since the last read to the
+  /// innermost phase, the phase word being that before the change.
+  static void update(uint32_t phases);
+
+  /// The count of a counter over all the phases
+  static uint64_t total(Counter counter);
+
+  /// Print the counts by phase.
+  static void print();
+};
+}
+
+#endif
@@ -186,6 +186,27 @@ void ImpliedValue::getImpliedValues(ref<Expr> e,
   }
 }
     
+const ImpliedValueList &
+ImpliedValueCache::getImpliedValues(ref<Expr> e, ref<ConstantExpr> cvalue) {
+  ExprHashMap<std::pair<ref<ConstantExpr>, ImpliedValueList> >::iterator it =
+      cache.find(e);
+  if (it != cache.end() && it->second.first == cvalue)
+    return it->second.second;
+
+  if (it == cache.end()) {
+    if (cache.size() >= MaxSize)
+      cache.clear();
+    it = cache.insert(std::make_pair(e, std::make_pair(cvalue,
+                                                       ImpliedValueList())))
+             .first;
+  } else {
+    it->second.first = cvalue;
+    it->second.second.clear();
+  }
+  ImpliedValue::getImpliedValues(e, cvalue, it->second.second);
+  return it->second.second;
+}
+
 void ImpliedValue::checkForImpliedValues(Solver *S, ref<Expr> e, 
                                          ref<ConstantExpr> value) {
   std::vector<ref<ReadExpr> > reads;
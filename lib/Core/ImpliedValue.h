@@ -11,6 +11,7 @@
 #define KLEE_IMPLIEDVALUE_H
 
 #include "klee/Expr.h"
+#include "klee/util/ExprHashMap.h"
 
 #include <vector>
 
@@ -36,6 +37,21 @@ namespace klee {
                                ref<ConstantExpr> cvalue);    
   }
 
+  /// ImpliedValueCache - The implied values of the expressions found equal
+  /// to constants, kept as the same branch conditions recur along the paths
+  /// and across the states. The cache is cleared when it is full.
+  class ImpliedValueCache {
+    ExprHashMap<std::pair<ref<ConstantExpr>, ImpliedValueList> > cache;
+
+  public:
+    enum { MaxSize = 4096 };
+
+    /// The implied values of the expression e equal to cvalue, which are
+    /// valid until the next call.
+    const ImpliedValueList &getImpliedValues(ref<Expr> e,
+                                             ref<ConstantExpr> cvalue);
+  };
+
 }
 
 #endif
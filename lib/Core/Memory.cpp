@@ -34,6 +34,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 
@@ -44,6 +45,19 @@ namespace {
   cl::opt<bool>
   UseConstantArrays("use-constant-arrays",
                     cl::init(true));
+
+  cl::opt<bool>
+  CompactUpdateLists("compact-update-lists",
+                     cl::desc("Fold long update lists with only constant "
+                              "updates of constant arrays into a new constant "
+                              "array (default=on)"),
+                     cl::init(true));
+
+  cl::opt<bool>
+  ShareArrays("share-arrays",
+              cl::desc("Share the equal constant arrays and update nodes "
+                       "created by the states (default=on)"),
+              cl::init(true));
 }
 
 /***/
@@ -100,15 +114,19 @@ void MemoryObject::getAllocInfo(std::string &result) const {
 
 /***/
 
+uint64_t ObjectState::concreteVersionCounter = 0;
+
 ObjectState::ObjectState(const MemoryObject *mo)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
-    concreteStore(new uint8_t[mo->size]),
+    concreteStore(mo->size),
+    concreteVersion(++concreteVersionCounter),
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
     updates(0, 0),
+    constantUpdates(true),
     size(mo->size),
     readOnly(false) {
   mo->refCount++;
@@ -127,7 +145,7 @@ ObjectState::ObjectState(const MemoryObject *mo)
       TxShadowArray::addShadowArrayMap(array, shadow);
     }
   }
-  memset(concreteStore, 0, size);
+  concreteStore.fill(0);
 }
 
 
@@ -135,47 +153,44 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
-    concreteStore(new uint8_t[mo->size]),
+    concreteStore(mo->size),
+    concreteVersion(++concreteVersionCounter),
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
     updates(array, 0),
+    constantUpdates(true),
     size(mo->size),
     readOnly(false) {
   mo->refCount++;
   makeSymbolic();
-  memset(concreteStore, 0, size);
+  concreteStore.fill(0);
 }
 
 ObjectState::ObjectState(const ObjectState &os) 
   : copyOnWriteOwner(0),
     refCount(0),
     object(os.object),
-    concreteStore(new uint8_t[os.size]),
+    concreteStore(os.concreteStore),
+    concreteVersion(os.concreteVersion),
     concreteMask(os.concreteMask ? new BitArray(*os.concreteMask, os.size) : 0),
     flushMask(os.flushMask ? new BitArray(*os.flushMask, os.size) : 0),
-    knownSymbolics(0),
+    knownSymbolics(os.knownSymbolics
+                       ? new ChunkedArray<ref<Expr> >(*os.knownSymbolics)
+                       : 0),
     updates(os.updates),
+    constantUpdates(os.constantUpdates),
     size(os.size),
     readOnly(false) {
   assert(!os.readOnly && "no need to copy read only object?");
   if (object)
     object->refCount++;
-
-  if (os.knownSymbolics) {
-    knownSymbolics = new ref<Expr>[size];
-    for (unsigned i=0; i<size; i++)
-      knownSymbolics[i] = os.knownSymbolics[i];
-  }
-
-  memcpy(concreteStore, os.concreteStore, size*sizeof(*concreteStore));
 }
 
 ObjectState::~ObjectState() {
   if (concreteMask) delete concreteMask;
   if (flushMask) delete flushMask;
-  if (knownSymbolics) delete[] knownSymbolics;
-  delete[] concreteStore;
+  if (knownSymbolics) delete knownSymbolics;
 
   if (object)
   {
@@ -195,6 +210,56 @@ ArrayCache *ObjectState::getArrayCache() const {
 
 /***/
 
+void ObjectState::setConstantRoot(
+    const std::vector<ref<ConstantExpr> > &contents) const {
+  static unsigned id = 0;
+  const std::string arrayName = "const_arr" + llvm::utostr(++id);
+  const unsigned arrayWidth = size;
+  const Array *array =
+      ShareArrays
+          ? getArrayCache()->CreateSharedConstantArray(
+                arrayName, arrayWidth, &contents[0],
+                &contents[0] + contents.size())
+          : getArrayCache()->CreateArray(arrayName, arrayWidth, &contents[0],
+                                         &contents[0] + contents.size());
+  updates = UpdateList(array, 0);
+  constantUpdates = true;
+
+  if (INTERPOLATION_ENABLED) {
+    // We create shadow array as existentially-quantified
+    // variables for subsumption checking. A shared array keeps its name, and
+    // with it its shadow array.
+    const Array *shadow = getArrayCache()->CreateArray(TxShadowArray::getShadowName(array->name), arrayWidth);
+    TxShadowArray::addShadowArrayMap(array, shadow);
+  }
+}
+
+void ObjectState::compactUpdates() const {
+  std::vector<ref<ConstantExpr> > Contents(updates.root->constantValues);
+
+  // The latest write at an index is the first one found from the head.
+  std::vector<bool> Written(size, false);
+  for (const UpdateNode *un = updates.head; un; un = un->next) {
+    uint64_t Index = cast<ConstantExpr>(un->index)->getZExtValue();
+    if (!Written[Index]) {
+      Written[Index] = true;
+      Contents[Index] = cast<ConstantExpr>(un->value);
+    }
+  }
+
+  setConstantRoot(Contents);
+}
+
+void ObjectState::extendUpdates(const ref<Expr> &index,
+                                const ref<Expr> &value) const {
+  if (!isa<ConstantExpr>(index) || !isa<ConstantExpr>(value))
+    constantUpdates = false;
+  if (ShareArrays)
+    getArrayCache()->extendUpdates(updates, index, value);
+  else
+    updates.extend(index, value);
+}
+
 const UpdateList &ObjectState::getUpdates() const {
   // Constant arrays are created lazily.
   if (!updates.root) {
@@ -232,24 +297,19 @@ const UpdateList &ObjectState::getUpdates() const {
       Contents[Index->getZExtValue()] = Value;
     }
 
-    static unsigned id = 0;
-    const std::string arrayName = "const_arr" + llvm::utostr(++id);
-    const unsigned arrayWidth = size;
-    const Array *array = getArrayCache()->CreateArray(
-        arrayName, arrayWidth, &Contents[0],
-        &Contents[0] + Contents.size());
-    updates = UpdateList(array, 0);
+    setConstantRoot(Contents);
 
     // Apply the remaining (non-constant) writes.
     for (; Begin != End; ++Begin)
-      updates.extend(Writes[Begin].first, Writes[Begin].second);
-
-    if (INTERPOLATION_ENABLED) {
-      // We create shadow array as existentially-quantified
-      // variables for subsumption checking
-      const Array *shadow = getArrayCache()->CreateArray(TxShadowArray::getShadowName(arrayName), arrayWidth);
-      TxShadowArray::addShadowArrayMap(array, shadow);
-    }
+      extendUpdates(Writes[Begin].first, Writes[Begin].second);
+  } else if (CompactUpdateLists && constantUpdates && updates.head &&
+             updates.root->isConstantArray() &&
+             updates.head->getSize() >= std::max(32u, size / 8)) {
+    // Repeated symbolic reads of a concrete object flush its rewritten bytes
+    // again and again; folding them keeps the list short. Only lists without
+    // symbolic updates can be folded, as the later concrete writes cannot be
+    // moved below a symbolic one.
+    compactUpdates();
   }
 
   return updates;
@@ -258,7 +318,7 @@ const UpdateList &ObjectState::getUpdates() const {
 void ObjectState::makeConcrete() {
   if (concreteMask) delete concreteMask;
   if (flushMask) delete flushMask;
-  if (knownSymbolics) delete[] knownSymbolics;
+  if (knownSymbolics) delete knownSymbolics;
   concreteMask = 0;
   flushMask = 0;
   knownSymbolics = 0;
@@ -268,25 +328,31 @@ void ObjectState::makeSymbolic() {
   assert(!updates.head &&
          "XXX makeSymbolic of objects with symbolic values is unsupported");
 
-  // XXX simplify this, can just delete various arrays I guess
-  for (unsigned i=0; i<size; i++) {
-    markByteSymbolic(i);
-    setKnownSymbolic(i, 0);
-    markByteFlushed(i);
+  if (concreteMask)
+    concreteMask->unsetRange(0, size);
+  else
+    concreteMask = new BitArray(size, false);
+  if (knownSymbolics) {
+    delete knownSymbolics;
+    knownSymbolics = 0;
   }
+  if (flushMask)
+    flushMask->unsetRange(0, size);
+  else
+    flushMask = new BitArray(size, false);
 }
 
 void ObjectState::initializeToZero() {
   makeConcrete();
-  memset(concreteStore, 0, size);
+  concreteStore.fill(0);
+  updateConcreteVersion();
 }
 
 void ObjectState::initializeToRandom() {  
   makeConcrete();
-  for (unsigned i=0; i<size; i++) {
-    // randomly selected by 256 sided die
-    concreteStore[i] = 0xAB;
-  }
+  // randomly selected by 256 sided die
+  concreteStore.fill(0xAB);
+  updateConcreteVersion();
 }
 
 /*
@@ -307,51 +373,41 @@ void ObjectState::fastRangeCheckOffset(ref<Expr> offset,
 void ObjectState::flushRangeForRead(unsigned rangeBase, 
                                     unsigned rangeSize) const {
   if (!flushMask) flushMask = new BitArray(size, true);
- 
-  for (unsigned offset=rangeBase; offset<rangeBase+rangeSize; offset++) {
-    if (!isByteFlushed(offset)) {
-      if (isByteConcrete(offset)) {
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(concreteStore[offset], Expr::Int8));
-      } else {
-        assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
-      }
 
-      flushMask->unset(offset);
+  // Only the unflushed bytes, set in flushMask, are visited
+  unsigned rangeEnd = rangeBase + rangeSize;
+  for (unsigned offset = flushMask->findFirstSet(rangeBase, rangeSize);
+       offset < rangeEnd;
+       offset = flushMask->findFirstSet(offset + 1, rangeEnd - offset - 1)) {
+    if (isByteConcrete(offset)) {
+      extendUpdates(ConstantExpr::create(offset, Expr::Int32),
+                     ConstantExpr::create(concreteStore.get(offset),
+                                          Expr::Int8));
+    } else {
+      assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
+      extendUpdates(ConstantExpr::create(offset, Expr::Int32),
+                     knownSymbolics->get(offset));
     }
-  } 
+  }
+  flushMask->unsetRange(rangeBase, rangeSize);
 }
 
 void ObjectState::flushRangeForWrite(unsigned rangeBase, 
                                      unsigned rangeSize) {
-  if (!flushMask) flushMask = new BitArray(size, true);
-
-  for (unsigned offset=rangeBase; offset<rangeBase+rangeSize; offset++) {
-    if (!isByteFlushed(offset)) {
-      if (isByteConcrete(offset)) {
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(concreteStore[offset], Expr::Int8));
-        markByteSymbolic(offset);
-      } else {
-        assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
-        setKnownSymbolic(offset, 0);
-      }
+  flushRangeForRead(rangeBase, rangeSize);
+  if (!rangeSize)
+    return;
 
-      flushMask->unset(offset);
-    } else {
-      // flushed bytes that are written over still need
-      // to be marked out
-      if (isByteConcrete(offset)) {
-        markByteSymbolic(offset);
-      } else if (isByteKnownSymbolic(offset)) {
-        setKnownSymbolic(offset, 0);
-      }
-    }
-  } 
+  // The bytes written over, flushed now, are all marked out
+  if (!isRangeSymbolic(rangeBase, rangeSize)) {
+    if (!concreteMask)
+      concreteMask = new BitArray(size, true);
+    concreteMask->unsetRange(rangeBase, rangeSize);
+  }
+  if (knownSymbolics) {
+    for (unsigned offset = rangeBase; offset < rangeBase + rangeSize; offset++)
+      setKnownSymbolic(offset, 0);
+  }
 }
 
 bool ObjectState::isByteConcrete(unsigned offset) const {
@@ -362,8 +418,20 @@ bool ObjectState::isByteFlushed(unsigned offset) const {
   return flushMask && !flushMask->get(offset);
 }
 
+bool ObjectState::isRangeConcrete(unsigned offset, unsigned count) const {
+  return !concreteMask || concreteMask->isAllSet(offset, count);
+}
+
+bool ObjectState::isRangeUnflushed(unsigned offset, unsigned count) const {
+  return !flushMask || flushMask->isAllSet(offset, count);
+}
+
+bool ObjectState::isRangeSymbolic(unsigned offset, unsigned count) const {
+  return concreteMask && concreteMask->isAllUnset(offset, count);
+}
+
 bool ObjectState::isByteKnownSymbolic(unsigned offset) const {
-  return knownSymbolics && knownSymbolics[offset].get();
+  return knownSymbolics && knownSymbolics->get(offset).get();
 }
 
 void ObjectState::markByteConcrete(unsigned offset) {
@@ -393,11 +461,13 @@ void ObjectState::markByteFlushed(unsigned offset) {
 void ObjectState::setKnownSymbolic(unsigned offset, 
                                    Expr *value /* can be null */) {
   if (knownSymbolics) {
-    knownSymbolics[offset] = value;
+    // Avoid duplicating a shared chunk when the byte is already unknown
+    if (value || knownSymbolics->get(offset).get())
+      knownSymbolics->set(offset, value);
   } else {
     if (value) {
-      knownSymbolics = new ref<Expr>[size];
-      knownSymbolics[offset] = value;
+      knownSymbolics = new ChunkedArray<ref<Expr> >(size);
+      knownSymbolics->set(offset, value);
     }
   }
 }
@@ -406,9 +476,9 @@ void ObjectState::setKnownSymbolic(unsigned offset,
 
 ref<Expr> ObjectState::read8(unsigned offset) const {
   if (isByteConcrete(offset)) {
-    return ConstantExpr::create(concreteStore[offset], Expr::Int8);
+    return ConstantExpr::create(concreteStore.get(offset), Expr::Int8);
   } else if (isByteKnownSymbolic(offset)) {
-    return knownSymbolics[offset];
+    return knownSymbolics->get(offset);
   } else {
     assert(isByteFlushed(offset) && "unflushed byte without cache value");
     
@@ -436,7 +506,10 @@ ref<Expr> ObjectState::read8(ref<Expr> offset) const {
 
 void ObjectState::write8(unsigned offset, uint8_t value) {
   //assert(read_only == false && "writing to read-only object!");
-  concreteStore[offset] = value;
+  if (concreteStore.get(offset) != value) {
+    concreteStore.set(offset, value);
+    updateConcreteVersion();
+  }
   setKnownSymbolic(offset, 0);
 
   markByteConcrete(offset);
@@ -469,7 +542,49 @@ void ObjectState::write8(ref<Expr> offset, ref<Expr> value) {
                       allocInfo.c_str());
   }
   
-  updates.extend(ZExtExpr::create(offset, Expr::Int32), value);
+  extendUpdates(ZExtExpr::create(offset, Expr::Int32), value);
+}
+
+bool ObjectState::readConcrete(unsigned offset, unsigned NumBytes,
+                               uint64_t &value) const {
+  if (!isRangeConcrete(offset, NumBytes))
+    return false;
+  const uint8_t *bytes = concreteStore.getRange(offset, NumBytes);
+  if (!bytes)
+    return false;
+
+  bool littleEndian = Context::get().isLittleEndian();
+  value = 0;
+  for (unsigned i = 0; i != NumBytes; ++i) {
+    unsigned idx = littleEndian ? i : (NumBytes - i - 1);
+    value |= (uint64_t) bytes[idx] << (8 * i);
+  }
+  return true;
+}
+
+bool ObjectState::writeConcrete(unsigned offset, unsigned NumBytes,
+                                uint64_t value) {
+  // The masks need no update when the bytes are already concrete and
+  // unflushed, and these bytes have no known symbolic value.
+  if (!isRangeConcrete(offset, NumBytes) || !isRangeUnflushed(offset, NumBytes))
+    return false;
+  const uint8_t *bytes = concreteStore.getRange(offset, NumBytes);
+  if (!bytes)
+    return false;
+
+  bool littleEndian = Context::get().isLittleEndian();
+  uint8_t values[8];
+  for (unsigned i = 0; i != NumBytes; ++i) {
+    unsigned idx = littleEndian ? i : (NumBytes - i - 1);
+    values[idx] = (uint8_t) (value >> (8 * i));
+  }
+  // Leave a shared chunk shared when its contents do not change
+  if (!std::equal(values, values + NumBytes, bytes)) {
+    std::copy(values, values + NumBytes,
+              concreteStore.getWritableRange(offset, NumBytes));
+    updateConcreteVersion();
+  }
+  return true;
 }
 
 /***/
@@ -506,9 +621,15 @@ ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
   if (width == Expr::Bool)
     return ExtractExpr::create(read8(offset), 0, Expr::Bool);
 
-  // Otherwise, follow the slow general case.
   unsigned NumBytes = width / 8;
   assert(width == NumBytes * 8 && "Invalid width for read size!");
+
+  // Load the concrete bytes at once, without building their expressions.
+  uint64_t value;
+  if (width <= 64 && readConcrete(offset, NumBytes, value))
+    return ConstantExpr::create(value, width);
+
+  // Otherwise, follow the slow general case.
   ref<Expr> Res(0);
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
@@ -581,6 +702,8 @@ void ObjectState::write(unsigned offset, ref<Expr> value) {
 
 void ObjectState::write16(unsigned offset, uint16_t value) {
   unsigned NumBytes = 2;
+  if (writeConcrete(offset, NumBytes, value))
+    return;
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
     write8(offset + idx, (uint8_t) (value >> (8 * i)));
@@ -589,6 +712,8 @@ void ObjectState::write16(unsigned offset, uint16_t value) {
 
 void ObjectState::write32(unsigned offset, uint32_t value) {
   unsigned NumBytes = 4;
+  if (writeConcrete(offset, NumBytes, value))
+    return;
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
     write8(offset + idx, (uint8_t) (value >> (8 * i)));
@@ -597,12 +722,53 @@ void ObjectState::write32(unsigned offset, uint32_t value) {
 
 void ObjectState::write64(unsigned offset, uint64_t value) {
   unsigned NumBytes = 8;
+  if (writeConcrete(offset, NumBytes, value))
+    return;
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
     write8(offset + idx, (uint8_t) (value >> (8 * i)));
   }
 }
 
+void ObjectState::copy(unsigned offset, const ObjectState *src,
+                       unsigned srcOffset, unsigned count) {
+  // The bytes are all read before they are written, for the overlapping
+  // ranges of the same object. The concrete bytes are kept as values, without
+  // making their expressions.
+  std::vector<uint8_t> values(count);
+  std::vector<ref<Expr> > bytes(count);
+  if (src->isRangeConcrete(srcOffset, count)) {
+    for (unsigned i = 0; i != count; ++i)
+      values[i] = src->concreteStore.get(srcOffset + i);
+  } else {
+    for (unsigned i = 0; i != count; ++i) {
+      if (src->isByteConcrete(srcOffset + i))
+        values[i] = src->concreteStore.get(srcOffset + i);
+      else
+        bytes[i] = src->read8(srcOffset + i);
+    }
+  }
+
+  for (unsigned i = 0; i != count; ++i) {
+    if (bytes[i].isNull())
+      write8(offset + i, values[i]);
+    else
+      write8(offset + i, bytes[i]);
+  }
+}
+
+void ObjectState::fill(unsigned offset, ref<Expr> value, unsigned count) {
+  assert(value->getWidth() == Expr::Int8 && "Invalid fill value!");
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
+    uint8_t byte = CE->getZExtValue(8);
+    for (unsigned i = 0; i != count; ++i)
+      write8(offset + i, byte);
+  } else {
+    for (unsigned i = 0; i != count; ++i)
+      write8(offset + i, value);
+  }
+}
+
 void ObjectState::print() {
   llvm::errs() << "-- ObjectState --\n";
   llvm::errs() << "\tMemoryObject ID: " << object->id << "\n";
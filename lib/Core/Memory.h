@@ -10,7 +10,9 @@
 #ifndef KLEE_MEMORY_H
 #define KLEE_MEMORY_H
 
+#include "ChunkedArray.h"
 #include "Context.h"
+#include "TxObjectPool.h"
 #include "klee/Expr.h"
 
 #include "llvm/ADT/StringExtras.h"
@@ -33,6 +35,8 @@ class MemoryObject {
   friend class STPBuilder;
   friend class ObjectState;
   friend class ExecutionState;
+  friend class StateSpiller;
+  friend class SymbolicList;
 
 private:
   static int counter;
@@ -54,6 +58,15 @@ public:
   bool fake_object;
   bool isUserSpecified;
 
+  /// Whether the address of the object may be known to external code, as it
+  /// was reachable from the arguments of an external call
+  mutable bool exposed;
+  /// The version of the concrete contents last copied to or from the actual
+  /// memory at the address of the object, or 0
+  mutable uint64_t hostVersion;
+  /// The version of the concrete contents last scanned for pointers, or 0
+  mutable uint64_t scannedVersion;
+
   MemoryManager *parent;
 
   /// "Location" for which this memory object was allocated. This
@@ -80,6 +93,9 @@ public:
       address(_address),
       size(0),
       isFixed(true),
+      exposed(false),
+      hostVersion(0),
+      scannedVersion(0),
       parent(NULL),
       allocSite(0) {
   }
@@ -98,12 +114,24 @@ public:
       isFixed(_isFixed),
       fake_object(false),
       isUserSpecified(false),
+      exposed(false),
+      hostVersion(0),
+      scannedVersion(0),
       parent(_parent), 
       allocSite(_allocSite) {
   }
 
   ~MemoryObject();
 
+  /// Allocation from the free-list pool of MemoryObject objects
+  static void *operator new(size_t size) {
+    return TxObjectPool<MemoryObject>::allocate(size);
+  }
+
+  static void operator delete(void *object, size_t size) {
+    TxObjectPool<MemoryObject>::deallocate(object, size);
+  }
+
   /// Get an identifying string for this allocation.
   void getAllocInfo(std::string &result) const;
 
@@ -154,20 +182,31 @@ private:
   friend class ObjectHolder;
   unsigned refCount;
 
+  friend class StateSpiller;
+
   const MemoryObject *object;
 
-  uint8_t *concreteStore;
+  // The byte arrays are chunked, so that copying the object state for a
+  // write in a forked state only duplicates the written chunks.
+  ChunkedArray<uint8_t> concreteStore;
+  // Identifies the contents of concreteStore, shared by the copies of the
+  // object state until either is modified.
+  uint64_t concreteVersion;
+  static uint64_t concreteVersionCounter;
   // XXX cleanup name of flushMask (its backwards or something)
   BitArray *concreteMask;
 
   // mutable because may need flushed during read of const
   mutable BitArray *flushMask;
 
-  ref<Expr> *knownSymbolics;
+  ChunkedArray<ref<Expr> > *knownSymbolics;
 
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
 
+  // whether all the updates are at constant indices with constant values
+  mutable bool constantUpdates;
+
 public:
   unsigned size;
 
@@ -208,9 +247,26 @@ public:
   void write32(unsigned offset, uint32_t value);
   void write64(unsigned offset, uint64_t value);
 
+  /// Copy count bytes of src from srcOffset to offset, where src may be this
+  /// object and the ranges may overlap.
+  void copy(unsigned offset, const ObjectState *src, unsigned srcOffset,
+            unsigned count);
+
+  /// Set count bytes from offset to the given byte value.
+  void fill(unsigned offset, ref<Expr> value, unsigned count);
+
 private:
   const UpdateList &getUpdates() const;
 
+  /// Create a constant array with the given contents as root of the updates.
+  void setConstantRoot(const std::vector<ref<ConstantExpr> > &contents) const;
+
+  /// Fold the updates into a fresh constant root array, when they are all
+  /// constant and the root is a constant array.
+  void compactUpdates() const;
+
+  void extendUpdates(const ref<Expr> &index, const ref<Expr> &value) const;
+
   void makeConcrete();
 
   void makeSymbolic();
@@ -228,11 +284,27 @@ private:
   bool isByteFlushed(unsigned offset) const;
   bool isByteKnownSymbolic(unsigned offset) const;
 
+  /// Return whether the count bytes from offset are all concrete, all
+  /// unflushed, or all symbolic, testing the masks a word at a time.
+  bool isRangeConcrete(unsigned offset, unsigned count) const;
+  bool isRangeUnflushed(unsigned offset, unsigned count) const;
+  bool isRangeSymbolic(unsigned offset, unsigned count) const;
+
+  /// Load the value of NumBytes concrete bytes from offset, at most 8, in the
+  /// byte order of the target. Returns false when a byte is not concrete.
+  bool readConcrete(unsigned offset, unsigned NumBytes, uint64_t &value) const;
+
+  /// Store a value into NumBytes bytes from offset, at most 8, when they are
+  /// all concrete and unflushed. Returns false otherwise, leaving the bytes
+  /// to be written one at a time.
+  bool writeConcrete(unsigned offset, unsigned NumBytes, uint64_t value);
+
   void markByteConcrete(unsigned offset);
   void markByteSymbolic(unsigned offset);
   void markByteFlushed(unsigned offset);
   void markByteUnflushed(unsigned offset);
   void setKnownSymbolic(unsigned offset, Expr *value);
+  void updateConcreteVersion() { concreteVersion = ++concreteVersionCounter; }
 
   void print();
   ArrayCache *getArrayCache() const;
@@ -49,12 +49,22 @@ llvm::cl::opt<unsigned long long> DeterministicStartAddress(
     llvm::cl::desc("Start address for deterministic allocation. Has to be page "
                    "aligned (default=0x7ff30000000)."),
     llvm::cl::init(0x7ff30000000));
+
+llvm::cl::opt<bool> DeterministicAllocationReuse(
+    "allocate-determ-reuse",
+    llvm::cl::desc("Reuse the space of the freed deterministic allocations. "
+                   "Use-after-free errors are then only detected until the "
+                   "space is reallocated (default=on)."),
+    llvm::cl::init(true));
 }
 
 /***/
 MemoryManager::MemoryManager(ArrayCache *_arrayCache)
     : arrayCache(_arrayCache), deterministicSpace(0), nextFreeSlot(0),
       spaceSize(DeterministicAllocationSize.getValue() * 1024 * 1024) {
+  for (unsigned i = 0; i < NumSizeClasses; ++i)
+    slabNext[i] = slabEnd[i] = 0;
+
   if (DeterministicAllocation) {
     // Page boundary
     void *expectedAddress = (void *)DeterministicStartAddress.getValue();
@@ -108,22 +118,12 @@ MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
 
   uint64_t address = 0;
   if (DeterministicAllocation) {
-
-    address = llvm::RoundUpToAlignment((uint64_t)nextFreeSlot + alignment - 1,
-                                       alignment);
-
-    // Handle the case of 0-sized allocations as 1-byte allocations.
-    // This way, we make sure we have this allocation between its own red zones
-    size_t alloc_size = std::max(size, (uint64_t)1);
-    if ((char *)address + alloc_size < deterministicSpace + spaceSize) {
-      nextFreeSlot = (char *)address + alloc_size + RedZoneSpace;
-    } else {
+    address = allocateDeterministic(size, alignment);
+    if (!address)
       klee_warning_once(
           0,
           "Couldn't allocate %lu bytes. Not enough deterministic space left.",
           size);
-      address = 0;
-    }
   } else {
     // Use malloc for the standard case
     if (alignment <= 8)
@@ -169,12 +169,105 @@ void MemoryManager::deallocate(const MemoryObject *mo) { assert(0); }
 
 void MemoryManager::markFreed(MemoryObject *mo) {
   if (objects.find(mo) != objects.end()) {
-    if (!mo->isFixed && !DeterministicAllocation)
-      free((void *)mo->address);
+    if (!mo->isFixed) {
+      if (DeterministicAllocation)
+        freeDeterministic(mo->address);
+      else
+        free((void *)mo->address);
+    }
     objects.erase(mo);
   }
 }
 
+uint64_t MemoryManager::bumpDeterministicSpace(uint64_t size,
+                                               uint64_t alignment) {
+  uint64_t address =
+      llvm::RoundUpToAlignment((uint64_t)nextFreeSlot, alignment);
+  if (address + size > (uint64_t)deterministicSpace + spaceSize)
+    return 0;
+  nextFreeSlot = (char *)(address + size);
+  return address;
+}
+
+uint64_t MemoryManager::allocateDeterministic(uint64_t size,
+                                              uint64_t alignment) {
+  // Handle the case of 0-sized allocations as 1-byte allocations.
+  // This way, we make sure we have this allocation between its own red zones
+  uint64_t span = std::max(size, (uint64_t)1) + RedZoneSpace;
+  uint64_t address = 0;
+
+  if (span <= (1 << MaxSizeClassBits) && alignment <= (1 << MaxSizeClassBits)) {
+    // The slots of a class are aligned to their size, which is at least the
+    // alignment, and followed by at least the red zone.
+    unsigned bits = MinSizeClassBits;
+    while ((1ULL << bits) < span || (1ULL << bits) < alignment)
+      ++bits;
+    unsigned sizeClass = bits - MinSizeClassBits;
+    span = 1ULL << bits;
+
+    std::vector<uint64_t> &slots = freeSlots[sizeClass];
+    if (!slots.empty()) {
+      address = slots.back();
+      slots.pop_back();
+    } else {
+      if (slabNext[sizeClass] == slabEnd[sizeClass]) {
+        uint64_t slab = bumpDeterministicSpace(SlabSize, PageSize);
+        if (!slab)
+          return 0;
+        slabNext[sizeClass] = slab;
+        slabEnd[sizeClass] = slab + SlabSize;
+      }
+      address = slabNext[sizeClass];
+      slabNext[sizeClass] += span;
+    }
+  } else {
+    span = llvm::RoundUpToAlignment(span, PageSize);
+    alignment = std::max(alignment, (uint64_t)PageSize);
+
+    std::map<uint64_t, std::vector<uint64_t> >::iterator it =
+        freeRanges.find(span);
+    if (it != freeRanges.end()) {
+      std::vector<uint64_t> &ranges = it->second;
+      for (std::vector<uint64_t>::reverse_iterator rit = ranges.rbegin(),
+                                                   rie = ranges.rend();
+           rit != rie; ++rit) {
+        if (*rit % alignment == 0) {
+          address = *rit;
+          ranges.erase(--rit.base());
+          break;
+        }
+      }
+    }
+    if (!address) {
+      address = bumpDeterministicSpace(span, alignment);
+      if (!address)
+        return 0;
+    }
+  }
+
+  deterministicSpans[address] = span;
+  return address;
+}
+
+void MemoryManager::freeDeterministic(uint64_t address) {
+  std::map<uint64_t, uint64_t>::iterator it = deterministicSpans.find(address);
+  assert(it != deterministicSpans.end() && "freeing unknown allocation");
+  uint64_t span = it->second;
+  deterministicSpans.erase(it);
+
+  if (!DeterministicAllocationReuse)
+    return;
+
+  if (span <= (1 << MaxSizeClassBits)) {
+    unsigned bits = MinSizeClassBits;
+    while ((1ULL << bits) < span)
+      ++bits;
+    freeSlots[bits - MinSizeClassBits].push_back(address);
+  } else {
+    freeRanges[span].push_back(address);
+  }
+}
+
 size_t MemoryManager::getUsedDeterministicSize() {
   return nextFreeSlot - deterministicSpace;
 }
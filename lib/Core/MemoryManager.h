@@ -10,8 +10,10 @@
 #ifndef KLEE_MEMORYMANAGER_H
 #define KLEE_MEMORYMANAGER_H
 
+#include <map>
 #include <set>
 #include <stdint.h>
+#include <vector>
 
 namespace llvm {
 class Value;
@@ -31,6 +33,33 @@ private:
   char *nextFreeSlot;
   size_t spaceSize;
 
+  /// Deterministic allocations are made in slots of power-of-two size
+  /// classes, red zone included, carved from slabs of the deterministic
+  /// space. Larger allocations take whole pages.
+  enum {
+    MinSizeClassBits = 4,
+    MaxSizeClassBits = 12,
+    NumSizeClasses = MaxSizeClassBits - MinSizeClassBits + 1,
+    SlabSize = 64 * 1024,
+    PageSize = 4096
+  };
+
+  /// The free slots of each size class. They are reused last freed first,
+  /// so that the addresses only depend on the sequence of allocations.
+  std::vector<uint64_t> freeSlots[NumSizeClasses];
+  /// The unused part of the current slab of each size class
+  uint64_t slabNext[NumSizeClasses], slabEnd[NumSizeClasses];
+  /// The free page ranges of the large allocations, by size
+  std::map<uint64_t, std::vector<uint64_t> > freeRanges;
+  /// The size of the slot or range of each live deterministic allocation
+  std::map<uint64_t, uint64_t> deterministicSpans;
+
+  /// Take the given number of bytes with the given alignment from the
+  /// unused end of the deterministic space; returns 0 when exhausted.
+  uint64_t bumpDeterministicSpace(uint64_t size, uint64_t alignment);
+  uint64_t allocateDeterministic(uint64_t size, uint64_t alignment);
+  void freeDeterministic(uint64_t address);
+
 public:
   MemoryManager(ArrayCache *arrayCache);
   ~MemoryManager();
@@ -48,7 +77,8 @@ public:
   ArrayCache *getArrayCache() const { return arrayCache; }
 
   /*
-   * Returns the size used by deterministic allocation in bytes
+   * Returns the size used by deterministic allocation in bytes, including the
+   * free slots kept for reuse
    */
   size_t getUsedDeterministicSize();
 };
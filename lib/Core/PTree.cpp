@@ -48,6 +48,24 @@ void PTree::remove(Node *n) {
     delete n;
     n = p;
   } while (n && !n->left && !n->right);
+
+  // Splice out the node left with a single child, such that every inner node
+  // of the tree has two children and the walks from the root only visit the
+  // nodes where the paths branch.
+  if (n) {
+    Node *child = n->left ? n->left : n->right;
+    Node *p = n->parent;
+    child->parent = p;
+    if (!p) {
+      root = child;
+    } else if (n == p->left) {
+      p->left = child;
+    } else {
+      assert(n == p->right);
+      p->right = child;
+    }
+    delete n;
+  }
 }
 
 void PTree::dump(llvm::raw_ostream &os) {
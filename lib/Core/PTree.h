@@ -31,6 +31,9 @@ namespace klee {
     std::pair<Node*,Node*> split(Node *n,
                                  const data_type &leftData,
                                  const data_type &rightData);
+
+    /// Remove a leaf, along with the inner nodes left without leaves below
+    /// them. The inner node left with a single child is replaced by its child.
     void remove(Node *n);
 
     void dump(llvm::raw_ostream &os);
@@ -0,0 +1,150 @@
+//===-- SamplingProfiler.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SamplingProfiler.h"
+
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#else
+#include "llvm/Function.h"
+#include "llvm/Instruction.h"
+#endif
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+struct Sample {
+  /// The phase word in the upper half, and the instruction id plus one in
+  /// the lower half, or zero for an empty slot
+  uint64_t key;
+  uint64_t count;
+};
+
+const unsigned TableSize = 1 << 16;
+
+Sample *table = 0;
+
+/// The samples that did not fit into the table
+volatile uint64_t droppedCount = 0;
+
+const char *phaseNames[] = { "", "interpret", "fork", "solver", "subsumption",
+                             "wp", "tabling", "dependency" };
+}
+
+volatile uint32_t SamplingProfiler::phases = SamplingProfiler::Interpret;
+
+KInstruction *volatile SamplingProfiler::instruction = 0;
+
+static void onSample(int) {
+  KInstruction *ki = SamplingProfiler::instruction;
+  uint64_t key = ((uint64_t)SamplingProfiler::phases << 32) |
+                 (ki ? ki->info->id + 1 : 0);
+
+  // Open addressing with linear probing, bounded to keep the handler short
+  unsigned slot = (unsigned)((key * 0x9e3779b97f4a7c15ULL) >> 48);
+  for (unsigned i = 0; i < 64; ++i, slot = (slot + 1) % TableSize) {
+    if (table[slot].key == key) {
+      ++table[slot].count;
+      return;
+    }
+    if (!table[slot].key) {
+      table[slot].key = key;
+      table[slot].count = 1;
+      return;
+    }
+  }
+  ++droppedCount;
+}
+
+void SamplingProfiler::start(unsigned interval) {
+  if (!table) {
+    table = new Sample[TableSize];
+    memset(table, 0, sizeof(Sample) * TableSize);
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = onSample;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  ::sigaction(SIGPROF, &action, 0);
+
+  struct itimerval t;
+  t.it_interval.tv_sec = interval / 1000000;
+  t.it_interval.tv_usec = interval % 1000000;
+  t.it_value = t.it_interval;
+  ::setitimer(ITIMER_PROF, &t, 0);
+}
+
+void SamplingProfiler::stop() {
+  struct itimerval t;
+  memset(&t, 0, sizeof(t));
+  ::setitimer(ITIMER_PROF, &t, 0);
+  ::signal(SIGPROF, SIG_IGN);
+}
+
+const char *SamplingProfiler::getPhaseName(unsigned phase) {
+  return phase <= Dependency ? phaseNames[phase] : "unknown";
+}
+
+void SamplingProfiler::dump(llvm::raw_ostream &os, KModule *kmodule) {
+  if (!table)
+    return;
+
+  std::map<unsigned, KInstruction *> instructions;
+  for (std::vector<KFunction *>::iterator it = kmodule->functions.begin(),
+                                          ie = kmodule->functions.end();
+       it != ie; ++it) {
+    KFunction *kf = *it;
+    for (unsigned i = 0; i < kf->numInstructions; ++i)
+      instructions[kf->instructions[i]->info->id] = kf->instructions[i];
+  }
+
+  for (unsigned slot = 0; slot < TableSize; ++slot) {
+    const Sample &s = table[slot];
+    if (!s.key)
+      continue;
+
+    // The outermost phase is in the highest nonzero bits
+    std::vector<unsigned> stack;
+    for (uint32_t word = s.key >> 32; word; word >>= PhaseBits)
+      stack.push_back(word & ((1 << PhaseBits) - 1));
+    for (std::vector<unsigned>::reverse_iterator it = stack.rbegin(),
+                                                 ie = stack.rend();
+         it != ie; ++it)
+      os << (it == stack.rbegin() ? "" : ";")
+         << getPhaseName(*it);
+
+    unsigned id = (unsigned)(s.key & 0xffffffff);
+    std::map<unsigned, KInstruction *>::iterator it =
+        id ? instructions.find(id - 1) : instructions.end();
+    if (it != instructions.end()) {
+      KInstruction *ki = it->second;
+      os << ";" << ki->inst->getParent()->getParent()->getName() << ";"
+         << ki->info->file << ":" << ki->info->line;
+    }
+    os << " " << s.count << "\n";
+  }
+
+  if (droppedCount)
+    klee_warning("sampling profile: %llu samples did not fit into the table",
+                 (unsigned long long)droppedCount);
+}
@@ -0,0 +1,92 @@
+//===-- SamplingProfiler.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SAMPLINGPROFILER_H
+#define KLEE_SAMPLINGPROFILER_H
+
+#include "HardwareCounters.h"
+
+#include <signal.h>
+#include <stdint.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace klee {
+struct KInstruction;
+class KModule;
+
+/// SamplingProfiler - Samples the phase of the executor and the instruction
+/// being interpreted on a CPU time timer.
+///
+/// The phases are nested: the phase word holds the stack of the current
+/// phases, three bits each, the innermost in the lowest bits. Entering and
+/// leaving a phase is only a store into the word, and a read of the
+/// HardwareCounters when they are enabled, such that the phases can be
+/// marked on the hot path whether the profiler runs or not. The signal
+/// handler counts the samples by phase word and instruction into a table
+/// allocated up front, as it cannot allocate.
+///
+/// The profile is written in the folded stack format of the flame graph
+/// tools: one line per phase stack and instruction, with the phases from the
+/// outermost, the function and the source location of the instruction, and
+/// the number of samples.
+class SamplingProfiler {
+public:
+  enum Phase {
+    Interpret = 1,
+    Fork,
+    Solver,
+    Subsumption,
+    WeakestPrecondition,
+    Tabling,
+    Dependency
+  };
+
+  /// Scope - Marks a phase for the lifetime of the object.
+  class Scope {
+    uint32_t saved;
+
+  public:
+    explicit Scope(Phase phase) : saved(phases) {
+      if (HardwareCounters::enabled)
+        HardwareCounters::update(saved);
+      phases = (saved << PhaseBits) | phase;
+    }
+    ~Scope() {
+      if (HardwareCounters::enabled)
+        HardwareCounters::update(phases);
+      phases = saved;
+    }
+  };
+
+  static const unsigned PhaseBits = 3;
+
+  /// The stack of the current phases
+  static volatile uint32_t phases;
+
+  /// The instruction being interpreted
+  static KInstruction *volatile instruction;
+
+  /// Start sampling every given number of microseconds of CPU time.
+  static void start(unsigned interval);
+
+  /// Stop sampling.
+  static void stop();
+
+  /// The name of a phase, as written in the profile
+  static const char *getPhaseName(unsigned phase);
+
+  /// Write the samples in the folded stack format.
+  static void dump(llvm::raw_ostream &os, KModule *kmodule);
+};
+}
+
+#endif
@@ -13,13 +13,14 @@
 #include "Executor.h"
 #include "PTree.h"
 #include "StatsTracker.h"
+#include "TxTree.h"
 
 #include "klee/ExecutionState.h"
 #include "klee/Statistics.h"
 #include "klee/Internal/Module/InstructionInfoTable.h"
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Module/KModule.h"
-#include "klee/Internal/ADT/DiscretePDF.h"
+#include "klee/Internal/ADT/FenwickPDF.h"
 #include "klee/Internal/ADT/RNG.h"
 #include "klee/Internal/Support/ModuleUtil.h"
 #include "klee/Internal/System/Time.h"
@@ -37,10 +38,13 @@
 
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
 #include "llvm/Support/CallSite.h"
+#include "llvm/Support/CFG.h"
 #else
 #include "llvm/IR/CallSite.h"
+#include "llvm/IR/CFG.h"
 #endif
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <climits>
@@ -62,6 +66,67 @@ Searcher::~Searcher() {
 
 ///
 
+/// The number of holes a state list keeps, whatever its number of states
+static const unsigned MinStateListHoles = 64;
+
+void StateList::push_back(ExecutionState *es) {
+  if (es->slot >= positions.size())
+    positions.resize(ExecutionState::getSlotCount());
+  positions[es->slot] = popped + slots.size();
+  slots.push_back(es);
+  ++count;
+}
+
+bool StateList::remove(ExecutionState *es) {
+  if (es->slot >= positions.size())
+    return false;
+  // The position of a slot is stale once its state is removed
+  uint64_t position = positions[es->slot];
+  if (position < popped || position - popped >= slots.size() ||
+      slots[position - popped] != es)
+    return false;
+
+  slots[position - popped] = 0;
+  --count;
+  while (!slots.empty() && !slots.back())
+    slots.pop_back();
+  while (!slots.empty() && !slots.front()) {
+    slots.pop_front();
+    ++popped;
+  }
+  if (slots.size() > 2 * count + MinStateListHoles)
+    compact();
+  return true;
+}
+
+void StateList::compact() {
+  std::deque<ExecutionState *> live;
+  for (std::deque<ExecutionState *>::iterator it = slots.begin(),
+                                              ie = slots.end();
+       it != ie; ++it) {
+    if (*it) {
+      positions[(*it)->slot] = live.size();
+      live.push_back(*it);
+    }
+  }
+  slots.swap(live);
+  popped = 0;
+}
+
+std::vector<ExecutionState *> StateList::getStates() const {
+  std::vector<ExecutionState *> res;
+  res.reserve(count);
+  for (std::deque<ExecutionState *>::const_iterator it = slots.begin(),
+                                                    ie = slots.end();
+       it != ie; ++it) {
+    if (*it)
+      res.push_back(*it);
+  }
+  return res;
+}
+
+///
+
 ExecutionState &DFSSearcher::selectState() {
   return *states.back();
 }
@@ -69,32 +134,108 @@ ExecutionState &DFSSearcher::selectState() {
 void DFSSearcher::update(ExecutionState *current,
                          const std::vector<ExecutionState *> &addedStates,
                          const std::vector<ExecutionState *> &removedStates) {
-  states.insert(states.end(),
-                addedStates.begin(),
-                addedStates.end());
+  for (std::vector<ExecutionState *>::const_iterator it = addedStates.begin(),
+                                                     ie = addedStates.end();
+       it != ie; ++it)
+    states.push_back(*it);
   for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
                                                      ie = removedStates.end();
        it != ie; ++it) {
-    ExecutionState *es = *it;
-    if (es == states.back()) {
-      states.pop_back();
-    } else {
-      bool ok = false;
-
-      for (std::vector<ExecutionState*>::iterator it = states.begin(),
-             ie = states.end(); it != ie; ++it) {
-        if (es==*it) {
-          states.erase(it);
-          ok = true;
-          break;
-        }
-      }
+    bool ok = states.remove(*it);
+    assert(ok && "invalid state removed");
+    (void)ok;
+  }
+}
+
+///
+
+/// Collect the program points following the basic block of the state, where
+/// it will next be checked for subsumption.
+static void getHeadingPoints(const ExecutionState &state,
+                             std::vector<uintptr_t> &points) {
+  BasicBlock *bb = state.pc->inst->getParent();
+  for (succ_iterator it = succ_begin(bb), ie = succ_end(bb); it != ie; ++it)
+    points.push_back(reinterpret_cast<uintptr_t>(&*(*it)->begin()));
+}
+
+void TxSubsumptionSearcher::rank() {
+  rankedEntryNumber = TxTree::entryNumber;
+
+  std::vector<ExecutionState *> live = states.getStates();
+
+  // The number of states heading into each program point
+  std::map<uintptr_t, unsigned> heading;
+  std::vector<std::vector<uintptr_t> > headingPoints(live.size());
+  for (unsigned i = 0; i < live.size(); ++i) {
+    getHeadingPoints(*live[i], headingPoints[i]);
+    for (std::vector<uintptr_t>::iterator it = headingPoints[i].begin(),
+                                          ie = headingPoints[i].end();
+         it != ie; ++it)
+      ++heading[*it];
+  }
+
+  selected = 0;
+  bool bestAtEntry = false, bestHeadingToEntry = false;
+  unsigned bestUnlocked = 0;
+  for (unsigned i = live.size(); i != 0;) {
+    ExecutionState *es = live[--i];
+
+    bool atEntry = INTERPOLATION_ENABLED && es->txTreeNode &&
+                   es->pc->hasTableEntry &&
+                   TxSubsumptionTable::hasInterpolation(*es);
+
+    bool headingToEntry = false;
+    for (std::vector<uintptr_t>::iterator it = headingPoints[i].begin(),
+                                          ie = headingPoints[i].end();
+         it != ie && !headingToEntry; ++it)
+      headingToEntry = TxSubsumptionTable::getEntryCount(*it) > 0;
+
+    unsigned unlocked = 0;
+    if (es->txTreeNode) {
+      std::map<uintptr_t, unsigned>::iterator it =
+          heading.find(es->txTreeNode->getProgramPoint());
+      if (it != heading.end())
+        unlocked = it->second;
+    }
 
-      assert(ok && "invalid state removed");
+    if (!selected || atEntry > bestAtEntry ||
+        (atEntry == bestAtEntry &&
+         (headingToEntry > bestHeadingToEntry ||
+          (headingToEntry == bestHeadingToEntry && unlocked > bestUnlocked)))) {
+      selected = es;
+      bestAtEntry = atEntry;
+      bestHeadingToEntry = headingToEntry;
+      bestUnlocked = unlocked;
     }
   }
 }
 
+ExecutionState &TxSubsumptionSearcher::selectState() {
+  if (!selected || rankedEntryNumber != TxTree::entryNumber)
+    rank();
+  return *selected;
+}
+
+void TxSubsumptionSearcher::update(
+    ExecutionState *current, const std::vector<ExecutionState *> &addedStates,
+    const std::vector<ExecutionState *> &removedStates) {
+  if (addedStates.empty() && removedStates.empty())
+    return;
+
+  for (std::vector<ExecutionState *>::const_iterator it = addedStates.begin(),
+                                                     ie = addedStates.end();
+       it != ie; ++it)
+    states.push_back(*it);
+  for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
+                                                     ie = removedStates.end();
+       it != ie; ++it) {
+    bool ok = states.remove(*it);
+    assert(ok && "invalid state removed");
+    (void)ok;
+  }
+  selected = 0;
+}
+
 ///
 
 ExecutionState &BFSSearcher::selectState() {
@@ -104,29 +245,16 @@ ExecutionState &BFSSearcher::selectState() {
 void BFSSearcher::update(ExecutionState *current,
                          const std::vector<ExecutionState *> &addedStates,
                          const std::vector<ExecutionState *> &removedStates) {
-  states.insert(states.end(),
-                addedStates.begin(),
-                addedStates.end());
+  for (std::vector<ExecutionState *>::const_iterator it = addedStates.begin(),
+                                                     ie = addedStates.end();
+       it != ie; ++it)
+    states.push_back(*it);
   for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
                                                      ie = removedStates.end();
        it != ie; ++it) {
-    ExecutionState *es = *it;
-    if (es == states.front()) {
-      states.pop_front();
-    } else {
-      bool ok = false;
-
-      for (std::deque<ExecutionState*>::iterator it = states.begin(),
-             ie = states.end(); it != ie; ++it) {
-        if (es==*it) {
-          states.erase(it);
-          ok = true;
-          break;
-        }
-      }
-
-      assert(ok && "invalid state removed");
-    }
+    bool ok = states.remove(*it);
+    assert(ok && "invalid state removed");
+    (void)ok;
   }
 }
 
@@ -140,33 +268,34 @@ void
 RandomSearcher::update(ExecutionState *current,
                        const std::vector<ExecutionState *> &addedStates,
                        const std::vector<ExecutionState *> &removedStates) {
-  states.insert(states.end(),
-                addedStates.begin(),
-                addedStates.end());
+  for (std::vector<ExecutionState *>::const_iterator it = addedStates.begin(),
+                                                     ie = addedStates.end();
+       it != ie; ++it) {
+    ExecutionState *es = *it;
+    if (es->slot >= indices.size())
+      indices.resize(ExecutionState::getSlotCount());
+    indices[es->slot] = states.size();
+    states.push_back(es);
+  }
   for (std::vector<ExecutionState *>::const_iterator it = removedStates.begin(),
                                                      ie = removedStates.end();
        it != ie; ++it) {
     ExecutionState *es = *it;
-    bool ok = false;
-
-    for (std::vector<ExecutionState*>::iterator it = states.begin(),
-           ie = states.end(); it != ie; ++it) {
-      if (es==*it) {
-        states.erase(it);
-        ok = true;
-        break;
-      }
-    }
-    
-    assert(ok && "invalid state removed");
+    assert(es->slot < indices.size() && indices[es->slot] < states.size() &&
+           states[indices[es->slot]] == es && "invalid state removed");
+    // The order of the states does not matter, the last one fills the gap
+    unsigned index = indices[es->slot];
+    states[index] = states.back();
+    indices[states[index]->slot] = index;
+    states.pop_back();
   }
 }
 
 ///
 
 WeightedRandomSearcher::WeightedRandomSearcher(WeightType _type)
-  : states(new DiscretePDF<ExecutionState*>()),
-    type(_type) {
+  : states(new FenwickPDF<ExecutionState*>()),
+    type(_type), epoch(StatsTracker::uncoveredEpoch) {
   switch(type) {
   case Depth: 
     updateWeights = false;
@@ -187,7 +316,31 @@ WeightedRandomSearcher::~WeightedRandomSearcher() {
   delete states;
 }
 
+void WeightedRandomSearcher::refreshWeights() {
+  // The distances to uncovered instructions of all the states change with
+  // each recomputation of the uncovered instructions, and only then
+  if ((type == MinDistToUncovered || type == CoveringNew) &&
+      epoch != StatsTracker::uncoveredEpoch) {
+    epoch = StatsTracker::uncoveredEpoch;
+    for (FenwickPDF<ExecutionState *>::iterator it = states->begin(),
+                                                ie = states->end();
+         it != ie; ++it)
+      states->update(*it, getWeight(*it));
+    stale.clear();
+    return;
+  }
+
+  for (std::vector<ExecutionState *>::iterator it = stale.begin(),
+                                               ie = stale.end();
+       it != ie; ++it) {
+    if (states->inTree(*it))
+      states->update(*it, getWeight(*it));
+  }
+  stale.clear();
+}
+
 ExecutionState &WeightedRandomSearcher::selectState() {
+  refreshWeights();
   return *states->choose(theRNG.getDoubleL());
 }
 
@@ -231,10 +384,11 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
 void WeightedRandomSearcher::update(
     ExecutionState *current, const std::vector<ExecutionState *> &addedStates,
     const std::vector<ExecutionState *> &removedStates) {
-  if (current && updateWeights &&
-      std::find(removedStates.begin(), removedStates.end(), current) ==
-          removedStates.end())
-    states->update(current, getWeight(current));
+  // The weight of the current state is only refreshed when the next state is
+  // selected, such that a batch of instructions of the same state, as run
+  // under BatchingSearcher, costs a single computation of its weight
+  if (current && updateWeights && (stale.empty() || stale.back() != current))
+    stale.push_back(current);
 
   for (std::vector<ExecutionState *>::const_iterator it = addedStates.begin(),
                                                      ie = addedStates.end();
@@ -266,20 +420,18 @@ RandomPathSearcher::~RandomPathSearcher() {
 ExecutionState &RandomPathSearcher::selectState() {
   unsigned flips=0, bits=0;
   PTree::Node *n = executor.processTree->root;
-  
+
+  // PTree::remove keeps every inner node with two children, such that a coin
+  // is flipped at each step, and a selection takes as many steps as the
+  // branches on the path of the selected state.
   while (!n->data) {
-    if (!n->left) {
-      n = n->right;
-    } else if (!n->right) {
-      n = n->left;
-    } else {
-      if (bits==0) {
-        flips = theRNG.getInt32();
-        bits = 32;
-      }
-      --bits;
-      n = (flips&(1<<bits)) ? n->left : n->right;
+    assert(n->left && n->right && "inner node with a single child");
+    if (bits==0) {
+      flips = theRNG.getInt32();
+      bits = 32;
     }
+    --bits;
+    n = (flips&(1<<bits)) ? n->left : n->right;
   }
 
   return *n->data;
@@ -11,10 +11,12 @@
 #define KLEE_SEARCHER_H
 
 #include "llvm/Support/raw_ostream.h"
+#include <deque>
 #include <vector>
 #include <set>
 #include <map>
 #include <queue>
+#include <stdint.h>
 
 namespace llvm {
   class BasicBlock;
@@ -24,7 +26,7 @@ namespace llvm {
 }
 
 namespace klee {
-  template<class T> class DiscretePDF;
+  template<class T> class FenwickPDF;
   class ExecutionState;
   class Executor;
 
@@ -80,12 +82,45 @@ namespace klee {
       NURS_Depth,
       NURS_ICnt,
       NURS_CPICnt,
-      NURS_QC
+      NURS_QC,
+      TxSubsumption
     };
   };
 
+  /// StateList - An ordered list of states, any of which is removed in
+  /// constant time through the position recorded for the slot of the state.
+  /// A removed state leaves a hole, skipped over, and the holes are reclaimed
+  /// once they outnumber the states.
+  class StateList {
+    /// The states, with null holes, never at the front or back
+    std::deque<ExecutionState *> slots;
+    /// The position of each state among all the slots ever pushed, by the
+    /// slot of the state
+    std::vector<uint64_t> positions;
+    /// The number of slots popped off the front
+    uint64_t popped;
+    unsigned count;
+
+    void compact();
+
+  public:
+    StateList() : popped(0), count(0) {}
+
+    bool empty() const { return !count; }
+    unsigned size() const { return count; }
+    ExecutionState *front() const { return slots.front(); }
+    ExecutionState *back() const { return slots.back(); }
+
+    void push_back(ExecutionState *es);
+
+    /// Remove a state, returning false if it is not in the list.
+    bool remove(ExecutionState *es);
+
+    std::vector<ExecutionState *> getStates() const;
+  };
+
   class DFSSearcher : public Searcher {
-    std::vector<ExecutionState*> states;
+    StateList states;
 
   public:
     ExecutionState &selectState();
@@ -97,11 +132,46 @@ namespace klee {
       os << "DFSSearcher\n";
     }
 
-    virtual std::vector<ExecutionState *> getStates() { return states; }
+    virtual std::vector<ExecutionState *> getStates() {
+      return states.getStates();
+    }
+  };
+
+  /// TxSubsumptionSearcher - Order the states by how soon they help
+  /// subsumption in the Tracer-X tree. The states at a program point with
+  /// table entries for their call history come first. Next come the states
+  /// heading into program points with table entries. Among the rest, the
+  /// states of the subtrees that would provide entries to the program points
+  /// the most other states are heading into are preferred. Ties are broken in
+  /// depth-first order. The states are only ranked again on the addition or
+  /// removal of states, or of table entries.
+  class TxSubsumptionSearcher : public Searcher {
+    StateList states;
+    ExecutionState *selected;
+    /// The number of table entries when the states were last ranked
+    double rankedEntryNumber;
+
+    void rank();
+
+  public:
+    TxSubsumptionSearcher() : selected(0), rankedEntryNumber(0) {}
+
+    ExecutionState &selectState();
+    void update(ExecutionState *current,
+                const std::vector<ExecutionState *> &addedStates,
+                const std::vector<ExecutionState *> &removedStates);
+    bool empty() { return states.empty(); }
+    void printName(llvm::raw_ostream &os) {
+      os << "TxSubsumptionSearcher\n";
+    }
+
+    virtual std::vector<ExecutionState *> getStates() {
+      return states.getStates();
+    }
   };
 
   class BFSSearcher : public Searcher {
-    std::deque<ExecutionState*> states;
+    StateList states;
 
   public:
     ExecutionState &selectState();
@@ -113,12 +183,14 @@ namespace klee {
       os << "BFSSearcher\n";
     }
     virtual std::vector<ExecutionState *> getStates() {
-      return std::vector<ExecutionState *>(states.begin(), states.end());
+      return states.getStates();
     }
   };
 
   class RandomSearcher : public Searcher {
     std::vector<ExecutionState*> states;
+    /// The index of each state in states, by the slot of the state
+    std::vector<unsigned> indices;
 
   public:
     ExecutionState &selectState();
@@ -145,10 +217,20 @@ namespace klee {
     };
 
   private:
-    DiscretePDF<ExecutionState*> *states;
+    FenwickPDF<ExecutionState*> *states;
     WeightType type;
     bool updateWeights;
-    
+
+    /// The states executed since the last selection, whose weights are
+    /// refreshed at the next selection rather than after every instruction
+    std::vector<ExecutionState *> stale;
+
+    /// The StatsTracker::uncoveredEpoch of the last refresh of the weights of
+    /// all the states, for the weights by distance to uncovered instructions
+    unsigned epoch;
+
+    void refreshWeights();
+
     double getWeight(ExecutionState*);
 
   public:
@@ -38,7 +38,11 @@
 #include "llvm/IR/DataLayout.h"
 #endif
 
+#include <algorithm>
 #include <errno.h>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
 
 using namespace llvm;
 using namespace klee;
@@ -56,6 +60,38 @@ cl::opt<bool>
                      cl::desc("Silently terminate paths with an infeasible "
                               "condition given to klee_assume() rather than "
                               "emitting an error (default=false)"));
+
+cl::opt<std::string> MemoTableFile(
+    "memo-table-file",
+    cl::desc("Load the tuples memoized by tracerx_memo from the given file "
+             "at startup when it was saved for the same module, and save "
+             "them into the file at exit."),
+    cl::init(""));
+
+cl::opt<bool> BulkMemoryFunctions(
+    "bulk-memory-functions",
+    cl::desc("Run the calls to memcpy, memmove and memset in the executor, "
+             "instead of interpreting their loops, when the addresses and the "
+             "size are constant and the ranges lie within single objects. "
+             "Not applied with interpolation (default=on)."),
+    cl::init(true));
+
+cl::opt<bool> StringFunctionSummaries(
+    "string-function-summaries",
+    cl::desc("Compute the results of the calls to strlen, strcmp, strncmp, "
+             "memcmp and memchr as single expressions over the bytes of "
+             "their ranges, instead of interpreting their loops, when the "
+             "addresses are constant and the ranges lie within single "
+             "objects. Not applied with interpolation (default=off)."),
+    cl::init(false));
+
+/// The most bytes of a range read by a summary of a string function
+const uint64_t MaxSummaryLength = 4096;
+
+/// Identifies files saved by SpecialFunctionHandler::MemoTable::save
+const uint32_t MemoTableFileMagic = 0x544d5854; // "TXMT"
+
+const uint32_t MemoTableFileVersion = 1;
 }
 
 /// \todo Almost all of the demands in this file should be replaced
@@ -86,6 +122,7 @@ static SpecialFunctionHandler::HandlerInfo handlerInfo[] = {
     add("free", handleFree, false),
     add("klee_assume", handleAssume, false),
     add("klee_check_memory_access", handleCheckMemoryAccess, false),
+    add("klee_copy_bytes", handleCopyBytes, true),
     add("klee_get_valuef", handleGetValue, true),
     add("klee_get_valued", handleGetValue, true),
     add("klee_get_valuel", handleGetValue, true),
@@ -171,7 +208,9 @@ int SpecialFunctionHandler::size() {
 }
 
 SpecialFunctionHandler::SpecialFunctionHandler(Executor &_executor)
-    : executor(_executor) {}
+    : executor(_executor), memcpyFunction(0), memmoveFunction(0),
+      memsetFunction(0), strlenFunction(0), strcmpFunction(0),
+      strncmpFunction(0), memcmpFunction(0), memchrFunction(0) {}
 
 void SpecialFunctionHandler::prepare() {
   unsigned N = size();
@@ -213,6 +252,180 @@ void SpecialFunctionHandler::bind() {
     if (f && (!hi.doNotOverride || f->isDeclaration()))
       handlers[f] = std::make_pair(hi.handler, hi.hasReturnValue);
   }
+
+  memcpyFunction = executor.kmodule->module->getFunction("memcpy");
+  memmoveFunction = executor.kmodule->module->getFunction("memmove");
+  memsetFunction = executor.kmodule->module->getFunction("memset");
+  strlenFunction = executor.kmodule->module->getFunction("strlen");
+  strcmpFunction = executor.kmodule->module->getFunction("strcmp");
+  strncmpFunction = executor.kmodule->module->getFunction("strncmp");
+  memcmpFunction = executor.kmodule->module->getFunction("memcmp");
+  memchrFunction = executor.kmodule->module->getFunction("memchr");
+}
+
+/// Find the object of a range at a constant address, and the offset of the
+/// range in the object, when the range lies within the object.
+static bool resolveRange(ExecutionState &state, ref<Expr> address,
+                         uint64_t count, ObjectPair &op, uint64_t &offset) {
+  klee::ConstantExpr *ce = dyn_cast<klee::ConstantExpr>(address);
+  if (!ce || !state.addressSpace.resolveOne(ce, op))
+    return false;
+  offset = ce->getZExtValue() - op.first->address;
+  return count <= op.first->size - offset;
+}
+
+bool SpecialFunctionHandler::handleMemoryFunction(
+    ExecutionState &state, Function *f, KInstruction *target,
+    std::vector<ref<Expr> > &arguments) {
+  if (handleStringFunction(state, f, target, arguments))
+    return true;
+  if (!BulkMemoryFunctions || INTERPOLATION_ENABLED || arguments.size() != 3)
+    return false;
+
+  bool done;
+  if (f == memcpyFunction || f == memmoveFunction)
+    done = copyBytes(state, arguments[0], arguments[1], arguments[2]);
+  else if (f == memsetFunction)
+    done = setBytes(state, arguments[0],
+                    ExtractExpr::create(arguments[1], 0, Expr::Int8),
+                    arguments[2]);
+  else
+    return false;
+
+  // The functions return their destination
+  if (done && !target->inst->use_empty())
+    executor.bindLocal(target, state, arguments[0]);
+  return done;
+}
+
+bool SpecialFunctionHandler::handleStringFunction(
+    ExecutionState &state, Function *f, KInstruction *target,
+    std::vector<ref<Expr> > &arguments) {
+  if (!StringFunctionSummaries || INTERPOLATION_ENABLED || !f ||
+      target->inst->getType()->isVoidTy())
+    return false;
+
+  Expr::Width width = executor.getWidthForLLVMType(target->inst->getType());
+  std::vector<ref<Expr> > a, b;
+  uint64_t n = ~UINT64_C(0);
+  ref<Expr> result;
+
+  if (f == strlenFunction && arguments.size() == 1) {
+    if (!readBytes(state, arguments[0], n, a))
+      return false;
+    // The length is that of the first NUL
+    ref<Expr> nul = ConstantExpr::create(0, Expr::Int8);
+    ref<Expr> found = ConstantExpr::create(0, Expr::Bool);
+    result = ConstantExpr::create(0, width);
+    for (uint64_t i = a.size(); i-- > 0;) {
+      ref<Expr> eq = EqExpr::create(a[i], nul);
+      result = SelectExpr::create(eq, ConstantExpr::create(i, width), result);
+      found = OrExpr::create(eq, found);
+    }
+    if (!mustHold(state, found))
+      return false;
+  } else if (f == memchrFunction && arguments.size() == 3) {
+    if (!readCount(state, arguments[2], n) ||
+        !readBytes(state, arguments[0], n, a) || a.size() != n)
+      return false;
+    ref<Expr> c = ExtractExpr::create(arguments[1], 0, Expr::Int8);
+    ref<Expr> s = executor.toUnique(state, arguments[0]);
+    result = ConstantExpr::create(0, width);
+    for (uint64_t i = a.size(); i-- > 0;)
+      result = SelectExpr::create(
+          EqExpr::create(a[i], c),
+          AddExpr::create(s, ConstantExpr::create(i, s->getWidth())), result);
+  } else if ((f == memcmpFunction || f == strncmpFunction) &&
+             arguments.size() == 3) {
+    if (!readCount(state, arguments[2], n) ||
+        !readBytes(state, arguments[0], n, a) ||
+        !readBytes(state, arguments[1], n, b))
+      return false;
+    // The ranges of memcmp are read in full, the strings of strncmp need only
+    // differ or end within both objects
+    bool full = a.size() == n && b.size() == n;
+    if (f == memcmpFunction && !full)
+      return false;
+    result = compareBytes(state, a, b, f == strncmpFunction, !full, width);
+  } else if (f == strcmpFunction && arguments.size() == 2) {
+    if (!readBytes(state, arguments[0], n, a) ||
+        !readBytes(state, arguments[1], n, b))
+      return false;
+    result = compareBytes(state, a, b, true, true, width);
+  } else {
+    return false;
+  }
+
+  if (result.isNull())
+    return false;
+  executor.bindLocal(target, state, result);
+  return true;
+}
+
+bool SpecialFunctionHandler::readCount(ExecutionState &state, ref<Expr> size,
+                                       uint64_t &count) {
+  size = executor.toUnique(state, size);
+  ConstantExpr *ce = dyn_cast<ConstantExpr>(size);
+  if (!ce || ce->getWidth() > Expr::Int64)
+    return false;
+  count = ce->getZExtValue();
+  return true;
+}
+
+bool SpecialFunctionHandler::readBytes(ExecutionState &state,
+                                       ref<Expr> address, uint64_t count,
+                                       std::vector<ref<Expr> > &bytes) {
+  ObjectPair op;
+  uint64_t offset;
+  address = executor.toUnique(state, address);
+  if (!resolveRange(state, address, 0, op, offset))
+    return false;
+
+  uint64_t n = std::min(count, op.first->size - offset);
+  if (n > MaxSummaryLength) {
+    // A string may end within the bytes read, a range has to be read in full
+    if (count != ~UINT64_C(0))
+      return false;
+    n = MaxSummaryLength;
+  }
+  for (uint64_t i = 0; i != n; ++i)
+    bytes.push_back(op.second->read8(offset + i));
+  return true;
+}
+
+bool SpecialFunctionHandler::mustHold(ExecutionState &state,
+                                      ref<Expr> condition) {
+  bool res;
+  return executor.solver->mustBeTrue(state, condition, res) && res;
+}
+
+ref<Expr> SpecialFunctionHandler::compareBytes(
+    ExecutionState &state, const std::vector<ref<Expr> > &a,
+    const std::vector<ref<Expr> > &b, bool stopAtNul, bool mustStop,
+    Expr::Width width) {
+  uint64_t n = std::min(a.size(), b.size());
+  ref<Expr> nul = ConstantExpr::create(0, Expr::Int8);
+  ref<Expr> stopped = ConstantExpr::create(0, Expr::Bool);
+  ref<Expr> result = ConstantExpr::create(0, width);
+
+  // The bytes are compared as unsigned chars, the result being the difference
+  // of the first pair that differ, or that end the strings
+  for (uint64_t i = n; i-- > 0;) {
+    ref<Expr> stop = NeExpr::create(a[i], b[i]);
+    if (stopAtNul)
+      stop = OrExpr::create(stop, EqExpr::create(a[i], nul));
+    result = SelectExpr::create(stop,
+                                SubExpr::create(ZExtExpr::create(a[i], width),
+                                                ZExtExpr::create(b[i], width)),
+                                result);
+    stopped = OrExpr::create(stop, stopped);
+  }
+
+  // The comparison has to stop within the bytes read, otherwise the loop of
+  // the body reads beyond them
+  if (mustStop && !mustHold(state, stopped))
+    return ref<Expr>();
+  return result;
 }
 
 bool SpecialFunctionHandler::handle(ExecutionState &state, Function *f,
@@ -652,6 +865,61 @@ void SpecialFunctionHandler::handleCheckMemoryAccess(
   }
 }
 
+bool SpecialFunctionHandler::copyBytes(ExecutionState &state, ref<Expr> dest,
+                                       ref<Expr> src, ref<Expr> size) {
+  dest = executor.toUnique(state, dest);
+  src = executor.toUnique(state, src);
+  size = executor.toUnique(state, size);
+  ConstantExpr *count = dyn_cast<ConstantExpr>(size);
+  ObjectPair destOp, srcOp;
+  uint64_t destOffset, srcOffset;
+
+  if (!count ||
+      !resolveRange(state, dest, count->getZExtValue(), destOp, destOffset) ||
+      !resolveRange(state, src, count->getZExtValue(), srcOp, srcOffset) ||
+      destOp.second->readOnly)
+    return false;
+
+  ObjectState *wos = state.addressSpace.getWriteable(destOp.first,
+                                                     destOp.second);
+  // The source is the writeable copy when both ranges are in the same object
+  const ObjectState *ros = destOp.first == srcOp.first ? wos : srcOp.second;
+  wos->copy(destOffset, ros, srcOffset, count->getZExtValue());
+  return true;
+}
+
+bool SpecialFunctionHandler::setBytes(ExecutionState &state, ref<Expr> dest,
+                                      ref<Expr> value, ref<Expr> size) {
+  dest = executor.toUnique(state, dest);
+  size = executor.toUnique(state, size);
+  ConstantExpr *count = dyn_cast<ConstantExpr>(size);
+  ObjectPair destOp;
+  uint64_t destOffset;
+
+  if (!count ||
+      !resolveRange(state, dest, count->getZExtValue(), destOp, destOffset) ||
+      destOp.second->readOnly)
+    return false;
+
+  ObjectState *wos = state.addressSpace.getWriteable(destOp.first,
+                                                     destOp.second);
+  wos->fill(destOffset, value, count->getZExtValue());
+  return true;
+}
+
+void SpecialFunctionHandler::handleCopyBytes(
+    ExecutionState &state, KInstruction *target,
+    std::vector<ref<Expr> > &arguments) {
+  assert(arguments.size() == 3 &&
+         "invalid number of arguments to klee_copy_bytes");
+
+  // The copy is left to the caller with interpolation, which tracks the
+  // dependencies of the loads and stores of the instructions doing the copy.
+  bool copied = !INTERPOLATION_ENABLED &&
+                copyBytes(state, arguments[0], arguments[1], arguments[2]);
+  executor.bindLocal(target, state, ConstantExpr::create(copied, Expr::Int32));
+}
+
 void SpecialFunctionHandler::handleDebugSubsumption(
     ExecutionState &state, KInstruction *target,
     std::vector<ref<Expr> > &arguments) {
@@ -701,38 +969,182 @@ void SpecialFunctionHandler::handleDebugStateOff(
   state.debugStateOff();
 }
 
+uint64_t SpecialFunctionHandler::MemoTable::hash(const Tuple &tuple) {
+  // 64-bit FNV-1a hash of the words of the tuple
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (Tuple::const_iterator it = tuple.begin(), ie = tuple.end(); it != ie;
+       ++it) {
+    h ^= *it;
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+bool SpecialFunctionHandler::MemoTable::insert(const Tuple &tuple) {
+  std::vector<Tuple> &bucket = buckets[hash(tuple)];
+  if (std::find(bucket.begin(), bucket.end(), tuple) != bucket.end())
+    return false;
+  bucket.push_back(tuple);
+  ++count;
+  return true;
+}
+
+bool SpecialFunctionHandler::MemoTable::contains(const Tuple &tuple) const {
+  std::map<uint64_t, std::vector<Tuple> >::const_iterator it =
+      buckets.find(hash(tuple));
+  return it != buckets.end() &&
+         std::find(it->second.begin(), it->second.end(), tuple) !=
+             it->second.end();
+}
+
+void SpecialFunctionHandler::MemoTable::save(const std::string &fileName,
+                                             uint64_t fingerprint) const {
+  // As the subsumption table file, the table is written into a temporary
+  // file which then replaces the original.
+  std::ostringstream tmpName;
+  tmpName << fileName << ".tmp." << getpid();
+  std::ofstream os(tmpName.str().c_str(), std::ios::out | std::ios::binary);
+  if (!os.good()) {
+    klee_warning("could not open memo table file %s for writing",
+                 tmpName.str().c_str());
+    return;
+  }
+
+  os.write(reinterpret_cast<const char *>(&MemoTableFileMagic),
+           sizeof(MemoTableFileMagic));
+  os.write(reinterpret_cast<const char *>(&MemoTableFileVersion),
+           sizeof(MemoTableFileVersion));
+  os.write(reinterpret_cast<const char *>(&fingerprint), sizeof(fingerprint));
+  os.write(reinterpret_cast<const char *>(&count), sizeof(count));
+  for (std::map<uint64_t, std::vector<Tuple> >::const_iterator
+           it = buckets.begin(),
+           ie = buckets.end();
+       it != ie; ++it) {
+    for (std::vector<Tuple>::const_iterator it1 = it->second.begin(),
+                                            ie1 = it->second.end();
+         it1 != ie1; ++it1) {
+      uint32_t length = it1->size();
+      os.write(reinterpret_cast<const char *>(&length), sizeof(length));
+      if (length)
+        os.write(reinterpret_cast<const char *>(&(*it1)[0]),
+                 length * sizeof(uint64_t));
+    }
+  }
+
+  os.close();
+  if (!os.good()) {
+    klee_warning("error writing memo table file %s", tmpName.str().c_str());
+    ::unlink(tmpName.str().c_str());
+    return;
+  }
+  if (::rename(tmpName.str().c_str(), fileName.c_str()) != 0) {
+    klee_warning("could not replace memo table file %s", fileName.c_str());
+    ::unlink(tmpName.str().c_str());
+  }
+}
+
+void SpecialFunctionHandler::MemoTable::load(const std::string &fileName,
+                                             uint64_t fingerprint) {
+  std::ifstream is(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!is.good())
+    return;
+
+  uint32_t magic, version;
+  uint64_t savedFingerprint, tupleCount;
+  if (!is.read(reinterpret_cast<char *>(&magic), sizeof(magic)) ||
+      magic != MemoTableFileMagic ||
+      !is.read(reinterpret_cast<char *>(&version), sizeof(version)) ||
+      version != MemoTableFileVersion ||
+      !is.read(reinterpret_cast<char *>(&savedFingerprint),
+               sizeof(savedFingerprint)) ||
+      !is.read(reinterpret_cast<char *>(&tupleCount), sizeof(tupleCount))) {
+    klee_warning("ignoring invalid memo table file %s", fileName.c_str());
+    return;
+  }
+
+  if (savedFingerprint != fingerprint) {
+    klee_message("ignoring memo table file %s saved for a different module",
+                 fileName.c_str());
+    return;
+  }
+
+  for (uint64_t i = 0; i < tupleCount; ++i) {
+    uint32_t length;
+    if (!is.read(reinterpret_cast<char *>(&length), sizeof(length))) {
+      klee_warning("truncated memo table file %s", fileName.c_str());
+      return;
+    }
+    Tuple tuple(length);
+    if (length && !is.read(reinterpret_cast<char *>(&tuple[0]),
+                           length * sizeof(uint64_t))) {
+      klee_warning("truncated memo table file %s", fileName.c_str());
+      return;
+    }
+    insert(tuple);
+  }
+}
+
+void SpecialFunctionHandler::loadMemoTable() {
+  if (MemoTableFile.empty())
+    return;
+  memoTable.load(MemoTableFile,
+                 TxSubsumptionTable::getModuleFingerprint(executor.kmodule));
+  if (memoTable.size())
+    klee_message("loaded %lu memoized tuples from %s",
+                 (unsigned long)memoTable.size(), MemoTableFile.c_str());
+}
+
+void SpecialFunctionHandler::saveMemoTable() {
+  if (MemoTableFile.empty())
+    return;
+  memoTable.save(MemoTableFile,
+                 TxSubsumptionTable::getModuleFingerprint(executor.kmodule));
+}
+
+bool SpecialFunctionHandler::readMemoTuple(ExecutionState &state,
+                                           std::vector<ref<Expr> > &arguments,
+                                           const char *name,
+                                           MemoTable::Tuple &tuple) {
+  ConstantExpr *length =
+      arguments.empty() ? 0 : dyn_cast<ConstantExpr>(arguments[0]);
+  if (!length || length->getZExtValue() >= arguments.size()) {
+    executor.terminateStateOnError(
+        state, llvm::Twine(name) + ": invalid number of items", Executor::User);
+    return false;
+  }
+
+  for (unsigned i = 1, n = length->getZExtValue(); i <= n; ++i) {
+    ConstantExpr *item = dyn_cast<ConstantExpr>(arguments[i]);
+    if (!item) {
+      executor.terminateStateOnError(
+          state, llvm::Twine(name) + " requires constant items",
+          Executor::User);
+      return false;
+    }
+    const llvm::APInt &value = item->getAPValue();
+    tuple.push_back(item->getWidth());
+    tuple.insert(tuple.end(), value.getRawData(),
+                 value.getRawData() + value.getNumWords());
+  }
+  return true;
+}
+
 void SpecialFunctionHandler::handleMemoCheck(
     ExecutionState &state, KInstruction *target,
     std::vector<ref<Expr> > &arguments) {
-  assert(arguments[0]->getKind() == 0 &&
-         "invalid length variable, the first argument should be constant");
-  ref<ConstantExpr> length = dyn_cast<ConstantExpr>(arguments[0]);
-  std::vector<int> obj;
-  for (int i = 1; i <= length->getAPValue().getSExtValue(); i++) {
-    assert(arguments[i]->getKind() == 0 &&
-           "invalid item, the items should be constant");
-    ref<ConstantExpr> item = dyn_cast<ConstantExpr>(arguments[i]);
-    obj.push_back(item->getAPValue().getSExtValue());
-  }
-  if (po.contains(obj))
+  MemoTable::Tuple tuple;
+  if (!readMemoTuple(state, arguments, "tracerx_memo_check", tuple))
+    return;
+  if (memoTable.contains(tuple))
     executor.terminateStateOnExit(state);
 }
 
 void SpecialFunctionHandler::handleMemo(ExecutionState &state,
                                         KInstruction *target,
                                         std::vector<ref<Expr> > &arguments) {
-  assert(arguments[0]->getKind() == 0 &&
-         "invalid length variable, the first argument should be constant");
-  ref<ConstantExpr> length = dyn_cast<ConstantExpr>(arguments[0]);
-  std::vector<int> obj;
-  for (int i = 1; i <= length->getAPValue().getSExtValue(); i++) {
-    assert(arguments[i]->getKind() == 0 &&
-           "invalid item, the items should be constant");
-    ref<ConstantExpr> item = dyn_cast<ConstantExpr>(arguments[i]);
-    obj.push_back(item->getAPValue().getSExtValue());
-  }
-
-  po.insert(obj);
+  MemoTable::Tuple tuple;
+  if (readMemoTuple(state, arguments, "tracerx_memo", tuple))
+    memoTable.insert(tuple);
 }
 
 void SpecialFunctionHandler::handleGetValue(
@@ -13,6 +13,7 @@
 #include "TxTree.h"
 #include <iterator>
 #include <map>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -69,22 +70,94 @@ namespace klee {
     static const_iterator end();
     static int size();
 
-    // const_iterator to iterate over stored HandlerInfo
-    // FIXME: Implement >, >=, <=, < operators
-    class persistentObject {
+    /// The tuples memoized by tracerx_memo, and looked up by
+    /// tracerx_memo_check. Each item of a tuple is held as its width followed
+    /// by the 64-bit words of its value, such that the items of a tuple can
+    /// be of any widths. The tuples are kept in buckets by hash.
+    class MemoTable {
+    public:
+      typedef std::vector<uint64_t> Tuple;
+
     private:
-      std::vector<std::vector<int> > objects;
-      int count;
+      std::map<uint64_t, std::vector<Tuple> > buckets;
+      uint64_t count;
+
+      static uint64_t hash(const Tuple &tuple);
 
     public:
-      void insert(std::vector<int> items) { objects.push_back(items); }
-      bool contains(std::vector<int> items) {
-        return std::find(objects.begin(), objects.end(), items) !=
-               objects.end();
-      }
+      MemoTable() : count(0) {}
+
+      /// Insert a tuple, returning false when it was already in the table.
+      bool insert(const Tuple &tuple);
+
+      bool contains(const Tuple &tuple) const;
+
+      uint64_t size() const { return count; }
+
+      /// Save the tuples into a file, for the module of the fingerprint.
+      void save(const std::string &fileName, uint64_t fingerprint) const;
+
+      /// Add the tuples of a file saved for the module of the fingerprint.
+      void load(const std::string &fileName, uint64_t fingerprint);
     };
 
-    persistentObject po;
+    MemoTable memoTable;
+
+    /// Read the tuple of the arguments of tracerx_memo or
+    /// tracerx_memo_check, the number of items followed by the items, and
+    /// terminate the state when they are not all constant.
+    bool readMemoTuple(ExecutionState &state,
+                       std::vector<ref<Expr> > &arguments, const char *name,
+                       MemoTable::Tuple &tuple);
+
+    /// The memcpy, memmove and memset of the module, run by
+    /// handleMemoryFunction
+    const llvm::Function *memcpyFunction;
+    const llvm::Function *memmoveFunction;
+    const llvm::Function *memsetFunction;
+
+    /// The strlen, strcmp, strncmp, memcmp and memchr of the module, run by
+    /// handleStringFunction
+    const llvm::Function *strlenFunction;
+    const llvm::Function *strcmpFunction;
+    const llvm::Function *strncmpFunction;
+    const llvm::Function *memcmpFunction;
+    const llvm::Function *memchrFunction;
+
+    /// Copy or set size bytes at constant addresses within single objects.
+    /// Returns false, doing nothing, when an address or the size is symbolic
+    /// or when a range does not lie within a single writeable object.
+    bool copyBytes(ExecutionState &state, ref<Expr> dest, ref<Expr> src,
+                   ref<Expr> size);
+    bool setBytes(ExecutionState &state, ref<Expr> dest, ref<Expr> value,
+                  ref<Expr> size);
+
+    /// Bind the result of a call to strlen, strcmp, strncmp, memcmp or
+    /// memchr of the module as a single expression over the bytes of its
+    /// ranges, with -string-function-summaries. Returns false, doing nothing,
+    /// when an address or a size is symbolic, when a range does not lie
+    /// within a single object, or when a string may not end within it.
+    bool handleStringFunction(ExecutionState &state, llvm::Function *f,
+                              KInstruction *target,
+                              std::vector<ref<Expr> > &arguments);
+
+    /// Read a constant size into count. Returns false when it is symbolic.
+    bool readCount(ExecutionState &state, ref<Expr> size, uint64_t &count);
+
+    /// Read the bytes at a constant address, up to count bytes, the end of
+    /// its object, or MaxSummaryLength bytes of a string of unknown count.
+    bool readBytes(ExecutionState &state, ref<Expr> address, uint64_t count,
+                   std::vector<ref<Expr> > &bytes);
+
+    /// Whether the condition is proved to hold on the state
+    bool mustHold(ExecutionState &state, ref<Expr> condition);
+
+    /// The result of comparing the bytes of a and b, or null when mustStop
+    /// and the comparison may not stop within the bytes of both.
+    ref<Expr> compareBytes(ExecutionState &state,
+                           const std::vector<ref<Expr> > &a,
+                           const std::vector<ref<Expr> > &b, bool stopAtNul,
+                           bool mustStop, Expr::Width width);
 
   public:
     SpecialFunctionHandler(Executor &_executor);
@@ -99,11 +172,25 @@ namespace klee {
     /// prepared for execution.
     void bind();
 
+    /// Load the memoized tuples of -memo-table-file, once the module has been
+    /// prepared for execution.
+    void loadMemoTable();
+
+    /// Save the memoized tuples into -memo-table-file.
+    void saveMemoTable();
+
     bool handle(ExecutionState &state, 
                 llvm::Function *f,
                 KInstruction *target,
                 std::vector< ref<Expr> > &arguments);
 
+    /// Run a call to memcpy, memmove or memset of the module in the executor,
+    /// instead of its body, with -bulk-memory-functions. Returns false when
+    /// the body is to be run, as for the other functions.
+    bool handleMemoryFunction(ExecutionState &state, llvm::Function *f,
+                              KInstruction *target,
+                              std::vector<ref<Expr> > &arguments);
+
     /* Convenience routines */
 
     std::string readStringAtAddress(ExecutionState &state, ref<Expr> address);
@@ -119,6 +206,7 @@ namespace klee {
     HANDLER(handleAssume);
     HANDLER(handleCalloc);
     HANDLER(handleCheckMemoryAccess);
+    HANDLER(handleCopyBytes);
     HANDLER(handleDebugState);
     HANDLER(handleDebugStateOff);
     HANDLER(handleDebugSubsumption);
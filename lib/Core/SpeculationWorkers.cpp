@@ -0,0 +1,140 @@
+//===-- SpeculationWorkers.cpp --------------------------------------------===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SpeculationWorkers.h"
+
+#include "Executor.h"
+
+#include "klee/CommandLine.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/Affinity.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+static void reap(pid_t pid) {
+  int status;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    ;
+}
+
+SpeculationWorkers::~SpeculationWorkers() {
+  for (std::map<ExecutionState *, Worker>::iterator it = pending.begin(),
+                                                    ie = pending.end();
+       it != ie; ++it) {
+    kill(it->second.pid, SIGKILL);
+    close(it->second.fd);
+    reap(it->second.pid);
+  }
+}
+
+bool SpeculationWorkers::start(ExecutionState &state) {
+  if (isWorker() || pending.size() >= maxWorkers || pending.count(&state))
+    return false;
+
+  int fds[2];
+  if (pipe(fds) < 0) {
+    klee_warning("pipe failed (for the speculation workers)");
+    return false;
+  }
+
+  unsigned cpuIndex = started++;
+  pid_t pid = fork();
+  if (pid < 0) {
+    klee_warning("fork failed (for the speculation workers)");
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    close(fds[0]);
+    // The other workers are children of the executor only
+    for (std::map<ExecutionState *, Worker>::iterator it = pending.begin(),
+                                                      ie = pending.end();
+         it != ie; ++it)
+      close(it->second.fd);
+    pending.clear();
+    outcomeFd = fds[1];
+    // A worker writes no output, not even of a failed pinning
+    if (PinWorkers)
+      util::pinToWorkerCPU(cpuIndex);
+    finish(executor.exploreSpeculation(state, timeout) ? Success : Undecided);
+  }
+
+  close(fds[1]);
+  Worker &worker = pending[&state];
+  worker.pid = pid;
+  worker.fd = fds[0];
+  return true;
+}
+
+void SpeculationWorkers::poll(
+    std::vector<std::pair<ExecutionState *, Outcome> > &outcomes, bool wait) {
+  if (pending.empty())
+    return;
+
+  std::vector<struct pollfd> fds;
+  std::vector<ExecutionState *> states;
+  for (std::map<ExecutionState *, Worker>::iterator it = pending.begin(),
+                                                    ie = pending.end();
+       it != ie; ++it) {
+    struct pollfd fd;
+    fd.fd = it->second.fd;
+    fd.events = POLLIN;
+    fd.revents = 0;
+    fds.push_back(fd);
+    states.push_back(it->first);
+  }
+
+  int ready = ::poll(&fds[0], fds.size(), wait ? -1 : 0);
+  if (ready <= 0)
+    return;
+
+  for (unsigned i = 0; i != fds.size(); ++i) {
+    if (!fds[i].revents)
+      continue;
+
+    std::map<ExecutionState *, Worker>::iterator it = pending.find(states[i]);
+    int code = Undecided;
+    // A child that died without sending an outcome decided nothing
+    if (read(it->second.fd, &code, sizeof(code)) != sizeof(code))
+      code = Undecided;
+    close(it->second.fd);
+    reap(it->second.pid);
+
+    outcomes.push_back(std::make_pair(it->first, Outcome(code)));
+    pending.erase(it);
+  }
+}
+
+void SpeculationWorkers::finish(Outcome outcome) {
+  int code = outcome;
+  ssize_t written = write(outcomeFd, &code, sizeof(code));
+  (void)written;
+  // Leave the buffers and the output files of this process to the executor
+  _exit(0);
+}
+
+bool SpeculationWorkers::cancel(ExecutionState &state) {
+  std::map<ExecutionState *, Worker>::iterator it = pending.find(&state);
+  if (it == pending.end())
+    return false;
+
+  kill(it->second.pid, SIGKILL);
+  close(it->second.fd);
+  reap(it->second.pid);
+  pending.erase(it);
+  return true;
+}
@@ -0,0 +1,97 @@
+//===-- SpeculationWorkers.h ------------------------------------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SPECULATIONWORKERS_H
+#define KLEE_SPECULATIONWORKERS_H
+
+#include <map>
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+
+namespace klee {
+class ExecutionState;
+class Executor;
+
+/// SpeculationWorkers - Explores the subtrees of new speculations in forked
+/// processes, while the executor steps the other states.
+///
+/// The executor parks the state of a speculation opened outside of any
+/// other, and a forked copy of the executor explores its subtree alone until
+/// the speculation fails or succeeds. A failed speculation is rolled back
+/// before the executor explored any of it, which then only marks the
+/// unsatisfiability core of its branch. The state of a successful one, or of
+/// one not decided in time, is resumed and explored as usual, as its subtree
+/// is needed for its interpolants. The forked processes share no memory with
+/// the executor, such that neither the expressions nor the solvers need to be
+/// thread-safe, and they write no output.
+class SpeculationWorkers {
+public:
+  /// The outcomes of the explorations, zero being sent by none
+  enum Outcome { Undecided = 0, Success, Failure };
+
+private:
+  struct Worker {
+    pid_t pid;
+    /// The read end of the pipe through which the child sends the outcome
+    int fd;
+  };
+
+  std::map<ExecutionState *, Worker> pending;
+
+  Executor &executor;
+
+  /// The time limit of the explorations, in seconds
+  double timeout;
+
+  /// The maximal number of subtrees explored at once
+  unsigned maxWorkers;
+
+  /// The write end of the pipe of the outcome, when this process is a
+  /// worker, or -1
+  int outcomeFd;
+
+  /// The number of workers started, numbering the CPUs of -pin-workers
+  unsigned started;
+
+public:
+  SpeculationWorkers(Executor &_executor, double _timeout,
+                     unsigned _maxWorkers)
+      : executor(_executor), timeout(_timeout), maxWorkers(_maxWorkers),
+        outcomeFd(-1), started(0) {}
+
+  /// Kills the processes of the pending explorations.
+  ~SpeculationWorkers();
+
+  unsigned size() const { return pending.size(); }
+
+  bool isPending(ExecutionState &state) const { return pending.count(&state); }
+
+  /// Whether this process is a worker exploring a speculation.
+  bool isWorker() const { return outcomeFd >= 0; }
+
+  /// Start exploring the subtree of the state in a forked process. Returns
+  /// false when too many explorations are pending or the fork fails.
+  bool start(ExecutionState &state);
+
+  /// Collect the outcomes of the explorations that have ended, waiting for
+  /// at least one when wait is set.
+  void poll(std::vector<std::pair<ExecutionState *, Outcome> > &outcomes,
+            bool wait);
+
+  /// Send the outcome of the exploration of this worker, and exit.
+  void finish(Outcome outcome);
+
+  /// Forget the exploration of a state being terminated. Returns true when
+  /// it was pending, that is, when the state was parked.
+  bool cancel(ExecutionState &state);
+};
+}
+
+#endif
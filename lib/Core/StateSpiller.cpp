@@ -0,0 +1,213 @@
+//===-- StateSpiller.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "StateSpiller.h"
+
+#include "Memory.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/util/BitArray.h"
+
+#include "llvm/ADT/StringExtras.h"
+
+#include <fstream>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+/// The flags of the records of the spilled object states
+enum SpillFlags {
+  ReadOnly = 1,
+  ConstantUpdates = 2,
+  HasConcreteMask = 4,
+  HasFlushMask = 8
+};
+
+/// Object states smaller than this are not worth spilling
+const unsigned MinSpilledSize = 64;
+}
+
+static void writeUInt32(std::ofstream &os, uint32_t value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void writeUInt64(std::ofstream &os, uint64_t value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static bool readUInt32(std::ifstream &is, uint32_t &value) {
+  return is.read(reinterpret_cast<char *>(&value), sizeof(value)).good();
+}
+
+static bool readUInt64(std::ifstream &is, uint64_t &value) {
+  return is.read(reinterpret_cast<char *>(&value), sizeof(value)).good();
+}
+
+static void writeBitArray(std::ofstream &os, BitArray *bits, unsigned size) {
+  std::vector<char> packed((size + 7) / 8, 0);
+  for (unsigned i = 0; i < size; ++i)
+    if (bits->get(i))
+      packed[i / 8] |= 1 << (i % 8);
+  os.write(&packed[0], packed.size());
+}
+
+static BitArray *readBitArray(std::ifstream &is, unsigned size) {
+  std::vector<char> packed((size + 7) / 8);
+  if (!is.read(&packed[0], packed.size()).good())
+    return 0;
+  BitArray *bits = new BitArray(size);
+  for (unsigned i = 0; i < size; ++i)
+    if (packed[i / 8] & (1 << (i % 8)))
+      bits->set(i);
+  return bits;
+}
+
+StateSpiller::~StateSpiller() {
+  for (std::map<const ExecutionState *, SpilledState>::iterator
+           it = spilled.begin(),
+           ie = spilled.end();
+       it != ie; ++it) {
+    unlink(it->second.fileName.c_str());
+    for (std::vector<const MemoryObject *>::iterator
+             oi = it->second.objects.begin(),
+             oe = it->second.objects.end();
+         oi != oe; ++oi) {
+      if (--(*oi)->refCount == 0)
+        delete *oi;
+    }
+  }
+}
+
+uint64_t StateSpiller::spill(ExecutionState &state) {
+  assert(!isSpilled(state) && "state already spilled");
+
+  std::vector<ObjectPair> candidates;
+  for (MemoryMap::iterator it = state.addressSpace.objects.begin(),
+                           ie = state.addressSpace.objects.end();
+       it != ie; ++it) {
+    const ObjectState *os = it->second;
+    if (os->refCount != 1 || os->size < MinSpilledSize || os->updates.head ||
+        os->concreteStore.isShared())
+      continue;
+    bool hasSymbolics = false;
+    if (os->knownSymbolics) {
+      for (unsigned i = 0; i < os->size && !hasSymbolics; ++i)
+        hasSymbolics = os->knownSymbolics->get(i).get();
+    }
+    if (!hasSymbolics)
+      candidates.push_back(ObjectPair(it->first, os));
+  }
+  if (candidates.empty())
+    return 0;
+
+  SpilledState &record = spilled[&state];
+  record.fileName = filePrefix + llvm::utostr(nextFileId++) + ".spill";
+  std::ofstream os(record.fileName.c_str(),
+                   std::ios::out | std::ios::binary | std::ios::trunc);
+
+  uint64_t bytes = 0;
+  std::vector<uint8_t> contents;
+  for (std::vector<ObjectPair>::iterator it = candidates.begin(),
+                                         ie = candidates.end();
+       it != ie && os.good(); ++it) {
+    const MemoryObject *mo = it->first;
+    const ObjectState *ostate = it->second;
+    uint32_t flags = (ostate->readOnly ? ReadOnly : 0) |
+                     (ostate->constantUpdates ? ConstantUpdates : 0) |
+                     (ostate->concreteMask ? HasConcreteMask : 0) |
+                     (ostate->flushMask ? HasFlushMask : 0);
+    writeUInt64(os, reinterpret_cast<uintptr_t>(mo));
+    writeUInt64(os, reinterpret_cast<uintptr_t>(ostate->updates.root));
+    writeUInt32(os, ostate->size);
+    writeUInt32(os, flags);
+    writeUInt64(os, ostate->concreteVersion);
+    contents.resize(ostate->size);
+    ostate->concreteStore.copyTo(&contents[0]);
+    os.write(reinterpret_cast<const char *>(&contents[0]), contents.size());
+    if (ostate->concreteMask)
+      writeBitArray(os, ostate->concreteMask, ostate->size);
+    if (ostate->flushMask)
+      writeBitArray(os, ostate->flushMask, ostate->size);
+    bytes += ostate->size;
+  }
+  os.close();
+
+  if (!os.good()) {
+    klee_warning_once(0, "unable to write spill file %s",
+                      record.fileName.c_str());
+    unlink(record.fileName.c_str());
+    spilled.erase(&state);
+    return 0;
+  }
+
+  // The memory objects are kept alive by the record, while the object states
+  // are freed with their last binding.
+  for (std::vector<ObjectPair>::iterator it = candidates.begin(),
+                                         ie = candidates.end();
+       it != ie; ++it) {
+    const MemoryObject *mo = it->first;
+    ++mo->refCount;
+    record.objects.push_back(mo);
+    state.addressSpace.unbindObject(mo);
+  }
+  return bytes;
+}
+
+void StateSpiller::restore(ExecutionState &state) {
+  std::map<const ExecutionState *, SpilledState>::iterator it =
+      spilled.find(&state);
+  if (it == spilled.end())
+    return;
+  SpilledState &record = it->second;
+
+  std::ifstream is(record.fileName.c_str(), std::ios::in | std::ios::binary);
+  for (std::vector<const MemoryObject *>::iterator
+           oi = record.objects.begin(),
+           oe = record.objects.end();
+       oi != oe; ++oi) {
+    const MemoryObject *mo = *oi;
+    uint64_t moAddress, rootAddress, concreteVersion;
+    uint32_t size, flags;
+    if (!readUInt64(is, moAddress) || !readUInt64(is, rootAddress) ||
+        !readUInt32(is, size) || !readUInt32(is, flags) ||
+        !readUInt64(is, concreteVersion) ||
+        moAddress != reinterpret_cast<uintptr_t>(mo) || size != mo->size)
+      klee_error("invalid spill file %s", record.fileName.c_str());
+
+    const Array *root = reinterpret_cast<const Array *>(rootAddress);
+    ObjectState *os = root ? new ObjectState(mo, root) : new ObjectState(mo);
+
+    std::vector<uint8_t> contents(size);
+    if (!is.read(reinterpret_cast<char *>(&contents[0]), size).good())
+      klee_error("invalid spill file %s", record.fileName.c_str());
+    os->concreteStore.copyFrom(&contents[0]);
+
+    delete os->concreteMask;
+    os->concreteMask = 0;
+    delete os->flushMask;
+    os->flushMask = 0;
+    if ((flags & HasConcreteMask) &&
+        !(os->concreteMask = readBitArray(is, size)))
+      klee_error("invalid spill file %s", record.fileName.c_str());
+    if ((flags & HasFlushMask) && !(os->flushMask = readBitArray(is, size)))
+      klee_error("invalid spill file %s", record.fileName.c_str());
+
+    os->readOnly = flags & ReadOnly;
+    os->constantUpdates = flags & ConstantUpdates;
+    os->concreteVersion = concreteVersion;
+
+    state.addressSpace.bindObject(mo, os);
+    --mo->refCount;
+  }
+
+  unlink(record.fileName.c_str());
+  spilled.erase(it);
+}
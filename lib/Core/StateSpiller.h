@@ -0,0 +1,64 @@
+//===-- StateSpiller.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATESPILLER_H
+#define KLEE_STATESPILLER_H
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace klee {
+class ExecutionState;
+class MemoryObject;
+
+/// StateSpiller - Moves the memory of suspended states to disk, and back when
+/// they are selected again.
+///
+/// Only the object states that are owned by the state alone, and are free of
+/// symbolic expressions, are spilled: the others are shared with other states
+/// or hold expressions, and would not be freed or would have to be rebuilt.
+/// The execution state itself, including its stack, constraints and its node
+/// in the process and Tracer-X trees, stays in memory, so that spilling is
+/// transparent to the searchers and to interpolation.
+class StateSpiller {
+  struct SpilledState {
+    std::string fileName;
+    /// The memory objects of the spilled object states, kept alive until
+    /// they are restored
+    std::vector<const MemoryObject *> objects;
+  };
+
+  std::map<const ExecutionState *, SpilledState> spilled;
+
+  /// The prefix of the names of the spill files
+  std::string filePrefix;
+
+  unsigned nextFileId;
+
+public:
+  explicit StateSpiller(const std::string &_filePrefix)
+      : filePrefix(_filePrefix), nextFileId(0) {}
+  ~StateSpiller();
+
+  bool isSpilled(const ExecutionState &state) const {
+    return spilled.count(&state);
+  }
+
+  /// Spill the object states of a state that are owned by it alone. Returns
+  /// the number of bytes spilled.
+  uint64_t spill(ExecutionState &state);
+
+  /// Bring back the spilled object states of the state, if any.
+  void restore(ExecutionState &state);
+};
+}
+
+#endif
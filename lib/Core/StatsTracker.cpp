@@ -10,6 +10,7 @@
 #include "StatsTracker.h"
 
 #include "klee/ExecutionState.h"
+#include "klee/LiveStats.h"
 #include "klee/Statistics.h"
 #include "klee/Config/Version.h"
 #include "klee/Internal/Module/InstructionInfoTable.h"
@@ -24,7 +25,10 @@
 #include "CallPathManager.h"
 #include "CoreStats.h"
 #include "Executor.h"
+#include "HardwareCounters.h"
 #include "MemoryManager.h"
+#include "SamplingProfiler.h"
+#include "TxMemoryCensus.h"
 #include "UserSearcher.h"
 
 #if LLVM_VERSION_CODE > LLVM_VERSION(3, 2)
@@ -57,7 +61,12 @@
 #include "llvm/IR/CFG.h"
 #endif
 
+#include <algorithm>
 #include <fstream>
+#include <functional>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 using namespace klee;
@@ -71,10 +80,25 @@ cl::opt<bool> TrackInstructionTime(
     cl::desc(
         "Enable tracking of time for individual instructions (default=off)"));
 
+cl::opt<unsigned> InstructionTimeSampleInterval(
+    "instruction-time-sample-interval", cl::init(1),
+    cl::desc("With -track-instruction-time, time one instruction of about "
+             "every n instructions, at random, and count its time n times, "
+             "instead of timing all the instructions (default=1)"));
+
 cl::opt<bool>
 OutputStats("output-stats", cl::init(true),
             cl::desc("Write running stats trace file (default=on)"));
 
+cl::opt<bool> StatsBinary(
+    "stats-binary", cl::init(false),
+    cl::desc("Write the running stats into run.stats.bin instead of "
+             "run.stats: a header with the magic number \"KRST\", the "
+             "format version and the number of columns (32 bits each) and "
+             "the column names, preceded by their length (32 bits), then "
+             "one record of a double per column for each write, all "
+             "little-endian. klee-stats reads either file (default=off)"));
+
 cl::opt<bool> OutputIStats(
     "output-istats", cl::init(true),
     cl::desc(
@@ -90,6 +114,13 @@ cl::opt<unsigned> StatsWriteAfterInstructions(
     cl::desc("Write statistics after each n instructions, 0 to disable "
              "(default=0)"));
 
+cl::opt<bool> IStatsDelta(
+    "istats-delta", cl::init(false),
+    cl::desc("Instead of rewriting run.istats, append the changes of the "
+             "instruction level statistics since the last write into "
+             "run.istats.bin, which klee-istats-convert converts into the "
+             "callgrind format (default=off)"));
+
 cl::opt<double>
 IStatsWriteInterval("istats-write-interval", cl::init(10.),
                     cl::desc("Approximate number of seconds between istats "
@@ -105,9 +136,65 @@ cl::opt<double> UncoveredUpdateInterval("uncovered-update-interval",
                                         cl::init(30.),
                                         cl::desc("(default=30.0s)"));
 
+cl::opt<std::string> ResumeCoverage(
+    "resume-coverage",
+    cl::desc("Treat the instructions covered in the given run.istats of a "
+             "previous run as covered, such that the searchers guided by "
+             "coverage first steer towards the instructions it did not cover, "
+             "and only the states covering other instructions cover new "
+             "code. The functions whose instructions or source lines changed "
+             "since are explored anew. Combine with -subsumption-table-file "
+             "to also reuse the subsumption table of the previous run."),
+    cl::init(""));
+
+cl::opt<std::string> LiveStatsFile(
+    "live-stats-file",
+    cl::desc("Keep the current statistics of the run in the given file, "
+             "mapped in memory, for monitors to read them while the run goes "
+             "on. See include/klee/LiveStats.h for its layout. Best put on a "
+             "memory file system, as /dev/shm (default=off)"),
+    cl::init(""));
+
+cl::opt<double> LiveStatsInterval(
+    "live-stats-interval", cl::init(1.),
+    cl::desc("Approximate number of seconds between the updates of "
+             "-live-stats-file (default=1.0s)"));
+
 cl::opt<bool> UseCallPaths("use-call-paths", cl::init(true),
                            cl::desc("Enable calltree tracking for instruction "
                                     "level statistics (default=on)"));
+
+cl::opt<bool> CompactCallPaths(
+    "compact-call-paths", cl::init(false),
+    cl::desc("Count on the call paths only the statistics of run.istats and "
+             "those of -max-static-cpfork-pct and -max-static-cpsolve-pct, "
+             "instead of all statistics (default=off)"));
+
+cl::opt<unsigned> MaxCallPathDepth(
+    "max-call-path-depth", cl::init(0),
+    cl::desc("Record the calls deeper than the given depth as calls from the "
+             "call path at the depth below it, which bounds the call paths "
+             "of deep recursions (default=0 (unbounded))"));
+
+cl::opt<bool> HardwareCounterStats(
+    "hw-counters", cl::init(false),
+    cl::desc("Count the cycles, instructions retired, last level cache "
+             "misses and branch misses of the phases of the executor with the "
+             "hardware counters of the system, and write their totals into "
+             "run.stats (default=off)"));
+
+cl::opt<unsigned> HardwareCounterSampleInterval(
+    "hw-counters-sample-interval", cl::init(0),
+    cl::desc("With -hw-counters, count the hardware counters of every n-th "
+             "instruction into run.istats, 0 to disable (default=0)"));
+
+const uint32_t IStatsDeltaMagic = 0x5453494b; // "KIST"
+
+const uint32_t IStatsDeltaVersion = 1;
+
+const uint32_t StatsBinaryMagic = 0x5453524b; // "KRST"
+
+const uint32_t StatsBinaryVersion = 1;
 }
 
 ///
@@ -137,6 +224,17 @@ namespace klee {
     void run() { statsTracker->writeStatsLine(); }
   };
 
+  class WriteLiveStatsTimer : public Executor::Timer {
+    StatsTracker *statsTracker;
+
+  public:
+    WriteLiveStatsTimer(StatsTracker *_statsTracker)
+        : statsTracker(_statsTracker) {}
+    ~WriteLiveStatsTimer() {}
+
+    void run() { statsTracker->writeLiveStats(false); }
+  };
+
   class UpdateReachableTimer : public Executor::Timer {
     StatsTracker *statsTracker;
     
@@ -173,6 +271,8 @@ static bool instructionIsCoverable(Instruction *i) {
   return true;
 }
 
+static void getIStatsStatistics(std::vector<Statistic *> &result);
+
 StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
                            bool _updateMinDistToUncovered)
   : executor(_executor),
@@ -183,7 +283,13 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     numBranches(0),
     fullBranches(0),
     partialBranches(0),
-    updateMinDistToUncovered(_updateMinDistToUncovered) {
+    callPathManager(MaxCallPathDepth),
+    updateMinDistToUncovered(_updateMinDistToUncovered),
+    liveStats(0),
+    liveLastTime(startWallTime),
+    liveLastInstructions(0),
+    liveLastQueries(0),
+    liveLastSolverTime(0) {
 
   if (StatsWriteAfterInstructions > 0 && StatsWriteInterval > 0)
     klee_error("Both options --stats-write-interval and "
@@ -214,9 +320,23 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     }
   }
 
+  // The counters are opened first, for the statistics to include them
+  if (HardwareCounterStats)
+    HardwareCounters::open();
+
   if (OutputIStats)
     theStatisticManager->useIndexedStats(km->infos->getMaxID());
 
+  // The call paths are created with the first frame, after the statistics
+  // they count are set
+  if (OutputIStats && UseCallPaths && CompactCallPaths) {
+    std::vector<Statistic *> callPathStats;
+    getIStatsStatistics(callPathStats);
+    callPathStats.push_back(&stats::forks);
+    callPathStats.push_back(&stats::solverTime);
+    theStatisticManager->setContextStatistics(callPathStats);
+  }
+
   for (std::vector<KFunction*>::iterator it = km->functions.begin(), 
          ie = km->functions.end(); it != ie; ++it) {
     KFunction *kf = *it;
@@ -240,8 +360,16 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     }
   }
 
+  if (!ResumeCoverage.empty()) {
+    if (OutputIStats)
+      readPreviousCoverage(ResumeCoverage);
+    else
+      klee_warning("-resume-coverage requires -output-istats, ignoring it");
+  }
+
   if (OutputStats) {
-    statsFile = executor.interpreterHandler->openOutputFile("run.stats");
+    statsFile = executor.interpreterHandler->openOutputFile(
+        StatsBinary ? "run.stats.bin" : "run.stats");
     assert(statsFile && "unable to open statistics trace file");
     writeStatsHeader();
     writeStatsLine();
@@ -257,12 +385,21 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
   }
 
   if (OutputIStats) {
-    istatsFile = executor.interpreterHandler->openOutputFile("run.istats");
+    istatsFile = executor.interpreterHandler->openOutputFile(
+        IStatsDelta ? "run.istats.bin" : "run.istats");
     assert(istatsFile && "unable to open istats file");
+    if (IStatsDelta)
+      writeIStatsDeltaHeader();
 
     if (IStatsWriteInterval > 0)
       executor.addTimer(new WriteIStatsTimer(this), IStatsWriteInterval);
   }
+
+  if (!LiveStatsFile.empty()) {
+    openLiveStats(LiveStatsFile);
+    if (liveStats && LiveStatsInterval > 0)
+      executor.addTimer(new WriteLiveStatsTimer(this), LiveStatsInterval);
+  }
 }
 
 StatsTracker::~StatsTracker() {  
@@ -270,11 +407,19 @@ StatsTracker::~StatsTracker() {
     delete statsFile;
   if (istatsFile)
     delete istatsFile;
+  if (liveStats)
+    munmap(liveStats, sizeof(LiveStats));
 }
 
 void StatsTracker::done() {
   if (statsFile)
     writeStatsLine();
+  if (HardwareCounters::enabled) {
+    HardwareCounters::update(SamplingProfiler::phases);
+    HardwareCounters::print();
+  }
+  if (liveStats)
+    writeLiveStats(true);
 
   if (OutputIStats) {
     if (updateMinDistToUncovered)
@@ -283,24 +428,58 @@ void StatsTracker::done() {
   }
 }
 
+/// The xorshift generator of the samples of -instruction-time-sample-interval
+static uint64_t nextRandom() {
+  static uint64_t state = 88172645463325252ULL;
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
 void StatsTracker::stepInstruction(ExecutionState &es) {
   if (OutputIStats) {
+    if (HardwareCounters::enabled && HardwareCounterSampleInterval) {
+      // The counts since the last read are those of the instruction sampled
+      // last, whose index is still the current one, or those of the
+      // instructions since, which are not attributed
+      bool sample =
+          stats::instructions % HardwareCounterSampleInterval.getValue() == 0;
+      if (sample || HardwareCounters::attributing)
+        HardwareCounters::update(SamplingProfiler::phases);
+      HardwareCounters::attributing = sample;
+    }
+
     if (TrackInstructionTime) {
       static sys::TimeValue lastNowTime(0,0),lastUserTime(0,0);
-    
-      if (lastUserTime.seconds()==0 && lastUserTime.nanoseconds()==0) {
-        sys::TimeValue sys(0,0);
-        sys::Process::GetTimeUsage(lastNowTime,lastUserTime,sys);
-      } else {
+      // Whether the last instruction is timed, its index being still the
+      // current one
+      static bool timing = false;
+      static uint64_t nextSample = 0;
+
+      uint64_t interval =
+          std::max(1U, InstructionTimeSampleInterval.getValue());
+      bool sample = stats::instructions >= nextSample;
+      if (timing || sample) {
         sys::TimeValue now(0,0),user(0,0),sys(0,0);
         sys::Process::GetTimeUsage(now,user,sys);
-        sys::TimeValue delta = user - lastUserTime;
-        sys::TimeValue deltaNow = now - lastNowTime;
-        stats::instructionTime += delta.usec();
-        stats::instructionRealTime += deltaNow.usec();
+        if (timing) {
+          // A timed instruction stands for the interval of its sample
+          sys::TimeValue delta = user - lastUserTime;
+          sys::TimeValue deltaNow = now - lastNowTime;
+          stats::instructionTime += delta.usec() * interval;
+          stats::instructionRealTime += deltaNow.usec() * interval;
+        }
         lastUserTime = user;
         lastNowTime = now;
       }
+      // The gaps between the samples are drawn from 1 to 2 * interval - 1,
+      // such that the samples do not follow the period of a loop
+      if (sample)
+        nextSample = stats::instructions +
+                     (interval == 1 ? 1
+                                    : 1 + nextRandom() % (2 * interval - 1));
+      timing = sample;
     }
 
     Instruction *inst = es.pc->inst;
@@ -325,6 +504,8 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
         es.instsSinceCovNew = 1;
 	++stats::coveredInstructions;
 	stats::uncoveredInstructions += (uint64_t)-1;
+        if (updateMinDistToUncovered)
+          newlyCovered.push_back(ii.id);
       }
     }
   }
@@ -397,7 +578,71 @@ void StatsTracker::markBranchVisited(ExecutionState *visitedTrue,
   }
 }
 
+static void writeUInt32(llvm::raw_ostream &os, uint32_t value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void writeUInt64(llvm::raw_ostream &os, uint64_t value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void writeString(llvm::raw_ostream &os, const std::string &s) {
+  writeUInt32(os, s.size());
+  os.write(s.data(), s.size());
+}
+
+static void writeDouble(llvm::raw_ostream &os, double value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+/// The columns of run.stats, in the order of the fields of writeStatsLine
+static const char *const StatsColumns[] = {
+    "Instructions", "FullBranches", "PartialBranches", "NumBranches",
+    "UserTime", "NumStates", "MallocUsage", "NumQueries",
+    "NumQueryConstructs", "NumObjects", "WallTime", "CoveredInstructions",
+    "UncoveredInstructions", "QueryTime", "SolverTime", "CexCacheTime",
+    "ForkTime", "ResolveTime",
+#ifdef DEBUG
+    "ArrayHashTime",
+#endif
+};
+
+static const unsigned NumStatsColumns =
+    sizeof(StatsColumns) / sizeof(StatsColumns[0]);
+
+/// The columns of the hardware counters, which follow those of StatsColumns
+/// with -hw-counters
+static unsigned getHardwareCounterColumns() {
+  return HardwareCounters::enabled ? HardwareCounters::CounterCount : 0;
+}
+
+/// The columns of the peaks of the interpolation memory census, which follow
+/// those of the hardware counters with -tx-memory-census-interval
+static const char *const TxMemoryColumns[TxMemoryCensus::ComponentCount] = {
+    "TxPeakValues", "TxPeakStore", "TxPeakPathCondition", "TxPeakWP",
+    "TxPeakPhi",    "TxPeakTable"};
+
+static unsigned getTxMemoryColumns() {
+  return TxMemoryCensus::getInterval() > 0 ? TxMemoryCensus::ComponentCount
+                                           : 0;
+}
+
 void StatsTracker::writeStatsHeader() {
+  if (StatsBinary) {
+    writeUInt32(*statsFile, StatsBinaryMagic);
+    writeUInt32(*statsFile, StatsBinaryVersion);
+    writeUInt32(*statsFile, NumStatsColumns + getHardwareCounterColumns() +
+                                getTxMemoryColumns());
+    for (unsigned i = 0; i < NumStatsColumns; ++i)
+      writeString(*statsFile, StatsColumns[i]);
+    for (unsigned i = 0; i < getHardwareCounterColumns(); ++i)
+      writeString(*statsFile, HardwareCounters::names[i]);
+    for (unsigned i = 0; i < getTxMemoryColumns(); ++i)
+      writeString(*statsFile, TxMemoryColumns[i]);
+    statsFile->flush();
+    return;
+  }
+
   *statsFile << "('Instructions',"
              << "'FullBranches',"
              << "'PartialBranches',"
@@ -419,7 +664,12 @@ void StatsTracker::writeStatsHeader() {
 #ifdef DEBUG
 	     << "'ArrayHashTime',"
 #endif
-             << ")\n";
+      ;
+  for (unsigned i = 0; i < getHardwareCounterColumns(); ++i)
+    *statsFile << "'" << HardwareCounters::names[i] << "',";
+  for (unsigned i = 0; i < getTxMemoryColumns(); ++i)
+    *statsFile << "'" << TxMemoryColumns[i] << "',";
+  *statsFile << ")\n";
   statsFile->flush();
 }
 
@@ -428,6 +678,38 @@ double StatsTracker::elapsed() {
 }
 
 void StatsTracker::writeStatsLine() {
+  if (HardwareCounters::enabled)
+    HardwareCounters::update(SamplingProfiler::phases);
+
+  if (StatsBinary) {
+    double values[] = {
+        (double)stats::instructions, (double)fullBranches,
+        (double)partialBranches, (double)numBranches, util::getUserTime(),
+        (double)executor.states.size(),
+        (double)(util::GetTotalMallocUsage() +
+                 executor.memory->getUsedDeterministicSize()),
+        (double)stats::queries, (double)stats::queryConstructs, 0., elapsed(),
+        (double)stats::coveredInstructions,
+        (double)stats::uncoveredInstructions, stats::queryTime / 1000000.,
+        stats::solverTime / 1000000., stats::cexCacheTime / 1000000.,
+        stats::forkTime / 1000000., stats::resolveTime / 1000000.,
+#ifdef DEBUG
+        stats::arrayHashTime / 1000000.,
+#endif
+    };
+    assert(sizeof(values) / sizeof(values[0]) == NumStatsColumns &&
+           "the records do not match the columns");
+    for (unsigned i = 0; i < NumStatsColumns; ++i)
+      writeDouble(*statsFile, values[i]);
+    for (unsigned i = 0; i < getHardwareCounterColumns(); ++i)
+      writeDouble(*statsFile, (double)HardwareCounters::total(
+                                  (HardwareCounters::Counter)i));
+    for (unsigned i = 0; i < getTxMemoryColumns(); ++i)
+      writeDouble(*statsFile, (double)TxMemoryCensus::peak[i]);
+    statsFile->flush();
+    return;
+  }
+
   *statsFile << "(" << stats::instructions << "," << fullBranches << ","
              << partialBranches << "," << numBranches << ","
              << util::getUserTime() << "," << executor.states.size() << ","
@@ -445,10 +727,79 @@ void StatsTracker::writeStatsLine() {
 #ifdef DEBUG
              << "," << stats::arrayHashTime / 1000000.
 #endif
-             << ")\n";
+      ;
+  for (unsigned i = 0; i < getHardwareCounterColumns(); ++i)
+    *statsFile << ","
+               << HardwareCounters::total((HardwareCounters::Counter)i);
+  for (unsigned i = 0; i < getTxMemoryColumns(); ++i)
+    *statsFile << "," << TxMemoryCensus::peak[i];
+  *statsFile << ")\n";
   statsFile->flush();
 }
 
+void StatsTracker::openLiveStats(const std::string &fileName) {
+  int fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, sizeof(LiveStats)) < 0) {
+    klee_warning("could not create live statistics file %s", fileName.c_str());
+    if (fd >= 0)
+      close(fd);
+    return;
+  }
+  void *map = mmap(0, sizeof(LiveStats), PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    klee_warning("could not map live statistics file %s", fileName.c_str());
+    return;
+  }
+
+  liveStats = static_cast<LiveStats *>(map);
+  liveStats->magic = LiveStats::Magic;
+  liveStats->version = LiveStats::Version;
+  liveStats->pid = getpid();
+  writeLiveStats(false);
+}
+
+void StatsTracker::writeLiveStats(bool finished) {
+  double now = util::getWallTime();
+  double interval = now - liveLastTime;
+  uint64_t instructions = stats::instructions;
+  uint64_t queries = stats::queries;
+  uint64_t solverTime = stats::solverTime;
+
+  // Readers retry while the sequence is odd or changed under them
+  ++liveStats->sequence;
+  __sync_synchronize();
+
+  liveStats->finished = finished;
+  liveStats->updateTime = now;
+  liveStats->elapsed = now - startWallTime;
+  liveStats->instructions = instructions;
+  liveStats->states = executor.states.size();
+  liveStats->queries = queries;
+  liveStats->forks = stats::forks;
+  if (interval > 0) {
+    liveStats->instructionsPerSecond =
+        (instructions - liveLastInstructions) / interval;
+    liveStats->queriesPerSecond = (queries - liveLastQueries) / interval;
+    liveStats->solverTimeShare =
+        (solverTime - liveLastSolverTime) / 1000000. / interval;
+  }
+  liveStats->subsumptionChecks = stats::subsumptionChecks;
+  liveStats->subsumptionHits = stats::subsumptionHits;
+  liveStats->heapMemory = util::GetTotalMallocUsage();
+  liveStats->objectMemory = executor.memory->getUsedDeterministicSize();
+  liveStats->expressions = Expr::count;
+
+  __sync_synchronize();
+  ++liveStats->sequence;
+
+  liveLastTime = now;
+  liveLastInstructions = instructions;
+  liveLastQueries = queries;
+  liveLastSolverTime = solverTime;
+}
+
 void StatsTracker::updateStateStatistics(uint64_t addend) {
   for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
          ie = executor.states.end(); it != ie; ++it) {
@@ -460,9 +811,224 @@ void StatsTracker::updateStateStatistics(uint64_t addend) {
   }
 }
 
+namespace {
+struct StatisticIdLess {
+  bool operator()(Statistic *a, Statistic *b) const {
+    return a->getID() < b->getID();
+  }
+};
+}
+
+/// Get the statistics written into run.istats, in the order of their ids.
+static void getIStatsStatistics(std::vector<Statistic *> &result) {
+  static const char *names[] = { "Queries",
+                                 "QueriesValid",
+                                 "QueriesInvalid",
+                                 "QueryTime",
+                                 "ResolveTime",
+                                 "Instructions",
+                                 "InstructionTimes",
+                                 "InstructionRealTimes",
+                                 "Forks",
+                                 "CoveredInstructions",
+                                 "UncoveredInstructions",
+                                 "States",
+                                 "MinDistToUncovered" };
+
+  for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+    if (Statistic *s = theStatisticManager->getStatisticByName(names[i]))
+      result.push_back(s);
+  if (HardwareCounters::enabled && HardwareCounterSampleInterval)
+    for (unsigned i = 0; i < HardwareCounters::CounterCount; ++i)
+      if (Statistic *s = theStatisticManager->getStatisticByName(
+              HardwareCounters::names[i]))
+        result.push_back(s);
+  std::sort(result.begin(), result.end(), StatisticIdLess());
+}
+
+void StatsTracker::writeIStatsDeltaHeader() {
+  llvm::raw_fd_ostream &of = *istatsFile;
+  StatisticManager &sm = *theStatisticManager;
+  KModule *km = executor.kmodule;
+
+  writeUInt32(of, IStatsDeltaMagic);
+  writeUInt32(of, IStatsDeltaVersion);
+  writeString(of, objectFilename);
+  writeString(of, km->module->getModuleIdentifier());
+
+  writeUInt32(of, sm.getNumStatistics());
+  for (unsigned i = 0; i < sm.getNumStatistics(); ++i) {
+    writeString(of, sm.getStatistic(i).getName());
+    writeString(of, sm.getStatistic(i).getShortName());
+  }
+
+  std::vector<Statistic *> istats;
+  getIStatsStatistics(istats);
+  writeUInt32(of, istats.size());
+  for (std::vector<Statistic *>::iterator it = istats.begin(),
+                                          ie = istats.end();
+       it != ie; ++it)
+    writeUInt32(of, (*it)->getID());
+
+  // The instructions in the order of the module, as run.istats lists them
+  unsigned count = 0;
+  for (std::vector<KFunction *>::iterator it = km->functions.begin(),
+                                          ie = km->functions.end();
+       it != ie; ++it)
+    count += (*it)->numInstructions;
+  writeUInt32(of, count);
+  for (std::vector<KFunction *>::iterator it = km->functions.begin(),
+                                          ie = km->functions.end();
+       it != ie; ++it) {
+    KFunction *kf = *it;
+    std::string name = kf->function->getName().str();
+    const std::string &functionFile =
+        km->infos->getFunctionInfo(kf->function).file;
+    for (unsigned i = 0; i < kf->numInstructions; ++i) {
+      const InstructionInfo &ii = *kf->instructions[i]->info;
+      writeUInt32(of, ii.id);
+      writeUInt32(of, ii.assemblyLine);
+      writeUInt32(of, ii.line);
+      writeString(of, name);
+      writeString(of, functionFile);
+      writeString(of, ii.file);
+    }
+  }
+
+  istatsLastValues.assign(km->infos->getMaxID() * sm.getNumStatistics(), 0);
+  of.flush();
+}
+
+void StatsTracker::writeIStatsDelta() {
+  llvm::raw_fd_ostream &of = *istatsFile;
+  StatisticManager &sm = *theStatisticManager;
+  unsigned nStats = sm.getNumStatistics();
+  unsigned nIndices = istatsLastValues.size() / nStats;
+
+  // The state counts are only set for the scan, as in writeIStats
+  updateStateStatistics(1);
+
+  std::vector<uint64_t> record;
+  for (unsigned index = 0; index < nIndices; ++index) {
+    uint64_t *last = &istatsLastValues[index * nStats];
+    for (unsigned i = 0; i < nStats; ++i) {
+      uint64_t value = sm.getIndexedValue(sm.getStatistic(i), index);
+      if (value == last[i])
+        continue;
+      record.push_back(((uint64_t)index << 32) | i);
+      // The differences are modulo 2^64, as the state counts may decrease
+      record.push_back(value - last[i]);
+      last[i] = value;
+    }
+  }
+
+  updateStateStatistics((uint64_t)-1);
+
+  double time = elapsed();
+  of.write(reinterpret_cast<const char *>(&time), sizeof(time));
+  writeUInt32(of, record.size() / 2);
+  for (unsigned i = 0; i < record.size(); i += 2) {
+    writeUInt32(of, record[i] >> 32);
+    writeUInt32(of, record[i] & 0xffffffff);
+    writeUInt64(of, record[i + 1]);
+  }
+  of.flush();
+}
+
+void StatsTracker::readPreviousCoverage(const std::string &fileName) {
+  std::ifstream in(fileName.c_str());
+  if (!in) {
+    klee_warning("unable to open the previous coverage %s", fileName.c_str());
+    return;
+  }
+
+  // The source line and whether it was covered of each instruction of each
+  // function, in the order of the module
+  std::map<std::string, std::vector<std::pair<unsigned, bool> > > previous;
+  std::vector<std::pair<unsigned, bool> > *instructions = 0;
+  int icovIndex = -1;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 7, "events:") == 0) {
+      std::istringstream events(line.substr(7));
+      std::string name;
+      for (int i = 0; events >> name; ++i)
+        if (name == stats::coveredInstructions.getShortName())
+          icovIndex = i;
+    } else if (line.compare(0, 3, "fn=") == 0) {
+      instructions = &previous[line.substr(3)];
+    } else if (line.compare(0, 6, "calls=") == 0) {
+      // The line of the costs of the call, inclusive of the callee
+      std::getline(in, line);
+    } else if (instructions && !line.empty() && isdigit((unsigned char)line[0])) {
+      std::istringstream fields(line);
+      unsigned assemblyLine, sourceLine;
+      uint64_t value = 0;
+      fields >> assemblyLine >> sourceLine;
+      for (int i = 0; i <= icovIndex; ++i)
+        fields >> value;
+      instructions->push_back(std::make_pair(sourceLine, fields && value));
+    }
+  }
+  if (icovIndex < 0) {
+    klee_warning("no covered instructions in %s, ignoring it",
+                 fileName.c_str());
+    return;
+  }
+
+  KModule *km = executor.kmodule;
+  unsigned covered = 0, changed = 0;
+  for (std::vector<KFunction*>::iterator it = km->functions.begin(),
+         ie = km->functions.end(); it != ie; ++it) {
+    Function *f = (*it)->function;
+    std::map<std::string, std::vector<std::pair<unsigned, bool> > >::iterator
+        pit = previous.find(f->getName().str());
+    if (pit == previous.end())
+      continue;
+
+    // The instructions are matched by their position in the function, as
+    // long as the function has the same number of instructions, on the same
+    // source lines
+    std::vector<std::pair<unsigned, bool> > &prev = pit->second;
+    std::vector<Instruction *> insts;
+    for (Function::iterator bbIt = f->begin(), bb_ie = f->end();
+         bbIt != bb_ie; ++bbIt)
+      for (BasicBlock::iterator iit = bbIt->begin(), iie = bbIt->end();
+           iit != iie; ++iit)
+        insts.push_back(&*iit);
+    bool same = insts.size() == prev.size();
+    for (unsigned i = 0; same && i != insts.size(); ++i)
+      same = km->infos->getInfo(insts[i]).line == prev[i].first;
+    if (!same) {
+      ++changed;
+      continue;
+    }
+
+    for (unsigned i = 0; i != insts.size(); ++i) {
+      unsigned id = km->infos->getInfo(insts[i]).id;
+      if (!prev[i].second || !instructionIsCoverable(insts[i]) ||
+          theStatisticManager->getIndexedValue(stats::coveredInstructions, id))
+        continue;
+      theStatisticManager->setIndex(id);
+      ++stats::coveredInstructions;
+      stats::uncoveredInstructions += (uint64_t)-1;
+      executor.visitedBlocks.insert(insts[i]->getParent());
+      ++covered;
+    }
+  }
+
+  klee_message("resuming the coverage of %u instructions from %s, %u "
+               "functions changed",
+               covered, fileName.c_str(), changed);
+}
+
 void StatsTracker::writeIStats() {
+  if (IStatsDelta) {
+    writeIStatsDelta();
+    return;
+  }
+
   Module *m = executor.kmodule->module;
-  uint64_t istatsMask = 0;
   llvm::raw_fd_ostream &of = *istatsFile;
   
   // We assume that we didn't move the file pointer
@@ -476,44 +1042,29 @@ void StatsTracker::writeIStats() {
   of << "cmd: " << m->getModuleIdentifier() << "\n\n";
   of << "\n";
   
-  StatisticManager &sm = *theStatisticManager;
-  unsigned nStats = sm.getNumStatistics();
-
-  // Max is 13, sadly
-  istatsMask |= 1<<sm.getStatisticID("Queries");
-  istatsMask |= 1<<sm.getStatisticID("QueriesValid");
-  istatsMask |= 1<<sm.getStatisticID("QueriesInvalid");
-  istatsMask |= 1<<sm.getStatisticID("QueryTime");
-  istatsMask |= 1<<sm.getStatisticID("ResolveTime");
-  istatsMask |= 1<<sm.getStatisticID("Instructions");
-  istatsMask |= 1<<sm.getStatisticID("InstructionTimes");
-  istatsMask |= 1<<sm.getStatisticID("InstructionRealTimes");
-  istatsMask |= 1<<sm.getStatisticID("Forks");
-  istatsMask |= 1<<sm.getStatisticID("CoveredInstructions");
-  istatsMask |= 1<<sm.getStatisticID("UncoveredInstructions");
-  istatsMask |= 1<<sm.getStatisticID("States");
-  istatsMask |= 1<<sm.getStatisticID("MinDistToUncovered");
+  std::vector<Statistic *> istats;
+  getIStatsStatistics(istats);
 
   of << "positions: instr line\n";
 
-  for (unsigned i=0; i<nStats; i++) {
-    if (istatsMask & (1<<i)) {
-      Statistic &s = sm.getStatistic(i);
-      of << "event: " << s.getShortName() << " : " 
-         << s.getName() << "\n";
-    }
-  }
+  for (std::vector<Statistic *>::iterator it = istats.begin(),
+                                          ie = istats.end();
+       it != ie; ++it)
+    of << "event: " << (*it)->getShortName() << " : " << (*it)->getName()
+       << "\n";
 
   of << "events: ";
-  for (unsigned i=0; i<nStats; i++) {
-    if (istatsMask & (1<<i))
-      of << sm.getStatistic(i).getShortName() << " ";
-  }
+  for (std::vector<Statistic *>::iterator it = istats.begin(),
+                                          ie = istats.end();
+       it != ie; ++it)
+    of << (*it)->getShortName() << " ";
   of << "\n";
   
   // set state counts, decremented after we process so that we don't
   // have to zero all records each time.
-  if (istatsMask & (1<<stats::states.getID()))
+  bool hasStates = std::find(istats.begin(), istats.end(), &stats::states) !=
+                   istats.end();
+  if (hasStates)
     updateStateStatistics(1);
 
   std::string sourceFile = "";
@@ -550,9 +1101,10 @@ void StatsTracker::writeIStats() {
           }
           of << ii.assemblyLine << " ";
           of << ii.line << " ";
-          for (unsigned i=0; i<nStats; i++)
-            if (istatsMask&(1<<i))
-              of << sm.getIndexedValue(sm.getStatistic(i), index) << " ";
+          for (std::vector<Statistic *>::iterator sit = istats.begin(),
+                                                  sie = istats.end();
+               sit != sie; ++sit)
+            of << theStatisticManager->getIndexedValue(**sit, index) << " ";
           of << "\n";
 
           if (UseCallPaths && 
@@ -576,21 +1128,21 @@ void StatsTracker::writeIStats() {
 
                 of << ii.assemblyLine << " ";
                 of << ii.line << " ";
-                for (unsigned i=0; i<nStats; i++) {
-                  if (istatsMask&(1<<i)) {
-                    Statistic &s = sm.getStatistic(i);
-                    uint64_t value;
-
-                    // Hack, ignore things that don't make sense on
-                    // call paths.
-                    if (&s == &stats::uncoveredInstructions) {
-                      value = 0;
-                    } else {
-                      value = csi.statistics.getValue(s);
-                    }
-
-                    of << value << " ";
+                for (std::vector<Statistic *>::iterator sit = istats.begin(),
+                                                        sie = istats.end();
+                     sit != sie; ++sit) {
+                  Statistic &s = **sit;
+                  uint64_t value;
+
+                  // Hack, ignore things that don't make sense on
+                  // call paths.
+                  if (&s == &stats::uncoveredInstructions) {
+                    value = 0;
+                  } else {
+                    value = csi.statistics.getValue(s);
                   }
+
+                  of << value << " ";
                 }
                 of << "\n";
               }
@@ -601,7 +1153,7 @@ void StatsTracker::writeIStats() {
     }
   }
 
-  if (istatsMask & (1<<stats::states.getID()))
+  if (hasStates)
     updateStateStatistics((uint64_t)-1);
   
   // Clear then end of the file if necessary (no truncate op?).
@@ -620,6 +1172,13 @@ static calltargets_ty callTargets;
 static std::map<Function*, std::vector<Instruction*> > functionCallers;
 static std::map<Function*, unsigned> functionShortestPath;
 
+/// The instructions of the module by their ids
+static std::vector<Instruction*> instructionsById;
+
+/// The ids of the instructions whose minDistToUncovered is computed from
+/// that of the instruction of each id
+static std::vector<std::vector<unsigned> > minDistDependents;
+
 static std::vector<Instruction*> getSuccs(Instruction *i) {
   BasicBlock *bb = i->getParent();
   std::vector<Instruction*> res;
@@ -634,6 +1193,70 @@ static std::vector<Instruction*> getSuccs(Instruction *i) {
   return res;
 }
 
+/// Get the distance from the instruction to its successors, through the
+/// shortest path of the functions it may call, or 0 if it never returns.
+static unsigned getDistanceThrough(Instruction *inst) {
+  if (!isa<CallInst>(inst) && !isa<InvokeInst>(inst))
+    return 1;
+
+  unsigned bestThrough = 0;
+  std::vector<Function*> &targets = callTargets[inst];
+  for (std::vector<Function*>::iterator fnIt = targets.begin(),
+         ie = targets.end(); fnIt != ie; ++fnIt) {
+    uint64_t dist = functionShortestPath[*fnIt];
+    if (dist) {
+      dist = 1+dist; // count instruction itself
+      if (bestThrough==0 || dist<bestThrough)
+        bestThrough = dist;
+    }
+  }
+  return bestThrough;
+}
+
+/// Lower the minDistToUncovered of the instruction to what its successors
+/// and callees give. Returns whether it changed.
+static bool lowerMinDistToUncovered(Instruction *inst,
+                                    const InstructionInfoTable &infos) {
+  StatisticManager &sm = *theStatisticManager;
+  unsigned id = infos.getInfo(inst).id;
+  uint64_t best, cur = best = sm.getIndexedValue(stats::minDistToUncovered, id);
+
+  if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
+    std::vector<Function*> &targets = callTargets[inst];
+    for (std::vector<Function*>::iterator fnIt = targets.begin(),
+           ie = targets.end(); fnIt != ie; ++fnIt) {
+      if (!(*fnIt)->isDeclaration()) {
+        uint64_t calleeDist = sm.getIndexedValue(stats::minDistToUncovered,
+                                                 infos.getFunctionInfo(*fnIt).id);
+        if (calleeDist) {
+          calleeDist = 1+calleeDist; // count instruction itself
+          if (best==0 || calleeDist<best)
+            best = calleeDist;
+        }
+      }
+    }
+  }
+
+  if (unsigned bestThrough = getDistanceThrough(inst)) {
+    std::vector<Instruction*> succs = getSuccs(inst);
+    for (std::vector<Instruction*>::iterator it = succs.begin(),
+           ie = succs.end(); it != ie; ++it) {
+      uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered,
+                                         infos.getInfo(*it).id);
+      if (dist) {
+        uint64_t val = bestThrough + dist;
+        if (best==0 || val<best)
+          best = val;
+      }
+    }
+  }
+
+  if (best == cur)
+    return false;
+  sm.setIndexedValue(stats::minDistToUncovered, id, best);
+  return true;
+}
+
 uint64_t klee::computeMinDistToUncovered(const KInstruction *ki,
                                          uint64_t minDistAtRA) {
   StatisticManager &sm = *theStatisticManager;
@@ -658,6 +1281,8 @@ uint64_t klee::computeMinDistToUncovered(const KInstruction *ki,
 
 std::map<llvm::BasicBlock *, std::vector<unsigned int> > StatsTracker::bbSpecCount;
 
+unsigned StatsTracker::uncoveredEpoch = 0;
+
 void StatsTracker::increaseEle(llvm::BasicBlock *bb, int indx, bool check) {
   if (check) {
     if (StatsTracker::bbSpecCount.find(bb) == StatsTracker::bbSpecCount.end()) {
@@ -806,82 +1431,76 @@ void StatsTracker::computeReachableUncovered() {
   }
 
   // compute minDistToUncovered, 0 is unreachable
-  std::vector<Instruction *> instructions;
-  for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
-       fnIt != fn_ie; ++fnIt) {
-    // Not sure if I should bother to preorder here.
-    for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
-         bbIt != bb_ie; ++bbIt) {
-      for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
-           it != ie; ++it) {
-        unsigned id = infos.getInfo(it).id;
-        instructions.push_back(&*it);
-        sm.setIndexedValue(stats::minDistToUncovered, 
-                           id, 
-                           sm.getIndexedValue(stats::uncoveredInstructions, id));
-      }
-    }
-  }
-  
-  std::reverse(instructions.begin(), instructions.end());
-  
-  // I'm so lazy it's not even worklisted.
-  bool changed;
-  do {
-    changed = false;
-    for (std::vector<Instruction*>::iterator it = instructions.begin(),
-           ie = instructions.end(); it != ie; ++it) {
-      Instruction *inst = *it;
-      uint64_t best, cur = best = sm.getIndexedValue(stats::minDistToUncovered, 
-                                                     infos.getInfo(inst).id);
-      unsigned bestThrough = 0;
-      
+  std::vector<unsigned> region;
+  if (instructionsById.empty()) {
+    instructionsById.resize(infos.getMaxID());
+    for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
+         fnIt != fn_ie; ++fnIt)
+      for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
+           bbIt != bb_ie; ++bbIt)
+        for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
+             it != ie; ++it)
+          instructionsById[infos.getInfo(it).id] = it;
+
+    // Record which distances each distance is computed from, as the
+    // first are only recomputed when the second may have changed
+    minDistDependents.resize(instructionsById.size());
+    for (unsigned id = 0; id < instructionsById.size(); ++id) {
+      Instruction *inst = instructionsById[id];
+      if (!inst)
+        continue;
       if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
         std::vector<Function*> &targets = callTargets[inst];
         for (std::vector<Function*>::iterator fnIt = targets.begin(),
-               ie = targets.end(); fnIt != ie; ++fnIt) {
-          uint64_t dist = functionShortestPath[*fnIt];
-          if (dist) {
-            dist = 1+dist; // count instruction itself
-            if (bestThrough==0 || dist<bestThrough)
-              bestThrough = dist;
-          }
-
-          if (!(*fnIt)->isDeclaration()) {
-            uint64_t calleeDist = sm.getIndexedValue(stats::minDistToUncovered,
-                                                     infos.getFunctionInfo(*fnIt).id);
-            if (calleeDist) {
-              calleeDist = 1+calleeDist; // count instruction itself
-              if (best==0 || calleeDist<best)
-                best = calleeDist;
-            }
-          }
-        }
-      } else {
-        bestThrough = 1;
+               ie = targets.end(); fnIt != ie; ++fnIt)
+          if (!(*fnIt)->isDeclaration())
+            minDistDependents[infos.getFunctionInfo(*fnIt).id].push_back(id);
       }
-      
-      if (bestThrough) {
+      if (getDistanceThrough(inst)) {
         std::vector<Instruction*> succs = getSuccs(inst);
-        for (std::vector<Instruction*>::iterator it2 = succs.begin(),
-               ie = succs.end(); it2 != ie; ++it2) {
-          uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered,
-                                             infos.getInfo(*it2).id);
-          if (dist) {
-            uint64_t val = bestThrough + dist;
-            if (best==0 || val<best)
-              best = val;
-          }
-        }
+        for (std::vector<Instruction*>::iterator it = succs.begin(),
+               ie = succs.end(); it != ie; ++it)
+          minDistDependents[infos.getInfo(*it).id].push_back(id);
       }
+    }
 
-      if (best != cur) {
-        sm.setIndexedValue(stats::minDistToUncovered, 
-                           infos.getInfo(inst).id, 
-                           best);
-        changed = true;
-      }
+    for (unsigned id = instructionsById.size(); id > 0; --id)
+      if (instructionsById[id - 1])
+        region.push_back(id - 1);
+  } else {
+    // Coverage only grows, hence only the distances of the instructions
+    // that reach a newly covered one may have changed
+    std::vector<bool> affected(instructionsById.size(), false);
+    std::vector<unsigned> worklist(newlyCovered.begin(), newlyCovered.end());
+    while (!worklist.empty()) {
+      unsigned id = worklist.back();
+      worklist.pop_back();
+      if (affected[id])
+        continue;
+      affected[id] = true;
+      region.push_back(id);
+      worklist.insert(worklist.end(), minDistDependents[id].begin(),
+                      minDistDependents[id].end());
     }
+    // In the reverse order of the module, as the full computation
+    std::sort(region.begin(), region.end(), std::greater<unsigned>());
+  }
+  newlyCovered.clear();
+
+  for (std::vector<unsigned>::iterator it = region.begin(),
+         ie = region.end(); it != ie; ++it)
+    sm.setIndexedValue(stats::minDistToUncovered, *it,
+                       sm.getIndexedValue(stats::uncoveredInstructions, *it));
+
+  // The distances outside the region are final, and the region is iterated
+  // to a fixpoint.
+  bool changed;
+  do {
+    changed = false;
+    for (std::vector<unsigned>::iterator it = region.begin(),
+           ie = region.end(); it != ie; ++it)
+      if (lowerMinDistToUncovered(instructionsById[*it], infos))
+        changed = true;
   } while (changed);
 
   for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
@@ -905,4 +1524,6 @@ void StatsTracker::computeReachableUncovered() {
       currentFrameMinDist = computeMinDistToUncovered(kii, currentFrameMinDist);
     }
   }
+
+  ++uncoveredEpoch;
 }
@@ -13,6 +13,8 @@
 #include "CallPathManager.h"
 
 #include <set>
+#include <stdint.h>
+#include <vector>
 
 namespace llvm {
   class BranchInst;
@@ -28,11 +30,13 @@ namespace klee {
   class InstructionInfoTable;
   class InterpreterHandler;
   struct KInstruction;
+  struct LiveStats;
   struct StackFrame;
 
   class StatsTracker {
     friend class WriteStatsTimer;
     friend class WriteIStatsTimer;
+    friend class WriteLiveStatsTimer;
 
     Executor &executor;
     std::string objectFilename;
@@ -47,6 +51,18 @@ namespace klee {
 
     bool updateMinDistToUncovered;
 
+    /// The instructions covered since the last computeReachableUncovered
+    std::vector<unsigned> newlyCovered;
+
+    /// The indexed statistics at the last write of run.istats.bin
+    std::vector<uint64_t> istatsLastValues;
+
+    /// The mapped file of -live-stats-file, and the values of its last
+    /// update from which the rates are computed
+    LiveStats *liveStats;
+    double liveLastTime;
+    uint64_t liveLastInstructions, liveLastQueries, liveLastSolverTime;
+
   public:
     static bool useStatistics();
 
@@ -56,6 +72,33 @@ namespace klee {
     void writeStatsLine();
     void writeIStats();
 
+    /// Map the file of -live-stats-file, see LiveStats for its layout.
+    void openLiveStats(const std::string &fileName);
+    void writeLiveStats(bool finished);
+
+    /// Write the header of run.istats.bin, the append-only alternative to
+    /// run.istats. All fields are little-endian, and the strings are
+    /// preceded by their length (32 bits). The header has the magic number
+    /// "KIST" and the format version (32 bits each), the object file and
+    /// module names, the number of statistics (32 bits) followed by their
+    /// names and short names, the number of the statistics run.istats would
+    /// hold (32 bits) followed by their ids (32 bits each), and the number of
+    /// instructions (32 bits) followed by, for each, its id, assembly line
+    /// and source line (32 bits each), and the names of its function, of the
+    /// file of its function and of its file.
+    void writeIStatsDeltaHeader();
+
+    /// Mark the instructions covered in the run.istats of a previous run as
+    /// covered, for -resume-coverage.
+    void readPreviousCoverage(const std::string &fileName);
+
+    /// Append a record of the changes of the indexed statistics since the
+    /// last record: the time since the start of the run in seconds (double),
+    /// the number of changes (32 bits), and for each change, the instruction
+    /// id and the statistic id (32 bits each) and the difference of the value
+    /// modulo 2^64 (64 bits).
+    void writeIStatsDelta();
+
   public:
     StatsTracker(Executor &_executor, std::string _objectFilename,
                  bool _updateMinDistToUncovered);
@@ -85,6 +128,11 @@ namespace klee {
 
     void computeReachableUncovered();
 
+    /// The number of runs of computeReachableUncovered, after each of which
+    /// the minimal distances to uncovered instructions of all the states may
+    /// have changed
+    static unsigned uncoveredEpoch;
+
     static std::map<llvm::BasicBlock *, std::vector<unsigned int> > bbSpecCount;
 
     static void increaseEle(llvm::BasicBlock *bb, int indx, bool check);
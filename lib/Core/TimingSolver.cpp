@@ -15,8 +15,10 @@
 #include "klee/Solver.h"
 #include "klee/Statistics.h"
 #include "klee/Internal/System/Time.h"
+#include "klee/util/ExprUtil.h"
 
 #include "CoreStats.h"
+#include "SamplingProfiler.h"
 
 #include "llvm/Support/TimeValue.h"
 
@@ -34,6 +36,16 @@ bool TimingSolver::evaluate(const ExecutionState &state, ref<Expr> expr,
     return true;
   }
 
+  // A model on each side shows that both are feasible
+  bool satisfied, falsified;
+  evaluateModels(state, expr, satisfied, falsified);
+  if (satisfied && falsified) {
+    unsatCore.clear();
+    result = Solver::Unknown;
+    return true;
+  }
+
+  SamplingProfiler::Scope phase(SamplingProfiler::Solver);
   sys::TimeValue now = util::getWallTimeVal();
 
   std::vector<ref<Expr> > simplificationCore;
@@ -42,8 +54,19 @@ bool TimingSolver::evaluate(const ExecutionState &state, ref<Expr> expr,
 
   unsatCore.clear();
 
-  bool success =
-      solver->evaluate(Query(state.constraints, expr), result, unsatCore);
+  // With a model on one side, only the other side is queried
+  bool success, isValid;
+  if (satisfied) {
+    success = findCounterexample(state, expr, isValid, unsatCore);
+    result = isValid ? Solver::True : Solver::Unknown;
+  } else if (falsified) {
+    success = findCounterexample(state, Expr::createIsZero(expr), isValid,
+                                 unsatCore);
+    result = isValid ? Solver::False : Solver::Unknown;
+  } else {
+    success =
+        solver->evaluate(Query(state.constraints, expr), result, unsatCore);
+  }
   if (INTERPOLATION_ENABLED) {
     if (result != Solver::Unknown) {
       if (simplifyExprs) {
@@ -70,14 +93,26 @@ bool TimingSolver::mustBeTrue(const ExecutionState &state, ref<Expr> expr,
     return true;
   }
 
+  bool satisfied, falsified;
+  evaluateModels(state, expr, satisfied, falsified);
+  if (falsified) {
+    result = false;
+    return true;
+  }
+
+  SamplingProfiler::Scope phase(SamplingProfiler::Solver);
   sys::TimeValue now = util::getWallTimeVal();
 
   std::vector<ref<Expr> > simplificationCore;
   if (simplifyExprs)
     expr = state.constraints.simplifyExpr(expr, simplificationCore);
 
+  // The counterexample, if any, makes the other side decidable by a model
   bool success =
-      solver->mustBeTrue(Query(state.constraints, expr), result, unsatCore);
+      satisfied
+          ? findCounterexample(state, expr, result, unsatCore)
+          : solver->mustBeTrue(Query(state.constraints, expr), result,
+                               unsatCore);
 
   if (INTERPOLATION_ENABLED && simplifyExprs) {
     unsatCore.insert(unsatCore.begin(), simplificationCore.begin(),
@@ -125,6 +160,7 @@ bool TimingSolver::getValue(const ExecutionState& state, ref<Expr> expr,
     return true;
   }
   
+  SamplingProfiler::Scope phase(SamplingProfiler::Solver);
   sys::TimeValue now = util::getWallTimeVal();
 
   std::vector<ref<Expr> > simplificationCore;
@@ -149,11 +185,14 @@ TimingSolver::getInitialValues(const ExecutionState &state,
   if (objects.empty())
     return true;
 
+  SamplingProfiler::Scope phase(SamplingProfiler::Solver);
   sys::TimeValue now = util::getWallTimeVal();
 
   bool success = solver->getInitialValues(
       Query(state.constraints, ConstantExpr::alloc(0, Expr::Bool)), objects,
       result, unsatCore);
+  if (success)
+    state.addModel(new StateModel(objects, result));
 
   sys::TimeValue delta = util::getWallTimeVal();
   delta -= now;
@@ -165,7 +204,104 @@ TimingSolver::getInitialValues(const ExecutionState &state,
 
 std::pair< ref<Expr>, ref<Expr> >
 TimingSolver::getRange(const ExecutionState& state, ref<Expr> expr) {
+  SamplingProfiler::Scope phase(SamplingProfiler::Solver);
   std::pair<ref<Expr>, ref<Expr> > ret =
       solver->getRange(Query(state.constraints, expr));
   return ret;
 }
+
+bool TimingSolver::getFeasibleValue(const ExecutionState &state,
+                                    ref<Expr> condition, ref<Expr> expr,
+                                    ref<ConstantExpr> &result,
+                                    bool &hasSolution,
+                                    std::vector<ref<Expr> > &unsatCore) {
+  unsatCore.clear();
+
+  // A model of the state satisfying the condition gives a value at no cost
+  for (std::vector<ref<StateModel> >::iterator it = state.models.begin(),
+                                               ie = state.models.end();
+       it != ie; ++it) {
+    ref<Expr> satisfied = (*it)->assignment.evaluate(condition);
+    ref<Expr> value = (*it)->assignment.evaluate(expr);
+    if (isa<ConstantExpr>(satisfied) && cast<ConstantExpr>(satisfied)->isTrue() &&
+        isa<ConstantExpr>(value)) {
+      result = cast<ConstantExpr>(value);
+      hasSolution = true;
+      return true;
+    }
+  }
+
+  SamplingProfiler::Scope phase(SamplingProfiler::Solver);
+  sys::TimeValue now = util::getWallTimeVal();
+
+  std::vector<ref<Expr> > simplificationCore;
+  if (simplifyExprs)
+    condition = state.constraints.simplifyExpr(condition, simplificationCore);
+
+  // Bind the arrays of the expression, such that the model gives its value
+  std::vector<ref<Expr> > exprs;
+  exprs.push_back(condition);
+  exprs.push_back(expr);
+  std::vector<const Array *> objects;
+  findSymbolicObjects(exprs.begin(), exprs.end(), objects);
+
+  std::vector<std::vector<unsigned char> > values;
+  bool success = solver->getInitialValues(
+      Query(state.constraints, Expr::createIsZero(condition)), objects, values,
+      hasSolution, unsatCore);
+  if (success && hasSolution) {
+    unsatCore.clear();
+    ref<StateModel> model = new StateModel(objects, values);
+    state.addModel(model.get());
+    result = cast<ConstantExpr>(model->assignment.evaluate(expr));
+  } else if (success && INTERPOLATION_ENABLED && simplifyExprs) {
+    unsatCore.insert(unsatCore.begin(), simplificationCore.begin(),
+                     simplificationCore.end());
+  }
+
+  sys::TimeValue delta = util::getWallTimeVal();
+  delta -= now;
+  stats::solverTime += delta.usec();
+  state.queryCost += delta.usec()/1000000.;
+
+  return success;
+}
+
+void TimingSolver::evaluateModels(const ExecutionState &state, ref<Expr> expr,
+                                  bool &satisfied, bool &falsified) {
+  satisfied = falsified = false;
+  for (std::vector<ref<StateModel> >::iterator it = state.models.begin(),
+                                               ie = state.models.end();
+       it != ie; ++it) {
+    ref<Expr> value = (*it)->assignment.evaluate(expr);
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
+      if (CE->isTrue())
+        satisfied = true;
+      else
+        falsified = true;
+    }
+  }
+}
+
+bool TimingSolver::findCounterexample(const ExecutionState &state,
+                                      ref<Expr> expr, bool &isValid,
+                                      std::vector<ref<Expr> > &unsatCore) {
+  std::vector<const Array *> objects;
+  for (unsigned i = 0; i != state.symbolics.size(); ++i)
+    objects.push_back(state.symbolics[i].second);
+  if (objects.empty())
+    return solver->mustBeTrue(Query(state.constraints, expr), isValid,
+                              unsatCore);
+
+  std::vector<std::vector<unsigned char> > values;
+  bool hasSolution;
+  if (!solver->getInitialValues(Query(state.constraints, expr), objects,
+                                values, hasSolution, unsatCore))
+    return false;
+  isValid = !hasSolution;
+  if (hasSolution) {
+    unsatCore.clear();
+    state.addModel(new StateModel(objects, values));
+  }
+  return true;
+}
@@ -46,6 +46,8 @@ namespace klee {
       return solver->getConstraintLog(query);
     }
 
+    void releaseMemory() { solver->releaseMemory(); }
+
     bool evaluate(const ExecutionState &, ref<Expr>, Solver::Validity &result,
                   std::vector<ref<Expr> > &unsatCore);
 
@@ -92,6 +94,27 @@ namespace klee {
 
     std::pair< ref<Expr>, ref<Expr> >
     getRange(const ExecutionState&, ref<Expr> query);
+
+    /// Find a value of the expression under the constraints of the state and
+    /// the condition, for enumerating the feasible values of the expression
+    /// with blocking conditions. hasSolution is false, with the
+    /// unsatisfiability core, when the condition is infeasible.
+    bool getFeasibleValue(const ExecutionState &, ref<Expr> condition,
+                          ref<Expr> expr, ref<ConstantExpr> &result,
+                          bool &hasSolution,
+                          std::vector<ref<Expr> > &unsatCore);
+
+  private:
+    /// Evaluate the expression under the models of the state, setting
+    /// satisfied (falsified) when one of them makes it true (false).
+    void evaluateModels(const ExecutionState &, ref<Expr>, bool &satisfied,
+                        bool &falsified);
+
+    /// Find whether the expression is valid under the constraints of the
+    /// state by looking for a counterexample, which becomes a model of the
+    /// state, at the cost of a single query.
+    bool findCounterexample(const ExecutionState &, ref<Expr>, bool &isValid,
+                            std::vector<ref<Expr> > &unsatCore);
   };
 
 }
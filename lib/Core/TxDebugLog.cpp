@@ -0,0 +1,153 @@
+//===-- TxDebugLog.cpp - Tracer-X subsumption debug log ---------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementations of the classes that record the
+/// subsumption debugging events into a bounded buffer.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TxDebugLog.h"
+
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/util/TxPrintUtil.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <fstream>
+
+using namespace klee;
+
+namespace {
+llvm::cl::opt<unsigned> DebugSubsumptionLogSize(
+    "debug-subsumption-log-size",
+    llvm::cl::desc("Record the subsumption debugging events into a buffer of "
+                   "the given number of records instead of printing them, and "
+                   "dump it into subsumption-log.bin at the end of the run "
+                   "(default=0 (off))."),
+    llvm::cl::init(0));
+
+llvm::cl::opt<unsigned> DebugSubsumptionLogPointSample(
+    "debug-subsumption-log-point-sample",
+    llvm::cl::desc("Only record the debugging events of one in the given "
+                   "number of program points (default=1)."),
+    llvm::cl::init(1));
+
+llvm::cl::opt<unsigned> DebugSubsumptionLogNodeSample(
+    "debug-subsumption-log-node-sample",
+    llvm::cl::desc("Only record the debugging events of one in the given "
+                   "number of nodes (default=1)."),
+    llvm::cl::init(1));
+
+const uint32_t DebugLogFileMagic = 0x4c445854; // "TXDL"
+
+const uint32_t DebugLogFileVersion = 1;
+}
+
+std::vector<TxDebugLog::Record> TxDebugLog::records;
+
+unsigned TxDebugLog::next = 0;
+
+uint64_t TxDebugLog::recordCount = 0;
+
+uint64_t TxDebugLog::sampledOutCount = 0;
+
+double TxDebugLog::startTime = util::getWallTime();
+
+static void writeUInt32(std::ofstream &os, uint32_t value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void writeUInt64(std::ofstream &os, uint64_t value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void writeString(std::ofstream &os, const std::string &s) {
+  writeUInt32(os, s.size());
+  os.write(s.data(), s.size());
+}
+
+bool TxDebugLog::isEnabled() { return DebugSubsumptionLogSize > 0; }
+
+bool TxDebugLog::isSampled(uintptr_t programPoint,
+                           uint64_t nodeSequenceNumber) {
+  // The program points are hashed as their addresses are aligned
+  uint64_t pointHash = (uint64_t)programPoint * 0x9e3779b97f4a7c15ULL;
+  return (pointHash >> 32) % DebugSubsumptionLogPointSample == 0 &&
+         nodeSequenceNumber % DebugSubsumptionLogNodeSample == 0;
+}
+
+void TxDebugLog::record(Event event, uint64_t nodeSequenceNumber,
+                        uint64_t entrySequenceNumber, uintptr_t programPoint,
+                        unsigned reason, unsigned querySize,
+                        ref<Expr> interpolant, ref<Expr> wpInterpolant) {
+  if (!isSampled(programPoint, nodeSequenceNumber)) {
+    ++sampledOutCount;
+    return;
+  }
+
+  if (records.size() < DebugSubsumptionLogSize)
+    records.push_back(Record());
+  Record &r = records[next];
+  next = (next + 1) % DebugSubsumptionLogSize;
+  ++recordCount;
+
+  r.time = util::getWallTime() - startTime;
+  r.nodeSequenceNumber = nodeSequenceNumber;
+  r.entrySequenceNumber = entrySequenceNumber;
+  r.programPoint = programPoint;
+  r.event = event;
+  r.reason = reason;
+  r.querySize = querySize;
+  r.interpolant = interpolant;
+  r.wpInterpolant = wpInterpolant;
+}
+
+void TxDebugLog::dump(const std::string &fileName, KModule *kmodule) {
+  std::ofstream os(fileName.c_str(), std::ios::out | std::ios::binary);
+  if (!os.good()) {
+    klee_warning("could not open subsumption log file %s", fileName.c_str());
+    return;
+  }
+
+  writeUInt32(os, DebugLogFileMagic);
+  writeUInt32(os, DebugLogFileVersion);
+  writeUInt64(os, records.size());
+  writeUInt64(os, recordCount - records.size());
+  writeUInt64(os, sampledOutCount);
+
+  // The oldest record is the next to be overwritten once the buffer is full
+  unsigned first = records.size() < DebugSubsumptionLogSize ? 0 : next;
+  for (unsigned i = 0; i < records.size(); ++i) {
+    const Record &r = records[(first + i) % records.size()];
+    os.write(reinterpret_cast<const char *>(&r.time), sizeof(r.time));
+    writeUInt64(os, r.nodeSequenceNumber);
+    writeUInt64(os, r.entrySequenceNumber);
+    llvm::Instruction *inst =
+        reinterpret_cast<llvm::Instruction *>(r.programPoint);
+    writeUInt32(os, kmodule->infos->getInfo(inst).id);
+    os.put(r.event);
+    os.put(r.reason);
+    writeUInt32(os, r.querySize);
+    writeString(os, r.interpolant.isNull()
+                        ? ""
+                        : TxPrettyExpressionBuilder::construct(r.interpolant));
+    writeString(os, r.wpInterpolant.isNull()
+                        ? ""
+                        : TxPrettyExpressionBuilder::construct(
+                              r.wpInterpolant));
+  }
+
+  os.close();
+  if (!os.good())
+    klee_warning("error writing subsumption log file %s", fileName.c_str());
+}
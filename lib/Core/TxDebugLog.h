@@ -0,0 +1,105 @@
+//===-- TxDebugLog.h - Tracer-X subsumption debug log -----------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains declarations of the classes that record the
+/// subsumption debugging events into a bounded buffer, as an alternative to
+/// printing them.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef TXDEBUGLOG_H_
+#define TXDEBUGLOG_H_
+
+#include "klee/Expr.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace klee {
+
+class KModule;
+
+/// \brief The log of the subsumption debugging events.
+///
+/// With -debug-subsumption-log-size, the events of the nodes with a nonzero
+/// debug subsumption level are recorded into a ring buffer of that many
+/// records, instead of being printed. The expressions of the records are only
+/// formatted when the log is dumped, and the events can be sampled by program
+/// point and by node with -debug-subsumption-log-point-sample and
+/// -debug-subsumption-log-node-sample, such that the log can be kept on in
+/// long runs.
+///
+/// The dump is a binary file of little-endian fields: the magic number
+/// "TXDL", the format version, the number of records, the number of records
+/// overwritten in the buffer and the number of events not sampled (32, 32,
+/// 64, 64 and 64 bits), followed by the records in the order of their events.
+/// Each record has the time since the start of the run in seconds (double),
+/// the node and table entry sequence numbers (64 bits each), the instruction
+/// id of the program point (32 bits), the event and check failure reason (8
+/// bits each), the query size (32 bits), and the interpolant and weakest
+/// precondition interpolant texts, each preceded by its length (32 bits).
+class TxDebugLog {
+public:
+  enum Event {
+    /// A check against a table entry succeeded
+    CheckSuccess,
+    /// A check against a table entry failed
+    CheckFailure,
+    /// A table entry was stored
+    EntryStored
+  };
+
+private:
+  struct Record {
+    double time;
+    uint64_t nodeSequenceNumber;
+    uint64_t entrySequenceNumber;
+    uintptr_t programPoint;
+    uint8_t event;
+    uint8_t reason;
+    uint32_t querySize;
+    ref<Expr> interpolant;
+    ref<Expr> wpInterpolant;
+  };
+
+  static std::vector<Record> records;
+
+  /// \brief The index of the next record to write in the buffer
+  static unsigned next;
+
+  /// \brief The number of records written in all
+  static uint64_t recordCount;
+
+  /// \brief The number of events not recorded due to sampling
+  static uint64_t sampledOutCount;
+
+  static double startTime;
+
+  static bool isSampled(uintptr_t programPoint, uint64_t nodeSequenceNumber);
+
+public:
+  /// \brief Test whether the debugging events are to be recorded instead of
+  /// printed
+  static bool isEnabled();
+
+  /// \brief Record an event, if sampled
+  static void record(Event event, uint64_t nodeSequenceNumber,
+                     uint64_t entrySequenceNumber, uintptr_t programPoint,
+                     unsigned reason, unsigned querySize,
+                     ref<Expr> interpolant, ref<Expr> wpInterpolant);
+
+  /// \brief Write the records of the buffer into a file, in the format
+  /// described above
+  static void dump(const std::string &fileName, KModule *kmodule);
+};
+}
+
+#endif /* TXDEBUGLOG_H_ */
@@ -80,47 +80,74 @@ ref<TxStateValue> TxDependency::getLatestValue(
   return ret;
 }
 
+const TxDependency *
+TxDependency::getDefiningAncestor(llvm::Value *value) const {
+  std::vector<const TxDependency *> path;
+  const TxDependency *ret = 0;
+  for (const TxDependency *current = this; current->parent;
+       current = current->parent) {
+    llvm::DenseMap<llvm::Value *, const TxDependency *>::const_iterator it =
+        current->ancestorIndex.find(value);
+    if (it != current->ancestorIndex.end()) {
+      ret = it->second;
+      break;
+    }
+    path.push_back(current);
+    if (current->parent->valuesMap.count(value)) {
+      ret = current->parent;
+      break;
+    }
+  }
+
+  for (std::vector<const TxDependency *>::iterator it = path.begin(),
+                                                   ie = path.end();
+       it != ie; ++it)
+    (*it)->ancestorIndex[value] = ret;
+  return ret;
+}
+
 ref<TxStateValue> TxDependency::getLatestValueNoConstantCheck(
     llvm::Value *value, ref<Expr> valueExpr, bool allowInconsistency) const {
   assert(value && "value cannot be null");
 
-  std::map<llvm::Value *, std::vector<ref<TxStateValue> > >::const_iterator
-  valuesMapIter = valuesMap.find(value);
-
-  if (valuesMapIter != valuesMap.end()) {
-    if (!valueExpr.isNull()) {
-      // Slight complication here that the latest version of an LLVM
-      // value may not be at the end of the vector; it is possible other
-      // values in a call stack has been appended to the vector, before
-      // the function returned, so the end part of the vector contains
-      // local values in a call already returned. To resolve this issue,
-      // here we naively search for values with equivalent expression.
-      const std::vector<ref<TxStateValue> > &allValues = valuesMapIter->second;
-
-      // In case this was for adding constraints, simply assume the
-      // latest value is the one without checking for its consistency. This is
-      // due to the difficulty in that the constraint in valueExpr is already
-      // processed into a different syntax (a negation of the original value).
-      if (allowInconsistency)
-        return allValues.back();
-
-      for (std::vector<ref<TxStateValue> >::const_reverse_iterator
-               it = allValues.rbegin(),
-               ie = allValues.rend();
-           it != ie; ++it) {
-        ref<Expr> e = (*it)->getExpression();
-        if (e == valueExpr)
-          return *it;
-      }
-    } else {
+  // Only the nodes having versions of the value are visited, skipping the
+  // others via the ancestor index
+  const TxDependency *current = this;
+  if (!valuesMap.count(value))
+    current = getDefiningAncestor(value);
+
+  for (; current; current = current->getDefiningAncestor(value)) {
+    std::map<llvm::Value *, std::vector<ref<TxStateValue> > >::const_iterator
+    valuesMapIter = current->valuesMap.find(value);
+
+    if (valueExpr.isNull())
       return valuesMapIter->second.back();
+
+    // Slight complication here that the latest version of an LLVM
+    // value may not be at the end of the vector; it is possible other
+    // values in a call stack has been appended to the vector, before
+    // the function returned, so the end part of the vector contains
+    // local values in a call already returned. To resolve this issue,
+    // here we naively search for values with equivalent expression.
+    const std::vector<ref<TxStateValue> > &allValues = valuesMapIter->second;
+
+    // In case this was for adding constraints, simply assume the
+    // latest value is the one without checking for its consistency. This is
+    // due to the difficulty in that the constraint in valueExpr is already
+    // processed into a different syntax (a negation of the original value).
+    if (allowInconsistency)
+      return allValues.back();
+
+    for (std::vector<ref<TxStateValue> >::const_reverse_iterator
+             it = allValues.rbegin(),
+             ie = allValues.rend();
+         it != ie; ++it) {
+      ref<Expr> e = (*it)->getExpression();
+      if (e == valueExpr)
+        return *it;
     }
   }
 
-  if (parent)
-    return parent->getLatestValueNoConstantCheck(value, valueExpr,
-                                                 allowInconsistency);
-
   return 0;
 }
 
@@ -148,6 +175,22 @@ ref<TxStateValue> TxDependency::getLatestValueForMarking(llvm::Value *val,
   return value;
 }
 
+void TxDependency::mergeValue(
+    llvm::Value *value, const std::vector<llvm::Instruction *> &callHistory,
+    ref<Expr> mergedExpr, ref<Expr> expr, const TxDependency *other,
+    ref<Expr> otherExpr) {
+  ref<TxStateValue> source = getLatestValueNoConstantCheck(value, expr);
+  ref<TxStateValue> otherSource =
+      other->getLatestValueNoConstantCheck(value, otherExpr);
+  ref<TxStateValue> target =
+      getNewTxStateValue(value, callHistory, mergedExpr);
+
+  // The pointer information of both sources is kept, as the merged value may
+  // point to either
+  addDependency(source, target);
+  addDependency(otherSource, target);
+}
+
 void TxDependency::addDependency(ref<TxStateValue> source,
                                  ref<TxStateValue> target) {
   if (source.isNull() || target.isNull())
@@ -250,7 +293,7 @@ void TxDependency::addDependencyViaExternalFunction(
       stream << "]";
       stream.flush();
     }
-    store->markPointerFlow(source, source, reason);
+    store->markPointerFlow(source, source, TxCoreReasons::intern(reason));
   }
 
   // Add new location to the target in case of pointer return value
@@ -527,7 +570,8 @@ void TxDependency::execute(llvm::Instruction *instr,
           stream << "]";
           stream.flush();
         }
-        markAllValues(binst->getCondition(), unknownExpression, reason);
+        markAllValues(binst->getCondition(), unknownExpression,
+                      TxCoreReasons::intern(reason));
       }
       break;
     }
@@ -585,7 +629,8 @@ void TxDependency::execute(llvm::Instruction *instr,
         stream << "]";
         stream.flush();
       }
-      markAllValues(instr->getOperand(0), argExpr, reason);
+      markAllValues(instr->getOperand(0), argExpr,
+                    TxCoreReasons::intern(reason));
       break;
     }
     default: { assert(!"unhandled unary instruction"); }
@@ -1010,13 +1055,26 @@ bool TxDependency::executeMemoryOperation(
         stream << "]";
         stream.flush();
       }
+      std::pair<ref<TxStateValue>, unsigned> key(
+          val, TxCoreReasons::intern(reason));
+      if (fullyMarkedPointers.count(key))
+        return ret;
+      std::map<std::pair<ref<TxStateValue>, unsigned>, bool>::iterator it =
+          checkedPointers.find(key);
+      if (it != checkedPointers.end())
+        return it->second;
+
       if (ExactAddressInterpolant) {
-        markAllValues(val, reason);
+        markAllValues(val, key.second);
+        fullyMarkedPointers.insert(key);
       } else {
-        ret = markAllPointerValues(val, reason);
+        ret = markAllPointerValues(val, key.second);
         if (ret && !TracerXPointerError) {
-          markAllValues(val, reason);
+          markAllValues(val, key.second);
+          fullyMarkedPointers.insert(key);
           ret = false;
+        } else {
+          checkedPointers[key] = ret;
         }
       }
     }
@@ -1080,8 +1138,7 @@ TxDependency::bindReturnValue(llvm::CallInst *site,
   }
 }
 
-void TxDependency::markAllValues(ref<TxStateValue> value,
-                                 const std::string &reason) {
+void TxDependency::markAllValues(ref<TxStateValue> value, unsigned reason) {
   if (value.isNull())
     return;
 
@@ -1094,12 +1151,27 @@ void TxDependency::markAllValues(ref<TxStateValue> value,
   }
 }
 
-void TxDependency::markGlobalVars(ref<TxStateValue> value,
-                                  const std::string &reason) {
-  const std::set<ref<TxStoreEntry> > &allowBoundEntryList(
+void TxDependency::markAllValues(const std::set<ref<TxStateValue> > &values,
+                                 unsigned reason) {
+  store->markFlow(values, reason);
+
+  for (std::set<ref<TxStateValue> >::const_iterator it = values.begin(),
+                                                    ie = values.end();
+       it != ie; ++it) {
+    if (it->isNull())
+      continue;
+    store->markUsed((*it)->getAllowBoundEntryList());
+    store->markUsed((*it)->getDisableBoundEntryList());
+    if (MarkGlobal) {
+      markGlobalVars(*it, reason);
+    }
+  }
+}
+
+void TxDependency::markGlobalVars(ref<TxStateValue> value, unsigned reason) {
+  const TxStoreEntryList &allowBoundEntryList(
       value->getAllowBoundEntryList());
-  for (std::set<ref<TxStoreEntry> >::const_iterator
-           it = allowBoundEntryList.begin(),
+  for (TxStoreEntryList::const_iterator it = allowBoundEntryList.begin(),
            ie = allowBoundEntryList.end();
        it != ie; ++it) {
     ref<TxStoreEntry> se = (*it);
@@ -1134,7 +1206,7 @@ void TxDependency::recursivelyMarkGlobalVars(ref<TxStoreEntry> se) {
 
 bool TxDependency::markAllPointerValues(ref<TxStateValue> value,
                                         std::set<uint64_t> &bounds,
-                                        const std::string &reason) {
+                                        unsigned reason) {
   if (value.isNull())
     return false;
 
@@ -1154,7 +1226,7 @@ bool TxDependency::boundInterpolation(llvm::Value *val) {
 
     if (llvm::Instruction *instr = llvm::dyn_cast<llvm::Instruction>(val)) {
       if (instr->getParent() && instr->getParent()->getParent() &&
-          instr->getParent()->getParent()->getName().str() == "tracerx_check")
+          instr->getParent()->getParent()->getName() == "tracerx_check")
         return true;
     }
     return false;
@@ -1202,7 +1274,10 @@ void TxDependency::memoryBoundViolationInterpolation(llvm::Instruction *inst,
       stream << "]";
       stream.flush();
     }
-    markAllValues(val, reason);
+    std::pair<ref<TxStateValue>, unsigned> key(val,
+                                               TxCoreReasons::intern(reason));
+    if (fullyMarkedPointers.insert(key).second)
+      markAllValues(val, key.second);
   }
 }
 
@@ -17,12 +17,15 @@
 #ifndef KLEE_DEPENDENCY_H
 #define KLEE_DEPENDENCY_H
 
+#include "TxObjectPool.h"
 #include "TxPathCondition.h"
 #include "TxStore.h"
 
 #include "klee/Config/Version.h"
 #include "klee/Internal/Module/TxValues.h"
 
+#include <llvm/ADT/DenseMap.h>
+
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/Function.h>
@@ -170,6 +173,8 @@ namespace klee {
 /// \see TxStateValue
 /// \see TxStateAddress
 class TxDependency {
+  friend class TxMemoryCensus;
+
   /// \brief The path condition manager
   TxPathCondition *pathCondition;
 
@@ -185,6 +190,11 @@ class TxDependency {
   /// \brief The store of the versioned values
   std::map<llvm::Value *, std::vector<ref<TxStateValue> > > valuesMap;
 
+  /// \brief The nearest ancestor having versions of each value looked up
+  /// from this node, or NULL when there is none. The ancestors no longer
+  /// register values once split, hence the entries never become stale.
+  mutable llvm::DenseMap<llvm::Value *, const TxDependency *> ancestorIndex;
+
   /// \brief The data layout of the analysis target program
   llvm::DataLayout *targetData;
 
@@ -195,6 +205,16 @@ class TxDependency {
 
   std::set<ref<TxStoreEntry> > markedGlobal;
 
+  /// \brief The outcomes of the bound checks of this node, by the checked
+  /// pointer value and the marking reason. The flow of a value is fixed at
+  /// its creation, and the markings only tighten the bounds of its entries,
+  /// hence a repeated check of the value marks nothing new.
+  std::map<std::pair<ref<TxStateValue>, unsigned>, bool> checkedPointers;
+
+  /// \brief The pointer values of this node whose flow has been marked
+  /// entirely, which disables the bound adjustment of a later check.
+  std::set<std::pair<ref<TxStateValue>, unsigned> > fullyMarkedPointers;
+
   /// \brief Tests if a pointer points to a main function's argument
   static bool isMainArgument(const llvm::Value *loc);
 
@@ -239,6 +259,10 @@ class TxDependency {
   evalConstantExpr(llvm::ConstantExpr *ce,
                    const std::vector<llvm::Instruction *> &callHistory);
 
+  /// \brief Find the nearest proper ancestor having versions of the value,
+  /// memoizing it in the nodes along the way.
+  const TxDependency *getDefiningAncestor(llvm::Value *value) const;
+
   /// \brief Gets the latest version of the location, but without checking
   /// for whether the value is constant or not.
   ref<TxStateValue>
@@ -296,13 +320,10 @@ class TxDependency {
       const std::vector<llvm::Instruction *> &callHistory,
       const std::map<ref<Expr>, ref<Expr> > &substitution,
       std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
-      TxStore::TopStateStore &__internalStore,
-      TxStore::LowerStateStore &__concretelyAddressedHistoricalStore,
-      TxStore::LowerStateStore &__symbolicallyAddressedHistoricalStore) {
-    store->getStoredExpressions(
-        referenceStore, callHistory, substitution, replacements, coreOnly,
-        leftRetrieval, __internalStore, __concretelyAddressedHistoricalStore,
-        __symbolicallyAddressedHistoricalStore);
+      TxStore::StateStoreView &stateStore) {
+    store->getStoredExpressions(referenceStore, callHistory, substitution,
+                                replacements, coreOnly, leftRetrieval,
+                                stateStore);
   }
 
   void getStoredCoreExpressions(
@@ -334,8 +355,25 @@ public:
 
   ~TxDependency();
 
+  /// \brief Allocation from the free-list pool of TxDependency objects
+  static void *operator new(size_t size) {
+    return TxObjectPool<TxDependency>::allocate(size);
+  }
+
+  static void operator delete(void *object, size_t size) {
+    TxObjectPool<TxDependency>::deallocate(object, size);
+  }
+
   std::set<ref<TxStoreEntry> > &getMarkedGlobal() { return markedGlobal; }
 
+  /// \brief Register a new version of a value merged from its version of the
+  /// given expression and the version of the other expression in the
+  /// dependency of another state, such that both flow into it.
+  void mergeValue(llvm::Value *value,
+                  const std::vector<llvm::Instruction *> &callHistory,
+                  ref<Expr> mergedExpr, ref<Expr> expr,
+                  const TxDependency *other, ref<Expr> otherExpr);
+
   bool isEntryInParent(ref<TxStoreEntry> se) {
     if (!parent)
       return false;
@@ -350,9 +388,8 @@ public:
   TxDependency *cdr() const;
 
   /// \brief This retrieves the locations known at this state, and the
-  /// expressions stored in the locations. Returns as the last argument a pair
-  /// of the store part indexed by constants, and the store part indexed by
-  /// symbolic expressions.
+  /// expressions stored in the locations, as a read-only view of the store of
+  /// the parent.
   ///
   /// \param callHistory The current call history context of the state
   /// \param replacements The replacement bound variables when
@@ -365,36 +402,24 @@ public:
   /// \param leftRetrieval Whether the retrieval is requested by the left
   /// child of the store, otherwise, we assume it is requested by the right
   /// child of the store.
-  /// \param [out] concretelyAddressedStore The output concretely-addressed
-  /// store.
-  /// \param [out] symbolicallyAddressedStore The output
-  /// symbolically-addressed store.
-  /// \param [out] concretelyAddressedHistoricalStore The output
-  /// concretely-addressed historical store, whose domain consists of
-  /// historical concrete addresses that are no longer valid due to exiting of
-  /// scope.
-  /// \param [out] symbolicallyAddressedHistoricalStore The output
-  /// symbolically-addressed historical store, whose domain consists of
-  /// historical symbolic addresses that are no longer valid due to exiting of
-  /// scope.
+  /// \param [out] stateStore The output view of the internal store and of
+  /// the concretely- and symbolically-addressed historical stores, whose
+  /// domains consist of historical addresses that are no longer valid due to
+  /// exiting of scope.
   ///
   /// \sa TxStore#getStoredExpressions()
   void getParentStoredExpressions(
       const std::vector<llvm::Instruction *> &callHistory,
       const std::map<ref<Expr>, ref<Expr> > &substitution,
       std::set<const Array *> &replacements, bool coreOnly, bool &leftRetrieval,
-      TxStore::TopStateStore &__internalStore,
-      TxStore::LowerStateStore &__concretelyAddressedHistoricalStore,
-      TxStore::LowerStateStore &__symbolicallyAddressedHistoricalStore) {
+      TxStore::StateStoreView &stateStore) {
     if (parent->left == this)
       leftRetrieval = true;
     else
       assert(parent->right == this && "mismatched tree edge");
 
     parent->getStoredExpressions(store, callHistory, substitution, replacements,
-                                 coreOnly, leftRetrieval, __internalStore,
-                                 __concretelyAddressedHistoricalStore,
-                                 __symbolicallyAddressedHistoricalStore);
+                                 coreOnly, leftRetrieval, stateStore);
   }
 
   /// \brief This retrieves the locations known at this state, and the
@@ -497,25 +522,28 @@ public:
 
   /// \brief Given an LLVM value and the expression it is associated with,
   /// retrieve all the sources and mark them as in the core
-  void markAllValues(llvm::Value *value, ref<Expr> expr,
-                     const std::string &reason) {
+  void markAllValues(llvm::Value *value, ref<Expr> expr, unsigned reason) {
     ref<TxStateValue> stateValue = getLatestValueForMarking(value, expr);
     markAllValues(stateValue, reason);
   }
 
   /// \brief Given a state value, retrieve all its sources and mark them as in
   /// the core
-  void markAllValues(ref<TxStateValue> value, const std::string &reason);
+  void markAllValues(ref<TxStateValue> value, unsigned reason);
+
+  /// \brief Given a set of state values, retrieve all their sources and mark
+  /// them as in the core, in a single traversal of the store
+  void markAllValues(const std::set<ref<TxStateValue> > &values,
+                     unsigned reason);
 
-  void markGlobalVars(ref<TxStateValue> value, const std::string &reason);
+  void markGlobalVars(ref<TxStateValue> value, unsigned reason);
 
   void recursivelyMarkGlobalVars(ref<TxStoreEntry> se);
 
   /// \brief Given an LLVM value which is used as an address, retrieve all its
   /// sources and mark them as in the core. Returns true if bounds error was
   /// detected; false otherwise.
-  bool markAllPointerValues(ref<TxStateValue> value,
-                            const std::string &reason) {
+  bool markAllPointerValues(ref<TxStateValue> value, unsigned reason) {
     std::set<uint64_t> bounds;
     return markAllPointerValues(value, bounds, reason);
   }
@@ -524,7 +552,7 @@ public:
   /// sources and mark them as in the core. Returns true if bounds error was
   /// detected; false otherwise.
   bool markAllPointerValues(ref<TxStateValue> value, std::set<uint64_t> &bounds,
-                            const std::string &reason);
+                            unsigned reason);
 
   /// \brief Tests if bound interpolation shold be enabled
   static bool boundInterpolation(llvm::Value *val = 0);
@@ -564,6 +592,10 @@ public:
     pathCondition->unsatCoreInterpolation(unsatCore);
   }
 
+  /// \brief Move the path condition constraints used in the interpolant of
+  /// a removed node up to its parent.
+  void propagateUsedConstraints() { pathCondition->propagateUsed(); }
+
   /// \brief Interpolation for memory bound violation
   void memoryBoundViolationInterpolation(llvm::Instruction *inst,
                                          ref<Expr> address);
@@ -15,11 +15,51 @@
 //===----------------------------------------------------------------------===//
 
 #include "TxExprHelper.h"
+#include "klee/util/TxExprUtil.h"
+
+#include <algorithm>
 
 namespace klee {
 
 ref<Expr> TxExprHelper::CONST_REF = ConstantExpr::create(1, Expr::Int32);
 
+static const size_t MinLinearFormsThreshold = 1 << 12;
+
+ExprHashMap<TxLinearForm> TxExprHelper::linearForms;
+
+size_t TxExprHelper::linearFormsThreshold = MinLinearFormsThreshold;
+
+void TxLinearForm::add(const TxLinearForm &other, int mul) {
+  // Merge the sorted coefficients, keeping the variables whose coefficients
+  // cancel out, as the coefficient maps did
+  std::vector<std::pair<ref<Expr>, int> > merged;
+  merged.reserve(coeffs.size() + other.coeffs.size());
+  std::vector<std::pair<ref<Expr>, int> >::const_iterator
+      it1 = coeffs.begin(),
+      ie1 = coeffs.end(), it2 = other.coeffs.begin(),
+      ie2 = other.coeffs.end();
+  while (it1 != ie1 || it2 != ie2) {
+    if (it2 == ie2 || (it1 != ie1 && it1->first < it2->first)) {
+      merged.push_back(*it1);
+      ++it1;
+    } else if (it1 == ie1 || it2->first < it1->first) {
+      merged.push_back(std::make_pair(it2->first, it2->second * mul));
+      ++it2;
+    } else {
+      merged.push_back(
+          std::make_pair(it1->first, it1->second + it2->second * mul));
+      ++it1;
+      ++it2;
+    }
+  }
+  coeffs.swap(merged);
+
+  if (other.hasConstant) {
+    hasConstant = true;
+    constant = constant + other.constant * mul;
+  }
+}
+
 /**
  * Remove Not() at the beginning if possible
  */
@@ -111,12 +151,21 @@ ref<Expr> TxExprHelper::simplifyNot(ref<Expr> e) {
   return ret;
 }
 
-ref<Expr> TxExprHelper::simplifyLinear(ref<Expr> e) {
+namespace {
+
+/// \brief Combines the coefficients of the same variables in the linear
+/// conjuncts of an expression
+class TxLinearRewriter : public TxExprRewriter {
+protected:
+  ref<Expr> rewriteNode(const ref<Expr> &e);
+};
+
+ref<Expr> TxLinearRewriter::rewriteNode(const ref<Expr> &e) {
   switch (e->getKind()) {
   case Expr::And: {
     ref<Expr> kids[2];
-    kids[0] = simplifyLinear(e->getKid(0));
-    kids[1] = simplifyLinear(e->getKid(1));
+    kids[0] = rewrite(e->getKid(0));
+    kids[1] = rewrite(e->getKid(1));
     if (kids[0] == kids[1]) {
       return kids[0];
     }
@@ -136,102 +185,117 @@ ref<Expr> TxExprHelper::simplifyLinear(ref<Expr> e) {
     ref<Expr> left = e->getKid(0);
     ref<Expr> right = e->getKid(1);
 
-    bool b1 = extractCoeff(left, 1, ref2coeff);
+    bool b1 = TxExprHelper::extractCoeff(left, 1, ref2coeff);
     if (!b1)
       return e;
 
-    bool b2 = extractCoeff(right, -1, ref2coeff);
+    bool b2 = TxExprHelper::extractCoeff(right, -1, ref2coeff);
     if (!b2) {
       return e;
     }
 
-    llvm::outs() << "== begin simplifyLinear ==\n";
-    e->dump();
-    llvm::outs() << "---\n";
-    for (std::map<ref<Expr>, int>::iterator it = ref2coeff.begin(),
-                                            ie = ref2coeff.end();
-         it != ie; ++it) {
-      it->first->dump();
-      llvm::outs() << it->second << "\n";
-    }
-    llvm::outs() << "== end simplifyLinear ==\n";
-    return makeExpr(e, ref2coeff);
+    return TxExprHelper::makeExpr(e, ref2coeff);
   }
   default:
     return e;
   }
 }
+}
 
-/**
- * Create a map from var -> coeff
- * mul = 1 or -1
- * Return: true if input is linear, false otherwise
- */
-bool TxExprHelper::extractCoeff(ref<Expr> e, int mul,
-                                std::map<ref<Expr>, int> &ref2coeff) {
+ref<Expr> TxExprHelper::simplifyLinear(ref<Expr> e) {
+  TxLinearRewriter rewriter;
+  return rewriter.rewrite(e);
+}
 
-  //  llvm::outs() << "star extractCoeff\n";
-  //  e->dump();
-  //  llvm::outs() << "isaVar(e)=" << isaVar(e) << "\n";
-  //  llvm::outs() << "end extractCoeff\n";
-  if (e->getWidth() != Expr::Bool) {
-    return false;
-  }
-  if (isaVar(e)) {
-    ref2coeff[e] = ref2coeff[e] + mul;
-    return true;
-  } else {
+const TxLinearForm &TxExprHelper::getLinearForm(ref<Expr> e) {
+  ExprHashMap<TxLinearForm>::iterator it = linearForms.find(e);
+  if (it != linearForms.end())
+    return it->second;
 
+  TxLinearForm form;
+  if (e->getWidth() == Expr::Bool && isaVar(e)) {
+    form.linear = true;
+    form.coeffs.push_back(std::make_pair(e, 1));
+  } else if (e->getWidth() == Expr::Bool) {
     switch (e->getKind()) {
     case Expr::Constant: {
-      ref<ConstantExpr> coeff = dyn_cast<ConstantExpr>(e);
-      //      llvm::outs() << coeff->getWidth() << "\n";
-      ref2coeff[CONST_REF] = ref2coeff[CONST_REF] + coeff->getZExtValue() * mul;
-      return true;
+      form.linear = true;
+      form.hasConstant = true;
+      form.constant = dyn_cast<ConstantExpr>(e)->getZExtValue();
+      break;
     }
     case Expr::Mul: {
       ref<Expr> kids[2];
       kids[0] = e->getKid(0);
       kids[1] = e->getKid(1);
       if (isa<ConstantExpr>(kids[0]) && isaVar(kids[1])) {
-        ref<ConstantExpr> coeff = dyn_cast<ConstantExpr>(kids[0]);
-        ref2coeff[kids[1]] = ref2coeff[kids[1]] + coeff->getZExtValue() * mul;
-        return true;
+        form.linear = true;
+        form.coeffs.push_back(std::make_pair(
+            kids[1], (int)dyn_cast<ConstantExpr>(kids[0])->getZExtValue()));
       } else if (isa<ConstantExpr>(kids[1]) && isaVar(kids[0])) {
-        ref<ConstantExpr> coeff = dyn_cast<ConstantExpr>(kids[1]);
-        ref2coeff[kids[0]] = ref2coeff[kids[0]] + coeff->getZExtValue() * mul;
-        return true;
-      } else {
-        return false;
+        form.linear = true;
+        form.coeffs.push_back(std::make_pair(
+            kids[0], (int)dyn_cast<ConstantExpr>(kids[1])->getZExtValue()));
       }
+      break;
     }
-    case Expr::Add: {
-      ref<Expr> kids[2];
-      kids[0] = e->getKid(0);
-      kids[1] = e->getKid(1);
-      bool b1 = extractCoeff(kids[0], mul, ref2coeff);
-      if (!b1)
-        return false;
-      bool b2 = extractCoeff(kids[1], mul, ref2coeff);
-      if (!b2)
-        return false;
-      return true;
-    }
+    case Expr::Add:
     case Expr::Sub: {
-      ref<Expr> kids[2];
-      kids[0] = e->getKid(0);
-      kids[1] = e->getKid(1);
-      bool b1 = extractCoeff(kids[0], mul, ref2coeff);
-      if (!b1)
-        return false;
-      bool b2 = extractCoeff(kids[1], -mul, ref2coeff);
-      if (!b2)
-        return false;
-      return true;
+      const TxLinearForm &left = getLinearForm(e->getKid(0));
+      if (!left.linear)
+        break;
+      const TxLinearForm &right = getLinearForm(e->getKid(1));
+      if (!right.linear)
+        break;
+      form.linear = true;
+      form.add(left, 1);
+      form.add(right, e->getKind() == Expr::Add ? 1 : -1);
+      break;
     }
-    default: { return false; }
+    default:
+      break;
     }
   }
+
+  TxLinearForm &cached = linearForms[e];
+  cached = form;
+  return cached;
+}
+
+/**
+ * Create a map from var -> coeff
+ * mul = 1 or -1
+ * Return: true if input is linear, false otherwise
+ */
+bool TxExprHelper::extractCoeff(ref<Expr> e, int mul,
+                                std::map<ref<Expr>, int> &ref2coeff) {
+  if (linearForms.size() >= linearFormsThreshold) {
+    // Releasing a form may leave the forms of its kids only referenced by
+    // the cache; those are released by the next collection.
+    for (ExprHashMap<TxLinearForm>::iterator it = linearForms.begin();
+         it != linearForms.end();) {
+      if (it->first->refCount == 1)
+        it = linearForms.erase(it);
+      else
+        ++it;
+    }
+    linearFormsThreshold =
+        std::max(MinLinearFormsThreshold, 2 * linearForms.size());
+  }
+
+  const TxLinearForm &form = getLinearForm(e);
+  if (!form.linear)
+    return false;
+
+  for (std::vector<std::pair<ref<Expr>, int> >::const_iterator
+           it = form.coeffs.begin(),
+           ie = form.coeffs.end();
+       it != ie; ++it) {
+    ref2coeff[it->first] = ref2coeff[it->first] + it->second * mul;
+  }
+  if (form.hasConstant)
+    ref2coeff[CONST_REF] = ref2coeff[CONST_REF] + form.constant * mul;
+  return true;
 }
 
 ref<Expr> TxExprHelper::makeExpr(ref<Expr> e,
@@ -341,6 +405,9 @@ ref<Expr> TxExprHelper::rangSimplify(ref<Expr> e) {
   return TxPartitionHelper::createAnd(es);
 }
 
+/// \brief The expressions of each variable, in the order of the variables
+typedef std::map<TxPartitionHelper::Var, std::vector<ref<Expr> > > VarExprsMap;
+
 /**
  * Simplify multiple expressions on range
  */
@@ -349,11 +416,11 @@ TxExprHelper::rangeSimplifyFromExprs(std::vector<ref<Expr> > exprs) {
   std::vector<ref<Expr> > ret;
 
   // combine expressions sharing 1 variable into 1 entry, others are kept in ret
-  std::map<std::string, std::vector<ref<Expr> > > var2refs;
+  VarExprsMap var2refs;
   for (std::vector<ref<Expr> >::const_iterator it = exprs.begin(),
                                                ie = exprs.end();
        it != ie; ++it) {
-    std::set<std::string> vars = TxPartitionHelper::getExprVars(*it);
+    TxPartitionHelper::VarSet vars = TxPartitionHelper::getExprVars(*it);
     if (vars.size() == 1) {
       var2refs[*vars.begin()].push_back(*it);
     } else {
@@ -362,9 +429,8 @@ TxExprHelper::rangeSimplifyFromExprs(std::vector<ref<Expr> > exprs) {
   }
 
   // simplify vector of expressions in each entry
-  for (std::map<std::string, std::vector<ref<Expr> > >::const_iterator
-           mapIt = var2refs.begin(),
-           mapIe = var2refs.end();
+  for (VarExprsMap::const_iterator mapIt = var2refs.begin(),
+                                   mapIe = var2refs.end();
        mapIt != mapIe; ++mapIt) {
     if (mapIt->second.size() > 1) {
       std::vector<ref<Expr> > sv = combineSharedSingleVarExprs(mapIt->second);
@@ -382,11 +448,11 @@ TxExprHelper::rangeSimplifyFromExprs(std::set<ref<Expr> > exprs) {
   std::vector<ref<Expr> > ret;
 
   // combine expressions sharing 1 variable into 1 entry, others are kept in ret
-  std::map<std::string, std::vector<ref<Expr> > > var2refs;
+  VarExprsMap var2refs;
   for (std::set<ref<Expr> >::const_iterator it = exprs.begin(),
                                             ie = exprs.end();
        it != ie; ++it) {
-    std::set<std::string> vars = TxPartitionHelper::getExprVars(*it);
+    TxPartitionHelper::VarSet vars = TxPartitionHelper::getExprVars(*it);
     if (vars.size() == 1) {
       var2refs[*vars.begin()].push_back(*it);
     } else {
@@ -395,9 +461,8 @@ TxExprHelper::rangeSimplifyFromExprs(std::set<ref<Expr> > exprs) {
   }
 
   // simplify vector of expressions in each entry
-  for (std::map<std::string, std::vector<ref<Expr> > >::const_iterator
-           mapIt = var2refs.begin(),
-           mapIe = var2refs.end();
+  for (VarExprsMap::const_iterator mapIt = var2refs.begin(),
+                                   mapIe = var2refs.end();
        mapIt != mapIe; ++mapIt) {
     if (mapIt->second.size() > 1) {
       std::vector<ref<Expr> > sv = combineSharedSingleVarExprs(mapIt->second);
@@ -19,11 +19,13 @@
 
 #include "TxPartitionHelper.h"
 #include "TxWPHelper.h"
+#include "klee/util/ExprHashMap.h"
 #include <iostream>
 #include <limits>
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace klee {
 class Bound {
@@ -38,10 +40,46 @@ public:
   }
 };
 
+/// \brief The decomposition of an expression into a linear combination of
+/// variables with integer coefficients and a constant term
+class TxLinearForm {
+public:
+  /// \brief Whether the expression is linear
+  bool linear;
+
+  /// \brief The coefficients of the variables, sorted by variable
+  std::vector<std::pair<ref<Expr>, int> > coeffs;
+
+  /// \brief Whether the expression has a constant term
+  bool hasConstant;
+
+  /// \brief The constant term
+  int constant;
+
+  TxLinearForm() : linear(false), hasConstant(false), constant(0) {}
+
+  /// \brief Add another linear form multiplied by mul (1 or -1) to this one
+  void add(const TxLinearForm &other, int mul);
+};
+
 class TxExprHelper {
 private:
   static ref<Expr> CONST_REF;
 
+  /// \brief The linear forms of the expressions decomposed so far, as the
+  /// same expressions recur in the interpolants and weakest preconditions.
+  /// The cache keeps its expressions alive; those no longer used outside of
+  /// the cache are released whenever the cache has doubled in size since the
+  /// last collection.
+  static ExprHashMap<TxLinearForm> linearForms;
+
+  /// \brief The cache size that triggers the next collection
+  static size_t linearFormsThreshold;
+
+  /// \brief Return the linear form of an expression, computing it only when
+  /// it is not in TxExprHelper#linearForms
+  static const TxLinearForm &getLinearForm(ref<Expr> e);
+
 public:
   //  TxExprHelper();
   //  virtual ~TxExprHelper();
@@ -0,0 +1,404 @@
+//===--- TxMemoryCensus.cpp - Interpolation memory census -------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementation of the census of the memory used by
+/// the interpolation tree and the subsumption table.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TxMemoryCensus.h"
+
+#include "TxDependency.h"
+#include "TxPathCondition.h"
+#include "TxStore.h"
+#include "TxTree.h"
+#include "TxWP.h"
+
+#include "klee/CommandLine.h"
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Module/KModule.h"
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#else
+#include "llvm/Function.h"
+#include "llvm/Instruction.h"
+#endif
+
+#include "llvm/Support/CommandLine.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+llvm::cl::opt<double> TxMemoryCensusInterval(
+    "tx-memory-census-interval",
+    llvm::cl::desc("The number of seconds between the censuses of the memory "
+                   "of the interpolation tree and the subsumption table, "
+                   "written to txmemoryNNNNNNNN.csv, with their peaks in "
+                   "run.stats (default=0 (off))"),
+    llvm::cl::init(0));
+
+/// \brief The overhead of a node of std::map and std::set: its color and its
+/// parent and child pointers
+const uint64_t TreeNodeOverhead = 4 * sizeof(void *);
+
+/// \brief The overhead of a node of an unordered map: its next pointer and
+/// its cached hash
+const uint64_t HashNodeOverhead = 2 * sizeof(void *);
+
+uint64_t getExprNodeBytes(const Expr *expr) {
+  switch (expr->getKind()) {
+  case Expr::Constant:
+    return sizeof(ConstantExpr);
+  case Expr::NotOptimized:
+    return sizeof(NotOptimizedExpr);
+  case Expr::Read:
+    return sizeof(ReadExpr);
+  case Expr::Select:
+    return sizeof(SelectExpr);
+  case Expr::Concat:
+    return sizeof(ConcatExpr);
+  case Expr::Extract:
+    return sizeof(ExtractExpr);
+  case Expr::Not:
+    return sizeof(NotExpr);
+  case Expr::ZExt:
+  case Expr::SExt:
+    return sizeof(CastExpr);
+  default:
+    return sizeof(BinaryExpr);
+  }
+}
+}
+
+const char *const TxMemoryCensus::componentNames[ComponentCount] = {
+  "values", "store", "path_condition", "wp", "phi", "table"
+};
+
+uint64_t TxMemoryCensus::peak[ComponentCount] = {};
+
+double TxMemoryCensus::getInterval() {
+  return INTERPOLATION_ENABLED ? TxMemoryCensusInterval.getValue() : 0;
+}
+
+uint64_t TxMemoryCensus::Usage::getTotal() const {
+  uint64_t sum = 0;
+  for (unsigned i = 0; i < ComponentCount; ++i)
+    sum += bytes[i];
+  return sum;
+}
+
+void TxMemoryCensus::add(uintptr_t programPoint, Component component,
+                         uint64_t bytes) {
+  if (!bytes)
+    return;
+  total.bytes[component] += bytes;
+  programPoints[programPoint].bytes[component] += bytes;
+
+  const llvm::Function *function =
+      programPoint ? reinterpret_cast<llvm::Instruction *>(programPoint)
+                         ->getParent()
+                         ->getParent()
+                   : 0;
+  functions[function].bytes[component] += bytes;
+}
+
+uint64_t TxMemoryCensus::getExprBytes(ref<Expr> expr) {
+  if (expr.isNull())
+    return 0;
+
+  uint64_t bytes = 0;
+  std::vector<const Expr *> worklist(1, expr.get());
+  while (!worklist.empty()) {
+    const Expr *e = worklist.back();
+    worklist.pop_back();
+    if (!firstVisit(e))
+      continue;
+    bytes += getExprNodeBytes(e);
+    for (unsigned i = 0, n = e->getNumKids(); i < n; ++i)
+      worklist.push_back(e->getKid(i).get());
+
+    // The updates of a read are shared by the reads of the same array
+    if (const ReadExpr *re = llvm::dyn_cast<ReadExpr>(e)) {
+      for (const UpdateNode *un = re->updates.head; un && firstVisit(un);
+           un = un->next) {
+        bytes += sizeof(UpdateNode);
+        worklist.push_back(un->index.get());
+        worklist.push_back(un->value.get());
+      }
+    }
+  }
+  return bytes;
+}
+
+uint64_t TxMemoryCensus::getStoreBytes(const TxStore *store) {
+  uint64_t bytes = sizeof(TxStore);
+
+  std::vector<const TxStore::LowerStateStore *> lowerStores;
+  lowerStores.push_back(&store->concretelyAddressedHistoricalStore);
+  lowerStores.push_back(&store->symbolicallyAddressedHistoricalStore);
+  for (TxStore::TopStateStore::const_iterator
+           it = store->internalStore.begin(),
+           ie = store->internalStore.end();
+       it != ie; ++it) {
+    bytes += TreeNodeOverhead + sizeof(*it);
+    for (TxStore::LowerStateStore::const_iterator
+             lit = it->second.concreteBegin(),
+             lie = it->second.concreteEnd();
+         lit != lie; ++lit)
+      bytes += TreeNodeOverhead + sizeof(*lit);
+    for (TxStore::LowerStateStore::const_iterator
+             lit = it->second.symbolicBegin(),
+             lie = it->second.symbolicEnd();
+         lit != lie; ++lit)
+      bytes += TreeNodeOverhead + sizeof(*lit);
+  }
+  for (std::vector<const TxStore::LowerStateStore *>::iterator
+           it = lowerStores.begin(),
+           ie = lowerStores.end();
+       it != ie; ++it) {
+    for (TxStore::LowerStateStore::const_iterator lit = (*it)->begin(),
+                                                  lie = (*it)->end();
+         lit != lie; ++lit) {
+      bytes += TreeNodeOverhead + sizeof(*lit);
+      TxStoreEntry *entry = lit->second.get();
+      if (!firstVisit(entry))
+        continue;
+      bytes += sizeof(TxStoreEntry) +
+               (entry->getAllowBoundEntryList().size() +
+                entry->getDisableBoundEntryList().size()) *
+                   (TreeNodeOverhead +
+                    sizeof(std::pair<ref<TxStoreEntry>, bool>));
+      ref<TxStateValue> content = entry->getContent();
+      if (!content.isNull() && firstVisit(content.get()))
+        bytes += sizeof(TxStateValue) + getExprBytes(content->getExpression());
+    }
+  }
+
+  bytes += (store->usedHere.size() + store->usedBelow.size()) *
+           (TreeNodeOverhead + sizeof(ref<TxStoreEntry>));
+  return bytes;
+}
+
+void TxMemoryCensus::addNode(TxTreeNode *node) {
+  uintptr_t programPoint = node->programPoint;
+  TxDependency *dependency = node->dependency;
+
+  // The versioned values
+  uint64_t bytes = sizeof(TxTreeNode) + sizeof(TxDependency) +
+                   dependency->ancestorIndex.getMemorySize();
+  for (std::map<llvm::Value *, std::vector<ref<TxStateValue> > >::iterator
+           it = dependency->valuesMap.begin(),
+           ie = dependency->valuesMap.end();
+       it != ie; ++it) {
+    bytes += TreeNodeOverhead + sizeof(*it) +
+             it->second.capacity() * sizeof(ref<TxStateValue>);
+    for (std::vector<ref<TxStateValue> >::iterator
+             vit = it->second.begin(),
+             vie = it->second.end();
+         vit != vie; ++vit) {
+      if (firstVisit(vit->get()))
+        bytes += sizeof(TxStateValue) + getExprBytes((*vit)->getExpression());
+    }
+  }
+  add(programPoint, Values, bytes);
+
+  add(programPoint, Store, getStoreBytes(dependency->store));
+
+  // The constraints of this depth only, those of the ancestors being counted
+  // with the ancestors
+  TxPathCondition *pathCondition = dependency->pathCondition;
+  bytes = sizeof(TxPathCondition) +
+          pathCondition->constraints.bucket_count() * sizeof(void *) +
+          pathCondition->used.size() *
+              (TreeNodeOverhead + sizeof(ref<TxPCConstraint>));
+  for (ExprHashMap<ref<TxPCConstraint> >::iterator
+           it = pathCondition->constraints.begin(),
+           ie = pathCondition->constraints.end();
+       it != ie; ++it) {
+    bytes += HashNodeOverhead + sizeof(*it) + getExprBytes(it->first);
+    TxPCConstraint *constraint = it->second.get();
+    if (firstVisit(constraint))
+      bytes += sizeof(TxPCConstraint) +
+               getExprBytes(constraint->constraint) +
+               getExprBytes(constraint->shadowConstraint) +
+               constraint->boundVariables.size() *
+                   (TreeNodeOverhead + sizeof(const Array *));
+  }
+  add(programPoint, PathCondition, bytes);
+
+  bytes = getExprBytes(node->childWPInterpolant[0]) +
+          getExprBytes(node->childWPInterpolant[1]);
+  if (node->wp)
+    bytes += sizeof(TxWeakestPreCondition) +
+             getExprBytes(node->wp->getWPExpr()) +
+             node->wp->markedVariables.size() *
+                 (TreeNodeOverhead + sizeof(llvm::Value *));
+  add(programPoint, WeakestPrecondition, bytes);
+
+  bytes = 0;
+  for (std::map<llvm::Value *, std::vector<ref<Expr> > >::iterator
+           it = node->phiValues.begin(),
+           ie = node->phiValues.end();
+       it != ie; ++it) {
+    bytes += TreeNodeOverhead + sizeof(*it) +
+             it->second.capacity() * sizeof(ref<Expr>);
+    for (std::vector<ref<Expr> >::iterator vit = it->second.begin(),
+                                           vie = it->second.end();
+         vit != vie; ++vit)
+      bytes += getExprBytes(*vit);
+  }
+  add(programPoint, PhiValues, bytes);
+}
+
+void TxMemoryCensus::addEntry(uintptr_t programPoint,
+                              TxSubsumptionTableEntry *entry) {
+  uint64_t bytes = sizeof(TxSubsumptionTableEntry) +
+                   getExprBytes(entry->interpolant) +
+                   getExprBytes(entry->wpInterpolant);
+
+  std::vector<const TxStore::LowerInterpolantStore *> lowerStores;
+  lowerStores.push_back(&entry->concretelyAddressedHistoricalStore);
+  lowerStores.push_back(&entry->symbolicallyAddressedHistoricalStore);
+  const TxStore::TopInterpolantStore *topStores[] = {
+    &entry->concretelyAddressedStore, &entry->symbolicallyAddressedStore
+  };
+  for (unsigned i = 0; i < 2; ++i) {
+    for (TxStore::TopInterpolantStore::const_iterator
+             it = topStores[i]->begin(),
+             ie = topStores[i]->end();
+         it != ie; ++it) {
+      bytes += TreeNodeOverhead + sizeof(*it);
+      lowerStores.push_back(&it->second);
+    }
+  }
+  for (std::vector<const TxStore::LowerInterpolantStore *>::iterator
+           it = lowerStores.begin(),
+           ie = lowerStores.end();
+       it != ie; ++it) {
+    for (TxStore::LowerInterpolantStore::const_iterator lit = (*it)->begin(),
+                                                        lie = (*it)->end();
+         lit != lie; ++lit) {
+      bytes += TreeNodeOverhead + sizeof(*lit);
+      if (!lit->second.isNull() && firstVisit(lit->second.get()))
+        bytes += sizeof(TxInterpolantValue) +
+                 getExprBytes(lit->second->getExpression());
+    }
+  }
+
+  bytes += (entry->markedGlobal.size() + entry->existentials.size()) *
+           (TreeNodeOverhead + sizeof(void *));
+  for (std::map<ref<Expr>, ref<Expr> >::iterator
+           it = entry->storeSubstitution.begin(),
+           ie = entry->storeSubstitution.end();
+       it != ie; ++it)
+    bytes += TreeNodeOverhead + sizeof(*it) + getExprBytes(it->first) +
+             getExprBytes(it->second);
+  for (std::map<llvm::Value *, std::vector<ref<Expr> > >::iterator
+           it = entry->phiValues.begin(),
+           ie = entry->phiValues.end();
+       it != ie; ++it) {
+    bytes += TreeNodeOverhead + sizeof(*it) +
+             it->second.capacity() * sizeof(ref<Expr>);
+    for (std::vector<ref<Expr> >::iterator vit = it->second.begin(),
+                                           vie = it->second.end();
+         vit != vie; ++vit)
+      bytes += getExprBytes(*vit);
+  }
+  add(programPoint, Table, bytes);
+}
+
+void TxMemoryCensus::addTree(TxTree *tree) {
+  std::vector<TxTreeNode *> worklist;
+  if (tree->root)
+    worklist.push_back(tree->root);
+  for (std::deque<TxTree::PendingNode>::iterator
+           it = TxTree::pendingNodes.begin(),
+           ie = TxTree::pendingNodes.end();
+       it != ie; ++it)
+    worklist.push_back(it->node);
+
+  std::set<TxTreeNode *> visited;
+  while (!worklist.empty()) {
+    TxTreeNode *node = worklist.back();
+    worklist.pop_back();
+    if (!visited.insert(node).second)
+      continue;
+    addNode(node);
+    if (node->left)
+      worklist.push_back(node->left);
+    if (node->right)
+      worklist.push_back(node->right);
+  }
+}
+
+void TxMemoryCensus::addTable() {
+  for (TxSubsumptionTable::TableMap::iterator
+           it = TxSubsumptionTable::instance.begin(),
+           ie = TxSubsumptionTable::instance.end();
+       it != ie; ++it) {
+    std::vector<TxSubsumptionTableEntry *> entries;
+    it->second->getEntries(entries);
+    for (std::vector<TxSubsumptionTableEntry *>::iterator
+             eit = entries.begin(),
+             eie = entries.end();
+         eit != eie; ++eit)
+      addEntry(it->first, *eit);
+  }
+}
+
+void TxMemoryCensus::updatePeaks() const {
+  for (unsigned i = 0; i < ComponentCount; ++i)
+    if (total.bytes[i] > peak[i])
+      peak[i] = total.bytes[i];
+}
+
+void TxMemoryCensus::print(llvm::raw_ostream &stream,
+                           KModule *kmodule) const {
+  stream << "scope,function,file,line,assembly_line";
+  for (unsigned i = 0; i < ComponentCount; ++i)
+    stream << "," << componentNames[i];
+  stream << ",total\n";
+
+  stream << "total,,,,";
+  for (unsigned i = 0; i < ComponentCount; ++i)
+    stream << "," << total.bytes[i];
+  stream << "," << total.getTotal() << "\n";
+
+  for (std::map<const llvm::Function *, Usage>::const_iterator
+           it = functions.begin(),
+           ie = functions.end();
+       it != ie; ++it) {
+    stream << "function," << (it->first ? it->first->getName() : "") << ",,,";
+    for (unsigned i = 0; i < ComponentCount; ++i)
+      stream << "," << it->second.bytes[i];
+    stream << "," << it->second.getTotal() << "\n";
+  }
+
+  for (std::map<uintptr_t, Usage>::const_iterator it = programPoints.begin(),
+                                                  ie = programPoints.end();
+       it != ie; ++it) {
+    if (it->first) {
+      llvm::Instruction *inst =
+          reinterpret_cast<llvm::Instruction *>(it->first);
+      const InstructionInfo &info = kmodule->infos->getInfo(inst);
+      stream << "point," << inst->getParent()->getParent()->getName() << ","
+             << info.file << "," << info.line << "," << info.assemblyLine;
+    } else {
+      stream << "point,,,,";
+    }
+    for (unsigned i = 0; i < ComponentCount; ++i)
+      stream << "," << it->second.bytes[i];
+    stream << "," << it->second.getTotal() << "\n";
+  }
+}
@@ -0,0 +1,122 @@
+//===--- TxMemoryCensus.h - Interpolation memory census ---------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the declarations of the census of the memory used by
+/// the interpolation tree and the subsumption table.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_TXMEMORYCENSUS_H
+#define KLEE_TXMEMORYCENSUS_H
+
+#include "klee/Expr.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <set>
+#include <stdint.h>
+
+namespace llvm {
+class Function;
+}
+
+namespace klee {
+class KModule;
+class TxStore;
+class TxSubsumptionTableEntry;
+class TxTree;
+class TxTreeNode;
+
+/// \brief The bytes used by the interpolation data, by component, by program
+/// point and by function.
+///
+/// The census walks the nodes of the interpolation tree, including the
+/// removed nodes whose weakest precondition is pending, and the entries of
+/// the subsumption table. The sizes are estimates: the sizes of the objects,
+/// with those of the nodes of the containers holding them. The objects
+/// shared by reference counting, such as the expressions and the versioned
+/// values, are counted once, in the first component reaching them.
+class TxMemoryCensus {
+public:
+  enum Component {
+    Values,
+    Store,
+    PathCondition,
+    WeakestPrecondition,
+    PhiValues,
+    Table,
+    ComponentCount
+  };
+
+  static const char *const componentNames[ComponentCount];
+
+  /// \brief The peak usage of each component over the censuses taken
+  static uint64_t peak[ComponentCount];
+
+  /// \brief The number of seconds between the periodic censuses, or 0 when
+  /// none is taken, run.stats then having no columns of the peaks
+  static double getInterval();
+
+private:
+  struct Usage {
+    uint64_t bytes[ComponentCount];
+
+    Usage() {
+      for (unsigned i = 0; i < ComponentCount; ++i)
+        bytes[i] = 0;
+    }
+
+    uint64_t getTotal() const;
+  };
+
+  Usage total;
+
+  std::map<uintptr_t, Usage> programPoints;
+
+  std::map<const llvm::Function *, Usage> functions;
+
+  /// \brief The shared objects already counted
+  std::set<const void *> counted;
+
+  bool firstVisit(const void *object) { return counted.insert(object).second; }
+
+  void add(uintptr_t programPoint, Component component, uint64_t bytes);
+
+  /// \brief The bytes of the nodes of the expression not yet counted
+  uint64_t getExprBytes(ref<Expr> expr);
+
+  uint64_t getStoreBytes(const TxStore *store);
+
+  void addNode(TxTreeNode *node);
+
+  void addEntry(uintptr_t programPoint, TxSubsumptionTableEntry *entry);
+
+public:
+  /// \brief Count the nodes of the tree, from its root
+  void addTree(TxTree *tree);
+
+  /// \brief Count the entries of the subsumption table
+  void addTable();
+
+  uint64_t getTotal(Component component) const {
+    return total.bytes[component];
+  }
+
+  /// \brief Raise the peaks to the usage of this census
+  void updatePeaks() const;
+
+  /// \brief Print the census as CSV: the totals, then a line per function
+  /// and a line per program point.
+  void print(llvm::raw_ostream &stream, KModule *kmodule) const;
+};
+}
+
+#endif
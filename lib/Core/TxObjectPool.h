@@ -0,0 +1,103 @@
+//===--- TxObjectPool.h - Free-list allocator for Tracer-X ------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the declaration of the object pool used to allocate the
+/// short-lived per-node objects of the Tracer-X tree.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_TXOBJECTPOOL_H
+#define KLEE_TXOBJECTPOOL_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace klee {
+
+/// \brief A free-list allocator for objects of the single type T.
+///
+/// The Tracer-X tree allocates and frees millions of TxTreeNode,
+/// TxDependency, TxStore and TxWeakestPreCondition objects during symbolic
+/// execution. Allocating them from chunks of equally-sized slots, and reusing
+/// the slots of freed objects, avoids heap fragmentation and reduces the cost
+/// of memory allocation on the fork path. The MemoryObject metadata of the
+/// allocations of the program is pooled in the same way.
+///
+/// A class uses the pool by defining its class-specific operator new and
+/// operator delete as calls to TxObjectPool::allocate and
+/// TxObjectPool::deallocate. Allocation of objects of derived classes of
+/// other sizes falls back to the global operators. The chunks are never
+/// returned to the system, as objects may still be freed during static
+/// destruction.
+template <class T, unsigned SlotsPerChunk = 256> class TxObjectPool {
+  struct FreeSlot {
+    FreeSlot *next;
+  };
+
+  /// \brief The size of a slot, a multiple of twice the pointer size to keep
+  /// the alignment of the global operator new
+  static const size_t slotSize =
+      ((sizeof(T) > sizeof(FreeSlot) ? sizeof(T) : sizeof(FreeSlot)) +
+       2 * sizeof(void *) - 1) &
+      ~(2 * sizeof(void *) - 1);
+
+  FreeSlot *freeList;
+
+  std::vector<char *> chunks;
+
+  TxObjectPool() : freeList(0) {}
+
+  static TxObjectPool &getInstance() {
+    static TxObjectPool *pool = new TxObjectPool();
+    return *pool;
+  }
+
+  void grow() {
+    char *chunk = static_cast<char *>(::operator new(slotSize * SlotsPerChunk));
+    chunks.push_back(chunk);
+    for (unsigned i = SlotsPerChunk; i > 0; --i) {
+      FreeSlot *slot = reinterpret_cast<FreeSlot *>(chunk + (i - 1) * slotSize);
+      slot->next = freeList;
+      freeList = slot;
+    }
+  }
+
+public:
+  static void *allocate(size_t size) {
+    if (size != sizeof(T))
+      return ::operator new(size);
+
+    TxObjectPool &pool = getInstance();
+    if (!pool.freeList)
+      pool.grow();
+    FreeSlot *slot = pool.freeList;
+    pool.freeList = slot->next;
+    return slot;
+  }
+
+  static void deallocate(void *object, size_t size) {
+    if (!object)
+      return;
+
+    if (size != sizeof(T)) {
+      ::operator delete(object);
+      return;
+    }
+
+    TxObjectPool &pool = getInstance();
+    FreeSlot *slot = static_cast<FreeSlot *>(object);
+    slot->next = pool.freeList;
+    pool.freeList = slot;
+  }
+};
+}
+
+#endif /* KLEE_TXOBJECTPOOL_H */
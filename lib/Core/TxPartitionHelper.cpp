@@ -14,6 +14,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "TxPartitionHelper.h"
+#include "klee/util/TxExprUtil.h"
 
 using namespace klee;
 
@@ -36,33 +37,63 @@ std::vector<ref<Expr> > TxPartitionHelper::getExprsFromAndExpr(ref<Expr> e) {
   return ret;
 }
 
-std::set<std::string> TxPartitionHelper::getExprVars(ref<Expr> expr) {
-  std::set<std::string> vars;
+llvm::DenseMap<const llvm::Value *, TxPartitionHelper::Var>
+TxPartitionHelper::addressVars;
+
+TxPartitionHelper::Var
+TxPartitionHelper::getAddressVar(const llvm::Value *address) {
+  llvm::DenseMap<const llvm::Value *, Var>::iterator it =
+      addressVars.find(address);
+  if (it != addressVars.end())
+    return it->second;
+  Var var = (UINT64_C(1) << 32) + addressVars.size();
+  addressVars[address] = var;
+  return var;
+}
+
+TxPartitionHelper::VarSet TxPartitionHelper::getExprVars(ref<Expr> expr) {
+  VarSet vars;
+  getExprVars(expr, vars);
+  return vars;
+}
+
+namespace {
+
+/// \brief Collects the names of the variables of an expression
+class TxExprVarsFolder : public TxExprFolder {
+  TxPartitionHelper::VarSet &vars;
+
+protected:
+  bool foldNode(const ref<Expr> &expr);
 
+public:
+  TxExprVarsFolder(TxPartitionHelper::VarSet &_vars) : vars(_vars) {}
+};
+
+bool TxExprVarsFolder::foldNode(const ref<Expr> &expr) {
   switch (expr->getKind()) {
   case Expr::InvalidKind:
   case Expr::Constant: {
-    return vars;
+    return true;
   }
 
   case Expr::WPVar: {
     ref<WPVarExpr> WPVar = dyn_cast<WPVarExpr>(expr);
-    vars.insert(WPVar->address->getName());
-    return vars;
+    vars.insert(TxPartitionHelper::getAddressVar(WPVar->address));
+    return true;
   }
 
   case Expr::Read: {
     ref<ReadExpr> readExpr = dyn_cast<ReadExpr>(expr);
-    vars.insert(readExpr->getName());
-    return vars;
+    vars.insert(TxPartitionHelper::getArrayVar(readExpr->updates.root));
+    return true;
   }
 
   case Expr::Concat: {
     ref<ConcatExpr> concatExpr = dyn_cast<ConcatExpr>(expr);
-    std::set<std::string> vars1 = getExprVars(concatExpr->getLeft());
-    std::set<std::string> vars2 = getExprVars(concatExpr->getRight());
-    vars1.insert(vars2.begin(), vars2.end());
-    return vars1;
+    fold(concatExpr->getLeft());
+    fold(concatExpr->getRight());
+    return true;
   }
 
   case Expr::NotOptimized:
@@ -70,7 +101,8 @@ std::set<std::string> TxPartitionHelper::getExprVars(ref<Expr> expr) {
   case Expr::Extract:
   case Expr::ZExt:
   case Expr::SExt: {
-    return getExprVars(expr->getKid(0));
+    fold(expr->getKid(0));
+    return true;
   }
 
   case Expr::Eq:
@@ -96,53 +128,28 @@ std::set<std::string> TxPartitionHelper::getExprVars(ref<Expr> expr) {
   case Expr::Xor:
   case Expr::Shl:
   case Expr::LShr:
-  case Expr::AShr: {
-    ref<Expr> kids[2];
-    kids[0] = expr->getKid(0);
-    kids[1] = expr->getKid(1);
-    std::set<std::string> left = getExprVars(kids[0]);
-    std::set<std::string> right = getExprVars(kids[1]);
-    left.insert(right.begin(), right.end());
-    return left;
+  case Expr::AShr:
+  case Expr::Sel: {
+    fold(expr->getKid(0));
+    fold(expr->getKid(1));
+    return true;
   }
 
   case Expr::Select: {
-    std::set<std::string> vars1;
-    ref<Expr> kids[2];
-    kids[0] = expr->getKid(0);
-    if (kids[0]->getKind() != Expr::WPVar) {
-      vars1 = getExprVars(kids[0]);
+    if (expr->getKid(0)->getKind() != Expr::WPVar) {
+      fold(expr->getKid(0));
     }
-    kids[1] = expr->getKid(1);
-    std::set<std::string> vars2 = getExprVars(kids[1]);
-    vars1.insert(vars2.begin(), vars2.end());
-    return vars1;
+    fold(expr->getKid(1));
+    return true;
   }
 
   case Expr::Upd: {
-    std::set<std::string> vars1;
-    ref<Expr> kids[3];
-    kids[0] = expr->getKid(0);
-    if (kids[0]->getKind() != Expr::WPVar) {
-      vars1 = getExprVars(kids[0]);
+    if (expr->getKid(0)->getKind() != Expr::WPVar) {
+      fold(expr->getKid(0));
     }
-
-    kids[1] = expr->getKid(1);
-    std::set<std::string> vars2 = getExprVars(kids[1]);
-    vars1.insert(vars2.begin(), vars2.end());
-    kids[2] = expr->getKid(2);
-    std::set<std::string> vars3 = getExprVars(kids[2]);
-    vars1.insert(vars3.begin(), vars3.end());
-    return vars1;
-  }
-  case Expr::Sel: {
-    ref<Expr> kids[2];
-    kids[0] = expr->getKid(0);
-    kids[1] = expr->getKid(1);
-    std::set<std::string> vars1 = getExprVars(kids[0]);
-    std::set<std::string> vars2 = getExprVars(kids[1]);
-    vars1.insert(vars2.begin(), vars2.end());
-    return vars1;
+    fold(expr->getKid(1));
+    fold(expr->getKid(2));
+    return true;
   }
   default: {
     // Sanity check
@@ -151,48 +158,37 @@ std::set<std::string> TxPartitionHelper::getExprVars(ref<Expr> expr) {
                "TxPartitionHelper::getExprVars!");
   }
   }
+}
+}
 
-  return vars;
+void TxPartitionHelper::getExprVars(ref<Expr> expr, VarSet &vars) {
+  TxExprVarsFolder folder(vars);
+  folder.fold(expr);
 }
 
-bool TxPartitionHelper::isShared(std::set<std::string> ss1,
-                                 std::set<std::string> ss2) {
-  for (std::set<std::string>::const_iterator it1 = ss1.begin(), ie1 = ss1.end();
-       it1 != ie1; ++it1) {
-    for (std::set<std::string>::const_iterator it2 = ss2.begin(),
-                                               ie2 = ss2.end();
-         it2 != ie2; ++it2) {
-      if ((*it2).compare(*it1) == 0) {
-        return true;
-      }
-    }
+bool TxPartitionHelper::isShared(const VarSet &ss1, const VarSet &ss2) {
+  for (VarSet::const_iterator it1 = ss1.begin(), ie1 = ss1.end(); it1 != ie1;
+       ++it1) {
+    if (ss2.count(*it1))
+      return true;
   }
   return false;
 }
 
-bool TxPartitionHelper::isSubset(std::set<std::string> ss1,
-                                 std::set<std::string> ss2) {
-  for (std::set<std::string>::const_iterator it1 = ss1.begin(), ie1 = ss1.end();
-       it1 != ie1; ++it1) {
-    int flag = false;
-    for (std::set<std::string>::const_iterator it2 = ss2.begin(),
-                                               ie2 = ss2.end();
-         it2 != ie2; ++it2) {
-      if ((*it2).compare(*it1) == 0) {
-        flag = true;
-      }
-    }
-    if (flag == false)
+bool TxPartitionHelper::isSubset(const VarSet &ss1, const VarSet &ss2) {
+  for (VarSet::const_iterator it1 = ss1.begin(), ie1 = ss1.end(); it1 != ie1;
+       ++it1) {
+    if (!ss2.count(*it1))
       return false;
   }
   return true;
 }
 
-std::set<std::string> TxPartitionHelper::diff(std::set<std::string> ss1,
-                                              std::set<std::string> ss2) {
-  std::set<std::string> diff;
-  for (std::set<std::string>::const_iterator it1 = ss1.begin(), ie1 = ss1.end();
-       it1 != ie1; ++it1) {
+TxPartitionHelper::VarSet TxPartitionHelper::diff(const VarSet &ss1,
+                                                  const VarSet &ss2) {
+  VarSet diff;
+  for (VarSet::const_iterator it1 = ss1.begin(), ie1 = ss1.end(); it1 != ie1;
+       ++it1) {
     if (ss2.find(*it1) == ss2.end()) {
       diff.insert(*it1);
     }
@@ -217,12 +213,39 @@ ref<Expr> TxPartitionHelper::createAnd(std::vector<ref<Expr> > exprs) {
   return result;
 }
 
+void TxPartitionHelper::partition(
+    ref<Expr> e, std::vector<std::vector<ref<Expr> > > &groups,
+    std::vector<VarSet> &groupVars) {
+  std::vector<ref<Expr> > conjuncts = getExprsFromAndExpr(e);
+  for (std::vector<ref<Expr> >::iterator it = conjuncts.begin(),
+                                         ie = conjuncts.end();
+       it != ie; ++it) {
+    std::vector<ref<Expr> > group(1, *it);
+    VarSet vars;
+    getExprVars(*it, vars);
+
+    // Merge the groups sharing a variable with the conjunct
+    for (unsigned i = 0; i < groups.size();) {
+      if (!isShared(vars, groupVars[i])) {
+        ++i;
+        continue;
+      }
+      group.insert(group.end(), groups[i].begin(), groups[i].end());
+      vars.insert(groupVars[i].begin(), groupVars[i].end());
+      groups.erase(groups.begin() + i);
+      groupVars.erase(groupVars.begin() + i);
+    }
+    groups.push_back(group);
+    groupVars.push_back(vars);
+  }
+}
+
 void TxPartitionHelper::testing(ref<Expr> expr, ExecutionState es) {
-  std::set<std::string> readSet = getExprVars(expr);
+  VarSet readSet = getExprVars(expr);
   llvm::outs() << "=========begin\n";
   es.prevPC->inst->dump();
-  for (std::set<std::string>::iterator it = readSet.begin(), ie = readSet.end();
-       it != ie; ++it) {
+  for (VarSet::iterator it = readSet.begin(), ie = readSet.end(); it != ie;
+       ++it) {
     llvm::outs() << (*it) << "\n";
   }
   llvm::outs() << "=========end\n";
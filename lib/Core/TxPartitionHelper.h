@@ -19,6 +19,7 @@
 #include "TxStore.h"
 #include "klee/ExecutionState.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/Value.h"
 #include <iostream>
 #include <map>
@@ -27,14 +28,36 @@
 namespace klee {
 
 class TxPartitionHelper {
+  /// \brief The variables given to the addresses of the WP variables
+  static llvm::DenseMap<const llvm::Value *, uint64_t> addressVars;
+
 public:
+  /// \brief A variable of the expressions: the id of an array read by them,
+  /// or the one given to the address of one of their WP variables, above the
+  /// ids of the arrays. The variables are compared as integers rather than
+  /// by their names.
+  typedef uint64_t Var;
+
+  typedef std::set<Var> VarSet;
+
+  static Var getArrayVar(const Array *array) { return array->getId(); }
+
+  static Var getAddressVar(const llvm::Value *address);
+
   static std::vector<ref<Expr> > getExprsFromAndExpr(ref<Expr> e);
-  static std::set<std::string> getExprVars(ref<Expr> e);
-  static bool isShared(std::set<std::string> ss1, std::set<std::string> ss2);
-  static bool isSubset(std::set<std::string> ss1, std::set<std::string> ss2);
-  static std::set<std::string> diff(std::set<std::string> ss1,
-                                    std::set<std::string> ss2);
+  static VarSet getExprVars(ref<Expr> e);
+  /// \brief Collect the variables of an expression into an existing set,
+  /// avoiding the temporary sets of the recursion.
+  static void getExprVars(ref<Expr> e, VarSet &vars);
+  static bool isShared(const VarSet &ss1, const VarSet &ss2);
+  static bool isSubset(const VarSet &ss1, const VarSet &ss2);
+  static VarSet diff(const VarSet &ss1, const VarSet &ss2);
   static ref<Expr> createAnd(std::vector<ref<Expr> > exprs);
+  /// \brief Split the conjuncts of an expression into groups such that no
+  /// two groups share a variable, with the variables of each group.
+  static void partition(ref<Expr> e,
+                        std::vector<std::vector<ref<Expr> > > &groups,
+                        std::vector<VarSet> &groupVars);
   static void testing(ref<Expr> expr, ExecutionState es);
 };
 }
@@ -77,94 +77,64 @@ TxPathCondition::addConstraint(ref<Expr> constraint,
                                ref<TxStateValue> condition) {
   ref<TxPCConstraint> pcConstraint(
       new TxPCConstraint(constraint, condition, depth));
-  pcDepth[constraint] = pcConstraint;
+  constraints[constraint] = pcConstraint;
   if (llvm::isa<OrExpr>(constraint)) {
     // FIXME: Break up disjunction into its components, because each disjunct is
     // solved separately. The or constraint was due to state merge. Hence, the
     // following is just a makeshift for when state merge is properly
     // implemented.
-    pcDepth[constraint->getKid(0)] = pcConstraint;
-    pcDepth[constraint->getKid(1)] = pcConstraint;
+    constraints[constraint->getKid(0)] = pcConstraint;
+    constraints[constraint->getKid(1)] = pcConstraint;
   }
   return pcConstraint;
 }
 
+ref<TxPCConstraint> TxPathCondition::find(ref<Expr> expr) const {
+  for (const TxPathCondition *pc = this; pc; pc = pc->parent) {
+    ExprHashMap<ref<TxPCConstraint> >::const_iterator it =
+        pc->constraints.find(expr);
+    if (it != pc->constraints.end())
+      return it->second;
+  }
+  return ref<TxPCConstraint>();
+}
+
 void TxPathCondition::unsatCoreInterpolation(
     const std::vector<ref<Expr> > &unsatCore) {
-  std::map<uint64_t, std::set<ref<TxPCConstraint> > > depthToConstraintSet;
-  std::set<uint64_t> keySet;
-  std::vector<uint64_t> sortedKeys;
-
   for (std::vector<ref<Expr> >::const_iterator it = unsatCore.begin(),
                                                ie = unsatCore.end();
        it != ie; ++it) {
-    std::map<ref<Expr>, ref<TxPCConstraint> >::iterator pcDepthIter =
-        pcDepth.find(*it);
+    ref<TxPCConstraint> pcConstraint = find(*it);
     // FIXME: Sometimes some constraints are not in the PC. This is
     // because constraints are not properly added at state merge.
-    if (pcDepthIter != pcDepth.end()) {
-      ref<TxPCConstraint> &pcConstraint = pcDepthIter->second;
-      depthToConstraintSet[pcConstraint->getDepth()].insert(pcConstraint);
-      keySet.insert(pcConstraint->getDepth());
-
+    if (!pcConstraint.isNull()) {
+      used.insert(pcConstraint);
       TxTreeGraph::setAsCore(pcConstraint.get());
     }
   }
+}
 
-  for (std::set<uint64_t>::iterator it = keySet.begin(), ie = keySet.end();
-       it != ie; ++it) {
-    sortedKeys.push_back(*it);
-  }
-
-  std::sort(sortedKeys.begin(), sortedKeys.end());
-
-  std::set<ref<TxPCConstraint> > currentSet;
-  for (std::vector<uint64_t>::iterator it = sortedKeys.begin(),
-                                       ie = sortedKeys.end();
-       it != ie; ++it) {
-    std::set<ref<TxPCConstraint> > &constraintSet = depthToConstraintSet[*it];
-    currentSet.insert(constraintSet.begin(), constraintSet.end());
-    depthToConstraintSet[*it] = currentSet;
-  }
-
-  for (std::vector<uint64_t>::reverse_iterator it = sortedKeys.rbegin(),
-                                               ie = sortedKeys.rend();
-       it != ie; ++it) {
-    uint64_t constraintDepth = *it;
-    std::set<ref<TxPCConstraint> > &constraintSet =
-        depthToConstraintSet[constraintDepth];
-    TxPathCondition *currentPC = this;
-
-    while (currentPC && currentPC->parent && currentPC->depth >= constraintDepth) {
-      if (currentPC->parent->left == currentPC) {
-        currentPC = currentPC->parent;
-        currentPC->usedByLeftPath.insert(constraintSet.begin(),
-                                         constraintSet.end());
-      } else if (currentPC->parent->right == currentPC) {
-        currentPC = currentPC->parent;
-        currentPC->usedByRightPath.insert(constraintSet.begin(),
-                                          constraintSet.end());
-      }
+void TxPathCondition::propagateUsed() {
+  if (parent) {
+    for (std::set<ref<TxPCConstraint> >::iterator it = used.begin(),
+                                                  ie = used.end();
+         it != ie; ++it) {
+      if ((*it)->getDepth() <= parent->depth)
+        parent->used.insert(*it);
     }
   }
+  used.clear();
 }
 
 ref<Expr> TxPathCondition::packInterpolant(
     std::set<const Array *> &replacements,
     std::map<ref<Expr>, ref<Expr> > &substitution) const {
   ref<Expr> res;
-  std::set<ref<TxPCConstraint> > *usedList;
   std::vector<ref<Expr> > constraintsList;
 
   if (parent) {
-    if (parent->left == this) {
-      usedList = &(parent->usedByLeftPath);
-    } else {
-      usedList = &(parent->usedByRightPath);
-    }
-
-    for (std::set<ref<TxPCConstraint> >::iterator it = usedList->begin(),
-                                                  ie = usedList->end();
+    for (std::set<ref<TxPCConstraint> >::const_iterator it = used.begin(),
+                                                        ie = used.end();
          it != ie; ++it) {
       ref<Expr> constraint = (*it)->packInterpolant(replacements);
       if (llvm::isa<EqExpr>(constraint)) {
@@ -205,10 +175,14 @@ void TxPathCondition::print(llvm::raw_ostream &stream,
   std::string tabs = makeTabs(paddingAmount);
   std::string tabsNext = appendTab(tabs);
 
+  std::map<ref<Expr>, ref<TxPCConstraint> > pcConstraints;
+  for (const TxPathCondition *pc = this; pc; pc = pc->parent)
+    pcConstraints.insert(pc->constraints.begin(), pc->constraints.end());
+
   stream << tabs << "path condition = [";
   for (std::map<ref<Expr>, ref<TxPCConstraint> >::const_iterator
-           is = pcDepth.begin(),
-           it = is, ie = pcDepth.end();
+           is = pcConstraints.begin(),
+           it = is, ie = pcConstraints.end();
        it != ie; ++it) {
     if (it != is)
       stream << ",";
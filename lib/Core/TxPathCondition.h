@@ -17,6 +17,7 @@
 #define KLEE_TXPATHCONDITION_H
 
 #include "klee/Constraints.h"
+#include "klee/util/ExprHashMap.h"
 #include "klee/util/TxPrintUtil.h"
 #include "klee/Internal/Module/TxValues.h"
 
@@ -24,8 +25,10 @@ namespace klee {
 
 /// \brief A conjunct on the path condition
 class TxPCConstraint {
+  friend class TxMemoryCensus;
+
 public:
-  unsigned refCount;
+  RefCount refCount;
 
 private:
   /// \brief KLEE expression
@@ -66,14 +69,16 @@ public:
 };
 
 class TxPathCondition {
-  /// \brief The path condition, with the levels each one is introduced
-  std::map<ref<Expr>, ref<TxPCConstraint> > pcDepth;
+  friend class TxMemoryCensus;
 
-  /// \brief Store elements used by left path
-  std::set<ref<TxPCConstraint> > usedByLeftPath;
+  /// \brief The constraints introduced at the depth of this path condition,
+  /// those of the lower depths being found in the ancestors
+  ExprHashMap<ref<TxPCConstraint> > constraints;
 
-  /// \brief Store elements used by right path
-  std::set<ref<TxPCConstraint> > usedByRightPath;
+  /// \brief The constraints used by the unsatisfiability cores found at this
+  /// depth or at the removed descendants. Those of the lower depths are only
+  /// moved up to the parent when this path condition is removed.
+  std::set<ref<TxPCConstraint> > used;
 
   /// \brief The depth level of this store
   uint64_t depth;
@@ -84,6 +89,9 @@ class TxPathCondition {
   /// \brief Constructor for an empty path condition manager.
   TxPathCondition() : depth(0), parent(0), left(0), right(0) {}
 
+  /// \brief Find the path condition constraint of an expression, or null
+  ref<TxPCConstraint> find(ref<Expr> expr) const;
+
 public:
   ~TxPathCondition() {}
 
@@ -93,7 +101,6 @@ public:
       return ret;
     }
     ret->depth = src->depth + 1;
-    ret->pcDepth = src->pcDepth;
     ret->parent = src;
     return ret;
   }
@@ -107,6 +114,10 @@ public:
 
   void unsatCoreInterpolation(const std::vector<ref<Expr> > &unsatCore);
 
+  /// \brief Move the used constraints of the lower depths up to the parent,
+  /// when the node of this path condition is removed
+  void propagateUsed();
+
   ref<Expr>
   packInterpolant(std::set<const Array *> &replacements,
                   std::map<ref<Expr>, ref<Expr> > &substitution) const;
@@ -0,0 +1,155 @@
+//===-- TxQueryPredictor.cpp - Query time prediction ------------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementation of the predictor of the solver time
+/// of the subsumption check queries.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TxQueryPredictor.h"
+
+#include "klee/util/ExprUtil.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+llvm::cl::opt<bool> AdaptiveSubsumptionTimeout(
+    "adaptive-subsumption-timeout",
+    llvm::cl::desc("Predict the solver time of the subsumption check queries "
+                   "from their features and the earlier queries of their "
+                   "program points, skip the ones predicted to time out and "
+                   "shorten the timeout of the others. Only applies with "
+                   "-max-solver-time (default=off)."),
+    llvm::cl::init(false));
+
+llvm::cl::opt<double> SubsumptionTimeoutFactor(
+    "subsumption-timeout-factor",
+    llvm::cl::desc("With -adaptive-subsumption-timeout, the timeout of a "
+                   "subsumption check query as a multiple of its predicted "
+                   "time, within -max-solver-time, or zero to keep the "
+                   "timeout of the solver (default=4)."),
+    llvm::cl::init(4.0));
+
+/// The number of queries of a program point from which its own history is
+/// used for the prediction
+const uint64_t MinSamples = 4;
+
+/// The weight of a new sample in the moving averages
+const double SampleWeight = 0.25;
+
+/// The maximum number of queries skipped after consecutive timeouts
+const unsigned MaxBackoff = 64;
+
+/// The shortest timeout given to a query, in seconds, so that the overhead of
+/// the solver does not make the quick queries time out
+const double MinTimeout = 0.1;
+}
+
+Statistic TxQueryPredictor::skippedQueryCount("skippedSubsumptionQueryCount",
+                                              "skippedQueries");
+Statistic TxQueryPredictor::shortenedTimeoutCount(
+    "shortenedSubsumptionTimeoutCount", "shortenedTimeouts");
+
+TxQueryPredictor::HistoryMap TxQueryPredictor::history;
+
+TxQueryPredictor::History TxQueryPredictor::globalHistory[2];
+
+TxQueryPredictor::Features::Features(const ConstraintManager &constraints,
+                                     ref<Expr> expr, unsigned _querySize)
+    : querySize(_querySize), constraintCount(constraints.size()),
+      arrayCount(0), quantified(llvm::isa<ExistsExpr>(expr)) {
+  // Only the arrays of the query expression are counted, as those of the
+  // path condition are shared by all the checks of the state
+  std::vector<const Array *> arrays;
+  findSymbolicObjects(expr, arrays);
+  arrayCount = arrays.size();
+}
+
+double TxQueryPredictor::Features::getUnits() const {
+  // The array reads are the costliest part of the queries, as the solver
+  // instantiates the theory of arrays for each array
+  return (double)(querySize + constraintCount) * (1 + arrayCount);
+}
+
+void TxQueryPredictor::History::addSample(double secondsPerUnit) {
+  rate = sampleCount ? rate + SampleWeight * (secondsPerUnit - rate)
+                     : secondsPerUnit;
+  ++sampleCount;
+}
+
+bool TxQueryPredictor::predict(uintptr_t point, const Features &features,
+                               double &timeout) {
+  if (!AdaptiveSubsumptionTimeout || timeout <= 0)
+    return true;
+
+  History &h = history[std::make_pair(point, features.quantified)];
+  if (h.skipsLeft) {
+    --h.skipsLeft;
+    ++skippedQueryCount;
+    return false;
+  }
+
+  // After a timeout, the query once the skipped ones are over is tried with
+  // the full timeout, to find whether the queries became cheaper.
+  if (h.backoff)
+    return true;
+
+  const History &basis = h.sampleCount >= MinSamples
+                             ? h
+                             : globalHistory[features.quantified];
+  if (basis.sampleCount < MinSamples)
+    return true;
+
+  double predicted = basis.rate * features.getUnits();
+  if (predicted >= timeout) {
+    h.backoff = 1;
+    ++skippedQueryCount;
+    return false;
+  }
+
+  if (SubsumptionTimeoutFactor > 0) {
+    double shortened =
+        std::max(MinTimeout, SubsumptionTimeoutFactor * predicted);
+    if (shortened < timeout) {
+      timeout = shortened;
+      ++shortenedTimeoutCount;
+    }
+  }
+  return true;
+}
+
+void TxQueryPredictor::record(uintptr_t point, const Features &features,
+                              double time, bool timedOut) {
+  if (!AdaptiveSubsumptionTimeout)
+    return;
+
+  double secondsPerUnit = time / std::max(1.0, features.getUnits());
+  History &h = history[std::make_pair(point, features.quantified)];
+  h.addSample(secondsPerUnit);
+  globalHistory[features.quantified].addSample(secondsPerUnit);
+
+  if (timedOut) {
+    h.backoff = h.backoff ? std::min(2 * h.backoff, MaxBackoff) : 1;
+    h.skipsLeft = h.backoff;
+  } else {
+    h.backoff = 0;
+  }
+}
+
+void TxQueryPredictor::clear() {
+  history.clear();
+  globalHistory[0] = History();
+  globalHistory[1] = History();
+}
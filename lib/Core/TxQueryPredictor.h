@@ -0,0 +1,112 @@
+//===-- TxQueryPredictor.h - Query time prediction --------------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the declaration of the predictor of the solver time of
+/// the subsumption check queries, which chooses their timeouts and skips the
+/// ones predicted not to finish.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef TXQUERYPREDICTOR_H_
+#define TXQUERYPREDICTOR_H_
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/Statistic.h"
+
+#include <map>
+#include <stdint.h>
+#include <utility>
+
+namespace klee {
+
+/// \brief Predicts the solver time of the subsumption check queries from
+/// their features and from the times of the earlier queries at their program
+/// points, with -adaptive-subsumption-timeout.
+///
+/// The time of a query is predicted as its cost in units, computed from its
+/// size, its number of constraints and arrays, times a moving average of the
+/// seconds per unit of the earlier queries of the program point, or of all
+/// the program points while it has too few of them. Quantified and
+/// unquantified queries are predicted separately, as their times differ by
+/// orders of magnitude.
+///
+/// A query predicted to take the whole timeout is skipped, which is sound as a
+/// failed subsumption check only leaves the state to be explored. A query that
+/// times out makes the next queries of the program point be skipped, in
+/// numbers doubling with every further timeout, such that its checks are
+/// retried less and less often. The other queries are given the timeout of
+/// -subsumption-timeout-factor times their predicted time, within the
+/// timeout of the solver.
+class TxQueryPredictor {
+public:
+  /// \brief The features of a query from which its time is predicted
+  struct Features {
+    unsigned querySize;
+    unsigned constraintCount;
+    unsigned arrayCount;
+    bool quantified;
+
+    Features(const ConstraintManager &constraints, ref<Expr> expr,
+             unsigned _querySize);
+
+    /// \brief The cost of the query, proportional to its predicted time
+    double getUnits() const;
+  };
+
+  static Statistic skippedQueryCount;
+  static Statistic shortenedTimeoutCount;
+
+private:
+  /// \brief The times of the queries of a program point
+  struct History {
+    /// \brief The moving average of the seconds per unit of the queries
+    double rate;
+
+    uint64_t sampleCount;
+
+    /// \brief The number of queries to skip after the last timeout, doubled
+    /// with each consecutive timeout
+    unsigned backoff;
+
+    /// \brief The number of queries still to be skipped
+    unsigned skipsLeft;
+
+    History() : rate(0.0), sampleCount(0), backoff(0), skipsLeft(0) {}
+
+    void addSample(double secondsPerUnit);
+  };
+
+  /// \brief The histories indexed by program point and whether the queries
+  /// are quantified
+  typedef std::map<std::pair<uintptr_t, bool>, History> HistoryMap;
+
+  static HistoryMap history;
+
+  /// \brief The histories of all the program points, quantified or not
+  static History globalHistory[2];
+
+public:
+  /// \brief Decide whether to send the query of the features at the program
+  /// point to the solver, and choose its timeout, from the given timeout of
+  /// the solver. Returns false when the query is to be skipped.
+  static bool predict(uintptr_t point, const Features &features,
+                      double &timeout);
+
+  /// \brief Record the time of a query sent to the solver, and whether it
+  /// timed out with the full timeout of the solver.
+  static void record(uintptr_t point, const Features &features, double time,
+                     bool timedOut);
+
+  static void clear();
+};
+}
+
+#endif /* TXQUERYPREDICTOR_H_ */
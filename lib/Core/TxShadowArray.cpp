@@ -15,6 +15,11 @@
 //===----------------------------------------------------------------------===//
 
 #include "TxShadowArray.h"
+#include "klee/CommandLine.h"
+#include "klee/util/ExprHashConsing.h"
+#include "klee/util/TxExprUtil.h"
+
+#include <algorithm>
 
 using namespace klee;
 
@@ -22,16 +27,13 @@ namespace klee {
 
 std::map<const Array *, const Array *> TxShadowArray::shadowArray;
 
-UpdateNode *
-TxShadowArray::getShadowUpdate(const UpdateNode *source,
-                             std::set<const Array *> &replacements) {
-  if (!source)
-    return 0;
+ExprHashConsing TxShadowArray::shadowExpressions;
 
-  return new UpdateNode(getShadowUpdate(source->next, replacements),
-                        getShadowExpression(source->index, replacements),
-                        getShadowExpression(source->value, replacements));
-}
+ExprHashMap<TxShadowArray::CachedShadow> TxShadowArray::shadowCache;
+
+static const size_t MinShadowCacheThreshold = 1 << 12;
+
+size_t TxShadowArray::shadowCacheThreshold = MinShadowCacheThreshold;
 
 ref<Expr> TxShadowArray::createBinaryOfSameKind(ref<Expr> originalExpr,
                                               ref<Expr> newLhs,
@@ -48,56 +50,119 @@ void TxShadowArray::addShadowArrayMap(const Array *source, const Array *target)
   shadowArray[source] = target;
 }
 
+void TxShadowArray::collectShadowCache() {
+  // Releasing an expression may leave its kids only referenced by the cache;
+  // those are released by the next collection.
+  for (ExprHashMap<CachedShadow>::iterator it = shadowCache.begin();
+       it != shadowCache.end();) {
+    if (it->first->refCount == 1)
+      it = shadowCache.erase(it);
+    else
+      ++it;
+  }
+}
+
+class TxShadowArray::ShadowExpressionRewriter {
+  /// \brief The shadow arrays read by the expression being rewritten
+  std::set<const Array *> *arrays;
+
+  /// \brief The shadow update sequences built in this rewriting, by their
+  /// source update nodes, such that the suffixes shared by the update
+  /// sequences of several reads are shadowed once
+  std::map<const UpdateNode *, UpdateList> shadowUpdates;
+
+  const UpdateNode *getShadowUpdate(const Array *root,
+                                    const UpdateNode *source);
+
+  ref<Expr> rewriteNode(const ref<Expr> &expr);
+
+public:
+  ShadowExpressionRewriter(std::set<const Array *> &replacements)
+      : arrays(&replacements) {}
+
+  /// \brief Return the shadow expression of an expression, adding the shadow
+  /// arrays it reads to the replacements, and computing it only when the
+  /// expression is not in TxShadowArray#shadowCache
+  ref<Expr> rewrite(const ref<Expr> &expr);
+};
+
 ref<Expr>
-TxShadowArray::getShadowExpression(ref<Expr> expr,
-                                 std::set<const Array *> &replacements) {
+TxShadowArray::ShadowExpressionRewriter::rewrite(const ref<Expr> &expr) {
+  if (llvm::isa<ConstantExpr>(expr))
+    return expr;
+
+  ExprHashMap<CachedShadow>::iterator it = shadowCache.find(expr);
+  if (it != shadowCache.end()) {
+    arrays->insert(it->second.arrays.begin(), it->second.arrays.end());
+    return it->second.shadow;
+  }
+
+  std::set<const Array *> *outerArrays = arrays;
+  std::set<const Array *> nodeArrays;
+  arrays = &nodeArrays;
+  ref<Expr> shadow = rewriteNode(expr);
+  arrays = outerArrays;
+  arrays->insert(nodeArrays.begin(), nodeArrays.end());
+
+  CachedShadow &cached = shadowCache[expr];
+  cached.shadow = shadow;
+  cached.arrays.assign(nodeArrays.begin(), nodeArrays.end());
+  return shadow;
+}
+
+const UpdateNode *TxShadowArray::ShadowExpressionRewriter::getShadowUpdate(
+    const Array *root, const UpdateNode *source) {
+  if (!source)
+    return 0;
+
+  std::map<const UpdateNode *, UpdateList>::iterator it =
+      shadowUpdates.find(source);
+  if (it != shadowUpdates.end())
+    return it->second.head;
+
+  // The list keeps the shadow update nodes alive for the sharing
+  UpdateList shadow(root, new UpdateNode(getShadowUpdate(root, source->next),
+                                         rewrite(source->index),
+                                         rewrite(source->value)));
+  shadowUpdates.insert(std::make_pair(source, shadow));
+  return shadow.head;
+}
+
+ref<Expr>
+TxShadowArray::ShadowExpressionRewriter::rewriteNode(const ref<Expr> &expr) {
   ref<Expr> ret;
 
   switch (expr->getKind()) {
   case Expr::Read: {
     ReadExpr *readExpr = llvm::dyn_cast<ReadExpr>(expr);
     const Array *replacementArray = shadowArray[readExpr->updates.root];
+    arrays->insert(replacementArray);
 
-    if (std::find(replacements.begin(), replacements.end(), replacementArray) ==
-        replacements.end()) {
-      replacements.insert(replacementArray);
-    }
-
-    UpdateList newUpdates(
-        replacementArray,
-        getShadowUpdate(readExpr->updates.head, replacements));
-    ret = ReadExpr::create(newUpdates,
-                           getShadowExpression(readExpr->index, replacements));
-    break;
-  }
-  case Expr::Constant: {
-    ret = expr;
+    UpdateList newUpdates(replacementArray,
+                          getShadowUpdate(replacementArray,
+                                          readExpr->updates.head));
+    ret = ReadExpr::create(newUpdates, rewrite(readExpr->index));
     break;
   }
   case Expr::Select: {
-    ret =
-        SelectExpr::create(getShadowExpression(expr->getKid(0), replacements),
-                           getShadowExpression(expr->getKid(1), replacements),
-                           getShadowExpression(expr->getKid(2), replacements));
+    ret = SelectExpr::create(rewrite(expr->getKid(0)), rewrite(expr->getKid(1)),
+                             rewrite(expr->getKid(2)));
     break;
   }
   case Expr::Extract: {
     ExtractExpr *extractExpr = llvm::dyn_cast<ExtractExpr>(expr);
-    ret =
-        ExtractExpr::create(getShadowExpression(expr->getKid(0), replacements),
-                            extractExpr->offset, extractExpr->width);
+    ret = ExtractExpr::create(rewrite(expr->getKid(0)), extractExpr->offset,
+                              extractExpr->width);
     break;
   }
   case Expr::ZExt: {
     CastExpr *castExpr = llvm::dyn_cast<CastExpr>(expr);
-    ret = ZExtExpr::create(getShadowExpression(expr->getKid(0), replacements),
-                           castExpr->getWidth());
+    ret = ZExtExpr::create(rewrite(expr->getKid(0)), castExpr->getWidth());
     break;
   }
   case Expr::SExt: {
     CastExpr *castExpr = llvm::dyn_cast<CastExpr>(expr);
-    ret = SExtExpr::create(getShadowExpression(expr->getKid(0), replacements),
-                           castExpr->getWidth());
+    ret = SExtExpr::create(rewrite(expr->getKid(0)), castExpr->getWidth());
     break;
   }
   case Expr::Concat:
@@ -125,19 +190,38 @@ TxShadowArray::getShadowExpression(ref<Expr> expr,
   case Expr::Sle:
   case Expr::Sgt:
   case Expr::Sge: {
-    ret = createBinaryOfSameKind(
-        expr, getShadowExpression(expr->getKid(0), replacements),
-        getShadowExpression(expr->getKid(1), replacements));
+    ret = createBinaryOfSameKind(expr, rewrite(expr->getKid(0)),
+                                 rewrite(expr->getKid(1)));
     break;
   }
   case Expr::NotOptimized: {
-    ret = NotOptimizedExpr::create(getShadowExpression(expr->getKid(0), replacements));
+    ret = NotOptimizedExpr::create(rewrite(expr->getKid(0)));
     break;
   }
   default:
     assert(!"unhandled Expr type");
   }
 
+#ifdef ENABLE_Z3
+  // The kids of ret are already canonical, so that interning only compares
+  // ret with its equal nodes shallowly.
+  if (HashConsShadowExpressions)
+    return shadowExpressions.intern(ret);
+#endif
+  return ret;
+}
+
+ref<Expr>
+TxShadowArray::getShadowExpression(ref<Expr> expr,
+                                 std::set<const Array *> &replacements) {
+  ShadowExpressionRewriter rewriter(replacements);
+  ref<Expr> ret = rewriter.rewrite(expr);
+
+  if (shadowCache.size() >= shadowCacheThreshold) {
+    collectShadowCache();
+    shadowCacheThreshold =
+        std::max(MinShadowCacheThreshold, 2 * shadowCache.size());
+  }
   return ret;
 }
 
@@ -18,6 +18,10 @@
 #define KLEE_SHADOWARRAY_H
 
 #include "AddressSpace.h"
+#include "klee/util/ExprHashConsing.h"
+#include "klee/util/ExprHashMap.h"
+
+#include <vector>
 
 namespace klee {
 
@@ -26,8 +30,36 @@ namespace klee {
   class TxShadowArray {
     static std::map<const Array *, const Array *> shadowArray;
 
-    static UpdateNode *getShadowUpdate(const UpdateNode *chain,
-				       std::set<const Array *> &replacements);
+    /// \brief The canonical nodes of the shadow expressions, so that the
+    /// structurally-equal shadow expressions of different interpolants share
+    /// their nodes
+    static ExprHashConsing shadowExpressions;
+
+    /// \brief The shadow expression of an expression, with the shadow arrays
+    /// it reads
+    struct CachedShadow {
+      ref<Expr> shadow;
+
+      std::vector<const Array *> arrays;
+    };
+
+    /// \brief The shadow expressions of the expressions rewritten so far, as
+    /// the same subexpressions recur in the interpolants and the stored
+    /// values of many nodes. The cache keeps its expressions alive; those no
+    /// longer used outside of the cache are released whenever the cache has
+    /// doubled in size since the last collection.
+    static ExprHashMap<CachedShadow> shadowCache;
+
+    /// \brief The cache size that triggers the next collection
+    static size_t shadowCacheThreshold;
+
+    /// \brief Release the cached shadows of the expressions only referenced
+    /// by the cache
+    static void collectShadowCache();
+
+    /// \brief The memoized rewriting of expressions into their shadow
+    /// expressions
+    class ShadowExpressionRewriter;
 
   public:
     static ref<Expr> createBinaryOfSameKind(ref<Expr> originalExpr,
@@ -15,8 +15,24 @@
 
 #include "TxSpeculation.h"
 
+#include "llvm/Support/CommandLine.h"
+
+#include <cmath>
+
 using namespace klee;
 
+namespace {
+llvm::cl::opt<bool> SpecAdaptive(
+    "spec-adaptive",
+    llvm::cl::desc("Decline speculation at the branches where its failures "
+                   "cost more than its successes, as observed during the run "
+                   "(default=false)."),
+    llvm::cl::init(false));
+
+/// \brief The number of outcomes of a branch before it can be declined
+const unsigned SpecAdaptiveWarmup = 3;
+}
+
 std::string TxSpeculationHelper::WHITESPACE = " \n\r\t\f\v";
 
 bool TxSpeculationHelper::isStateSpeculable(ExecutionState &current) {
@@ -46,14 +62,17 @@ bool TxSpeculationHelper::isStateSpeculable(ExecutionState &current) {
 
 bool TxSpeculationHelper::isOverlap(std::set<std::string> &s1,
                                     std::set<std::string> &s2) {
-  for (std::set<std::string>::iterator it1 = s1.begin(), ie1 = s1.end();
-       it1 != ie1; ++it1) {
-    for (std::set<std::string>::iterator it2 = s2.begin(), ie2 = s2.end();
-         it2 != ie2; ++it2) {
-      if (*it1 == *it2) {
-        return true;
-      }
-    }
+  // Both sets are ordered, hence a single simultaneous traversal suffices
+  std::set<std::string>::iterator it1 = s1.begin(), ie1 = s1.end();
+  std::set<std::string>::iterator it2 = s2.begin(), ie2 = s2.end();
+  while (it1 != ie1 && it2 != ie2) {
+    int res = it1->compare(*it2);
+    if (res == 0)
+      return true;
+    if (res < 0)
+      ++it1;
+    else
+      ++it2;
   }
   return false;
 }
@@ -70,3 +89,66 @@ bool TxSpeculationHelper::isIndependent(
   }
   return true;
 }
+
+std::map<llvm::Instruction *, TxSpeculationController::BranchStatistics>
+    TxSpeculationController::branches;
+
+unsigned TxSpeculationController::outcomeCount = 0;
+
+unsigned TxSpeculationController::successCount = 0;
+
+double TxSpeculationController::successTime = 0.0;
+
+unsigned TxSpeculationController::declineCount = 0;
+
+bool TxSpeculationController::shouldSpeculate(llvm::Instruction *binst) {
+  if (!SpecAdaptive)
+    return true;
+
+  std::map<llvm::Instruction *, BranchStatistics>::const_iterator it =
+      branches.find(binst);
+  if (it == branches.end())
+    return true;
+  const BranchStatistics &stats = it->second;
+  unsigned count = stats.successCount + stats.failureCount;
+  if (count < SpecAdaptiveWarmup || !stats.failureCount)
+    return true;
+
+  double bound = (double)stats.successCount / count +
+                 std::sqrt(2.0 * std::log((double)outcomeCount) / count);
+  if (bound >= 1.0)
+    return true;
+
+  // Without a success at the branch, its benefit is estimated from the
+  // other branches, or else taken as equal to the rollback time
+  double rollbackTime = stats.failureTime / stats.failureCount;
+  double benefit = rollbackTime;
+  if (stats.successCount)
+    benefit = stats.successTime / stats.successCount;
+  else if (successCount)
+    benefit = successTime / successCount;
+
+  if (bound * benefit >= (1.0 - bound) * rollbackTime)
+    return true;
+
+  ++declineCount;
+  return false;
+}
+
+void TxSpeculationController::recordSuccess(llvm::Instruction *binst,
+                                            double time) {
+  BranchStatistics &stats = branches[binst];
+  ++stats.successCount;
+  stats.successTime += time;
+  ++successCount;
+  successTime += time;
+  ++outcomeCount;
+}
+
+void TxSpeculationController::recordFailure(llvm::Instruction *binst,
+                                            double time) {
+  BranchStatistics &stats = branches[binst];
+  ++stats.failureCount;
+  stats.failureTime += time;
+  ++outcomeCount;
+}
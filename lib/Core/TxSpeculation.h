@@ -50,6 +50,50 @@ public:
 
   static std::string trim(const std::string &s) { return rtrim(ltrim(s)); }
 };
+
+/// \brief Decides during the run at which branches speculation is worth
+/// opening.
+///
+/// Each branch at which speculations are opened is an arm of a bandit. A
+/// speculation either succeeds, with its subtree explored in the time
+/// accumulated in TxTreeNode#specTime, or fails, in which case that time is
+/// wasted in rolling the subtree back. With -spec-adaptive, speculation is
+/// declined at a branch when even the upper confidence bound of its success
+/// rate does not pay for its expected rollback time, taking the time of a
+/// successful speculation as the measure of its benefit. As the confidence
+/// bound widens with the number of outcomes elsewhere, a declined branch is
+/// eventually tried again.
+class TxSpeculationController {
+  struct BranchStatistics {
+    unsigned successCount;
+    unsigned failureCount;
+    double successTime;
+    double failureTime;
+
+    BranchStatistics()
+        : successCount(0), failureCount(0), successTime(0.0),
+          failureTime(0.0) {}
+  };
+
+  static std::map<llvm::Instruction *, BranchStatistics> branches;
+
+  static unsigned outcomeCount;
+
+  static unsigned successCount;
+
+  static double successTime;
+
+public:
+  /// \brief The number of speculations declined
+  static unsigned declineCount;
+
+  /// \brief Test if a speculation is to be opened at the branch
+  static bool shouldSpeculate(llvm::Instruction *binst);
+
+  static void recordSuccess(llvm::Instruction *binst, double time);
+
+  static void recordFailure(llvm::Instruction *binst, double time);
+};
 } // namespace klee
 
 #endif /* TXSPECULATION_H_ */
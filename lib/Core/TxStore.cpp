@@ -24,6 +24,12 @@ using namespace klee;
 
 namespace klee {
 
+const TxStore::TopStateStore TxStore::StateStoreView::emptyTopStateStore;
+
+const TxStore::LowerStateStore TxStore::StateStoreView::emptyLowerStateStore;
+
+uint64_t TxStore::markingEpoch = 0;
+
 ref<TxStoreEntry>
 TxStore::MiddleStateStore::find(ref<TxStateAddress> loc) const {
   ref<TxStoreEntry> ret;
@@ -174,6 +180,33 @@ void TxStore::MiddleStateStore::print(llvm::raw_ostream &stream,
 
 /**/
 
+TxStore::~TxStore() {
+  // The uses of this store and of the removed stores of its subtree are
+  // resolved into the parent, keeping those of the entries visible there
+  if (parent) {
+    for (std::set<ref<TxStoreEntry> >::iterator it = usedHere.begin(),
+                                                ie = usedHere.end();
+         it != ie; ++it) {
+      if ((*it)->getDepth() <= parent->depth)
+        parent->usedBelow.insert(*it);
+    }
+    for (std::set<ref<TxStoreEntry> >::iterator it = usedBelow.begin(),
+                                                ie = usedBelow.end();
+         it != ie; ++it) {
+      if ((*it)->getDepth() <= parent->depth)
+        parent->usedBelow.insert(*it);
+    }
+    if (parent->left == this)
+      parent->left = 0;
+    else if (parent->right == this)
+      parent->right = 0;
+  }
+  if (left)
+    left->parent = 0;
+  if (right)
+    right->parent = 0;
+}
+
 bool TxStore::isInLeftSubtree(uint64_t targetDepth) const {
   const TxStore *current = this;
   bool inLeftSubtree = false;
@@ -199,7 +232,7 @@ bool TxStore::isInLeftSubtree(uint64_t targetDepth) const {
 bool TxStore::adjustOffsetBound(ref<TxStoreEntry> entry, bool leftMarking,
                                 ref<TxStateValue> checkedAddress,
                                 std::set<uint64_t> &bounds,
-                                const std::string &reason, bool &boundUpdated) {
+                                unsigned reason, bool &boundUpdated) {
   bool memoryError = false;
   if (entry->canInterpolateBound(leftMarking)) {
     memoryError = entry->getPointerInfo(leftMarking)
@@ -268,12 +301,9 @@ void TxStore::getStoredExpressions(
     const std::vector<llvm::Instruction *> &callHistory,
     const std::map<ref<Expr>, ref<Expr> > &substitution,
     std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
-    TopStateStore &__internalStore,
-    LowerStateStore &__concretelyAddressedHistoricalStore,
-    LowerStateStore &__symbolicallyAddressedHistoricalStore) const {
-  __internalStore = internalStore;
-  __concretelyAddressedHistoricalStore = concretelyAddressedHistoricalStore;
-  __symbolicallyAddressedHistoricalStore = symbolicallyAddressedHistoricalStore;
+    StateStoreView &stateStore) const {
+  stateStore = StateStoreView(internalStore, concretelyAddressedHistoricalStore,
+                              symbolicallyAddressedHistoricalStore);
 }
 
 void TxStore::getStoredCoreExpressions(
@@ -285,12 +315,16 @@ void TxStore::getStoredCoreExpressions(
     TopInterpolantStore &_symbolicallyAddressedStore,
     LowerInterpolantStore &_concretelyAddressedHistoricalStore,
     LowerInterpolantStore &_symbolicallyAddressedHistoricalStore) const {
+  std::set<ref<TxStoreEntry> > used;
+  if (coreOnly)
+    getUsedBelow(used);
+
   getConcreteStore(referenceStore, callHistory, substitution, replacements,
                    coreOnly, leftRetrieval, _concretelyAddressedStore,
-                   _concretelyAddressedHistoricalStore);
+                   _concretelyAddressedHistoricalStore, used);
   getSymbolicStore(referenceStore, callHistory, substitution, replacements,
                    coreOnly, leftRetrieval, _symbolicallyAddressedStore,
-                   _symbolicallyAddressedHistoricalStore);
+                   _symbolicallyAddressedHistoricalStore, used);
 }
 
 ref<TxAllocationContext>
@@ -320,42 +354,23 @@ inline void TxStore::concreteToInterpolant(
     ref<TxVariable> variable, ref<TxStoreEntry> entry,
     const std::map<ref<Expr>, ref<Expr> > &substitution,
     std::set<const Array *> &replacements, bool coreOnly,
-    LowerInterpolantStore &map, bool leftOfEntry) const {
+    LowerInterpolantStore &map, bool leftOfEntry,
+    const std::set<ref<TxStoreEntry> > &used) const {
   if (!coreOnly) {
     ref<TxInterpolantValue> interpolantValue =
         entry->getInterpolantStyleValue(leftOfEntry);
     map[variable] = interpolantValue;
   } else if (entry->isCore(leftOfEntry)) {
-    // Do not add to the map if entry is not used
-    // The reason for commenting this code and adding the if statement
-    // after the commented code is to fix a bug which arises from
-    // insertions in usedByLeftPath and usedByRightPath. An entry is
-    // added to these if it is used in the subtree beneath it.
-    // However, in some cases for example when a path is infeasible
-    // the logic doesn't work. I have disabled this and I check both
-    // paths.
-    /*if (leftOfEntry) {
-      if (usedByLeftPath.find(entry) == usedByLeftPath.end())
-        return;
-    } else if (usedByRightPath.find(entry) == usedByRightPath.end()) {
-      return;
-    }*/
-    if (usedByLeftPath.find(entry) == usedByLeftPath.end() &&
-        usedByRightPath.find(entry) == usedByRightPath.end())
+    // Do not add to the map if entry is not used. The uses are not
+    // distinguished by the left and right subtrees, as the distinction does
+    // not hold when a path is infeasible.
+    if (used.find(entry) == used.end())
       return;
 
-// An address is in the core if it stores a value that is in the core
-#ifdef ENABLE_Z3
-    if (!NoExistential) {
-      map[variable] =
-          entry->getInterpolantValue(leftOfEntry, substitution, replacements);
-    } else {
-      map[variable] = entry->getInterpolantValue(leftOfEntry);
-    }
-#else
-    map[variable] =
-        entry->getInterpolantValue(leftOfEntry, substitution, replacements);
-#endif
+    // An address is in the core if it stores a value that is in the core.
+    // The value is shadowed at the first use of the subsumption table entry
+    // (see TxSubsumptionTableEntry#shadowStores).
+    map[variable] = entry->getRawInterpolantValue(leftOfEntry);
   }
 }
 
@@ -363,45 +378,35 @@ inline void TxStore::symbolicToInterpolant(
     ref<TxVariable> variable, ref<TxStoreEntry> entry,
     const std::map<ref<Expr>, ref<Expr> > &substitution,
     std::set<const Array *> &replacements, bool coreOnly,
-    LowerInterpolantStore &map, bool leftOfEntry) const {
+    LowerInterpolantStore &map, bool leftOfEntry,
+    const std::set<ref<TxStoreEntry> > &used) const {
   if (!coreOnly) {
     ref<TxInterpolantValue> interpolantValue =
         entry->getInterpolantStyleValue(leftOfEntry);
     map[variable] = interpolantValue;
   } else if (entry->isCore(leftOfEntry)) {
-    // Do not add to the map if entry is not used
-    // The reason for commenting this code and adding the if statement
-    // after the commented code is to fix a bug which arises from
-    // insertions in usedByLeftPath and usedByRightPath. An entry is
-    // added to these if it is used in the subtree beneath it.
-    // However, in some cases for example when a path is infeasible
-    // the logic doesn't work. I have disabled this and I check both
-    // paths.
-    /*if (leftOfEntry) {
-      if (usedByLeftPath.find(entry) == usedByLeftPath.end())
-        return;
-    } else if (usedByRightPath.find(entry) == usedByRightPath.end()) {
-      return;
-    }*/
-    if (usedByRightPath.find(entry) == usedByRightPath.end() &&
-        usedByLeftPath.find(entry) == usedByLeftPath.end())
+    // Do not add to the map if entry is not used. The uses are not
+    // distinguished by the left and right subtrees, as the distinction does
+    // not hold when a path is infeasible.
+    if (used.find(entry) == used.end())
       return;
 
-// An address is in the core if it stores a value that is in the core
+    // An address is in the core if it stores a value that is in the core.
+    // The value is shadowed at the first use of the subsumption table entry
+    // (see TxSubsumptionTableEntry#shadowStores), but the address is shadowed
+    // here as it is the key of the store.
 #ifdef ENABLE_Z3
     if (!NoExistential) {
       ref<TxVariable> address = TxStateAddress::create(
           entry->getAddress(), replacements)->getAsVariable();
-      map[address] =
-          entry->getInterpolantValue(leftOfEntry, substitution, replacements);
+      map[address] = entry->getRawInterpolantValue(leftOfEntry);
     } else {
-      map[variable] = entry->getInterpolantValue(leftOfEntry);
+      map[variable] = entry->getRawInterpolantValue(leftOfEntry);
     }
 #else
     ref<TxVariable> address = TxStateAddress::create(
         entry->getAddress(), replacements)->getAsVariable();
-    map[address] =
-        entry->getInterpolantValue(leftOfEntry, substitution, replacements);
+    map[address] = entry->getRawInterpolantValue(leftOfEntry);
 #endif
   }
 }
@@ -412,7 +417,8 @@ void TxStore::getConcreteStore(
     const std::map<ref<Expr>, ref<Expr> > &substitution,
     std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
     TopInterpolantStore &_concretelyAddressedStore,
-    LowerInterpolantStore &_concretelyAddressedHistoricalStore) const {
+    LowerInterpolantStore &_concretelyAddressedHistoricalStore,
+    const std::set<ref<TxStoreEntry> > &used) const {
   for (TopStateStore::const_iterator it = internalStore.begin(),
                                      ie = internalStore.end();
        it != ie; ++it) {
@@ -429,7 +435,7 @@ void TxStore::getConcreteStore(
            it1 != ie1; ++it1) {
         concreteToInterpolant(
             it1->first, it1->second, substitution, replacements, coreOnly, map,
-            referenceStore->isInLeftSubtree(it1->second->getDepth()));
+            referenceStore->isInLeftSubtree(it1->second->getDepth()), used);
       }
 
       // The map is only added when it is not empty; this is to avoid entries
@@ -444,7 +450,7 @@ void TxStore::getConcreteStore(
         concreteToInterpolant(
             it1->first, it1->second, substitution, replacements, coreOnly,
             storeIter->second,
-            referenceStore->isInLeftSubtree(it1->second->getDepth()));
+            referenceStore->isInLeftSubtree(it1->second->getDepth()), used);
       }
     }
   }
@@ -457,7 +463,7 @@ void TxStore::getConcreteStore(
     concreteToInterpolant(
         it->first, it->second, substitution, replacements, coreOnly,
         _concretelyAddressedHistoricalStore,
-        referenceStore->isInLeftSubtree(it->second->getDepth()));
+        referenceStore->isInLeftSubtree(it->second->getDepth()), used);
   }
 }
 
@@ -467,7 +473,8 @@ void TxStore::getSymbolicStore(
     const std::map<ref<Expr>, ref<Expr> > &substitution,
     std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
     TopInterpolantStore &_symbolicallyAddressedStore,
-    LowerInterpolantStore &_symbolicallyAddressedHistoricalStore) const {
+    LowerInterpolantStore &_symbolicallyAddressedHistoricalStore,
+    const std::set<ref<TxStoreEntry> > &used) const {
   for (TopStateStore::const_iterator it = internalStore.begin(),
                                      ie = internalStore.end();
        it != ie; ++it) {
@@ -484,7 +491,7 @@ void TxStore::getSymbolicStore(
            it1 != ie1; ++it1) {
         symbolicToInterpolant(
             it1->first, it1->second, substitution, replacements, coreOnly, map,
-            referenceStore->isInLeftSubtree(it1->second->getDepth()));
+            referenceStore->isInLeftSubtree(it1->second->getDepth()), used);
       }
 
       // The map is only added when it is not empty; this is to avoid entries
@@ -499,7 +506,7 @@ void TxStore::getSymbolicStore(
         symbolicToInterpolant(
             it1->first, it1->second, substitution, replacements, coreOnly,
             storeIter->second,
-            referenceStore->isInLeftSubtree(it1->second->getDepth()));
+            referenceStore->isInLeftSubtree(it1->second->getDepth()), used);
       }
     }
   }
@@ -511,7 +518,7 @@ void TxStore::getSymbolicStore(
     symbolicToInterpolant(
         it->first, it->second, substitution, replacements, coreOnly,
         _symbolicallyAddressedHistoricalStore,
-        referenceStore->isInLeftSubtree(it->second->getDepth()));
+        referenceStore->isInLeftSubtree(it->second->getDepth()), used);
   }
 }
 
@@ -584,118 +591,148 @@ void TxStore::updateStore(
   }
 }
 
-void TxStore::markUsed(const std::set<ref<TxStoreEntry> > &entryList) {
-  for (std::set<ref<TxStoreEntry> >::const_iterator it = entryList.begin(),
-                                                    ie = entryList.end();
+void TxStore::markUsed(const TxStoreEntryList &entryList) {
+  for (TxStoreEntryList::const_iterator it = entryList.begin(),
+                                        ie = entryList.end();
        it != ie; ++it) {
-    uint64_t entryDepth = (*it)->getDepth();
-
     // Note that it is possible that entryDepth > depth, due to the association
     // of values with newly-created entries in TxStore::updateStore().
-    if (entryDepth >= depth)
+    if ((*it)->getDepth() >= depth)
       continue;
 
-    // We now register the used entry as used after it was instantiated in
-    // previous depth levels
-    TxStore *prev = 0, *current = parent;
-    while (current && entryDepth <= current->depth) {
-      const TxStore *constPrev;
-      if (!prev) {
-        constPrev = this;
-      } else {
-        constPrev = prev;
-      }
-      if (current->left == constPrev) {
-        std::set<ref<TxStoreEntry> >::iterator usedEntryIter =
-            current->usedByLeftPath.find(*it);
-        if (usedEntryIter == current->usedByLeftPath.end()) {
-          current->usedByLeftPath.insert(*it);
-        } else {
-          break;
-        }
-      } else if (current->right == constPrev) {
-        std::set<ref<TxStoreEntry> >::iterator usedEntryIter =
-            current->usedByRightPath.find(*it);
-        if (usedEntryIter == current->usedByRightPath.end()) {
-          current->usedByRightPath.insert(*it);
-        } else {
-          break;
-        }
-      } else {
-        assert(!"child is neither left not right");
-      }
-      prev = current;
-      current = current->parent;
-    }
+    usedHere.insert(*it);
   }
 }
 
-void TxStore::recursivelyMarkFlow(ref<TxStoreEntry> entry, bool leftMarking,
-                                  const std::string &reason) const {
-  if (entry.isNull())
-    return;
-
-  if (entry->isCore(leftMarking)) {
-    if (!entry->canInterpolateBound(leftMarking))
-      return;
+void TxStore::getUsedBelow(std::set<ref<TxStoreEntry> > &used) const {
+  // An entry is used by the subtree if it is used by a store in the subtree
+  // that is still there, or has been resolved into this store at the removal
+  // of a store of the subtree.
+  for (std::set<ref<TxStoreEntry> >::const_iterator it = usedBelow.begin(),
+                                                    ie = usedBelow.end();
+       it != ie; ++it) {
+    if ((*it)->getDepth() <= depth)
+      used.insert(*it);
+  }
+
+  std::vector<const TxStore *> worklist;
+  if (left)
+    worklist.push_back(left);
+  if (right)
+    worklist.push_back(right);
+  while (!worklist.empty()) {
+    const TxStore *current = worklist.back();
+    worklist.pop_back();
+    for (std::set<ref<TxStoreEntry> >::const_iterator
+             it = current->usedHere.begin(),
+             ie = current->usedHere.end();
+         it != ie; ++it) {
+      if ((*it)->getDepth() <= depth)
+        used.insert(*it);
+    }
+    for (std::set<ref<TxStoreEntry> >::const_iterator
+             it = current->usedBelow.begin(),
+             ie = current->usedBelow.end();
+         it != ie; ++it) {
+      if ((*it)->getDepth() <= depth)
+        used.insert(*it);
+    }
+    if (current->left)
+      worklist.push_back(current->left);
+    if (current->right)
+      worklist.push_back(current->right);
   }
+}
 
-  entry->setAsCore(leftMarking, reason);
-  entry->disableBoundInterpolation(leftMarking);
+void TxStore::addFlowSources(ref<TxStateValue> target,
+                             MarkingWorklist &worklist) const {
+  if (target.isNull())
+    return;
 
-  std::map<ref<TxStoreEntry>, bool> &allowBoundEntryList(
-      entry->getAllowBoundEntryList());
-  for (std::map<ref<TxStoreEntry>, bool>::iterator
-           it = allowBoundEntryList.begin(),
-           ie = allowBoundEntryList.end();
+  const TxStoreEntryList &allowBoundEntryList(
+      target->getAllowBoundEntryList());
+  for (TxStoreEntryList::const_iterator it = allowBoundEntryList.begin(),
+                                        ie = allowBoundEntryList.end();
        it != ie; ++it) {
-    recursivelyMarkFlow(it->first, it->second, reason);
+    worklist.push_back(
+        std::make_pair(*it, isInLeftSubtree((*it)->getDepth())));
   }
 
-  std::map<ref<TxStoreEntry>, bool> &disableBoundEntryList(
-      entry->getDisableBoundEntryList());
-  for (std::map<ref<TxStoreEntry>, bool>::iterator
-           it = disableBoundEntryList.begin(),
-           ie = disableBoundEntryList.end();
+  const TxStoreEntryList &disableBoundEntryList(
+      target->getDisableBoundEntryList());
+  for (TxStoreEntryList::const_iterator it = disableBoundEntryList.begin(),
+                                        ie = disableBoundEntryList.end();
        it != ie; ++it) {
-    recursivelyMarkFlow(it->first, it->second, reason);
+    worklist.push_back(
+        std::make_pair(*it, isInLeftSubtree((*it)->getDepth())));
   }
 }
 
-void TxStore::markFlow(ref<TxStateValue> target,
-                       const std::string &reason) const {
-  if (target.isNull())
-    return;
+void TxStore::markFlow(MarkingWorklist &worklist, unsigned reason) {
+  while (!worklist.empty()) {
+    ref<TxStoreEntry> entry = worklist.back().first;
+    bool leftMarking = worklist.back().second;
+    worklist.pop_back();
 
-  const std::set<ref<TxStoreEntry> > &allowBoundEntryList(
-      target->getAllowBoundEntryList());
-  for (std::set<ref<TxStoreEntry> >::const_iterator
-           it = allowBoundEntryList.begin(),
-           ie = allowBoundEntryList.end();
-       it != ie; ++it) {
-    recursivelyMarkFlow(*it, isInLeftSubtree((*it)->getDepth()), reason);
+    if (entry.isNull())
+      continue;
+
+    if (entry->isCore(leftMarking)) {
+      if (!entry->canInterpolateBound(leftMarking))
+        continue;
+    }
+
+    entry->setAsCore(leftMarking, reason);
+    entry->disableBoundInterpolation(leftMarking);
+
+    std::map<ref<TxStoreEntry>, bool> &allowBoundEntryList(
+        entry->getAllowBoundEntryList());
+    for (std::map<ref<TxStoreEntry>, bool>::iterator
+             it = allowBoundEntryList.begin(),
+             ie = allowBoundEntryList.end();
+         it != ie; ++it) {
+      worklist.push_back(*it);
+    }
+
+    std::map<ref<TxStoreEntry>, bool> &disableBoundEntryList(
+        entry->getDisableBoundEntryList());
+    for (std::map<ref<TxStoreEntry>, bool>::iterator
+             it = disableBoundEntryList.begin(),
+             ie = disableBoundEntryList.end();
+         it != ie; ++it) {
+      worklist.push_back(*it);
+    }
   }
+}
 
-  const std::set<ref<TxStoreEntry> > &disableBoundEntryList(
-      target->getDisableBoundEntryList());
-  for (std::set<ref<TxStoreEntry> >::const_iterator
-           it = disableBoundEntryList.begin(),
-           ie = disableBoundEntryList.end();
+void TxStore::markFlow(ref<TxStateValue> target, unsigned reason) const {
+  MarkingWorklist worklist;
+  addFlowSources(target, worklist);
+  markFlow(worklist, reason);
+}
+
+void TxStore::markFlow(const std::set<ref<TxStateValue> > &targets,
+                       unsigned reason) const {
+  MarkingWorklist worklist;
+  for (std::set<ref<TxStateValue> >::const_iterator it = targets.begin(),
+                                                    ie = targets.end();
        it != ie; ++it) {
-    recursivelyMarkFlow(*it, isInLeftSubtree((*it)->getDepth()), reason);
+    addFlowSources(*it, worklist);
   }
+  markFlow(worklist, reason);
 }
 
-bool TxStore::recursivelyMarkPointerFlow(ref<TxStoreEntry> entry,
-                                         bool leftMarking,
-                                         ref<TxStateValue> checkedAddress,
-                                         std::set<uint64_t> &bounds,
-                                         const std::string &reason,
-                                         uint64_t startingDepth) const {
+bool TxStore::visitPointerFlow(ref<TxStoreEntry> entry, bool leftMarking,
+                               ref<TxStateValue> checkedAddress,
+                               std::set<uint64_t> &bounds, unsigned reason,
+                               uint64_t startingDepth,
+                               std::vector<PointerMarkingFrame> &stack) {
   bool memoryError = false;
   bool boundUpdated = false;
 
-  if (entry.isNull())
+  // The offset bound of an entry is adjusted against the same address at
+  // every visit of the traversal, hence the entry is visited only once.
+  if (entry.isNull() || !entry->visitMarking(leftMarking, markingEpoch))
     return memoryError;
 
   if (entry->getDepth() == startingDepth) {
@@ -714,44 +751,29 @@ bool TxStore::recursivelyMarkPointerFlow(ref<TxStoreEntry> entry,
                       : memoryError;
   }
 
+  std::map<ref<TxStoreEntry>, bool> &allowBoundEntryList(
+      entry->getAllowBoundEntryList());
   if (memoryError) {
-    std::map<ref<TxStoreEntry>, bool> &allowBoundEntryList(
-        entry->getAllowBoundEntryList());
-    for (std::map<ref<TxStoreEntry>, bool>::iterator
-             it = allowBoundEntryList.begin(),
-             ie = allowBoundEntryList.end();
-         it != ie; ++it) {
-      recursivelyMarkFlow(it->first, it->second, reason);
-    }
-  } else {
-    if (boundUpdated) {
-      std::map<ref<TxStoreEntry>, bool> &allowBoundEntryList(
-          entry->getAllowBoundEntryList());
-      for (std::map<ref<TxStoreEntry>, bool>::iterator
-               it = allowBoundEntryList.begin(),
-               ie = allowBoundEntryList.end();
-           it != ie; ++it) {
-        if (!it->first->isPointer()) {
-          recursivelyMarkFlow(it->first, it->second, reason);
-        } else {
-          memoryError =
-              recursivelyMarkPointerFlow(it->first, it->second, checkedAddress,
-                                         bounds, reason, startingDepth)
-                  ? true
-                  : memoryError;
-        }
-      }
-    }
+    MarkingWorklist worklist(allowBoundEntryList.begin(),
+                             allowBoundEntryList.end());
+    markFlow(worklist, reason);
+  } else if (boundUpdated) {
+    // The entries this entry depends upon are visited before the ones that
+    // disable bound interpolation, as the marking of the latter disables the
+    // bound adjustment of the former.
+    PointerMarkingFrame frame;
+    frame.entry = entry;
+    frame.next = allowBoundEntryList.begin();
+    frame.end = allowBoundEntryList.end();
+    stack.push_back(frame);
+    return memoryError;
   }
 
   std::map<ref<TxStoreEntry>, bool> &disableBoundEntryList(
       entry->getDisableBoundEntryList());
-  for (std::map<ref<TxStoreEntry>, bool>::iterator
-           it = disableBoundEntryList.begin(),
-           ie = disableBoundEntryList.end();
-       it != ie; ++it) {
-    recursivelyMarkFlow(it->first, it->second, reason);
-  }
+  MarkingWorklist worklist(disableBoundEntryList.begin(),
+                           disableBoundEntryList.end());
+  markFlow(worklist, reason);
 
   return memoryError;
 }
@@ -759,36 +781,61 @@ bool TxStore::recursivelyMarkPointerFlow(ref<TxStoreEntry> entry,
 bool TxStore::markPointerFlow(ref<TxStateValue> target,
                               ref<TxStateValue> checkedAddress,
                               std::set<uint64_t> &bounds,
-                              const std::string &reason) const {
+                              unsigned reason) const {
   bool memoryError = false;
 
   if (target.isNull())
     return memoryError;
 
-  const std::set<ref<TxStoreEntry> > &allowBoundEntryList(
-      target->getAllowBoundEntryList());
-  for (std::set<ref<TxStoreEntry> >::const_iterator
-           it = allowBoundEntryList.begin(),
-           ie = allowBoundEntryList.end();
+  ++markingEpoch;
+  std::vector<PointerMarkingFrame> stack;
+
+  const TxStoreEntryList &allowBoundEntryList(target->getAllowBoundEntryList());
+  for (TxStoreEntryList::const_iterator it = allowBoundEntryList.begin(),
+                                        ie = allowBoundEntryList.end();
        it != ie; ++it) {
     if (!(*it)->isPointer()) {
-      recursivelyMarkFlow(*it, isInLeftSubtree((*it)->getDepth()), reason);
-    } else {
-      memoryError =
-          recursivelyMarkPointerFlow(*it, isInLeftSubtree((*it)->getDepth()),
-                                     checkedAddress, bounds, reason, depth)
-              ? true
-              : memoryError;
+      markFlow(*it, isInLeftSubtree((*it)->getDepth()), reason);
+      continue;
+    }
+
+    memoryError = visitPointerFlow(*it, isInLeftSubtree((*it)->getDepth()),
+                                   checkedAddress, bounds, reason, depth, stack)
+                      ? true
+                      : memoryError;
+
+    // Visit the entries the pointer depends upon depth-first, as the
+    // recursion would, with the stack of the entries being visited
+    while (!stack.empty()) {
+      PointerMarkingFrame &frame = stack.back();
+      if (frame.next == frame.end) {
+        std::map<ref<TxStoreEntry>, bool> &disableBoundEntryList(
+            frame.entry->getDisableBoundEntryList());
+        MarkingWorklist worklist(disableBoundEntryList.begin(),
+                                 disableBoundEntryList.end());
+        stack.pop_back();
+        markFlow(worklist, reason);
+        continue;
+      }
+
+      std::pair<ref<TxStoreEntry>, bool> next = *frame.next;
+      ++frame.next;
+      if (!next.first->isPointer()) {
+        markFlow(next.first, next.second, reason);
+      } else {
+        memoryError = visitPointerFlow(next.first, next.second, checkedAddress,
+                                       bounds, reason, depth, stack)
+                          ? true
+                          : memoryError;
+      }
     }
   }
 
-  const std::set<ref<TxStoreEntry> > &disableBoundEntryList(
-      target->getDisableBoundEntryList());
-  for (std::set<ref<TxStoreEntry> >::const_iterator
-           it = disableBoundEntryList.begin(),
-           ie = disableBoundEntryList.end();
+  const TxStoreEntryList &disableBoundEntryList(target->getDisableBoundEntryList());
+  for (TxStoreEntryList::const_iterator it = disableBoundEntryList.begin(),
+                                        ie = disableBoundEntryList.end();
        it != ie; ++it) {
-    recursivelyMarkFlow(*it, isInLeftSubtree((*it)->getDepth()), reason);
+    markFlow(*it, isInLeftSubtree((*it)->getDepth()), reason);
   }
 
   return memoryError;
@@ -17,6 +17,7 @@
 #ifndef KLEE_TXSTORE_H
 #define KLEE_TXSTORE_H
 
+#include "TxObjectPool.h"
 #include "klee/Internal/Module/TxValues.h"
 #include "klee/util/Ref.h"
 
@@ -25,6 +26,8 @@
 namespace klee {
 
 class TxStore {
+  friend class TxMemoryCensus;
+
 public:
   class MiddleStateStore;
 
@@ -111,6 +114,49 @@ public:
     void print(llvm::raw_ostream &stream, const std::string &prefix) const;
   };
 
+  /// \brief A read-only view of the state store of a TxStore.
+  ///
+  /// This is used by the subsumption check to iterate the store of the
+  /// current state without copying its maps. The view is only valid for as
+  /// long as the viewed TxStore is neither modified nor deleted, which holds
+  /// during a subsumption check. A default-constructed view is empty.
+  class StateStoreView {
+    const TopStateStore *internalStore;
+
+    const LowerStateStore *concretelyAddressedHistoricalStore;
+
+    const LowerStateStore *symbolicallyAddressedHistoricalStore;
+
+    static const TopStateStore emptyTopStateStore;
+
+    static const LowerStateStore emptyLowerStateStore;
+
+  public:
+    StateStoreView()
+        : internalStore(&emptyTopStateStore),
+          concretelyAddressedHistoricalStore(&emptyLowerStateStore),
+          symbolicallyAddressedHistoricalStore(&emptyLowerStateStore) {}
+
+    StateStoreView(const TopStateStore &_internalStore,
+                   const LowerStateStore &_concretelyAddressedHistoricalStore,
+                   const LowerStateStore &_symbolicallyAddressedHistoricalStore)
+        : internalStore(&_internalStore),
+          concretelyAddressedHistoricalStore(
+              &_concretelyAddressedHistoricalStore),
+          symbolicallyAddressedHistoricalStore(
+              &_symbolicallyAddressedHistoricalStore) {}
+
+    const TopStateStore &getInternalStore() const { return *internalStore; }
+
+    const LowerStateStore &getConcretelyAddressedHistoricalStore() const {
+      return *concretelyAddressedHistoricalStore;
+    }
+
+    const LowerStateStore &getSymbolicallyAddressedHistoricalStore() const {
+      return *symbolicallyAddressedHistoricalStore;
+    }
+  };
+
 private:
   /// \brief A concretely-addressed store of the earlier versions of all
   /// addresses
@@ -123,11 +169,12 @@ private:
   /// \brief The mapping of locations to stored value
   TopStateStore internalStore;
 
-  /// \brief Store elements used by left path
-  std::set<ref<TxStoreEntry> > usedByLeftPath;
+  /// \brief Store elements of the ancestors used by this store
+  std::set<ref<TxStoreEntry> > usedHere;
 
-  /// \brief Store elements used by right path
-  std::set<ref<TxStoreEntry> > usedByRightPath;
+  /// \brief Store elements used by the removed stores of the subtree, which
+  /// resolve their uses into their parent
+  std::set<ref<TxStoreEntry> > usedBelow;
 
   /// \brief The depth level of this store
   uint64_t depth;
@@ -135,17 +182,35 @@ private:
   /// \brief The parent and left and right children of this store
   TxStore *parent, *left, *right;
 
+  /// \brief The store entries to be marked, each with whether it is marked
+  /// from the subtree of the immediate left child
+  typedef std::vector<std::pair<ref<TxStoreEntry>, bool> > MarkingWorklist;
+
+  /// \brief An entry being visited by the pointer marking, with the entries
+  /// it depends upon that are still to be visited
+  struct PointerMarkingFrame {
+    ref<TxStoreEntry> entry;
+
+    std::map<ref<TxStoreEntry>, bool>::iterator next, end;
+  };
+
+  /// \brief The number of pointer marking traversals so far, with which the
+  /// entries visited by the current traversal are stamped
+  static uint64_t markingEpoch;
+
   void concreteToInterpolant(ref<TxVariable> variable, ref<TxStoreEntry> entry,
                              const std::map<ref<Expr>, ref<Expr> > &substition,
                              std::set<const Array *> &replacements,
                              bool coreOnly, LowerInterpolantStore &map,
-                             bool leftOfEntry) const;
+                             bool leftOfEntry,
+                             const std::set<ref<TxStoreEntry> > &used) const;
 
   void
   symbolicToInterpolant(ref<TxVariable> variable, ref<TxStoreEntry> entry,
                         const std::map<ref<Expr>, ref<Expr> > &substitution,
                         std::set<const Array *> &replacements, bool coreOnly,
-                        LowerInterpolantStore &map, bool leftOfEntry) const;
+                        LowerInterpolantStore &map, bool leftOfEntry,
+                        const std::set<ref<TxStoreEntry> > &used) const;
 
   void getConcreteStore(
       const TxStore *referenceStore,
@@ -153,7 +218,8 @@ private:
       const std::map<ref<Expr>, ref<Expr> > &substitution,
       std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
       TopInterpolantStore &_concretelyAddressedStore,
-      LowerInterpolantStore &_concretelyAddressedHistoricalStore) const;
+      LowerInterpolantStore &_concretelyAddressedHistoricalStore,
+      const std::set<ref<TxStoreEntry> > &used) const;
 
   void getSymbolicStore(
       const TxStore *referenceStore,
@@ -161,27 +227,57 @@ private:
       const std::map<ref<Expr>, ref<Expr> > &substitution,
       std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
       TopInterpolantStore &_symbolicallyAddressedStore,
-      LowerInterpolantStore &_symbolicallyAddressedHistoricalStore) const;
-
-  void recursivelyMarkFlow(ref<TxStoreEntry> entry, bool leftMarking,
-                           const std::string &reason) const;
+      LowerInterpolantStore &_symbolicallyAddressedHistoricalStore,
+      const std::set<ref<TxStoreEntry> > &used) const;
+
+  /// \brief Collect the store elements of this store and its ancestors used
+  /// by the subtree
+  void getUsedBelow(std::set<ref<TxStoreEntry> > &used) const;
+
+  /// \brief Add the entries the target value depends upon to the worklist
+  void addFlowSources(ref<TxStateValue> target,
+                      MarkingWorklist &worklist) const;
+
+  /// \brief Mark as core the entries in the worklist and all the entries they
+  /// depend upon, iteratively to bound the stack depth. An entry marked
+  /// without bound interpolation is not traversed again.
+  static void markFlow(MarkingWorklist &worklist, unsigned reason);
+
+  static void markFlow(ref<TxStoreEntry> entry, bool leftMarking,
+                       unsigned reason) {
+    MarkingWorklist worklist(1, std::make_pair(entry, leftMarking));
+    markFlow(worklist, reason);
+  }
 
-  bool recursivelyMarkPointerFlow(ref<TxStoreEntry> entry, bool leftMarking,
-                                  ref<TxStateValue> checkedAddress,
-                                  std::set<uint64_t> &bounds,
-                                  const std::string &reason,
-                                  uint64_t startingDepth) const;
+  /// \brief Adjust the offset bound of a pointer entry and mark it as core,
+  /// pushing it onto the stack when the entries it depends upon are to be
+  /// visited. Returns true if memory bounds violation is detected; false
+  /// otherwise.
+  static bool visitPointerFlow(ref<TxStoreEntry> entry, bool leftMarking,
+                               ref<TxStateValue> checkedAddress,
+                               std::set<uint64_t> &bounds, unsigned reason,
+                               uint64_t startingDepth,
+                               std::vector<PointerMarkingFrame> &stack);
 
   static bool adjustOffsetBound(ref<TxStoreEntry> entry, bool leftMarking,
                                 ref<TxStateValue> checkedAddress,
                                 std::set<uint64_t> &bounds,
-                                const std::string &reason, bool &boundUpdated);
+                                unsigned reason, bool &boundUpdated);
 
   /// \brief Constructor for an empty store.
   TxStore() : depth(0), parent(0), left(0), right(0) {}
 
 public:
-  ~TxStore() {}
+  ~TxStore();
+
+  /// \brief Allocation from the free-list pool of TxStore objects
+  static void *operator new(size_t size) {
+    return TxObjectPool<TxStore>::allocate(size);
+  }
+
+  static void operator delete(void *object, size_t size) {
+    TxObjectPool<TxStore>::deallocate(object, size);
+  }
 
   bool isInInternalStateStore(ref<TxAllocationContext> ctx) {
     TopStateStore::iterator middleStoreIter = internalStore.find(ctx);
@@ -225,9 +321,8 @@ public:
   ref<TxStoreEntry> find(ref<TxAllocationContext> alc, ref<Expr> offset) const;
 
   /// \brief This retrieves the locations known at this state, and the
-  /// expressions stored in the locations. Returns as the last argument a pair
-  /// of the store part indexed by constants, and the store part indexed by
-  /// symbolic expressions.
+  /// expressions stored in the locations, as a read-only view of this store
+  /// that is returned as the last argument. No map is copied.
   ///
   /// \param replacements The replacement bound variables when
   /// retrieving state for creating subsumption table entry: As the
@@ -243,9 +338,7 @@ public:
       const TxStore *store, const std::vector<llvm::Instruction *> &callHistory,
       const std::map<ref<Expr>, ref<Expr> > &substitution,
       std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
-      TopStateStore &__internalStore,
-      LowerStateStore &__concretelyAddressedHistoricalStore,
-      LowerStateStore &__symbolicallyAddressedHistoricalStore) const;
+      StateStoreView &stateStore) const;
 
   /// \brief This retrieves the locations known at this state, and the
   /// expressions stored in the locations. Returns as the last argument a pair
@@ -286,12 +379,20 @@ public:
       ref<TxStateAddress> location, ref<TxStateValue> address,
       ref<TxStateValue> value);
 
-  /// \brief Register the entries in the entry list as used
-  void markUsed(const std::set<ref<TxStoreEntry> > &entryList);
+  /// \brief Register the entries in the entry list as used. The use is only
+  /// recorded in this store, and resolved into the ancestors when the store
+  /// is removed or the interpolant of the subtree of an ancestor is
+  /// retrieved.
+  void markUsed(const TxStoreEntryList &entryList);
 
   /// \brief Mark as core all the values and locations that flows to the
   /// target
-  void markFlow(ref<TxStateValue> target, const std::string &reason) const;
+  void markFlow(ref<TxStateValue> target, unsigned reason) const;
+
+  /// \brief Mark as core all the values and locations that flows to any of
+  /// the targets, in a single traversal
+  void markFlow(const std::set<ref<TxStateValue> > &targets,
+                unsigned reason) const;
 
   void markGlobalVariables(ref<TxAllocationContext> ctx, ref<Expr> expr) const;
 
@@ -300,8 +401,7 @@ public:
   /// slackening). Returns true if memory bounds violation is detected; false
   /// otherwise.
   bool markPointerFlow(ref<TxStateValue> target,
-                       ref<TxStateValue> checkedOffset,
-                       const std::string &reason) const {
+                       ref<TxStateValue> checkedOffset, unsigned reason) const {
     std::set<uint64_t> bounds;
     return markPointerFlow(target, checkedOffset, bounds, reason);
   }
@@ -311,8 +411,7 @@ public:
   /// slackening)
   bool markPointerFlow(ref<TxStateValue> target,
                        ref<TxStateValue> checkedOffset,
-                       std::set<uint64_t> &bounds,
-                       const std::string &reason) const;
+                       std::set<uint64_t> &bounds, unsigned reason) const;
 
   uint64_t getDepth() const { return depth; }
 
@@ -15,20 +15,33 @@
 
 #include "TxTree.h"
 
+#include "SamplingProfiler.h"
 #include "TimingSolver.h"
 
+#include "TxDebugLog.h"
 #include "TxDependency.h"
+#include "TxQueryPredictor.h"
 #include "TxShadowArray.h"
 #include "Memory.h"
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/System/Time.h"
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <klee/CommandLine.h>
 #include <klee/Expr.h>
 #include <klee/Internal/Support/ErrorHandling.h>
 #include <klee/Solver.h>
 #include <klee/SolverStats.h>
+#include <klee/util/Assignment.h>
 #include <klee/util/ExprPPrinter.h>
+#include <klee/util/ExprUtil.h>
 #include <klee/util/TxExprUtil.h>
 #include <klee/util/TxPrintUtil.h>
+#include <sstream>
+#include <unistd.h>
 #include <vector>
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 5)
@@ -39,6 +52,14 @@
 #include <llvm/Analysis/DebugInfo.h>
 #endif
 
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include <llvm/IR/Module.h>
+#else
+#include <llvm/Module.h>
+#endif
+
+#include <llvm/Support/Format.h>
+
 using namespace klee;
 
 Statistic TxSubsumptionTableEntry::concretelyAddressedStoreExpressionBuildTime(
@@ -48,19 +69,149 @@ TxSubsumptionTableEntry::symbolicallyAddressedStoreExpressionBuildTime(
     "symbolicallyAddressedStoreExpressionBuildTime", "symbolicStoreTime");
 Statistic TxSubsumptionTableEntry::solverAccessTime("solverAccessTime",
                                                     "solverAccessTime");
+Statistic TxSubsumptionTableEntry::preFilterRejectionCount(
+    "preFilterRejectionCount", "preFilterRejections");
+Statistic TxSubsumptionTableEntry::modelRejectionCount("modelRejectionCount",
+                                                       "modelRejections");
+Statistic TxSubsumptionTableEntry::quantifiedQueryCacheHits(
+    "quantifiedQueryCacheHits", "quantifiedQueryCacheHits");
+Statistic TxSubsumptionTableEntry::quantifiedQueryCacheMisses(
+    "quantifiedQueryCacheMisses", "quantifiedQueryCacheMisses");
+
+std::map<unsigned, std::vector<TxSubsumptionTableEntry::QuantifiedQueryResult> >
+TxSubsumptionTableEntry::quantifiedQueryCache;
+
+unsigned TxSubsumptionTableEntry::quantifiedQueryCacheSize = 0;
+
+TxSubsumptionTableEntry::CheckFailure
+TxSubsumptionTableEntry::lastCheckFailure =
+    TxSubsumptionTableEntry::NoFailure;
+
+unsigned TxSubsumptionTableEntry::lastQuerySize = 0;
+
+/// \brief The number of cached quantified query results above which the cache
+/// is flushed to bound its memory usage.
+static const unsigned MaxQuantifiedQueryCacheSize = 1 << 14;
+
+uint64_t TxStoreSignature::getFilterBits(const llvm::Value *site) {
+  // Two bits out of 64, taken from a multiplicative hash of the pointer
+  uint64_t h = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(site)) *
+               0x9E3779B97F4A7C15ULL;
+  return (1ULL << (h >> 58)) | (1ULL << ((h >> 52) & 63));
+}
+
+TxStoreSignature::TxStoreSignature(const TxStore::StateStoreView &stateStore)
+    : allocationFilter(0), historicalFilter(0) {
+  const TxStore::TopStateStore &internalStore = stateStore.getInternalStore();
+  for (TxStore::TopStateStore::const_iterator it = internalStore.begin(),
+                                              ie = internalStore.end();
+       it != ie; ++it) {
+    allocationFilter |= getFilterBits(it->first->getValue());
+  }
+
+  const TxStore::LowerStateStore &concreteHistory =
+      stateStore.getConcretelyAddressedHistoricalStore();
+  for (TxStore::LowerStateStore::const_iterator it = concreteHistory.begin(),
+                                                ie = concreteHistory.end();
+       it != ie; ++it) {
+    historicalFilter |= getFilterBits(it->first->getValue());
+  }
+
+  const TxStore::LowerStateStore &symbolicHistory =
+      stateStore.getSymbolicallyAddressedHistoricalStore();
+  for (TxStore::LowerStateStore::const_iterator it = symbolicHistory.begin(),
+                                                ie = symbolicHistory.end();
+       it != ie; ++it) {
+    historicalFilter |= getFilterBits(it->first->getValue());
+  }
+}
+
+void TxStoreSignature::build(
+    const TxStore::TopInterpolantStore &concretelyAddressedStore,
+    const TxStore::TopInterpolantStore &symbolicallyAddressedStore,
+    const TxStore::LowerInterpolantStore &concretelyAddressedHistoricalStore,
+    const TxStore::LowerInterpolantStore &
+        symbolicallyAddressedHistoricalStore) {
+  allocationFilter = 0;
+  historicalFilter = 0;
+  allocationContexts.clear();
+  historicalVariables.clear();
+
+  for (TxStore::TopInterpolantStore::const_iterator
+           it = concretelyAddressedStore.begin(),
+           ie = concretelyAddressedStore.end();
+       it != ie; ++it) {
+    allocationContexts.insert(it->first);
+    allocationFilter |= getFilterBits(it->first->getValue());
+  }
+  for (TxStore::TopInterpolantStore::const_iterator
+           it = symbolicallyAddressedStore.begin(),
+           ie = symbolicallyAddressedStore.end();
+       it != ie; ++it) {
+    allocationContexts.insert(it->first);
+    allocationFilter |= getFilterBits(it->first->getValue());
+  }
+  for (TxStore::LowerInterpolantStore::const_iterator
+           it = concretelyAddressedHistoricalStore.begin(),
+           ie = concretelyAddressedHistoricalStore.end();
+       it != ie; ++it) {
+    historicalVariables.insert(it->first);
+    historicalFilter |= getFilterBits(it->first->getValue());
+  }
+  for (TxStore::LowerInterpolantStore::const_iterator
+           it = symbolicallyAddressedHistoricalStore.begin(),
+           ie = symbolicallyAddressedHistoricalStore.end();
+       it != ie; ++it) {
+    historicalVariables.insert(it->first);
+    historicalFilter |= getFilterBits(it->first->getValue());
+  }
+}
+
+bool TxStoreSignature::mayMatch(
+    const TxStoreSignature &stateSignature,
+    const TxStore::StateStoreView &stateStore) const {
+  // Quick rejection: some allocation site is surely absent from the state
+  if ((allocationFilter & ~stateSignature.allocationFilter) ||
+      (historicalFilter & ~stateSignature.historicalFilter))
+    return false;
+
+  const TxStore::TopStateStore &internalStore = stateStore.getInternalStore();
+  for (std::set<ref<TxAllocationContext> >::const_iterator
+           it = allocationContexts.begin(),
+           ie = allocationContexts.end();
+       it != ie; ++it) {
+    if (internalStore.find(*it) == internalStore.end())
+      return false;
+  }
+
+  const TxStore::LowerStateStore &concreteHistory =
+      stateStore.getConcretelyAddressedHistoricalStore();
+  const TxStore::LowerStateStore &symbolicHistory =
+      stateStore.getSymbolicallyAddressedHistoricalStore();
+  for (std::set<ref<TxVariable> >::const_iterator
+           it = historicalVariables.begin(),
+           ie = historicalVariables.end();
+       it != ie; ++it) {
+    if (concreteHistory.find(*it) == concreteHistory.end() &&
+        symbolicHistory.find(*it) == symbolicHistory.end())
+      return false;
+  }
+  return true;
+}
 
 TxSubsumptionTableEntry::TxSubsumptionTableEntry(
     TxTreeNode *node, const std::vector<llvm::Instruction *> &callHistory)
-    : programPoint(node->getProgramPoint()),
+    : pendingShadowing(true), pendingWP(false), checkCount(0), hitCount(0),
+      checkTime(0), minStackDepth(node->minStackDepth), widenedLow(0),
+      widenedHigh(0), programPoint(node->getProgramPoint()),
       nodeSequenceNumber(node->getNodeSequenceNumber()) {
-  std::map<ref<Expr>, ref<Expr> > substitution;
   existentials.clear();
-  interpolant = node->getInterpolant(existentials, substitution);
+  interpolant = node->getInterpolant(existentials, storeSubstitution);
   prevProgramPoint = node->getPrevProgramPoint();
   phiValues = node->getPhiValue();
 
   node->getStoredCoreExpressions(
-      callHistory, substitution, existentials, concretelyAddressedStore,
+      callHistory, storeSubstitution, existentials, concretelyAddressedStore,
       symbolicallyAddressedStore, concretelyAddressedHistoricalStore,
       symbolicallyAddressedHistoricalStore);
 
@@ -68,12 +219,116 @@ TxSubsumptionTableEntry::TxSubsumptionTableEntry(
     markedGlobal = node->getDependency()->getMarkedGlobal();
   }
 
-  if (WPInterpolant)
-    wpInterpolant = node->generateWPInterpolant();
+  updateSignature();
 }
 
+TxSubsumptionTableEntry::TxSubsumptionTableEntry(uintptr_t _programPoint)
+    : prevProgramPoint(0), pendingShadowing(false), pendingWP(false),
+      checkCount(0), hitCount(0), checkTime(0), minStackDepth(0),
+      widenedLow(0), widenedHigh(0), programPoint(_programPoint),
+      nodeSequenceNumber(0) {}
+
 TxSubsumptionTableEntry::~TxSubsumptionTableEntry() {}
 
+static void shadowValues(TxStore::LowerInterpolantStore &store,
+                         const std::map<ref<Expr>, ref<Expr> > &substitution,
+                         std::set<const Array *> &replacements) {
+  for (TxStore::LowerInterpolantStore::iterator it = store.begin(),
+                                                ie = store.end();
+       it != ie; ++it) {
+    it->second->shadow(substitution, replacements);
+    it->second = TxInterpolantValue::intern(it->second);
+  }
+}
+
+static void shadowValues(TxStore::TopInterpolantStore &store,
+                         const std::map<ref<Expr>, ref<Expr> > &substitution,
+                         std::set<const Array *> &replacements) {
+  for (TxStore::TopInterpolantStore::iterator it = store.begin(),
+                                              ie = store.end();
+       it != ie; ++it) {
+    shadowValues(it->second, substitution, replacements);
+  }
+}
+
+void TxSubsumptionTableEntry::shadowStores() {
+  if (!pendingShadowing)
+    return;
+  pendingShadowing = false;
+
+  // Without existential quantification the values are shadowed without
+  // substitution, and their shadow arrays are not recorded
+  std::map<ref<Expr>, ref<Expr> > noSubstitution;
+  std::set<const Array *> noReplacements;
+  bool quantified = true;
+#ifdef ENABLE_Z3
+  quantified = !NoExistential;
+#endif
+  const std::map<ref<Expr>, ref<Expr> > &substitution =
+      quantified ? storeSubstitution : noSubstitution;
+  std::set<const Array *> &replacements =
+      quantified ? existentials : noReplacements;
+
+  shadowValues(concretelyAddressedStore, substitution, replacements);
+  shadowValues(symbolicallyAddressedStore, substitution, replacements);
+  shadowValues(concretelyAddressedHistoricalStore, substitution, replacements);
+  shadowValues(symbolicallyAddressedHistoricalStore, substitution,
+               replacements);
+  storeSubstitution.clear();
+}
+
+unsigned TxSubsumptionTableEntry::hashQuery(const Query &query) {
+  unsigned result = query.expr->hash();
+  for (ConstraintManager::constraint_iterator it = query.constraints.begin(),
+                                              ie = query.constraints.end();
+       it != ie; ++it)
+    result ^= (*it)->hash();
+  return result;
+}
+
+bool TxSubsumptionTableEntry::lookupQuantifiedQuery(
+    const Query &query, Solver::Validity &validity,
+    std::vector<ref<Expr> > &unsatCore) {
+  std::map<unsigned, std::vector<QuantifiedQueryResult> >::const_iterator it =
+      quantifiedQueryCache.find(hashQuery(query));
+  if (it != quantifiedQueryCache.end()) {
+    for (std::vector<QuantifiedQueryResult>::const_iterator
+             it1 = it->second.begin(),
+             ie1 = it->second.end();
+         it1 != ie1; ++it1) {
+      // Expr comparison ignores the bound variables of ExistsExpr, hence we
+      // compare them separately.
+      ExistsExpr *cachedExists = llvm::dyn_cast<ExistsExpr>(it1->query);
+      ExistsExpr *queryExists = llvm::dyn_cast<ExistsExpr>(query.expr);
+      if (cachedExists && queryExists &&
+          cachedExists->variables != queryExists->variables)
+        continue;
+
+      if (*(it1->query.get()) == *(query.expr.get()) &&
+          it1->constraints == query.constraints) {
+        validity = it1->validity;
+        unsatCore = it1->unsatCore;
+        ++quantifiedQueryCacheHits;
+        return true;
+      }
+    }
+  }
+  ++quantifiedQueryCacheMisses;
+  return false;
+}
+
+void TxSubsumptionTableEntry::insertQuantifiedQuery(
+    const Query &query, Solver::Validity validity,
+    const std::vector<ref<Expr> > &unsatCore) {
+  if (quantifiedQueryCacheSize >= MaxQuantifiedQueryCacheSize) {
+    quantifiedQueryCache.clear();
+    quantifiedQueryCacheSize = 0;
+  }
+  quantifiedQueryCache[hashQuery(query)].push_back(QuantifiedQueryResult(
+      query.constraints, query.expr, validity, unsatCore));
+  ++quantifiedQueryCacheSize;
+}
+
 ref<Expr> TxSubsumptionTableEntry::makeConstraint(
     ExecutionState &state, ref<TxInterpolantValue> tabledValue,
     ref<TxInterpolantValue> stateValue, ref<Expr> tabledOffset,
@@ -200,6 +455,52 @@ ref<Expr> TxSubsumptionTableEntry::getBoundFreeConjunction(
   return expr;
 }
 
+Assignment *TxSubsumptionTableEntry::getStateModel(TimingSolver *solver,
+                                                   ExecutionState &state) {
+  std::vector<const Array *> objects;
+  for (unsigned i = 0; i < state.symbolics.size(); ++i)
+    objects.push_back(state.symbolics[i].second);
+
+  // The symbolics not bound by the model are left free, so that the
+  // expressions reading them are never evaluated to a constant.
+  std::vector<std::vector<unsigned char> > values;
+  std::vector<ref<Expr> > unsatCore;
+  if (!solver->getInitialValues(state, objects, values, unsatCore))
+    return new Assignment(true);
+  return new Assignment(objects, values, true);
+}
+
+bool TxSubsumptionTableEntry::isFalsifiedBy(Assignment &model,
+                                            std::set<const Array *> *variables,
+                                            ref<Expr> expr) {
+  if (ExistsExpr *existsExpr = llvm::dyn_cast<ExistsExpr>(expr))
+    return isFalsifiedBy(model, &existsExpr->variables, existsExpr->getKid(0));
+
+  if (llvm::isa<AndExpr>(expr))
+    return isFalsifiedBy(model, variables, expr->getKid(0)) ||
+           isFalsifiedBy(model, variables, expr->getKid(1));
+
+  // A conjunct with bound variables may be satisfied by other values of them
+  if (variables && hasVariableInSet(*variables, expr))
+    return false;
+
+  return model.evaluate(expr)->isFalse();
+}
+
+unsigned TxSubsumptionTableEntry::getExprSize(ref<Expr> expr) {
+  std::set<const Expr *> visited;
+  std::vector<const Expr *> worklist(1, expr.get());
+  while (!worklist.empty()) {
+    const Expr *e = worklist.back();
+    worklist.pop_back();
+    if (!visited.insert(e).second)
+      continue;
+    for (unsigned i = 0, n = e->getNumKids(); i < n; ++i)
+      worklist.push_back(e->getKid(i).get());
+  }
+  return visited.size();
+}
+
 bool TxSubsumptionTableEntry::hasVariableNotInSet(
     std::set<const Array *> &existentials, ref<Expr> expr) {
   for (int i = 0, numKids = expr->getNumKids(); i < numKids; ++i) {
@@ -402,37 +703,71 @@ TxSubsumptionTableEntry::simplifyArithmeticBody(ref<Expr> existsExpr,
   return existsExpr->rebuild(&newBody);
 }
 
-ref<Expr> TxSubsumptionTableEntry::replaceExpr(ref<Expr> originalExpr,
-                                               ref<Expr> replacedExpr,
-                                               ref<Expr> replacementExpr) {
-  // We only handle binary expressions
-  if (!llvm::isa<BinaryExpr>(originalExpr) ||
-      llvm::isa<ConcatExpr>(originalExpr))
-    return originalExpr;
+namespace {
+
+/// \brief Replaces a sub-expression with another within the binary
+/// expressions of an expression
+class TxReplacementRewriter : public TxExprRewriter {
+  ref<Expr> replacedExpr;
+
+  ref<Expr> replacementExpr;
+
+protected:
+  ref<Expr> rewriteNode(const ref<Expr> &originalExpr) {
+    // We only handle binary expressions
+    if (!llvm::isa<BinaryExpr>(originalExpr) ||
+        llvm::isa<ConcatExpr>(originalExpr))
+      return originalExpr;
+
+    if (originalExpr->getKid(0) == replacedExpr)
+      return TxShadowArray::createBinaryOfSameKind(
+          originalExpr, replacementExpr, originalExpr->getKid(1));
 
-  if (originalExpr->getKid(0) == replacedExpr)
-    return TxShadowArray::createBinaryOfSameKind(originalExpr, replacementExpr,
-                                                 originalExpr->getKid(1));
+    if (originalExpr->getKid(1) == replacedExpr)
+      return TxShadowArray::createBinaryOfSameKind(
+          originalExpr, originalExpr->getKid(0), replacementExpr);
 
-  if (originalExpr->getKid(1) == replacedExpr)
     return TxShadowArray::createBinaryOfSameKind(
-        originalExpr, originalExpr->getKid(0), replacementExpr);
+        originalExpr, rewrite(originalExpr->getKid(0)),
+        rewrite(originalExpr->getKid(1)));
+  }
+
+public:
+  TxReplacementRewriter(ref<Expr> _replacedExpr, ref<Expr> _replacementExpr)
+      : replacedExpr(_replacedExpr), replacementExpr(_replacementExpr) {}
+};
+
+/// \brief Searches for a sub-expression within the first two kids of the
+/// nodes of an expression
+class TxSubExpressionFinder : public TxExprFolder {
+  ref<Expr> subExpr;
+
+protected:
+  bool foldNode(const ref<Expr> &expr) {
+    if (expr == subExpr)
+      return false;
+    if (expr->getNumKids() < 2)
+      return true;
+
+    return fold(expr->getKid(0)) && fold(expr->getKid(1));
+  }
 
-  return TxShadowArray::createBinaryOfSameKind(
-      originalExpr,
-      replaceExpr(originalExpr->getKid(0), replacedExpr, replacementExpr),
-      replaceExpr(originalExpr->getKid(1), replacedExpr, replacementExpr));
+public:
+  TxSubExpressionFinder(ref<Expr> _subExpr) : subExpr(_subExpr) {}
+};
+}
+
+ref<Expr> TxSubsumptionTableEntry::replaceExpr(ref<Expr> originalExpr,
+                                               ref<Expr> replacedExpr,
+                                               ref<Expr> replacementExpr) {
+  TxReplacementRewriter rewriter(replacedExpr, replacementExpr);
+  return rewriter.rewrite(originalExpr);
 }
 
 bool TxSubsumptionTableEntry::hasSubExpression(ref<Expr> expr,
                                                ref<Expr> subExpr) {
-  if (expr == subExpr)
-    return true;
-  if (expr->getNumKids() < 2 && expr != subExpr)
-    return false;
-
-  return hasSubExpression(expr->getKid(0), subExpr) ||
-         hasSubExpression(expr->getKid(1), subExpr);
+  TxSubExpressionFinder finder(subExpr);
+  return !finder.fold(expr);
 }
 
 ref<Expr> TxSubsumptionTableEntry::simplifyInterpolantExpr(
@@ -714,6 +1049,303 @@ bool TxSubsumptionTableEntry::fetchExprEqualityConjucts(
          fetchExprEqualityConjucts(conjunction, expr->getKid(1));
 }
 
+/// \brief The maximum number of pairs of lower and upper bounds of a variable
+/// that bounds elimination combines
+static const unsigned MaxBoundPairs = 16;
+
+/// \brief Test whether the expression is an existentially-quantified variable,
+/// i.e., a read or concatenation of reads from an unmodified bound array
+static bool isBoundVariable(std::set<const Array *> &variables,
+                            ref<Expr> expr) {
+  if (ReadExpr *readExpr = llvm::dyn_cast<ReadExpr>(expr))
+    return !readExpr->updates.head && variables.count(readExpr->updates.root);
+  if (llvm::isa<ConcatExpr>(expr))
+    return isBoundVariable(variables, expr->getKid(0)) &&
+           isBoundVariable(variables, expr->getKid(1));
+  return false;
+}
+
+/// \brief Test whether the expression reads from any of the arrays
+static bool readsFrom(ref<Expr> expr, const std::set<const Array *> &arrays) {
+  std::vector<const Array *> objects;
+  findSymbolicObjects(expr, objects);
+  for (std::vector<const Array *>::iterator it = objects.begin(),
+                                            ie = objects.end();
+       it != ie; ++it) {
+    if (arrays.count(*it))
+      return true;
+  }
+  return false;
+}
+
+static std::set<const Array *> getArrays(ref<Expr> expr) {
+  std::vector<const Array *> objects;
+  findSymbolicObjects(expr, objects);
+  return std::set<const Array *>(objects.begin(), objects.end());
+}
+
+/// \brief Solve the equality lhs == rhs for a bound variable in lhs, by
+/// inverting the operations applied to it.
+static bool solveEquality(std::set<const Array *> &variables, ref<Expr> lhs,
+                          ref<Expr> rhs, ref<Expr> &variable,
+                          ref<Expr> &solution) {
+  while (!isBoundVariable(variables, lhs)) {
+    if (lhs->getWidth() == Expr::Bool || lhs->getNumKids() == 0)
+      return false;
+
+    ref<Expr> a = lhs->getKid(0);
+    bool inA = readsFrom(a, variables);
+    switch (lhs->getKind()) {
+    case Expr::Add:
+    case Expr::Sub:
+    case Expr::Xor: {
+      ref<Expr> b = lhs->getKid(1);
+      bool inB = readsFrom(b, variables);
+      if (inA == inB)
+        return false;
+      if (llvm::isa<AddExpr>(lhs)) {
+        rhs = SubExpr::create(rhs, inA ? b : a);
+      } else if (llvm::isa<SubExpr>(lhs)) {
+        rhs = inA ? AddExpr::create(rhs, b) : SubExpr::create(a, rhs);
+      } else {
+        rhs = XorExpr::create(rhs, inA ? b : a);
+      }
+      lhs = inA ? a : b;
+      break;
+    }
+    case Expr::ZExt:
+    case Expr::SExt: {
+      // An extension is only skinned when both sides have the same one
+      if (rhs->getKind() != lhs->getKind() ||
+          rhs->getKid(0)->getWidth() != a->getWidth())
+        return false;
+      lhs = a;
+      rhs = rhs->getKid(0);
+      break;
+    }
+    default:
+      return false;
+    }
+  }
+  variable = lhs;
+  solution = rhs;
+  return true;
+}
+
+/// \brief Eliminate a bound variable of the conjuncts using an equality
+/// solved for it, returning false when there is none.
+static bool applyOnePointRule(std::set<const Array *> &variables,
+                              std::vector<ref<Expr> > &conjuncts) {
+  for (unsigned i = 0; i < conjuncts.size(); ++i) {
+    if (!llvm::isa<EqExpr>(conjuncts[i]))
+      continue;
+
+    for (unsigned side = 0; side < 2; ++side) {
+      ref<Expr> variable, solution;
+      if (!readsFrom(conjuncts[i]->getKid(side), variables) ||
+          !solveEquality(variables, conjuncts[i]->getKid(side),
+                         conjuncts[i]->getKid(1 - side), variable, solution))
+        continue;
+
+      std::set<const Array *> arrays = getArrays(variable);
+      if (readsFrom(solution, arrays))
+        continue;
+
+      // The equality can only be dropped when the substitution removes all
+      // the reads of the arrays of the variable.
+      std::map<ref<Expr>, ref<Expr> > substitution;
+      substitution[variable] = solution;
+      std::vector<ref<Expr> > substituted;
+      unsigned j = 0;
+      for (; j < conjuncts.size(); ++j) {
+        if (j == i)
+          continue;
+        ref<Expr> conjunct =
+            TxSubstitutionVisitor(substitution).visit(conjuncts[j]);
+        if (readsFrom(conjunct, arrays))
+          break;
+        if (!conjunct->isTrue())
+          substituted.push_back(conjunct);
+      }
+      if (j < conjuncts.size())
+        continue;
+
+      conjuncts.swap(substituted);
+      return true;
+    }
+  }
+  return false;
+}
+
+/// \brief Retrieve the comparison a < b (when strict) or a <= b of a
+/// conjunct, including a negated one.
+static bool getComparison(ref<Expr> conjunct, ref<Expr> &a, ref<Expr> &b,
+                          bool &isSigned, bool &strict) {
+  bool negated = false;
+  if (llvm::isa<EqExpr>(conjunct) && conjunct->getKid(0)->isFalse()) {
+    conjunct = conjunct->getKid(1);
+    negated = true;
+  }
+
+  switch (conjunct->getKind()) {
+  case Expr::Ult:
+  case Expr::Slt:
+    strict = true;
+    break;
+  case Expr::Ule:
+  case Expr::Sle:
+    strict = false;
+    break;
+  default:
+    return false;
+  }
+  isSigned = llvm::isa<SltExpr>(conjunct) || llvm::isa<SleExpr>(conjunct);
+  a = conjunct->getKid(0);
+  b = conjunct->getKid(1);
+
+  // not (a < b) is b <= a, and not (a <= b) is b < a
+  if (negated) {
+    std::swap(a, b);
+    strict = !strict;
+  }
+  return true;
+}
+
+static ref<Expr> createComparison(bool isSigned, bool strict, ref<Expr> a,
+                                  ref<Expr> b) {
+  if (isSigned)
+    return strict ? SltExpr::create(a, b) : SleExpr::create(a, b);
+  return strict ? UltExpr::create(a, b) : UleExpr::create(a, b);
+}
+
+/// \brief Eliminate a bound variable of the conjuncts that only occurs in
+/// comparisons, returning false when there is none.
+static bool applyBoundsElimination(std::set<const Array *> &variables,
+                                   std::vector<ref<Expr> > &conjuncts) {
+  std::vector<ref<Expr> > candidates;
+  for (std::vector<ref<Expr> >::iterator it = conjuncts.begin(),
+                                         ie = conjuncts.end();
+       it != ie; ++it) {
+    ref<Expr> a, b;
+    bool isSigned, strict;
+    if (!getComparison(*it, a, b, isSigned, strict))
+      continue;
+    if (isBoundVariable(variables, a) &&
+        std::find(candidates.begin(), candidates.end(), a) == candidates.end())
+      candidates.push_back(a);
+    if (isBoundVariable(variables, b) &&
+        std::find(candidates.begin(), candidates.end(), b) == candidates.end())
+      candidates.push_back(b);
+  }
+
+  for (std::vector<ref<Expr> >::iterator it = candidates.begin(),
+                                         ie = candidates.end();
+       it != ie; ++it) {
+    ref<Expr> variable = *it;
+    std::set<const Array *> arrays = getArrays(variable);
+
+    // The bounds with whether they are strict
+    std::vector<std::pair<ref<Expr>, bool> > lowers, uppers;
+    std::vector<ref<Expr> > rest;
+    bool eliminable = true, first = true, variableSigned = false;
+    for (std::vector<ref<Expr> >::iterator it1 = conjuncts.begin(),
+                                           ie1 = conjuncts.end();
+         it1 != ie1 && eliminable; ++it1) {
+      if (!readsFrom(*it1, arrays)) {
+        rest.push_back(*it1);
+        continue;
+      }
+
+      ref<Expr> a, b;
+      bool isSigned, strict;
+      if (!getComparison(*it1, a, b, isSigned, strict) ||
+          (!first && isSigned != variableSigned)) {
+        eliminable = false;
+      } else if (a == variable && !readsFrom(b, arrays)) {
+        uppers.push_back(std::make_pair(b, strict));
+      } else if (b == variable && !readsFrom(a, arrays)) {
+        lowers.push_back(std::make_pair(a, strict));
+      } else {
+        eliminable = false;
+      }
+      first = false;
+      variableSigned = isSigned;
+    }
+    if (!eliminable || lowers.size() * uppers.size() > MaxBoundPairs)
+      continue;
+
+    Expr::Width width = variable->getWidth();
+    for (std::vector<std::pair<ref<Expr>, bool> >::iterator
+             it1 = lowers.begin(),
+             ie1 = lowers.end();
+         it1 != ie1; ++it1) {
+      for (std::vector<std::pair<ref<Expr>, bool> >::iterator
+               it2 = uppers.begin(),
+               ie2 = uppers.end();
+           it2 != ie2; ++it2) {
+        // With a strict lower bound l and a strict upper bound u, l + 1 < u
+        // is also needed for a value to lie in between.
+        rest.push_back(createComparison(variableSigned,
+                                        it1->second || it2->second,
+                                        it1->first, it2->first));
+        if (it1->second && it2->second)
+          rest.push_back(createComparison(
+              variableSigned, true,
+              AddExpr::create(it1->first, ConstantExpr::create(1, width)),
+              it2->first));
+      }
+
+      // Without upper bounds, a strict lower bound must not be the maximum
+      if (uppers.empty() && it1->second) {
+        ref<Expr> maximum = ConstantExpr::alloc(
+            variableSigned ? llvm::APInt::getSignedMaxValue(width)
+                           : llvm::APInt::getMaxValue(width));
+        rest.push_back(
+            createComparison(variableSigned, true, it1->first, maximum));
+      }
+    }
+
+    // Without lower bounds, a strict upper bound must not be the minimum
+    if (lowers.empty()) {
+      ref<Expr> minimum = ConstantExpr::alloc(
+          variableSigned ? llvm::APInt::getSignedMinValue(width)
+                         : llvm::APInt::getMinValue(width));
+      for (std::vector<std::pair<ref<Expr>, bool> >::iterator
+               it1 = uppers.begin(),
+               ie1 = uppers.end();
+           it1 != ie1; ++it1) {
+        if (it1->second)
+          rest.push_back(
+              createComparison(variableSigned, true, minimum, it1->first));
+      }
+    }
+
+    conjuncts.swap(rest);
+    return true;
+  }
+  return false;
+}
+
+ref<Expr> TxSubsumptionTableEntry::eliminateExistentials(
+    std::set<const Array *> &variables, ref<Expr> body) {
+  std::vector<ref<Expr> > conjuncts =
+      TxPartitionHelper::getExprsFromAndExpr(body);
+
+  bool eliminated = false;
+  while (applyOnePointRule(variables, conjuncts) ||
+         applyBoundsElimination(variables, conjuncts))
+    eliminated = true;
+  if (!eliminated)
+    return body;
+
+  ref<Expr> result = ConstantExpr::create(1, Expr::Bool);
+  for (std::vector<ref<Expr> >::iterator it = conjuncts.begin(),
+                                         ie = conjuncts.end();
+       it != ie; ++it)
+    result = AndExpr::create(result, *it);
+  return result;
+}
+
 ref<Expr>
 TxSubsumptionTableEntry::simplifyExistsExpr(ref<Expr> existsExpr,
                                             bool &hasExistentialsOnly) {
@@ -739,6 +1371,8 @@ TxSubsumptionTableEntry::simplifyExistsExpr(ref<Expr> existsExpr,
   }
 
   ref<Expr> newBody = AndExpr::create(interpolant, equalities);
+  if (ExistentialElimination)
+    newBody = eliminateExistentials(expr->variables, newBody);
 
   // FIXME: Need to test the performance of the following.
   if (!hasVariableInSet(expr->variables, newBody))
@@ -773,36 +1407,196 @@ void TxSubsumptionTableEntry::interpolateValues(
       instr->print(stream);
     }
   }
+  unsigned reasonTag = TxCoreReasons::intern(reason);
 
-  for (std::set<ref<TxStateValue> >::iterator it = coreValues.begin(),
-                                              ie = coreValues.end();
-       it != ie; ++it) {
-    state.txTreeNode->valuesInterpolation(*it, reason);
-  }
+  state.txTreeNode->valuesInterpolation(coreValues, reasonTag);
 
 #ifdef ENABLE_Z3
   if (TxDependency::boundInterpolation() && !ExactAddressInterpolant) {
-    reason = "interpolating memory bound for " + reason;
+    reasonTag =
+        TxCoreReasons::intern("interpolating memory bound for " + reason);
 
     for (std::map<ref<TxStateValue>, std::set<uint64_t> >::iterator
              it = corePointerValues.begin(),
              ie = corePointerValues.end();
          it != ie; ++it) {
       bool memoryError = state.txTreeNode->pointerValuesInterpolation(
-          it->first, it->second, reason);
+          it->first, it->second, reasonTag);
       assert(!memoryError && "interpolation should not result in memory error");
     }
   }
 #endif
 }
 
+bool TxSubsumptionTableEntry::evaluateWithPredictedTimeout(
+    TimingSolver *solver, ExecutionState &state, double timeout,
+    ref<Expr> expr, Solver::Validity &result,
+    std::vector<ref<Expr> > &unsatCore) {
+  TxQueryPredictor::Features features(state.constraints, expr, lastQuerySize);
+  double queryTimeout = timeout;
+  if (!TxQueryPredictor::predict(state.txTreeNode->getProgramPoint(), features,
+                                 queryTimeout))
+    return false;
+
+  double startTime = util::getWallTime();
+  solver->setTimeout(queryTimeout);
+  bool success = solver->evaluate(state, expr, result, unsatCore);
+  solver->setTimeout(0);
+  TxQueryPredictor::record(state.txTreeNode->getProgramPoint(), features,
+                           util::getWallTime() - startTime,
+                           !success && queryTimeout == timeout);
+  return success;
+}
+
+#ifdef ENABLE_Z3
+bool TxSubsumptionTableEntry::solveSubsumptionQuery(
+    TimingSolver *solver, ExecutionState &state, double timeout,
+    ref<Expr> expr, Solver::Validity &result,
+    std::vector<ref<Expr> > &unsatCore, int debugSubsumptionLevel) {
+  if (!llvm::isa<ExistsExpr>(expr))
+    return evaluateWithPredictedTimeout(solver, state, timeout, expr, result,
+                                        unsatCore);
+
+  // We instantiate a new Z3 solver to make sure that we use Z3 without
+  // pre-solving optimizations. It would be nice in the future to just run
+  // solver->evaluate so that the optimizations can be used, but this requires
+  // handling of quantified expressions by KLEE's pre-solving procedure, which
+  // does not exist currently.
+  Query query(state.constraints, expr);
+  if (SubsumptionQueryCache && lookupQuantifiedQuery(query, result, unsatCore))
+    return true;
+
+  TxQueryPredictor::Features features(state.constraints, expr,
+                                      lastQuerySize);
+  double queryTimeout = timeout;
+  if (!TxQueryPredictor::predict(state.txTreeNode->getProgramPoint(),
+                                 features, queryTimeout)) {
+    if (debugSubsumptionLevel >= 1) {
+      klee_message("#%lu=>#%lu: Check failure as the query is predicted to "
+                   "time out",
+                   state.txTreeNode->getNodeSequenceNumber(),
+                   nodeSequenceNumber);
+    }
+    return false;
+  }
+
+  double startTime = util::getWallTime();
+  Z3Solver *z3solver = new Z3Solver();
+  z3solver->setCoreSolverTimeout(queryTimeout);
+  bool success = z3solver->directComputeValidity(query, result, unsatCore);
+  z3solver->setCoreSolverTimeout(0);
+  delete z3solver;
+  TxQueryPredictor::record(state.txTreeNode->getProgramPoint(), features,
+                           util::getWallTime() - startTime,
+                           !success && queryTimeout == timeout);
+
+  // Only results decided by the solver are cached, as a timeout may not
+  // recur.
+  if (SubsumptionQueryCache && success)
+    insertQuantifiedQuery(query, result, unsatCore);
+  return success;
+}
+
+namespace {
+/// \brief Orders the partitions of a subsumption check query, the
+/// quantifier-free ones first, then the smallest ones first
+struct PartitionOrder {
+  bool operator()(const std::pair<unsigned, ref<Expr> > &a,
+                  const std::pair<unsigned, ref<Expr> > &b) const {
+    bool aQuantified = llvm::isa<ExistsExpr>(a.second),
+         bQuantified = llvm::isa<ExistsExpr>(b.second);
+    if (aQuantified != bQuantified)
+      return bQuantified;
+    return a.first < b.first;
+  }
+};
+}
+
+bool TxSubsumptionTableEntry::solvePartitioned(
+    TimingSolver *solver, ExecutionState &state, double timeout,
+    ref<Expr> expr, Solver::Validity &result,
+    std::vector<ref<Expr> > &unsatCore, int debugSubsumptionLevel) {
+  std::set<const Array *> noVariables;
+  const std::set<const Array *> *variables = &noVariables;
+  ref<Expr> body = expr;
+  if (ExistsExpr *existsExpr = llvm::dyn_cast<ExistsExpr>(expr)) {
+    variables = &existsExpr->variables;
+    body = existsExpr->body;
+  }
+
+  std::vector<std::vector<ref<Expr> > > groups;
+  std::vector<TxPartitionHelper::VarSet> groupVars;
+  if (SubsumptionPartitioning)
+    TxPartitionHelper::partition(body, groups, groupVars);
+  if (groups.size() <= 1)
+    return solveSubsumptionQuery(solver, state, timeout, expr, result,
+                                 unsatCore, debugSubsumptionLevel);
+
+  // The groups share no variable, bound or free, hence the query is valid
+  // when each group is, quantified over its own bound variables only
+  std::vector<std::pair<unsigned, ref<Expr> > > partitions;
+  for (unsigned i = 0, n = groups.size(); i != n; ++i) {
+    std::set<const Array *> bound;
+    for (std::set<const Array *>::const_iterator it = variables->begin(),
+                                                 ie = variables->end();
+         it != ie; ++it) {
+      if (groupVars[i].count(TxPartitionHelper::getArrayVar(*it)))
+        bound.insert(*it);
+    }
+    ref<Expr> partition = TxPartitionHelper::createAnd(groups[i]);
+    if (!bound.empty())
+      partition = ExistsExpr::create(bound, partition);
+    partitions.push_back(std::make_pair(getExprSize(partition), partition));
+  }
+  std::sort(partitions.begin(), partitions.end(), PartitionOrder());
+
+  std::vector<ref<Expr> > partitionCore;
+  for (std::vector<std::pair<unsigned, ref<Expr> > >::iterator
+           it = partitions.begin(),
+           ie = partitions.end();
+       it != ie; ++it) {
+    partitionCore.clear();
+    if (!solveSubsumptionQuery(solver, state, timeout, it->second, result,
+                               partitionCore, debugSubsumptionLevel))
+      return false;
+    if (result != Solver::True) {
+      if (debugSubsumptionLevel >= 2) {
+        klee_message("#%lu=>#%lu: Partition %lu of %lu is not valid",
+                     state.txTreeNode->getNodeSequenceNumber(),
+                     nodeSequenceNumber,
+                     (unsigned long)(it - partitions.begin() + 1),
+                     (unsigned long)partitions.size());
+      }
+      return true;
+    }
+    for (std::vector<ref<Expr> >::iterator coreIt = partitionCore.begin(),
+                                           coreIe = partitionCore.end();
+         coreIt != coreIe; ++coreIt) {
+      if (std::find(unsatCore.begin(), unsatCore.end(), *coreIt) ==
+          unsatCore.end())
+        unsatCore.push_back(*coreIt);
+    }
+  }
+  return true;
+}
+#endif
+
 bool TxSubsumptionTableEntry::subsumed(
     TimingSolver *solver, ExecutionState &state, double timeout,
-    bool leftRetrieval, TxStore::TopStateStore &__internalStore,
-    TxStore::LowerStateStore &__concretelyAddressedHistoricalStore,
-    TxStore::LowerStateStore &__symbolicallyAddressedHistoricalStore,
-    int debugSubsumptionLevel) {
+    bool leftRetrieval, const TxStore::StateStoreView &stateStore,
+    Assignment *&stateModel, int debugSubsumptionLevel) {
 #ifdef ENABLE_Z3
+  lastCheckFailure = StoreMismatch;
+  lastQuerySize = 0;
+
+  shadowStores();
+
+  const TxStore::TopStateStore &__internalStore =
+      stateStore.getInternalStore();
+  const TxStore::LowerStateStore &__concretelyAddressedHistoricalStore =
+      stateStore.getConcretelyAddressedHistoricalStore();
+  const TxStore::LowerStateStore &__symbolicallyAddressedHistoricalStore =
+      stateStore.getSymbolicallyAddressedHistoricalStore();
 
   if (MarkGlobal) {
     // Global check
@@ -1019,7 +1813,7 @@ bool TxSubsumptionTableEntry::subsumed(
   std::map<ref<TxStateValue>, std::set<uint64_t> > corePointerValues;
 
   {
-    TimerStatIncrementer t(concretelyAddressedStoreExpressionBuildTime);
+    TX_TIMER(concretelyAddressedStoreExpressionBuildTime);
 
     // Build constraints from concrete-address interpolant store
     for (TxStore::TopInterpolantStore::const_iterator
@@ -1029,7 +1823,8 @@ bool TxSubsumptionTableEntry::subsumed(
       assert(!it1->second.empty() && "empty table entry with real index");
 
       const TxStore::LowerInterpolantStore &tabledConcreteMap = it1->second;
-      TxStore::TopStateStore::iterator mIt = __internalStore.find(it1->first);
+      TxStore::TopStateStore::const_iterator mIt =
+          __internalStore.find(it1->first);
       if (mIt == __internalStore.end()) {
         if (debugSubsumptionLevel >= 1) {
           std::string msg;
@@ -1045,7 +1840,7 @@ bool TxSubsumptionTableEntry::subsumed(
         return false;
       }
 
-      TxStore::MiddleStateStore &m = mIt->second;
+      const TxStore::MiddleStateStore &m = mIt->second;
 
       for (TxStore::LowerInterpolantStore::const_iterator
                it2 = tabledConcreteMap.begin(),
@@ -1140,8 +1935,18 @@ bool TxSubsumptionTableEntry::subsumed(
               coreValues.insert(stateValue->getOriginalValue());
             }
           } else {
-            res = EqExpr::create(tabledValue->getExpression(),
-                                 stateValue->getExpression());
+            ref<Expr> stateExpr = stateValue->getExpression();
+            if (!widenedVariable.isNull() && it2->first == widenedVariable &&
+                it1->first == widenedContext) {
+              Expr::Width width = stateExpr->getWidth();
+              res = AndExpr::create(
+                  UleExpr::create(ConstantExpr::create(widenedLow, width),
+                                  stateExpr),
+                  UleExpr::create(stateExpr,
+                                  ConstantExpr::create(widenedHigh, width)));
+            } else {
+              res = EqExpr::create(tabledValue->getExpression(), stateExpr);
+            }
             if (res->isFalse()) {
               if (debugSubsumptionLevel >= 1) {
                 if (debugSubsumptionLevel >= 2) {
@@ -1317,7 +2122,7 @@ bool TxSubsumptionTableEntry::subsumed(
   }
 
   {
-    TimerStatIncrementer t(symbolicallyAddressedStoreExpressionBuildTime);
+    TX_TIMER(symbolicallyAddressedStoreExpressionBuildTime);
     // Build constraints from symbolic-address interpolant store
     for (TxStore::TopInterpolantStore::const_iterator
              it1 = symbolicallyAddressedStore.begin(),
@@ -1326,7 +2131,8 @@ bool TxSubsumptionTableEntry::subsumed(
       assert(!it1->second.empty() && "empty table entry with real index");
 
       const TxStore::LowerInterpolantStore &tabledSymbolicMap = it1->second;
-      TxStore::TopStateStore::iterator mIt = __internalStore.find(it1->first);
+      TxStore::TopStateStore::const_iterator mIt =
+          __internalStore.find(it1->first);
       if (mIt == __internalStore.end()) {
         if (debugSubsumptionLevel >= 1) {
           std::string msg;
@@ -1342,7 +2148,7 @@ bool TxSubsumptionTableEntry::subsumed(
         return false;
       }
 
-      TxStore::MiddleStateStore &m = mIt->second;
+      const TxStore::MiddleStateStore &m = mIt->second;
 
       ref<Expr> conjunction;
 
@@ -1476,7 +2282,7 @@ bool TxSubsumptionTableEntry::subsumed(
   ref<Expr> expr; // The query expression
 
   {
-    TimerStatIncrementer t(solverAccessTime);
+    TX_TIMER(solverAccessTime);
 
     // Here we build the query expression, after which it is always a
     // conjunction of the interpolant and the state equality constraints. Here
@@ -1533,6 +2339,7 @@ bool TxSubsumptionTableEntry::subsumed(
     // If query expression simplification result was false, we quickly fail
     // without calling the solver
     if (expr->isFalse()) {
+      lastCheckFailure = SimplificationFailure;
       if (debugSubsumptionLevel >= 1) {
         klee_message("#%lu=>#%lu: Check failure as consequent is unsatisfiable",
                      state.txTreeNode->getNodeSequenceNumber(),
@@ -1544,6 +2351,7 @@ bool TxSubsumptionTableEntry::subsumed(
     bool success = false;
 
     if (!detectConflictPrimitives(state, expr)) {
+      lastCheckFailure = SimplificationFailure;
       if (debugSubsumptionLevel >= 1) {
         klee_message(
             "#%lu=>#%lu: Check failure as contradictory equalities detected",
@@ -1552,6 +2360,25 @@ bool TxSubsumptionTableEntry::subsumed(
       return false;
     }
 
+    // A model of the path condition that falsifies the query shows that it is
+    // not valid, which is much cheaper to find out than by the solver,
+    // especially for existentially-quantified queries.
+    if (SubsumptionModelCheck && !llvm::isa<ConstantExpr>(expr)) {
+      if (!stateModel)
+        stateModel = getStateModel(solver, state);
+      if (isFalsifiedBy(*stateModel, 0, expr)) {
+        ++modelRejectionCount;
+        lastCheckFailure = ModelRefutation;
+        if (debugSubsumptionLevel >= 1) {
+          klee_message("#%lu=>#%lu: Check failure as a model of the path "
+                       "condition falsifies the query",
+                       state.txTreeNode->getNodeSequenceNumber(),
+                       nodeSequenceNumber);
+        }
+        return false;
+      }
+    }
+
     std::vector<ref<Expr> > unsatCore;
 
     // We call the solver only when the simplified query expression is not a
@@ -1603,25 +2430,12 @@ bool TxSubsumptionTableEntry::subsumed(
                              state.constraints, expr).c_str());
           }
 
-          if (llvm::isa<ExistsExpr>(expr)) {
-            // We instantiate a new Z3 solver to make sure that we use Z3
-            // without pre-solving optimizations. It would be nice in the future
-            // to just run solver->evaluate so that the optimizations can be
-            // used, but this requires handling of quantified expressions by
-            // KLEE's pre-solving procedure, which does not exist currently.
-            Z3Solver *z3solver = new Z3Solver();
-            z3solver->setCoreSolverTimeout(timeout);
-            success = z3solver->directComputeValidity(
-                Query(state.constraints, expr), result, unsatCore);
-            z3solver->setCoreSolverTimeout(0);
-            delete z3solver;
-          } else {
-            solver->setTimeout(timeout);
-            success = solver->evaluate(state, expr, result, unsatCore);
-            solver->setTimeout(0);
-          }
+          lastQuerySize = getExprSize(expr);
+          success = solvePartitioned(solver, state, timeout, expr, result,
+                                     unsatCore, debugSubsumptionLevel);
 
           if (!success || result != Solver::True) {
+            lastCheckFailure = success ? SolverInvalid : SolverTimeout;
             if (debugSubsumptionLevel >= 1) {
               klee_message("#%lu=>#%lu: Check failure as solved did not decide "
                            "validity of existentially-quantified query",
@@ -1640,11 +2454,12 @@ bool TxSubsumptionTableEntry::subsumed(
         }
         // We call the solver in the standard way if the
         // formula is unquantified.
-        solver->setTimeout(timeout);
-        success = solver->evaluate(state, expr, result, unsatCore);
-        solver->setTimeout(0);
+        lastQuerySize = getExprSize(expr);
+        success = solvePartitioned(solver, state, timeout, expr, result,
+                                   unsatCore, debugSubsumptionLevel);
 
         if (!success || result != Solver::True) {
+          lastCheckFailure = success ? SolverInvalid : SolverTimeout;
           if (debugSubsumptionLevel >= 1) {
             klee_message(
                 "#%lu=>#%lu: Check failure as solved did not decide validity",
@@ -1676,6 +2491,7 @@ bool TxSubsumptionTableEntry::subsumed(
         }
         return true;
       }
+      lastCheckFailure = SimplificationFailure;
       if (debugSubsumptionLevel >= 1) {
         klee_message(
             "#%lu=>#%lu: Check failure as query expression is non-true",
@@ -1711,9 +2527,149 @@ bool TxSubsumptionTableEntry::subsumed(
   return false;
 }
 
-ref<Expr> TxSubsumptionTableEntry::getInterpolant() const {
-  return interpolant;
-}
+/// \brief Test whether two interpolant values are known to be the same
+/// constraint on the state values. Pointer values are only compared by
+/// identity, as their checks involve their allocations and bounds.
+static bool equalValues(ref<TxInterpolantValue> first,
+                        ref<TxInterpolantValue> second) {
+  if (first.get() == second.get())
+    return true;
+  if (first->isPointer() || second->isPointer())
+    return false;
+  return first->getExpression() == second->getExpression();
+}
+
+static bool equalStores(const TxStore::LowerInterpolantStore &first,
+                        const TxStore::LowerInterpolantStore &second) {
+  if (first.size() != second.size())
+    return false;
+  for (TxStore::LowerInterpolantStore::const_iterator it1 = first.begin(),
+                                                      ie1 = first.end(),
+                                                      it2 = second.begin();
+       it1 != ie1; ++it1, ++it2) {
+    if (!(it1->first == it2->first) || !equalValues(it1->second, it2->second))
+      return false;
+  }
+  return true;
+}
+
+static bool equalStores(const TxStore::TopInterpolantStore &first,
+                        const TxStore::TopInterpolantStore &second) {
+  if (first.size() != second.size())
+    return false;
+  for (TxStore::TopInterpolantStore::const_iterator it1 = first.begin(),
+                                                    ie1 = first.end(),
+                                                    it2 = second.begin();
+       it1 != ie1; ++it1, ++it2) {
+    if (!(it1->first == it2->first) || !equalStores(it1->second, it2->second))
+      return false;
+  }
+  return true;
+}
+
+/// \brief Test whether an interpolant value is a constant that can be
+/// widened into a range
+static bool isWidenable(ref<TxInterpolantValue> value) {
+  return !value->isPointer() &&
+         llvm::isa<ConstantExpr>(value->getExpression()) &&
+         value->getExpression()->getWidth() <= Expr::Int64;
+}
+
+bool TxSubsumptionTableEntry::getWideningLocation(
+    const TxSubsumptionTableEntry *other, ref<TxAllocationContext> &context,
+    ref<TxVariable> &variable) const {
+  if (pendingWP || other->pendingWP || !wpInterpolant.isNull() ||
+      !other->wpInterpolant.isNull() || !markedGlobal.empty() ||
+      !other->markedGlobal.empty() ||
+      prevProgramPoint != other->prevProgramPoint ||
+      existentials != other->existentials || phiValues != other->phiValues)
+    return false;
+
+  if (interpolant.isNull() != other->interpolant.isNull() ||
+      (!interpolant.isNull() && !(interpolant == other->interpolant)))
+    return false;
+
+  if (!equalStores(symbolicallyAddressedStore,
+                   other->symbolicallyAddressedStore) ||
+      !equalStores(concretelyAddressedHistoricalStore,
+                   other->concretelyAddressedHistoricalStore) ||
+      !equalStores(symbolicallyAddressedHistoricalStore,
+                   other->symbolicallyAddressedHistoricalStore))
+    return false;
+
+  // An entry already widened can only be widened further at the same
+  // location
+  if (!widenedVariable.isNull() && !other->widenedVariable.isNull() &&
+      (!(widenedContext == other->widenedContext) ||
+       !(widenedVariable == other->widenedVariable)))
+    return false;
+  if (!widenedVariable.isNull()) {
+    context = widenedContext;
+    variable = widenedVariable;
+  } else if (!other->widenedVariable.isNull()) {
+    context = other->widenedContext;
+    variable = other->widenedVariable;
+  }
+
+  if (concretelyAddressedStore.size() !=
+      other->concretelyAddressedStore.size())
+    return false;
+
+  bool found = false;
+  for (TxStore::TopInterpolantStore::const_iterator
+           it1 = concretelyAddressedStore.begin(),
+           ie1 = concretelyAddressedStore.end(),
+           it2 = other->concretelyAddressedStore.begin();
+       it1 != ie1; ++it1, ++it2) {
+    if (!(it1->first == it2->first) ||
+        it1->second.size() != it2->second.size())
+      return false;
+
+    for (TxStore::LowerInterpolantStore::const_iterator
+             it3 = it1->second.begin(),
+             ie3 = it1->second.end(), it4 = it2->second.begin();
+         it3 != ie3; ++it3, ++it4) {
+      if (!(it3->first == it4->first))
+        return false;
+
+      bool atLocation = !variable.isNull() && it3->first == variable &&
+                        it1->first == context;
+      if (!atLocation && equalValues(it3->second, it4->second))
+        continue;
+      if (!isWidenable(it3->second) || !isWidenable(it4->second) ||
+          it3->second->getExpression()->getWidth() !=
+              it4->second->getExpression()->getWidth())
+        return false;
+      if (atLocation)
+        continue;
+      if (found || !variable.isNull())
+        return false;
+      found = true;
+      context = it1->first;
+      variable = it3->first;
+    }
+  }
+  return !variable.isNull();
+}
+
+void TxSubsumptionTableEntry::getWidenedRange(ref<TxAllocationContext> context,
+                                              ref<TxVariable> variable,
+                                              uint64_t &low,
+                                              uint64_t &high) const {
+  if (!widenedVariable.isNull()) {
+    low = widenedLow;
+    high = widenedHigh;
+    return;
+  }
+  ref<TxInterpolantValue> value =
+      concretelyAddressedStore.find(context)->second.find(variable)->second;
+  low = high =
+      llvm::cast<ConstantExpr>(value->getExpression())->getZExtValue();
+}
+
+ref<Expr> TxSubsumptionTableEntry::getInterpolant() const {
+  return interpolant;
+}
 
 ref<Expr> TxSubsumptionTableEntry::getWPInterpolant() const {
   return wpInterpolant;
@@ -1721,25 +2677,30 @@ ref<Expr> TxSubsumptionTableEntry::getWPInterpolant() const {
 
 TxStore::LowerInterpolantStore
 TxSubsumptionTableEntry::getConcretelyAddressedHistoricalStore() const {
+  const_cast<TxSubsumptionTableEntry *>(this)->shadowStores();
   return concretelyAddressedHistoricalStore;
 }
 
 TxStore::LowerInterpolantStore
 TxSubsumptionTableEntry::getSymbolicallyAddressedHistoricalStore() const {
+  const_cast<TxSubsumptionTableEntry *>(this)->shadowStores();
   return symbolicallyAddressedHistoricalStore;
 }
 
 TxStore::TopInterpolantStore
 TxSubsumptionTableEntry::getConcretelyAddressedStore() const {
+  const_cast<TxSubsumptionTableEntry *>(this)->shadowStores();
   return concretelyAddressedStore;
 }
 
 TxStore::TopInterpolantStore
 TxSubsumptionTableEntry::getSymbolicallyAddressedStore() const {
+  const_cast<TxSubsumptionTableEntry *>(this)->shadowStores();
   return symbolicallyAddressedStore;
 }
 
 std::set<const Array *> TxSubsumptionTableEntry::getExistentials() const {
+  const_cast<TxSubsumptionTableEntry *>(this)->shadowStores();
   return existentials;
 }
 
@@ -1753,26 +2714,35 @@ void TxSubsumptionTableEntry::setWPInterpolant(ref<Expr> _wpInterpolant) {
 
 void TxSubsumptionTableEntry::setConcretelyAddressedHistoricalStore(
     TxStore::LowerInterpolantStore _concretelyAddressedHistoricalStore) {
+  shadowStores();
   concretelyAddressedHistoricalStore = _concretelyAddressedHistoricalStore;
+  updateSignature();
 }
 
 void TxSubsumptionTableEntry::setSymbolicallyAddressedHistoricalStore(
     TxStore::LowerInterpolantStore _symbolicallyAddressedHistoricalStore) {
+  shadowStores();
   symbolicallyAddressedHistoricalStore = _symbolicallyAddressedHistoricalStore;
+  updateSignature();
 }
 
 void TxSubsumptionTableEntry::setConcretelyAddressedStore(
     TxStore::TopInterpolantStore _concretelyAddressedStore) {
+  shadowStores();
   concretelyAddressedStore = _concretelyAddressedStore;
+  updateSignature();
 }
 
 void TxSubsumptionTableEntry::setSymbolicallyAddressedStore(
     TxStore::TopInterpolantStore _symbolicallyAddressedStore) {
+  shadowStores();
   symbolicallyAddressedStore = _symbolicallyAddressedStore;
+  updateSignature();
 }
 
 void TxSubsumptionTableEntry::setExistentials(
     std::set<const Array *> _existentials) {
+  shadowStores();
   existentials = _existentials;
 }
 
@@ -1790,6 +2760,8 @@ void TxSubsumptionTableEntry::print(llvm::raw_ostream &stream,
   std::string tabsNext = appendTab(prefix);
   std::string tabsNextNext = appendTab(tabsNext);
 
+  const_cast<TxSubsumptionTableEntry *>(this)->shadowStores();
+
   stream << prefix << "------------ Subsumption Table Entry ------------\n";
   stream << prefix << "Program point = " << programPoint << "\n";
   if (MarkGlobal) {
@@ -1807,6 +2779,10 @@ void TxSubsumptionTableEntry::print(llvm::raw_ostream &stream,
   else
     stream << "(empty)";
 
+  if (!widenedVariable.isNull())
+    stream << "\n" << prefix << "widened range = [" << widenedLow << ", "
+           << widenedHigh << "]";
+
   stream << "\n" << prefix << "concretely-addressed store = [";
   if (!concretelyAddressedStore.empty()) {
     stream << "\n";
@@ -1943,6 +2919,17 @@ void TxSubsumptionTableEntry::printStat(std::stringstream &stream) {
                 1000 << "\n";
   stream << "KLEE: done:     Solver access time (ms) = "
          << ((double)solverAccessTime.getValue()) / 1000 << "\n";
+  stream << "KLEE: done:     Table entries rejected by store pre-filter = "
+         << preFilterRejectionCount.getValue() << "\n";
+  stream << "KLEE: done:     Table entries rejected by path condition model = "
+         << modelRejectionCount.getValue() << "\n";
+  stream << "KLEE: done:     Quantified query cache hits (misses) = "
+         << quantifiedQueryCacheHits.getValue() << " ("
+         << quantifiedQueryCacheMisses.getValue() << ")\n";
+  stream << "KLEE: done:     Queries skipped as predicted to time out "
+            "(with shortened timeout) = "
+         << TxQueryPredictor::skippedQueryCount.getValue() << " ("
+         << TxQueryPredictor::shortenedTimeoutCount.getValue() << ")\n";
 }
 
 /**/
@@ -2015,7 +3002,7 @@ void TxSubsumptionTable::CallHistoryIndexedTable::insert(
     std::map<llvm::Instruction *, Node *>::const_iterator it1 =
         current->next.find(call);
     if (it1 == current->next.end()) {
-      Node *newNode = new Node(call);
+      Node *newNode = new Node(call, current);
       current->next[*it] = newNode;
       current = newNode;
     } else {
@@ -2023,27 +3010,152 @@ void TxSubsumptionTable::CallHistoryIndexedTable::insert(
     }
   }
   current->entryList.push_back(entry);
+
+  // Keeps the first node in case of a collision, which find() detects
+  index.insert(
+      std::make_pair(TxTreeNode::getCallHistoryHash(callHistory), current));
 }
 
-std::pair<TxSubsumptionTable::EntryIterator, TxSubsumptionTable::EntryIterator>
-TxSubsumptionTable::CallHistoryIndexedTable::find(
-    const std::vector<llvm::Instruction *> &callHistory, bool &found) const {
+std::deque<TxSubsumptionTableEntry *> *
+TxSubsumptionTable::CallHistoryIndexedTable::getEntryList(
+    const std::vector<llvm::Instruction *> &callHistory) {
   Node *current = root;
-  std::pair<EntryIterator, EntryIterator> ret;
-
   for (std::vector<llvm::Instruction *>::const_iterator
            it = callHistory.begin(),
            ie = callHistory.end();
        it != ie; ++it) {
-    llvm::Instruction *call = *it;
     std::map<llvm::Instruction *, Node *>::const_iterator it1 =
-        current->next.find(call);
-    if (it1 == current->next.end()) {
-      found = false;
-      return ret;
-    }
+        current->next.find(*it);
+    if (it1 == current->next.end())
+      return 0;
     current = it1->second;
   }
+  return &current->entryList;
+}
+
+void TxSubsumptionTable::CallHistoryIndexedTable::getEntries(
+    Node *node, std::vector<TxSubsumptionTableEntry *> &entries) const {
+  entries.insert(entries.end(), node->entryList.begin(),
+                 node->entryList.end());
+  for (std::map<llvm::Instruction *, Node *>::const_iterator
+           it = node->next.begin(),
+           ie = node->next.end();
+       it != ie; ++it)
+    getEntries(it->second, entries);
+}
+
+unsigned TxSubsumptionTable::CallHistoryIndexedTable::removeEntries(
+    Node *node, const std::set<TxSubsumptionTableEntry *> &evicted) {
+  unsigned removed = 0;
+  std::deque<TxSubsumptionTableEntry *> kept;
+  for (std::deque<TxSubsumptionTableEntry *>::iterator
+           it = node->entryList.begin(),
+           ie = node->entryList.end();
+       it != ie; ++it) {
+    if (evicted.count(*it)) {
+      TxTreeGraph::removeTableEntryMapping(*it);
+      delete *it;
+      ++removed;
+    } else {
+      kept.push_back(*it);
+    }
+  }
+  if (removed)
+    node->entryList.swap(kept);
+
+  for (std::map<llvm::Instruction *, Node *>::iterator it = node->next.begin(),
+                                                       ie = node->next.end();
+       it != ie; ++it)
+    removed += removeEntries(it->second, evicted);
+  return removed;
+}
+
+void TxSubsumptionTable::CallHistoryIndexedTable::getUnconditionalCallHistories(
+    Node *node, std::vector<llvm::Instruction *> &history,
+    std::vector<std::vector<llvm::Instruction *> > &histories) const {
+  // A single unconditional entry per node suffices, as it subsumes all states
+  for (std::deque<TxSubsumptionTableEntry *>::const_iterator
+           it = node->entryList.begin(),
+           ie = node->entryList.end();
+       it != ie; ++it) {
+    if ((*it)->isUnconditional()) {
+      histories.push_back(history);
+      break;
+    }
+  }
+
+  for (std::map<llvm::Instruction *, Node *>::const_iterator
+           it = node->next.begin(),
+           ie = node->next.end();
+       it != ie; ++it) {
+    history.push_back(it->first);
+    getUnconditionalCallHistories(it->second, history, histories);
+    history.pop_back();
+  }
+}
+
+bool TxSubsumptionTable::CallHistoryIndexedTable::hasUnconditionalEntry(
+    const std::vector<llvm::Instruction *> &callHistory) const {
+  bool found;
+  std::pair<EntryIterator, EntryIterator> iterPair =
+      find(callHistory, TxTreeNode::getCallHistoryHash(callHistory), found);
+  if (!found)
+    return false;
+  for (EntryIterator it = iterPair.first, ie = iterPair.second; it != ie;
+       ++it) {
+    if ((*it)->isUnconditional())
+      return true;
+  }
+  return false;
+}
+
+bool TxSubsumptionTable::CallHistoryIndexedTable::Node::matches(
+    const std::vector<llvm::Instruction *> &callHistory) const {
+  if (depth != callHistory.size())
+    return false;
+  const Node *current = this;
+  for (std::vector<llvm::Instruction *>::const_reverse_iterator
+           it = callHistory.rbegin(),
+           ie = callHistory.rend();
+       it != ie; ++it) {
+    if (current->id != *it)
+      return false;
+    current = current->parent;
+  }
+  return true;
+}
+
+std::pair<TxSubsumptionTable::EntryIterator, TxSubsumptionTable::EntryIterator>
+TxSubsumptionTable::CallHistoryIndexedTable::find(
+    const std::vector<llvm::Instruction *> &callHistory,
+    uint64_t callHistoryHash, bool &found) const {
+  std::pair<EntryIterator, EntryIterator> ret;
+
+  // The histories without entries are not indexed
+  llvm::DenseMap<uint64_t, Node *>::const_iterator indexIt =
+      index.find(callHistoryHash);
+  if (indexIt == index.end()) {
+    found = false;
+    return ret;
+  }
+
+  Node *current = indexIt->second;
+  if (!current->matches(callHistory)) {
+    // Hash collision: walk the trie
+    current = root;
+    for (std::vector<llvm::Instruction *>::const_iterator
+             it = callHistory.begin(),
+             ie = callHistory.end();
+         it != ie; ++it) {
+      std::map<llvm::Instruction *, Node *>::const_iterator it1 =
+          current->next.find(*it);
+      if (it1 == current->next.end()) {
+        found = false;
+        return ret;
+      }
+      current = it1->second;
+    }
+  }
   found = true;
   return std::pair<EntryIterator, EntryIterator>(current->entryList.rbegin(),
                                                  current->entryList.rend());
@@ -2070,8 +3182,25 @@ void TxSubsumptionTable::CallHistoryIndexedTable::print(
 
 /**/
 
-std::map<uintptr_t, TxSubsumptionTable::CallHistoryIndexedTable *>
-TxSubsumptionTable::instance;
+TxSubsumptionTable::TableMap TxSubsumptionTable::instance;
+
+TxSubsumptionTable::EntryCountMap TxSubsumptionTable::entryCount;
+
+std::map<uintptr_t, TxSubsumptionTable::ProgramPointProfile>
+TxSubsumptionTable::profile;
+
+unsigned TxSubsumptionTable::totalEntryCount = 0;
+
+uint64_t TxSubsumptionTable::evictionCount = 0;
+
+uint64_t TxSubsumptionTable::widenedEntryCount = 0;
+
+uint64_t TxSubsumptionTable::redundantEntryCount = 0;
+
+std::map<uintptr_t, std::vector<TxSubsumptionTableEntry *> >
+TxSubsumptionTable::summaries;
+
+uint64_t TxSubsumptionTable::summaryHitCount = 0;
 
 void
 TxSubsumptionTable::insert(uintptr_t id,
@@ -2080,18 +3209,376 @@ TxSubsumptionTable::insert(uintptr_t id,
   CallHistoryIndexedTable *subTable = 0;
 
   TxTree::entryNumber++; // Count of entries in the table
+  ++entryCount[id];
 
-  std::map<uintptr_t, CallHistoryIndexedTable *>::iterator it =
-      instance.find(id);
+  TableMap::iterator it = instance.find(id);
 
   if (it == instance.end()) {
     subTable = new CallHistoryIndexedTable();
-    subTable->insert(callHistory, entry);
     instance[id] = subTable;
-    return;
+  } else {
+    subTable = it->second;
   }
-  subTable = it->second;
   subTable->insert(callHistory, entry);
+
+  ++totalEntryCount;
+  if (MaxSubsumptionTableEntries &&
+      totalEntryCount > MaxSubsumptionTableEntries)
+    evict(MaxSubsumptionTableEntries - MaxSubsumptionTableEntries / 4);
+}
+
+/// \brief The number of the latest entries of the same program point and call
+/// history that a new entry is merged with
+static const unsigned MergeCandidateCount = 8;
+
+/// \brief Test whether the antecedent is known to imply the consequent.
+static bool mustImply(TimingSolver *solver, ref<Expr> antecedent,
+                      ref<Expr> consequent) {
+  ConstraintManager constraints;
+  bool result = false;
+  if (!solver->solver->mustBeTrue(
+          Query(constraints, OrExpr::create(Expr::createIsZero(antecedent),
+                                            consequent)),
+          result))
+    return false;
+  return result;
+}
+
+/// \brief Return the disjunction of two conjunctions that only differ by one
+/// conjunct, with their common conjuncts factored out, or NULL when they
+/// differ otherwise.
+static ref<Expr> mergeConjunctions(ref<Expr> first, ref<Expr> second) {
+  std::vector<ref<Expr> > firstRest =
+      TxPartitionHelper::getExprsFromAndExpr(first);
+  std::vector<ref<Expr> > secondRest =
+      TxPartitionHelper::getExprsFromAndExpr(second);
+  std::vector<ref<Expr> > common;
+  for (std::vector<ref<Expr> >::iterator it = firstRest.begin();
+       it != firstRest.end();) {
+    std::vector<ref<Expr> >::iterator found =
+        std::find(secondRest.begin(), secondRest.end(), *it);
+    if (found == secondRest.end()) {
+      ++it;
+      continue;
+    }
+    common.push_back(*it);
+    secondRest.erase(found);
+    it = firstRest.erase(it);
+  }
+
+  ref<Expr> ret;
+  if (firstRest.size() != 1 || secondRest.size() != 1)
+    return ret;
+  ret = OrExpr::create(firstRest[0], secondRest[0]);
+  if (!common.empty())
+    ret = AndExpr::create(TxPartitionHelper::createAnd(common), ret);
+  return ret;
+}
+
+bool TxSubsumptionTable::merge(
+    TimingSolver *solver, uintptr_t id,
+    const std::vector<llvm::Instruction *> &callHistory,
+    TxSubsumptionTableEntry *entry, int debugSubsumptionLevel) {
+  if (!entry->hasInterpolantOnly())
+    return true;
+
+  TableMap::iterator it = instance.find(id);
+  if (it == instance.end())
+    return true;
+  std::deque<TxSubsumptionTableEntry *> *entryList =
+      it->second->getEntryList(callHistory);
+  if (!entryList)
+    return true;
+
+  unsigned compared = 0;
+  for (std::deque<TxSubsumptionTableEntry *>::iterator
+           it1 = entryList->end();
+       it1 != entryList->begin() && compared < MergeCandidateCount;) {
+    --it1;
+    TxSubsumptionTableEntry *older = *it1;
+    if (!older->hasInterpolantOnly() ||
+        older->prevProgramPoint != entry->prevProgramPoint)
+      continue;
+    ++compared;
+
+    // A null interpolant is true
+    ref<Expr> olderInterpolant = older->interpolant;
+    ref<Expr> newInterpolant = entry->interpolant;
+    if (olderInterpolant.isNull() ||
+        (!newInterpolant.isNull() &&
+         (newInterpolant == olderInterpolant ||
+          mustImply(solver, newInterpolant, olderInterpolant)))) {
+      if (debugSubsumptionLevel >= 1) {
+        klee_message("Entry for Node #%lu not stored as the table entry of "
+                     "Node #%lu is more general",
+                     entry->nodeSequenceNumber, older->nodeSequenceNumber);
+      }
+      return false;
+    }
+
+    if (!newInterpolant.isNull() &&
+        !mustImply(solver, olderInterpolant, newInterpolant)) {
+      ref<Expr> merged = mergeConjunctions(olderInterpolant, newInterpolant);
+      if (merged.isNull())
+        continue;
+      entry->setInterpolant(merged);
+    }
+
+    if (debugSubsumptionLevel >= 1) {
+      klee_message("Table entry of Node #%lu merged into the entry for Node "
+                   "#%lu",
+                   older->nodeSequenceNumber, entry->nodeSequenceNumber);
+    }
+    entry->checkCount += older->checkCount;
+    entry->hitCount += older->hitCount;
+    entry->checkTime += older->checkTime;
+    entry->minStackDepth = std::min(entry->minStackDepth, older->minStackDepth);
+    it1 = entryList->erase(it1);
+    deleteEntry(id, older);
+  }
+  return true;
+}
+
+void TxSubsumptionTable::widen(
+    uintptr_t id, const std::vector<llvm::Instruction *> &callHistory,
+    TxSubsumptionTableEntry *entry, int debugSubsumptionLevel) {
+  TableMap::iterator it = instance.find(id);
+  if (it == instance.end())
+    return;
+  std::deque<TxSubsumptionTableEntry *> *entryList =
+      it->second->getEntryList(callHistory);
+  if (!entryList)
+    return;
+
+  // The values are compared once shadowed, as they are in the checks
+  entry->shadowStores();
+
+  for (std::deque<TxSubsumptionTableEntry *>::iterator
+           it1 = entryList->end();
+       it1 != entryList->begin();) {
+    --it1;
+    TxSubsumptionTableEntry *older = *it1;
+    older->shadowStores();
+
+    ref<TxAllocationContext> context;
+    ref<TxVariable> variable;
+    if (!entry->getWideningLocation(older, context, variable))
+      continue;
+
+    uint64_t low, high, olderLow, olderHigh;
+    entry->getWidenedRange(context, variable, low, high);
+    older->getWidenedRange(context, variable, olderLow, olderHigh);
+
+    // The union of the ranges is only an exact summary of the two entries
+    // when it has no gap
+    if ((low > olderHigh && low - olderHigh > 1) ||
+        (olderLow > high && olderLow - high > 1))
+      continue;
+
+    entry->widenedContext = context;
+    entry->widenedVariable = variable;
+    entry->widenedLow = std::min(low, olderLow);
+    entry->widenedHigh = std::max(high, olderHigh);
+
+    if (debugSubsumptionLevel >= 1) {
+      klee_message("Table entry of Node #%lu widened into the entry for Node "
+                   "#%lu, with the range [%lu, %lu]",
+                   older->nodeSequenceNumber, entry->nodeSequenceNumber,
+                   entry->widenedLow, entry->widenedHigh);
+    }
+    entry->checkCount += older->checkCount;
+    entry->hitCount += older->hitCount;
+    entry->checkTime += older->checkTime;
+    entry->minStackDepth = std::min(entry->minStackDepth, older->minStackDepth);
+    it1 = entryList->erase(it1);
+    deleteEntry(id, older);
+    ++widenedEntryCount;
+  }
+}
+
+/// \brief Test whether the locations of a store are locations of another
+/// store, with the same values.
+static bool includedStores(const TxStore::LowerInterpolantStore &general,
+                           const TxStore::LowerInterpolantStore &specific) {
+  if (general.size() > specific.size())
+    return false;
+  for (TxStore::LowerInterpolantStore::const_iterator it = general.begin(),
+                                                      ie = general.end();
+       it != ie; ++it) {
+    TxStore::LowerInterpolantStore::const_iterator found =
+        specific.find(it->first);
+    if (found == specific.end() || !equalValues(it->second, found->second))
+      return false;
+  }
+  return true;
+}
+
+static bool includedStores(const TxStore::TopInterpolantStore &general,
+                           const TxStore::TopInterpolantStore &specific) {
+  if (general.size() > specific.size())
+    return false;
+  for (TxStore::TopInterpolantStore::const_iterator it = general.begin(),
+                                                    ie = general.end();
+       it != ie; ++it) {
+    TxStore::TopInterpolantStore::const_iterator found =
+        specific.find(it->first);
+    if (found == specific.end() || !includedStores(it->second, found->second))
+      return false;
+  }
+  return true;
+}
+
+/// \brief Test whether the conjuncts of an interpolant are conjuncts of
+/// another one, a null interpolant being true.
+static bool includedConjuncts(ref<Expr> general, ref<Expr> specific) {
+  if (general.isNull() || general == specific)
+    return true;
+  if (specific.isNull())
+    return false;
+  std::vector<ref<Expr> > generalConjuncts =
+      TxPartitionHelper::getExprsFromAndExpr(general);
+  std::vector<ref<Expr> > specificConjuncts =
+      TxPartitionHelper::getExprsFromAndExpr(specific);
+  for (std::vector<ref<Expr> >::iterator it = generalConjuncts.begin(),
+                                         ie = generalConjuncts.end();
+       it != ie; ++it) {
+    if (std::find(specificConjuncts.begin(), specificConjuncts.end(), *it) ==
+        specificConjuncts.end())
+      return false;
+  }
+  return true;
+}
+
+bool TxSubsumptionTableEntry::generalizes(
+    TimingSolver *solver, const TxSubsumptionTableEntry *other,
+    unsigned &solverChecks) const {
+  // The entries of pending or computed weakest preconditions, and the widened
+  // ones, require more than their stores and interpolants
+  if (pendingWP || other->pendingWP || !wpInterpolant.isNull() ||
+      !other->wpInterpolant.isNull() || !widenedVariable.isNull() ||
+      !other->widenedVariable.isNull() ||
+      prevProgramPoint != other->prevProgramPoint ||
+      existentials != other->existentials || phiValues != other->phiValues ||
+      markedGlobal != other->markedGlobal)
+    return false;
+
+  // Only the concretely-addressed locations are required one by one of the
+  // subsumed states
+  if (!includedStores(concretelyAddressedStore,
+                      other->concretelyAddressedStore) ||
+      !equalStores(symbolicallyAddressedStore,
+                   other->symbolicallyAddressedStore) ||
+      !equalStores(concretelyAddressedHistoricalStore,
+                   other->concretelyAddressedHistoricalStore) ||
+      !equalStores(symbolicallyAddressedHistoricalStore,
+                   other->symbolicallyAddressedHistoricalStore))
+    return false;
+
+  if (includedConjuncts(interpolant, other->interpolant))
+    return true;
+
+  // The existentially-quantified interpolants are only decided by the
+  // subsumption checks
+  if (!solverChecks || other->interpolant.isNull() || !existentials.empty())
+    return false;
+  --solverChecks;
+  return mustImply(solver, other->interpolant, interpolant);
+}
+
+bool TxSubsumptionTable::eliminateRedundant(
+    TimingSolver *solver, uintptr_t id,
+    const std::vector<llvm::Instruction *> &callHistory,
+    TxSubsumptionTableEntry *entry, int debugSubsumptionLevel) {
+  if (entry->pendingWP)
+    return true;
+
+  TableMap::iterator it = instance.find(id);
+  if (it == instance.end())
+    return true;
+  std::deque<TxSubsumptionTableEntry *> *entryList =
+      it->second->getEntryList(callHistory);
+  if (!entryList)
+    return true;
+
+  // The values are compared once shadowed, as they are in the checks
+  entry->shadowStores();
+
+  unsigned solverChecks = RedundantEntrySolverChecks;
+  for (std::deque<TxSubsumptionTableEntry *>::iterator
+           it1 = entryList->end();
+       it1 != entryList->begin();) {
+    --it1;
+    TxSubsumptionTableEntry *older = *it1;
+    older->shadowStores();
+
+    if (older->generalizes(solver, entry, solverChecks)) {
+      if (debugSubsumptionLevel >= 1) {
+        klee_message("Entry for Node #%lu not stored as the table entry of "
+                     "Node #%lu generalizes it",
+                     entry->nodeSequenceNumber, older->nodeSequenceNumber);
+      }
+      ++redundantEntryCount;
+      return false;
+    }
+
+    if (!entry->generalizes(solver, older, solverChecks))
+      continue;
+
+    if (debugSubsumptionLevel >= 1) {
+      klee_message("Table entry of Node #%lu removed as the entry for Node "
+                   "#%lu generalizes it",
+                   older->nodeSequenceNumber, entry->nodeSequenceNumber);
+    }
+    entry->checkCount += older->checkCount;
+    entry->hitCount += older->hitCount;
+    entry->checkTime += older->checkTime;
+    entry->minStackDepth = std::min(entry->minStackDepth, older->minStackDepth);
+    it1 = entryList->erase(it1);
+    deleteEntry(id, older);
+    ++redundantEntryCount;
+  }
+  return true;
+}
+
+void TxSubsumptionTable::deleteEntry(uintptr_t id,
+                                     TxSubsumptionTableEntry *entry) {
+  TxTreeGraph::removeTableEntryMapping(entry);
+  delete entry;
+  --entryCount[id];
+  --totalEntryCount;
+}
+
+unsigned TxSubsumptionTable::evict(unsigned target) {
+  // Entries whose weakest precondition is pending are still referred to by
+  // their nodes, and are kept.
+  std::vector<std::pair<double, TxSubsumptionTableEntry *> > candidates;
+  for (TableMap::iterator it = instance.begin(), ie = instance.end();
+       it != ie; ++it) {
+    std::vector<TxSubsumptionTableEntry *> entries;
+    it->second->getEntries(entries);
+    for (std::vector<TxSubsumptionTableEntry *>::iterator
+             it1 = entries.begin(),
+             ie1 = entries.end();
+         it1 != ie1; ++it1) {
+      if (!(*it1)->pendingWP)
+        candidates.push_back(std::make_pair((*it1)->getUtility(), *it1));
+    }
+  }
+
+  unsigned excess = std::min<unsigned>(totalEntryCount - target,
+                                       candidates.size());
+  std::nth_element(candidates.begin(), candidates.begin() + excess,
+                   candidates.end());
+  std::set<TxSubsumptionTableEntry *> evicted;
+  for (unsigned i = 0; i < excess; ++i)
+    evicted.insert(candidates[i].second);
+
+  for (TableMap::iterator it = instance.begin(), ie = instance.end();
+       it != ie; ++it)
+    entryCount[it->first] -= it->second->removeEntries(evicted);
+  totalEntryCount -= excess;
+  evictionCount += excess;
+  return excess;
 }
 
 bool TxSubsumptionTable::check(TimingSolver *solver, ExecutionState &state,
@@ -2099,27 +3586,32 @@ bool TxSubsumptionTable::check(TimingSolver *solver, ExecutionState &state,
   CallHistoryIndexedTable *subTable = 0;
   TxTreeNode *txTreeNode = state.txTreeNode;
 
-  std::map<uintptr_t, CallHistoryIndexedTable *>::iterator it =
-      instance.find(state.txTreeNode->getProgramPoint());
+  // The events are recorded instead of printed when the log is enabled
+  bool logged = debugSubsumptionLevel >= 1 && TxDebugLog::isEnabled();
+  if (TxDebugLog::isEnabled())
+    debugSubsumptionLevel = 0;
+
+  TableMap::iterator it = instance.find(state.txTreeNode->getProgramPoint());
   if (it == instance.end()) {
     if (debugSubsumptionLevel >= 1) {
       klee_message(
           "#%lu: Check failure due to control point not found in table",
           state.txTreeNode->getNodeSequenceNumber());
     }
-    return false;
+    return checkSummaries(solver, state, timeout, debugSubsumptionLevel);
   }
   subTable = it->second;
 
   bool found;
   std::pair<EntryIterator, EntryIterator> iterPair =
-      subTable->find(txTreeNode->entryCallHistory, found);
+      subTable->find(txTreeNode->getEntryCallHistory(),
+                     txTreeNode->entryCallHistoryHash, found);
   if (!found) {
     if (debugSubsumptionLevel >= 1) {
       klee_message("#%lu: Check failure due to entry not found",
                    state.txTreeNode->getNodeSequenceNumber());
     }
-    return false;
+    return checkSummaries(solver, state, timeout, debugSubsumptionLevel);
   }
 
   if (iterPair.first != iterPair.second) {
@@ -2129,52 +3621,177 @@ bool TxSubsumptionTable::check(TimingSolver *solver, ExecutionState &state,
     TxStore::LowerInterpolantStore concretelyAddressedHistoricalStore;
     TxStore::LowerInterpolantStore symbolicallyAddressedHistoricalStore;
 
-    bool leftRetrieval;
-    TxStore::TopStateStore __internalStore;
-    TxStore::LowerStateStore __concretelyAddressedHistoricalStore;
-    TxStore::LowerStateStore __symbolicallyAddressedHistoricalStore;
+    bool leftRetrieval = false;
+    TxStore::StateStoreView stateStore;
 
-    txTreeNode->getStoredExpressions(txTreeNode->entryCallHistory,
-                                     leftRetrieval, __internalStore,
-                                     __concretelyAddressedHistoricalStore,
-                                     __symbolicallyAddressedHistoricalStore);
+    txTreeNode->getStoredExpressions(txTreeNode->getEntryCallHistory(),
+                                     leftRetrieval, stateStore);
+    TxStoreSignature stateSignature(stateStore);
+    Assignment *stateModel = 0;
+    ProgramPointProfile *pointProfile =
+        SubsumptionProfile ? &profile[txTreeNode->getProgramPoint()] : 0;
 
     // Iterate the subsumption table entry with reverse iterator because
     // the successful subsumption mostly happen in the newest entry.
     for (EntryIterator it = iterPair.first, ie = iterPair.second; it != ie;
          ++it) {
-      if ((*it)->subsumed(solver, state, timeout, leftRetrieval,
-                          __internalStore, __concretelyAddressedHistoricalStore,
-                          __symbolicallyAddressedHistoricalStore,
-                          debugSubsumptionLevel)) {
+      if ((*it)->pendingWP) {
+        if (SkipPendingWPEntries) {
+          if (debugSubsumptionLevel >= 1) {
+            klee_message("#%lu=>#%lu: Check skipped as the weakest "
+                         "precondition of the table entry is pending",
+                         state.txTreeNode->getNodeSequenceNumber(),
+                         (*it)->nodeSequenceNumber);
+          }
+          continue;
+        }
+        TxTree::completePendingEntry(*it);
+      }
+      if (!(*it)->mayBeSubsumed(stateSignature, stateStore)) {
+        ++TxSubsumptionTableEntry::preFilterRejectionCount;
+        if (pointProfile) {
+          ++pointProfile->checkCount;
+          ++pointProfile->failureCount[TxSubsumptionTableEntry::StoreMismatch];
+        }
+        if (debugSubsumptionLevel >= 1) {
+          klee_message("#%lu=>#%lu: Check failure as the state store lacks "
+                       "keys of the table entry",
+                       state.txTreeNode->getNodeSequenceNumber(),
+                       (*it)->nodeSequenceNumber);
+        }
+        continue;
+      }
+      double startTime = util::getWallTime();
+      bool success =
+          (*it)->subsumed(solver, state, timeout, leftRetrieval, stateStore,
+                          stateModel, debugSubsumptionLevel);
+      double checkTime = util::getWallTime() - startTime;
+      ++(*it)->checkCount;
+      (*it)->checkTime += checkTime;
+      if (pointProfile) {
+        ++pointProfile->checkCount;
+        pointProfile->checkTime += checkTime;
+        if (success)
+          ++pointProfile->successCount;
+        else
+          ++pointProfile
+                ->failureCount[TxSubsumptionTableEntry::lastCheckFailure];
+        if (TxSubsumptionTableEntry::lastQuerySize) {
+          ++pointProfile->queryCount;
+          pointProfile->querySize += TxSubsumptionTableEntry::lastQuerySize;
+        }
+      }
+      if (logged) {
+        TxDebugLog::record(
+            success ? TxDebugLog::CheckSuccess : TxDebugLog::CheckFailure,
+            txTreeNode->getNodeSequenceNumber(), (*it)->nodeSequenceNumber,
+            txTreeNode->getProgramPoint(),
+            success ? TxSubsumptionTableEntry::NoFailure
+                    : TxSubsumptionTableEntry::lastCheckFailure,
+            TxSubsumptionTableEntry::lastQuerySize, (*it)->getInterpolant(),
+            (*it)->getWPInterpolant());
+      }
+      if (success) {
+        ++(*it)->hitCount;
+
         // We mark as subsumed such that the node will not be
         // stored into table (the table already contains a more
         // general entry).
         txTreeNode->isSubsumed = true;
 
+        // The paths cut by the subsumption return as those of the entry
+        txTreeNode->recordReturn((*it)->minStackDepth);
+
         // Mark the node as subsumed, and create a subsumption edge
         TxTreeGraph::markAsSubsumed(txTreeNode, (*it));
+        delete stateModel;
         return true;
       }
     }
+    delete stateModel;
   }
+  return checkSummaries(solver, state, timeout, debugSubsumptionLevel);
+}
+
+bool TxSubsumptionTable::checkSummaries(TimingSolver *solver,
+                                        ExecutionState &state, double timeout,
+                                        int debugSubsumptionLevel) {
+  TxTreeNode *txTreeNode = state.txTreeNode;
+  std::map<uintptr_t, std::vector<TxSubsumptionTableEntry *> >::iterator it =
+      summaries.find(txTreeNode->getProgramPoint());
+  if (it == summaries.end())
+    return false;
+
+  // The summaries have no stores, hence an empty store view suffices
+  bool leftRetrieval = false;
+  TxStore::StateStoreView stateStore;
+  Assignment *stateModel = 0;
+  for (std::vector<TxSubsumptionTableEntry *>::iterator
+           it1 = it->second.begin(),
+           ie1 = it->second.end();
+       it1 != ie1; ++it1) {
+    bool success =
+        (*it1)->subsumed(solver, state, timeout, leftRetrieval, stateStore,
+                         stateModel, debugSubsumptionLevel);
+    if (success) {
+      if (debugSubsumptionLevel >= 1) {
+        klee_message("#%lu: Check success with a summary of the program "
+                     "point",
+                     txTreeNode->getNodeSequenceNumber());
+      }
+      ++(*it1)->hitCount;
+      ++summaryHitCount;
+      txTreeNode->isSubsumed = true;
+      TxTreeGraph::markAsSubsumed(txTreeNode, *it1);
+      delete stateModel;
+      return true;
+    }
+  }
+  delete stateModel;
   return false;
 }
 
+void TxSubsumptionTable::insertSummary(TxTreeNode *node,
+                                       TxSubsumptionTableEntry *entry) {
+  // The entries of the states in the entry function already hold for all
+  // their states, and the nodes never run have no stack depth
+  if (node->getEntryCallHistory().empty() || !node->entryStackDepth ||
+      node->minStackDepth < node->entryStackDepth ||
+      !entry->hasInterpolantOnly())
+    return;
+
+  std::vector<TxSubsumptionTableEntry *> &list =
+      summaries[node->getProgramPoint()];
+  for (std::vector<TxSubsumptionTableEntry *>::iterator it = list.begin(),
+                                                        ie = list.end();
+       it != ie; ++it) {
+    if ((*it)->interpolant.isNull() ||
+        (!entry->interpolant.isNull() &&
+         (*it)->interpolant == entry->interpolant))
+      return;
+  }
+
+  TxSubsumptionTableEntry *summary =
+      new TxSubsumptionTableEntry(node->getProgramPoint());
+  summary->interpolant = entry->interpolant;
+  summary->prevProgramPoint = entry->prevProgramPoint;
+  list.push_back(summary);
+}
+
 bool TxSubsumptionTable::hasInterpolation(ExecutionState &state) {
 
   CallHistoryIndexedTable *subTable = 0;
   TxTreeNode *txTreeNode = state.txTreeNode;
 
-  std::map<uintptr_t, CallHistoryIndexedTable *>::iterator it =
-      instance.find(state.txTreeNode->getProgramPoint());
+  TableMap::iterator it = instance.find(state.txTreeNode->getProgramPoint());
   if (it == instance.end()) {
     return false;
   }
   subTable = it->second;
 
   bool found;
-  subTable->find(txTreeNode->entryCallHistory, found);
+  subTable->find(txTreeNode->getEntryCallHistory(),
+                 txTreeNode->entryCallHistoryHash, found);
   if (!found) {
     return false;
   }
@@ -2183,15 +3800,234 @@ bool TxSubsumptionTable::hasInterpolation(ExecutionState &state) {
 }
 
 void TxSubsumptionTable::clear() {
-  for (std::map<uintptr_t, CallHistoryIndexedTable *>::iterator
-           it = instance.begin(),
-           ie = instance.end();
+  for (TableMap::iterator it = instance.begin(), ie = instance.end();
        it != ie; ++it) {
     if (it->second) {
       ++TxTree::programPointNumber;
       delete it->second;
     }
   }
+  entryCount.clear();
+  totalEntryCount = 0;
+
+  for (std::map<uintptr_t, std::vector<TxSubsumptionTableEntry *> >::iterator
+           it = summaries.begin(),
+           ie = summaries.end();
+       it != ie; ++it) {
+    for (std::vector<TxSubsumptionTableEntry *>::iterator
+             it1 = it->second.begin(),
+             ie1 = it->second.end();
+         it1 != ie1; ++it1)
+      delete *it1;
+  }
+  summaries.clear();
+}
+
+/// \brief Identifies files saved by TxSubsumptionTable::save
+static const uint32_t SubsumptionTableFileMagic = 0x54585354; // "TXST"
+
+static const uint32_t SubsumptionTableFileVersion = 1;
+
+static void writeUInt32(std::ofstream &os, uint32_t value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void writeUInt64(std::ofstream &os, uint64_t value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static bool readUInt32(std::ifstream &is, uint32_t &value) {
+  return is.read(reinterpret_cast<char *>(&value), sizeof(value)).good();
+}
+
+static bool readUInt64(std::ifstream &is, uint64_t &value) {
+  return is.read(reinterpret_cast<char *>(&value), sizeof(value)).good();
+}
+
+uint64_t TxSubsumptionTable::getModuleFingerprint(KModule *kmodule) {
+  std::string text;
+  llvm::raw_string_ostream stream(text);
+  kmodule->module->print(stream, 0);
+  stream.flush();
+
+  // 64-bit FNV-1a hash of the textual module
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (std::string::const_iterator it = text.begin(), ie = text.end();
+       it != ie; ++it) {
+    hash ^= static_cast<unsigned char>(*it);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+void TxSubsumptionTable::save(const std::string &fileName, KModule *kmodule) {
+  // We write into a temporary file which then replaces the original, so that
+  // other processes sharing the file never read a partially-written table.
+  std::ostringstream tmpName;
+  tmpName << fileName << ".tmp." << getpid();
+  std::ofstream os(tmpName.str().c_str(), std::ios::out | std::ios::binary);
+  if (!os.good()) {
+    klee_warning("could not open subsumption table file %s for writing",
+                 tmpName.str().c_str());
+    return;
+  }
+
+  std::vector<std::pair<uint32_t, std::vector<uint32_t> > > records;
+  for (TableMap::const_iterator it = instance.begin(), ie = instance.end();
+       it != ie; ++it) {
+    std::vector<std::vector<llvm::Instruction *> > histories;
+    it->second->getUnconditionalCallHistories(histories);
+
+    uint32_t id = kmodule->infos->getInfo(
+        reinterpret_cast<llvm::Instruction *>(it->first)).id;
+    for (std::vector<std::vector<llvm::Instruction *> >::const_iterator
+             it1 = histories.begin(),
+             ie1 = histories.end();
+         it1 != ie1; ++it1) {
+      std::vector<uint32_t> historyIds;
+      for (std::vector<llvm::Instruction *>::const_iterator
+               it2 = it1->begin(),
+               ie2 = it1->end();
+           it2 != ie2; ++it2) {
+        historyIds.push_back(kmodule->infos->getInfo(*it2).id);
+      }
+      records.push_back(
+          std::pair<uint32_t, std::vector<uint32_t> >(id, historyIds));
+    }
+  }
+
+  writeUInt32(os, SubsumptionTableFileMagic);
+  writeUInt32(os, SubsumptionTableFileVersion);
+  writeUInt64(os, getModuleFingerprint(kmodule));
+  writeUInt64(os, records.size());
+  for (std::vector<std::pair<uint32_t, std::vector<uint32_t> > >::const_iterator
+           it = records.begin(),
+           ie = records.end();
+       it != ie; ++it) {
+    writeUInt32(os, it->first);
+    writeUInt32(os, it->second.size());
+    for (std::vector<uint32_t>::const_iterator it1 = it->second.begin(),
+                                               ie1 = it->second.end();
+         it1 != ie1; ++it1) {
+      writeUInt32(os, *it1);
+    }
+  }
+
+  os.close();
+  if (!os.good()) {
+    klee_warning("error writing subsumption table file %s",
+                 tmpName.str().c_str());
+    ::unlink(tmpName.str().c_str());
+    return;
+  }
+  if (::rename(tmpName.str().c_str(), fileName.c_str()) != 0) {
+    klee_warning("could not replace subsumption table file %s",
+                 fileName.c_str());
+    ::unlink(tmpName.str().c_str());
+  }
+}
+
+void TxSubsumptionTable::load(const std::string &fileName, KModule *kmodule) {
+  std::ifstream is(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!is.good())
+    return;
+
+  uint32_t magic, version;
+  uint64_t fingerprint, recordCount;
+  if (!readUInt32(is, magic) || magic != SubsumptionTableFileMagic ||
+      !readUInt32(is, version) || version != SubsumptionTableFileVersion ||
+      !readUInt64(is, fingerprint) || !readUInt64(is, recordCount)) {
+    klee_warning("ignoring invalid subsumption table file %s",
+                 fileName.c_str());
+    return;
+  }
+
+  if (fingerprint != getModuleFingerprint(kmodule)) {
+    klee_message("ignoring subsumption table file %s saved for a different "
+                 "module",
+                 fileName.c_str());
+    return;
+  }
+
+  std::map<uint32_t, KInstruction *> kinstructions;
+  for (std::vector<KFunction *>::const_iterator
+           it = kmodule->functions.begin(),
+           ie = kmodule->functions.end();
+       it != ie; ++it) {
+    for (unsigned i = 0; i < (*it)->numInstructions; ++i) {
+      KInstruction *ki = (*it)->instructions[i];
+      kinstructions[ki->info->id] = ki;
+    }
+  }
+
+  uint64_t loaded = 0;
+  for (uint64_t i = 0; i < recordCount; ++i) {
+    uint32_t id, historySize;
+    if (!readUInt32(is, id) || !readUInt32(is, historySize))
+      break;
+
+    bool valid = kinstructions.find(id) != kinstructions.end();
+    std::vector<llvm::Instruction *> callHistory;
+    for (uint32_t j = 0; j < historySize; ++j) {
+      uint32_t callId;
+      if (!readUInt32(is, callId))
+        break;
+      std::map<uint32_t, KInstruction *>::const_iterator it =
+          kinstructions.find(callId);
+      if (it == kinstructions.end()) {
+        valid = false;
+        continue;
+      }
+      callHistory.push_back(it->second->inst);
+    }
+    if (!is.good())
+      break;
+    if (!valid)
+      continue;
+
+    KInstruction *ki = kinstructions[id];
+    uintptr_t programPoint = reinterpret_cast<uintptr_t>(ki->inst);
+    TableMap::const_iterator tableIt = instance.find(programPoint);
+    if (tableIt != instance.end() &&
+        tableIt->second->hasUnconditionalEntry(callHistory))
+      continue;
+
+    insert(programPoint, callHistory,
+           new TxSubsumptionTableEntry(programPoint));
+    ki->hasTableEntry = true;
+    ++loaded;
+  }
+
+  if (loaded) {
+    klee_message("loaded %lu subsumption table entries from %s", loaded,
+                 fileName.c_str());
+  }
+}
+
+void TxSubsumptionTable::saveProfile(llvm::raw_ostream &stream,
+                                     KModule *kmodule) {
+  stream << "function,file,line,assembly_line,entries,checks,successes,"
+            "store_mismatches,simplification_failures,model_refutations,"
+            "solver_invalid,solver_timeouts,time_ms,average_query_size\n";
+  for (std::map<uintptr_t, ProgramPointProfile>::const_iterator
+           it = profile.begin(),
+           ie = profile.end();
+       it != ie; ++it) {
+    llvm::Instruction *inst = reinterpret_cast<llvm::Instruction *>(it->first);
+    const InstructionInfo &info = kmodule->infos->getInfo(inst);
+    const ProgramPointProfile &p = it->second;
+    stream << inst->getParent()->getParent()->getName() << "," << info.file
+           << "," << info.line << "," << info.assemblyLine << ","
+           << getEntryCount(it->first) << "," << p.checkCount << ","
+           << p.successCount;
+    for (unsigned i = TxSubsumptionTableEntry::StoreMismatch;
+         i <= TxSubsumptionTableEntry::SolverTimeout; ++i)
+      stream << "," << p.failureCount[i];
+    stream << "," << llvm::format("%.3f", p.checkTime * 1000) << ","
+           << llvm::format("%.1f", p.queryCount
+                                       ? (double)p.querySize / p.queryCount
+                                       : 0.0) << "\n";
+  }
 }
 
 /**/
@@ -2215,10 +4051,19 @@ bool TxTree::symbolicExecutionError = false;
 
 uint64_t TxTree::subsumptionCheckCount = 0;
 
+uint64_t TxTree::mergeCount = 0;
+
+uint64_t TxTree::disabledFunctionCount = 0;
+
+llvm::DenseMap<const llvm::Function *, TxTree::FunctionProfile>
+TxTree::functionProfiles;
+
 ExecutionState *TxTree::initialStateCopy = 0;
 
 uint64_t TxTree::blockCount = 1;
 
+std::deque<TxTree::PendingNode> TxTree::pendingNodes;
+
 void TxTree::printTimeStat(std::stringstream &stream) {
   stream << "KLEE: done:     setCurrentINode = "
          << ((double)setCurrentINodeTime.getValue()) / 1000 << "\n";
@@ -2246,6 +4091,33 @@ void TxTree::printTableStat(std::stringstream &stream) {
   stream << "KLEE: done:     Number of subsumption checks = "
          << subsumptionCheckCount << "\n";
 
+  if (mergeCount)
+    stream << "KLEE: done:     Number of merges of states = " << mergeCount
+           << "\n";
+
+  stream << "KLEE: done:     Number of tabled values shared with other "
+            "table entries = " << TxInterpolantValue::sharedHitCount << "\n";
+
+  if (AdaptiveInterpolationWarmup)
+    stream << "KLEE: done:     Number of functions disabled by adaptive "
+              "interpolation = " << disabledFunctionCount << "\n";
+
+  if (MaxSubsumptionTableEntries || TxSubsumptionTable::evictionCount)
+    stream << "KLEE: done:     Number of evicted table entries = "
+           << TxSubsumptionTable::evictionCount << "\n";
+
+  if (LoopWidening)
+    stream << "KLEE: done:     Number of table entries removed by loop "
+              "widening = " << TxSubsumptionTable::widenedEntryCount << "\n";
+
+  if (EliminateRedundantEntries)
+    stream << "KLEE: done:     Number of redundant table entries eliminated = "
+           << TxSubsumptionTable::redundantEntryCount << "\n";
+
+  if (FunctionSummaries)
+    stream << "KLEE: done:     Number of states subsumed by summaries = "
+           << TxSubsumptionTable::summaryHitCount << "\n";
+
   stream << "KLEE: done:     Average solver calls per subsumption check = "
          << inTwoDecimalPoints((double)stats::subsumptionQueryCount /
                                (double)subsumptionCheckCount) << "\n";
@@ -2295,6 +4167,84 @@ TxTree::TxTree(
   ;
 }
 
+TxTree::~TxTree() {
+  // The deferred interpolants are of no use anymore
+  for (std::deque<PendingNode>::iterator it = pendingNodes.begin(),
+                                         ie = pendingNodes.end();
+       it != ie; ++it)
+    delete it->node;
+  pendingNodes.clear();
+
+  TxSubsumptionTable::clear();
+  TxQueryPredictor::clear();
+  delete initialStateCopy;
+}
+
+void TxTree::completeNode(const PendingNode &pending) {
+  TxTreeNode *node = pending.node;
+  TxSubsumptionTableEntry *entry = pending.entry;
+
+  if (entry && entry->pendingWP) {
+    ref<Expr> WPExpr = node->generateWPInterpolant();
+    entry->setWPInterpolant(WPExpr);
+    entry->pendingWP = false;
+    if (!WPExpr.isNull()) {
+      entry = node->getWP()->updateSubsumptionTableEntry(entry);
+    }
+
+    // The parent interpolant is generated from the ones of its children
+    if (node->parent && pending.childIndex >= 0)
+      node->parent->childWPInterpolant[pending.childIndex] = WPExpr;
+  }
+
+  if (entry && node->dependency->debugSubsumptionLevel >= 1 &&
+      TxDebugLog::isEnabled()) {
+    TxDebugLog::record(TxDebugLog::EntryStored, node->getNodeSequenceNumber(),
+                       entry->nodeSequenceNumber, node->getProgramPoint(), 0, 0,
+                       entry->getInterpolant(), entry->getWPInterpolant());
+  } else if (entry && node->dependency->debugSubsumptionLevel >= 2) {
+    std::string msg;
+    llvm::raw_string_ostream out(msg);
+    entry->print(out);
+    if (WPInterpolant) {
+      entry->printWP(out);
+    }
+    out.flush();
+    klee_message("%s", msg.c_str());
+  }
+
+  delete node;
+}
+
+void TxTree::retireNode(TxTreeNode *node, TxSubsumptionTableEntry *entry,
+                        int childIndex) {
+  TxTreeGraph::removeNode(node);
+  // The entry, if any, has been created, and the parent is still there
+  node->dependency->propagateUsedConstraints();
+
+  if (!DeferWPInterpolant && pendingNodes.empty()) {
+    completeNode(PendingNode(node, entry, childIndex));
+    return;
+  }
+
+  // The parent of a deferred node is removed after it, and hence also
+  // deferred, so that it is still there when the node is completed.
+  pendingNodes.push_back(PendingNode(node, entry, childIndex));
+  while (pendingNodes.size() > DeferWPInterpolant) {
+    PendingNode pending = pendingNodes.front();
+    pendingNodes.pop_front();
+    completeNode(pending);
+  }
+}
+
+void TxTree::completePendingEntry(TxSubsumptionTableEntry *entry) {
+  while (entry->pendingWP && !pendingNodes.empty()) {
+    PendingNode pending = pendingNodes.front();
+    pendingNodes.pop_front();
+    completeNode(pending);
+  }
+}
+
 bool TxTree::subsumptionCheck(TimingSolver *solver, ExecutionState &state,
                               double timeout) {
 #ifdef ENABLE_Z3
@@ -2309,32 +4259,89 @@ bool TxTree::subsumptionCheck(TimingSolver *solver, ExecutionState &state,
                                state.txTreeNode->getProgramPoint())
     return false;
 
+  // The states of a merged region are not checked, see TxTreeNode#merged
+  if (state.txTreeNode->merged)
+    return false;
+
+  if (isFunctionDisabled(state.txTreeNode))
+    return false;
+
   int debugSubsumptionLevel =
       currentTxTreeNode->dependency->debugSubsumptionLevel;
 
-  if (debugSubsumptionLevel >= 2) {
+  // With the debug log, the outcomes are recorded by TxSubsumptionTable::check
+  // instead
+  int messageLevel = TxDebugLog::isEnabled() ? 0 : debugSubsumptionLevel;
+  if (messageLevel >= 2) {
     klee_message("Subsumption check for Node #%lu, Program Point %lu",
                  state.txTreeNode->getNodeSequenceNumber(),
                  state.txTreeNode->getProgramPoint());
-  } else if (debugSubsumptionLevel >= 1) {
+  } else if (messageLevel >= 1) {
     klee_message("Subsumption check for Node #%lu",
                  state.txTreeNode->getNodeSequenceNumber());
   }
 
   ++subsumptionCheckCount; // For profiling
 
-  TimerStatIncrementer t(subsumptionCheckTime);
+  TX_TIMER(subsumptionCheckTime);
+  SamplingProfiler::Scope phase(SamplingProfiler::Subsumption);
 
-  return TxSubsumptionTable::check(solver, state, timeout,
-                                   debugSubsumptionLevel);
+  bool success = TxSubsumptionTable::check(solver, state, timeout,
+                                           debugSubsumptionLevel);
+  recordFunctionCheck(state.txTreeNode, success);
+  return success;
 #endif
   return false;
 }
 
+bool TxTree::isFunctionDisabled(TxTreeNode *node) {
+  if (!AdaptiveInterpolationWarmup)
+    return false;
+  const llvm::Function *f = getFunction(node);
+  if (!f)
+    return false;
+
+  FunctionProfile &profile = functionProfiles[f];
+  if (!profile.disabled)
+    return false;
+  if (AdaptiveInterpolationResample &&
+      ++profile.skipCount >= AdaptiveInterpolationResample) {
+    // Sample the function again with a new warm-up, such that a function
+    // whose states only become subsumable later in the run is not lost
+    profile = FunctionProfile();
+    return false;
+  }
+  return true;
+}
+
+void TxTree::recordFunctionCheck(TxTreeNode *node, bool success) {
+  if (!AdaptiveInterpolationWarmup)
+    return;
+  const llvm::Function *f = getFunction(node);
+  if (!f)
+    return;
+
+  FunctionProfile &profile = functionProfiles[f];
+  ++profile.checkCount;
+  if (success)
+    ++profile.successCount;
+  if (profile.checkCount >= AdaptiveInterpolationWarmup &&
+      profile.successCount <
+          AdaptiveInterpolationThreshold * profile.checkCount) {
+    profile.disabled = true;
+    ++disabledFunctionCount;
+  }
+}
+
 void TxTree::setCurrentINode(ExecutionState &state) {
-  TimerStatIncrementer t(setCurrentINodeTime);
+  TX_TIMER(setCurrentINodeTime);
   currentTxTreeNode = state.txTreeNode;
   currentTxTreeNode->setProgramPoint(state.pc->inst, state.prevPC->inst);
+  if (!currentTxTreeNode->programPointInstruction) {
+    currentTxTreeNode->programPointInstruction = state.pc;
+    currentTxTreeNode->entryStackDepth = currentTxTreeNode->minStackDepth =
+        state.stack.size();
+  }
   if (!currentTxTreeNode->nodeSequenceNumber)
     currentTxTreeNode->nodeSequenceNumber =
         TxTreeNode::nextNodeSequenceNumber++;
@@ -2344,24 +4351,29 @@ void TxTree::setCurrentINode(ExecutionState &state) {
 void TxTree::removeSpeculationFailedNodes(TxTreeNode *node) {
   assert(!node->left && !node->right);
   TxTreeNode *p = node->parent;
+  int childIndex = -1;
   if (p) {
     if (node == p->left) {
       p->left = 0;
+      childIndex = 0;
     } else {
       assert(node == p->right);
       p->right = 0;
+      childIndex = 1;
     }
   }
-  delete node;
+  retireNode(node, 0, childIndex);
 }
 
 void TxTree::remove(ExecutionState *state, TimingSolver *solver, bool dumping) {
 #ifdef ENABLE_Z3
   TxTreeNode *node = state->txTreeNode;
-  TimerStatIncrementer t(removeTime);
+  TX_TIMER(removeTime);
+  SamplingProfiler::Scope phase(SamplingProfiler::Tabling);
   assert(!node->left && !node->right);
   do {
     TxTreeNode *p = node->parent;
+    TxSubsumptionTableEntry *entry = 0;
 
     // Speculation Success
     if (INTERPOLATION_ENABLED && SpecTypeToUse != NO_SPEC &&
@@ -2369,6 +4381,8 @@ void TxTree::remove(ExecutionState *state, TimingSolver *solver, bool dumping) {
         !p->isSpeculationNode()) {
       llvm::BasicBlock *pbb = p->getBasicBlock();
       StatsTracker::increaseEle(pbb, 2, false);
+      TxSpeculationController::recordSuccess(
+          p->secondCheckInst, node->specTime ? *node->specTime : 0.0);
     }
 
     // As the node is about to be deleted, it must have been completely
@@ -2378,8 +4392,11 @@ void TxTree::remove(ExecutionState *state, TimingSolver *solver, bool dumping) {
     // This is because a generic error returns no information (true), which
     // should not be used for subsuming.
     if (!dumping && !node->isSubsumed && node->storable &&
-        !node->genericEarlyTermination) {
-      int debugSubsumptionLevel = node->dependency->debugSubsumptionLevel;
+        !node->genericEarlyTermination && !node->merged &&
+        !isFunctionDisabled(node)) {
+      int debugSubsumptionLevel = TxDebugLog::isEnabled()
+                                      ? 0
+                                      : node->dependency->debugSubsumptionLevel;
 
       if (debugSubsumptionLevel >= 2) {
         klee_message("Storing entry for Node #%lu, Program Point %lu",
@@ -2389,45 +4406,56 @@ void TxTree::remove(ExecutionState *state, TimingSolver *solver, bool dumping) {
                      node->getNodeSequenceNumber());
       }
 
-      // generate marking and wp interpolant
-      TxSubsumptionTableEntry *entry =
-          new TxSubsumptionTableEntry(node, node->entryCallHistory);
-
-      if (WPInterpolant) {
-        ref<Expr> WPExpr = entry->getWPInterpolant();
-        if (!WPExpr.isNull()) {
-          entry = node->wp->updateSubsumptionTableEntry(entry);
-        }
-      }
-
-      TxSubsumptionTable::insert(node->getProgramPoint(),
-                                 node->entryCallHistory, entry);
-
-      TxTreeGraph::addTableEntryMapping(node, entry);
-
-      if (debugSubsumptionLevel >= 2) {
-        std::string msg;
-        llvm::raw_string_ostream out(msg);
-        entry->print(out);
-        if (WPInterpolant) {
-          entry->printWP(out);
-        }
-        out.flush();
-        klee_message("%s", msg.c_str());
+      // generate marking; the wp interpolant is computed when the node is
+      // completed
+      entry = new TxSubsumptionTableEntry(node, node->getEntryCallHistory());
+      entry->pendingWP = WPInterpolant;
+
+      if ((MergeSubsumptionEntries &&
+           !TxSubsumptionTable::merge(solver, node->getProgramPoint(),
+                                      node->getEntryCallHistory(), entry,
+                                      debugSubsumptionLevel)) ||
+          (EliminateRedundantEntries &&
+           !TxSubsumptionTable::eliminateRedundant(
+               solver, node->getProgramPoint(), node->getEntryCallHistory(),
+               entry, debugSubsumptionLevel))) {
+        delete entry;
+        entry = 0;
+      } else {
+        if (LoopWidening && node->programPointInstruction &&
+            node->programPointInstruction->isLoopHeader)
+          TxSubsumptionTable::widen(node->getProgramPoint(),
+                                    node->getEntryCallHistory(), entry,
+                                    debugSubsumptionLevel);
+
+        TxSubsumptionTable::insert(node->getProgramPoint(),
+                                   node->getEntryCallHistory(), entry);
+        if (FunctionSummaries)
+          TxSubsumptionTable::insertSummary(node, entry);
+
+        // Enable subsumption checks before the program point instruction
+        if (node->programPointInstruction)
+          node->programPointInstruction->hasTableEntry = true;
+
+        TxTreeGraph::addTableEntryMapping(node, entry);
       }
     }
 
+    int childIndex = -1;
     if (p) {
       if (!p->genericEarlyTermination)
         p->genericEarlyTermination = node->genericEarlyTermination;
+      p->recordReturn(node->minStackDepth);
       if (node == p->left) {
         p->left = 0;
+        childIndex = 0;
       } else {
         assert(node == p->right);
         p->right = 0;
+        childIndex = 1;
       }
     }
-    delete node;
+    retireNode(node, entry, childIndex);
     node = p;
   } while (node && !node->left && !node->right);
 #endif
@@ -2435,7 +4463,7 @@ void TxTree::remove(ExecutionState *state, TimingSolver *solver, bool dumping) {
 
 std::pair<TxTreeNode *, TxTreeNode *>
 TxTree::split(TxTreeNode *parent, ExecutionState *left, ExecutionState *right) {
-  TimerStatIncrementer t(splitTime);
+  TX_TIMER(splitTime);
   parent->split(left, right);
   TxTreeGraph::addChildren(parent, parent->left, parent->right);
   std::pair<TxTreeNode *, TxTreeNode *> ret(parent->left, parent->right);
@@ -2444,7 +4472,7 @@ TxTree::split(TxTreeNode *parent, ExecutionState *left, ExecutionState *right) {
 
 void TxTree::markPathCondition(ExecutionState &state,
                                std::vector<ref<Expr> > &unsatCore) {
-  TimerStatIncrementer t(markPathConditionTime);
+  TX_TIMER(markPathConditionTime);
   int debugSubsumptionLevel =
       currentTxTreeNode->dependency->debugSubsumptionLevel;
 
@@ -2468,8 +4496,9 @@ void TxTree::markPathCondition(ExecutionState &state,
       stream << "]";
       stream.flush();
     }
-    currentTxTreeNode->dependency->markAllValues(binst->getCondition(),
-                                                 unknownExpression, reason);
+    currentTxTreeNode->dependency->markAllValues(
+        binst->getCondition(), unknownExpression,
+        TxCoreReasons::intern(reason));
   }
 
   // We create path condition marking structure and mark core constraints
@@ -2486,7 +4515,8 @@ void TxTree::executePHI(llvm::Instruction *instr, unsigned incomingBlock,
 
 void TxTree::executeOnNode(TxTreeNode *node, llvm::Instruction *instr,
                            std::vector<ref<Expr> > &args) {
-  TimerStatIncrementer t(executeOnNodeTime);
+  TX_TIMER(executeOnNodeTime);
+  SamplingProfiler::Scope phase(SamplingProfiler::Dependency);
   node->execute(instr, args, symbolicExecutionError);
   symbolicExecutionError = false;
 }
@@ -2502,31 +4532,19 @@ void TxTree::storeSpeculationUnsatCore(TimingSolver *solver,
 }
 
 void TxTree::storeInstruction(KInstruction *instr, unsigned incomingBB) {
-  currentTxTreeNode->reverseInstructionList.push_back(
-      std::pair<KInstruction *, bool>(instr, 0));
-  if (llvm::isa<llvm::PHINode>(instr->inst)) {
-    currentTxTreeNode->phiNodeArg.insert(
-        std::pair<llvm::Instruction *, unsigned>(instr->inst, incomingBB));
-  }
+  currentTxTreeNode->instructionTrace.append(instr, incomingBB);
 }
 
 void TxTree::markInstruction(KInstruction *instr, bool branchFlag) {
-  std::vector<std::pair<KInstruction *, int> >::iterator iter =
-      std::find(currentTxTreeNode->reverseInstructionList.begin(),
-                currentTxTreeNode->reverseInstructionList.end(),
-                std::pair<KInstruction *, int>(instr, 0));
   // Marking all the br instruction that have one branch as infeasible.
   // Other infeasible paths (like the infeasible paths in the internal
   // KLEE function klee_make_symbolic are not tracked by weakest pre-
   // condition approach.
-  std::string fname = iter->first->inst->getParent()->getParent()->getName();
-  if (isa<llvm::BranchInst>(iter->first->inst) &&
+  std::string fname = instr->inst->getParent()->getParent()->getName();
+  if (isa<llvm::BranchInst>(instr->inst) &&
       fname.find("klee_") == std::string::npos &&
       fname.find("tx_") == std::string::npos) {
-    if (branchFlag == true)
-      iter->second = 1;
-    else
-      iter->second = 2;
+    currentTxTreeNode->instructionTrace.mark(instr, branchFlag ? 1 : 2);
   }
 }
 
@@ -2625,17 +4643,21 @@ void TxTreeNode::printTimeStat(std::stringstream &stream) {
 TxTreeNode::TxTreeNode(
     TxTreeNode *_parent, llvm::DataLayout *_targetData,
     std::map<const llvm::GlobalValue *, ref<ConstantExpr> > *_globalAddresses)
-    : parent(_parent), left(0), right(0), programPoint(0), prevProgramPoint(0),
-      phiValuesFlag(1), nodeSequenceNumber(0), storable(true),
+    : wp(0), parent(_parent), left(0), right(0), programPoint(0),
+      programPointInstruction(0), prevProgramPoint(0), phiValuesFlag(1), nodeSequenceNumber(0), storable(true),
+      storableFunction(0),
       graph(_parent ? _parent->graph : 0),
       instructionsDepth(_parent ? _parent->instructionsDepth : 0),
       targetData(_targetData), globalAddresses(_globalAddresses),
       genericEarlyTermination(false), assertionFail(false),
-      emitAllErrors(false), isSubsumed(false) {
-  if (_parent) {
-    entryCallHistory = _parent->callHistory;
+      emitAllErrors(false), isSubsumed(false),
+      merged(_parent ? _parent->merged : false), entryStackDepth(0),
+      minStackDepth(0) {
+  if (_parent)
     callHistory = _parent->callHistory;
-  }
+  entryCallHistoryId = callHistoryId = _parent ? _parent->callHistoryId : 0;
+  entryCallHistoryHash = callHistoryHash =
+      _parent ? _parent->callHistoryHash : 0;
 
   // Inherit the abstract dependency or NULL
   dependency = new TxDependency(_parent ? _parent->dependency : 0, _targetData,
@@ -2648,27 +4670,44 @@ TxTreeNode::TxTreeNode(
     visitedProgramPoints = NULL;
     specTime = NULL;
   }
+  state = 0;
 
-  // Set the child WP Interpolants to false
+  // Set the child WP Interpolants to true; the weakest precondition object
+  // itself is only created when the interpolant of the node is generated.
   if (WPInterpolant) {
-    wp = new TxWeakestPreCondition(this, dependency, _targetData);
-    childWPInterpolant[0] = wp->True();
-    childWPInterpolant[1] = wp->True();
+    childWPInterpolant[0] = ConstantExpr::alloc(1, Expr::Bool);
+    childWPInterpolant[1] = ConstantExpr::alloc(1, Expr::Bool);
   }
 }
 
 TxTreeNode::~TxTreeNode() {
   if (dependency)
     delete dependency;
-  if (WPInterpolant && wp) {
+  if (wp)
     delete wp;
+}
+
+TxWeakestPreCondition *TxTreeNode::getWP() {
+  if (!wp)
+    wp = new TxWeakestPreCondition(this, dependency, targetData);
+  return wp;
+}
+
+unsigned TxTreeNode::getIncomingBB(llvm::Instruction *phi) const {
+  for (std::vector<TxWPTraceEntry>::const_iterator
+           it = reverseInstructionList.begin(),
+           ie = reverseInstructionList.end();
+       it != ie; ++it) {
+    if (it->instr->inst == phi)
+      return it->incomingBB;
   }
+  return 0;
 }
 
 ref<Expr> TxTreeNode::getInterpolant(
     std::set<const Array *> &replacements,
     std::map<ref<Expr>, ref<Expr> > &substitution) const {
-  TimerStatIncrementer t(getInterpolantTime);
+  TX_TIMER(getInterpolantTime);
   ref<Expr> expr = dependency->packInterpolant(replacements, substitution);
   return expr;
 }
@@ -2712,7 +4751,7 @@ void TxTreeNode::mark() {
       stream.flush();
     }
     this->dependency->markAllValues(binst->getCondition(), unknownExpression,
-                                    reason);
+                                    TxCoreReasons::intern(reason));
   }
 
   // We create path condition marking structure and mark core constraints
@@ -2720,43 +4759,45 @@ void TxTreeNode::mark() {
 }
 
 ref<Expr> TxTreeNode::generateWPInterpolant() {
-  TimerStatIncrementer t(getWPInterpolantTime);
+  TX_TIMER(getWPInterpolantTime);
+  SamplingProfiler::Scope phase(SamplingProfiler::WeakestPrecondition);
+  instructionTrace.decode(reverseInstructionList);
 
   ref<Expr> expr;
   if (assertionFail && emitAllErrors) {
-    expr = wp->False();
+    expr = getWP()->False();
   } else if (assertionFail) {
-    wp->resetWPExpr();
+    getWP()->resetWPExpr();
     // Generate weakest precondition from pathCondition and/or BB instructions
-    expr = wp->True();
+    expr = getWP()->True();
   } else if (childWPInterpolant[0].isNull() || childWPInterpolant[1].isNull()) {
     expr = childWPInterpolant[0].isNull() ? childWPInterpolant[0]
                                           : childWPInterpolant[1];
-  } else if (childWPInterpolant[0] == wp->False() ||
-             childWPInterpolant[1] == wp->False()) {
-    expr = wp->False();
-  } else if (childWPInterpolant[0] == wp->True() &&
-             childWPInterpolant[1] == wp->True()) {
-    wp->resetWPExpr();
+  } else if (childWPInterpolant[0] == getWP()->False() ||
+             childWPInterpolant[1] == getWP()->False()) {
+    expr = getWP()->False();
+  } else if (childWPInterpolant[0] == getWP()->True() &&
+             childWPInterpolant[1] == getWP()->True()) {
+    getWP()->resetWPExpr();
     // Generate weakest precondition from pathCondition and/or BB instructions
-    expr = wp->PushUp(reverseInstructionList);
+    expr = getWP()->PushUp(reverseInstructionList);
   } else {
     // Get branch condition
-    llvm::Instruction *i = reverseInstructionList.back().first->inst;
+    llvm::Instruction *i = reverseInstructionList.back().instr->inst;
     if (i->getOpcode() == llvm::Instruction::Br) {
       llvm::BranchInst *br = dyn_cast<llvm::BranchInst>(i);
       if (br->isConditional()) {
-        branchCondition = wp->getBrCondition(i);
+        branchCondition = getWP()->getBrCondition(i);
       }
     }
     if (!branchCondition.isNull()) {
-      expr = wp->intersectWPExpr(branchCondition, childWPInterpolant[0],
-                                 childWPInterpolant[1]);
+      expr = getWP()->intersectWPExpr(branchCondition, childWPInterpolant[0],
+                                      childWPInterpolant[1]);
       if (!expr.isNull()) {
-        wp->setWPExpr(expr);
+        getWP()->setWPExpr(expr);
         // Generate weakest precondition from pathCondition and/or BB
         // instructions
-        expr = wp->PushUp(reverseInstructionList);
+        expr = getWP()->PushUp(reverseInstructionList);
       }
     } else {
       expr = branchCondition; // expr is null
@@ -2764,16 +4805,7 @@ ref<Expr> TxTreeNode::generateWPInterpolant() {
     expr = Z3Simplification::simplify(expr);
   }
 
-  // set to parent node
-  if (parent) {
-    //	  llvm::errs() << "Parent Node is " << parent->getNodeSequenceNumber()
-    //<< "\n";
-    if (parent->left == this) {
-      parent->childWPInterpolant[0] = expr;
-    } else {
-      parent->childWPInterpolant[1] = expr;
-    }
-  }
+  std::vector<TxWPTraceEntry>().swap(reverseInstructionList);
   return expr;
 }
 
@@ -2785,12 +4817,12 @@ ref<Expr> TxTreeNode::getChildWPInterpolant(int flag) {
 }
 
 llvm::Instruction *TxTreeNode::getPreviousInstruction(llvm::PHINode *phi) {
-  for (std::vector<std::pair<KInstruction *, int> >::const_reverse_iterator
+  for (std::vector<TxWPTraceEntry>::const_reverse_iterator
            it = reverseInstructionList.rbegin(),
            ie = reverseInstructionList.rend();
        it != ie; ++it) {
-    if ((*it).first->inst == phi)
-      return (*++it).first->inst;
+    if (it->instr->inst == phi)
+      return (++it)->instr->inst;
   }
   klee_error(
       "TxTreeNode::getPreviousInstruction: Control should not reach here!");
@@ -2984,17 +5016,19 @@ void TxTreeNode::setWPatSubsumption(ref<Expr> _wpInterpolant) {
 }
 
 void TxTreeNode::addConstraint(ref<Expr> &constraint, llvm::Value *condition) {
-  TimerStatIncrementer t(addConstraintTime);
+  TX_TIMER(addConstraintTime);
   ref<TxPCConstraint> pcConstraint =
       dependency->addConstraint(constraint, condition, callHistory);
   graph->addPathCondition(this, pcConstraint.get(), constraint);
 }
 
 void TxTreeNode::split(ExecutionState *leftData, ExecutionState *rightData) {
-  TimerStatIncrementer t(splitTime);
+  TX_TIMER(splitTime);
   assert(left == 0 && right == 0);
   leftData->txTreeNode = createLeftChild();
   rightData->txTreeNode = createRightChild();
+  leftData->txTreeNode->state = leftData;
+  rightData->txTreeNode->state = rightData;
   if (INTERPOLATION_ENABLED && SpecTypeToUse != NO_SPEC &&
       this->speculationFlag) {
     leftData->txTreeNode->setSpeculationFlag();
@@ -3009,30 +5043,50 @@ void TxTreeNode::split(ExecutionState *leftData, ExecutionState *rightData) {
 void TxTreeNode::execute(llvm::Instruction *instr,
                          std::vector<ref<Expr> > &args,
                          bool symbolicExecutionError) {
-  TimerStatIncrementer t(executeTime);
+  TX_TIMER(executeTime);
   dependency->execute(instr, callHistory, args, symbolicExecutionError);
 }
 
 void TxTreeNode::bindCallArguments(llvm::Instruction *site,
                                    std::vector<ref<Expr> > &arguments) {
-  TimerStatIncrementer t(bindCallArgumentsTime);
+  TX_TIMER(bindCallArgumentsTime);
+  unsigned historySize = callHistory.size();
   dependency->bindCallArguments(site, callHistory, arguments);
+  if (callHistory.size() > historySize) {
+    callHistoryHash = extendCallHistoryHash(callHistoryHash, site);
+    callHistoryId = TxCallHistory::extend(callHistoryId, site);
+  }
 }
 
 void TxTreeNode::bindReturnValue(llvm::CallInst *site, llvm::Instruction *inst,
                                  ref<Expr> returnValue) {
   // TODO: This is probably where we should simplify
   // the dependency graph by removing callee values.
-  TimerStatIncrementer t(bindReturnValueTime);
+  TX_TIMER(bindReturnValueTime);
+  llvm::Instruction *call = callHistory.empty() ? 0 : callHistory.back();
+  unsigned historySize = callHistory.size();
   dependency->bindReturnValue(site, callHistory, inst, returnValue);
+  if (callHistory.size() < historySize) {
+    callHistoryHash = retractCallHistoryHash(callHistoryHash, call);
+    callHistoryId = TxCallHistory::retract(callHistoryId);
+  }
+}
+
+uint64_t TxTreeNode::getCallHistoryHash(
+    const std::vector<llvm::Instruction *> &callHistory) {
+  uint64_t hash = 0;
+  for (std::vector<llvm::Instruction *>::const_iterator
+           it = callHistory.begin(),
+           ie = callHistory.end();
+       it != ie; ++it)
+    hash = extendCallHistoryHash(hash, *it);
+  return hash;
 }
 
 void TxTreeNode::getStoredExpressions(
     const std::vector<llvm::Instruction *> &_callHistory, bool &leftRetrieval,
-    TxStore::TopStateStore &__internalStore,
-    TxStore::LowerStateStore &__concretelyAddressedHistoricalStore,
-    TxStore::LowerStateStore &__symbolicallyAddressedHistoricalStore) const {
-  TimerStatIncrementer t(getStoredExpressionsTime);
+    TxStore::StateStoreView &stateStore) const {
+  TX_TIMER(getStoredExpressionsTime);
   std::map<ref<Expr>, ref<Expr> > dummySubstitution;
   std::set<const Array *> dummyReplacements;
 
@@ -3040,10 +5094,9 @@ void TxTreeNode::getStoredExpressions(
   // the allocations to be stored in subsumption table should be obtained
   // from the parent node.
   if (parent) {
-    dependency->getParentStoredExpressions(
-        _callHistory, dummySubstitution, dummyReplacements, false,
-        leftRetrieval, __internalStore, __concretelyAddressedHistoricalStore,
-        __symbolicallyAddressedHistoricalStore);
+    dependency->getParentStoredExpressions(_callHistory, dummySubstitution,
+                                           dummyReplacements, false,
+                                           leftRetrieval, stateStore);
   }
 }
 
@@ -3056,7 +5109,7 @@ void TxTreeNode::getStoredCoreExpressions(
     TxStore::LowerInterpolantStore &concretelyAddressedHistoricalStore,
     TxStore::LowerInterpolantStore &symbolicallyAddressedHistoricalStore)
     const {
-  TimerStatIncrementer t(getStoredCoreExpressionsTime);
+  TX_TIMER(getStoredCoreExpressionsTime);
 
   // Since a program point index is a first statement in a basic block,
   // the allocations to be stored in subsumption table should be obtained
@@ -3074,6 +5127,21 @@ uint64_t TxTreeNode::getInstructionsDepth() { return instructionsDepth; }
 
 void TxTreeNode::incInstructionsDepth() { ++instructionsDepth; }
 
+void TxTreeNode::mergeWith(TxTreeNode *other) {
+  // The flag is propagated to the ancestors as the nodes are removed
+  genericEarlyTermination = true;
+  other->genericEarlyTermination = true;
+  merged = true;
+  ++TxTree::mergeCount;
+}
+
+void TxTreeNode::mergeValue(llvm::Value *value, ref<Expr> mergedExpr,
+                            ref<Expr> expr, const TxTreeNode *other,
+                            ref<Expr> otherExpr) {
+  dependency->mergeValue(value, callHistory, mergedExpr, expr,
+                         other->dependency, otherExpr);
+}
+
 void
 TxTreeNode::unsatCoreInterpolation(const std::vector<ref<Expr> > &unsatCore) {
   dependency->unsatCoreInterpolation(unsatCore);
@@ -28,13 +28,33 @@
 
 #include "StatsTracker.h"
 #include "TxDependency.h"
+#include "TxObjectPool.h"
 #include "TxSpeculation.h"
 #include "TxWP.h"
+#include "TxWPTrace.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/GlobalValue.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+
+/// \brief Time a Tracer-X method into a statistic.
+///
+/// The per-call timers are compiled out of the builds without assertions,
+/// where the cost of reading the clock on every entry and exit would show in
+/// the measurements. Use -sampling-profile-interval to profile those builds.
+#ifdef NDEBUG
+#define TX_TIMER(statistic)
+#else
+#define TX_TIMER(statistic) TimerStatIncrementer t(statistic)
+#endif
+
 namespace klee {
 
+class Assignment;
+
+class KModule;
+
 class TxWeakestPreCondition;
 
 /// \brief The subsumption table.
@@ -51,6 +71,8 @@ class TxWeakestPreCondition;
 ///
 /// \see TxSubsumptionTableEntry
 class TxSubsumptionTable {
+  friend class TxMemoryCensus;
+
   typedef std::deque<TxSubsumptionTableEntry *>::const_reverse_iterator
   EntryIterator;
 
@@ -64,7 +86,16 @@ class TxSubsumptionTable {
 
       std::map<llvm::Instruction *, Node *> next;
 
-      Node(llvm::Instruction *_id) : id(_id) {}
+      Node *parent;
+
+      /// \brief The length of the call history of the node
+      unsigned depth;
+
+      Node(llvm::Instruction *_id, Node *_parent)
+          : id(_id), parent(_parent), depth(_parent ? _parent->depth + 1 : 0) {}
+
+      /// \brief Test if the node is the one of the given call history
+      bool matches(const std::vector<llvm::Instruction *> &callHistory) const;
 
       void dump() const {
         this->print(llvm::errs());
@@ -80,10 +111,15 @@ class TxSubsumptionTable {
 
     Node *root;
 
+    /// \brief The nodes having entries, hashed by their call history, so
+    /// that the trie does not have to be walked at every lookup. In case of
+    /// a hash collision only the first node is kept.
+    llvm::DenseMap<uint64_t, Node *> index;
+
     void printNode(llvm::raw_ostream &stream, Node *n, std::string edges) const;
 
   public:
-    CallHistoryIndexedTable() { root = new Node(0); }
+    CallHistoryIndexedTable() { root = new Node(0, 0); }
 
     ~CallHistoryIndexedTable() { clearTree(root); }
 
@@ -92,9 +128,50 @@ class TxSubsumptionTable {
     void insert(const std::vector<llvm::Instruction *> &callHistory,
                 TxSubsumptionTableEntry *entry);
 
+    /// \brief Find the entries of the call history, whose hash, as computed
+    /// by TxTreeNode::getCallHistoryHash, is given.
     std::pair<EntryIterator, EntryIterator>
     find(const std::vector<llvm::Instruction *> &callHistory,
-         bool &found) const;
+         uint64_t callHistoryHash, bool &found) const;
+
+    /// \brief Collect the call histories of the nodes having entries that
+    /// hold unconditionally, and hence can be saved into a file.
+    void getUnconditionalCallHistories(
+        std::vector<std::vector<llvm::Instruction *> > &histories) const {
+      std::vector<llvm::Instruction *> history;
+      getUnconditionalCallHistories(root, history, histories);
+    }
+
+    void getUnconditionalCallHistories(
+        Node *node, std::vector<llvm::Instruction *> &history,
+        std::vector<std::vector<llvm::Instruction *> > &histories) const;
+
+    /// \brief Test if there is an unconditional entry for the call history.
+    bool
+    hasUnconditionalEntry(const std::vector<llvm::Instruction *> &callHistory)
+        const;
+
+    /// \brief Return the entries of the call history, or NULL in case there
+    /// are none.
+    std::deque<TxSubsumptionTableEntry *> *
+    getEntryList(const std::vector<llvm::Instruction *> &callHistory);
+
+    /// \brief Collect the entries of all call histories.
+    void getEntries(std::vector<TxSubsumptionTableEntry *> &entries) const {
+      getEntries(root, entries);
+    }
+
+    void getEntries(Node *node,
+                    std::vector<TxSubsumptionTableEntry *> &entries) const;
+
+    /// \brief Remove and delete the given entries, returning how many of them
+    /// were in this table.
+    unsigned removeEntries(const std::set<TxSubsumptionTableEntry *> &evicted) {
+      return removeEntries(root, evicted);
+    }
+
+    unsigned removeEntries(Node *node,
+                           const std::set<TxSubsumptionTableEntry *> &evicted);
 
     void dump() const {
       this->print(llvm::errs());
@@ -104,9 +181,81 @@ class TxSubsumptionTable {
     void print(llvm::raw_ostream &stream) const;
   };
 
-  static std::map<uintptr_t, CallHistoryIndexedTable *> instance;
+  /// \brief The tables of the program points, hashed as they are looked up
+  /// at the start of every node
+  typedef llvm::DenseMap<uintptr_t, CallHistoryIndexedTable *> TableMap;
+
+  typedef llvm::DenseMap<uintptr_t, unsigned> EntryCountMap;
+
+  static TableMap instance;
+
+  /// \brief The subsumption checks at a program point, for -subsumption-profile
+  struct ProgramPointProfile {
+    /// \brief The number of checks against the entries
+    uint64_t checkCount;
+
+    uint64_t successCount;
+
+    /// \brief The number of failures, indexed by
+    /// TxSubsumptionTableEntry::CheckFailure
+    uint64_t failureCount[6];
+
+    /// \brief The time spent in the checks against the entries, in seconds
+    double checkTime;
+
+    /// \brief The number of queries sent to the solver, and their total
+    /// number of distinct expression nodes
+    uint64_t queryCount;
+    uint64_t querySize;
+
+    ProgramPointProfile()
+        : checkCount(0), successCount(0), checkTime(0.0), queryCount(0),
+          querySize(0) {
+      for (unsigned i = 0; i < 6; ++i)
+        failureCount[i] = 0;
+    }
+  };
+
+  static std::map<uintptr_t, ProgramPointProfile> profile;
+
+  /// \brief The number of entries at each program point
+  static EntryCountMap entryCount;
+
+  /// \brief The number of entries in all the tables
+  static unsigned totalEntryCount;
+
+  /// \brief Delete an entry of the program point, already removed from its
+  /// list.
+  static void deleteEntry(uintptr_t id, TxSubsumptionTableEntry *entry);
+
+  /// \brief Evict the entries of the lowest utility (see
+  /// TxSubsumptionTableEntry#getUtility), down to the given number of
+  /// entries, returning the number of entries evicted.
+  static unsigned evict(unsigned target);
+
+  /// \brief The summaries of each program point, see
+  /// TxSubsumptionTable#insertSummary
+  static std::map<uintptr_t, std::vector<TxSubsumptionTableEntry *> >
+  summaries;
+
+  /// \brief Check the state against the summaries of its program point
+  static bool checkSummaries(TimingSolver *solver, ExecutionState &state,
+                             double timeout, int debugSubsumptionLevel);
 
 public:
+  /// \brief Compute a fingerprint of the module, such that saved entries are
+  /// only reused on the very same code.
+  static uint64_t getModuleFingerprint(KModule *kmodule);
+
+  /// \brief The number of entries evicted for statistical purposes
+  static uint64_t evictionCount;
+
+  /// \brief Evict the quarter of the entries of the lowest utility, to free
+  /// memory near -max-memory. Returns the number of entries evicted.
+  static unsigned shed() {
+    return evict(totalEntryCount - totalEntryCount / 4);
+  }
+
   static void insert(uintptr_t id,
                      const std::vector<llvm::Instruction *> &callHistory,
                      TxSubsumptionTableEntry *entry);
@@ -114,14 +263,103 @@ public:
   static bool check(TimingSolver *solver, ExecutionState &state, double timeout,
                     int debugSubsumptionLevel);
 
+  /// \brief Merge a new entry with the latest entries of its program point
+  /// and call history that only differ from it by their interpolants, with
+  /// -merge-subsumption-entries.
+  ///
+  /// An older entry whose interpolant implies the one of the new entry is
+  /// removed, as the new one subsumes all the states it does. When the two
+  /// interpolants only differ by one conjunct, the new entry takes their
+  /// disjunction instead. Returns false when an older entry already subsumes
+  /// all the states of the new entry, which is then not to be inserted.
+  static bool merge(TimingSolver *solver, uintptr_t id,
+                    const std::vector<llvm::Instruction *> &callHistory,
+                    TxSubsumptionTableEntry *entry, int debugSubsumptionLevel);
+
+  /// \brief Keep the entries of the program point and call history of a new
+  /// entry an antichain, with -eliminate-redundant-entries.
+  ///
+  /// An entry generalizes another when its interpolant is implied by the
+  /// other one, syntactically as a subset of its conjuncts or by at most
+  /// -redundant-entry-solver-checks solver calls, and its stores are a subset
+  /// of the stores of the other one, with the same values. The older entries
+  /// the new entry generalizes are removed. Returns false when an older entry
+  /// generalizes the new entry, which is then not to be inserted.
+  static bool eliminateRedundant(
+      TimingSolver *solver, uintptr_t id,
+      const std::vector<llvm::Instruction *> &callHistory,
+      TxSubsumptionTableEntry *entry, int debugSubsumptionLevel);
+
+  /// \brief The number of entries not stored or removed as redundant, for
+  /// statistical purposes
+  static uint64_t redundantEntryCount;
+
+  /// \brief Widen a new entry of a loop header with the entries of its
+  /// program point and call history that only differ from it by the
+  /// constant value of one location, with -loop-widening.
+  ///
+  /// The entries of the iterations of a loop typically only differ by the
+  /// value of its induction variable. When the values of the new entry and of
+  /// an older one form a contiguous range, the older one is removed and the
+  /// new entry takes the range. This is sound without a solver call: a state
+  /// whose value is within the range satisfies the entry of that value, which
+  /// the widened entry otherwise equals, hence it is subsumed by that entry.
+  static void widen(uintptr_t id,
+                    const std::vector<llvm::Instruction *> &callHistory,
+                    TxSubsumptionTableEntry *entry, int debugSubsumptionLevel);
+
+  /// \brief The number of entries removed by widening for statistical
+  /// purposes
+  static uint64_t widenedEntryCount;
+
+  /// \brief Record the entry of a node as a summary of its program point for
+  /// all call histories, with -function-summaries, when the subtree of the
+  /// node never returned from its function and the entry only has an
+  /// interpolant.
+  ///
+  /// The interpolant of an entry covers the whole rest of the paths from its
+  /// program point, hence the code run after the return to the callers,
+  /// which differs between the call sites. An entry whose subtree never
+  /// returned is independent of the callers. Its stores would be keyed by the
+  /// allocation contexts of its call history, hence only the entries without
+  /// stores are summaries.
+  static void insertSummary(TxTreeNode *node, TxSubsumptionTableEntry *entry);
+
+  /// \brief The number of states subsumed by summaries for statistical
+  /// purposes
+  static uint64_t summaryHitCount;
+
   static bool hasInterpolation(ExecutionState &state);
 
+  /// \brief The number of entries at the program point, for all call
+  /// histories together
+  static unsigned getEntryCount(uintptr_t programPoint) {
+    EntryCountMap::const_iterator it = entryCount.find(programPoint);
+    return it == entryCount.end() ? 0 : it->second;
+  }
+
   static void clear();
 
+  /// \brief Save the table entries that hold unconditionally into a binary
+  /// file, for reuse by later runs on the same module.
+  ///
+  /// Such entries have no interpolant, no stores, and no global, weakest
+  /// precondition or phi node conditions. Program points and call histories
+  /// are identified using the instruction ids of InstructionInfoTable.
+  static void save(const std::string &fileName, KModule *kmodule);
+
+  /// \brief Load the table entries saved by TxSubsumptionTable::save. Nothing
+  /// is loaded in case the file was saved for a different module, and entries
+  /// already in the table are skipped, such that the file can be merged
+  /// repeatedly during the run.
+  static void load(const std::string &fileName, KModule *kmodule);
+
+  /// \brief Write the profile of the subsumption checks collected with
+  /// -subsumption-profile as CSV, with a line for each program point.
+  static void saveProfile(llvm::raw_ostream &stream, KModule *kmodule);
+
   static void print(llvm::raw_ostream &stream) {
-    for (std::map<uintptr_t, CallHistoryIndexedTable *>::const_iterator
-             it = instance.begin(),
-             ie = instance.end();
+    for (TableMap::const_iterator it = instance.begin(), ie = instance.end();
          it != ie; ++it) {
       stream << it->first << ": ";
       it->second->print(stream);
@@ -130,6 +368,57 @@ public:
   }
 };
 
+/// \brief A syntactic summary of the store keys of a subsumption table entry.
+///
+/// A table entry can only subsume a state whose store contains all the
+/// allocations of the entry's concretely- and symbolically-addressed stores,
+/// and all the addresses of its historical stores. The signature records these
+/// keys, together with a small Bloom filter of their allocation sites, so that
+/// entries failing for such structural reasons are rejected before any
+/// constraint is built or the solver is called.
+///
+/// The signature of a state is computed once per subsumption check using the
+/// TxStoreSignature(const TxStore::StateStoreView &) constructor, which only
+/// fills in the Bloom filters.
+class TxStoreSignature {
+  /// \brief Bloom filter of the allocation sites of the regular stores
+  uint64_t allocationFilter;
+
+  /// \brief Bloom filter of the allocation sites of the historical stores
+  uint64_t historicalFilter;
+
+  /// \brief The allocations required by the regular stores
+  std::set<ref<TxAllocationContext> > allocationContexts;
+
+  /// \brief The addresses required by the historical stores
+  std::set<ref<TxVariable> > historicalVariables;
+
+  static uint64_t getFilterBits(const llvm::Value *site);
+
+public:
+  TxStoreSignature() : allocationFilter(0), historicalFilter(0) {}
+
+  TxStoreSignature(const TxStore::StateStoreView &stateStore);
+
+  /// \brief Rebuild the signature from the stores of a table entry.
+  void build(const TxStore::TopInterpolantStore &concretelyAddressedStore,
+             const TxStore::TopInterpolantStore &symbolicallyAddressedStore,
+             const TxStore::LowerInterpolantStore &
+                 concretelyAddressedHistoricalStore,
+             const TxStore::LowerInterpolantStore &
+                 symbolicallyAddressedHistoricalStore);
+
+  /// \brief Test whether a state may contain all the store keys of this
+  /// signature.
+  ///
+  /// \param stateSignature The Bloom filters of the state store.
+  /// \param stateStore The state store itself.
+  /// \return false if some key is definitely missing from the state store,
+  /// true otherwise.
+  bool mayMatch(const TxStoreSignature &stateSignature,
+                const TxStore::StateStoreView &stateStore) const;
+};
+
 /// \brief The class that implements an entry (record) in the subsumption table.
 ///
 /// The subsumption table records the generalization of state such that
@@ -161,6 +450,10 @@ public:
 class TxSubsumptionTableEntry {
   friend class TxTree;
 
+  friend class TxMemoryCensus;
+
+  friend class TxSubsumptionTable;
+
 #ifdef ENABLE_Z3
   /// \brief Mark begin and end of subsumption check for use within a scope
   struct SubsumptionCheckMarker {
@@ -172,6 +465,75 @@ class TxSubsumptionTableEntry {
   static Statistic concretelyAddressedStoreExpressionBuildTime;
   static Statistic symbolicallyAddressedStoreExpressionBuildTime;
   static Statistic solverAccessTime;
+  static Statistic preFilterRejectionCount;
+  static Statistic modelRejectionCount;
+  static Statistic quantifiedQueryCacheHits;
+  static Statistic quantifiedQueryCacheMisses;
+
+  /// \brief The reason why a subsumption check failed, recorded by subsumed()
+  /// for the subsumption profile
+  enum CheckFailure {
+    NoFailure,
+    /// The stores or the other conditions of the entry did not match the state
+    StoreMismatch,
+    /// The query was found unsatisfiable or non-true by simplification
+    SimplificationFailure,
+    /// A model of the path condition falsified the query
+    ModelRefutation,
+    /// The solver decided that the query is not valid
+    SolverInvalid,
+    /// The solver did not decide the query, normally due to a timeout
+    SolverTimeout
+  };
+
+  /// \brief The outcome of the last call to subsumed()
+  static CheckFailure lastCheckFailure;
+
+  /// \brief The size of the query of the last call to subsumed(), or zero when
+  /// the solver was not called
+  static unsigned lastQuerySize;
+
+  /// \brief Count the distinct nodes of an expression
+  static unsigned getExprSize(ref<Expr> expr);
+
+  /// \brief The result of an existentially-quantified subsumption check query
+  /// decided by the solver.
+  struct QuantifiedQueryResult {
+    QuantifiedQueryResult(const ConstraintManager &_constraints,
+                          ref<Expr> _query, Solver::Validity _validity,
+                          const std::vector<ref<Expr> > &_unsatCore)
+        : constraints(_constraints), query(_query), validity(_validity),
+          unsatCore(_unsatCore) {}
+
+    ConstraintManager constraints;
+    ref<Expr> query;
+    Solver::Validity validity;
+    std::vector<ref<Expr> > unsatCore;
+  };
+
+  /// \brief Results of existentially-quantified queries indexed by hash.
+  ///
+  /// Such queries are solved by a fresh Z3 solver outside of the solver chain,
+  /// and therefore miss the caching solvers. The shadow arrays bound by the
+  /// quantifier are unique per original array (see TxShadowArray), so a table
+  /// entry checked against structurally identical states produces identical
+  /// queries.
+  static std::map<unsigned, std::vector<QuantifiedQueryResult> >
+  quantifiedQueryCache;
+
+  /// \brief The number of results in
+  /// TxSubsumptionTableEntry#quantifiedQueryCache
+  static unsigned quantifiedQueryCacheSize;
+
+  static unsigned hashQuery(const Query &query);
+
+  static bool lookupQuantifiedQuery(const Query &query,
+                                    Solver::Validity &validity,
+                                    std::vector<ref<Expr> > &unsatCore);
+
+  static void insertQuantifiedQuery(const Query &query,
+                                    Solver::Validity validity,
+                                    const std::vector<ref<Expr> > &unsatCore);
 
   ref<Expr> interpolant;
 
@@ -189,11 +551,104 @@ class TxSubsumptionTableEntry {
 
   std::set<const Array *> existentials;
 
+  /// \brief The substitution of the existentially-quantified variables of
+  /// the interpolant, kept to be applied to the values of the stores
+  std::map<ref<Expr>, ref<Expr> > storeSubstitution;
+
+  /// \brief Whether the values of the stores are still unshadowed, which is
+  /// done at the first use of the entry, as many entries are never checked
+  bool pendingShadowing;
+
   // Used to ensure at subsumption the value of the phiNodes in the subsumed
   // tree remain the same
   uintptr_t prevProgramPoint;
   std::map<llvm::Value *, std::vector<ref<Expr> > > phiValues;
 
+  /// \brief Summary of the store keys, kept in sync with the stores above
+  TxStoreSignature signature;
+
+  /// \brief Whether the weakest precondition interpolant of the entry is yet
+  /// to be computed (see TxTree#pendingNodes)
+  bool pendingWP;
+
+  /// \brief The number of subsumption checks of the entry
+  unsigned checkCount;
+
+  /// \brief The number of states subsumed by the entry
+  unsigned hitCount;
+
+  /// \brief The time spent in the subsumption checks of the entry, in
+  /// seconds
+  double checkTime;
+
+  /// \brief The location of the concretely-addressed store widened by
+  /// TxSubsumptionTable#widen, or null. The value of the location in the
+  /// state is only required to be within the unsigned range of
+  /// TxSubsumptionTableEntry#widenedLow to
+  /// TxSubsumptionTableEntry#widenedHigh, instead of being equal to the
+  /// tabled value.
+  /// \brief The least size of the stack reached by the subtree of the node
+  /// of the entry (see TxTreeNode#minStackDepth), which is also reached by
+  /// the subtrees of the states it subsumes
+  unsigned minStackDepth;
+
+  ref<TxAllocationContext> widenedContext;
+  ref<TxVariable> widenedVariable;
+  uint64_t widenedLow;
+  uint64_t widenedHigh;
+
+  /// \brief Test whether the entry and the other one only differ by the
+  /// constant value of one location of their concretely-addressed stores, or
+  /// also by the other range when it is already widened at that location.
+  /// The location is returned through the reference arguments.
+  bool getWideningLocation(const TxSubsumptionTableEntry *other,
+                           ref<TxAllocationContext> &context,
+                           ref<TxVariable> &variable) const;
+
+  /// \brief The unsigned range of the values of a location of the
+  /// concretely-addressed store, which is a single constant unless the entry
+  /// is widened at the location
+  void getWidenedRange(ref<TxAllocationContext> context,
+                       ref<TxVariable> variable, uint64_t &low,
+                       uint64_t &high) const;
+
+  /// \brief Test whether the entry subsumes all the states that the other
+  /// entry subsumes, syntactically or, when the interpolant of the other entry
+  /// is not syntactically stronger, by a solver call while the given number of
+  /// solver checks is positive, which it then decrements (see
+  /// TxSubsumptionTable::eliminateRedundant). The stores are to be shadowed.
+  bool generalizes(TimingSolver *solver, const TxSubsumptionTableEntry *other,
+                   unsigned &solverChecks) const;
+
+  /// \brief Test whether the entry is only made of its interpolant, such that
+  /// it can be merged with the entries similarly made by comparing their
+  /// interpolants (see TxSubsumptionTable::merge).
+  bool hasInterpolantOnly() const {
+    return !pendingWP && concretelyAddressedStore.empty() &&
+           symbolicallyAddressedStore.empty() &&
+           concretelyAddressedHistoricalStore.empty() &&
+           symbolicallyAddressedHistoricalStore.empty() &&
+           existentials.empty() && markedGlobal.empty() &&
+           wpInterpolant.isNull() && phiValues.empty();
+  }
+
+  /// \brief The use of keeping the entry: the states it subsumed per second
+  /// of checking it. Entries that are never checked are the most useful, as
+  /// they cost nothing yet.
+  double getUtility() const { return (hitCount + 1) / (checkTime + 0.001); }
+
+  /// \brief Shadow the values of the stores, adding their shadow arrays to
+  /// the existentials, if not yet done. This does not change the store keys,
+  /// hence TxSubsumptionTableEntry#signature stays valid.
+  void shadowStores();
+
+  /// \brief Recompute TxSubsumptionTableEntry#signature from the stores
+  void updateSignature() {
+    signature.build(concretelyAddressedStore, symbolicallyAddressedStore,
+                    concretelyAddressedHistoricalStore,
+                    symbolicallyAddressedHistoricalStore);
+  }
+
   /// \brief A procedure for building subsumption check constraints using
   /// symbolically-addressed store elements
   ///
@@ -229,6 +684,26 @@ class TxSubsumptionTableEntry {
   getBoundFreeConjunction(std::set<const Array *> &existentials,
                           ref<Expr> expr);
 
+  /// \brief Compute a model of the path condition of a state, for the cheap
+  /// refutation of the subsumption check queries by isFalsifiedBy.
+  ///
+  /// \return An assignment of the symbolic arrays of the state, which is empty
+  /// when the solver fails to provide one.
+  static Assignment *getStateModel(TimingSolver *solver,
+                                   ExecutionState &state);
+
+  /// \brief Test whether a conjunct of a query expression free of the bound
+  /// variables evaluates to false under a model of the path condition, in
+  /// which case the query is not valid.
+  ///
+  /// \param model A model of the path condition.
+  /// \param variables The bound variables, or null for an unquantified query.
+  /// \param expr The query expression.
+  /// \return true if the model falsifies the query, false otherwise.
+  static bool isFalsifiedBy(Assignment &model,
+                            std::set<const Array *> *variables,
+                            ref<Expr> expr);
+
   /// \brief Test for the non-existence of a variable in a set in an expression.
   ///
   /// \param existentials A set of variables (KLEE arrays).
@@ -292,6 +767,23 @@ class TxSubsumptionTableEntry {
   static ref<Expr> removeUnsubstituted(std::set<const Array *> &variables,
                                        ref<Expr> equalities);
 
+  /// \brief Eliminate existentially-quantified variables from a conjunction.
+  ///
+  /// A variable is eliminated by the one-point rule when a conjunct is an
+  /// equality that can be solved for it, by inverting additions, subtractions,
+  /// exclusive ors and extensions of the same width. Otherwise, when the
+  /// variable only occurs as an operand of comparisons with the same
+  /// signedness, it is eliminated by requiring each of its lower bounds to be
+  /// below each of its upper bounds, as in Fourier-Motzkin elimination, which
+  /// is exact here as no arithmetic is applied to the variable. A variable is
+  /// only eliminated when none of its arrays remains in the conjunction.
+  ///
+  /// \param variables The existentially-quantified variables.
+  /// \param body The conjunction.
+  /// \return The conjunction without the eliminated variables.
+  static ref<Expr> eliminateExistentials(std::set<const Array *> &variables,
+                                         ref<Expr> body);
+
   static void interpolateValues(
       ExecutionState &state, std::set<ref<TxStateValue> > &coreValues,
       std::map<ref<TxStateValue>, std::set<uint64_t> > &corePointerValues,
@@ -302,9 +794,51 @@ class TxSubsumptionTableEntry {
            symbolicallyAddressedStore.empty();
   }
 
+  /// \brief Test whether the entry subsumes any state at its program point
+  /// and call history, such that it can be saved into a file.
+  bool isUnconditional() const {
+    return !pendingWP && interpolant.isNull() &&
+           concretelyAddressedStore.empty() &&
+           symbolicallyAddressedStore.empty() &&
+           concretelyAddressedHistoricalStore.empty() &&
+           symbolicallyAddressedHistoricalStore.empty() &&
+           existentials.empty() && markedGlobal.empty() &&
+           wpInterpolant.isNull() && phiValues.empty() &&
+           !llvm::isa<llvm::PHINode>(
+               reinterpret_cast<llvm::Instruction *>(programPoint));
+  }
+
   /// \brief For printing member functions running time statistics,
   static void printStat(std::stringstream &stream);
 
+  /// \brief Decide the validity of an unquantified subsumption check query
+  /// with the solver, with the timeout chosen by TxQueryPredictor. Returns
+  /// false when the query timed out or was skipped as predicted to time out.
+  static bool evaluateWithPredictedTimeout(TimingSolver *solver,
+                                           ExecutionState &state,
+                                           double timeout, ref<Expr> expr,
+                                           Solver::Validity &result,
+                                           std::vector<ref<Expr> > &unsatCore);
+
+  /// \brief Decide the validity of a subsumption check query, through the
+  /// solver chain when it is unquantified, or with a dedicated Z3 solver and
+  /// the cache of the quantified queries otherwise.
+  bool solveSubsumptionQuery(TimingSolver *solver, ExecutionState &state,
+                             double timeout, ref<Expr> expr,
+                             Solver::Validity &result,
+                             std::vector<ref<Expr> > &unsatCore,
+                             int debugSubsumptionLevel);
+
+  /// \brief Decide the validity of a subsumption check query by the groups
+  /// of its conjuncts that share no variables, the quantifier-free and the
+  /// smaller ones first, stopping at the first group that is not valid. The
+  /// unsatisfiability core is the union of those of the groups.
+  bool solvePartitioned(TimingSolver *solver, ExecutionState &state,
+                        double timeout, ref<Expr> expr,
+                        Solver::Validity &result,
+                        std::vector<ref<Expr> > &unsatCore,
+                        int debugSubsumptionLevel);
+
 public:
   const uintptr_t programPoint;
 
@@ -313,14 +847,27 @@ public:
   TxSubsumptionTableEntry(TxTreeNode *node,
                           const std::vector<llvm::Instruction *> &callHistory);
 
+  /// \brief Create an unconditional entry for a program point, as loaded by
+  /// TxSubsumptionTable::load
+  TxSubsumptionTableEntry(uintptr_t _programPoint);
+
   ~TxSubsumptionTableEntry();
 
-  bool
-  subsumed(TimingSolver *solver, ExecutionState &state, double timeout,
-           bool leftRetrieval, TxStore::TopStateStore &__internalStore,
-           TxStore::LowerStateStore &__concretelyAddressedHistoricalStore,
-           TxStore::LowerStateStore &__symbolicallyAddressedHistoricalStore,
-           int debugSubsumptionLevel);
+  /// \brief Test whether the state is subsumed by this entry.
+  ///
+  /// \param stateModel A model of the path condition of the state, shared by
+  /// the checks against the entries of a program point and computed on first
+  /// use.
+  bool subsumed(TimingSolver *solver, ExecutionState &state, double timeout,
+                bool leftRetrieval, const TxStore::StateStoreView &stateStore,
+                Assignment *&stateModel, int debugSubsumptionLevel);
+
+  /// \brief Cheap syntactic test that is necessary for subsumption: a state
+  /// store missing any of the store keys of this entry cannot be subsumed.
+  bool mayBeSubsumed(const TxStoreSignature &stateSignature,
+                     const TxStore::StateStoreView &stateStore) const {
+    return signature.mayMatch(stateSignature, stateStore);
+  }
 
   /// Tests if the argument is a variable. A variable here is defined to be
   /// either a symbolic concatenation or a symbolic read. A concatenation in
@@ -406,6 +953,8 @@ public:
 class TxTreeNode {
   friend class TxTree;
 
+  friend class TxMemoryCensus;
+
   friend class ExecutionState;
 
   // Timers for profiling the execution times of the member functions of this
@@ -425,6 +974,11 @@ class TxTreeNode {
   /// purposes
   static uint64_t nextNodeSequenceNumber;
 
+  /// \brief The odd multiplier of the call history hash and its inverse
+  /// modulo 2^64, with which a call can be removed from the hash
+  static const uint64_t CallHistoryHashMultiplier = 0x100000001b3ULL;
+  static const uint64_t CallHistoryHashInverse = 0xce965057aff6957bULL;
+
   /// \brief Value dependencies
   TxDependency *dependency;
 
@@ -440,7 +994,7 @@ class TxTreeNode {
   bool speculationFailed;
 
   // \brief Instance of weakest precondition class used to generate WP
-  // interpolant
+  // interpolant, only created when the interpolant is generated
   TxWeakestPreCondition *wp;
 
   /// \brief Child WP expressions
@@ -454,6 +1008,10 @@ class TxTreeNode {
   uintptr_t programPoint;
   llvm::BasicBlock *basicBlock;
 
+  /// \brief The KLEE instruction of the program point, flagged on storing a
+  /// table entry for this node
+  KInstruction *programPointInstruction;
+
   // Used to ensure at subsumption the value of the phiNodes in the subsumed
   // tree remain the same
   uintptr_t prevProgramPoint;
@@ -464,6 +1022,10 @@ class TxTreeNode {
 
   bool storable;
 
+  /// \brief The function of the last instruction for which
+  /// TxTreeNode#storable was computed
+  llvm::Function *storableFunction;
+
   /// \brief Graph for displaying as .dot file
   TxTreeGraph *graph;
 
@@ -494,9 +1056,13 @@ class TxTreeNode {
     // Disabling the subsumption check within KLEE's own API
     // (call sites of klee_ and at any location within the klee_ function)
     // by never store a table entry for KLEE's own API, marked with flag
-    // storable.
-    storable = !(instr->getParent()->getParent()->getName().substr(0, 5).equals(
-                    "klee_"));
+    // storable. This runs before every instruction of the node, hence the
+    // name is only compared when the function changes.
+    llvm::Function *function = instr->getParent()->getParent();
+    if (function != storableFunction) {
+      storableFunction = function;
+      storable = !function->getName().startswith("klee_");
+    }
   }
 
   /// \brief for printing member function running time statistics
@@ -534,6 +1100,35 @@ class TxTreeNode {
 public:
   bool isSubsumed;
 
+  /// \brief Indicates that the node continues a merge of states, or descends
+  /// from such a node. The interpolants of the merged region are not computed
+  /// and its states are not checked for subsumption, as the dependencies of
+  /// the merged values and stores are only approximated.
+  bool merged;
+
+  /// \brief The size of the stack of the state when the node began
+  unsigned entryStackDepth;
+
+  /// \brief The least size of the stack reached by the paths of the subtree
+  /// of the node, including the paths cut by subsumption. The subtree never
+  /// returned from the function of the node when it is not less than
+  /// TxTreeNode#entryStackDepth.
+  unsigned minStackDepth;
+
+  /// \brief Record the size of the stack after a return from a function
+  void recordReturn(unsigned stackDepth) {
+    minStackDepth = std::min(minStackDepth, stackDepth);
+  }
+
+  /// \brief Allocation from the free-list pool of TxTreeNode objects
+  static void *operator new(size_t size) {
+    return TxObjectPool<TxTreeNode>::allocate(size);
+  }
+
+  static void operator delete(void *object, size_t size) {
+    TxObjectPool<TxTreeNode>::deallocate(object, size);
+  }
+
   // \brief The unsat core from a infeasible path is temporarily stored here
   // and in case speculation is failed it's used to do marking related to
   // the infeasible path
@@ -547,21 +1142,57 @@ public:
     return globalAddresses;
   }
 
-  /// \brief List of the instructions in the node in a reverse order (used only
-  /// in WP interpolation)
-  /// Second argument is 0 means instruction is not dependent to any target
-  /// Second argument is 1 means instruction is dependent to a target
-  /// Second argument is 2 means negation of the instruction is dependent to a
-  /// target
-  std::vector<std::pair<KInstruction *, int> > reverseInstructionList;
-  std::map<llvm::Instruction *, unsigned> phiNodeArg;
+  /// \brief The instructions executed in the node (used only in WP
+  /// interpolation), with the incoming block of the PHI nodes and the
+  /// markings of the branches
+  TxWPTrace instructionTrace;
 
-  /// \brief The entry call history
-  std::vector<llvm::Instruction *> entryCallHistory;
+  /// \brief The decoded instruction trace, only held while the WP
+  /// interpolant of the node is generated
+  std::vector<TxWPTraceEntry> reverseInstructionList;
+
+  /// \brief Return the index of the incoming block of the first execution of
+  /// the PHI node in this node
+  unsigned getIncomingBB(llvm::Instruction *phi) const;
+
+  /// \brief The id of the entry call history, interned by TxCallHistory
+  unsigned entryCallHistoryId;
 
   /// \brief The current call history
   std::vector<llvm::Instruction *> callHistory;
 
+  /// \brief The id of the current call history, maintained as calls are
+  /// pushed into and popped from it
+  unsigned callHistoryId;
+
+  /// \brief The entry call history
+  const std::vector<llvm::Instruction *> &getEntryCallHistory() const {
+    return TxCallHistory::get(entryCallHistoryId);
+  }
+
+  /// \brief The hash of the entry call history
+  uint64_t entryCallHistoryHash;
+
+  /// \brief The hash of the current call history, maintained as calls are
+  /// pushed into and popped from it
+  uint64_t callHistoryHash;
+
+  /// \brief Compute the rolling hash of a call history. The hash of a
+  /// history extended by a call is computed by extendCallHistoryHash, and
+  /// retracted back by retractCallHistoryHash.
+  static uint64_t
+  getCallHistoryHash(const std::vector<llvm::Instruction *> &callHistory);
+
+  static uint64_t extendCallHistoryHash(uint64_t hash,
+                                        llvm::Instruction *call) {
+    return hash * CallHistoryHashMultiplier + (uintptr_t)call;
+  }
+
+  static uint64_t retractCallHistoryHash(uint64_t hash,
+                                         llvm::Instruction *call) {
+    return (hash - (uintptr_t)call) * CallHistoryHashInverse;
+  }
+
   uintptr_t getProgramPoint() { return programPoint; }
   llvm::BasicBlock *getBasicBlock() { return basicBlock; }
 
@@ -596,6 +1227,11 @@ public:
   std::set<uintptr_t> *visitedProgramPoints;
   double *specTime;
 
+  /// \brief The state placed at this node when it was created by a split,
+  /// with which the states of a failed speculation subtree are found
+  /// without scanning all states
+  ExecutionState *state;
+
   /// \brief Check if the current node is a speculation node
   bool isSpeculationNode();
 
@@ -629,8 +1265,8 @@ public:
   /// expression.
   ref<Expr> generateWPInterpolant();
 
-  /// \return Return the weakest precondition object
-  TxWeakestPreCondition *getWP() { return wp; }
+  /// \brief Return the weakest precondition object, creating it on first use
+  TxWeakestPreCondition *getWP();
 
   /// \brief Get the stored child WP interpolants in the parent node
   ref<Expr> getChildWPInterpolant(int flag);
@@ -679,14 +1315,12 @@ public:
                        ref<Expr> returnValue);
 
   /// \brief This retrieves the allocations known at this state, and the
-  /// expressions stored in the allocations. This returns as the two last
-  /// arguments a pair of the store part indexed by constants, and the store
-  /// part indexed by symbolic expressions.
-  void getStoredExpressions(
-      const std::vector<llvm::Instruction *> &callHistory, bool &leftRetrieval,
-      TxStore::TopStateStore &__internalStore,
-      TxStore::LowerStateStore &__concretelyAddressedHistoricalStore,
-      TxStore::LowerStateStore &__symbolicallyAddressedHistoricalStore) const;
+  /// expressions stored in the allocations. This returns as the last argument
+  /// a read-only view of the store of the parent node, which is valid for as
+  /// long as the parent node is not modified.
+  void getStoredExpressions(const std::vector<llvm::Instruction *> &callHistory,
+                            bool &leftRetrieval,
+                            TxStore::StateStoreView &stateStore) const;
 
   /// \brief This retrieves the allocations known at this state, and the
   /// expressions stored in the allocations, as long as the allocation is
@@ -713,6 +1347,17 @@ public:
 
   uint64_t getInstructionsDepth();
 
+  /// \brief Record the merge of the state of another node into the state of
+  /// this one, as by ExecutionState#merge. Neither node nor any of their
+  /// ancestors is tabled, as their interpolants would miss the paths of the
+  /// merged state, and this node begins a merged region.
+  void mergeWith(TxTreeNode *other);
+
+  /// \brief Register the merged value of a local of the state, flowing from
+  /// its values in this node and in the node of the other merged state.
+  void mergeValue(llvm::Value *value, ref<Expr> mergedExpr, ref<Expr> expr,
+                  const TxTreeNode *other, ref<Expr> otherExpr);
+
   /// \brief Marking the core constraints on the path condition, and all the
   /// relevant values on the dependency graph, given an unsatistiability core.
   void unsatCoreInterpolation(const std::vector<ref<Expr> > &unsatCore);
@@ -720,8 +1365,7 @@ public:
   /// \brief Memory bounds interpolation from a target address. Returns true if
   /// memory bounds check fails somehow.
   bool pointerValuesInterpolation(ref<TxStateValue> value,
-                                  std::set<uint64_t> &bounds,
-                                  const std::string &reason) {
+                                  std::set<uint64_t> &bounds, unsigned reason) {
     return dependency->markAllPointerValues(value, bounds, reason);
   }
 
@@ -732,8 +1376,9 @@ public:
   }
 
   /// \brief Exact / non-pointer value interpolation
-  void valuesInterpolation(ref<TxStateValue> value, const std::string &reason) {
-    dependency->markAllValues(value, reason);
+  void valuesInterpolation(const std::set<ref<TxStateValue> > &values,
+                           unsigned reason) {
+    dependency->markAllValues(values, reason);
   }
 
   void setGenericEarlyTermination() { genericEarlyTermination = true; }
@@ -861,6 +1506,8 @@ public:
 /// \see TxSubsumptionTable
 /// \see TxSubsumptionTableEntry
 class TxTree {
+  friend class TxMemoryCensus;
+
   typedef std::vector<ref<Expr> > ExprList;
   typedef ExprList::iterator iterator;
   typedef ExprList::const_iterator const_iterator;
@@ -887,6 +1534,73 @@ class TxTree {
   /// two decimal points.
   static std::string inTwoDecimalPoints(const double n);
 
+  /// \brief A removed node, kept until the weakest precondition interpolants
+  /// of it and of its descendants are computed
+  struct PendingNode {
+    TxTreeNode *node;
+
+    /// \brief The table entry of the node, or NULL if it was not stored
+    TxSubsumptionTableEntry *entry;
+
+    /// \brief The index of the node among the children of its parent
+    int childIndex;
+
+    PendingNode(TxTreeNode *_node, TxSubsumptionTableEntry *_entry,
+                int _childIndex)
+        : node(_node), entry(_entry), childIndex(_childIndex) {}
+  };
+
+  /// \brief The removed nodes in the order of their removal, such that the
+  /// descendants of a node are completed before it
+  static std::deque<PendingNode> pendingNodes;
+
+  /// \brief Compute the weakest precondition interpolant of a removed node
+  /// into its table entry and its parent, and delete the node.
+  static void completeNode(const PendingNode &pending);
+
+  /// \brief Complete a removed node, or defer it with -defer-wp-interpolant.
+  static void retireNode(TxTreeNode *node, TxSubsumptionTableEntry *entry,
+                         int childIndex);
+
+  /// \brief The subsumption checks of the states of a function, for
+  /// -adaptive-interpolation-warmup
+  struct FunctionProfile {
+    uint64_t checkCount;
+
+    uint64_t successCount;
+
+    /// \brief The number of nodes that skipped their check and tabling since
+    /// the function was disabled
+    uint64_t skipCount;
+
+    bool disabled;
+
+    FunctionProfile()
+        : checkCount(0), successCount(0), skipCount(0), disabled(false) {}
+  };
+
+  /// \brief The profiles of the functions, keyed by the functions of the
+  /// program points of the nodes
+  static llvm::DenseMap<const llvm::Function *, FunctionProfile>
+  functionProfiles;
+
+  static const llvm::Function *getFunction(TxTreeNode *node) {
+    return node->programPointInstruction
+               ? node->programPointInstruction->inst->getParent()->getParent()
+               : 0;
+  }
+
+  /// \brief Whether the function of the node is disabled by
+  /// -adaptive-interpolation-warmup, such that the node is neither checked
+  /// nor tabled. Counts the node as skipped, enabling the function again
+  /// after -adaptive-interpolation-resample nodes.
+  static bool isFunctionDisabled(TxTreeNode *node);
+
+  /// \brief Record the outcome of a subsumption check into the profile of
+  /// the function of the node, disabling the function when its warm-up ends
+  /// with too few successes.
+  static void recordFunctionCheck(TxTreeNode *node, bool success);
+
 public:
   // Several static member variables for profiling the execution time of
   // this class's member functions.
@@ -903,6 +1617,13 @@ public:
   /// \brief Number of subsumption checks for statistical purposes
   static uint64_t subsumptionCheckCount;
 
+  /// \brief Number of merges of states for statistical purposes
+  static uint64_t mergeCount;
+
+  /// \brief Number of the times functions were disabled by
+  /// -adaptive-interpolation-warmup for statistical purposes
+  static uint64_t disabledFunctionCount;
+
   /// \brief Number of visited basic blocks for statistical purposes
   static uint64_t blockCount;
 
@@ -920,10 +1641,11 @@ public:
          std::map<const llvm::GlobalValue *, ref<ConstantExpr> > *
              _globalAddresses);
 
-  ~TxTree() {
-    TxSubsumptionTable::clear();
-    delete initialStateCopy;
-  }
+  ~TxTree();
+
+  /// \brief Compute the deferred weakest precondition interpolants up to the
+  /// one of the given table entry.
+  static void completePendingEntry(TxSubsumptionTableEntry *entry);
 
   /// \brief Set the reference to the KLEE state in the current interpolation
   /// data holder (Tracer-X tree node) that is currently being processed.
@@ -1034,7 +1756,7 @@ public:
                                            llvm::Instruction *instr,
                                            ref<Expr> value, ref<Expr> address,
                                            bool inBounds) {
-    TimerStatIncrementer t(executeMemoryOperationTime);
+    TX_TIMER(executeMemoryOperationTime);
     std::vector<ref<Expr> > args;
     args.push_back(value);
     args.push_back(address);
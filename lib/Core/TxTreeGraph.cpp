@@ -16,6 +16,7 @@
 #include "klee/util/TxTreeGraph.h"
 
 #include "klee/ExecutionState.h"
+#include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/util/TxPrintUtil.h"
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
@@ -55,6 +56,51 @@ uint64_t TxTreeGraph::nodeCount = 1;
 
 TxTreeGraph *TxTreeGraph::instance = 0;
 
+std::ofstream *TxTreeGraph::eventStream = 0;
+
+std::map<TxTreeNode *, TxTreeGraph::StreamNode> TxTreeGraph::streamNodes;
+
+std::map<TxSubsumptionTableEntry *, uint64_t> TxTreeGraph::streamEntries;
+
+uint64_t TxTreeGraph::streamNodeCount = 0;
+
+/// \brief The source location of an instruction, or the instruction itself
+/// when it has no debug information
+static std::string getInstructionLocation(llvm::Instruction *inst) {
+  std::string location;
+  llvm::raw_string_ostream out(location);
+  if (llvm::MDNode *n = inst->getMetadata("dbg")) {
+    // Display the line, char position of this instruction
+    llvm::DILocation loc(n);
+    unsigned line = loc.getLineNumber();
+    llvm::StringRef file = loc.getFilename();
+    out << file << ":" << line << "\n";
+  } else {
+    inst->print(out);
+  }
+  return out.str();
+}
+
+uint64_t TxTreeGraph::getStreamNodeId(TxTreeNode *txTreeNode) {
+  StreamNode &node = streamNodes[txTreeNode];
+  if (!node.id)
+    node.id = ++streamNodeCount;
+  return node.id;
+}
+
+void TxTreeGraph::writeStreamString(const std::string &s) {
+  for (std::string::const_iterator it = s.begin(), ie = s.end(); it != ie;
+       ++it) {
+    if (*it == '\\')
+      *eventStream << "\\\\";
+    else if (*it == '\n')
+      *eventStream << "\\n";
+    else
+      *eventStream << *it;
+  }
+  *eventStream << "\n";
+}
+
 std::string TxTreeGraph::recurseRender(TxTreeGraph::Node *node) {
   std::ostringstream stream;
 
@@ -272,6 +318,13 @@ void TxTreeGraph::addChildren(TxTreeNode *parent, TxTreeNode *falseChild,
                               TxTreeNode *trueChild) {
   nodeCount += 2;
 
+  if (eventStream) {
+    uint64_t parentId = getStreamNodeId(parent);
+    uint64_t falseId = getStreamNodeId(falseChild);
+    *eventStream << "S " << parentId << " " << falseId << " "
+                 << getStreamNodeId(trueChild) << "\n";
+  }
+
   if (!OUTPUT_INTERPOLATION_TREE)
     return;
 
@@ -294,6 +347,32 @@ void TxTreeGraph::addChildren(TxTreeNode *parent, TxTreeNode *falseChild,
 
 void TxTreeGraph::setCurrentNode(ExecutionState &state,
                                  const uint64_t _nodeSequenceNumber) {
+  // This runs before every instruction, and usually has nothing to record
+  if (!eventStream && !OUTPUT_INTERPOLATION_TREE)
+    return;
+
+  bool isMark = false;
+  if (llvm::ReturnInst *ri = llvm::dyn_cast<llvm::ReturnInst>(state.pc->inst)) {
+    if (ri->getParent()) {
+      if (llvm::Function *f = ri->getParent()->getParent())
+        isMark = f->getName() == "tracerx_mark";
+    }
+  }
+
+  if (eventStream) {
+    uint64_t id = getStreamNodeId(state.txTreeNode);
+    StreamNode &streamNode = streamNodes[state.txTreeNode];
+    if (!streamNode.visited) {
+      streamNode.visited = true;
+      *eventStream << "V " << id << " " << _nodeSequenceNumber << " ";
+      writeStreamString(
+          state.pc->inst->getParent()->getParent()->getName().str() + "\\l" +
+          getInstructionLocation(state.pc->inst));
+    }
+    if (isMark)
+      *eventStream << "M " << id << "\n";
+  }
+
   if (!OUTPUT_INTERPOLATION_TREE)
     return;
 
@@ -304,37 +383,26 @@ void TxTreeGraph::setCurrentNode(ExecutionState &state,
   if (!node->nodeSequenceNumber) {
     std::string functionName(
         state.pc->inst->getParent()->getParent()->getName().str());
-    node->name = functionName + "\\l";
-    llvm::raw_string_ostream out(node->name);
-    if (llvm::MDNode *n = state.pc->inst->getMetadata("dbg")) {
-      // Display the line, char position of this instruction
-      llvm::DILocation loc(n);
-      unsigned line = loc.getLineNumber();
-      llvm::StringRef file = loc.getFilename();
-      out << file << ":" << line << "\n";
-    } else {
-      state.pc->inst->print(out);
-    }
-    node->name = out.str();
+    node->name = functionName + "\\l" + getInstructionLocation(state.pc->inst);
     node->nodeSequenceNumber = _nodeSequenceNumber;
   }
 
   // Increase the mark addition count when there is a return from a function
   // named tracerx_mark.
-  if (llvm::ReturnInst *ri = llvm::dyn_cast<llvm::ReturnInst>(state.pc->inst)) {
-    if (ri->getParent()) {
-      if (llvm::Function *f = ri->getParent()->getParent()) {
-        if (f->getName().str() == "tracerx_mark") {
-          (node->markCount)++;
-          (node->markAddition)++;
-        }
-      }
-    }
+  if (isMark) {
+    (node->markCount)++;
+    (node->markAddition)++;
   }
 }
 
 void TxTreeGraph::markAsSubsumed(TxTreeNode *txTreeNode,
                                  TxSubsumptionTableEntry *entry) {
+  if (eventStream) {
+    *eventStream << "B " << getStreamNodeId(txTreeNode) << " "
+                 << (streamEntries.count(entry) ? streamEntries[entry] : 0)
+                 << "\n";
+  }
+
   if (!OUTPUT_INTERPOLATION_TREE)
     return;
 
@@ -343,6 +411,9 @@ void TxTreeGraph::markAsSubsumed(TxTreeNode *txTreeNode,
   TxTreeGraph::Node *node = instance->txTreeNodeMap[txTreeNode];
   node->subsumed = true;
   TxTreeGraph::Node *subsuming = instance->tableEntryMap[entry];
+  // Entries loaded from a file have no node in the graph
+  if (!subsuming)
+    return;
   instance->subsumptionEdges.push_back(new TxTreeGraph::NumberedEdge(
       node, subsuming, ++(instance->subsumptionEdgeNumber)));
 }
@@ -350,6 +421,12 @@ void TxTreeGraph::markAsSubsumed(TxTreeNode *txTreeNode,
 void TxTreeGraph::addPathCondition(TxTreeNode *txTreeNode,
                                    TxPCConstraint *pathCondition,
                                    ref<Expr> condition) {
+  if (eventStream) {
+    *eventStream << "C " << getStreamNodeId(txTreeNode) << " "
+                 << reinterpret_cast<uintptr_t>(pathCondition) << " ";
+    writeStreamString(TxPrettyExpressionBuilder::construct(condition));
+  }
+
   if (!OUTPUT_INTERPOLATION_TREE)
     return;
 
@@ -366,6 +443,14 @@ void TxTreeGraph::addPathCondition(TxTreeNode *txTreeNode,
 
 void TxTreeGraph::addTableEntryMapping(TxTreeNode *txTreeNode,
                                        TxSubsumptionTableEntry *entry) {
+  if (eventStream) {
+    // The entries are identified by the nodes they were created from, which
+    // are removed right after.
+    uint64_t id = getStreamNodeId(txTreeNode);
+    streamEntries[entry] = id;
+    *eventStream << "T " << id << "\n";
+  }
+
   if (!OUTPUT_INTERPOLATION_TREE)
     return;
 
@@ -375,7 +460,28 @@ void TxTreeGraph::addTableEntryMapping(TxTreeNode *txTreeNode,
   instance->tableEntryMap[entry] = node;
 }
 
+void TxTreeGraph::removeTableEntryMapping(TxSubsumptionTableEntry *entry) {
+  if (eventStream) {
+    std::map<TxSubsumptionTableEntry *, uint64_t>::iterator it =
+        streamEntries.find(entry);
+    if (it != streamEntries.end()) {
+      *eventStream << "U " << it->second << "\n";
+      streamEntries.erase(it);
+    }
+  }
+
+  if (!OUTPUT_INTERPOLATION_TREE)
+    return;
+
+  assert(TxTreeGraph::instance && "Search tree graph not initialized");
+
+  instance->tableEntryMap.erase(entry);
+}
+
 void TxTreeGraph::setAsCore(TxPCConstraint *pathCondition) {
+  if (eventStream)
+    *eventStream << "I " << reinterpret_cast<uintptr_t>(pathCondition) << "\n";
+
   if (!OUTPUT_INTERPOLATION_TREE)
     return;
 
@@ -388,23 +494,18 @@ void TxTreeGraph::setAsCore(TxPCConstraint *pathCondition) {
 
 void TxTreeGraph::setError(const ExecutionState &state,
                            TxTreeGraph::Error errorType) {
+  if (eventStream) {
+    *eventStream << "E " << getStreamNodeId(state.txTreeNode) << " "
+                 << errorType << " ";
+    writeStreamString(getInstructionLocation(state.pc->inst));
+  }
+
   if (!OUTPUT_INTERPOLATION_TREE)
     return;
 
   TxTreeGraph::Node *node = instance->txTreeNodeMap[state.txTreeNode];
   node->errorType = errorType;
-
-  node->errorLocation = "";
-  llvm::raw_string_ostream out(node->errorLocation);
-  if (llvm::MDNode *n = state.pc->inst->getMetadata("dbg")) {
-    // Display the line, char position of this instruction
-    llvm::DILocation loc(n);
-    unsigned line = loc.getLineNumber();
-    llvm::StringRef file = loc.getFilename();
-    out << file << ":" << line << "\n";
-  } else {
-    state.pc->inst->print(out);
-  }
+  node->errorLocation = getInstructionLocation(state.pc->inst);
 
   // Mark the path as leading to memory error
   while (node) {
@@ -426,3 +527,40 @@ void TxTreeGraph::save(std::string dotFileName) {
     out.close();
   }
 }
+
+void TxTreeGraph::openEventStream(const std::string &fileName,
+                                  TxTreeNode *root) {
+  closeEventStream();
+
+  eventStream = new std::ofstream(fileName.c_str());
+  if (eventStream->fail()) {
+    klee_warning("could not open tree event file %s", fileName.c_str());
+    delete eventStream;
+    eventStream = 0;
+    return;
+  }
+  *eventStream << "R " << getStreamNodeId(root) << "\n";
+}
+
+void TxTreeGraph::closeEventStream() {
+  if (!eventStream)
+    return;
+
+  eventStream->close();
+  delete eventStream;
+  eventStream = 0;
+  streamNodes.clear();
+  streamEntries.clear();
+}
+
+void TxTreeGraph::removeNode(TxTreeNode *txTreeNode) {
+  if (!eventStream)
+    return;
+
+  std::map<TxTreeNode *, StreamNode>::iterator it =
+      streamNodes.find(txTreeNode);
+  if (it == streamNodes.end())
+    return;
+  *eventStream << "X " << it->second.id << "\n";
+  streamNodes.erase(it);
+}
@@ -32,6 +32,8 @@
 #include <llvm/Type.h>
 #endif
 
+#include <algorithm>
+
 using namespace klee;
 
 namespace klee {
@@ -40,6 +42,62 @@ bool concreteBound(uint64_t bound) { return bound < symbolicBoundId; }
 
 /**/
 
+std::deque<TxCallHistory::Node> TxCallHistory::nodes(1);
+
+llvm::DenseMap<std::pair<unsigned, llvm::Instruction *>, unsigned>
+TxCallHistory::children;
+
+unsigned TxCallHistory::intern(
+    const std::vector<llvm::Instruction *> &history) {
+  unsigned id = 0;
+  for (std::vector<llvm::Instruction *>::const_iterator it = history.begin(),
+                                                        ie = history.end();
+       it != ie; ++it)
+    id = extend(id, *it);
+  return id;
+}
+
+unsigned TxCallHistory::extend(unsigned id, llvm::Instruction *site) {
+  std::pair<llvm::DenseMap<std::pair<unsigned, llvm::Instruction *>,
+                           unsigned>::iterator,
+            bool> res =
+      children.insert(std::make_pair(std::make_pair(id, site), 0u));
+  if (res.second) {
+    res.first->second = nodes.size();
+    nodes.push_back(Node());
+    Node &node = nodes.back();
+    node.parent = id;
+    node.history = nodes[id].history;
+    node.history.push_back(site);
+  }
+  return res.first->second;
+}
+
+std::vector<std::string> TxCoreReasons::names(1, "");
+
+std::map<std::string, unsigned> TxCoreReasons::tags;
+
+unsigned TxCoreReasons::intern(const std::string &reason) {
+  if (reason.empty())
+    return 0;
+  std::map<std::string, unsigned>::iterator it = tags.find(reason);
+  if (it != tags.end())
+    return it->second;
+  unsigned tag = names.size();
+  names.push_back(reason);
+  tags[reason] = tag;
+  return tag;
+}
+
+void TxCoreReasons::getTags(std::vector<unsigned> &result) const {
+  for (unsigned i = 0; i < bits.size(); ++i) {
+    for (uint64_t word = bits[i]; word; word &= word - 1)
+      result.push_back(i * 64 + __builtin_ctzll(word));
+  }
+}
+
+/**/
+
 void TxStoreEntry::print(llvm::raw_ostream &stream,
                          const std::string &prefix) const {
   std::string tabsNext = appendTab(prefix);
@@ -52,29 +110,31 @@ void TxStoreEntry::print(llvm::raw_ostream &stream,
   stream << prefix << "content:\n";
   if (leftCore && rightCore) {
     stream << tabsNext << "a left and right interpolant value:\n";
-    for (std::set<std::string>::iterator it = leftCoreReasons.begin(),
-                                         ie = leftCoreReasons.end();
-         it != ie; ++it) {
-      stream << tabsNextNext << *it << "\n";
-    }
-    for (std::set<std::string>::iterator it = rightCoreReasons.begin(),
-                                         ie = rightCoreReasons.end();
+    std::vector<unsigned> reasons;
+    leftCoreReasons.getTags(reasons);
+    rightCoreReasons.getTags(reasons);
+    for (std::vector<unsigned>::iterator it = reasons.begin(),
+                                         ie = reasons.end();
          it != ie; ++it) {
-      stream << tabsNextNext << *it << "\n";
+      stream << tabsNextNext << TxCoreReasons::getName(*it) << "\n";
     }
   } else if (leftCore) {
     stream << tabsNext << "a left interpolant value:\n";
-    for (std::set<std::string>::iterator it = leftCoreReasons.begin(),
-                                         ie = leftCoreReasons.end();
+    std::vector<unsigned> reasons;
+    leftCoreReasons.getTags(reasons);
+    for (std::vector<unsigned>::iterator it = reasons.begin(),
+                                         ie = reasons.end();
          it != ie; ++it) {
-      stream << tabsNextNext << *it << "\n";
+      stream << tabsNextNext << TxCoreReasons::getName(*it) << "\n";
     }
   } else if (rightCore) {
     stream << tabsNext << "a right interpolant value:\n";
-    for (std::set<std::string>::iterator it = rightCoreReasons.begin(),
-                                         ie = rightCoreReasons.end();
+    std::vector<unsigned> reasons;
+    rightCoreReasons.getTags(reasons);
+    for (std::vector<unsigned>::iterator it = reasons.begin(),
+                                         ie = reasons.end();
          it != ie; ++it) {
-      stream << tabsNextNext << *it << "\n";
+      stream << tabsNextNext << TxCoreReasons::getName(*it) << "\n";
     }
   } else {
     stream << tabsNext << "a non-interpolant value:\n";
@@ -174,6 +234,7 @@ void TxAllocationContext::print(llvm::raw_ostream &stream,
     }
     value->print(stream);
   }
+  const std::vector<llvm::Instruction *> &callHistory = getCallHistory();
   if (callHistory.size() > 0) {
     stream << "\n" << prefix << "Call history:";
     for (std::vector<llvm::Instruction *>::const_iterator
@@ -223,11 +284,12 @@ void TxVariable::print(llvm::raw_ostream &stream,
 
 void TxInterpolantValue::init(
     llvm::Value *_value, ref<Expr> _expr, bool canInterpolateBound,
-    const std::set<std::string> &_coreReasons, ref<TxStateAddress> _location,
+    const TxCoreReasons &_coreReasons, ref<TxStateAddress> _location,
     const std::map<ref<Expr>, ref<Expr> > &substitution,
     std::set<const Array *> &replacements, bool shadowing) {
   refCount = 0;
   id = reinterpret_cast<uintptr_t>(this);
+  boundsChecksBuilt = false;
   if (shadowing) {
     _expr = TxShadowArray::getShadowExpression(_expr, replacements);
     for (std::map<ref<Expr>, ref<Expr> >::const_iterator
@@ -304,6 +366,133 @@ void TxInterpolantValue::init(
   }
 }
 
+void TxInterpolantValue::shadow(
+    const std::map<ref<Expr>, ref<Expr> > &substitution,
+    std::set<const Array *> &replacements) {
+  expr = TxShadowArray::getShadowExpression(expr, replacements);
+  for (std::map<ref<Expr>, ref<Expr> >::const_iterator
+           it = substitution.begin(),
+           ie = substitution.end();
+       it != ie; ++it) {
+    expr = TxSubstitutionVisitor(substitution).visit(expr);
+  }
+
+  for (std::map<ref<TxAllocationInfo>, std::set<ref<Expr> > >::iterator
+           it = allocationOffsets.begin(),
+           ie = allocationOffsets.end();
+       it != ie; ++it) {
+    std::set<ref<Expr> > offsets;
+    for (std::set<ref<Expr> >::iterator it1 = it->second.begin(),
+                                        ie1 = it->second.end();
+         it1 != ie1; ++it1) {
+      offsets.insert(TxShadowArray::getShadowExpression(*it1, replacements));
+    }
+    it->second = offsets;
+  }
+}
+
+std::map<unsigned, std::vector<ref<TxInterpolantValue> > >
+TxInterpolantValue::sharedValues;
+
+size_t TxInterpolantValue::sharedValuesSize = 0;
+
+static const size_t MinSharedValuesThreshold = 1 << 12;
+
+size_t TxInterpolantValue::sharedValuesThreshold = MinSharedValuesThreshold;
+
+uint64_t TxInterpolantValue::sharedHitCount = 0;
+
+unsigned TxInterpolantValue::hash() const {
+  unsigned result = expr.isNull() ? 0 : expr->hash();
+  result = result * 31 + (unsigned)reinterpret_cast<uintptr_t>(value);
+  result = result * 31 + doNotUseBound;
+  result = result * 31 + allocationBounds.size();
+  return result * 31 + allocationOffsets.size();
+}
+
+bool TxInterpolantValue::equals(const TxInterpolantValue &other) const {
+  return value == other.value && doNotUseBound == other.doNotUseBound &&
+         expr.isNull() == other.expr.isNull() &&
+         (expr.isNull() || expr == other.expr) &&
+         allocationBounds == other.allocationBounds &&
+         allocationOffsets == other.allocationOffsets &&
+         coreReasons == other.coreReasons &&
+         originalValue.isNull() && other.originalValue.isNull();
+}
+
+ref<TxInterpolantValue>
+TxInterpolantValue::intern(ref<TxInterpolantValue> value) {
+  // The values of the state stores keep their original values, and are not
+  // shared
+  if (!value->originalValue.isNull())
+    return value;
+
+  std::vector<ref<TxInterpolantValue> > &bucket = sharedValues[value->hash()];
+  for (std::vector<ref<TxInterpolantValue> >::iterator it = bucket.begin(),
+                                                       ie = bucket.end();
+       it != ie; ++it) {
+    if (it->get() == value.get())
+      return value;
+    if ((*it)->equals(*value)) {
+      ++sharedHitCount;
+      return *it;
+    }
+  }
+  bucket.push_back(value);
+
+  if (++sharedValuesSize >= sharedValuesThreshold) {
+    collectSharedValues();
+    sharedValuesThreshold =
+        std::max(MinSharedValuesThreshold, 2 * sharedValuesSize);
+  }
+  return value;
+}
+
+void TxInterpolantValue::collectSharedValues() {
+  for (std::map<unsigned, std::vector<ref<TxInterpolantValue> > >::iterator
+           it = sharedValues.begin();
+       it != sharedValues.end();) {
+    std::vector<ref<TxInterpolantValue> > &bucket = it->second;
+    for (unsigned i = 0; i < bucket.size();) {
+      if (bucket[i]->refCount == 1) {
+        bucket[i] = bucket.back();
+        bucket.pop_back();
+        --sharedValuesSize;
+      } else {
+        ++i;
+      }
+    }
+    if (bucket.empty())
+      sharedValues.erase(it++);
+    else
+      ++it;
+  }
+}
+
+void TxInterpolantValue::buildBoundsChecks() const {
+  if (boundsChecksBuilt)
+    return;
+  boundsChecksBuilt = true;
+
+  for (std::map<ref<TxAllocationInfo>, std::set<uint64_t> >::const_iterator
+           it = allocationBounds.begin(),
+           ie = allocationBounds.end();
+       it != ie; ++it) {
+    BoundsCheck &check = boundsChecks[it->first];
+    check.symbolicBound = false;
+    for (std::set<uint64_t>::const_iterator it1 = it->second.begin(),
+                                            ie1 = it->second.end();
+         it1 != ie1; ++it1) {
+      if (!concreteBound(*it1)) {
+        check.symbolicBound = true;
+      } else if (*it1 > 0) {
+        check.bounds.push_back(*it1);
+        check.boundExprs.push_back(Expr::createPointer(*it1));
+      }
+    }
+  }
+}
+
 ref<Expr> TxInterpolantValue::getBoundsCheck(
     ref<TxInterpolantValue> other, std::set<uint64_t> &bounds,
     std::map<ref<TxAllocationInfo>, ref<TxAllocationInfo> > &unifiedBases,
@@ -327,12 +516,14 @@ ref<Expr> TxInterpolantValue::getBoundsCheck(
   // the current object and for each such allocation, retrieve the
   // information from the argument object; in this way resulting in
   // less iterations compared to doing it the other way around.
+  buildBoundsChecks();
+
   bool matchFound = false;
-  for (std::map<ref<TxAllocationInfo>, std::set<uint64_t> >::const_iterator
-           selfBoundsListIt = allocationBounds.begin(),
-           selfBoundsListIe = allocationBounds.end();
+  for (std::map<ref<TxAllocationInfo>, BoundsCheck>::const_iterator
+           selfBoundsListIt = boundsChecks.begin(),
+           selfBoundsListIe = boundsChecks.end();
        selfBoundsListIt != selfBoundsListIe; ++selfBoundsListIt) {
-    std::set<uint64_t> selfBounds = selfBoundsListIt->second;
+    const BoundsCheck &selfCheck = selfBoundsListIt->second;
     std::map<ref<TxAllocationInfo>, std::set<ref<Expr> > >::iterator
     otherOffsetsListIt = other->allocationOffsets.find(selfBoundsListIt->first);
     if (otherOffsetsListIt == other->allocationOffsets.end()) {
@@ -340,9 +531,7 @@ ref<Expr> TxInterpolantValue::getBoundsCheck(
     }
     matchFound = true;
 
-    std::set<ref<Expr> > otherOffsets = otherOffsetsListIt->second;
-
-    assert(!selfBounds.empty() && "tabled bounds empty");
+    const std::set<ref<Expr> > &otherOffsets = otherOffsetsListIt->second;
 
     if (otherOffsets.empty()) {
       if (debugSubsumptionLevel >= 3) {
@@ -359,50 +548,40 @@ ref<Expr> TxInterpolantValue::getBoundsCheck(
              otherOffsetsIt = otherOffsets.begin(),
              otherOffsetsIe = otherOffsets.end();
          otherOffsetsIt != otherOffsetsIe; ++otherOffsetsIt) {
-      for (std::set<uint64_t>::const_iterator selfBoundsIt = selfBounds.begin(),
-                                              selfBoundsIe = selfBounds.end();
-           selfBoundsIt != selfBoundsIe; ++selfBoundsIt) {
-        uint64_t selfBound = *selfBoundsIt;
-        if (concreteBound(selfBound)) {
-          if (ConstantExpr *otherOffsetObj =
-                  llvm::dyn_cast<ConstantExpr>(*otherOffsetsIt)) {
-            if (selfBound > 0) {
-              uint64_t otherOffset = otherOffsetObj->getZExtValue();
-              if (otherOffset >= selfBound) {
-                if (debugSubsumptionLevel >= 3) {
-                  std::string msg;
-                  llvm::raw_string_ostream stream(msg);
-                  selfBoundsListIt->first->print(stream);
-                  stream.flush();
-                  klee_message("Offset %lu out of bound %lu for %s",
-                               otherOffset, selfBound, msg.c_str());
-                }
-                return ConstantExpr::create(0, Expr::Bool);
-              } else {
-                bounds.insert(*selfBoundsIt);
-                continue;
-              }
-            }
-          } else if (selfBound > 0) {
-            // Symbolic state offset, but concrete tabled bound. Here the bound
-            // is known (non-zero), so we create constraints
-            if (res.isNull()) {
-              res = UltExpr::create(*otherOffsetsIt,
-                                    Expr::createPointer(selfBound));
-            } else {
-              res = AndExpr::create(
-                  UltExpr::create(*otherOffsetsIt,
-                                  Expr::createPointer(selfBound)),
-                  res);
+      if (ConstantExpr *otherOffsetObj =
+              llvm::dyn_cast<ConstantExpr>(*otherOffsetsIt)) {
+        // The bounds are ascending, hence the offset is within all of them
+        // when it is within the first
+        if (!selfCheck.bounds.empty()) {
+          uint64_t otherOffset = otherOffsetObj->getZExtValue();
+          if (otherOffset >= selfCheck.bounds.front()) {
+            if (debugSubsumptionLevel >= 3) {
+              std::string msg;
+              llvm::raw_string_ostream stream(msg);
+              selfBoundsListIt->first->print(stream);
+              stream.flush();
+              klee_message("Offset %lu out of bound %lu for %s", otherOffset,
+                           selfCheck.bounds.front(), msg.c_str());
             }
-            bounds.insert(selfBound);
+            return ConstantExpr::create(0, Expr::Bool);
           }
-          continue;
+          bounds.insert(selfCheck.bounds.begin(), selfCheck.bounds.end());
         }
+      } else {
+        // Symbolic state offset, but concrete tabled bound. Here the bound
+        // is known (non-zero), so we create constraints
+        for (unsigned i = 0; i < selfCheck.boundExprs.size(); ++i) {
+          ref<Expr> conjunct =
+              UltExpr::create(*otherOffsetsIt, selfCheck.boundExprs[i]);
+          res = res.isNull() ? conjunct : AndExpr::create(conjunct, res);
+        }
+        bounds.insert(selfCheck.bounds.begin(), selfCheck.bounds.end());
+      }
 
-        // We return a null expression signaling that we have encountered a
-        // symbolic bound. In this case, the caller should switch to checking
-        // the exact offset.
+      // We return a null expression signaling that we have encountered a
+      // symbolic bound. In this case, the caller should switch to checking
+      // the exact offset.
+      if (selfCheck.symbolicBound) {
         ref<Expr> nullExpression;
         return nullExpression;
       }
@@ -415,11 +594,15 @@ ref<Expr> TxInterpolantValue::getBoundsCheck(
       return ConstantExpr::create(1, Expr::Bool);
     else {
       // Match not found; we force match via address translation
-      for (std::map<ref<TxAllocationInfo>, std::set<uint64_t> >::const_iterator
-               selfBoundsListIt = allocationBounds.begin(),
-               selfBoundsListIe = allocationBounds.end();
+      for (std::map<ref<TxAllocationInfo>, BoundsCheck>::const_iterator
+               selfBoundsListIt = boundsChecks.begin(),
+               selfBoundsListIe = boundsChecks.end();
            selfBoundsListIt != selfBoundsListIe && !matchFound;
            ++selfBoundsListIt) {
+        // A symbolic bound makes the constraints false
+        const BoundsCheck &selfCheck = selfBoundsListIt->second;
+        if (selfCheck.symbolicBound)
+          continue;
         for (std::map<ref<TxAllocationInfo>,
                       std::set<ref<Expr> > >::const_iterator
                  otherOffsetsListIt = other->allocationOffsets.begin(),
@@ -430,26 +613,17 @@ ref<Expr> TxInterpolantValue::getBoundsCheck(
                    otherSize = otherOffsetsListIt->first->getSize();
           if (selfSize == otherSize) {
             // Allocation sizes match
-            const std::set<uint64_t> &selfBounds = selfBoundsListIt->second;
             const std::set<ref<Expr> > &otherOffsets =
                 otherOffsetsListIt->second;
             ref<Expr> expr;
-            for (std::set<uint64_t>::const_iterator
-                     selfBoundsIt = selfBounds.begin(),
-                     selfBoundsIe = selfBounds.end();
-                 selfBoundsIt != selfBoundsIe; ++selfBoundsIt) {
-              uint64_t selfBound = *selfBoundsIt;
+            for (unsigned i = 0; i < selfCheck.boundExprs.size(); ++i) {
               for (std::set<ref<Expr> >::const_iterator
                        otherOffsetsIt = otherOffsets.begin(),
                        otherOffsetsIe = otherOffsets.end();
                    otherOffsetsIt != otherOffsetsIe; ++otherOffsetsIt) {
                 // Create constraints for offset inequalities
-                ref<Expr> conjunct;
-                if (concreteBound(selfBound))
-                  conjunct = UltExpr::create(*otherOffsetsIt,
-                                             Expr::createPointer(selfBound));
-                else
-                  conjunct = ConstantExpr::create(0, Expr::Bool);
+                ref<Expr> conjunct =
+                    UltExpr::create(*otherOffsetsIt, selfCheck.boundExprs[i]);
                 if (expr.isNull()) {
                   expr = conjunct;
                 } else {
@@ -697,12 +871,14 @@ void TxInterpolantValue::print(llvm::raw_ostream &stream,
   if (!coreReasons.empty()) {
     stream << "\n";
     stream << prefix << "reason(s) for storage:\n";
-    for (std::set<std::string>::const_iterator is = coreReasons.begin(),
-                                               ie = coreReasons.end(), it = is;
+    std::vector<unsigned> reasons;
+    coreReasons.getTags(reasons);
+    for (std::vector<unsigned>::iterator is = reasons.begin(),
+                                         ie = reasons.end(), it = is;
          it != ie; ++it) {
       if (it != is)
         stream << "\n";
-      stream << nextTabs << *it;
+      stream << nextTabs << TxCoreReasons::getName(*it);
     }
   }
 }
@@ -822,72 +998,83 @@ void TxStateAddress::print(llvm::raw_ostream &stream,
 
 /**/
 
-void TxStateValue::addLoadAddress(ref<TxStateValue> loadAddress) {
-  disableBoundEntryList.insert(loadAddress->allowBoundEntryList.begin(),
-                               loadAddress->allowBoundEntryList.end());
-  disableBoundEntryList.insert(loadAddress->disableBoundEntryList.begin(),
-                               loadAddress->disableBoundEntryList.end());
-  std::set<ref<TxStoreEntry> > tmpSet;
-  for (std::set<ref<TxStoreEntry> >::iterator it = allowBoundEntryList.begin(),
-                                              ie = allowBoundEntryList.end();
+/// \brief Insert an entry into a sorted list, unless it is already there
+static void insertEntry(TxStoreEntryList &list, ref<TxStoreEntry> entry) {
+  TxStoreEntryList::iterator it =
+      std::lower_bound(list.begin(), list.end(), entry);
+  if (it == list.end() || entry < *it)
+    list.insert(it, entry);
+}
+
+void TxStateValue::disableEntries(ref<TxStateValue> address) {
+  for (TxStoreEntryList::const_iterator
+           it = address->allowBoundEntryList.begin(),
+           ie = address->allowBoundEntryList.end();
        it != ie; ++it) {
-    std::set<ref<TxStoreEntry> >::iterator it1 =
-        disableBoundEntryList.find(*it);
-    if (it1 == disableBoundEntryList.end()) {
-      tmpSet.insert(*it);
-    }
+    insertEntry(disableBoundEntryList, *it);
+  }
+  for (TxStoreEntryList::const_iterator
+           it = address->disableBoundEntryList.begin(),
+           ie = address->disableBoundEntryList.end();
+       it != ie; ++it) {
+    insertEntry(disableBoundEntryList, *it);
   }
-  allowBoundEntryList = tmpSet;
-}
 
-void TxStateValue::addStoreAddress(ref<TxStateValue> storeAddress) {
-  disableBoundEntryList.insert(storeAddress->allowBoundEntryList.begin(),
-                               storeAddress->allowBoundEntryList.end());
-  disableBoundEntryList.insert(storeAddress->disableBoundEntryList.begin(),
-                               storeAddress->disableBoundEntryList.end());
-  std::set<ref<TxStoreEntry> > tmpSet;
-  for (std::set<ref<TxStoreEntry> >::iterator it = allowBoundEntryList.begin(),
-                                              ie = allowBoundEntryList.end();
+  // Keep the entries that remain enabled, in their order
+  TxStoreEntryList::iterator kept = allowBoundEntryList.begin();
+  for (TxStoreEntryList::iterator it = allowBoundEntryList.begin(),
+                                  ie = allowBoundEntryList.end();
        it != ie; ++it) {
-    std::set<ref<TxStoreEntry> >::iterator it1 =
-        disableBoundEntryList.find(*it);
-    if (it1 == disableBoundEntryList.end()) {
-      tmpSet.insert(*it);
-    }
+    if (!std::binary_search(disableBoundEntryList.begin(),
+                            disableBoundEntryList.end(), *it))
+      *kept++ = *it;
   }
-  allowBoundEntryList = tmpSet;
+  allowBoundEntryList.erase(kept, allowBoundEntryList.end());
 }
 
-void TxStateValue::addDependency(ref<TxStateValue> source) {
-  std::set<ref<TxStoreEntry> > tmpSet;
+void TxStateValue::addLoadAddress(ref<TxStateValue> loadAddress) {
+  disableEntries(loadAddress);
+}
+
+void TxStateValue::addStoreAddress(ref<TxStateValue> storeAddress) {
+  disableEntries(storeAddress);
+}
 
-  disableBoundEntryList.insert(source->disableBoundEntryList.begin(),
-                               source->disableBoundEntryList.end());
+void *TxStateValue::operator new(size_t size) {
+  return TxObjectPool<TxStateValue>::allocate(size);
+}
+
+void TxStateValue::operator delete(void *object, size_t size) {
+  TxObjectPool<TxStateValue>::deallocate(object, size);
+}
+
+void TxStateValue::addDependency(ref<TxStateValue> source) {
+  for (TxStoreEntryList::const_iterator
+           it = source->disableBoundEntryList.begin(),
+           ie = source->disableBoundEntryList.end();
+       it != ie; ++it) {
+    insertEntry(disableBoundEntryList, *it);
+  }
 
-  for (std::set<ref<TxStoreEntry> >::iterator
+  for (TxStoreEntryList::const_iterator
            it = source->allowBoundEntryList.begin(),
            ie = source->allowBoundEntryList.end();
        it != ie; ++it) {
-    std::set<ref<TxStoreEntry> >::iterator it1 =
-        disableBoundEntryList.find(*it);
-    if (it1 == disableBoundEntryList.end()) {
-      tmpSet.insert(*it);
-    }
+    if (!std::binary_search(disableBoundEntryList.begin(),
+                            disableBoundEntryList.end(), *it))
+      insertEntry(allowBoundEntryList, *it);
   }
-  allowBoundEntryList.insert(tmpSet.begin(), tmpSet.end());
 }
 
 void TxStateValue::addStoreEntry(ref<TxStoreEntry> entry) {
-  allowBoundEntryList.insert(entry);
+  insertEntry(allowBoundEntryList, entry);
 }
 
-const std::set<ref<TxStoreEntry> > &
-TxStateValue::getAllowBoundEntryList() const {
+const TxStoreEntryList &TxStateValue::getAllowBoundEntryList() const {
   return allowBoundEntryList;
 }
 
-const std::set<ref<TxStoreEntry> > &
-TxStateValue::getDisableBoundEntryList() const {
+const TxStoreEntryList &TxStateValue::getDisableBoundEntryList() const {
   return disableBoundEntryList;
 }
 
@@ -902,15 +1089,13 @@ void TxStateValue::print(llvm::raw_ostream &stream,
     stream << prefix << "not dependent on store\n";
   } else {
     stream << prefix << "loaded from store entries:";
-    for (std::set<ref<TxStoreEntry> >::const_iterator
-             it = allowBoundEntryList.begin(),
+    for (TxStoreEntryList::const_iterator it = allowBoundEntryList.begin(),
              ie = allowBoundEntryList.end();
          it != ie; ++it) {
       stream << "\n";
       (*it)->print(stream, tabsNext);
     }
-    for (std::set<ref<TxStoreEntry> >::const_iterator
-             it = disableBoundEntryList.begin(),
+    for (TxStoreEntryList::const_iterator it = disableBoundEntryList.begin(),
              ie = disableBoundEntryList.end();
          it != ie; ++it) {
       stream << "\n";
@@ -940,6 +1125,14 @@ void TxStateValue::printMinimal(llvm::raw_ostream &stream,
 
 /**/
 
+void *TxStoreEntry::operator new(size_t size) {
+  return TxObjectPool<TxStoreEntry>::allocate(size);
+}
+
+void TxStoreEntry::operator delete(void *object, size_t size) {
+  TxObjectPool<TxStoreEntry>::deallocate(object, size);
+}
+
 TxStoreEntry::TxStoreEntry(ref<TxStateAddress> _address,
                            ref<TxStateValue> _addressValue,
                            ref<TxStateValue> _content, const TxStore *store,
@@ -947,25 +1140,24 @@ TxStoreEntry::TxStoreEntry(ref<TxStateAddress> _address,
     : refCount(0), address(_address), addressValue(_addressValue),
       content(_content), depth(_depth), value(content->getValue()),
       valueExpr(content->getExpression()), leftDoNotInterpolateBound(false),
-      rightDoNotInterpolateBound(false), leftCore(false), rightCore(false) {
+      rightDoNotInterpolateBound(false), leftCore(false), rightCore(false),
+      leftMarkingEpoch(0), rightMarkingEpoch(0) {
   if (!content->getPointerInfo().isNull()) {
     leftPointerInfo = content->getPointerInfo();
     rightPointerInfo = content->getPointerInfo()->copy();
   }
 
-  const std::set<ref<TxStoreEntry> > &entryList1(
-      content->getAllowBoundEntryList());
-  const std::set<ref<TxStoreEntry> > &entryList2(
-      content->getDisableBoundEntryList());
+  const TxStoreEntryList &entryList1(content->getAllowBoundEntryList());
+  const TxStoreEntryList &entryList2(content->getDisableBoundEntryList());
 
-  for (std::set<ref<TxStoreEntry> >::const_iterator it = entryList1.begin(),
-                                                    ie = entryList1.end();
+  for (TxStoreEntryList::const_iterator it = entryList1.begin(),
+                                        ie = entryList1.end();
        it != ie; ++it) {
     allowBoundEntryList[*it] = store->isInLeftSubtree((*it)->depth);
   }
 
-  for (std::set<ref<TxStoreEntry> >::const_iterator it = entryList2.begin(),
-                                                    ie = entryList2.end();
+  for (TxStoreEntryList::const_iterator it = entryList2.begin(),
+                                        ie = entryList2.end();
        it != ie; ++it) {
     disableBoundEntryList[*it] = store->isInLeftSubtree((*it)->depth);
   }
@@ -32,6 +32,8 @@
 #include <klee/util/TxPrintUtil.h>
 #include <vector>
 
+#include "llvm/ADT/DenseMap.h"
+
 using namespace klee;
 
 typedef std::map<ref<TxVariable>, ref<TxInterpolantValue> >
@@ -61,49 +63,50 @@ ref<Expr> TxWeakestPreCondition::intersectWPExpr(ref<Expr> branchCondition,
                                                  ref<Expr> expr1,
                                                  ref<Expr> expr2) {
   // v
-  std::set<std::string> bvars = TxPartitionHelper::getExprVars(branchCondition);
+  TxPartitionHelper::VarSet bvars =
+      TxPartitionHelper::getExprVars(branchCondition);
 
   // Closure(W1,v)
-  std::set<std::string> closure1 = bvars;
+  TxPartitionHelper::VarSet closure1 = bvars;
   std::vector<ref<Expr> > expr1Comps =
       TxPartitionHelper::getExprsFromAndExpr(expr1);
   for (std::vector<ref<Expr> >::iterator it = expr1Comps.begin(),
                                          ie = expr1Comps.end();
        it != ie; ++it) {
-    std::set<std::string> tmpVars = TxPartitionHelper::getExprVars(*it);
+    TxPartitionHelper::VarSet tmpVars = TxPartitionHelper::getExprVars(*it);
     if (TxPartitionHelper::isShared(closure1, tmpVars)) {
       closure1.insert(tmpVars.begin(), tmpVars.end());
     }
   }
 
   // Closure(W2,v)
-  std::set<std::string> closure2 = bvars;
+  TxPartitionHelper::VarSet closure2 = bvars;
   std::vector<ref<Expr> > expr2Comps =
       TxPartitionHelper::getExprsFromAndExpr(expr2);
   for (std::vector<ref<Expr> >::iterator it = expr2Comps.begin(),
                                          ie = expr2Comps.end();
        it != ie; ++it) {
-    std::set<std::string> tmpVars = TxPartitionHelper::getExprVars(*it);
+    TxPartitionHelper::VarSet tmpVars = TxPartitionHelper::getExprVars(*it);
     if (TxPartitionHelper::isShared(closure2, tmpVars)) {
       closure2.insert(tmpVars.begin(), tmpVars.end());
     }
   }
 
-  std::set<std::string> closure = closure1;
+  TxPartitionHelper::VarSet closure = closure1;
   closure.insert(closure2.begin(), closure2.end());
 
   // v1, v2
-  std::set<std::string> wp1vars = TxPartitionHelper::getExprVars(expr1);
-  std::set<std::string> v1 = TxPartitionHelper::diff(wp1vars, closure);
-  std::set<std::string> wp2vars = TxPartitionHelper::getExprVars(expr2);
-  std::set<std::string> v2 = TxPartitionHelper::diff(wp2vars, closure);
+  TxPartitionHelper::VarSet wp1vars = TxPartitionHelper::getExprVars(expr1);
+  TxPartitionHelper::VarSet v1 = TxPartitionHelper::diff(wp1vars, closure);
+  TxPartitionHelper::VarSet wp2vars = TxPartitionHelper::getExprVars(expr2);
+  TxPartitionHelper::VarSet v2 = TxPartitionHelper::diff(wp2vars, closure);
 
   std::vector<ref<Expr> > expr0Comps;
   // proj(W1, v1)
   for (std::vector<ref<Expr> >::iterator it = expr1Comps.begin(),
                                          ie = expr1Comps.end();
        it != ie; ++it) {
-    std::set<std::string> tmpVars = TxPartitionHelper::getExprVars(*it);
+    TxPartitionHelper::VarSet tmpVars = TxPartitionHelper::getExprVars(*it);
     if (TxPartitionHelper::isShared(v1, tmpVars)) {
       expr0Comps.push_back(*it);
     }
@@ -113,7 +116,7 @@ ref<Expr> TxWeakestPreCondition::intersectWPExpr(ref<Expr> branchCondition,
   for (std::vector<ref<Expr> >::iterator it = expr2Comps.begin(),
                                          ie = expr2Comps.end();
        it != ie; ++it) {
-    std::set<std::string> tmpVars = TxPartitionHelper::getExprVars(*it);
+    TxPartitionHelper::VarSet tmpVars = TxPartitionHelper::getExprVars(*it);
     if (TxPartitionHelper::isShared(v2, tmpVars)) {
       expr0Comps.push_back(*it);
     }
@@ -137,13 +140,13 @@ TxSubsumptionTableEntry *TxWeakestPreCondition::updateSubsumptionTableEntry(
     entry->setWPInterpolant(ConstantExpr::alloc(1, Expr::Bool));
 
   // vars(w)
-  std::set<std::string> wpVars;
+  TxPartitionHelper::VarSet wpVars;
   if (!entry->getWPInterpolant().isNull())
     wpVars = TxPartitionHelper::getExprVars(entry->getWPInterpolant());
 
   // get vars(pi, miu)
   // vars(pi)
-  std::set<std::string> pimiuVars;
+  TxPartitionHelper::VarSet pimiuVars;
   if (!entry->getInterpolant().isNull())
     pimiuVars = TxPartitionHelper::getExprVars(entry->getInterpolant());
 
@@ -155,39 +158,26 @@ TxSubsumptionTableEntry *TxWeakestPreCondition::updateSubsumptionTableEntry(
            ie1 = concretelyAddressedStore.end();
        it1 != ie1; ++it1) {
     if (strcmp(it1->first->getValue()->getName().data(), "") != 0) {
-      pimiuVars.insert(it1->first->getValue()->getName().data());
-      std::set<std::string> right = TxPartitionHelper::getExprVars(
+      pimiuVars.insert(
+          TxPartitionHelper::getAddressVar(it1->first->getValue()));
+      TxPartitionHelper::VarSet right = TxPartitionHelper::getExprVars(
           it1->second.begin()->second->getExpression());
       pimiuVars.insert(right.begin(), right.end());
     }
   }
 
-  // add normal names of __shadow__ variables
-  std::set<std::string> pimiuVars2;
-  for (std::set<std::string>::iterator it1 = pimiuVars.begin(),
-                                       ie1 = pimiuVars.end();
-       it1 != ie1; ++it1) {
-    // keep both normal & __shadow__
-    pimiuVars2.insert((*it1));
-    std::string toErase = "__shadow__";
-    size_t pos = (*it1).find(toErase);
-    if (pos == std::string::npos) {
-      pimiuVars2.insert(*it1);
-    }
-  }
-
   // get v1 = vars(pi,miu) - vars(w)
-  std::set<std::string> v1 = TxPartitionHelper::diff(pimiuVars2, wpVars);
+  TxPartitionHelper::VarSet v1 = TxPartitionHelper::diff(pimiuVars, wpVars);
 
   // closure(pi,miu,v1)
-  std::set<std::string> v1star = v1;
+  TxPartitionHelper::VarSet v1star = v1;
   // closure on pi
   std::vector<ref<Expr> > piComps =
       TxPartitionHelper::getExprsFromAndExpr(entry->getInterpolant());
   for (std::vector<ref<Expr> >::iterator it = piComps.begin(),
                                          ie = piComps.end();
        it != ie; ++it) {
-    std::set<std::string> tmp = TxPartitionHelper::getExprVars(*it);
+    TxPartitionHelper::VarSet tmp = TxPartitionHelper::getExprVars(*it);
     if (TxPartitionHelper::isShared(tmp, v1star)) {
       v1star.insert(tmp.begin(), tmp.end());
     }
@@ -198,10 +188,10 @@ TxSubsumptionTableEntry *TxWeakestPreCondition::updateSubsumptionTableEntry(
            it1 = concretelyAddressedStore.begin(),
            ie1 = concretelyAddressedStore.end();
        it1 != ie1; ++it1) {
-    std::set<std::string> tmp;
+    TxPartitionHelper::VarSet tmp;
     if (strcmp(it1->first->getValue()->getName().data(), "") == 0) {
-      tmp.insert(it1->first->getValue()->getName().data());
-      std::set<std::string> right = TxPartitionHelper::getExprVars(
+      tmp.insert(TxPartitionHelper::getAddressVar(it1->first->getValue()));
+      TxPartitionHelper::VarSet right = TxPartitionHelper::getExprVars(
           it1->second.begin()->second->getExpression());
       tmp.insert(right.begin(), right.end());
       if (TxPartitionHelper::isShared(tmp, v1star)) {
@@ -211,7 +201,7 @@ TxSubsumptionTableEntry *TxWeakestPreCondition::updateSubsumptionTableEntry(
   }
 
   // v2
-  std::set<std::string> v2 = TxPartitionHelper::diff(wpVars, v1star);
+  TxPartitionHelper::VarSet v2 = TxPartitionHelper::diff(wpVars, v1star);
 
   // update pi by (wp,v2) and (pi,v1star)
   std::vector<ref<Expr> > wpComps =
@@ -221,7 +211,7 @@ TxSubsumptionTableEntry *TxWeakestPreCondition::updateSubsumptionTableEntry(
   for (std::vector<ref<Expr> >::iterator it = wpComps.begin(),
                                          ie = wpComps.end();
        it != ie; ++it) {
-    std::set<std::string> tmp = TxPartitionHelper::getExprVars(*it);
+    TxPartitionHelper::VarSet tmp = TxPartitionHelper::getExprVars(*it);
     if (TxPartitionHelper::isSubset(tmp, v2)) {
       newWPComps.push_back(*it);
     }
@@ -231,7 +221,7 @@ TxSubsumptionTableEntry *TxWeakestPreCondition::updateSubsumptionTableEntry(
   for (std::vector<ref<Expr> >::iterator it = piComps.begin(),
                                          ie = piComps.end();
        it != ie; ++it) {
-    std::set<std::string> tmp = TxPartitionHelper::getExprVars(*it);
+    TxPartitionHelper::VarSet tmp = TxPartitionHelper::getExprVars(*it);
     if (TxPartitionHelper::isShared(tmp, v1star)) {
       newpiComps.push_back(*it);
     }
@@ -249,10 +239,10 @@ TxSubsumptionTableEntry *TxWeakestPreCondition::updateSubsumptionTableEntry(
            it1 = concretelyAddressedStore.begin(),
            ie1 = concretelyAddressedStore.end();
        it1 != ie1; ++it1) {
-    std::set<std::string> tmp;
+    TxPartitionHelper::VarSet tmp;
     if (strcmp(it1->first->getValue()->getName().data(), "") != 0) {
-      tmp.insert(it1->first->getValue()->getName().data());
-      std::set<std::string> right = TxPartitionHelper::getExprVars(
+      tmp.insert(TxPartitionHelper::getAddressVar(it1->first->getValue()));
+      TxPartitionHelper::VarSet right = TxPartitionHelper::getExprVars(
           it1->second.begin()->second->getExpression());
       tmp.insert(right.begin(), right.end());
       if (!TxPartitionHelper::isShared(tmp, v1star)) {
@@ -278,14 +268,14 @@ TxSubsumptionTableEntry *TxWeakestPreCondition::updateSubsumptionTableEntry(
  * Push up expression to top of the  basic block
  */
 ref<Expr> TxWeakestPreCondition::PushUp(
-    std::vector<std::pair<KInstruction *, int> > reverseInstructionList) {
+    const std::vector<TxWPTraceEntry> &reverseInstructionList) {
 
-  for (std::vector<std::pair<KInstruction *, int> >::const_reverse_iterator
+  for (std::vector<TxWPTraceEntry>::const_reverse_iterator
            it = reverseInstructionList.rbegin(),
            ie = reverseInstructionList.rend();
        it != ie; ++it) {
-    llvm::Instruction *i = (*it).first->inst;
-    int flag = (*it).second;
+    llvm::Instruction *i = it->instr->inst;
+    int flag = it->flag;
     if (flag == 1) {
       // 1- call getCondition on the cond argument of the branch instruction
       // 2- create and expression from the condition and this->WPExpr
@@ -970,9 +960,9 @@ ref<Expr> TxWeakestPreCondition::getSwitchInst(llvm::SwitchInst *si) {
 
 ref<Expr> TxWeakestPreCondition::getPhiInst(llvm::PHINode *phi) {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 0)
-  llvm::Value *inputArg = phi->getOperand(node->phiNodeArg[phi]);
+  llvm::Value *inputArg = phi->getOperand(node->getIncomingBB(phi));
 #else
-  llvm::Value *inputArg = phi->getOperand(node->phiNodeArg[phi] * 2);
+  llvm::Value *inputArg = phi->getOperand(node->getIncomingBB(phi) * 2);
 #endif
   ref<Expr> result = this->generateExprFromOperand(inputArg);
   return result;
@@ -987,13 +977,13 @@ ref<Expr> TxWeakestPreCondition::getCallInst(llvm::CallInst *ci) {
   // can be accessed from the pushup function. We leave this optimization
   // as future work.
   llvm::Instruction *ret = 0;
-  for (std::vector<std::pair<KInstruction *, int> >::reverse_iterator
+  for (std::vector<TxWPTraceEntry>::reverse_iterator
            it = this->node->reverseInstructionList.rbegin(),
            ie = this->node->reverseInstructionList.rend();
        it != ie; ++it) {
-    if (isa<llvm::ReturnInst>(it->first->inst) &&
-        inFunction(it->first->inst, function)) {
-      ret = it->first->inst;
+    if (isa<llvm::ReturnInst>(it->instr->inst) &&
+        inFunction(it->instr->inst, function)) {
+      ret = it->instr->inst;
     }
   }
   assert(ret && "Return instruction is null!");
@@ -1022,7 +1012,16 @@ ref<Expr> TxWeakestPreCondition::getCallAssume(llvm::CallInst *ci) {
   return result;
 }
 
+/// The widths of the values of the types, by the kind of the value. The
+/// types are uniqued by their context, which outlives the analysis.
+typedef llvm::DenseMap<llvm::Type *, unsigned int> TypeSizeMap;
+static TypeSizeMap allocaSizes, globalSizes, argumentSizes, gepSizes;
+
 unsigned int TxWeakestPreCondition::getAllocaInstSize(llvm::AllocaInst *alc) {
+  TypeSizeMap::iterator it = allocaSizes.find(alc->getAllocatedType());
+  if (it != allocaSizes.end())
+    return it->second;
+
   unsigned int size;
 
   if (alc->getAllocatedType()->isIntegerTy(1)) {
@@ -1045,11 +1044,16 @@ unsigned int TxWeakestPreCondition::getAllocaInstSize(llvm::AllocaInst *alc) {
     // not "
     //               "defined for this type yet");
   }
+  allocaSizes[alc->getAllocatedType()] = size;
   return size;
 }
 
 unsigned int
 TxWeakestPreCondition::getGlobalVariabletSize(llvm::GlobalValue *gv) {
+  TypeSizeMap::iterator it = globalSizes.find(gv->getType());
+  if (it != globalSizes.end())
+    return it->second;
+
   unsigned int size;
 
   if (gv->getType()->getElementType()->isIntegerTy(1)) {
@@ -1084,11 +1088,16 @@ TxWeakestPreCondition::getGlobalVariabletSize(llvm::GlobalValue *gv) {
         "TxWeakestPreCondition::getGlobalVariabletSize getting size is not "
         "defined for this type yet");
   }
+  globalSizes[gv->getType()] = size;
   return size;
 }
 
 unsigned int
 TxWeakestPreCondition::getFunctionArgumentSize(llvm::Argument *arg) {
+  TypeSizeMap::iterator it = argumentSizes.find(arg->getType());
+  if (it != argumentSizes.end())
+    return it->second;
+
   unsigned int size;
 
   if (arg->getType()->isIntegerTy(1)) {
@@ -1108,10 +1117,15 @@ TxWeakestPreCondition::getFunctionArgumentSize(llvm::Argument *arg) {
         "TxWeakestPreCondition::getGlobalVariabletSize getting size is not "
         "defined for this type yet");
   }
+  argumentSizes[arg->getType()] = size;
   return size;
 }
 
 unsigned int TxWeakestPreCondition::getGepSize(llvm::Type *ty) {
+  TypeSizeMap::iterator it = gepSizes.find(ty);
+  if (it != gepSizes.end())
+    return it->second;
+
   unsigned int size;
 
   if (ty->isIntegerTy(1)) {
@@ -1130,5 +1144,6 @@ unsigned int TxWeakestPreCondition::getGepSize(llvm::Type *ty) {
         "TxWeakestPreCondition::getGlobalVariabletSize getting size is not "
         "defined for this type yet");
   }
+  gepSizes[ty] = size;
   return size;
 }
@@ -18,9 +18,11 @@
 
 #include "TxDependency.h"
 #include "TxExprHelper.h"
+#include "TxObjectPool.h"
 #include "TxPartitionHelper.h"
 #include "TxTree.h"
 #include "TxWPHelper.h"
+#include "TxWPTrace.h"
 #include "Z3Simplification.h"
 #include "klee/ExecutionState.h"
 #include "llvm/IR/DataLayout.h"
@@ -37,6 +39,7 @@ class TxWeakestPreCondition {
 
   friend class TxTree;
   friend class ExecutionState;
+  friend class TxMemoryCensus;
 
   std::set<llvm::Value *> markedVariables;
 
@@ -59,6 +62,15 @@ public:
 
   ~TxWeakestPreCondition();
 
+  /// \brief Allocation from the free-list pool of TxWeakestPreCondition objects
+  static void *operator new(size_t size) {
+    return TxObjectPool<TxWeakestPreCondition>::allocate(size);
+  }
+
+  static void operator delete(void *object, size_t size) {
+    TxObjectPool<TxWeakestPreCondition>::deallocate(object, size);
+  }
+
   ref<Expr> True() { return ConstantExpr::alloc(1, Expr::Bool); };
   ref<Expr> False() { return ConstantExpr::alloc(0, Expr::Bool); };
 
@@ -89,8 +101,7 @@ public:
   // =========================================================================
 
   // \brief Generate and return the weakest precondition expression.
-  ref<Expr>
-  PushUp(std::vector<std::pair<KInstruction *, int> > reverseInstructionList);
+  ref<Expr> PushUp(const std::vector<TxWPTraceEntry> &reverseInstructionList);
 
   ref<Expr> getBrCondition(llvm::Instruction *ins);
 
@@ -17,33 +17,40 @@
 
 #include "TxWPHelper.h"
 
+#include <algorithm>
+#include <iterator>
+
 namespace klee {
 
-bool TxWPHelper::isTargetDependent(llvm::Value *inst, ref<Expr> expr) {
+/// The bound of the address sets of TxWPHelper
+static const unsigned MaxAddressSets = 1 << 16;
+
+ExprHashMap<TxWPHelper::AddressSet> TxWPHelper::addressSets;
+
+const TxWPHelper::AddressSet &TxWPHelper::getAddresses(ref<Expr> expr) {
+  ExprHashMap<AddressSet>::iterator it = addressSets.find(expr);
+  if (it != addressSets.end())
+    return it->second;
+
+  AddressSet addresses;
   switch (expr->getKind()) {
   case Expr::InvalidKind:
   case Expr::Constant: {
-    return false;
+    break;
   }
 
   case Expr::WPVar: {
-    ref<WPVarExpr> wp1 = dyn_cast<WPVarExpr>(expr);
-    if (wp1->address == inst) {
-      return true;
-    } else
-      return false;
+    // The variables of the index are not those of the expression
+    addresses.push_back(cast<WPVarExpr>(expr)->address);
+    break;
   }
 
   case Expr::NotOptimized:
   case Expr::Not:
   case Expr::Extract:
   case Expr::ZExt:
-  case Expr::SExt: {
-    ref<Expr> kids[1];
-    kids[0] = expr->getKid(0);
-    return isTargetDependent(inst, kids[0]);
-  }
-
+  case Expr::SExt:
+  case Expr::Concat:
   case Expr::Eq:
   case Expr::Ne:
   case Expr::Ult:
@@ -67,38 +74,18 @@ bool TxWPHelper::isTargetDependent(llvm::Value *inst, ref<Expr> expr) {
   case Expr::Xor:
   case Expr::Shl:
   case Expr::LShr:
-  case Expr::AShr: {
-    ref<Expr> kids[2];
-    kids[0] = expr->getKid(0);
-    kids[1] = expr->getKid(1);
-    return (isTargetDependent(inst, kids[0]) ||
-            isTargetDependent(inst, kids[1]));
-  }
-
-  case Expr::Select: {
-    ref<Expr> kids[3];
-    kids[0] = expr->getKid(0);
-    kids[1] = expr->getKid(1);
-    kids[2] = expr->getKid(2);
-    return (isTargetDependent(inst, kids[0]) ||
-            isTargetDependent(inst, kids[1]) ||
-            isTargetDependent(inst, kids[2]));
-  }
-  case Expr::Upd: {
-    ref<Expr> kids[3];
-    kids[0] = expr->getKid(0);
-    kids[1] = expr->getKid(1);
-    kids[2] = expr->getKid(2);
-    return (isTargetDependent(inst, kids[0]) ||
-            isTargetDependent(inst, kids[1]) ||
-            isTargetDependent(inst, kids[2]));
-  }
+  case Expr::AShr:
+  case Expr::Select:
+  case Expr::Upd:
   case Expr::Sel: {
-    ref<Expr> kids[2];
-    kids[0] = expr->getKid(0);
-    kids[1] = expr->getKid(1);
-    return (isTargetDependent(inst, kids[0]) ||
-            isTargetDependent(inst, kids[1]));
+    for (unsigned i = 0, e = expr->getNumKids(); i != e; ++i) {
+      const AddressSet &kid = getAddresses(expr->getKid(i));
+      AddressSet merged;
+      std::set_union(addresses.begin(), addresses.end(), kid.begin(),
+                     kid.end(), std::back_inserter(merged));
+      addresses.swap(merged);
+    }
+    break;
   }
   default: {
     // Sanity check
@@ -107,7 +94,17 @@ bool TxWPHelper::isTargetDependent(llvm::Value *inst, ref<Expr> expr) {
                "TxWPHelper::isTargetDependent!");
   }
   }
-  return false;
+
+  // The sets of the kids are looked up before the insertion, which may clear
+  // the cache
+  if (addressSets.size() >= MaxAddressSets)
+    addressSets.clear();
+  return addressSets.insert(std::make_pair(expr, addresses)).first->second;
+}
+
+bool TxWPHelper::isTargetDependent(llvm::Value *inst, ref<Expr> expr) {
+  const AddressSet &addresses = getAddresses(expr);
+  return std::binary_search(addresses.begin(), addresses.end(), inst);
 }
 
 ref<Expr> TxWPHelper::substituteExpr(ref<Expr> base, const ref<Expr> lhs,
@@ -117,6 +114,10 @@ ref<Expr> TxWPHelper::substituteExpr(ref<Expr> base, const ref<Expr> lhs,
     return rhs;
   } else if (base.compare(lhs) == 0) { // base case
     return rhs;
+  } else if (isa<WPVarExpr>(lhs) &&
+             !isTargetDependent(cast<WPVarExpr>(lhs)->address, base)) {
+    // No subexpression is lhs or a variable of its address
+    return base;
   } else {
     switch (base->getKind()) {
     case Expr::InvalidKind:
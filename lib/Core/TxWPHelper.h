@@ -23,6 +23,7 @@
 #include <klee/ExprBuilder.h>
 #include <klee/Internal/Support/ErrorHandling.h>
 #include <klee/util/ArrayCache.h>
+#include <klee/util/ExprHashMap.h>
 #include <vector>
 
 namespace klee {
@@ -30,11 +31,24 @@ namespace klee {
 class TxWPArrayStore;
 
 class TxWPHelper {
+  /// \brief The addresses of the WP variables of an expression, sorted
+  typedef std::vector<llvm::Value *> AddressSet;
+
+  /// \brief The addresses of the WP variables of the expressions, kept as
+  /// the weakest precondition of a long trace is pushed up through its
+  /// stores, and cleared when full
+  static ExprHashMap<AddressSet> addressSets;
+
+  static const AddressSet &getAddresses(ref<Expr> expr);
 
 public:
 
+  /// \brief Whether the expression has a WP variable of the address inst
   static bool isTargetDependent(llvm::Value *inst, ref<Expr> expr);
 
+  /// \brief Replace the subexpressions of base equal to lhs, or that are WP
+  /// variables of its address, by rhs. The subexpressions without a WP
+  /// variable of the address of a WP variable lhs are left as they are.
   static ref<Expr> substituteExpr(ref<Expr> base, const ref<Expr> lhs,
                                   const ref<Expr> rhs);
 
@@ -0,0 +1,112 @@
+//===-- TxWPTrace.cpp - Tracer-X symbolic execution tree --------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementations of the classes that record the
+/// instructions executed in a node for the weakest precondition
+/// interpolation.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TxWPTrace.h"
+
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Module/KModule.h"
+
+#include "llvm/IR/Instructions.h"
+
+#include <cassert>
+
+using namespace klee;
+
+std::vector<KInstruction *> TxWPTrace::instructions;
+
+void TxWPTrace::initialize(KModule *kmodule) {
+  instructions.assign(kmodule->infos->getMaxID() + 1, 0);
+  for (std::vector<KFunction *>::iterator it = kmodule->functions.begin(),
+                                          ie = kmodule->functions.end();
+       it != ie; ++it) {
+    KFunction *kf = *it;
+    for (unsigned i = 0; i < kf->numInstructions; ++i)
+      instructions[kf->instructions[i]->info->id] = kf->instructions[i];
+  }
+}
+
+void TxWPTrace::writeNumber(uint32_t value) {
+  while (value >= 0x80) {
+    data.push_back((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  data.push_back(value);
+}
+
+uint32_t TxWPTrace::readNumber(const uint8_t *&pos) {
+  uint32_t value = 0;
+  for (unsigned shift = 0;; shift += 7) {
+    uint8_t byte = *pos++;
+    value |= (uint32_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return value;
+  }
+}
+
+void TxWPTrace::append(KInstruction *instr, unsigned incomingBB) {
+  uint32_t id = instr->info->id;
+  assert(id < instructions.size() && instructions[id] == instr &&
+         "instruction table not initialized");
+
+  // Zigzag encoding of the difference, to keep the backward jumps short
+  uint32_t delta = id - lastId;
+  writeNumber((delta << 1) ^ (0 - (delta >> 31)));
+  if (llvm::isa<llvm::PHINode>(instr->inst))
+    writeNumber(incomingBB);
+
+  if (length % 4 == 0)
+    flags.push_back(0);
+  ++length;
+  lastId = id;
+}
+
+void TxWPTrace::mark(KInstruction *instr, unsigned flag) {
+  if (length == 0)
+    return;
+
+  // The marked instruction is normally the last one executed
+  if (lastId == instr->info->id && getFlag(length - 1) == 0) {
+    setFlag(length - 1, flag);
+    return;
+  }
+
+  std::vector<TxWPTraceEntry> entries;
+  decode(entries);
+  for (unsigned index = length; index > 0; --index) {
+    if (entries[index - 1].instr == instr && entries[index - 1].flag == 0) {
+      setFlag(index - 1, flag);
+      return;
+    }
+  }
+}
+
+void TxWPTrace::decode(std::vector<TxWPTraceEntry> &entries) const {
+  entries.clear();
+  entries.reserve(length);
+
+  const uint8_t *pos = data.empty() ? 0 : &data[0];
+  uint32_t id = 0;
+  for (unsigned index = 0; index < length; ++index) {
+    uint32_t zigzag = readNumber(pos);
+    id += (zigzag >> 1) ^ (0 - (zigzag & 1));
+    KInstruction *instr = instructions[id];
+    unsigned incomingBB =
+        llvm::isa<llvm::PHINode>(instr->inst) ? readNumber(pos) : 0;
+    entries.push_back(TxWPTraceEntry(instr, incomingBB));
+    entries.back().flag = getFlag(index);
+  }
+}
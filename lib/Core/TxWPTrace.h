@@ -0,0 +1,106 @@
+//===-- TxWPTrace.h - Tracer-X symbolic execution tree ----------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains declarations of the classes that record the
+/// instructions executed in a node for the weakest precondition
+/// interpolation.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef TXWPTRACE_H_
+#define TXWPTRACE_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace klee {
+
+class KModule;
+struct KInstruction;
+
+/// \brief An instruction executed in a node, as recorded for weakest
+/// precondition interpolation
+struct TxWPTraceEntry {
+  KInstruction *instr;
+
+  /// \brief The index of the incoming block (only for PHI nodes)
+  unsigned incomingBB : 30;
+
+  /// \brief The marking of the instruction: 0 means the instruction is not
+  /// dependent to any target, 1 means it is dependent to a target, and 2
+  /// means its negation is dependent to a target
+  unsigned flag : 2;
+
+  TxWPTraceEntry(KInstruction *_instr, unsigned _incomingBB)
+      : instr(_instr), incomingBB(_incomingBB), flag(0) {}
+};
+
+/// \brief The encoded list of the instructions executed in a node.
+///
+/// The instructions are stored by the difference between their identifier
+/// in the module and the one of the previous instruction, as variable-length
+/// integers, so that straight-line code takes a byte per instruction. The
+/// PHI nodes are followed by the index of their incoming block, and the
+/// markings take two bits per instruction. The list is decoded into
+/// TxWPTraceEntry objects only when the weakest precondition is computed.
+class TxWPTrace {
+  /// \brief The instructions of the module, indexed by their identifiers
+  static std::vector<KInstruction *> instructions;
+
+  /// \brief The encoded identifiers and incoming blocks
+  std::vector<uint8_t> data;
+
+  /// \brief The markings of the instructions
+  std::vector<uint8_t> flags;
+
+  /// \brief The number of instructions
+  unsigned length;
+
+  /// \brief The identifier of the last instruction
+  uint32_t lastId;
+
+  void writeNumber(uint32_t value);
+
+  static uint32_t readNumber(const uint8_t *&pos);
+
+  unsigned getFlag(unsigned index) const {
+    return (flags[index / 4] >> (2 * (index % 4))) & 3;
+  }
+
+  void setFlag(unsigned index, unsigned flag) {
+    flags[index / 4] = (flags[index / 4] & ~(3 << (2 * (index % 4)))) |
+                       (flag << (2 * (index % 4)));
+  }
+
+public:
+  TxWPTrace() : length(0), lastId(0) {}
+
+  /// \brief Build the table of the instructions of the module, to be called
+  /// before any trace is recorded
+  static void initialize(KModule *kmodule);
+
+  unsigned size() const { return length; }
+
+  bool empty() const { return length == 0; }
+
+  /// \brief Append an executed instruction, with the index of its incoming
+  /// block in case of a PHI node
+  void append(KInstruction *instr, unsigned incomingBB);
+
+  /// \brief Set the marking of the last unmarked execution of the
+  /// instruction
+  void mark(KInstruction *instr, unsigned flag);
+
+  /// \brief Decode the trace into the given list, in the execution order
+  void decode(std::vector<TxWPTraceEntry> &entries) const;
+};
+}
+
+#endif /* TXWPTRACE_H_ */
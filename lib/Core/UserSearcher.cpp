@@ -31,6 +31,7 @@ namespace {
 			clEnumValN(Searcher::NURS_ICnt, "nurs:icnt", "use NURS with Instr-Count"),
 			clEnumValN(Searcher::NURS_CPICnt, "nurs:cpicnt", "use NURS with CallPath-Instr-Count"),
 			clEnumValN(Searcher::NURS_QC, "nurs:qc", "use NURS with Query-Cost"),
+			clEnumValN(Searcher::TxSubsumption, "tx-subsumption", "prefer the states likely to be subsumed soon, and those completing subtrees needed for subsumption (Tracer-X)"),
 			clEnumValEnd));
 
   cl::opt<bool>
@@ -72,6 +73,13 @@ bool klee::userSearcherRequiresMD2U() {
 	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_QC) != CoreSearch.end());
 }
 
+bool klee::userSearcherRequiresPTree() {
+  // The default searchers include the random path searcher
+  return CoreSearch.empty() ||
+         std::find(CoreSearch.begin(), CoreSearch.end(),
+                   Searcher::RandomPath) != CoreSearch.end();
+}
+
 
 Searcher *getNewSearcher(Searcher::CoreSearchType type, Executor &executor) {
   Searcher *searcher = NULL;
@@ -86,6 +94,7 @@ Searcher *getNewSearcher(Searcher::CoreSearchType type, Executor &executor) {
   case Searcher::NURS_ICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::InstCount); break;
   case Searcher::NURS_CPICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CPInstCount); break;
   case Searcher::NURS_QC: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::QueryCost); break;
+  case Searcher::TxSubsumption: searcher = new TxSubsumptionSearcher(); break;
   }
 
   return searcher;
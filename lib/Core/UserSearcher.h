@@ -17,6 +17,10 @@ namespace klee {
   // XXX gross, should be on demand?
   bool userSearcherRequiresMD2U();
 
+  /// Whether the searchers read the process tree of the states, which the
+  /// executor otherwise does not maintain.
+  bool userSearcherRequiresPTree();
+
   Searcher *constructUserSearcher(Executor &executor);
 }
 
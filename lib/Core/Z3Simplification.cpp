@@ -7,8 +7,45 @@
 
 #include "Z3Simplification.h"
 
+#include "llvm/Support/CommandLine.h"
+
+#include <set>
+#include <vector>
+
 using namespace klee;
 
+namespace {
+llvm::cl::opt<unsigned> SimplificationCacheSize(
+    "z3-simplification-cache-size",
+    llvm::cl::desc("The number of results of the simplifications of the "
+                   "interpolants to keep (default=4096)."),
+    llvm::cl::init(4096));
+
+llvm::cl::opt<unsigned> ContextualSimplificationTimeout(
+    "z3-ctx-simplify-timeout",
+    llvm::cl::desc("Timeout in milliseconds of the contextual simplifications "
+                   "of the interpolants, after which the expression is kept "
+                   "as it is (default=1000, 0 means no timeout)."),
+    llvm::cl::init(1000));
+
+/// Contextual simplification is skipped on expressions of sizes where it was
+/// run this many times without ever reducing the expression
+const unsigned ContextualSimplificationTrials = 8;
+}
+
+z3::context *Z3Simplification::context = 0;
+
+std::map<ref<Expr>, ref<Expr> > Z3Simplification::cache;
+
+std::map<unsigned, std::pair<unsigned, unsigned> >
+    Z3Simplification::contextualRuns;
+
+z3::context &Z3Simplification::getContext() {
+  if (!context)
+    context = new z3::context();
+  return *context;
+}
+
 void Z3Simplification::test() {
   std::cout << "Start test!\n";
   z3::context c;
@@ -23,20 +60,81 @@ void Z3Simplification::test() {
 }
 
 ref<Expr> Z3Simplification::simplify(ref<Expr> txe) {
-  if (txe.isNull()) {
+  if (txe.isNull() || isa<ConstantExpr>(txe)) {
     return txe;
   }
-  z3::context c;
+  std::map<ref<Expr>, ref<Expr> >::iterator it = cache.find(txe);
+  if (it != cache.end())
+    return it->second;
+
+  z3::context &c = getContext();
   std::map<std::string, ref<Expr> > emap;
   z3::expr z3e = c.bool_val(false);
+  ref<Expr> ret = txe;
   bool succ = txExpr2z3Expr(z3e, c, txe, emap);
   if (succ) {
     z3e = applyTactic(c, "simplify", z3e);
-    z3e = applyTactic(c, "ctx-solver-simplify", z3e);
-    ref<Expr> ret = z3Expr2TxExpr(z3e, emap);
-    return ret;
+    z3e = applyContextualSimplification(c, z3e);
+    ret = z3Expr2TxExpr(z3e, emap);
+  }
+
+  if (cache.size() >= SimplificationCacheSize)
+    cache.clear();
+  cache.insert(std::make_pair(txe, ret));
+  return ret;
+}
+
+unsigned Z3Simplification::getSize(z3::context &c, const z3::expr &e) {
+  std::set<unsigned> visited;
+  std::vector<z3::expr> worklist(1, e);
+  while (!worklist.empty()) {
+    z3::expr current = worklist.back();
+    worklist.pop_back();
+    if (!visited.insert(Z3_get_ast_id(c, current)).second)
+      continue;
+    if (current.is_app()) {
+      for (unsigned i = 0; i < current.num_args(); ++i)
+        worklist.push_back(current.arg(i));
+    }
   }
-  return txe;
+  return visited.size();
+}
+
+z3::expr Z3Simplification::applyContextualSimplification(z3::context &c,
+                                                         z3::expr e) {
+  unsigned size = getSize(c, e);
+  unsigned sizeClass = 0;
+  while ((2u << sizeClass) <= size)
+    ++sizeClass;
+
+  std::pair<unsigned, unsigned> &runs = contextualRuns[sizeClass];
+  if (runs.first >= ContextualSimplificationTrials && runs.second == 0)
+    return e;
+
+  z3::goal g(c);
+  g.add(e);
+  z3::tactic t(c, "ctx-solver-simplify");
+  if (ContextualSimplificationTimeout)
+    t = z3::try_for(t, ContextualSimplificationTimeout);
+
+  z3::expr ret = e;
+  try {
+    z3::apply_result r = t(g);
+    assert(r.size() > 0 && "apply result is empty!");
+    ret = r[0].as_expr();
+    for (unsigned i = 1; i < r.size(); i++) {
+      ret = ret || r[i].as_expr();
+    }
+  } catch (z3::exception &) {
+    // Out of time: keep the expression as it is
+    ++runs.first;
+    return e;
+  }
+
+  ++runs.first;
+  if (getSize(c, ret) < size)
+    ++runs.second;
+  return ret;
 }
 
 bool Z3Simplification::txExpr2z3Expr(z3::expr &z3e, z3::context &c,
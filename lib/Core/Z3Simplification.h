@@ -12,6 +12,7 @@
 #include <cstdlib>
 #include <iostream>
 #include <klee/Expr.h>
+#include <map>
 #include <string>
 
 #include <z3++.h>
@@ -26,6 +27,25 @@ public:
   static void test();
 
 private:
+  /// \brief The context of all simplifications, created on first use, as
+  /// creating a context is expensive
+  static z3::context *context;
+
+  /// \brief The results of the previous simplifications
+  static std::map<ref<Expr>, ref<Expr> > cache;
+
+  /// \brief The number of ctx-solver-simplify runs, and of those that
+  /// reduced the expression, by the binary logarithm of the expression size
+  static std::map<unsigned, std::pair<unsigned, unsigned> > contextualRuns;
+
+  static z3::context &getContext();
+
+  /// \brief Run ctx-solver-simplify unless it never reduced expressions of
+  /// a similar size, or it is out of time
+  static z3::expr applyContextualSimplification(z3::context &c, z3::expr e);
+
+  static unsigned getSize(z3::context &c, const z3::expr &e);
+
   static bool txExpr2z3Expr(z3::expr &z3e, z3::context &c, ref<Expr> txe,
                             std::map<std::string, ref<Expr> > &emap);
 
@@ -1,7 +1,12 @@
 #include "klee/util/ArrayCache.h"
 
+#include <algorithm>
+
 namespace klee {
 
+/// The id of the next array to be created, see Array#getId
+static unsigned nextArrayId = 0;
+
 ArrayCache::~ArrayCache() {
   // Free Allocated Array objects
   for (ArrayHashMap::iterator ai = cachedSymbolicArrays.begin(),
@@ -22,26 +27,96 @@ ArrayCache::CreateArray(const std::string &_name, uint64_t _size,
                         const ref<ConstantExpr> *constantValuesEnd,
                         Expr::Width _domain, Expr::Width _range) {
 
-  const Array *array = new Array(_name, _size, constantValuesBegin,
-                                 constantValuesEnd, _domain, _range);
+  Array *array = new Array(_name, _size, constantValuesBegin,
+                           constantValuesEnd, _domain, _range);
   if (array->isSymbolicArray()) {
     std::pair<ArrayHashMap::const_iterator, bool> success =
         cachedSymbolicArrays.insert(array);
     if (success.second) {
       // Cache miss
+      array->id = nextArrayId++;
       return array;
     }
     // Cache hit
     delete array;
-    array = *(success.first);
-    assert(array->isSymbolicArray() &&
+    assert((*success.first)->isSymbolicArray() &&
            "Cached symbolic array is no longer symbolic");
-    return array;
+    return *(success.first);
   } else {
     // Treat every constant array as distinct so we never cache them
     assert(array->isConstantArray());
+    array->id = nextArrayId++;
     concreteArrays.push_back(array); // For deletion later
     return array;
   }
 }
+
+const Array *ArrayCache::CreateSharedConstantArray(
+    const std::string &_name, uint64_t _size,
+    const ref<ConstantExpr> *constantValuesBegin,
+    const ref<ConstantExpr> *constantValuesEnd, Expr::Width _domain,
+    Expr::Width _range) {
+  Array *array = new Array(_name, _size, constantValuesBegin,
+                           constantValuesEnd, _domain, _range);
+  assert(array->isConstantArray() && "shared array is not constant");
+  std::pair<ConstantArrayHashMap::const_iterator, bool> success =
+      sharedConstantArrays.insert(array);
+  if (success.second) {
+    // Cache miss
+    array->id = nextArrayId++;
+    concreteArrays.push_back(array); // For deletion later
+    return array;
+  }
+  // Cache hit
+  delete array;
+  return *(success.first);
+}
+
+void ArrayCache::extendUpdates(UpdateList &updates, const ref<Expr> &index,
+                               const ref<Expr> &value) {
+  // The lists of the objects whose array is not yet created are not shared
+  if (!updates.root) {
+    updates.extend(index, value);
+    return;
+  }
+
+  UpdateList extended(updates);
+  extended.extend(index, value);
+
+  std::pair<UpdateListHashMap::const_iterator, bool> success =
+      sharedUpdates.insert(extended);
+  if (success.second) {
+    // Cache miss
+    updates = extended;
+    if (sharedUpdates.size() >= sharedUpdatesToRelease)
+      releaseSharedUpdates();
+    return;
+  }
+  // Cache hit, the new node is freed with the extended list
+  updates = UpdateList(updates.root, success.first->head);
+}
+
+void ArrayCache::releaseSharedUpdates() {
+  // Releasing a node may leave its successor only referenced by the cache,
+  // hence the repeated passes.
+  for (bool released = true; released;) {
+    released = false;
+    std::vector<UpdateList> kept;
+    kept.reserve(sharedUpdates.size());
+    for (UpdateListHashMap::const_iterator it = sharedUpdates.begin(),
+                                           ie = sharedUpdates.end();
+         it != ie; ++it) {
+      if (it->head->refCount > 1)
+        kept.push_back(*it);
+      else
+        released = true;
+    }
+    if (!released)
+      break;
+    sharedUpdates.clear();
+    sharedUpdates.insert(kept.begin(), kept.end());
+  }
+  sharedUpdatesToRelease =
+      std::max<size_t>(MinSharedUpdatesToRelease, 2 * sharedUpdates.size());
+}
 }
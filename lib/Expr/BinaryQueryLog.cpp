@@ -0,0 +1,757 @@
+//===-- BinaryQueryLog.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/BinaryQueryLog.h"
+
+#include "expr/Parser.h"
+
+#include "klee/Constraints.h"
+#include "klee/ExprBuilder.h"
+#include "klee/util/ArrayCache.h"
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstring>
+
+using namespace llvm;
+using namespace klee;
+using namespace klee::expr;
+
+const char BinaryQueryWriter::Magic[4] = { '\x7f', 'K', 'Q', 'B' };
+
+static void appendUnsigned(std::string &buffer, uint64_t value) {
+  do {
+    unsigned char byte = value & 0x7f;
+    value >>= 7;
+    if (value)
+      byte |= 0x80;
+    buffer += (char)byte;
+  } while (value);
+}
+
+BinaryQueryWriter::BinaryQueryWriter() : headerWritten(false) {
+  committed = getMarks();
+}
+
+BinaryQueryWriter::Marks BinaryQueryWriter::getMarks() const {
+  Marks marks;
+  marks.exprs = exprs.size();
+  marks.arrays = arrays.size();
+  marks.updates = updates.size();
+  return marks;
+}
+
+void BinaryQueryWriter::rollback(const Marks &marks) {
+  for (unsigned i = marks.exprs; i < exprs.size(); ++i)
+    exprIds.erase(exprs[i]);
+  exprs.erase(exprs.begin() + marks.exprs, exprs.end());
+
+  for (unsigned i = marks.arrays; i < arrays.size(); ++i)
+    arrayIds.erase(arrays[i]);
+  arrays.erase(arrays.begin() + marks.arrays, arrays.end());
+
+  for (unsigned i = marks.updates; i < updates.size(); ++i)
+    updateIds.erase(updates[i].head);
+  updates.erase(updates.begin() + marks.updates, updates.end());
+}
+
+void BinaryQueryWriter::writeUnsigned(uint64_t value) {
+  appendUnsigned(pending, value);
+}
+
+void BinaryQueryWriter::writeString(const std::string &s) {
+  writeUnsigned(s.size());
+  pending += s;
+}
+
+unsigned BinaryQueryWriter::writeArray(const Array *array) {
+  std::map<const Array *, unsigned>::iterator it = arrayIds.find(array);
+  if (it != arrayIds.end())
+    return it->second;
+
+  pending += (char)ArrayRecord;
+  writeString(array->name);
+  writeUnsigned(array->size);
+  writeUnsigned(array->domain);
+  writeUnsigned(array->range);
+  writeUnsigned(array->isSymbolicArray());
+  if (!array->isSymbolicArray()) {
+    for (unsigned i = 0; i < array->size; ++i)
+      writeUnsigned(array->constantValues[i]->getZExtValue());
+  }
+
+  unsigned id = arrays.size();
+  arrays.push_back(array);
+  arrayIds[array] = id;
+  return id;
+}
+
+bool BinaryQueryWriter::writeUpdates(const UpdateList &ul, unsigned &id) {
+  // The nodes are written from the oldest, after the last written one
+  std::vector<const UpdateNode *> unwritten;
+  unsigned next = 0;
+  for (const UpdateNode *un = ul.head; un; un = un->next) {
+    std::map<const UpdateNode *, unsigned>::iterator it = updateIds.find(un);
+    if (it != updateIds.end()) {
+      next = it->second + 1;
+      break;
+    }
+    unwritten.push_back(un);
+  }
+
+  unsigned array = writeArray(ul.root);
+  for (std::vector<const UpdateNode *>::reverse_iterator
+           it = unwritten.rbegin(),
+           ie = unwritten.rend();
+       it != ie; ++it) {
+    const UpdateNode *un = *it;
+    unsigned index, value;
+    if (!writeExpr(un->index, index) || !writeExpr(un->value, value))
+      return false;
+
+    pending += (char)UpdateRecord;
+    writeUnsigned(array);
+    writeUnsigned(next);
+    writeUnsigned(index);
+    writeUnsigned(value);
+
+    unsigned nodeId = updates.size();
+    updates.push_back(UpdateList(ul.root, un));
+    updateIds[un] = nodeId;
+    next = nodeId + 1;
+  }
+
+  id = next;
+  return true;
+}
+
+bool BinaryQueryWriter::writeExpr(const ref<Expr> &e, unsigned &id) {
+  ExprHashMap<unsigned>::iterator it = exprIds.find(e);
+  if (it != exprIds.end()) {
+    id = it->second;
+    return true;
+  }
+
+  // The kids are written before the expression, which refers to their ids
+  switch (e->getKind()) {
+  case Expr::Constant: {
+    const llvm::APInt &value = cast<ConstantExpr>(e)->getAPValue();
+    pending += (char)ExprRecord;
+    writeUnsigned(e->getKind());
+    writeUnsigned(e->getWidth());
+    for (unsigned i = 0; i < value.getNumWords(); ++i)
+      writeUnsigned(value.getRawData()[i]);
+    break;
+  }
+
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    unsigned array = writeArray(re->updates.root);
+    unsigned head, index;
+    if (!writeUpdates(re->updates, head) || !writeExpr(re->index, index))
+      return false;
+    pending += (char)ExprRecord;
+    writeUnsigned(e->getKind());
+    writeUnsigned(array);
+    writeUnsigned(head);
+    writeUnsigned(index);
+    break;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    unsigned kid;
+    if (!writeExpr(ee->expr, kid))
+      return false;
+    pending += (char)ExprRecord;
+    writeUnsigned(e->getKind());
+    writeUnsigned(kid);
+    writeUnsigned(ee->offset);
+    writeUnsigned(ee->width);
+    break;
+  }
+
+  case Expr::ZExt:
+  case Expr::SExt: {
+    unsigned kid;
+    if (!writeExpr(e->getKid(0), kid))
+      return false;
+    pending += (char)ExprRecord;
+    writeUnsigned(e->getKind());
+    writeUnsigned(kid);
+    writeUnsigned(e->getWidth());
+    break;
+  }
+
+  case Expr::Exists: {
+    const ExistsExpr *ee = cast<ExistsExpr>(e);
+    std::vector<unsigned> variables;
+    for (std::set<const Array *>::const_iterator it = ee->variables.begin(),
+                                                 ie = ee->variables.end();
+         it != ie; ++it)
+      variables.push_back(writeArray(*it));
+    unsigned body;
+    if (!writeExpr(ee->body, body))
+      return false;
+    pending += (char)ExprRecord;
+    writeUnsigned(e->getKind());
+    writeUnsigned(variables.size());
+    for (std::vector<unsigned>::iterator it = variables.begin(),
+                                         ie = variables.end();
+         it != ie; ++it)
+      writeUnsigned(*it);
+    writeUnsigned(body);
+    break;
+  }
+
+  case Expr::WPVar:
+  case Expr::Upd:
+  case Expr::Sel:
+    // The expressions of the weakest preconditions refer to the program
+    return false;
+
+  default: {
+    // The number of kids follows from the kind
+    std::vector<unsigned> kids(e->getNumKids());
+    for (unsigned i = 0; i < kids.size(); ++i)
+      if (!writeExpr(e->getKid(i), kids[i]))
+        return false;
+    pending += (char)ExprRecord;
+    writeUnsigned(e->getKind());
+    for (std::vector<unsigned>::iterator it = kids.begin(), ie = kids.end();
+         it != ie; ++it)
+      writeUnsigned(*it);
+    break;
+  }
+  }
+
+  id = exprs.size();
+  exprs.push_back(e);
+  exprIds[e] = id;
+  return true;
+}
+
+bool BinaryQueryWriter::writeQuery(const ConstraintManager &constraints,
+                                   const ref<Expr> &q,
+                                   const ref<Expr> *evalExprsBegin,
+                                   const ref<Expr> *evalExprsEnd,
+                                   const Array *const *evalArraysBegin,
+                                   const Array *const *evalArraysEnd) {
+  Marks start = getMarks();
+  size_t startSize = pending.size();
+
+  std::vector<unsigned> constraintIds, valueIds, objectIds;
+  unsigned queryId;
+  bool success = true;
+  for (ConstraintManager::const_iterator it = constraints.begin(),
+                                         ie = constraints.end();
+       success && it != ie; ++it) {
+    unsigned id;
+    success = writeExpr(*it, id);
+    constraintIds.push_back(id);
+  }
+  success = success && writeExpr(q, queryId);
+  for (const ref<Expr> *it = evalExprsBegin; success && it != evalExprsEnd;
+       ++it) {
+    unsigned id;
+    success = writeExpr(*it, id);
+    valueIds.push_back(id);
+  }
+
+  if (!success) {
+    pending.resize(startSize);
+    rollback(start);
+    return false;
+  }
+
+  for (const Array *const *it = evalArraysBegin; it != evalArraysEnd; ++it)
+    objectIds.push_back(writeArray(*it));
+
+  pending += (char)QueryRecord;
+  writeUnsigned(constraintIds.size());
+  for (std::vector<unsigned>::iterator it = constraintIds.begin(),
+                                       ie = constraintIds.end();
+       it != ie; ++it)
+    writeUnsigned(*it);
+  writeUnsigned(queryId);
+  writeUnsigned(valueIds.size());
+  for (std::vector<unsigned>::iterator it = valueIds.begin(),
+                                       ie = valueIds.end();
+       it != ie; ++it)
+    writeUnsigned(*it);
+  writeUnsigned(objectIds.size());
+  for (std::vector<unsigned>::iterator it = objectIds.begin(),
+                                       ie = objectIds.end();
+       it != ie; ++it)
+    writeUnsigned(*it);
+  return true;
+}
+
+void BinaryQueryWriter::writeComment(const std::string &comment) {
+  pending += (char)CommentRecord;
+  writeString(comment);
+}
+
+void BinaryQueryWriter::commit(llvm::raw_ostream &os) {
+  if (!headerWritten) {
+    std::string header(Magic, sizeof(Magic));
+    appendUnsigned(header, Version);
+    os << header;
+    headerWritten = true;
+  }
+  os << pending;
+  pending.clear();
+  committed = getMarks();
+
+  if (exprs.size() > ResetThreshold) {
+    os << (char)ResetRecord;
+    exprIds.clear();
+    exprs.clear();
+    arrayIds.clear();
+    arrays.clear();
+    updateIds.clear();
+    updates.clear();
+    committed = getMarks();
+  }
+}
+
+void BinaryQueryWriter::discard() {
+  pending.clear();
+  rollback(committed);
+}
+
+///
+
+namespace {
+/// BinaryQueryParser - Returns the queries of a binary query log as query
+/// commands. The arrays are owned by the parser, and outlive the resets of
+/// the tables, such that the returned commands stay valid.
+class BinaryQueryParser : public Parser {
+  const std::string Filename;
+  const char *Begin, *Pos, *End;
+  ExprBuilder *Builder;
+  ArrayCache TheArrayCache;
+  unsigned MaxErrors;
+  unsigned NumErrors;
+
+  std::vector<ref<Expr> > Exprs;
+  std::vector<const Array *> Arrays;
+  std::vector<UpdateList> Updates;
+
+  void Error(const char *Message);
+
+  bool ReadUnsigned(uint64_t &Value);
+  bool ReadString(std::string &S);
+  bool ReadExprId(ref<Expr> &E);
+  bool ReadArrayId(const Array *&A);
+  bool ReadUpdateList(const Array *Root, UpdateList &UL);
+
+  bool ParseExpr();
+  bool ParseKids(unsigned N, ref<Expr> *Kids);
+  bool ParseArray();
+  bool ParseUpdate();
+  QueryCommand *ParseQuery();
+
+public:
+  BinaryQueryParser(const std::string &_Filename, const MemoryBuffer *MB,
+                    ExprBuilder *_Builder)
+      : Filename(_Filename), Begin(MB->getBufferStart()), Pos(Begin),
+        End(MB->getBufferEnd()), Builder(_Builder), MaxErrors(~0u),
+        NumErrors(0) {}
+
+  virtual ~BinaryQueryParser() {}
+
+  void Initialize();
+
+  virtual void SetMaxErrors(unsigned N) { MaxErrors = N; }
+
+  virtual unsigned GetNumErrors() const { return NumErrors; }
+
+  virtual Decl *ParseTopLevelDecl();
+};
+}
+
+void BinaryQueryParser::Error(const char *Message) {
+  if (NumErrors++ < MaxErrors)
+    llvm::errs() << Filename << ": error at offset " << (Pos - Begin) << ": "
+                 << Message << "\n";
+  // The records cannot be resynchronized
+  Pos = End;
+}
+
+bool BinaryQueryParser::ReadUnsigned(uint64_t &Value) {
+  Value = 0;
+  for (unsigned Shift = 0; Pos != End && Shift < 64; Shift += 7) {
+    unsigned char Byte = *Pos++;
+    Value |= (uint64_t)(Byte & 0x7f) << Shift;
+    if (!(Byte & 0x80))
+      return true;
+  }
+  Error("truncated or invalid integer");
+  return false;
+}
+
+bool BinaryQueryParser::ReadString(std::string &S) {
+  uint64_t Size;
+  if (!ReadUnsigned(Size))
+    return false;
+  if (Size > (uint64_t)(End - Pos)) {
+    Error("truncated string");
+    return false;
+  }
+  S.assign(Pos, Size);
+  Pos += Size;
+  return true;
+}
+
+bool BinaryQueryParser::ReadExprId(ref<Expr> &E) {
+  uint64_t Id;
+  if (!ReadUnsigned(Id))
+    return false;
+  if (Id >= Exprs.size()) {
+    Error("undefined expression");
+    return false;
+  }
+  E = Exprs[Id];
+  return true;
+}
+
+bool BinaryQueryParser::ReadArrayId(const Array *&A) {
+  uint64_t Id;
+  if (!ReadUnsigned(Id))
+    return false;
+  if (Id >= Arrays.size()) {
+    Error("undefined array");
+    return false;
+  }
+  A = Arrays[Id];
+  return true;
+}
+
+bool BinaryQueryParser::ReadUpdateList(const Array *Root, UpdateList &UL) {
+  uint64_t Id;
+  if (!ReadUnsigned(Id))
+    return false;
+  if (Id > Updates.size()) {
+    Error("undefined update node");
+    return false;
+  }
+  UL = UpdateList(Root, Id ? Updates[Id - 1].head : 0);
+  return true;
+}
+
+bool BinaryQueryParser::ParseKids(unsigned N, ref<Expr> *Kids) {
+  for (unsigned i = 0; i < N; ++i)
+    if (!ReadExprId(Kids[i]))
+      return false;
+  return true;
+}
+
+bool BinaryQueryParser::ParseExpr() {
+  uint64_t Kind;
+  if (!ReadUnsigned(Kind))
+    return false;
+
+  ref<Expr> Kids[3];
+  ref<Expr> E;
+  switch (Kind) {
+  case Expr::Constant: {
+    uint64_t Width;
+    if (!ReadUnsigned(Width))
+      return false;
+    if (!Width || Width > (1 << 24)) {
+      Error("invalid constant width");
+      return false;
+    }
+    std::vector<uint64_t> Words((Width + 63) / 64);
+    for (unsigned i = 0; i < Words.size(); ++i)
+      if (!ReadUnsigned(Words[i]))
+        return false;
+    E = Builder->Constant(
+        llvm::APInt((unsigned)Width, llvm::ArrayRef<uint64_t>(Words)));
+    break;
+  }
+
+  case Expr::NotOptimized:
+    if (!ParseKids(1, Kids))
+      return false;
+    E = Builder->NotOptimized(Kids[0]);
+    break;
+
+  case Expr::Read: {
+    const Array *Root;
+    UpdateList UL(0, 0);
+    if (!ReadArrayId(Root) || !ReadUpdateList(Root, UL) ||
+        !ParseKids(1, Kids))
+      return false;
+    if (Kids[0]->getWidth() != Root->getDomain()) {
+      Error("invalid read index width");
+      return false;
+    }
+    E = Builder->Read(UL, Kids[0]);
+    break;
+  }
+
+  case Expr::Select:
+    if (!ParseKids(3, Kids))
+      return false;
+    if (Kids[0]->getWidth() != Expr::Bool ||
+        Kids[1]->getWidth() != Kids[2]->getWidth()) {
+      Error("invalid select widths");
+      return false;
+    }
+    E = Builder->Select(Kids[0], Kids[1], Kids[2]);
+    break;
+
+  case Expr::Concat:
+    if (!ParseKids(2, Kids))
+      return false;
+    E = Builder->Concat(Kids[0], Kids[1]);
+    break;
+
+  case Expr::Extract: {
+    uint64_t Offset, Width;
+    if (!ParseKids(1, Kids) || !ReadUnsigned(Offset) || !ReadUnsigned(Width))
+      return false;
+    if (!Width || Offset + Width > Kids[0]->getWidth()) {
+      Error("invalid extract");
+      return false;
+    }
+    E = Builder->Extract(Kids[0], (unsigned)Offset, (Expr::Width)Width);
+    break;
+  }
+
+  case Expr::ZExt:
+  case Expr::SExt: {
+    uint64_t Width;
+    if (!ParseKids(1, Kids) || !ReadUnsigned(Width))
+      return false;
+    if (Width < Kids[0]->getWidth() || Width > (1 << 24)) {
+      Error("invalid cast width");
+      return false;
+    }
+    E = Kind == Expr::ZExt ? Builder->ZExt(Kids[0], (Expr::Width)Width)
+                           : Builder->SExt(Kids[0], (Expr::Width)Width);
+    break;
+  }
+
+  case Expr::Not:
+    if (!ParseKids(1, Kids))
+      return false;
+    E = Builder->Not(Kids[0]);
+    break;
+
+  case Expr::Exists: {
+    uint64_t N;
+    if (!ReadUnsigned(N))
+      return false;
+    std::set<const Array *> Variables;
+    for (uint64_t i = 0; i < N; ++i) {
+      const Array *A;
+      if (!ReadArrayId(A))
+        return false;
+      Variables.insert(A);
+    }
+    if (!ParseKids(1, Kids))
+      return false;
+    E = ExistsExpr::create(Variables, Kids[0]);
+    break;
+  }
+
+  default:
+    if (Kind < Expr::BinaryKindFirst || Kind > Expr::BinaryKindLast) {
+      Error("invalid expression kind");
+      return false;
+    }
+    if (!ParseKids(2, Kids))
+      return false;
+    if (Kids[0]->getWidth() != Kids[1]->getWidth()) {
+      Error("invalid binary expression widths");
+      return false;
+    }
+
+    switch (Kind) {
+    case Expr::Add: E = Builder->Add(Kids[0], Kids[1]); break;
+    case Expr::Sub: E = Builder->Sub(Kids[0], Kids[1]); break;
+    case Expr::Mul: E = Builder->Mul(Kids[0], Kids[1]); break;
+    case Expr::UDiv: E = Builder->UDiv(Kids[0], Kids[1]); break;
+    case Expr::SDiv: E = Builder->SDiv(Kids[0], Kids[1]); break;
+    case Expr::URem: E = Builder->URem(Kids[0], Kids[1]); break;
+    case Expr::SRem: E = Builder->SRem(Kids[0], Kids[1]); break;
+    case Expr::And: E = Builder->And(Kids[0], Kids[1]); break;
+    case Expr::Or: E = Builder->Or(Kids[0], Kids[1]); break;
+    case Expr::Xor: E = Builder->Xor(Kids[0], Kids[1]); break;
+    case Expr::Shl: E = Builder->Shl(Kids[0], Kids[1]); break;
+    case Expr::LShr: E = Builder->LShr(Kids[0], Kids[1]); break;
+    case Expr::AShr: E = Builder->AShr(Kids[0], Kids[1]); break;
+    case Expr::Eq: E = Builder->Eq(Kids[0], Kids[1]); break;
+    case Expr::Ne: E = Builder->Ne(Kids[0], Kids[1]); break;
+    case Expr::Ult: E = Builder->Ult(Kids[0], Kids[1]); break;
+    case Expr::Ule: E = Builder->Ule(Kids[0], Kids[1]); break;
+    case Expr::Ugt: E = Builder->Ugt(Kids[0], Kids[1]); break;
+    case Expr::Uge: E = Builder->Uge(Kids[0], Kids[1]); break;
+    case Expr::Slt: E = Builder->Slt(Kids[0], Kids[1]); break;
+    case Expr::Sle: E = Builder->Sle(Kids[0], Kids[1]); break;
+    case Expr::Sgt: E = Builder->Sgt(Kids[0], Kids[1]); break;
+    case Expr::Sge: E = Builder->Sge(Kids[0], Kids[1]); break;
+    default:
+      Error("invalid expression kind");
+      return false;
+    }
+  }
+
+  Exprs.push_back(E);
+  return true;
+}
+
+bool BinaryQueryParser::ParseArray() {
+  std::string Name;
+  uint64_t Size, Domain, Range, Symbolic;
+  if (!ReadString(Name) || !ReadUnsigned(Size) || !ReadUnsigned(Domain) ||
+      !ReadUnsigned(Range) || !ReadUnsigned(Symbolic))
+    return false;
+  if (!Domain || Domain > 64 || !Range || Range > 64) {
+    Error("invalid array widths");
+    return false;
+  }
+
+  if (Symbolic) {
+    Arrays.push_back(TheArrayCache.CreateArray(Name, Size, 0, 0, Domain, Range));
+    return true;
+  }
+
+  // Each constant value takes at least one byte
+  if (Size > (uint64_t)(End - Pos)) {
+    Error("truncated array");
+    return false;
+  }
+  std::vector<ref<ConstantExpr> > Values;
+  for (uint64_t i = 0; i < Size; ++i) {
+    uint64_t Value;
+    if (!ReadUnsigned(Value))
+      return false;
+    Values.push_back(ConstantExpr::create(Value, (Expr::Width)Range));
+  }
+  Arrays.push_back(TheArrayCache.CreateArray(
+      Name, Size, Values.empty() ? 0 : &Values[0],
+      Values.empty() ? 0 : &Values[0] + Values.size(), Domain, Range));
+  return true;
+}
+
+bool BinaryQueryParser::ParseUpdate() {
+  const Array *Root;
+  UpdateList UL(0, 0);
+  ref<Expr> Index, Value;
+  if (!ReadArrayId(Root) || !ReadUpdateList(Root, UL) ||
+      !ReadExprId(Index) || !ReadExprId(Value))
+    return false;
+  if (Index->getWidth() != Root->getDomain() ||
+      Value->getWidth() != Root->getRange()) {
+    Error("invalid update widths");
+    return false;
+  }
+  UL.extend(Index, Value);
+  Updates.push_back(UL);
+  return true;
+}
+
+QueryCommand *BinaryQueryParser::ParseQuery() {
+  std::vector<ExprHandle> Constraints, Values;
+  std::vector<const Array *> Objects;
+  ExprHandle Query;
+
+  uint64_t N;
+  if (!ReadUnsigned(N))
+    return 0;
+  for (uint64_t i = 0; i < N; ++i) {
+    ref<Expr> E;
+    if (!ReadExprId(E))
+      return 0;
+    Constraints.push_back(E);
+  }
+  if (!ReadExprId(Query) || !ReadUnsigned(N))
+    return 0;
+  for (uint64_t i = 0; i < N; ++i) {
+    ref<Expr> E;
+    if (!ReadExprId(E))
+      return 0;
+    Values.push_back(E);
+  }
+  if (!ReadUnsigned(N))
+    return 0;
+  for (uint64_t i = 0; i < N; ++i) {
+    const Array *A;
+    if (!ReadArrayId(A))
+      return 0;
+    Objects.push_back(A);
+  }
+
+  return new QueryCommand(Constraints, Query, Values, Objects);
+}
+
+void BinaryQueryParser::Initialize() {
+  Pos += sizeof(BinaryQueryWriter::Magic);
+  uint64_t Version;
+  if (ReadUnsigned(Version) && Version != BinaryQueryWriter::Version)
+    Error("unsupported binary query log version");
+}
+
+Decl *BinaryQueryParser::ParseTopLevelDecl() {
+  while (Pos != End) {
+    char Tag = *Pos++;
+    switch (Tag) {
+    case BinaryQueryWriter::ExprRecord:
+      if (!ParseExpr())
+        return 0;
+      break;
+    case BinaryQueryWriter::ArrayRecord:
+      if (!ParseArray())
+        return 0;
+      break;
+    case BinaryQueryWriter::UpdateRecord:
+      if (!ParseUpdate())
+        return 0;
+      break;
+    case BinaryQueryWriter::QueryRecord:
+      return ParseQuery();
+    case BinaryQueryWriter::CommentRecord: {
+      std::string Comment;
+      if (!ReadString(Comment))
+        return 0;
+      break;
+    }
+    case BinaryQueryWriter::ResetRecord:
+      Exprs.clear();
+      Arrays.clear();
+      Updates.clear();
+      break;
+    default:
+      Error("invalid record");
+      return 0;
+    }
+  }
+  return 0;
+}
+
+bool klee::expr::isBinaryQueryLog(const MemoryBuffer *MB) {
+  return MB->getBufferSize() >= sizeof(BinaryQueryWriter::Magic) &&
+         !memcmp(MB->getBufferStart(), BinaryQueryWriter::Magic,
+                 sizeof(BinaryQueryWriter::Magic));
+}
+
+Parser *klee::expr::createBinaryQueryParser(const std::string &Filename,
+                                            const MemoryBuffer *MB,
+                                            ExprBuilder *Builder) {
+  BinaryQueryParser *P = new BinaryQueryParser(Filename, MB, Builder);
+  P->Initialize();
+  return P;
+}
@@ -0,0 +1,360 @@
+//===-- CompiledExpr.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/CompiledExpr.h"
+
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprHashMap.h"
+
+#include <map>
+
+using namespace klee;
+
+static inline uint64_t mask(uint64_t value, unsigned width) {
+  return width >= 64 ? value : value & ((UINT64_C(1) << width) - 1);
+}
+
+static inline int64_t signExtend(uint64_t value, unsigned width) {
+  if (width >= 64)
+    return (int64_t)value;
+  unsigned shift = 64 - width;
+  return (int64_t)(value << shift) >> shift;
+}
+
+class CompiledExpr::Compiler {
+  CompiledExpr &program;
+
+  /// The registers of the compiled nodes
+  ExprHashMap<unsigned> compiled;
+
+  std::map<const Array *, unsigned> arraySlots;
+
+  /// The first and the number of the updates of the compiled update lists
+  std::map<const UpdateNode *, std::pair<unsigned, unsigned> > updateRanges;
+
+  bool failed;
+
+  unsigned emit(Opcode opcode, unsigned width, unsigned a = 0, unsigned b = 0,
+                unsigned c = 0, uint64_t value = 0) {
+    Instruction ins;
+    ins.opcode = opcode;
+    ins.width = width;
+    ins.operands[0] = a;
+    ins.operands[1] = b;
+    ins.operands[2] = c;
+    ins.value = value;
+    program.code.push_back(ins);
+    if (program.code.size() + program.updates.size() > MaxSize)
+      failed = true;
+    return program.code.size() - 1;
+  }
+
+  unsigned getArraySlot(const Array *array) {
+    std::map<const Array *, unsigned>::iterator it = arraySlots.find(array);
+    if (it != arraySlots.end())
+      return it->second;
+    unsigned slot = program.arrays.size();
+    program.arrays.push_back(array);
+    arraySlots[array] = slot;
+    return slot;
+  }
+
+  std::pair<unsigned, unsigned> compileUpdates(const UpdateNode *head) {
+    std::map<const UpdateNode *, std::pair<unsigned, unsigned> >::iterator it =
+        updateRanges.find(head);
+    if (it != updateRanges.end())
+      return it->second;
+
+    std::vector<Update> list;
+    for (const UpdateNode *un = head; un && !failed; un = un->next) {
+      Update update;
+      update.index = compile(un->index);
+      update.value = compile(un->value);
+      list.push_back(update);
+    }
+    std::pair<unsigned, unsigned> range(program.updates.size(), list.size());
+    program.updates.insert(program.updates.end(), list.begin(), list.end());
+    if (program.code.size() + program.updates.size() > MaxSize)
+      failed = true;
+    updateRanges[head] = range;
+    return range;
+  }
+
+  unsigned compileNode(const ref<Expr> &e);
+
+public:
+  explicit Compiler(CompiledExpr &_program)
+      : program(_program), failed(false) {}
+
+  unsigned compile(const ref<Expr> &e) {
+    if (failed)
+      return 0;
+    ExprHashMap<unsigned>::iterator it = compiled.find(e);
+    if (it != compiled.end())
+      return it->second;
+    unsigned reg = compileNode(e);
+    compiled.insert(std::make_pair(e, reg));
+    return reg;
+  }
+
+  bool hasFailed() const { return failed; }
+};
+
+unsigned CompiledExpr::Compiler::compileNode(const ref<Expr> &e) {
+  unsigned width = e->getWidth();
+  if (width > 64) {
+    failed = true;
+    return 0;
+  }
+
+  switch (e->getKind()) {
+  case Expr::Constant:
+    return emit(Constant, width, 0, 0, 0,
+                cast<ConstantExpr>(e)->getZExtValue());
+
+  case Expr::NotOptimized:
+    return compile(cast<NotOptimizedExpr>(e)->src);
+
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    unsigned index = compile(re->index);
+    std::pair<unsigned, unsigned> range = compileUpdates(re->updates.head);
+    return emit(Read, width, index, getArraySlot(re->updates.root),
+                range.second, range.first);
+  }
+
+  case Expr::Select: {
+    const SelectExpr *se = cast<SelectExpr>(e);
+    unsigned cond = compile(se->cond);
+    unsigned trueValue = compile(se->trueExpr);
+    unsigned falseValue = compile(se->falseExpr);
+    return emit(Select, width, cond, trueValue, falseValue);
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    return emit(Extract, width, compile(ee->expr), 0, 0, ee->offset);
+  }
+
+  case Expr::ZExt:
+    return emit(ZExt, width, compile(cast<CastExpr>(e)->src));
+
+  case Expr::SExt:
+    return emit(SExt, width, compile(cast<CastExpr>(e)->src));
+
+  case Expr::Not:
+    return emit(Not, width, compile(cast<NotExpr>(e)->expr));
+
+  case Expr::Concat:
+  case Expr::Add:
+  case Expr::Sub:
+  case Expr::Mul:
+  case Expr::UDiv:
+  case Expr::SDiv:
+  case Expr::URem:
+  case Expr::SRem:
+  case Expr::And:
+  case Expr::Or:
+  case Expr::Xor:
+  case Expr::Shl:
+  case Expr::LShr:
+  case Expr::AShr:
+  case Expr::Eq:
+  case Expr::Ne:
+  case Expr::Ult:
+  case Expr::Ule:
+  case Expr::Ugt:
+  case Expr::Uge:
+  case Expr::Slt:
+  case Expr::Sle:
+  case Expr::Sgt:
+  case Expr::Sge: {
+    // The binary opcodes but Concat are in the order of their kinds
+    Opcode opcode = e->getKind() == Expr::Concat
+                        ? Concat
+                        : Opcode(Add + (e->getKind() - Expr::Add));
+    unsigned left = compile(e->getKid(0));
+    unsigned right = compile(e->getKid(1));
+    return emit(opcode, width, left, right);
+  }
+
+  default:
+    // Exists and the kinds of the weakest preconditions
+    failed = true;
+    return 0;
+  }
+}
+
+CompiledExpr *CompiledExpr::compile(const ref<Expr> &e) {
+  CompiledExpr *program = new CompiledExpr();
+  Compiler compiler(*program);
+  compiler.compile(e);
+  if (compiler.hasFailed()) {
+    delete program;
+    return 0;
+  }
+  program->registers.resize(program->code.size());
+  program->bindings.resize(program->arrays.size());
+  return program;
+}
+
+bool CompiledExpr::evaluate(const Assignment &a, uint64_t &result) const {
+  for (unsigned i = 0, e = arrays.size(); i != e; ++i) {
+    Assignment::bindings_ty::const_iterator it = a.bindings.find(arrays[i]);
+    bindings[i] = it == a.bindings.end() ? 0 : &it->second;
+  }
+
+  uint64_t *r = &registers[0];
+  for (unsigned i = 0, e = code.size(); i != e; ++i) {
+    const Instruction &ins = code[i];
+    uint64_t left = r[ins.operands[0]], right = r[ins.operands[1]];
+    unsigned width = code[ins.operands[0]].width;
+    uint64_t value;
+
+    switch (ins.opcode) {
+    case Constant:
+      value = ins.value;
+      break;
+
+    case Read: {
+      unsigned u = ins.value, ue = u + ins.operands[2];
+      for (; u != ue; ++u)
+        if (r[updates[u].index] == left)
+          break;
+      if (u != ue) {
+        value = r[updates[u].value];
+        break;
+      }
+      const Array *array = arrays[ins.operands[1]];
+      const std::vector<unsigned char> *binding = bindings[ins.operands[1]];
+      if (array->isConstantArray() && left < array->size)
+        value = array->constantValues[left]->getZExtValue();
+      else if (binding && left < binding->size())
+        value = (*binding)[left];
+      else if (a.allowFreeValues)
+        return false;
+      else
+        value = 0;
+      break;
+    }
+
+    case Select:
+      value = left ? right : r[ins.operands[2]];
+      break;
+    case Concat:
+      value = (left << code[ins.operands[1]].width) | right;
+      break;
+    case Extract:
+      value = left >> ins.value;
+      break;
+    case ZExt:
+      value = left;
+      break;
+    case SExt:
+      value = signExtend(left, width);
+      break;
+    case Not:
+      value = ~left;
+      break;
+
+    case Add:
+      value = left + right;
+      break;
+    case Sub:
+      value = left - right;
+      break;
+    case Mul:
+      value = left * right;
+      break;
+    case UDiv:
+    case URem:
+      if (!right)
+        return false;
+      value = ins.opcode == UDiv ? left / right : left % right;
+      break;
+    case SDiv:
+    case SRem: {
+      int64_t sleft = signExtend(left, width);
+      int64_t sright = signExtend(right, width);
+      if (!sright)
+        return false;
+      // The minimum divided by -1 overflows where APInt wraps around
+      if (sright == -1)
+        value = ins.opcode == SDiv ? -left : 0;
+      else
+        value = ins.opcode == SDiv ? sleft / sright : sleft % sright;
+      break;
+    }
+
+    case And:
+      value = left & right;
+      break;
+    case Or:
+      value = left | right;
+      break;
+    case Xor:
+      value = left ^ right;
+      break;
+    // The shifts by the width or more are those of APInt
+    case Shl:
+      value = right >= width ? 0 : left << right;
+      break;
+    case LShr:
+      value = right >= width ? 0 : left >> right;
+      break;
+    case AShr: {
+      int64_t sleft = signExtend(left, width);
+      if (right >= width)
+        value = sleft < 0 ? ~UINT64_C(0) : 0;
+      else
+        value = (uint64_t)(sleft >> right);
+      break;
+    }
+
+    case Eq:
+      value = left == right;
+      break;
+    case Ne:
+      value = left != right;
+      break;
+    case Ult:
+      value = left < right;
+      break;
+    case Ule:
+      value = left <= right;
+      break;
+    case Ugt:
+      value = left > right;
+      break;
+    case Uge:
+      value = left >= right;
+      break;
+    case Slt:
+      value = signExtend(left, width) < signExtend(right, width);
+      break;
+    case Sle:
+      value = signExtend(left, width) <= signExtend(right, width);
+      break;
+    case Sgt:
+      value = signExtend(left, width) > signExtend(right, width);
+      break;
+    case Sge:
+      value = signExtend(left, width) >= signExtend(right, width);
+      break;
+
+    default:
+      assert(0 && "invalid opcode");
+      return false;
+    }
+    r[i] = mask(value, ins.width);
+  }
+
+  result = r[code.size() - 1];
+  return true;
+}
@@ -11,6 +11,7 @@
 #include "klee/CommandLine.h"
 
 #include "klee/util/ExprPPrinter.h"
+#include "klee/util/ExprUtil.h"
 #include "klee/util/ExprVisitor.h"
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
 #include "llvm/IR/Function.h"
@@ -20,6 +21,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "klee/Internal/Module/KModule.h"
 
+#include <algorithm>
 #include <map>
 
 using namespace klee;
@@ -83,27 +85,80 @@ public:
   }
 };
 
-bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
+uint64_t ConstraintManager::getArrayMask(ref<Expr> e) {
+  std::vector<ref<ReadExpr> > reads;
+  findReads(e, /* visitUpdates= */ true, reads);
+  // The top bit marks the mask as computed
+  uint64_t mask = 1ULL << 63;
+  for (std::vector<ref<ReadExpr> >::iterator it = reads.begin(),
+                                             ie = reads.end();
+       it != ie; ++it) {
+    uint64_t h = (uint64_t)(uintptr_t)(*it)->updates.root * 0x9e3779b97f4a7c15ULL;
+    mask |= 1ULL << (h >> 58) % 63;
+  }
+  return mask;
+}
+
+void ConstraintManager::addEquality(equalities_ty &equalities, ref<Expr> e) {
+  if (const EqExpr *ee = dyn_cast<EqExpr>(e)) {
+    if (isa<ConstantExpr>(ee->left)) {
+      equalities[ee->right] = std::make_pair(ee->left, e);
+    } else {
+      equalities[e] = std::make_pair(ConstantExpr::alloc(1, Expr::Bool), e);
+    }
+  } else {
+    equalities[e] = std::make_pair(ConstantExpr::alloc(1, Expr::Bool), e);
+  }
+}
+
+bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor,
+                                           uint64_t mask) {
   ConstraintManager::constraints_ty old;
+  std::vector<uint64_t> oldMasks;
   bool changed = false;
 
   constraints.swap(old);
-  for (ConstraintManager::constraints_ty::iterator 
-         it = old.begin(), ie = old.end(); it != ie; ++it) {
-    ref<Expr> &ce = *it;
+  arrayMasks.swap(oldMasks);
+  fingerprint = 0;
+  equalities.clear();
+  equalitiesValid = false;
+  for (unsigned i = 0; i < old.size(); ++i) {
+    ref<Expr> &ce = old[i];
+    if (!oldMasks[i])
+      oldMasks[i] = getArrayMask(ce);
+    if (!(oldMasks[i] & mask & ~(1ULL << 63))) {
+      append(ce, oldMasks[i]);
+      continue;
+    }
+
     ref<Expr> e = visitor.visit(ce);
 
     if (e!=ce) {
       addConstraintInternal(e); // enable further reductions
       changed = true;
     } else {
-      constraints.push_back(ce);
+      append(ce, oldMasks[i]);
     }
   }
 
   return changed;
 }
 
+bool ConstraintManager::operator==(const ConstraintManager &other) const {
+  if (fingerprint != other.fingerprint ||
+      constraints.size() != other.constraints.size())
+    return false;
+
+  // The constraints of the states of a path share a prefix of the same
+  // expressions, which need no structural comparison
+  constraints_ty::const_iterator it = constraints.begin(),
+                                 ie = constraints.end(),
+                                 oit = other.constraints.begin();
+  for (; it != ie && it->get() == oit->get(); ++it, ++oit)
+    ;
+  return std::equal(it, ie, oit);
+}
+
 void ConstraintManager::simplifyForValidConstraint(ref<Expr> e) {
   // XXX 
 }
@@ -118,20 +173,14 @@ ref<Expr> ConstraintManager::simplifyExpr(ref<Expr> e,
   if (isa<ConstantExpr>(e))
     return e;
 
-  std::map<ref<Expr>, std::pair<ref<Expr>, ref<Expr> > > equalities;
-
-  for (ConstraintManager::constraints_ty::const_iterator 
-         it = constraints.begin(), ie = constraints.end(); it != ie; ++it) {
-    if (const EqExpr *ee = dyn_cast<EqExpr>(*it)) {
-      if (isa<ConstantExpr>(ee->left)) {
-        equalities[ee->right] = std::make_pair(ee->left, *it);
-      } else {
-        equalities[*it] =
-            std::make_pair(ConstantExpr::alloc(1, Expr::Bool), *it);
-      }
-    } else {
-      equalities[*it] = std::make_pair(ConstantExpr::alloc(1, Expr::Bool), *it);
-    }
+  if (!equalitiesValid) {
+    equalities.clear();
+    for (ConstraintManager::constraints_ty::const_iterator
+             it = constraints.begin(),
+             ie = constraints.end();
+         it != ie; ++it)
+      addEquality(equalities, *it);
+    equalitiesValid = true;
   }
 
   ExprReplaceVisitor2 visitor(equalities);
@@ -168,15 +217,15 @@ void ConstraintManager::addConstraintInternal(ref<Expr> e) {
       BinaryExpr *be = cast<BinaryExpr>(e);
       if (isa<ConstantExpr>(be->left)) {
 	ExprReplaceVisitor visitor(be->right, be->left);
-	rewriteConstraints(visitor);
+	rewriteConstraints(visitor, getArrayMask(be->right));
       }
     }
-    constraints.push_back(e);
+    append(e);
     break;
   }
     
   default:
-    constraints.push_back(e);
+    append(e);
     break;
   }
 }
@@ -21,6 +21,7 @@
 
 #include "klee/util/ExprPPrinter.h"
 
+#include <set>
 #include <sstream>
 
 using namespace klee;
@@ -167,82 +168,127 @@ void Expr::printKind(llvm::raw_ostream &os, Kind k) {
 //
 ///////
 
-unsigned Expr::computeHash() {
-  unsigned res = getKind() * Expr::MAGIC_HASH_CONSTANT;
+uint64_t Expr::computeHash() {
+  uint64_t res = mixHash(getKind());
 
   int n = getNumKids();
-  for (int i = 0; i < n; i++) {
-    res <<= 1;
-    res ^= getKid(i)->hash() * Expr::MAGIC_HASH_CONSTANT;
-  }
-  
+  for (int i = 0; i < n; i++)
+    res = combineHash(res, getKid(i)->hash());
+
   hashValue = res;
   return hashValue;
 }
 
-unsigned ConstantExpr::computeHash() {
+uint64_t ConstantExpr::computeHash() {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 1)
-  hashValue = hash_value(value) ^ (getWidth() * MAGIC_HASH_CONSTANT);
+  hashValue = combineHash(hash_value(value), getWidth());
 #else
-  hashValue = value.getHashValue() ^ (getWidth() * MAGIC_HASH_CONSTANT);
+  hashValue = combineHash(value.getHashValue(), getWidth());
 #endif
   return hashValue;
 }
 
-unsigned ExistsExpr::computeHash() {
-  unsigned res = body->hash() * Expr::MAGIC_HASH_CONSTANT;
+ConstantExpr *ConstantExpr::getSmallConstant(uint64_t v, Width w) {
+  // The table of each width is filled in on first use. The references of the
+  // tables keep the constants alive until the end of the run.
+  static std::vector<ref<ConstantExpr> > tables[5];
+
+  unsigned index;
+  switch (w) {
+  case Expr::Bool:
+    if (v > 1)
+      return 0;
+    index = 0;
+    break;
+  case Expr::Int8:  index = 1; break;
+  case Expr::Int16: index = 2; break;
+  case Expr::Int32: index = 3; break;
+  case Expr::Int64: index = 4; break;
+  default:
+    return 0;
+  }
+
+  // The values below SmallConstantCount are at their own index, followed by
+  // the ones from the maximum downwards. The 8-bit values are all below
+  // SmallConstantCount.
+  uint64_t max = bits64::maxValueOfNBits(w);
+  uint64_t slot = v;
+  if (v >= SmallConstantCount) {
+    if (max - v >= SmallNegativeCount)
+      return 0;
+    slot = SmallConstantCount + (max - v);
+  }
+
+  std::vector<ref<ConstantExpr> > &table = tables[index];
+  if (table.empty()) {
+    uint64_t size = (w == Expr::Bool)
+                        ? 2
+                        : (w == Expr::Int8)
+                              ? SmallConstantCount
+                              : SmallConstantCount + SmallNegativeCount;
+    table.reserve(size);
+    for (uint64_t i = 0; i < size; ++i) {
+      uint64_t value = i < SmallConstantCount
+                           ? i
+                           : max - (i - SmallConstantCount);
+      ref<ConstantExpr> c(new ConstantExpr(llvm::APInt(w, value)));
+      c->computeHash();
+      table.push_back(c);
+    }
+  }
+  return table[slot].get();
+}
+
+uint64_t ExistsExpr::computeHash() {
+  uint64_t res = combineHash(mixHash(Exists), body->hash());
   for (std::set<const Array *>::iterator it = variables.begin(),
                                          itEnd = variables.end();
-       it != itEnd; ++it) {
-    res <<= 1;
-    res ^= (*it)->hash() * Expr::MAGIC_HASH_CONSTANT;
-  }
-  return res;
+       it != itEnd; ++it)
+    res = combineHash(res, (*it)->hash());
+  hashValue = res;
+  return hashValue;
 }
 
-unsigned CastExpr::computeHash() {
-  unsigned res = getWidth() * Expr::MAGIC_HASH_CONSTANT;
-  hashValue = res ^ src->hash() * Expr::MAGIC_HASH_CONSTANT;
+uint64_t CastExpr::computeHash() {
+  uint64_t res = combineHash(mixHash(getKind()), getWidth());
+  hashValue = combineHash(res, src->hash());
   return hashValue;
 }
 
-unsigned ExtractExpr::computeHash() {
-  unsigned res = offset * Expr::MAGIC_HASH_CONSTANT;
-  res ^= getWidth() * Expr::MAGIC_HASH_CONSTANT;
-  hashValue = res ^ expr->hash() * Expr::MAGIC_HASH_CONSTANT;
+uint64_t ExtractExpr::computeHash() {
+  uint64_t res = combineHash(mixHash(Extract), offset);
+  res = combineHash(res, getWidth());
+  hashValue = combineHash(res, expr->hash());
   return hashValue;
 }
 
-unsigned ReadExpr::computeHash() {
-  unsigned res = index->hash() * Expr::MAGIC_HASH_CONSTANT;
-  res ^= updates.hash();
-  hashValue = res;
+uint64_t ReadExpr::computeHash() {
+  hashValue = combineHash(updates.hash(), index->hash());
   return hashValue;
 }
 
-unsigned WPVarExpr::computeHash() {
-  unsigned hash = 0;
-  for (unsigned i = 0; i < name.size(); i++) {
-    hash = (hash * Expr::MAGIC_HASH_CONSTANT) + name[i];
-  }
-  unsigned res = index->hash() * Expr::MAGIC_HASH_CONSTANT * hash;
-  hashValue = res;
+uint64_t WPVarExpr::computeHash() {
+  uint64_t res = mixHash(WPVar);
+  for (unsigned i = 0; i < name.size(); i++)
+    res = (res * Expr::MAGIC_HASH_CONSTANT) + name[i];
+  hashValue = combineHash(res, index->hash());
   return hashValue;
 }
 
-unsigned SelExpr::computeHash() {
-  hashValue = array->hash() * index->hash() * Expr::MAGIC_HASH_CONSTANT;
+uint64_t SelExpr::computeHash() {
+  hashValue = combineHash(combineHash(mixHash(Sel), array->hash()),
+                          index->hash());
   return hashValue;
 }
 
-unsigned UpdExpr::computeHash() {
-  hashValue =
-      array->hash() * index->hash() * value->hash() * Expr::MAGIC_HASH_CONSTANT;
+uint64_t UpdExpr::computeHash() {
+  uint64_t res = combineHash(mixHash(Upd), array->hash());
+  hashValue = combineHash(combineHash(res, index->hash()), value->hash());
   return hashValue;
 }
 
-unsigned NotExpr::computeHash() {
-  hashValue = expr->hash() * Expr::MAGIC_HASH_CONSTANT * Expr::Not;
+uint64_t NotExpr::computeHash() {
+  hashValue = combineHash(mixHash(Not), expr->hash());
   return hashValue;
 }
 
@@ -523,12 +569,20 @@ ref<Expr>  NotOptimizedExpr::create(ref<Expr> src) {
 
 /***/
 
+/// The names of the arrays, never released such that the arrays can refer to
+/// them until the end
+static const std::string &internArrayName(const std::string &name) {
+  static std::set<std::string> *names = new std::set<std::string>();
+  return *names->insert(name).first;
+}
+
 Array::Array(const std::string &_name, uint64_t _size,
              const ref<ConstantExpr> *constantValuesBegin,
              const ref<ConstantExpr> *constantValuesEnd, Expr::Width _domain,
              Expr::Width _range)
-    : name(_name), size(_size), domain(_domain), range(_range),
-      constantValues(constantValuesBegin, constantValuesEnd) {
+    : name(internArrayName(_name)), size(_size), domain(_domain),
+      range(_range), constantValues(constantValuesBegin, constantValuesEnd),
+      id(0) {
 
   assert((isSymbolicArray() || constantValues.size() == size) &&
          "Invalid size for constant array!");
@@ -544,13 +598,12 @@ Array::Array(const std::string &_name, uint64_t _size,
 Array::~Array() {
 }
 
-unsigned Array::computeHash() {
-  unsigned res = 0;
+uint64_t Array::computeHash() {
+  uint64_t res = 0;
   for (unsigned i = 0, e = name.size(); i != e; ++i)
     res = (res * Expr::MAGIC_HASH_CONSTANT) + name[i];
-  res = (res * Expr::MAGIC_HASH_CONSTANT) + size;
-  hashValue = res;
-  return hashValue; 
+  hashValue = Expr::combineHash(res, size);
+  return hashValue;
 }
 /***/
 
@@ -564,6 +617,17 @@ ref<Expr> ReadExpr::create(const UpdateList &ul, ref<Expr> index) {
   // a smart UpdateList so it is not worth rescanning.
 
   const UpdateNode *un = ul.head;
+
+  // Long sequences of updates at constant indices, as produced by loops
+  // filling buffers, are looked up through their index instead.
+  const ConstantExpr *CI = dyn_cast<ConstantExpr>(index);
+  if (CI && CI->getWidth() <= 64 && un &&
+      un->getSize() >= UpdateNode::ConstantIndexThreshold) {
+    if (const UpdateNode *found =
+            un->lookupConstantIndex(CI->getZExtValue(), un))
+      return found->value;
+  }
+
   for (; un; un=un->next) {
     ref<Expr> cond = EqExpr::create(index, un->index);
     
@@ -588,7 +652,10 @@ ref<Expr> WPVarExpr::create(llvm::Value *address, std::string name,
 }
 
 int WPVarExpr::compareContents(const Expr &b) const {
-  return this->address == static_cast<const WPVarExpr &>(b).address;
+  const WPVarExpr &wb = static_cast<const WPVarExpr &>(b);
+  if (address != wb.address)
+    return address < wb.address ? -1 : 1;
+  return 0;
 }
 
 void WPVarExpr::print(llvm::raw_ostream &os) const {
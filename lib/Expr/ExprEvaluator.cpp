@@ -13,7 +13,13 @@ using namespace klee;
 
 ExprVisitor::Action ExprEvaluator::evalRead(const UpdateList &ul,
                                             unsigned index) {
-  for (const UpdateNode *un=ul.head; un; un=un->next) {
+  const UpdateNode *un = ul.head;
+  if (un && un->getSize() >= UpdateNode::ConstantIndexThreshold) {
+    if (const UpdateNode *found = un->lookupConstantIndex(index, un))
+      return Action::changeTo(visit(found->value));
+  }
+
+  for (; un; un=un->next) {
     ref<Expr> ui = visit(un->index);
     
     if (ConstantExpr *CE = dyn_cast<ConstantExpr>(ui)) {
@@ -0,0 +1,42 @@
+//===-- ExprHashConsing.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/ExprHashConsing.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+static const size_t MinCollectThreshold = 1 << 12;
+
+ExprHashConsing::ExprHashConsing() : collectThreshold(MinCollectThreshold) {}
+
+ref<Expr> ExprHashConsing::intern(const ref<Expr> &e) {
+  ExprHashSet::iterator it = table.find(e);
+  if (it != table.end())
+    return *it;
+
+  table.insert(e);
+  if (table.size() >= collectThreshold) {
+    collect();
+    collectThreshold = std::max(MinCollectThreshold, 2 * table.size());
+  }
+  return e;
+}
+
+void ExprHashConsing::collect() {
+  // Releasing a node may leave its children only referenced by the table;
+  // those are released by the next collection.
+  for (ExprHashSet::iterator it = table.begin(); it != table.end();) {
+    if ((*it)->refCount == 1)
+      it = table.erase(it);
+    else
+      ++it;
+  }
+}
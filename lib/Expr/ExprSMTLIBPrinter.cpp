@@ -45,6 +45,9 @@ llvm::cl::opt<klee::ExprSMTLIBPrinter::AbbreviationMode> abbreviationMode(
                                 "Abbreviate with let"),
                      clEnumValN(klee::ExprSMTLIBPrinter::ABBR_NAMED, "named",
                                 "Abbreviate with :named annotations"),
+                     clEnumValN(klee::ExprSMTLIBPrinter::ABBR_DEFINE_FUN,
+                                "define-fun",
+                                "Abbreviate with define-fun commands"),
                      clEnumValEnd),
     llvm::cl::init(klee::ExprSMTLIBPrinter::ABBR_LET));
 }
@@ -83,6 +86,10 @@ void ExprSMTLIBPrinter::reset() {
   bindings.clear();
   orderedBindings.clear();
   seenExprs.clear();
+  references.clear();
+  updateReferences.clear();
+  definitions.clear();
+  updateDefinitions.clear();
   usedArrays.clear();
   haveConstantArray = false;
 
@@ -200,6 +207,15 @@ void ExprSMTLIBPrinter::printExpression(
     }
     break;
   }
+
+  case ABBR_DEFINE_FUN: {
+    ExprHashMap<unsigned>::iterator i = definitions.find(e);
+    if (i != definitions.end()) {
+      *p << "?B" << i->second;
+      return;
+    }
+    break;
+  }
   }
 
   printFullExpression(e, expectedSort);
@@ -431,7 +447,15 @@ void ExprSMTLIBPrinter::printExistsExpr(const ref<ExistsExpr> &e) {
   }
   *p << ")";
   printSeperator();
+
+  // The definitions are outside the scope of the bound variables, hence they
+  // may not be used in the body, where the names of the arrays are those of
+  // the variables.
+  AbbreviationMode mode = abbrMode;
+  if (abbrMode == ABBR_DEFINE_FUN)
+    abbrMode = ABBR_NONE;
   printExpression(e->getKid(0), SORT_BOOL);
+  abbrMode = mode;
   p->popIndent();
   *p << ")";
 }
@@ -507,6 +531,15 @@ const char *ExprSMTLIBPrinter::getSMTLIBKeyword(const ref<Expr> &e) {
 
 void ExprSMTLIBPrinter::printUpdatesAndArray(const UpdateNode *un,
                                              const Array *root) {
+  if (abbrMode == ABBR_DEFINE_FUN && un != NULL) {
+    std::map<const UpdateNode *, unsigned>::const_iterator i =
+        updateDefinitions.find(un);
+    if (i != updateDefinitions.end()) {
+      *p << "?U" << i->second;
+      return;
+    }
+  }
+
   if (un != NULL) {
     *p << "(store ";
     p->pushIndent();
@@ -656,7 +689,10 @@ void ExprSMTLIBPrinter::printHumanReadableQuery() {
   assert(humanReadable && "method must be called in humanReadable mode");
   *o << "; Constraints\n";
 
-  if (abbrMode != ABBR_LET) {
+  if (abbrMode == ABBR_DEFINE_FUN) {
+    *o << "; Definitions, Constraints and QueryExpr\n";
+    printQueryWithDefinitions();
+  } else if (abbrMode != ABBR_LET) {
     // Generate assert statements for each constraint
     for (ConstraintManager::const_iterator i = query->constraints.begin();
          i != query->constraints.end(); i++) {
@@ -678,7 +714,10 @@ void ExprSMTLIBPrinter::printHumanReadableQuery() {
 }
 void ExprSMTLIBPrinter::printMachineReadableQuery() {
   assert(!humanReadable && "method should not be called in humanReadable mode");
-  printQueryInSingleAssert();
+  if (abbrMode == ABBR_DEFINE_FUN)
+    printQueryWithDefinitions();
+  else
+    printQueryInSingleAssert();
 }
 
 
@@ -698,6 +737,136 @@ void ExprSMTLIBPrinter::printQueryInSingleAssert() {
   printAssert(queryAssert);
 }
 
+void ExprSMTLIBPrinter::printQueryWithDefinitions() {
+  // We negate the Query Expr because in KLEE queries are solved
+  // in terms of validity, but SMT-LIB works in terms of satisfiability
+  ref<Expr> queryAssert = Expr::createIsZero(query->expr);
+
+  // The definitions are global, so that the subterms shared between the
+  // constraints are defined once for all of them
+  for (ConstraintManager::const_iterator i = query->constraints.begin(),
+                                         e = query->constraints.end();
+       i != e; ++i)
+    countReferences(*i);
+  countReferences(queryAssert);
+
+  for (ConstraintManager::const_iterator i = query->constraints.begin(),
+                                         e = query->constraints.end();
+       i != e; ++i) {
+    printDefinitions(*i);
+    printAssert(*i);
+  }
+  printDefinitions(queryAssert);
+  printAssert(queryAssert);
+}
+
+void ExprSMTLIBPrinter::countReferences(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return;
+
+  if (references[e]++)
+    return;
+
+  // The bodies of the quantified expressions are not abbreviated
+  if (isa<ExistsExpr>(e))
+    return;
+
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e))
+    countUpdateReferences(re->updates.head);
+
+  for (unsigned i = 0; i < e->getNumKids(); ++i)
+    countReferences(e->getKid(i));
+}
+
+void ExprSMTLIBPrinter::countUpdateReferences(const UpdateNode *un) {
+  // The rest of the list has been counted with the first occurrence of a node
+  for (; un != NULL; un = un->next) {
+    if (updateReferences[un]++)
+      return;
+    countReferences(un->index);
+    countReferences(un->value);
+  }
+}
+
+void ExprSMTLIBPrinter::printDefinitions(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e) || definitions.count(e))
+    return;
+
+  // Nothing in the body of a quantified expression is defined
+  if (!isa<ExistsExpr>(e)) {
+    if (const ReadExpr *re = dyn_cast<ReadExpr>(e))
+      printUpdateDefinitions(re->updates.head, re->updates.root);
+
+    for (unsigned i = 0; i < e->getNumKids(); ++i)
+      printDefinitions(e->getKid(i));
+  }
+
+  if (references[e] < 2)
+    return;
+
+  SMTLIB_SORT sort = getSort(e);
+  unsigned number = definitions.size() + 1;
+  *p << "(define-fun";
+  p->pushIndent();
+  printSeperator();
+  *p << "?B" << number;
+  printSeperator();
+  *p << "()";
+  printSeperator();
+  if (sort == SORT_BOOL)
+    *p << "Bool";
+  else
+    *p << "(_ BitVec " << e->getWidth() << ")";
+  printSeperator();
+  printFullExpression(e, sort);
+  p->popIndent();
+  printSeperator();
+  *p << ")";
+  p->breakLineI();
+
+  definitions.insert(std::make_pair(e, number));
+}
+
+void ExprSMTLIBPrinter::printUpdateDefinitions(const UpdateNode *un,
+                                               const Array *root) {
+  // Define the nodes from the oldest undefined one, so that each definition
+  // uses those of the rest of its list
+  std::vector<const UpdateNode *> undefined;
+  for (; un != NULL && !updateDefinitions.count(un); un = un->next)
+    undefined.push_back(un);
+
+  for (std::vector<const UpdateNode *>::reverse_iterator
+           it = undefined.rbegin(),
+           ie = undefined.rend();
+       it != ie; ++it) {
+    const UpdateNode *node = *it;
+    printDefinitions(node->index);
+    printDefinitions(node->value);
+
+    if (updateReferences[node] < 2)
+      continue;
+
+    unsigned number = updateDefinitions.size() + 1;
+    *p << "(define-fun";
+    p->pushIndent();
+    printSeperator();
+    *p << "?U" << number;
+    printSeperator();
+    *p << "()";
+    printSeperator();
+    *p << "(Array (_ BitVec " << root->getDomain() << ") (_ BitVec "
+       << root->getRange() << "))";
+    printSeperator();
+    printUpdatesAndArray(node, root);
+    p->popIndent();
+    printSeperator();
+    *p << ")";
+    p->breakLineI();
+
+    updateDefinitions.insert(std::make_pair(node, number));
+  }
+}
+
 void ExprSMTLIBPrinter::printAction() {
   // Ask solver to check for satisfiability
   *o << "(check-sat)\n";
@@ -750,7 +919,7 @@ void ExprSMTLIBPrinter::scan(const ref<Expr> &e) {
     Expr *ep = e.get();
     for (unsigned int i = 0; i < ep->getNumKids(); i++)
       scan(ep->getKid(i));
-  } else {
+  } else if (abbrMode != ABBR_DEFINE_FUN) {
     // Add the expression to the binding map. The semantics of std::map::insert
     // are such that it will not be inserted twice.
     bindings.insert(std::make_pair(e, bindings.size()+1));
@@ -10,6 +10,7 @@
 #include "expr/Parser.h"
 
 #include "expr/Lexer.h"
+#include "expr/SMTLIB2Parser.h"
 
 #include "klee/Config/Version.h"
 #include "klee/Constraints.h"
@@ -17,6 +18,7 @@
 #include "klee/Solver.h"
 #include "klee/util/ExprPPrinter.h"
 #include "klee/util/ArrayCache.h"
+#include "klee/util/BinaryQueryLog.h"
 
 #include "llvm/ADT/APInt.h"
 #include "llvm/Support/MemoryBuffer.h"
@@ -1647,6 +1649,11 @@ Parser::~Parser() {
 
 Parser *Parser::Create(const std::string Filename, const MemoryBuffer *MB,
                        ExprBuilder *Builder, bool ClearArrayAfterQuery) {
+  if (isBinaryQueryLog(MB))
+    return createBinaryQueryParser(Filename, MB, Builder);
+  if (isSMTLIB2Script(Filename, MB))
+    return createSMTLIB2Parser(Filename, MB, Builder);
+
   ParserImpl *P = new ParserImpl(Filename, MB, Builder, ClearArrayAfterQuery);
   P->Initialize();
   return P;
@@ -0,0 +1,1072 @@
+//===-- SMTLIB2Parser.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A streaming parser of the SMT-LIB v2 scripts over bit-vectors and arrays
+// (QF_BV, QF_ABV, QF_AUFBV), such as the SMT-COMP benchmarks and the logs of
+// the SMTLIBLoggingSolver. Each (check-sat) is returned as the query command
+// (query [assertions] false), valid when the assertions are unsatisfiable,
+// with the variables of the (get-value) commands following it as the objects.
+//
+// The commands are read one at a time, and the assertions are translated at
+// the (check-sat), once the sizes of the arrays are known from the constant
+// indices of their reads, as the symbolic arrays of KLEE have a size. The
+// variables are arrays of bytes: a bit-vector variable of width w is read
+// from an array of (w + 7) / 8 bytes, least significant byte first, and a
+// Boolean one from the bit 0 of an array of one byte.
+//
+//===----------------------------------------------------------------------===//
+
+#include "expr/SMTLIB2Parser.h"
+
+#include "expr/Parser.h"
+
+#include "klee/ExprBuilder.h"
+#include "klee/util/ArrayCache.h"
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <set>
+
+using namespace llvm;
+using namespace klee;
+using namespace klee::expr;
+
+namespace {
+/// The arrays with a constant read at an index beyond this one keep the size
+/// of their other reads
+const uint64_t MaxArraySize = 1 << 20;
+
+/// SExpr - An S-expression of the script.
+struct SExpr {
+  /// The symbol, keyword, numeral or literal of an atom
+  std::string Atom;
+  std::vector<SExpr> Kids;
+  bool IsList;
+  unsigned Line;
+
+  SExpr() : IsList(false), Line(0) {}
+
+  bool isAtom(const char *S) const { return !IsList && Atom == S; }
+};
+
+/// Term - The value of a term: a bit-vector or Boolean expression, or an
+/// array, as the update list of its stores.
+struct Term {
+  ref<Expr> E;
+  UpdateList Updates;
+
+  Term() : Updates(0, 0) {}
+  explicit Term(const ref<Expr> &_E) : E(_E), Updates(0, 0) {}
+  explicit Term(const UpdateList &_Updates) : Updates(_Updates) {}
+
+  bool isArray() const { return Updates.root != 0; }
+};
+
+/// Sort - The sort of a declared or defined symbol.
+struct Sort {
+  enum Kind { Bool, BitVec, ArrayOf };
+  Kind K;
+  /// The width of a bit-vector, or the domain and range of an array
+  unsigned Width, Domain, Range;
+
+  Sort() : K(Bool), Width(1), Domain(0), Range(0) {}
+};
+
+/// Variable - A declared symbol, with the array created on its first use.
+struct Variable {
+  Sort S;
+  const Array *Root;
+  Term Value;
+
+  Variable() : Root(0) {}
+};
+
+/// Definition - A symbol defined by (define-fun) or by a :named term, with
+/// the value of its body once it is used.
+struct Definition {
+  SExpr Body;
+  bool Translated;
+  Term Value;
+
+  Definition() : Translated(false) {}
+};
+
+/// Scope - The assertions and the symbols of a level of (push).
+struct Scope {
+  /// The assertions not translated yet
+  std::vector<SExpr> Pending;
+  std::vector<ref<Expr> > Assertions;
+  std::vector<std::string> Names;
+};
+
+class SMTLIB2Parser : public Parser {
+  const std::string Filename;
+  const char *Pos, *End;
+  unsigned Line;
+  ExprBuilder *Builder;
+  ArrayCache TheArrayCache;
+  unsigned MaxErrors;
+  unsigned NumErrors;
+
+  std::map<std::string, Variable> Variables;
+  std::map<std::string, Definition> Definitions;
+  /// The symbols bound by the enclosing let terms
+  std::map<std::string, Term> Bindings;
+  std::vector<Scope> Scopes;
+  /// The maximal constant index of the reads of each array variable
+  std::map<std::string, uint64_t> MaxIndex;
+
+  void Error(unsigned ErrorLine, const std::string &Message);
+
+  bool SkipBlanks();
+  bool ReadSExpr(SExpr &S);
+  bool ReadCommand(SExpr &Command);
+  void Reset();
+
+  void ScanIndices(const SExpr &S);
+  bool ParseNumeral(const SExpr &S, uint64_t &Value);
+  bool ParseSort(const SExpr &S, Sort &Result);
+
+  const Array *GetArray(const std::string &Name, Variable &V);
+  bool TranslateSymbol(const SExpr &S, Term &T);
+  bool TranslateLet(const SExpr &S, Term &T);
+  bool TranslateIndexed(const SExpr &Head, const std::vector<Term> &Args,
+                        Term &T);
+  bool TranslateApp(const SExpr &S, Term &T);
+  bool Translate(const SExpr &S, Term &T);
+  bool TranslateExpr(const SExpr &S, ref<Expr> &E);
+
+  void CollectObjects(const SExpr &S, std::vector<const Array *> &Objects,
+                      std::set<const Array *> &Seen);
+
+  QueryCommand *CheckSat(const std::vector<SExpr> &Assumptions);
+  QueryCommand *ParseCommand(const SExpr &Command);
+
+public:
+  SMTLIB2Parser(const std::string &_Filename, const MemoryBuffer *MB,
+                ExprBuilder *_Builder)
+      : Filename(_Filename), Pos(MB->getBufferStart()),
+        End(MB->getBufferEnd()), Line(1), Builder(_Builder),
+        MaxErrors(~0u), NumErrors(0), Scopes(1) {}
+
+  virtual ~SMTLIB2Parser() {}
+
+  virtual void SetMaxErrors(unsigned N) { MaxErrors = N; }
+
+  virtual unsigned GetNumErrors() const { return NumErrors; }
+
+  virtual Decl *ParseTopLevelDecl();
+};
+}
+
+void SMTLIB2Parser::Error(unsigned ErrorLine, const std::string &Message) {
+  if (NumErrors++ < MaxErrors)
+    llvm::errs() << Filename << ":" << ErrorLine << ": error: " << Message
+                 << "\n";
+}
+
+// Lexing
+
+static bool isSymbolChar(char C) {
+  return !isspace((unsigned char)C) && C != '(' && C != ')' && C != ';' &&
+         C != '"' && C != '|';
+}
+
+bool SMTLIB2Parser::SkipBlanks() {
+  while (Pos != End) {
+    if (*Pos == '\n') {
+      ++Line;
+      ++Pos;
+    } else if (isspace((unsigned char)*Pos)) {
+      ++Pos;
+    } else if (*Pos == ';') {
+      while (Pos != End && *Pos != '\n')
+        ++Pos;
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SMTLIB2Parser::ReadSExpr(SExpr &S) {
+  if (!SkipBlanks()) {
+    Error(Line, "unexpected end of input");
+    return false;
+  }
+  S.Line = Line;
+
+  if (*Pos == '(') {
+    ++Pos;
+    S.IsList = true;
+    for (;;) {
+      if (!SkipBlanks()) {
+        Error(S.Line, "unterminated list");
+        return false;
+      }
+      if (*Pos == ')') {
+        ++Pos;
+        return true;
+      }
+      S.Kids.push_back(SExpr());
+      if (!ReadSExpr(S.Kids.back()))
+        return false;
+    }
+  }
+
+  if (*Pos == ')') {
+    Error(Line, "unexpected ')'");
+    ++Pos;
+    return false;
+  }
+
+  if (*Pos == '|' || *Pos == '"') {
+    // A quoted symbol keeps its bars off, and a string literal its quotes
+    char Quote = *Pos;
+    const char *Begin = Pos++;
+    for (;;) {
+      if (Pos == End) {
+        Error(S.Line, "unterminated literal");
+        return false;
+      }
+      if (*Pos == '\n')
+        ++Line;
+      if (*Pos++ != Quote)
+        continue;
+      // A doubled quote is an escaped one in a string literal
+      if (Quote == '"' && Pos != End && *Pos == '"') {
+        ++Pos;
+        continue;
+      }
+      break;
+    }
+    if (Quote == '|')
+      S.Atom.assign(Begin + 1, Pos - 1);
+    else
+      S.Atom.assign(Begin, Pos);
+    return true;
+  }
+
+  const char *Begin = Pos;
+  while (Pos != End && isSymbolChar(*Pos))
+    ++Pos;
+  S.Atom.assign(Begin, Pos);
+  return true;
+}
+
+bool SMTLIB2Parser::ReadCommand(SExpr &Command) {
+  while (SkipBlanks()) {
+    Command = SExpr();
+    if (!ReadSExpr(Command))
+      continue;
+    if (Command.IsList && !Command.Kids.empty() && !Command.Kids[0].IsList)
+      return true;
+    Error(Command.Line, "invalid command");
+  }
+  return false;
+}
+
+void SMTLIB2Parser::Reset() {
+  Variables.clear();
+  Definitions.clear();
+  Bindings.clear();
+  MaxIndex.clear();
+  Scopes.clear();
+  Scopes.resize(1);
+}
+
+// Sorts and indices
+
+bool SMTLIB2Parser::ParseNumeral(const SExpr &S, uint64_t &Value) {
+  if (S.IsList || S.Atom.empty() ||
+      S.Atom.find_first_not_of("0123456789") != std::string::npos ||
+      StringRef(S.Atom).getAsInteger(10, Value)) {
+    Error(S.Line, "invalid numeral");
+    return false;
+  }
+  return true;
+}
+
+/// Whether the S-expression is (_ Name Index), with the numeral Index
+static bool isIndexed(const SExpr &S, const char *Name) {
+  return S.IsList && S.Kids.size() == 3 && S.Kids[0].isAtom("_") &&
+         S.Kids[1].isAtom(Name) && !S.Kids[2].IsList;
+}
+
+bool SMTLIB2Parser::ParseSort(const SExpr &S, Sort &Result) {
+  uint64_t Width;
+  if (S.isAtom("Bool")) {
+    Result.K = Sort::Bool;
+    Result.Width = 1;
+    return true;
+  }
+  if (isIndexed(S, "BitVec")) {
+    if (!ParseNumeral(S.Kids[2], Width))
+      return false;
+    if (!Width || Width > (1 << 24)) {
+      Error(S.Line, "invalid bit-vector width");
+      return false;
+    }
+    Result.K = Sort::BitVec;
+    Result.Width = (unsigned)Width;
+    return true;
+  }
+  if (S.IsList && S.Kids.size() == 3 && S.Kids[0].isAtom("Array")) {
+    Sort Domain, Range;
+    if (!ParseSort(S.Kids[1], Domain) || !ParseSort(S.Kids[2], Range))
+      return false;
+    if (Domain.K != Sort::BitVec || Range.K != Sort::BitVec ||
+        Domain.Width > 64 || Range.Width > 64) {
+      Error(S.Line, "unsupported array sort");
+      return false;
+    }
+    Result.K = Sort::ArrayOf;
+    Result.Domain = Domain.Width;
+    Result.Range = Range.Width;
+    return true;
+  }
+  Error(S.Line, "unsupported sort");
+  return false;
+}
+
+/// Parse the value of a bit-vector literal, #b..., #x... or (_ bvN w)
+static bool parseLiteral(const SExpr &S, APInt &Value) {
+  if (S.IsList) {
+    if (S.Kids.size() != 3 || !S.Kids[0].isAtom("_") || S.Kids[1].IsList ||
+        S.Kids[1].Atom.compare(0, 2, "bv") || S.Kids[2].IsList)
+      return false;
+    StringRef Digits = StringRef(S.Kids[1].Atom).substr(2);
+    uint64_t Width;
+    if (Digits.empty() ||
+        Digits.find_first_not_of("0123456789") != StringRef::npos ||
+        StringRef(S.Kids[2].Atom).getAsInteger(10, Width) || !Width ||
+        Width > (1 << 24))
+      return false;
+    // The numeral may need more bits than the width, and is reduced modulo
+    // 2^width
+    unsigned Bits = std::max((unsigned)Width, 4 * (unsigned)Digits.size());
+    Value = APInt(Bits, Digits, 10).trunc((unsigned)Width);
+    return true;
+  }
+
+  if (S.Atom.size() < 3 || S.Atom[0] != '#')
+    return false;
+  StringRef Digits = StringRef(S.Atom).substr(2);
+  if (S.Atom[1] == 'b' &&
+      Digits.find_first_not_of("01") == StringRef::npos) {
+    Value = APInt(Digits.size(), Digits, 2);
+    return true;
+  }
+  if (S.Atom[1] == 'x' &&
+      Digits.find_first_not_of("0123456789abcdefABCDEF") == StringRef::npos) {
+    Value = APInt(4 * Digits.size(), Digits, 16);
+    return true;
+  }
+  return false;
+}
+
+void SMTLIB2Parser::ScanIndices(const SExpr &S) {
+  if (!S.IsList)
+    return;
+  if (S.Kids.size() == 3 && S.Kids[0].isAtom("select") && !S.Kids[1].IsList) {
+    APInt Index;
+    if (parseLiteral(S.Kids[2], Index) && Index.getActiveBits() <= 64 &&
+        Index.getZExtValue() < MaxArraySize) {
+      uint64_t &Max = MaxIndex[S.Kids[1].Atom];
+      Max = std::max(Max, Index.getZExtValue());
+    }
+  }
+  for (std::vector<SExpr>::const_iterator it = S.Kids.begin(),
+                                          ie = S.Kids.end();
+       it != ie; ++it)
+    ScanIndices(*it);
+}
+
+// Terms
+
+const Array *SMTLIB2Parser::GetArray(const std::string &Name, Variable &V) {
+  if (V.Root)
+    return V.Root;
+
+  switch (V.S.K) {
+  case Sort::Bool:
+    V.Root = TheArrayCache.CreateArray(Name, 1);
+    break;
+  case Sort::BitVec:
+    V.Root = TheArrayCache.CreateArray(Name, (V.S.Width + 7) / 8);
+    break;
+  case Sort::ArrayOf: {
+    std::map<std::string, uint64_t>::iterator it = MaxIndex.find(Name);
+    uint64_t Size = it == MaxIndex.end() ? 1 : it->second + 1;
+    V.Root = TheArrayCache.CreateArray(Name, Size, 0, 0, V.S.Domain,
+                                       V.S.Range);
+    break;
+  }
+  }
+  return V.Root;
+}
+
+bool SMTLIB2Parser::TranslateSymbol(const SExpr &S, Term &T) {
+  if (S.Atom == "true" || S.Atom == "false") {
+    T = Term(S.Atom == "true" ? Builder->True() : Builder->False());
+    return true;
+  }
+
+  APInt Value;
+  if (parseLiteral(S, Value)) {
+    T = Term(Builder->Constant(Value));
+    return true;
+  }
+
+  std::map<std::string, Term>::iterator bit = Bindings.find(S.Atom);
+  if (bit != Bindings.end()) {
+    T = bit->second;
+    return true;
+  }
+
+  std::map<std::string, Definition>::iterator dit = Definitions.find(S.Atom);
+  if (dit != Definitions.end()) {
+    Definition &D = dit->second;
+    if (!D.Translated) {
+      // The body of a definition does not see the bindings of its use
+      std::map<std::string, Term> Outer;
+      Outer.swap(Bindings);
+      bool Success = Translate(D.Body, D.Value);
+      Bindings.swap(Outer);
+      if (!Success)
+        return false;
+      D.Translated = true;
+    }
+    T = D.Value;
+    return true;
+  }
+
+  std::map<std::string, Variable>::iterator vit = Variables.find(S.Atom);
+  if (vit == Variables.end()) {
+    Error(S.Line, "unknown symbol '" + S.Atom + "'");
+    return false;
+  }
+
+  Variable &V = vit->second;
+  if (V.Value.E.isNull() && !V.Value.isArray()) {
+    const Array *Root = GetArray(S.Atom, V);
+    if (V.S.K == Sort::ArrayOf) {
+      V.Value = Term(UpdateList(Root, 0));
+    } else {
+      UpdateList UL(Root, 0);
+      ref<Expr> E = Builder->Read(UL, Builder->Constant(0, Expr::Int32));
+      for (unsigned i = 1; i < Root->size; ++i)
+        E = Builder->Concat(
+            Builder->Read(UL, Builder->Constant(i, Expr::Int32)), E);
+      if (E->getWidth() != V.S.Width)
+        E = Builder->Extract(E, 0, V.S.Width);
+      V.Value = Term(E);
+    }
+  }
+  T = V.Value;
+  return true;
+}
+
+bool SMTLIB2Parser::TranslateLet(const SExpr &S, Term &T) {
+  if (S.Kids.size() != 3 || !S.Kids[1].IsList) {
+    Error(S.Line, "invalid let");
+    return false;
+  }
+
+  // The bindings are parallel, each term seeing only the outer bindings
+  const std::vector<SExpr> &Pairs = S.Kids[1].Kids;
+  std::vector<Term> Values(Pairs.size());
+  for (unsigned i = 0; i < Pairs.size(); ++i) {
+    if (!Pairs[i].IsList || Pairs[i].Kids.size() != 2 ||
+        Pairs[i].Kids[0].IsList) {
+      Error(Pairs[i].Line, "invalid let binding");
+      return false;
+    }
+    if (!Translate(Pairs[i].Kids[1], Values[i]))
+      return false;
+  }
+
+  std::vector<std::pair<std::string, Term> > Shadowed;
+  std::vector<std::string> Added;
+  for (unsigned i = 0; i < Pairs.size(); ++i) {
+    const std::string &Name = Pairs[i].Kids[0].Atom;
+    std::map<std::string, Term>::iterator it = Bindings.find(Name);
+    if (it != Bindings.end()) {
+      Shadowed.push_back(*it);
+      it->second = Values[i];
+    } else {
+      Added.push_back(Name);
+      Bindings.insert(std::make_pair(Name, Values[i]));
+    }
+  }
+
+  bool Success = Translate(S.Kids[2], T);
+
+  for (std::vector<std::string>::iterator it = Added.begin(),
+                                          ie = Added.end();
+       it != ie; ++it)
+    Bindings.erase(*it);
+  for (std::vector<std::pair<std::string, Term> >::iterator
+           it = Shadowed.begin(),
+           ie = Shadowed.end();
+       it != ie; ++it)
+    Bindings.find(it->first)->second = it->second;
+  return Success;
+}
+
+bool SMTLIB2Parser::TranslateIndexed(const SExpr &Head,
+                                     const std::vector<Term> &Args, Term &T) {
+  const std::vector<SExpr> &Kids = Head.Kids;
+  if (Kids.size() < 3 || !Kids[0].isAtom("_") || Kids[1].IsList) {
+    Error(Head.Line, "unsupported function");
+    return false;
+  }
+  if (Args.size() != 1 || Args[0].isArray()) {
+    Error(Head.Line, "invalid arguments of '" + Kids[1].Atom + "'");
+    return false;
+  }
+
+  const std::string &Name = Kids[1].Atom;
+  ref<Expr> E = Args[0].E;
+  unsigned Width = E->getWidth();
+  std::vector<uint64_t> Indices(Kids.size() - 2);
+  for (unsigned i = 0; i < Indices.size(); ++i)
+    if (!ParseNumeral(Kids[i + 2], Indices[i]))
+      return false;
+
+  if (Name == "extract" && Indices.size() == 2) {
+    if (Indices[0] < Indices[1] || Indices[0] >= Width) {
+      Error(Head.Line, "invalid extract");
+      return false;
+    }
+    T = Term(Builder->Extract(E, (unsigned)Indices[1],
+                              (unsigned)(Indices[0] - Indices[1] + 1)));
+    return true;
+  }
+
+  if (Indices.size() != 1 || Indices[0] > (1 << 24)) {
+    Error(Head.Line, "unsupported function '" + Name + "'");
+    return false;
+  }
+  unsigned K = (unsigned)Indices[0];
+
+  if (Name == "zero_extend" || Name == "sign_extend") {
+    if (K)
+      E = Name == "zero_extend" ? Builder->ZExt(E, Width + K)
+                                : Builder->SExt(E, Width + K);
+  } else if (Name == "repeat") {
+    if (!K) {
+      Error(Head.Line, "invalid repeat");
+      return false;
+    }
+    ref<Expr> Result = E;
+    for (unsigned i = 1; i < K; ++i)
+      Result = Builder->Concat(Result, E);
+    E = Result;
+  } else if (Name == "rotate_left" || Name == "rotate_right") {
+    unsigned Shift = K % Width;
+    if (Name == "rotate_right" && Shift)
+      Shift = Width - Shift;
+    // The high bits of the rotation are the low bits of the argument
+    if (Shift)
+      E = Builder->Concat(Builder->Extract(E, 0, Width - Shift),
+                          Builder->Extract(E, Width - Shift, Shift));
+  } else {
+    Error(Head.Line, "unsupported function '" + Name + "'");
+    return false;
+  }
+  T = Term(E);
+  return true;
+}
+
+namespace {
+typedef ref<Expr> (ExprBuilder::*BinaryBuilder)(const ref<Expr> &,
+                                                const ref<Expr> &);
+
+/// BinaryOp - A binary function of the script, with the builder of its
+/// expression, and whether it chains and its arguments are Boolean.
+struct BinaryOp {
+  const char *Name;
+  BinaryBuilder Build;
+  /// Whether more than two arguments are folded from the left
+  bool LeftAssoc;
+};
+
+const BinaryOp BinaryOps[] = {
+  { "bvadd", &ExprBuilder::Add, true },
+  { "bvsub", &ExprBuilder::Sub, false },
+  { "bvmul", &ExprBuilder::Mul, true },
+  { "bvudiv", &ExprBuilder::UDiv, false },
+  { "bvsdiv", &ExprBuilder::SDiv, false },
+  { "bvurem", &ExprBuilder::URem, false },
+  { "bvsrem", &ExprBuilder::SRem, false },
+  { "bvand", &ExprBuilder::And, true },
+  { "bvor", &ExprBuilder::Or, true },
+  { "bvxor", &ExprBuilder::Xor, true },
+  { "bvshl", &ExprBuilder::Shl, false },
+  { "bvlshr", &ExprBuilder::LShr, false },
+  { "bvashr", &ExprBuilder::AShr, false },
+  { "bvult", &ExprBuilder::Ult, false },
+  { "bvule", &ExprBuilder::Ule, false },
+  { "bvugt", &ExprBuilder::Ugt, false },
+  { "bvuge", &ExprBuilder::Uge, false },
+  { "bvslt", &ExprBuilder::Slt, false },
+  { "bvsle", &ExprBuilder::Sle, false },
+  { "bvsgt", &ExprBuilder::Sgt, false },
+  { "bvsge", &ExprBuilder::Sge, false },
+  { "bvcomp", &ExprBuilder::Eq, false },
+  { "and", &ExprBuilder::And, true },
+  { "or", &ExprBuilder::Or, true },
+  { "xor", &ExprBuilder::Xor, true }
+};
+}
+
+bool SMTLIB2Parser::TranslateApp(const SExpr &S, Term &T) {
+  const SExpr &Head = S.Kids[0];
+  if (Head.isAtom("let"))
+    return TranslateLet(S, T);
+
+  if (Head.isAtom("!")) {
+    if (S.Kids.size() < 2 || !Translate(S.Kids[1], T))
+      return false;
+    for (unsigned i = 2; i + 1 < S.Kids.size(); i += 2) {
+      if (S.Kids[i].isAtom(":named") && !S.Kids[i + 1].IsList) {
+        Definition &D = Definitions[S.Kids[i + 1].Atom];
+        D.Translated = true;
+        D.Value = T;
+        Scopes.back().Names.push_back(S.Kids[i + 1].Atom);
+      }
+    }
+    return true;
+  }
+
+  std::vector<Term> Args(S.Kids.size() - 1);
+  for (unsigned i = 1; i < S.Kids.size(); ++i)
+    if (!Translate(S.Kids[i], Args[i - 1]))
+      return false;
+
+  if (Head.IsList)
+    return TranslateIndexed(Head, Args, T);
+
+  const std::string &Name = Head.Atom;
+
+  // The array functions
+  if (Name == "select" || Name == "store") {
+    unsigned Arity = Name == "select" ? 2 : 3;
+    if (Args.size() != Arity || !Args[0].isArray() || Args[1].isArray() ||
+        Args[1].E->getWidth() != Args[0].Updates.root->getDomain() ||
+        (Arity == 3 && (Args[2].isArray() ||
+                        Args[2].E->getWidth() !=
+                            Args[0].Updates.root->getRange()))) {
+      Error(S.Line, "invalid arguments of '" + Name + "'");
+      return false;
+    }
+    if (Arity == 2) {
+      T = Term(Builder->Read(Args[0].Updates, Args[1].E));
+    } else {
+      UpdateList UL = Args[0].Updates;
+      UL.extend(Args[1].E, Args[2].E);
+      T = Term(UL);
+    }
+    return true;
+  }
+
+  for (std::vector<Term>::iterator it = Args.begin(), ie = Args.end();
+       it != ie; ++it) {
+    if (it->isArray()) {
+      Error(S.Line, "unsupported array argument of '" + Name + "'");
+      return false;
+    }
+  }
+
+  if (Name == "not" || Name == "bvnot" || Name == "bvneg") {
+    if (Args.size() != 1) {
+      Error(S.Line, "invalid arguments of '" + Name + "'");
+      return false;
+    }
+    if (Name == "bvneg")
+      T = Term(Builder->Sub(Builder->Constant(0, Args[0].E->getWidth()),
+                            Args[0].E));
+    else
+      T = Term(Builder->Not(Args[0].E));
+    return true;
+  }
+
+  if (Name == "ite") {
+    if (Args.size() != 3 || Args[0].E->getWidth() != Expr::Bool ||
+        Args[1].E->getWidth() != Args[2].E->getWidth()) {
+      Error(S.Line, "invalid arguments of 'ite'");
+      return false;
+    }
+    T = Term(Builder->Select(Args[0].E, Args[1].E, Args[2].E));
+    return true;
+  }
+
+  if (Args.size() < 2) {
+    Error(S.Line, "invalid arguments of '" + Name + "'");
+    return false;
+  }
+  for (unsigned i = 1; i < Args.size(); ++i) {
+    if (Name != "concat" &&
+        Args[i].E->getWidth() != Args[0].E->getWidth()) {
+      Error(S.Line, "invalid argument widths of '" + Name + "'");
+      return false;
+    }
+  }
+
+  if (Name == "concat") {
+    ref<Expr> E = Args[0].E;
+    for (unsigned i = 1; i < Args.size(); ++i)
+      E = Builder->Concat(E, Args[i].E);
+    T = Term(E);
+    return true;
+  }
+
+  if (Name == "=" || Name == "distinct") {
+    // The chain of equalities, or the pairwise disequalities
+    ref<Expr> E;
+    for (unsigned i = 0; i + 1 < Args.size(); ++i) {
+      for (unsigned j = i + 1; j < Args.size(); ++j) {
+        ref<Expr> Pair = Name == "=" ? Builder->Eq(Args[i].E, Args[j].E)
+                                     : Builder->Ne(Args[i].E, Args[j].E);
+        E = E.isNull() ? Pair : Builder->And(E, Pair);
+        if (Name == "=")
+          break;
+      }
+    }
+    T = Term(E);
+    return true;
+  }
+
+  if (Name == "=>") {
+    ref<Expr> E = Args.back().E;
+    for (unsigned i = Args.size() - 1; i != 0; --i)
+      E = Builder->Or(Builder->Not(Args[i - 1].E), E);
+    T = Term(E);
+    return true;
+  }
+
+  if (Args.size() == 2 && (Name == "bvnand" || Name == "bvnor" ||
+                           Name == "bvxnor")) {
+    ref<Expr> E = Name == "bvnand" ? Builder->And(Args[0].E, Args[1].E)
+                  : Name == "bvnor" ? Builder->Or(Args[0].E, Args[1].E)
+                                    : Builder->Xor(Args[0].E, Args[1].E);
+    T = Term(Builder->Not(E));
+    return true;
+  }
+
+  if (Args.size() == 2 && Name == "bvsmod") {
+    // The remainder takes the sign of the divisor
+    ref<Expr> A = Args[0].E, B = Args[1].E;
+    ref<Expr> Zero = Builder->Constant(0, A->getWidth());
+    ref<Expr> R = Builder->SRem(A, B);
+    ref<Expr> Same =
+        Builder->Or(Builder->Eq(R, Zero),
+                    Builder->Eq(Builder->Slt(A, Zero), Builder->Slt(B, Zero)));
+    T = Term(Builder->Select(Same, R, Builder->Add(R, B)));
+    return true;
+  }
+
+  for (unsigned i = 0; i < sizeof(BinaryOps) / sizeof(BinaryOps[0]); ++i) {
+    const BinaryOp &Op = BinaryOps[i];
+    if (Name != Op.Name)
+      continue;
+    if (Args.size() > 2 && !Op.LeftAssoc)
+      break;
+    ref<Expr> E = Args[0].E;
+    for (unsigned j = 1; j < Args.size(); ++j)
+      E = (Builder->*Op.Build)(E, Args[j].E);
+    T = Term(E);
+    return true;
+  }
+
+  Error(S.Line, "unsupported function '" + Name + "'");
+  return false;
+}
+
+bool SMTLIB2Parser::Translate(const SExpr &S, Term &T) {
+  if (!S.IsList)
+    return TranslateSymbol(S, T);
+  if (S.Kids.empty()) {
+    Error(S.Line, "invalid term");
+    return false;
+  }
+  if (S.Kids[0].isAtom("_")) {
+    APInt Value;
+    if (!parseLiteral(S, Value)) {
+      Error(S.Line, "unsupported indexed term");
+      return false;
+    }
+    T = Term(Builder->Constant(Value));
+    return true;
+  }
+  return TranslateApp(S, T);
+}
+
+bool SMTLIB2Parser::TranslateExpr(const SExpr &S, ref<Expr> &E) {
+  Term T;
+  if (!Translate(S, T))
+    return false;
+  if (T.isArray()) {
+    Error(S.Line, "unexpected array term");
+    return false;
+  }
+  E = T.E;
+  return true;
+}
+
+// Commands
+
+void SMTLIB2Parser::CollectObjects(const SExpr &S,
+                                   std::vector<const Array *> &Objects,
+                                   std::set<const Array *> &Seen) {
+  if (S.IsList) {
+    for (std::vector<SExpr>::const_iterator it = S.Kids.begin(),
+                                            ie = S.Kids.end();
+         it != ie; ++it)
+      CollectObjects(*it, Objects, Seen);
+    return;
+  }
+  std::map<std::string, Variable>::iterator it = Variables.find(S.Atom);
+  if (it != Variables.end() && !Bindings.count(S.Atom)) {
+    const Array *Root = GetArray(S.Atom, it->second);
+    if (Seen.insert(Root).second)
+      Objects.push_back(Root);
+  }
+}
+
+QueryCommand *SMTLIB2Parser::CheckSat(const std::vector<SExpr> &Assumptions) {
+  // The variables of the (get-value) commands following the (check-sat) are
+  // the objects of the query
+  std::vector<SExpr> Values;
+  for (;;) {
+    const char *Saved = Pos;
+    unsigned SavedLine = Line;
+    SExpr Command;
+    if (!ReadCommand(Command) || !Command.Kids[0].isAtom("get-value")) {
+      Pos = Saved;
+      Line = SavedLine;
+      break;
+    }
+    ScanIndices(Command);
+    Values.push_back(Command);
+  }
+
+  bool Success = true;
+  std::vector<ExprHandle> Constraints;
+  for (std::vector<Scope>::iterator it = Scopes.begin(), ie = Scopes.end();
+       it != ie; ++it) {
+    // The assertions failing to translate fail the later queries too
+    std::vector<SExpr> Failed;
+    for (std::vector<SExpr>::iterator pit = it->Pending.begin(),
+                                      pie = it->Pending.end();
+         pit != pie; ++pit) {
+      ref<Expr> E;
+      if (TranslateExpr(*pit, E) && E->getWidth() == Expr::Bool) {
+        it->Assertions.push_back(E);
+      } else {
+        if (!E.isNull())
+          Error(pit->Line, "non-Boolean assertion");
+        Failed.push_back(*pit);
+        Success = false;
+      }
+    }
+    it->Pending.swap(Failed);
+    Constraints.insert(Constraints.end(), it->Assertions.begin(),
+                       it->Assertions.end());
+  }
+
+  for (std::vector<SExpr>::const_iterator it = Assumptions.begin(),
+                                          ie = Assumptions.end();
+       it != ie; ++it) {
+    ref<Expr> E;
+    if (TranslateExpr(*it, E) && E->getWidth() == Expr::Bool)
+      Constraints.push_back(E);
+    else
+      Success = false;
+  }
+
+  std::vector<const Array *> Objects;
+  std::set<const Array *> Seen;
+  for (std::vector<SExpr>::iterator it = Values.begin(), ie = Values.end();
+       it != ie; ++it)
+    CollectObjects(*it, Objects, Seen);
+
+  if (!Success)
+    return 0;
+  return new QueryCommand(Constraints, Builder->False(),
+                          std::vector<ExprHandle>(), Objects);
+}
+
+QueryCommand *SMTLIB2Parser::ParseCommand(const SExpr &Command) {
+  const std::string &Name = Command.Kids[0].Atom;
+  const std::vector<SExpr> &Kids = Command.Kids;
+
+  if (Name == "set-logic" || Name == "set-option" || Name == "set-info" ||
+      Name == "get-info" || Name == "get-option" || Name == "get-model" ||
+      Name == "get-assignment" || Name == "get-unsat-core" ||
+      Name == "get-proof" || Name == "get-value" || Name == "echo")
+    return 0;
+
+  if (Name == "declare-fun" || Name == "declare-const") {
+    bool IsFun = Name == "declare-fun";
+    if (Kids.size() != (IsFun ? 4u : 3u) || Kids[1].IsList ||
+        (IsFun && (!Kids[2].IsList || !Kids[2].Kids.empty()))) {
+      Error(Command.Line, "unsupported declaration");
+      return 0;
+    }
+    Variable V;
+    if (!ParseSort(Kids.back(), V.S))
+      return 0;
+    Variables[Kids[1].Atom] = V;
+    Definitions.erase(Kids[1].Atom);
+    Scopes.back().Names.push_back(Kids[1].Atom);
+    return 0;
+  }
+
+  if (Name == "define-fun") {
+    Sort S;
+    if (Kids.size() != 5 || Kids[1].IsList || !Kids[2].IsList ||
+        !Kids[2].Kids.empty()) {
+      Error(Command.Line, "unsupported definition");
+      return 0;
+    }
+    if (!ParseSort(Kids[3], S))
+      return 0;
+    ScanIndices(Kids[4]);
+    Definition &D = Definitions[Kids[1].Atom];
+    D = Definition();
+    D.Body = Kids[4];
+    Variables.erase(Kids[1].Atom);
+    Scopes.back().Names.push_back(Kids[1].Atom);
+    return 0;
+  }
+
+  if (Name == "assert") {
+    if (Kids.size() != 2) {
+      Error(Command.Line, "invalid assertion");
+      return 0;
+    }
+    ScanIndices(Kids[1]);
+    Scopes.back().Pending.push_back(Kids[1]);
+    return 0;
+  }
+
+  if (Name == "check-sat")
+    return CheckSat(std::vector<SExpr>());
+
+  if (Name == "check-sat-assuming") {
+    if (Kids.size() != 2 || !Kids[1].IsList) {
+      Error(Command.Line, "invalid check-sat-assuming");
+      return 0;
+    }
+    ScanIndices(Kids[1]);
+    return CheckSat(Kids[1].Kids);
+  }
+
+  if (Name == "push" || Name == "pop") {
+    uint64_t N = 1;
+    if (Kids.size() > 2 || (Kids.size() == 2 && !ParseNumeral(Kids[1], N)))
+      return 0;
+    if (Name == "push") {
+      Scopes.resize(Scopes.size() + N);
+      return 0;
+    }
+    if (N >= Scopes.size()) {
+      Error(Command.Line, "pop of more levels than pushed");
+      N = Scopes.size() - 1;
+    }
+    for (; N; --N) {
+      std::vector<std::string> &Names = Scopes.back().Names;
+      for (std::vector<std::string>::iterator it = Names.begin(),
+                                              ie = Names.end();
+           it != ie; ++it) {
+        Variables.erase(*it);
+        Definitions.erase(*it);
+      }
+      Scopes.pop_back();
+    }
+    return 0;
+  }
+
+  if (Name == "reset-assertions") {
+    for (std::vector<Scope>::iterator it = Scopes.begin(), ie = Scopes.end();
+         it != ie; ++it) {
+      it->Pending.clear();
+      it->Assertions.clear();
+    }
+    return 0;
+  }
+
+  if (Name == "exit" || Name == "reset") {
+    // Each query of the SMT-LIB query logs ends with an (exit)
+    Reset();
+    return 0;
+  }
+
+  Error(Command.Line, "unsupported command '" + Name + "'");
+  return 0;
+}
+
+Decl *SMTLIB2Parser::ParseTopLevelDecl() {
+  SExpr Command;
+  while (ReadCommand(Command)) {
+    if (QueryCommand *QC = ParseCommand(Command))
+      return QC;
+  }
+  return 0;
+}
+
+// Public interface
+
+bool klee::expr::isSMTLIB2Script(const std::string &Filename,
+                                 const MemoryBuffer *MB) {
+  if (StringRef(Filename).endswith(".smt2"))
+    return true;
+
+  // The first command, past the blanks and the comments
+  const char *Pos = MB->getBufferStart(), *End = MB->getBufferEnd();
+  for (;;) {
+    while (Pos != End && isspace((unsigned char)*Pos))
+      ++Pos;
+    if (Pos == End || *Pos != ';')
+      break;
+    while (Pos != End && *Pos != '\n')
+      ++Pos;
+  }
+  if (Pos == End || *Pos++ != '(')
+    return false;
+  while (Pos != End && isspace((unsigned char)*Pos))
+    ++Pos;
+  const char *Begin = Pos;
+  while (Pos != End && isSymbolChar(*Pos))
+    ++Pos;
+
+  static const char *const Commands[] = {
+    "set-logic", "set-option",  "set-info", "declare-fun",
+    "declare-const", "define-fun", "assert", "push"
+  };
+  StringRef First(Begin, Pos - Begin);
+  for (unsigned i = 0; i < sizeof(Commands) / sizeof(Commands[0]); ++i)
+    if (First == Commands[i])
+      return true;
+  return false;
+}
+
+Parser *klee::expr::createSMTLIB2Parser(const std::string &Filename,
+                                        const MemoryBuffer *MB,
+                                        ExprBuilder *Builder) {
+  return new SMTLIB2Parser(Filename, MB, Builder);
+}
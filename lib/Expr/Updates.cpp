@@ -8,8 +8,10 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
 
 #include <cassert>
+#include <vector>
 
 using namespace klee;
 
@@ -19,6 +21,7 @@ UpdateNode::UpdateNode(const UpdateNode *_next,
                        const ref<Expr> &_index, 
                        const ref<Expr> &_value) 
   : refCount(0),    
+    constantIndex(0),
     next(_next),
     index(_index),
     value(_value) {
@@ -44,6 +47,57 @@ extern "C" void vc_DeleteExpr(void*);
 // non-recursively.
 UpdateNode::~UpdateNode() {
     assert(refCount == 0 && "Deleted UpdateNode when a reference is still held");
+    delete constantIndex;
+}
+
+struct UpdateNode::ConstantIndex {
+  /// The latest update at each constant index
+  ImmutableMap<uint64_t, const UpdateNode *> updates;
+  /// The first update at a symbolic index, or null
+  const UpdateNode *rest;
+};
+
+static bool hasConstantIndex(const UpdateNode *un) {
+  const ConstantExpr *CE = dyn_cast<ConstantExpr>(un->index);
+  return CE && CE->getWidth() <= 64;
+}
+
+const UpdateNode::ConstantIndex *UpdateNode::getConstantIndex() const {
+  if (constantIndex)
+    return constantIndex;
+
+  // Only the updates above the closest indexed one are added, so that
+  // indexing the successive heads of a growing sequence takes logarithmic
+  // time per update, with the maps sharing their structure.
+  std::vector<const UpdateNode *> pending;
+  const UpdateNode *un = this;
+  for (; un && !un->constantIndex && hasConstantIndex(un); un = un->next)
+    pending.push_back(un);
+
+  ConstantIndex *res = new ConstantIndex();
+  if (un && un->constantIndex) {
+    *res = *un->constantIndex;
+  } else {
+    res->rest = un;
+  }
+  for (std::vector<const UpdateNode *>::reverse_iterator it = pending.rbegin(),
+                                                         ie = pending.rend();
+       it != ie; ++it)
+    res->updates = res->updates.replace(std::make_pair(
+        cast<ConstantExpr>((*it)->index)->getZExtValue(), *it));
+
+  constantIndex = res;
+  return res;
+}
+
+const UpdateNode *UpdateNode::lookupConstantIndex(uint64_t index,
+                                                  const UpdateNode *&rest) const {
+  const ConstantIndex *ci = getConstantIndex();
+  rest = ci->rest;
+  if (const std::pair<uint64_t, const UpdateNode *> *res =
+          ci->updates.lookup(index))
+    return res->second;
+  return 0;
 }
 
 int UpdateNode::compare(const UpdateNode &b) const {
@@ -52,10 +106,11 @@ int UpdateNode::compare(const UpdateNode &b) const {
   return value.compare(b.value);
 }
 
-unsigned UpdateNode::computeHash() {
-  hashValue = index->hash() ^ value->hash();
-  if (next)
-    hashValue ^= next->hash();
+uint64_t UpdateNode::computeHash() {
+  // The hash of the next updates is cached in their node, such that the hash
+  // of a sequence is computed once per update
+  uint64_t res = Expr::combineHash(next ? next->hash() : 0, index->hash());
+  hashValue = Expr::combineHash(res, value->hash());
   return hashValue;
 }
 
@@ -182,11 +237,6 @@ int UpdateList::compare(const UpdateList &b) const {
   return 0;
 }
 
-unsigned UpdateList::hash() const {
-  unsigned res = 0;
-  for (unsigned i = 0, e = root->name.size(); i != e; ++i)
-    res = (res * Expr::MAGIC_HASH_CONSTANT) + root->name[i];
-  if (head)
-    res ^= head->hash();
-  return res;
+uint64_t UpdateList::hash() const {
+  return Expr::combineHash(root->hash(), head ? head->hash() : 0);
 }
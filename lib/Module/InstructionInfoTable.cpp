@@ -60,31 +60,99 @@ public:
     os << (uintptr_t) i;
   }
 };
-        
-static void buildInstructionToLineMap(Module *m,
-                                      std::map<const Instruction*, unsigned> &out) {  
-  InstructionToLineAnnotator a;
-  std::string str;
-  llvm::raw_string_ostream os(str);
-  m->print(os, &a);
-  os.flush();
-  const char *s;
-
-  unsigned line = 1;
-  for (s=str.c_str(); *s; s++) {
-    if (*s=='\n') {
-      line++;
-      if (s[1]=='%' && s[2]=='%' && s[3]=='%') {
-        s += 4;
-        char *end;
-        unsigned long long value = strtoull(s, &end, 10);
-        if (end!=s) {
-          out.insert(std::make_pair((const Instruction*) value, line));
+
+/// A stream for the annotated print of a module, which records the line of
+/// each annotated instruction as the print is written, and forwards the
+/// print without the annotations. The print of the module is never held in
+/// memory.
+class AssemblyLineStream : public llvm::raw_ostream {
+  enum State { LineStart, Annotation, Body };
+
+  llvm::raw_ostream &out;
+  bool truncateLines;
+  llvm::DenseMap<const Instruction *, unsigned> &lines;
+
+  State state;
+  /// The number of '%' seen at the start of the line
+  unsigned percents;
+  uintptr_t value;
+  unsigned line;
+  unsigned column;
+  uint64_t pos;
+
+  void writeBody(char c) {
+    if (c == '\n') {
+      out << c;
+      ++line;
+      column = 0;
+      state = LineStart;
+      percents = 0;
+      return;
+    }
+    // Keep the first 254 characters of the long lines, as kcachegrind
+    // puts them on new lines otherwise
+    if (!truncateLines || column < 254)
+      out << c;
+    ++column;
+  }
+
+  void write_impl(const char *ptr, size_t size) {
+    pos += size;
+    for (const char *p = ptr, *e = ptr + size; p != e; ++p) {
+      char c = *p;
+      switch (state) {
+      case LineStart:
+        if (c == '%' && percents < 3) {
+          if (++percents == 3) {
+            state = Annotation;
+            value = 0;
+          }
+          continue;
+        }
+        // Not an annotation, forward the '%' held back
+        state = Body;
+        for (; percents; --percents)
+          writeBody('%');
+        writeBody(c);
+        break;
+      case Annotation:
+        if (c >= '0' && c <= '9') {
+          value = value * 10 + (c - '0');
+          continue;
         }
-        s = end;
+        if (value)
+          lines[(const Instruction *)value] = line;
+        state = Body;
+        writeBody(c);
+        break;
+      case Body:
+        writeBody(c);
+        break;
       }
     }
   }
+
+  uint64_t current_pos() const { return pos; }
+
+public:
+  AssemblyLineStream(llvm::raw_ostream &_out, bool _truncateLines,
+                     llvm::DenseMap<const Instruction *, unsigned> &_lines)
+      : out(_out), truncateLines(_truncateLines), lines(_lines),
+        state(LineStart), percents(0), value(0), line(1), column(0), pos(0) {}
+
+  ~AssemblyLineStream() {
+    flush();
+    for (; percents && state == LineStart; --percents)
+      out << '%';
+  }
+};
+
+/// Print a module into a stream, and get the lines of its instructions
+static void printModule(Module *m, llvm::raw_ostream &os, bool truncateLines,
+                        llvm::DenseMap<const Instruction *, unsigned> &out) {
+  InstructionToLineAnnotator a;
+  AssemblyLineStream stream(os, truncateLines, out);
+  m->print(stream, &a);
 }
 
 static std::string getDSPIPath(DILocation Loc) {
@@ -112,11 +180,25 @@ bool InstructionInfoTable::getInstructionDebugInfo(const llvm::Instruction *I,
   return false;
 }
 
-InstructionInfoTable::InstructionInfoTable(Module *m) 
+InstructionInfoTable::InstructionInfoTable(Module *m,
+                                           llvm::raw_ostream *assemblyOutput,
+                                           bool truncateLines)
   : dummyString(""), dummyInfo(0, dummyString, 0, 0) {
   unsigned id = 0;
-  std::map<const Instruction*, unsigned> lineTable;
-  buildInstructionToLineMap(m, lineTable);
+  llvm::DenseMap<const Instruction *, unsigned> lineTable;
+  if (assemblyOutput)
+    printModule(m, *assemblyOutput, truncateLines, lineTable);
+
+  unsigned numInstructions = 0;
+  for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
+       fnIt != fn_ie; ++fnIt) {
+    for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end();
+         bbIt != bb_ie; ++bbIt)
+      numInstructions += bbIt->size();
+  }
+  // The infos are not moved once built, as the KInstructions point to them
+  infos.reserve(numInstructions);
+  ids.reserve(numInstructions);
 
   for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
        fnIt != fn_ie; ++fnIt) {
@@ -139,14 +221,13 @@ InstructionInfoTable::InstructionInfoTable(Module *m)
     for (inst_iterator it = inst_begin(fnIt), ie = inst_end(fnIt); it != ie;
         ++it) {
       Instruction *instr = &*it;
-      unsigned assemblyLine = lineTable[instr];
+      unsigned assemblyLine = lineTable.lookup(instr);
 
       // Update our source level debug information.
       getInstructionDebugInfo(instr, file, line);
 
-      infos.insert(std::make_pair(instr,
-                                  InstructionInfo(id++, *file, line,
-                                                  assemblyLine)));
+      ids[instr] = id;
+      infos.push_back(InstructionInfo(id++, *file, line, assemblyLine));
     }
   }
 }
@@ -175,12 +256,12 @@ unsigned InstructionInfoTable::getMaxID() const {
 
 const InstructionInfo &
 InstructionInfoTable::getInfo(const Instruction *inst) const {
-  std::map<const llvm::Instruction*, InstructionInfo>::const_iterator it = 
-    infos.find(inst);
-  if (it == infos.end())
+  llvm::DenseMap<const llvm::Instruction*, unsigned>::const_iterator it =
+    ids.find(inst);
+  if (it == ids.end())
     llvm::report_fatal_error("invalid instruction, not present in "
                              "initial module!");
-  return it->second;
+  return infos[it->second];
 }
 
 const InstructionInfo &
@@ -13,6 +13,7 @@
 
 #include "Passes.h"
 
+#include "klee/CommandLine.h"
 #include "klee/Config/Version.h"
 #include "klee/Interpreter.h"
 #include "klee/Internal/Module/Cell.h"
@@ -21,7 +22,13 @@
 #include "klee/Internal/Support/Debug.h"
 #include "klee/Internal/Support/ModuleUtil.h"
 
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Bitcode/ReaderWriter.h"
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 5)
+#include "llvm/IR/Dominators.h"
+#else
+#include "llvm/Analysis/Dominators.h"
+#endif
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
@@ -99,6 +106,14 @@ namespace {
   cl::opt<bool>
   DebugPrintEscapingFunctions("debug-print-escaping-functions", 
                               cl::desc("Print functions whose address is taken."));
+
+  cl::opt<bool>
+  RemoveUnreachableFunctions("remove-unreachable-functions",
+                             cl::desc("Remove the functions unreachable from "
+                                      "the entry point before preparing the "
+                                      "module, when it is not optimized "
+                                      "(default=on)"),
+                             cl::init(true));
 }
 
 KModule::KModule(Module *_module) 
@@ -292,6 +307,26 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
     }
   }
 
+  // The functions that cannot be called, such as most of the linked C
+  // library, are removed before the passes run and the KFunctions are built
+  // on them. The optimization removes them anyway once the module is
+  // internalized.
+  if (RemoveUnreachableFunctions && !opts.Optimize) {
+    std::vector<std::string> roots;
+    roots.push_back(opts.EntryPoint);
+    roots.push_back("main");
+    roots.push_back("klee_merge");
+    roots.insert(roots.end(), MergeAtExit.begin(), MergeAtExit.end());
+    // The functions whose calls are introduced by the intrinsic lowering
+    roots.push_back("abort");
+    roots.push_back("memcpy");
+    roots.push_back("memmove");
+    roots.push_back("memset");
+    unsigned removed = removeUnreachableFunctions(module, roots);
+    (void)removed;
+    KLEE_DEBUG(klee_message("Removed %u unreachable functions.", removed));
+  }
+
   // Inject checks prior to optimization... we also perform the
   // invariant transformations that we will end up doing later so that
   // optimize is seeing what is as close as possible to the final
@@ -374,6 +409,13 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   }
   pm3.add(new IntrinsicCleanerPass(*targetData));
   pm3.add(new PhiCleanerPass());
+#ifdef ENABLE_Z3
+  // The dependencies of the basic blocks for speculation are computed
+  // unless given by the files of -spec-dependency
+  if (SpecTypeToUse != NO_SPEC && !DependencyFolder.getNumOccurrences())
+    pm3.add(new SpeculationDependencyPass(speculationAvoid,
+                                          SpecDependencyCache));
+#endif
   pm3.run(*module);
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 3)
   // For cleanliness see if we can discard any of the functions we
@@ -387,44 +429,6 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   if (f && f->use_empty()) f->eraseFromParent();
 #endif
 
-  // Write out the .ll assembly file. We truncate long lines to work
-  // around a kcachegrind parsing bug (it puts them on new lines), so
-  // that source browsing works.
-  if (OutputSource) {
-    llvm::raw_fd_ostream *os = ih->openOutputFile("assembly.ll");
-    assert(os && !os->has_error() && "unable to open source output");
-
-    // We have an option for this in case the user wants a .ll they
-    // can compile.
-    if (NoTruncateSourceLines) {
-      *os << *module;
-    } else {
-      std::string string;
-      llvm::raw_string_ostream rss(string);
-      rss << *module;
-      rss.flush();
-      const char *position = string.c_str();
-
-      for (;;) {
-        const char *end = index(position, '\n');
-        if (!end) {
-          *os << position;
-          break;
-        } else {
-          unsigned count = (end - position) + 1;
-          if (count<255) {
-            os->write(position, count);
-          } else {
-            os->write(position, 254);
-            *os << "\n";
-          }
-          position = end+1;
-        }
-      }
-    }
-    delete os;
-  }
-
   if (OutputModule) {
     llvm::raw_fd_ostream *f = ih->openOutputFile("final.bc");
     WriteBitcodeToFile(module, *f);
@@ -435,7 +439,18 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
 
   /* Build shadow structures */
 
-  infos = new InstructionInfoTable(module);  
+  // Write out the .ll assembly file, while the assembly lines of the
+  // instructions are recorded. We truncate long lines to work around a
+  // kcachegrind parsing bug (it puts them on new lines), so that source
+  // browsing works. We have an option for this in case the user wants a .ll
+  // they can compile.
+  llvm::raw_fd_ostream *os = 0;
+  if (OutputSource) {
+    os = ih->openOutputFile("assembly.ll");
+    assert(os && !os->has_error() && "unable to open source output");
+  }
+  infos = new InstructionInfoTable(module, os, !NoTruncateSourceLines);
+  delete os;
   
   for (Module::iterator it = module->begin(), ie = module->end();
        it != ie; ++it) {
@@ -519,6 +534,61 @@ static int getOperandNum(Value *v,
   }
 }
 
+/// Whether an instruction only computes a value from its operands, such that
+/// its dependency need not be built when the value is not used
+static bool isDependencySliceable(Instruction *inst) {
+  return isa<BinaryOperator>(inst) || isa<CastInst>(inst) ||
+         isa<CmpInst>(inst) || isa<SelectInst>(inst) ||
+         isa<GetElementPtrInst>(inst) || isa<PHINode>(inst) ||
+         isa<InsertValueInst>(inst) || isa<ExtractValueInst>(inst);
+}
+
+/// Collect the instructions of a function that are irrelevant to the
+/// interpolation of Tracer-X: the side-effect free instructions that are not
+/// in the backward slice of the operands of the other instructions, namely
+/// the branches, memory accesses, calls and returns.
+static void getDependencyIrrelevant(Function *function,
+                                    std::set<Instruction *> &irrelevant) {
+  std::set<Instruction *> relevant;
+  std::vector<Instruction *> worklist;
+  for (llvm::Function::iterator bbit = function->begin(),
+         bbie = function->end(); bbit != bbie; ++bbit) {
+    for (llvm::BasicBlock::iterator it = bbit->begin(), ie = bbit->end();
+         it != ie; ++it) {
+      if (isDependencySliceable(&*it))
+        continue;
+      for (User::op_iterator oi = it->op_begin(), oe = it->op_end(); oi != oe;
+           ++oi) {
+        Instruction *op = dyn_cast<Instruction>(*oi);
+        if (op && relevant.insert(op).second)
+          worklist.push_back(op);
+      }
+    }
+  }
+
+  while (!worklist.empty()) {
+    Instruction *inst = worklist.back();
+    worklist.pop_back();
+    if (!isDependencySliceable(inst))
+      continue;
+    for (User::op_iterator oi = inst->op_begin(), oe = inst->op_end();
+         oi != oe; ++oi) {
+      Instruction *op = dyn_cast<Instruction>(*oi);
+      if (op && relevant.insert(op).second)
+        worklist.push_back(op);
+    }
+  }
+
+  for (llvm::Function::iterator bbit = function->begin(),
+         bbie = function->end(); bbit != bbie; ++bbit) {
+    for (llvm::BasicBlock::iterator it = bbit->begin(), ie = bbit->end();
+         it != ie; ++it) {
+      if (isDependencySliceable(&*it) && !relevant.count(&*it))
+        irrelevant.insert(&*it);
+    }
+  }
+}
+
 KFunction::KFunction(llvm::Function *_function,
                      KModule *km) 
   : function(_function),
@@ -545,7 +615,39 @@ KFunction::KFunction(llvm::Function *_function,
       registerMap[it] = rnum++;
   }
   numRegisters = rnum;
-  
+
+  // The loop headers are the targets of the back edges of the natural loops
+  std::set<BasicBlock *> loopHeaders;
+  if (!function->empty()) {
+    DominatorTree dt;
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 5)
+    dt.recalculate(*function);
+    LoopInfoBase<BasicBlock, Loop> loops;
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 8)
+    loops.analyze(dt);
+#else
+    loops.Analyze(dt);
+#endif
+#else
+    dt.runOnFunction(*function);
+    LoopInfoBase<BasicBlock, Loop> loops;
+    loops.Analyze(dt.getBase());
+#endif
+    for (llvm::Function::iterator bbit = function->begin(),
+           bbie = function->end(); bbit != bbie; ++bbit) {
+      BasicBlock *bb = &*bbit;
+      Loop *loop = loops.getLoopFor(bb);
+      if (loop && loop->getHeader() == bb)
+        loopHeaders.insert(bb);
+    }
+  }
+
+  std::set<Instruction *> dependencyIrrelevant;
+#ifdef ENABLE_Z3
+  if (DependencySlicing && !WPInterpolant)
+    getDependencyIrrelevant(function, dependencyIrrelevant);
+#endif
+
   unsigned i = 0;
   for (llvm::Function::iterator bbit = function->begin(), 
          bbie = function->end(); bbit != bbie; ++bbit) {
@@ -564,6 +666,13 @@ KFunction::KFunction(llvm::Function *_function,
 
       ki->inst = it;      
       ki->dest = registerMap[it];
+      ki->opcode = it->getOpcode();
+      ki->width = it->getType()->isSized()
+                      ? km->targetData->getTypeSizeInBits(it->getType())
+                      : 0;
+      ki->hasTableEntry = false;
+      ki->isLoopHeader = it == bbit->begin() && loopHeaders.count(&*bbit);
+      ki->isDependencyIrrelevant = dependencyIrrelevant.count(&*it);
 
       if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
         CallSite cs(it);
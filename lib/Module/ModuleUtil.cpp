@@ -491,3 +491,87 @@ static bool valueIsOnlyCalled(const Value *v) {
 bool klee::functionEscapes(const Function *f) {
   return !valueIsOnlyCalled(f);
 }
+
+/// Add the functions referenced by a constant, through its constant
+/// expressions and aggregates, to the reachable ones. The global variables
+/// and aliases are not followed, as they are all roots.
+static void addReferencedFunctions(Constant *c, std::set<Constant *> &visited,
+                                   std::set<Function *> &reachable,
+                                   std::vector<Function *> &worklist) {
+  if (!visited.insert(c).second)
+    return;
+
+  if (Function *f = dyn_cast<Function>(c)) {
+    if (reachable.insert(f).second)
+      worklist.push_back(f);
+    return;
+  }
+  if (isa<GlobalValue>(c))
+    return;
+
+  for (User::op_iterator it = c->op_begin(), ie = c->op_end(); it != ie; ++it)
+    if (Constant *op = dyn_cast<Constant>(*it))
+      addReferencedFunctions(op, visited, reachable, worklist);
+}
+
+unsigned
+klee::removeUnreachableFunctions(Module *module,
+                                 const std::vector<std::string> &roots) {
+  std::set<Constant *> visited;
+  std::set<Function *> reachable;
+  std::vector<Function *> worklist;
+
+  for (std::vector<std::string>::const_iterator it = roots.begin(),
+                                                ie = roots.end();
+       it != ie; ++it)
+    if (Function *f = module->getFunction(*it))
+      addReferencedFunctions(f, visited, reachable, worklist);
+
+  for (Module::global_iterator it = module->global_begin(),
+                               ie = module->global_end();
+       it != ie; ++it)
+    if (it->hasInitializer())
+      addReferencedFunctions(it->getInitializer(), visited, reachable,
+                             worklist);
+
+  for (Module::alias_iterator it = module->alias_begin(),
+                              ie = module->alias_end();
+       it != ie; ++it)
+    addReferencedFunctions(it->getAliasee(), visited, reachable, worklist);
+
+  while (!worklist.empty()) {
+    Function *f = worklist.back();
+    worklist.pop_back();
+    for (Function::iterator bbit = f->begin(), bbie = f->end(); bbit != bbie;
+         ++bbit)
+      for (BasicBlock::iterator it = bbit->begin(), ie = bbit->end(); it != ie;
+           ++it)
+        for (User::op_iterator opit = it->op_begin(), opie = it->op_end();
+             opit != opie; ++opit)
+          if (Constant *op = dyn_cast<Constant>(*opit))
+            addReferencedFunctions(op, visited, reachable, worklist);
+  }
+
+  // The bodies are all deleted before the functions are erased, as the
+  // unreachable functions may reference each other.
+  std::vector<Function *> unreachable;
+  for (Module::iterator it = module->begin(), ie = module->end(); it != ie;
+       ++it)
+    if (!it->isDeclaration() && !reachable.count(it))
+      unreachable.push_back(it);
+
+  for (std::vector<Function *>::iterator it = unreachable.begin(),
+                                         ie = unreachable.end();
+       it != ie; ++it)
+    (*it)->deleteBody();
+
+  for (std::vector<Function *>::iterator it = unreachable.begin(),
+                                         ie = unreachable.end();
+       it != ie; ++it) {
+    (*it)->removeDeadConstantUsers();
+    if ((*it)->use_empty())
+      (*it)->eraseFromParent();
+  }
+
+  return unreachable.size();
+}
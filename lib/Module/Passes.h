@@ -25,6 +25,10 @@
 #include "llvm/CodeGen/IntrinsicLowering.h"
 #include "llvm/Pass.h"
 
+#include <map>
+#include <set>
+#include <string>
+
 namespace llvm {
   class Function;
   class Instruction;
@@ -149,6 +153,36 @@ public:
   virtual bool runOnModule(llvm::Module &M);
 };
 
+/// SpeculationDependencyPass - Compute for each basic block the names of the
+/// variables on which reaching the block depends, that is, the variables of
+/// the conditions of the branches the block is control dependent on, closed
+/// under the stores into these variables. Speculation is only allowed at the
+/// branches independent of all of them. The variables are named as in
+/// Executor::extractVarNames. The result can be cached in a directory, keyed
+/// by the hash of the module.
+class SpeculationDependencyPass : public llvm::ModulePass {
+  static char ID;
+
+  std::map<llvm::BasicBlock *, std::set<std::string> > &avoid;
+
+  std::string cacheDirectory;
+
+  std::string getCacheFileName(llvm::Module &M);
+
+  bool readCache(llvm::Module &M, const std::string &fileName);
+
+  void writeCache(llvm::Module &M, const std::string &fileName);
+
+public:
+  SpeculationDependencyPass(
+      std::map<llvm::BasicBlock *, std::set<std::string> > &_avoid,
+      const std::string &_cacheDirectory)
+      : llvm::ModulePass(ID), avoid(_avoid),
+        cacheDirectory(_cacheDirectory) {}
+
+  virtual bool runOnModule(llvm::Module &M);
+};
+
 /// LowerSwitchPass - Replace all SwitchInst instructions with chained branch
 /// instructions.  Note that this cannot be a BasicBlock pass because it
 /// modifies the CFG!
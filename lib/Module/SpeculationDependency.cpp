@@ -0,0 +1,262 @@
+//===-- SpeculationDependency.cpp -----------------------------------------===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#else
+#include "llvm/Function.h"
+#include "llvm/GlobalVariable.h"
+#endif
+#include "llvm/ADT/Hashing.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+using namespace llvm;
+
+char klee::SpeculationDependencyPass::ID = 0;
+
+typedef std::map<std::string, std::set<std::string> > FlowMap;
+
+/// Collect the names of the variables a value is computed from, following
+/// the same rules as Executor::extractVarNames, but visiting every value
+/// once so that the cycles through PHI nodes terminate.
+static void getVariableNames(Value *v, std::set<std::string> &names,
+                             std::set<Value *> &visited) {
+  if (!visited.insert(v).second)
+    return;
+
+  if (GlobalVariable *gv = dyn_cast<GlobalVariable>(v)) {
+    names.insert(gv->getName().str());
+    return;
+  }
+
+  Instruction *ins = dyn_cast<Instruction>(v);
+  if (!ins)
+    return;
+
+  if (AllocaInst *ai = dyn_cast<AllocaInst>(ins)) {
+    if (!ai->getName().empty()) {
+      names.insert(ai->getName().str());
+      return;
+    }
+    // The unnamed allocas of the first two arguments are named after them
+    Function *f = ai->getParent()->getParent();
+    Function::arg_iterator arg = f->arg_begin();
+    BasicBlock::iterator first = f->getEntryBlock().begin();
+    if (arg == f->arg_end())
+      return;
+    if (ai == &*first) {
+      names.insert(arg->getName().str());
+    } else if (++arg != f->arg_end() && ai == &*(++first)) {
+      names.insert(arg->getName().str());
+    }
+    return;
+  }
+
+  for (unsigned i = 0; i < ins->getNumOperands(); ++i)
+    getVariableNames(ins->getOperand(i), names, visited);
+}
+
+static std::set<std::string> getVariableNames(Value *v) {
+  std::set<std::string> names;
+  std::set<Value *> visited;
+  getVariableNames(v, names, visited);
+  return names;
+}
+
+/// Record the variables the variables stored into by the function are
+/// computed from.
+static void collectFlows(Function &f, FlowMap &flows) {
+  for (Function::iterator b = f.begin(), be = f.end(); b != be; ++b) {
+    for (BasicBlock::iterator i = b->begin(), ie = b->end(); i != ie; ++i) {
+      StoreInst *si = dyn_cast<StoreInst>(i);
+      if (!si)
+        continue;
+      std::set<std::string> targets =
+          getVariableNames(si->getPointerOperand());
+      if (targets.empty())
+        continue;
+      std::set<std::string> sources = getVariableNames(si->getValueOperand());
+      for (std::set<std::string>::iterator it = targets.begin(),
+                                           ie = targets.end();
+           it != ie; ++it)
+        flows[*it].insert(sources.begin(), sources.end());
+    }
+  }
+}
+
+/// Add to each block of the function the variables of the conditions of the
+/// branches it is control dependent on. Block B is control dependent on the
+/// branch of block A when B postdominates a successor of A, but does not
+/// postdominate A, i.e., B is on the postdominator tree path from the
+/// successor up to, but excluding, the immediate postdominator of A.
+static void
+collectControlVariables(Function &f,
+                        std::map<BasicBlock *, std::set<std::string> > &avoid) {
+  PostDominatorTree pdt;
+  pdt.runOnFunction(f);
+
+  for (Function::iterator b = f.begin(), be = f.end(); b != be; ++b) {
+    TerminatorInst *term = b->getTerminator();
+    if (!term || term->getNumSuccessors() < 2)
+      continue;
+
+    Value *condition = 0;
+    if (BranchInst *bi = dyn_cast<BranchInst>(term))
+      condition = bi->getCondition();
+    else if (SwitchInst *si = dyn_cast<SwitchInst>(term))
+      condition = si->getCondition();
+    if (!condition)
+      continue;
+
+    std::set<std::string> vars = getVariableNames(condition);
+    if (vars.empty())
+      continue;
+
+    DomTreeNode *node = pdt.getNode(b);
+    DomTreeNode *limit = node ? node->getIDom() : 0;
+    for (unsigned i = 0; i < term->getNumSuccessors(); ++i) {
+      for (DomTreeNode *runner = pdt.getNode(term->getSuccessor(i));
+           runner && runner != limit; runner = runner->getIDom()) {
+        // The virtual exit node has no block
+        if (!runner->getBlock())
+          break;
+        avoid[runner->getBlock()].insert(vars.begin(), vars.end());
+      }
+    }
+  }
+}
+
+/// Close the set of variables under the flows of the stores.
+static void closeVariables(std::set<std::string> &vars, FlowMap &flows) {
+  std::vector<std::string> worklist(vars.begin(), vars.end());
+  while (!worklist.empty()) {
+    std::string var = worklist.back();
+    worklist.pop_back();
+    FlowMap::iterator it = flows.find(var);
+    if (it == flows.end())
+      continue;
+    for (std::set<std::string>::iterator it1 = it->second.begin(),
+                                         ie1 = it->second.end();
+         it1 != ie1; ++it1) {
+      if (vars.insert(*it1).second)
+        worklist.push_back(*it1);
+    }
+  }
+}
+
+std::string klee::SpeculationDependencyPass::getCacheFileName(Module &M) {
+  std::string text;
+  raw_string_ostream os(text);
+  os << M;
+  os.flush();
+
+  std::ostringstream name;
+  name << cacheDirectory << "/SpecAvoid-" << std::hex
+       << (uint64_t)hash_value(StringRef(text)) << ".txt";
+  return name.str();
+}
+
+bool klee::SpeculationDependencyPass::readCache(Module &M,
+                                                const std::string &fileName) {
+  std::ifstream in(fileName.c_str());
+  if (!in.good())
+    return false;
+
+  // Each line holds a function name, the index of the block in the function,
+  // and the variables of the block
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    std::string functionName;
+    unsigned index;
+    if (!(fields >> functionName >> index))
+      continue;
+    Function *f = M.getFunction(functionName);
+    if (!f || index >= f->size()) {
+      klee_warning("ignoring stale speculation dependency cache %s",
+                   fileName.c_str());
+      avoid.clear();
+      return false;
+    }
+    Function::iterator b = f->begin();
+    for (unsigned i = 0; i < index; ++i)
+      ++b;
+    std::set<std::string> &vars = avoid[b];
+    std::string var;
+    while (fields >> var)
+      vars.insert(var);
+  }
+  return true;
+}
+
+void klee::SpeculationDependencyPass::writeCache(Module &M,
+                                                 const std::string &fileName) {
+  std::ofstream out(fileName.c_str());
+  if (!out.good()) {
+    klee_warning("could not write speculation dependency cache %s",
+                 fileName.c_str());
+    return;
+  }
+
+  for (Module::iterator f = M.begin(), fe = M.end(); f != fe; ++f) {
+    unsigned index = 0;
+    for (Function::iterator b = f->begin(), be = f->end(); b != be;
+         ++b, ++index) {
+      std::map<BasicBlock *, std::set<std::string> >::iterator it =
+          avoid.find(b);
+      if (it == avoid.end())
+        continue;
+      out << f->getName().str() << " " << index;
+      for (std::set<std::string>::iterator it1 = it->second.begin(),
+                                           ie1 = it->second.end();
+           it1 != ie1; ++it1)
+        out << " " << *it1;
+      out << "\n";
+    }
+  }
+}
+
+bool klee::SpeculationDependencyPass::runOnModule(Module &M) {
+  std::string cacheFileName;
+  if (!cacheDirectory.empty()) {
+    cacheFileName = getCacheFileName(M);
+    if (readCache(M, cacheFileName))
+      return false;
+  }
+
+  FlowMap flows;
+  for (Module::iterator f = M.begin(), fe = M.end(); f != fe; ++f) {
+    if (f->isDeclaration())
+      continue;
+    collectFlows(*f, flows);
+    collectControlVariables(*f, avoid);
+  }
+
+  for (std::map<BasicBlock *, std::set<std::string> >::iterator
+           it = avoid.begin(),
+           ie = avoid.end();
+       it != ie; ++it)
+    closeVariables(it->second, flows);
+
+  if (!cacheFileName.empty())
+    writeCache(M, cacheFileName);
+
+  // This is an analysis: the module is not modified
+  return false;
+}
@@ -0,0 +1,639 @@
+//===-- ArraySlicingSolver.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A solver that restricts the symbolic reads of constant arrays, such as the
+// lookup tables of the programs, to the slices of the arrays at the indices
+// feasible under the constraints, so that the core solvers are given those
+// elements only rather than the whole arrays. The slices that hold few runs
+// of equal values, as the small ones do, are read by selects over the index
+// ranges of the runs instead, such that no array is built at all.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SolverImpl.h"
+#include "klee/util/ArrayCache.h"
+#include "klee/util/Bits.h"
+#include "klee/util/ExprHashMap.h"
+#include "klee/util/ExprUtil.h"
+#include "klee/util/ExprVisitor.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+llvm::cl::opt<unsigned> ConstantArraySelectThreshold(
+    "constant-array-select-threshold", llvm::cl::init(16),
+    llvm::cl::desc("With -slice-constant-arrays, read the slices with at "
+                   "most this number of runs of equal values other than "
+                   "those of the most frequent value through selects on the "
+                   "index, or 0 to always read the slices (default=16)"));
+
+/// An interval of unsigned values
+struct IndexRange {
+  uint64_t min, max;
+
+  IndexRange() : min(0), max(0) {}
+  IndexRange(uint64_t _min, uint64_t _max) : min(_min), max(_max) {}
+
+  static IndexRange full(Expr::Width width) {
+    return IndexRange(0, bits64::maxValueOfNBits(width));
+  }
+
+  IndexRange intersect(const IndexRange &b) const {
+    return IndexRange(std::max(min, b.min), std::min(max, b.max));
+  }
+};
+
+/// Whether the expression reads a constant array at a symbolic index
+bool hasSymbolicConstantRead(const ref<Expr> &e) {
+  std::vector<ref<ReadExpr> > reads;
+  findReads(e, /* visitUpdates= */ true, reads);
+  for (std::vector<ref<ReadExpr> >::iterator it = reads.begin(),
+                                             ie = reads.end();
+       it != ie; ++it) {
+    if ((*it)->updates.root->isConstantArray() && !(*it)->updates.head &&
+        !isa<ConstantExpr>((*it)->index))
+      return true;
+  }
+  return false;
+}
+
+/// Computes the ranges of the index expressions, from their structure and
+/// from the bounds that the constraints put on their sub-expressions.
+class IndexRangeAnalysis {
+  /// The bounds put by the constraints
+  ExprHashMap<IndexRange> bounds;
+  /// The upper bounds put by the signed comparisons of the constraints, which
+  /// only apply once an expression is known to be non-negative
+  ExprHashMap<IndexRange> signedBounds;
+  ExprHashMap<IndexRange> ranges;
+
+  void addBound(const ref<Expr> &e, const IndexRange &range, bool isSigned);
+  void addFact(const ref<Expr> &e, bool value);
+  IndexRange computeRange(const ref<Expr> &e);
+
+public:
+  void addConstraint(const ref<Expr> &e) { addFact(e, true); }
+  IndexRange getRange(const ref<Expr> &e);
+};
+
+void IndexRangeAnalysis::addBound(const ref<Expr> &e, const IndexRange &range,
+                                  bool isSigned) {
+  if (isa<ConstantExpr>(e) || e->getWidth() > 64)
+    return;
+  ExprHashMap<IndexRange> &map = isSigned ? signedBounds : bounds;
+  ExprHashMap<IndexRange>::iterator it = map.find(e);
+  if (it == map.end())
+    map.insert(std::make_pair(e, range));
+  else
+    it->second = it->second.intersect(range);
+}
+
+void IndexRangeAnalysis::addFact(const ref<Expr> &e, bool value) {
+  if (e->getWidth() != Expr::Bool)
+    return;
+
+  switch (e->getKind()) {
+  case Expr::And:
+    if (value) {
+      addFact(e->getKid(0), true);
+      addFact(e->getKid(1), true);
+    }
+    return;
+
+  case Expr::Or:
+    if (!value) {
+      addFact(e->getKid(0), false);
+      addFact(e->getKid(1), false);
+    }
+    return;
+
+  case Expr::Eq: {
+    ref<Expr> left = e->getKid(0), right = e->getKid(1);
+    const ConstantExpr *CE = dyn_cast<ConstantExpr>(left);
+    if (!CE || CE->getWidth() > 64)
+      return;
+    // (Eq false x) is the negation of x
+    if (CE->getWidth() == Expr::Bool) {
+      addFact(right, value == CE->isTrue());
+    } else if (value) {
+      uint64_t v = CE->getZExtValue();
+      addBound(right, IndexRange(v, v), false);
+    }
+    return;
+  }
+
+  case Expr::Not:
+    addFact(e->getKid(0), !value);
+    return;
+
+  case Expr::Ult:
+  case Expr::Ule:
+  case Expr::Slt:
+  case Expr::Sle: {
+    bool isSigned = e->getKind() == Expr::Slt || e->getKind() == Expr::Sle;
+    // Whether the comparison holds with equality
+    bool orEqual = e->getKind() == Expr::Ule || e->getKind() == Expr::Sle;
+    ref<Expr> left = e->getKid(0), right = e->getKid(1);
+    if (!value) {
+      // !(a < b) is b <= a
+      std::swap(left, right);
+      orEqual = !orEqual;
+    }
+
+    Expr::Width width = left->getWidth();
+    if (width > 64)
+      return;
+    uint64_t maxValue = isSigned ? bits64::maxValueOfNBits(width - 1)
+                                 : bits64::maxValueOfNBits(width);
+
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(right)) {
+      // left < C or left <= C
+      uint64_t c = CE->getZExtValue();
+      if (isSigned && c > maxValue)
+        return; // A negative bound
+      if (!orEqual) {
+        if (c == 0)
+          return;
+        --c;
+      }
+      addBound(left, IndexRange(0, c), isSigned);
+    } else if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(left)) {
+      // C < right or C <= right, where a non-negative signed C makes right
+      // non-negative, hence bounded as an unsigned value too
+      uint64_t c = CE->getZExtValue();
+      if (isSigned && c > maxValue)
+        return;
+      if (!orEqual) {
+        if (c == maxValue)
+          return;
+        ++c;
+      }
+      addBound(right, IndexRange(c, maxValue), false);
+    }
+    return;
+  }
+
+  default:
+    return;
+  }
+}
+
+IndexRange IndexRangeAnalysis::getRange(const ref<Expr> &e) {
+  ExprHashMap<IndexRange>::iterator it = ranges.find(e);
+  if (it != ranges.end())
+    return it->second;
+
+  IndexRange range = computeRange(e);
+
+  ExprHashMap<IndexRange>::iterator bound = bounds.find(e);
+  if (bound != bounds.end())
+    range = range.intersect(bound->second);
+
+  // The signed bounds apply as unsigned ones to the non-negative values
+  bound = signedBounds.find(e);
+  if (bound != signedBounds.end() &&
+      range.max <= bits64::maxValueOfNBits(e->getWidth() - 1))
+    range = range.intersect(bound->second);
+
+  ranges.insert(std::make_pair(e, range));
+  return range;
+}
+
+IndexRange IndexRangeAnalysis::computeRange(const ref<Expr> &e) {
+  Expr::Width width = e->getWidth();
+  if (width > 64)
+    return IndexRange::full(64);
+  IndexRange full = IndexRange::full(width);
+
+  switch (e->getKind()) {
+  case Expr::Constant: {
+    uint64_t value = cast<ConstantExpr>(e)->getZExtValue();
+    return IndexRange(value, value);
+  }
+
+  case Expr::ZExt:
+    return getRange(e->getKid(0));
+
+  case Expr::SExt: {
+    ref<Expr> src = e->getKid(0);
+    IndexRange range = getRange(src);
+    if (range.max <= bits64::maxValueOfNBits(src->getWidth() - 1))
+      return range;
+    return full;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    if (ee->offset != 0)
+      return full;
+    IndexRange range = getRange(ee->expr);
+    if (range.max <= full.max)
+      return range;
+    return full;
+  }
+
+  case Expr::Add: {
+    IndexRange left = getRange(e->getKid(0)), right = getRange(e->getKid(1));
+    // The sum of the maxima must not wrap around, or, as that of the negated
+    // constants of the subtractions, wrap around for all the values
+    if (left.max <= full.max - right.max)
+      return IndexRange(left.min + right.min, left.max + right.max);
+    if (left.min == left.max) {
+      uint64_t min = (left.min + right.min) & full.max;
+      uint64_t max = (left.min + right.max) & full.max;
+      if (min <= max && max - min == right.max - right.min)
+        return IndexRange(min, max);
+    }
+    return full;
+  }
+
+  case Expr::Mul: {
+    IndexRange left = getRange(e->getKid(0)), right = getRange(e->getKid(1));
+    if (left.max != 0 && right.max > full.max / left.max)
+      return full;
+    return IndexRange(left.min * right.min, left.max * right.max);
+  }
+
+  case Expr::Shl: {
+    IndexRange left = getRange(e->getKid(0)), right = getRange(e->getKid(1));
+    if (right.max >= width || left.max > (full.max >> right.max))
+      return full;
+    return IndexRange(left.min << right.min, left.max << right.max);
+  }
+
+  case Expr::LShr: {
+    IndexRange left = getRange(e->getKid(0)), right = getRange(e->getKid(1));
+    if (right.max >= width)
+      return IndexRange(0, left.max);
+    return IndexRange(left.min >> right.max, left.max >> right.min);
+  }
+
+  case Expr::And: {
+    IndexRange left = getRange(e->getKid(0)), right = getRange(e->getKid(1));
+    return IndexRange(0, std::min(left.max, right.max));
+  }
+
+  case Expr::URem: {
+    IndexRange right = getRange(e->getKid(1));
+    if (right.max == 0)
+      return full;
+    return IndexRange(0, std::min(getRange(e->getKid(0)).max, right.max - 1));
+  }
+
+  case Expr::UDiv: {
+    IndexRange left = getRange(e->getKid(0)), right = getRange(e->getKid(1));
+    if (right.min == 0)
+      return full;
+    return IndexRange(left.min / right.max, left.max / right.min);
+  }
+
+  case Expr::Select: {
+    IndexRange left = getRange(e->getKid(1)), right = getRange(e->getKid(2));
+    return IndexRange(std::min(left.min, right.min),
+                      std::max(left.max, right.max));
+  }
+
+  default:
+    return full;
+  }
+}
+
+/// Rewrites the symbolic reads of constant arrays into reads of the slices
+/// of the arrays at the feasible indices.
+class ArraySlicer : public ExprVisitor {
+  ArrayCache &arrayCache;
+  IndexRangeAnalysis &analysis;
+
+protected:
+  Action visitExprPost(const Expr &e) {
+    const ReadExpr *re = dyn_cast<ReadExpr>(&e);
+    if (!re)
+      return Action::skipChildren();
+
+    const Array *root = re->updates.root;
+    if (!root->isConstantArray() || re->updates.head ||
+        isa<ConstantExpr>(re->index) || root->size == 0)
+      return Action::skipChildren();
+
+    IndexRange indexRange = analysis.getRange(re->index);
+    IndexRange range = indexRange.intersect(IndexRange(0, root->size - 1));
+    // An empty range is that of an infeasible read, which is left as it is
+    if (range.min > range.max)
+      return Action::skipChildren();
+
+    // A single feasible index concretizes the read
+    if (range.min == range.max)
+      return Action::changeTo(root->constantValues[range.min]);
+
+    // The selects give a value to the indices out of the array too, so they
+    // only stand for the reads known to be within it
+    if (indexRange.max < root->size) {
+      ref<Expr> select = selectValues(re->index, root, range);
+      if (!select.isNull())
+        return Action::changeTo(select);
+    }
+
+    if (range.max - range.min + 1 == root->size)
+      return Action::skipChildren();
+
+    const std::string name = root->name + "_slice" +
+                             llvm::utostr(range.min) + "_" +
+                             llvm::utostr(range.max);
+    const Array *slice = arrayCache.CreateSharedConstantArray(
+        name, range.max - range.min + 1, &root->constantValues[range.min],
+        &root->constantValues[range.max] + 1, root->getDomain(),
+        root->getRange());
+    ref<Expr> index = SubExpr::create(
+        re->index, ConstantExpr::create(range.min, root->getDomain()));
+    return Action::changeTo(ReadExpr::create(UpdateList(slice, 0), index));
+  }
+
+  /// The read of the array at the index through selects on the runs of its
+  /// values in the given range, or null when the runs are too many.
+  ref<Expr> selectValues(const ref<Expr> &index, const Array *root,
+                         const IndexRange &range);
+
+public:
+  ArraySlicer(ArrayCache &_arrayCache, IndexRangeAnalysis &_analysis)
+      : ExprVisitor(false), arrayCache(_arrayCache), analysis(_analysis) {}
+};
+
+ref<Expr> ArraySlicer::selectValues(const ref<Expr> &index, const Array *root,
+                                    const IndexRange &range) {
+  if (ConstantArraySelectThreshold == 0)
+    return 0;
+
+  // The runs of equal values, as their first indices, and their number for
+  // each distinct value, in the order of the first runs
+  std::vector<uint64_t> runs;
+  std::vector<ref<ConstantExpr> > values;
+  std::vector<unsigned> runCounts;
+  for (uint64_t i = range.min; i <= range.max; ++i) {
+    const ref<ConstantExpr> &value = root->constantValues[i];
+    if (i != range.min &&
+        value->getAPValue() == root->constantValues[i - 1]->getAPValue())
+      continue;
+    runs.push_back(i);
+    unsigned v = 0;
+    while (v != values.size() &&
+           values[v]->getAPValue() != value->getAPValue())
+      ++v;
+    if (v == values.size()) {
+      values.push_back(value);
+      runCounts.push_back(0);
+    }
+    ++runCounts[v];
+    // Each value but one has a run at least
+    if (values.size() > ConstantArraySelectThreshold + 1)
+      return 0;
+  }
+
+  // The value of the most runs is that of the selects of none of the others
+  unsigned defaultValue =
+      std::max_element(runCounts.begin(), runCounts.end()) - runCounts.begin();
+  if (runs.size() - runCounts[defaultValue] > ConstantArraySelectThreshold)
+    return 0;
+
+  std::vector<ref<Expr> > conditions(values.size());
+  Expr::Width domain = root->getDomain();
+  for (unsigned r = 0; r != runs.size(); ++r) {
+    uint64_t first = runs[r];
+    uint64_t last = r + 1 == runs.size() ? range.max : runs[r + 1] - 1;
+    const ref<ConstantExpr> &value = root->constantValues[first];
+    unsigned v = 0;
+    while (values[v]->getAPValue() != value->getAPValue())
+      ++v;
+    if (v == defaultValue)
+      continue;
+
+    ref<Expr> condition;
+    if (first == last) {
+      condition = EqExpr::create(ConstantExpr::create(first, domain), index);
+    } else {
+      // The bounds of the feasible range hold already
+      if (first != range.min)
+        condition =
+            UleExpr::create(ConstantExpr::create(first, domain), index);
+      if (last != range.max) {
+        ref<Expr> upper =
+            UleExpr::create(index, ConstantExpr::create(last, domain));
+        condition =
+            condition.isNull() ? upper : AndExpr::create(condition, upper);
+      }
+    }
+    conditions[v] = conditions[v].isNull()
+                        ? condition
+                        : OrExpr::create(conditions[v], condition);
+  }
+
+  ref<Expr> result = values[defaultValue];
+  for (unsigned v = values.size(); v != 0; --v) {
+    if (v - 1 != defaultValue)
+      result = SelectExpr::create(conditions[v - 1], values[v - 1], result);
+  }
+  return result;
+}
+
+class ArraySlicingSolver : public SolverImpl {
+private:
+  Solver *solver;
+  /// The slices, shared between the queries, such that the core solvers
+  /// build each once
+  ArrayCache arrayCache;
+
+  /// Rewrite the query, and map each rewritten constraint to its original,
+  /// or return false when no read is sliced.
+  bool sliceQuery(const Query &query, std::vector<ref<Expr> > &constraints,
+                  ref<Expr> &expr, ExprHashMap<ref<Expr> > &originals);
+
+  /// Replace the rewritten constraints of the unsatisfiability core by their
+  /// originals.
+  void restoreUnsatCore(const ExprHashMap<ref<Expr> > &originals,
+                        std::vector<ref<Expr> > &unsatCore);
+
+public:
+  ArraySlicingSolver(Solver *_solver) : solver(_solver) {}
+  ~ArraySlicingSolver() { delete solver; }
+
+  bool computeValidity(const Query &, Solver::Validity &result,
+                       std::vector<ref<Expr> > &unsatCore);
+  bool computeTruth(const Query &, bool &isValid,
+                    std::vector<ref<Expr> > &unsatCore);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution,
+                            std::vector<ref<Expr> > &unsatCore);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(double timeout);
+  void releaseMemory();
+};
+
+bool ArraySlicingSolver::sliceQuery(const Query &query,
+                                    std::vector<ref<Expr> > &constraints,
+                                    ref<Expr> &expr,
+                                    ExprHashMap<ref<Expr> > &originals) {
+  std::vector<bool> slicable;
+  bool anySlicable = false;
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                         ie = query.constraints.end();
+       it != ie; ++it) {
+    slicable.push_back(hasSymbolicConstantRead(*it));
+    anySlicable |= slicable.back();
+  }
+  if (!anySlicable && !hasSymbolicConstantRead(query.expr))
+    return false;
+
+  // Only the constraints that are not rewritten bound the indices, so that
+  // the rewritten query is equivalent to the original one: in any model of
+  // either, the bounds hold, and the slices give the values of the arrays.
+  IndexRangeAnalysis analysis;
+  unsigned i = 0;
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                         ie = query.constraints.end();
+       it != ie; ++it, ++i) {
+    if (!slicable[i])
+      analysis.addConstraint(*it);
+  }
+
+  ArraySlicer slicer(arrayCache, analysis);
+  bool sliced = false;
+  i = 0;
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                         ie = query.constraints.end();
+       it != ie; ++it, ++i) {
+    // The constraints and the query expression that the concretized reads
+    // make constant are kept as they are, as the solvers expect symbolic ones
+    ref<Expr> constraint = slicable[i] ? slicer.visit(*it) : *it;
+    if (isa<ConstantExpr>(constraint))
+      constraint = *it;
+    if (constraint != *it) {
+      sliced = true;
+      originals.insert(std::make_pair(constraint, *it));
+    }
+    constraints.push_back(constraint);
+  }
+
+  expr = slicer.visit(query.expr);
+  if (isa<ConstantExpr>(expr))
+    expr = query.expr;
+  if (expr != query.expr) {
+    sliced = true;
+    // The cores may contain the negation of the query expression
+    originals.insert(std::make_pair(Expr::createIsZero(expr),
+                                    Expr::createIsZero(query.expr)));
+  }
+  return sliced;
+}
+
+void
+ArraySlicingSolver::restoreUnsatCore(const ExprHashMap<ref<Expr> > &originals,
+                                     std::vector<ref<Expr> > &unsatCore) {
+  for (std::vector<ref<Expr> >::iterator it = unsatCore.begin(),
+                                         ie = unsatCore.end();
+       it != ie; ++it) {
+    ExprHashMap<ref<Expr> >::const_iterator original = originals.find(*it);
+    if (original != originals.end())
+      *it = original->second;
+  }
+}
+
+bool ArraySlicingSolver::computeValidity(const Query &query,
+                                         Solver::Validity &result,
+                                         std::vector<ref<Expr> > &unsatCore) {
+  std::vector<ref<Expr> > constraints;
+  ref<Expr> expr;
+  ExprHashMap<ref<Expr> > originals;
+  if (!sliceQuery(query, constraints, expr, originals))
+    return solver->impl->computeValidity(query, result, unsatCore);
+
+  ConstraintManager cm(constraints);
+  if (!solver->impl->computeValidity(Query(cm, expr), result, unsatCore))
+    return false;
+  restoreUnsatCore(originals, unsatCore);
+  return true;
+}
+
+bool ArraySlicingSolver::computeTruth(const Query &query, bool &isValid,
+                                      std::vector<ref<Expr> > &unsatCore) {
+  std::vector<ref<Expr> > constraints;
+  ref<Expr> expr;
+  ExprHashMap<ref<Expr> > originals;
+  if (!sliceQuery(query, constraints, expr, originals))
+    return solver->impl->computeTruth(query, isValid, unsatCore);
+
+  ConstraintManager cm(constraints);
+  if (!solver->impl->computeTruth(Query(cm, expr), isValid, unsatCore))
+    return false;
+  restoreUnsatCore(originals, unsatCore);
+  return true;
+}
+
+bool ArraySlicingSolver::computeValue(const Query &query, ref<Expr> &result) {
+  std::vector<ref<Expr> > constraints;
+  ref<Expr> expr;
+  ExprHashMap<ref<Expr> > originals;
+  if (!sliceQuery(query, constraints, expr, originals))
+    return solver->impl->computeValue(query, result);
+
+  ConstraintManager cm(constraints);
+  return solver->impl->computeValue(Query(cm, expr), result);
+}
+
+bool ArraySlicingSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution,
+    std::vector<ref<Expr> > &unsatCore) {
+  std::vector<ref<Expr> > constraints;
+  ref<Expr> expr;
+  ExprHashMap<ref<Expr> > originals;
+  if (!sliceQuery(query, constraints, expr, originals))
+    return solver->impl->computeInitialValues(query, objects, values,
+                                              hasSolution, unsatCore);
+
+  // The objects are symbolic arrays, which are not sliced
+  ConstraintManager cm(constraints);
+  if (!solver->impl->computeInitialValues(Query(cm, expr), objects, values,
+                                          hasSolution, unsatCore))
+    return false;
+  restoreUnsatCore(originals, unsatCore);
+  return true;
+}
+
+SolverImpl::SolverRunStatus ArraySlicingSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *ArraySlicingSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void ArraySlicingSolver::setCoreSolverTimeout(double timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+void ArraySlicingSolver::releaseMemory() { solver->impl->releaseMemory(); }
+}
+
+Solver *klee::createArraySlicingSolver(Solver *s) {
+  return new Solver(new ArraySlicingSolver(s));
+}
@@ -0,0 +1,82 @@
+//===-- BinaryLoggingSolver.cpp -------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QueryLoggingSolver.h"
+
+#include "klee/Expr.h"
+#include "klee/util/BinaryQueryLog.h"
+
+using namespace klee;
+
+/// This QueryLoggingSolver will log queries to a file in the binary query log
+/// format. The text of the comments about the queries and their results is
+/// kept in comment records, in the order it is written with the queries.
+class BinaryLoggingSolver : public QueryLoggingSolver {
+
+private:
+  BinaryQueryWriter writer;
+
+  /// Move the text of the log buffer into a comment record.
+  void writeComment() {
+    logBuffer.flush();
+    if (!BufferString.empty()) {
+      writer.writeComment(BufferString);
+      BufferString = "";
+    }
+  }
+
+  virtual void printQuery(const Query &query, const Query *falseQuery = 0,
+                          const std::vector<const Array *> *objects = 0) {
+    writeComment();
+
+    const ref<Expr> *evalExprsBegin = 0;
+    const ref<Expr> *evalExprsEnd = 0;
+
+    if (0 != falseQuery) {
+      evalExprsBegin = &query.expr;
+      evalExprsEnd = &query.expr + 1;
+    }
+
+    const Array *const *evalArraysBegin = 0;
+    const Array *const *evalArraysEnd = 0;
+
+    if ((0 != objects) && (false == objects->empty())) {
+      evalArraysBegin = &((*objects)[0]);
+      evalArraysEnd = &((*objects)[0]) + objects->size();
+    }
+
+    const Query *q = (0 == falseQuery) ? &query : falseQuery;
+
+    if (!writer.writeQuery(q->constraints, q->expr, evalExprsBegin,
+                           evalExprsEnd, evalArraysBegin, evalArraysEnd))
+      logBuffer << queryCommentSign
+                << " Query not logged: unsupported expression\n";
+  }
+
+  virtual void flushBufferConditionally(bool writeToFile) {
+    writeComment();
+    if (writeToFile) {
+      writer.commit(*os);
+      os->flush();
+    } else {
+      writer.discard();
+    }
+  }
+
+public:
+  BinaryLoggingSolver(Solver *_solver, std::string path, int queryTimeToLog)
+      : QueryLoggingSolver(_solver, path, "#", queryTimeToLog, true) {}
+};
+
+///
+
+Solver *klee::createBinaryLoggingSolver(Solver *_solver, std::string path,
+                                        int minQueryTimeToLog) {
+  return new Solver(new BinaryLoggingSolver(_solver, path, minQueryTimeToLog));
+}
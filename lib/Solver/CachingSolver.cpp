@@ -41,6 +41,12 @@ private:
                    IncompleteSolver::PartialValidity &result,
                    std::vector<ref<Expr> > &unsatCore);
 
+  /// \brief Express the unsatisfiability core as the positions of its
+  /// elements in the constraints of the query
+  static void getCoreIndices(const Query &query,
+                             const std::vector<ref<Expr> > &core,
+                             std::vector<unsigned> &indices);
+
   struct CacheEntry {
     CacheEntry(const ConstraintManager &c, ref<Expr> q)
       : constraints(c), query(q) {}
@@ -57,21 +63,20 @@ private:
   };
   
   struct CacheEntryHash {
-    unsigned operator()(const CacheEntry &ce) const {
-      unsigned result = ce.query->hash();
-      
-      for (ConstraintManager::constraint_iterator it = ce.constraints.begin();
-           it != ce.constraints.end(); ++it)
-        result ^= (*it)->hash();
-      
-      return result;
+    size_t operator()(const CacheEntry &ce) const {
+      return Expr::combineHash(ce.query->hash(),
+                               ce.constraints.getFingerprint());
     }
   };
 
   typedef unordered_map<CacheEntry, 
                         IncompleteSolver::PartialValidity, 
                         CacheEntryHash> cache_map;
-  typedef unordered_map<CacheEntry, std::vector<ref<Expr> >, CacheEntryHash>
+  /// \brief The unsatisfiability cores of valid queries, stored as indices
+  /// into the constraints of the cache entry. Structurally-equal queries are
+  /// made of different expression objects, hence a cached core is remapped
+  /// onto the constraints of the query of the lookup on a cache hit.
+  typedef unordered_map<CacheEntry, std::vector<unsigned>, CacheEntryHash>
   UnsatCoreStoreMap;
 
   Solver *solver;
@@ -107,6 +112,7 @@ public:
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query&);
   void setCoreSolverTimeout(double timeout);
+  void releaseMemory();
 };
 
 /** @returns the canonical version of the given query.  The reference
@@ -142,9 +148,15 @@ bool CachingSolver::cacheLookup(const Query &query,
               IncompleteSolver::negatePartialValidity(it->second) :
               it->second);
     unsatCore.clear();
-    UnsatCoreStoreMap::iterator it = unsatCoreStore.find(ce);
-    if (it != unsatCoreStore.end()) {
-      unsatCore.insert(unsatCore.begin(), it->second.begin(), it->second.end());
+    UnsatCoreStoreMap::iterator coreIt = unsatCoreStore.find(ce);
+    if (coreIt != unsatCoreStore.end()) {
+      ConstraintManager::const_iterator constraintsBegin =
+          query.constraints.begin();
+      for (std::vector<unsigned>::iterator indexIt = coreIt->second.begin(),
+                                           indexIe = coreIt->second.end();
+           indexIt != indexIe; ++indexIt) {
+        unsatCore.push_back(*(constraintsBegin + *indexIt));
+      }
     }
     return true;
   }
@@ -163,8 +175,46 @@ void CachingSolver::cacheInsert(const Query& query,
   IncompleteSolver::PartialValidity cachedResult = 
     (negationUsed ? IncompleteSolver::negatePartialValidity(result) : result);
   
-  cache.insert(std::make_pair(ce, cachedResult));
-  unsatCoreStore.insert(std::make_pair(ce, core));
+  // A later, more precise result (e.g., MustBeTrue for a MayBeTrue entry)
+  // replaces the earlier one.
+  cache[ce] = cachedResult;
+  if (core.empty()) {
+    unsatCoreStore.erase(ce);
+    return;
+  }
+  std::vector<unsigned> &indices = unsatCoreStore[ce];
+  indices.clear();
+  getCoreIndices(query, core, indices);
+}
+
+void CachingSolver::getCoreIndices(const Query &query,
+                                   const std::vector<ref<Expr> > &core,
+                                   std::vector<unsigned> &indices) {
+  for (std::vector<ref<Expr> >::const_iterator it = core.begin(),
+                                               ie = core.end();
+       it != ie; ++it) {
+    unsigned index = 0;
+    ConstraintManager::const_iterator constraintIt = query.constraints.begin(),
+                                      constraintIe = query.constraints.end();
+    // The core normally consists of the very constraint objects of the query,
+    // so try pointer equality first.
+    for (; constraintIt != constraintIe; ++constraintIt, ++index) {
+      if (constraintIt->get() == it->get())
+        break;
+    }
+    if (constraintIt == constraintIe) {
+      index = 0;
+      for (constraintIt = query.constraints.begin();
+           constraintIt != constraintIe; ++constraintIt, ++index) {
+        if (*constraintIt == *it)
+          break;
+      }
+    }
+    // Core elements that are not constraints of the query cannot be
+    // remapped, and are not part of the path condition anyway.
+    if (constraintIt != constraintIe)
+      indices.push_back(index);
+  }
 }
 
 bool CachingSolver::computeValidity(const Query &query,
@@ -252,6 +302,10 @@ bool CachingSolver::computeTruth(const Query &query, bool &isValid,
   if (cacheHit && cachedResult != IncompleteSolver::MayBeTrue) {
     ++stats::queryCacheHits;
     isValid = (cachedResult == IncompleteSolver::MustBeTrue);
+    // The core of a MustBeFalse entry is that of the negated query, which
+    // is of no use to the caller of an invalid query.
+    if (!isValid)
+      unsatCore.clear();
     return true;
   }
 
@@ -290,6 +344,12 @@ void CachingSolver::setCoreSolverTimeout(double timeout) {
   solver->impl->setCoreSolverTimeout(timeout);
 }
 
+void CachingSolver::releaseMemory() {
+  cache.clear();
+  unsatCoreStore.clear();
+  solver->impl->releaseMemory();
+}
+
 ///
 
 Solver *klee::createCachingSolver(Solver *_solver) {
@@ -14,6 +14,8 @@
 #include "klee/SolverImpl.h"
 #include "klee/TimerStatIncrementer.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/CompiledExpr.h"
+#include "klee/util/ExprHashMap.h"
 #include "klee/util/ExprUtil.h"
 #include "klee/util/ExprVisitor.h"
 #include "klee/Internal/ADT/MapOfSets.h"
@@ -24,6 +26,9 @@
 
 #include "llvm/Support/CommandLine.h"
 
+#include <deque>
+#include <list>
+
 using namespace klee;
 using namespace llvm;
 
@@ -44,6 +49,31 @@ namespace {
   cl::opt<bool>
   CexCacheExperimental("cex-cache-exp", cl::init(false));
 
+  cl::opt<unsigned>
+  CexCacheMaxEntries("cex-cache-max-entries",
+                     cl::desc("Bound the counterexample cache to the given "
+                              "number of queries, evicting the least recently "
+                              "used ones (default=0 (unbounded))"),
+                     cl::init(0));
+
+  cl::opt<unsigned>
+  CexCacheRecent("cex-cache-recent",
+                 cl::desc("Try the given number of the most recently computed "
+                          "counterexamples before searching the cache, as "
+                          "those of the current path likely satisfy the "
+                          "next queries (default=0 (off))"),
+                 cl::init(0));
+
+  cl::opt<bool>
+  CexCacheCompile("cex-cache-compile",
+                  cl::desc("Check the cached counterexamples against the "
+                           "constraints compiled to programs over their "
+                           "values, instead of interpreting their "
+                           "expressions (default=false)"),
+                  cl::init(false));
+
+  /// The bound of the compiled constraints, cleared when reached
+  const unsigned MaxCompiledConstraints = 1 << 16;
 }
 
 ///
@@ -66,6 +96,33 @@ class CexCachingSolver : public SolverImpl {
   // memo table
   assignmentsTable_ty assignmentsTable;
 
+  /// The number of cache entries and recent assignments that use each
+  /// assignment of the memo table
+  std::map<Assignment *, unsigned> assignmentUses;
+
+  /// The keys of the cache entries, the most recently used first, when the
+  /// cache is bounded
+  typedef std::list<std::pair<KeyType, AssignmentCacheWrapper *> > lru_ty;
+  lru_ty lru;
+  std::map<AssignmentCacheWrapper *, lru_ty::iterator> lruPositions;
+
+  /// The most recently computed assignments, the latest first
+  std::deque<Assignment *> recentAssignments;
+
+  /// The compiled constraints, or null for those that cannot be compiled
+  ExprHashMap<CompiledExpr *> compiledConstraints;
+
+  friend struct NullOrSatisfyingAssignment;
+
+  /// Whether the assignment satisfies all the constraints of the key
+  bool satisfies(Assignment *a, const KeyType &key);
+  void clearCompiledConstraints();
+
+  void retain(Assignment *a);
+  void release(Assignment *a);
+  void touch(AssignmentCacheWrapper *w);
+  void insert(const KeyType &key, AssignmentCacheWrapper *w);
+
   bool searchForAssignment(KeyType &key, Assignment *&result,
                            std::vector<ref<Expr> > &unsatCore);
 
@@ -98,6 +155,7 @@ public:
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query& query);
   void setCoreSolverTimeout(double timeout);
+  void releaseMemory();
 };
 
 ///
@@ -115,16 +173,50 @@ struct NonNullAssignment {
 };
 
 struct NullOrSatisfyingAssignment {
+  CexCachingSolver &solver;
   KeyType &key;
-  
-  NullOrSatisfyingAssignment(KeyType &_key) : key(_key) {}
+
+  NullOrSatisfyingAssignment(CexCachingSolver &_solver, KeyType &_key)
+      : solver(_solver), key(_key) {}
 
   bool operator()(AssignmentCacheWrapper *a) const {
-    return !(a->getAssignment()) ||
-	a->getAssignment()->satisfies(key.begin(), key.end());
+    return !(a->getAssignment()) || solver.satisfies(a->getAssignment(), key);
   }
 };
 
+bool CexCachingSolver::satisfies(Assignment *a, const KeyType &key) {
+  if (!CexCacheCompile)
+    return a->satisfies(key.begin(), key.end());
+
+  for (KeyType::const_iterator it = key.begin(), ie = key.end(); it != ie;
+       ++it) {
+    ExprHashMap<CompiledExpr *>::iterator compiled =
+        compiledConstraints.find(*it);
+    if (compiled == compiledConstraints.end()) {
+      if (compiledConstraints.size() >= MaxCompiledConstraints)
+        clearCompiledConstraints();
+      compiled = compiledConstraints
+                     .insert(std::make_pair(*it, CompiledExpr::compile(*it)))
+                     .first;
+    }
+    if (compiled->second) {
+      if (!compiled->second->isTrue(*a))
+        return false;
+    } else if (!a->evaluate(*it)->isTrue()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void CexCachingSolver::clearCompiledConstraints() {
+  for (ExprHashMap<CompiledExpr *>::iterator it = compiledConstraints.begin(),
+                                             ie = compiledConstraints.end();
+       it != ie; ++it)
+    delete it->second;
+  compiledConstraints.clear();
+}
+
 /// searchForAssignment - Look for a cached solution for a query.
 ///
 /// \param key - The query to look up.
@@ -137,6 +229,7 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result,
   AssignmentCacheWrapper * const *lookup = cache.lookup(key);
 
   if (lookup) {
+    touch(*lookup);
     result = (*lookup)->getAssignment();
     const std::vector<ref<Expr> > &cachedCore = (*lookup)->getCore();
     unsatCore.clear();
@@ -144,6 +237,16 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result,
     return true;
   }
 
+  for (std::deque<Assignment *>::iterator it = recentAssignments.begin(),
+                                          ie = recentAssignments.end();
+       it != ie; ++it) {
+    if (satisfies(*it, key)) {
+      result = *it;
+      unsatCore.clear();
+      return true;
+    }
+  }
+
   if (CexCacheTryAll) {
     // Look for a satisfying assignment for a superset, which is trivially an
     // assignment for any subset.
@@ -157,6 +260,7 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result,
 
     // If either lookup succeeded, then we have a cached solution.
     if (lookup) {
+      touch(*lookup);
       result = (*lookup)->getAssignment();
       const std::vector<ref<Expr> > &cachedCore = (*lookup)->getCore();
       unsatCore.clear();
@@ -169,7 +273,7 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result,
     for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
            ie = assignmentsTable.end(); it != ie; ++it) {
       Assignment *a = *it;
-      if (a->satisfies(key.begin(), key.end())) {
+      if (satisfies(a, key)) {
         result = a;
         unsatCore.clear();
         return true;
@@ -190,10 +294,11 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result,
     // satisfiable subsets to see if they solve the current query and return
     // them if so. This is cheap and frequently succeeds.
     if (!lookup) 
-      lookup = cache.findSubset(key, NullOrSatisfyingAssignment(key));
+      lookup = cache.findSubset(key, NullOrSatisfyingAssignment(*this, key));
 
     // If either lookup succeeded, then we have a cached solution.
     if (lookup) {
+      touch(*lookup);
       result = (*lookup)->getAssignment();
       const std::vector<ref<Expr> > &cachedCore = (*lookup)->getCore();
       unsatCore.clear();
@@ -241,6 +346,19 @@ bool CexCachingSolver::lookupAssignment(const Query &query, KeyType &key,
     unsatCore.erase(std::remove(unsatCore.begin(), unsatCore.end(), neg),
                     unsatCore.end());
   }
+
+  if (found && !unsatCore.empty()) {
+    // The cached core may belong to a structurally-equal subset of the
+    // constraints, made of different expression objects. Remap it onto the
+    // constraints of this query, which all are in the key.
+    for (std::vector<ref<Expr> >::iterator it = unsatCore.begin(),
+                                           ie = unsatCore.end();
+         it != ie; ++it) {
+      KeyType::iterator keyIt = key.find(*it);
+      if (keyIt != key.end())
+        *it = *keyIt;
+    }
+  }
     
   return found;
 }
@@ -282,21 +400,75 @@ bool CexCachingSolver::getAssignment(const Query &query, Assignment *&result,
       }
 
     bindingWrapper = new AssignmentCacheWrapper(binding);
+
+    if (CexCacheRecent) {
+      retain(binding);
+      recentAssignments.push_front(binding);
+      if (recentAssignments.size() > CexCacheRecent) {
+        release(recentAssignments.back());
+        recentAssignments.pop_back();
+      }
+    }
   } else {
     binding = (Assignment *) 0;
     bindingWrapper = new AssignmentCacheWrapper(unsatCore);
   }
   
   result = binding;
-  cache.insert(key, bindingWrapper);
+  insert(key, bindingWrapper);
 
   return true;
 }
 
+void CexCachingSolver::retain(Assignment *a) {
+  if (a)
+    ++assignmentUses[a];
+}
+
+void CexCachingSolver::release(Assignment *a) {
+  if (!a)
+    return;
+  std::map<Assignment *, unsigned>::iterator it = assignmentUses.find(a);
+  assert(it != assignmentUses.end() && "releasing an unused assignment");
+  if (--it->second)
+    return;
+  assignmentUses.erase(it);
+  assignmentsTable.erase(a);
+  delete a;
+}
+
+void CexCachingSolver::touch(AssignmentCacheWrapper *w) {
+  if (!CexCacheMaxEntries)
+    return;
+  std::map<AssignmentCacheWrapper *, lru_ty::iterator>::iterator it =
+      lruPositions.find(w);
+  if (it != lruPositions.end())
+    lru.splice(lru.begin(), lru, it->second);
+}
+
+void CexCachingSolver::insert(const KeyType &key, AssignmentCacheWrapper *w) {
+  cache.insert(key, w);
+  retain(w->getAssignment());
+  if (!CexCacheMaxEntries)
+    return;
+
+  lru.push_front(std::make_pair(key, w));
+  lruPositions[w] = lru.begin();
+  while (lru.size() > CexCacheMaxEntries) {
+    std::pair<KeyType, AssignmentCacheWrapper *> &entry = lru.back();
+    cache.remove(entry.first);
+    lruPositions.erase(entry.second);
+    release(entry.second->getAssignment());
+    delete entry.second;
+    lru.pop_back();
+  }
+}
+
 ///
 
 CexCachingSolver::~CexCachingSolver() {
   cache.clear();
+  clearCompiledConstraints();
   delete solver;
   for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
          ie = assignmentsTable.end(); it != ie; ++it)
@@ -439,6 +611,31 @@ void CexCachingSolver::setCoreSolverTimeout(double timeout) {
   solver->impl->setCoreSolverTimeout(timeout);
 }
 
+void CexCachingSolver::releaseMemory() {
+  // All the entries of the cache are the supersets of the empty set
+  std::vector<std::pair<KeyType, AssignmentCacheWrapper *> > entries;
+  cache.supersets(KeyType(), entries);
+  for (std::vector<std::pair<KeyType, AssignmentCacheWrapper *> >::iterator
+           it = entries.begin(),
+           ie = entries.end();
+       it != ie; ++it)
+    delete it->second;
+  cache.clear();
+  lru.clear();
+  lruPositions.clear();
+
+  recentAssignments.clear();
+  assignmentUses.clear();
+  for (assignmentsTable_ty::iterator it = assignmentsTable.begin(),
+                                     ie = assignmentsTable.end();
+       it != ie; ++it)
+    delete *it;
+  assignmentsTable.clear();
+  clearCompiledConstraints();
+
+  solver->impl->releaseMemory();
+}
+
 ///
 
 Solver *klee::createCexCachingSolver(Solver *_solver) {
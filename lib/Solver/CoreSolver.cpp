@@ -31,24 +31,24 @@ using namespace klee;
 using namespace metaSMT;
 using namespace metaSMT::solver;
 
-static klee::Solver *handleMetaSMT() {
+static klee::Solver *handleMetaSMT(bool forked) {
   Solver *coreSolver = NULL;
   std::string backend;
   switch (MetaSMTBackend) {
   case METASMT_BACKEND_STP:
     backend = "STP";
     coreSolver = new MetaSMTSolver<DirectSolver_Context<STP_Backend> >(
-        UseForkedCoreSolver, CoreSolverOptimizeDivides);
+        forked, CoreSolverOptimizeDivides);
     break;
   case METASMT_BACKEND_Z3:
     backend = "Z3";
     coreSolver = new MetaSMTSolver<DirectSolver_Context<Z3_Backend> >(
-        UseForkedCoreSolver, CoreSolverOptimizeDivides);
+        forked, CoreSolverOptimizeDivides);
     break;
   case METASMT_BACKEND_BOOLECTOR:
     backend = "Boolector";
     coreSolver = new MetaSMTSolver<DirectSolver_Context<Boolector> >(
-        UseForkedCoreSolver, CoreSolverOptimizeDivides);
+        forked, CoreSolverOptimizeDivides);
     break;
   default:
     llvm_unreachable("Unrecognised metasmt backend");
@@ -61,12 +61,12 @@ static klee::Solver *handleMetaSMT() {
 
 namespace klee {
 
-Solver *createCoreSolver(CoreSolverType cst) {
+static Solver *createSingleCoreSolver(CoreSolverType cst, bool forked) {
   switch (cst) {
   case STP_SOLVER:
 #ifdef ENABLE_STP
     llvm::errs() << "Using STP solver backend\n";
-    return new STPSolver(UseForkedCoreSolver, CoreSolverOptimizeDivides);
+    return new STPSolver(forked, CoreSolverOptimizeDivides);
 #else
     llvm::errs() << "Not compiled with STP support\n";
     return NULL;
@@ -74,7 +74,7 @@ Solver *createCoreSolver(CoreSolverType cst) {
   case METASMT_SOLVER:
 #ifdef ENABLE_METASMT
     llvm::errs() << "Using MetaSMT solver backend\n";
-    return handleMetaSMT();
+    return handleMetaSMT(forked);
 #else
     llvm::errs() << "Not compiled with MetaSMT support\n";
     return NULL;
@@ -96,4 +96,23 @@ Solver *createCoreSolver(CoreSolverType cst) {
     llvm_unreachable("Unsupported CoreSolverType");
   }
 }
+
+Solver *createCoreSolver(CoreSolverType cst) {
+  if (cst != CoreSolverToUse || PortfolioCoreSolverWith == NO_SOLVER ||
+      PortfolioCoreSolverWith == cst)
+    return createSingleCoreSolver(cst, UseForkedCoreSolver);
+
+  // The portfolio already runs each backend in its own process
+  Solver *primary = createSingleCoreSolver(cst, false);
+  if (!primary)
+    return NULL;
+  Solver *secondary = createSingleCoreSolver(PortfolioCoreSolverWith, false);
+  if (!secondary) {
+    llvm::errs() << "Portfolio solver unavailable, using the core solver "
+                    "alone\n";
+    return primary;
+  }
+  llvm::errs() << "Using portfolio of core solver backends\n";
+  return createPortfolioSolver(primary, secondary);
+}
 }
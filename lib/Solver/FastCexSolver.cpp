@@ -23,6 +23,7 @@
 #include "llvm/Support/raw_ostream.h"
 #include <sstream>
 #include <cassert>
+#include <algorithm>
 #include <map>
 #include <vector>
 
@@ -307,7 +308,6 @@ class CexObjectData {
   /// for each array location.
   std::vector<CexValueData> exactContents;
 
-  CexObjectData(const CexObjectData&); // DO NOT IMPLEMENT
   void operator=(const CexObjectData&); // DO NOT IMPLEMENT
 
 public:
@@ -412,17 +412,27 @@ class CexData {
 public:
   std::map<const Array*, CexObjectData*> objects;
 
-  CexData(const CexData&); // DO NOT IMPLEMENT
   void operator=(const CexData&); // DO NOT IMPLEMENT
 
 public:
   CexData() {}
+  CexData(const CexData &b) { copyObjects(b); }
   ~CexData() {
     for (std::map<const Array*, CexObjectData*>::iterator it = objects.begin(),
            ie = objects.end(); it != ie; ++it)
       delete it->second;
   }
 
+  /// copyObjects - Copy the object values of \a b, into this initially empty
+  /// data.
+  void copyObjects(const CexData &b) {
+    assert(objects.empty() && "copying into non-empty data");
+    for (std::map<const Array*, CexObjectData*>::const_iterator
+           it = b.objects.begin(), ie = b.objects.end(); it != ie; ++it)
+      objects.insert(std::make_pair(it->first,
+                                    new CexObjectData(*it->second)));
+  }
+
   CexObjectData &getObjectData(const Array *A) {
     CexObjectData *&Entry = objects[A];
 
@@ -967,6 +977,23 @@ public:
 
 
 class FastCexSolver : public IncompleteSolver {
+  /// The number of constraint sets whose propogation results are kept
+  static const unsigned PrefixCacheSize = 8;
+
+  /// The propogation results of a constraint set, from which those of the
+  /// constraint sets it is a prefix of are computed incrementally.
+  struct CachedPrefix {
+    std::vector<ref<Expr> > constraints;
+    CexData *data;
+  };
+
+  /// The cached constraint sets, the most recently used first
+  std::vector<CachedPrefix> prefixCache;
+
+  /// Propogate the constraints into the initially empty \a cd, starting from
+  /// the results of the longest cached prefix of the constraints.
+  void propogateConstraints(const ConstraintManager &constraints, CexData &cd);
+
 public:
   FastCexSolver();
   ~FastCexSolver();
@@ -983,14 +1010,70 @@ public:
 
 FastCexSolver::FastCexSolver() { }
 
-FastCexSolver::~FastCexSolver() { }
+FastCexSolver::~FastCexSolver() {
+  for (std::vector<CachedPrefix>::iterator it = prefixCache.begin(),
+         ie = prefixCache.end(); it != ie; ++it)
+    delete it->data;
+}
+
+void FastCexSolver::propogateConstraints(const ConstraintManager &constraints,
+                                         CexData &cd) {
+  // The constraints are propogated in order, so that from the results of a
+  // prefix, the propogation of the remaining constraints gives the same
+  // results as that of all the constraints.
+  std::vector<CachedPrefix>::iterator best = prefixCache.end();
+  for (std::vector<CachedPrefix>::iterator it = prefixCache.begin(),
+         ie = prefixCache.end(); it != ie; ++it) {
+    if (it->constraints.size() > constraints.size() ||
+        (best != prefixCache.end() &&
+         it->constraints.size() <= best->constraints.size()))
+      continue;
+    if (std::equal(it->constraints.begin(), it->constraints.end(),
+                   constraints.begin()))
+      best = it;
+  }
+
+  unsigned start = 0;
+  if (best != prefixCache.end()) {
+    start = best->constraints.size();
+    cd.copyObjects(*best->data);
+
+    // Move the entry to the front
+    CachedPrefix entry = *best;
+    prefixCache.erase(best);
+    prefixCache.insert(prefixCache.begin(), entry);
+  }
+
+  ConstraintManager::const_iterator it = constraints.begin(),
+                                    ie = constraints.end();
+  for (it += start; it != ie; ++it) {
+    cd.propogatePossibleValue(*it, 1);
+    cd.propogateExactValue(*it, 1);
+  }
+
+  if (start == constraints.size())
+    return;
+
+  // Cache the results of the extended constraint set, keeping its prefix for
+  // the other paths that extend it.
+  CachedPrefix entry;
+  entry.constraints.assign(constraints.begin(), constraints.end());
+  entry.data = new CexData(cd);
+  prefixCache.insert(prefixCache.begin(), entry);
+  if (prefixCache.size() > PrefixCacheSize) {
+    delete prefixCache.back().data;
+    prefixCache.pop_back();
+  }
+}
 
 /// propogateValues - Propogate value ranges for the given query and return the
 /// propogation results.
 ///
 /// \param query - The query to propogate values for.
 ///
-/// \param cd - The initial object values resulting from the propogation.
+/// \param cd - The object values resulting from the propogation of the
+/// constraints, and the initial values of the propogation of the query
+/// expression.
 ///
 /// \param checkExpr - Include the query expression in the constraints to
 /// propogate.
@@ -1001,11 +1084,6 @@ FastCexSolver::~FastCexSolver() { }
 /// \return - True if the propogation was able to prove validity or invalidity.
 static bool propogateValues(const Query &query, CexData &cd, bool checkExpr,
                             bool &isValid, std::vector<ref<Expr> > &unsatCore) {
-  for (ConstraintManager::const_iterator it = query.constraints.begin(), 
-         ie = query.constraints.end(); it != ie; ++it) {
-    cd.propogatePossibleValue(*it, 1);
-    cd.propogateExactValue(*it, 1);
-  }
   if (checkExpr) {
     cd.propogatePossibleValue(query.expr, 0);
     cd.propogateExactValue(query.expr, 0);
@@ -1051,6 +1129,7 @@ IncompleteSolver::PartialValidity
 FastCexSolver::computeTruth(const Query &query,
                             std::vector<ref<Expr> > &unsatCore) {
   CexData cd;
+  propogateConstraints(query.constraints, cd);
 
   bool isValid;
   bool success = propogateValues(query, cd, true, isValid, unsatCore);
@@ -1063,6 +1142,7 @@ FastCexSolver::computeTruth(const Query &query,
 
 bool FastCexSolver::computeValue(const Query& query, ref<Expr> &result) {
   CexData cd;
+  propogateConstraints(query.constraints, cd);
 
   bool isValid;
   std::vector<ref<Expr> > unsatCore;
@@ -1093,6 +1173,7 @@ bool FastCexSolver::computeInitialValues(
     std::vector<std::vector<unsigned char> > &values, bool &hasSolution,
     std::vector<ref<Expr> > &unsatCore) {
   CexData cd;
+  propogateConstraints(query.constraints, cd);
 
   bool isValid;
   bool success = propogateValues(query, cd, true, isValid, unsatCore);
@@ -148,3 +148,5 @@ void StagedSolverImpl::setCoreSolverTimeout(double timeout) {
   secondary->impl->setCoreSolverTimeout(timeout);
 }
 
+void StagedSolverImpl::releaseMemory() { secondary->impl->releaseMemory(); }
+
@@ -14,74 +14,145 @@
 #include "klee/Constraints.h"
 #include "klee/SolverImpl.h"
 #include "klee/Internal/Support/Debug.h"
+#include "klee/Internal/Support/ErrorHandling.h"
 
 #include "klee/util/ExprUtil.h"
 #include "klee/util/Assignment.h"
 
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include <map>
 #include <vector>
 #include <ostream>
 #include <list>
+#include <algorithm>
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 using namespace klee;
 using namespace llvm;
 
+namespace {
+cl::opt<bool> IndependentFactorCache(
+    "independent-factor-cache",
+    cl::desc("Reuse the independent element sets of the constraints of the "
+             "previous query when the constraints of the current query extend "
+             "them, as is the case for consecutive queries on the same path "
+             "(default=true)"),
+    cl::init(true));
+
+cl::opt<unsigned> IndependentSolverProcesses(
+    "independent-solver-processes",
+    cl::desc("Solve the independent factors of a query for initial values, "
+             "as when generating a test case, in the given number of forked "
+             "processes (default=0 (in this process))"),
+    cl::init(0));
+
+/// \brief The header of the shared memory region of a factor solved in a
+/// child process, followed by the bytes of the arrays of the factor
+struct FactorSlot {
+  enum { FAILED, SOLVABLE, UNSOLVABLE };
+  int state;
+};
+}
+
+/// A set of array indices as a compressed bitmap: the nonzero 64-bit words
+/// of the bitmap, ordered by their position. Unions and intersections merge
+/// the words of the two sets, and test a whole word at a time.
 template<class T>
 class DenseSet {
-  typedef std::set<T> set_ty;
-  set_ty s;
+  typedef std::vector<std::pair<T, uint64_t> > words_ty;
+  words_ty words;
+
+  static bool positionLess(const std::pair<T, uint64_t> &word, T position) {
+    return word.first < position;
+  }
 
 public:
   DenseSet() {}
 
   void add(T x) {
-    s.insert(x);
+    T position = x / 64;
+    typename words_ty::iterator it =
+        std::lower_bound(words.begin(), words.end(), position, positionLess);
+    if (it == words.end() || it->first != position)
+      it = words.insert(it, std::make_pair(position, (uint64_t)0));
+    it->second |= (uint64_t)1 << (x % 64);
   }
   void add(T start, T end) {
     for (; start<end; start++)
-      s.insert(start);
+      add(start);
   }
 
   // returns true iff set is changed by addition
   bool add(const DenseSet &b) {
+    words_ty merged;
+    merged.reserve(words.size() + b.words.size());
     bool modified = false;
-    for (typename set_ty::const_iterator it = b.s.begin(), ie = b.s.end(); 
-         it != ie; ++it) {
-      if (modified || !s.count(*it)) {
+    typename words_ty::const_iterator it = words.begin(), ie = words.end(),
+                                      bit = b.words.begin(),
+                                      bie = b.words.end();
+    while (it != ie || bit != bie) {
+      if (bit == bie || (it != ie && it->first < bit->first)) {
+        merged.push_back(*it++);
+      } else if (it == ie || bit->first < it->first) {
+        merged.push_back(*bit++);
         modified = true;
-        s.insert(*it);
+      } else {
+        if (bit->second & ~it->second)
+          modified = true;
+        merged.push_back(std::make_pair(it->first, it->second | bit->second));
+        ++it;
+        ++bit;
       }
     }
+    if (modified)
+      words.swap(merged);
     return modified;
   }
 
-  bool intersects(const DenseSet &b) {
-    for (typename set_ty::iterator it = s.begin(), ie = s.end(); 
-         it != ie; ++it)
-      if (b.s.count(*it))
-        return true;
+  bool intersects(const DenseSet &b) const {
+    typename words_ty::const_iterator it = words.begin(), ie = words.end(),
+                                      bit = b.words.begin(),
+                                      bie = b.words.end();
+    while (it != ie && bit != bie) {
+      if (it->first < bit->first) {
+        ++it;
+      } else if (bit->first < it->first) {
+        ++bit;
+      } else {
+        if (it->second & bit->second)
+          return true;
+        ++it;
+        ++bit;
+      }
+    }
     return false;
   }
 
-  std::set<unsigned>::iterator begin(){
-    return s.begin();
-  }
-
-  std::set<unsigned>::iterator end(){
-    return s.end();
+  void getElements(std::vector<T> &result) const {
+    for (typename words_ty::const_iterator it = words.begin(),
+                                           ie = words.end();
+         it != ie; ++it) {
+      for (unsigned i = 0; i < 64; ++i)
+        if (it->second & ((uint64_t)1 << i))
+          result.push_back(it->first * 64 + i);
+    }
   }
 
   void print(llvm::raw_ostream &os) const {
-    bool first = true;
+    std::vector<T> elements;
+    getElements(elements);
     os << "{";
-    for (typename set_ty::iterator it = s.begin(), ie = s.end(); 
+    for (typename std::vector<T>::iterator it = elements.begin(),
+                                           ie = elements.end();
          it != ie; ++it) {
-      if (first) {
-        first = false;
-      } else {
+      if (it != elements.begin())
         os << ",";
-      }
       os << *it;
     }
     os << "}";
@@ -182,8 +253,16 @@ public:
     os << "}";
   }
 
+  /// Add the arrays the set accesses, in no particular order.
+  void getArrays(std::vector<const Array *> &result) const {
+    for (elements_ty::const_iterator it = elements.begin(), ie = elements.end();
+         it != ie; ++it)
+      result.push_back(it->first);
+    result.insert(result.end(), wholeObjects.begin(), wholeObjects.end());
+  }
+
   // more efficient when this is the smaller set
-  bool intersects(const IndependentElementSet &b) {
+  bool intersects(const IndependentElementSet &b) const {
     // If there are any symbolic arrays in our query that b accesses
     for (std::set<const Array*>::iterator it = wholeObjects.begin(), 
            ie = wholeObjects.end(); it != ie; ++it) {
@@ -192,7 +271,7 @@ public:
           b.elements.find(array) != b.elements.end())
         return true;
     }
-    for (elements_ty::iterator it = elements.begin(), ie = elements.end();
+    for (elements_ty::const_iterator it = elements.begin(), ie = elements.end();
          it != ie; ++it) {
       const Array *array = it->first;
       // if the array we access is symbolic in b
@@ -256,12 +335,37 @@ inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
   return os;
 }
 
+/// The representative of the element in a union-find forest, compressing
+/// the path to it.
+static unsigned find(std::vector<unsigned> &parents, unsigned i) {
+  while (parents[i] != i) {
+    parents[i] = parents[parents[i]];
+    i = parents[i];
+  }
+  return i;
+}
+
+static void unite(std::vector<unsigned> &parents, unsigned i, unsigned j) {
+  i = find(parents, i);
+  j = find(parents, j);
+  // The earlier constraint stays the representative
+  if (i < j)
+    parents[j] = i;
+  else
+    parents[i] = j;
+}
+
 // Breaks down a constraint into all of it's individual pieces, returning a
 // list of IndependentElementSets or the independent factors.
 //
 // Caller takes ownership of returned std::list.
+//
+// The element sets of the constraints of the query are given in constraintSets,
+// in the order of the constraints.
 static std::list<IndependentElementSet>*
-getAllIndependentConstraintsSets(const Query &query) {
+getAllIndependentConstraintsSets(
+    const Query &query,
+    const std::vector<IndependentElementSet> &constraintSets) {
   std::list<IndependentElementSet> *factors = new std::list<IndependentElementSet>();
   ConstantExpr *CE = dyn_cast<ConstantExpr>(query.expr);
   if (CE) {
@@ -272,83 +376,149 @@ getAllIndependentConstraintsSets(const Query &query) {
     factors->push_back(IndependentElementSet(neg));
   }
 
-  for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                         ie = query.constraints.end();
+  for (std::vector<IndependentElementSet>::const_iterator
+           it = constraintSets.begin(),
+           ie = constraintSets.end();
        it != ie; ++it) {
     // iterate through all the previously separated constraints.  Until we
     // actually return, factors is treated as a queue of expressions to be
     // evaluated.  If the queue property isn't maintained, then the exprs
     // could be returned in an order different from how they came it, negatively
     // affecting later stages.
-    factors->push_back(IndependentElementSet(*it));
-  }
-
-  bool doneLoop = false;
-  do {
-    doneLoop = true;
-    std::list<IndependentElementSet> *done =
-        new std::list<IndependentElementSet>;
-    while (factors->size() > 0) {
-      IndependentElementSet current = factors->front();
-      factors->pop_front();
-      // This list represents the set of factors that are separate from current.
-      // Those that are not inserted into this list (queue) intersect with
-      // current.
-      std::list<IndependentElementSet> *keep =
-          new std::list<IndependentElementSet>;
-      while (factors->size() > 0) {
-        IndependentElementSet compare = factors->front();
-        factors->pop_front();
-        if (current.intersects(compare)) {
-          if (current.add(compare)) {
-            // Means that we have added (z=y)added to (x=y)
-            // Now need to see if there are any (z=?)'s
-            doneLoop = false;
-          }
-        } else {
-          keep->push_back(compare);
-        }
+    factors->push_back(*it);
+  }
+
+  // The factors are the connected components of the intersection relation,
+  // as a set intersects a union of sets iff it intersects one of them. Sets
+  // intersect when one accesses an array as a whole and the other accesses
+  // the array, or when both access the same element.
+  std::vector<IndependentElementSet *> sets;
+  for (std::list<IndependentElementSet>::iterator it = factors->begin(),
+                                                  ie = factors->end();
+       it != ie; ++it)
+    sets.push_back(&*it);
+
+  std::vector<unsigned> parents(sets.size());
+  for (unsigned i = 0; i < sets.size(); ++i)
+    parents[i] = i;
+
+  // The sets accessing each array, until a set accesses it as a whole, which
+  // then stands for all of them
+  std::map<const Array *, std::vector<unsigned> > accessors;
+  std::map<const Array *, unsigned> wholeOwner;
+  std::map<std::pair<const Array *, unsigned>, unsigned> elementOwner;
+  std::vector<unsigned> indices;
+  for (unsigned i = 0; i < sets.size(); ++i) {
+    IndependentElementSet &set = *sets[i];
+    for (std::set<const Array *>::iterator it = set.wholeObjects.begin(),
+                                           ie = set.wholeObjects.end();
+         it != ie; ++it) {
+      std::vector<unsigned> &previous = accessors[*it];
+      for (std::vector<unsigned>::iterator it2 = previous.begin(),
+                                           ie2 = previous.end();
+           it2 != ie2; ++it2)
+        unite(parents, i, *it2);
+      previous.clear();
+      std::map<const Array *, unsigned>::iterator owner =
+          wholeOwner.find(*it);
+      if (owner != wholeOwner.end())
+        unite(parents, i, owner->second);
+      wholeOwner[*it] = i;
+    }
+    for (IndependentElementSet::elements_ty::iterator
+             it = set.elements.begin(),
+             ie = set.elements.end();
+         it != ie; ++it) {
+      std::map<const Array *, unsigned>::iterator owner =
+          wholeOwner.find(it->first);
+      if (owner != wholeOwner.end())
+        unite(parents, i, owner->second);
+      else
+        accessors[it->first].push_back(i);
+      indices.clear();
+      it->second.getElements(indices);
+      for (std::vector<unsigned>::iterator it2 = indices.begin(),
+                                           ie2 = indices.end();
+           it2 != ie2; ++it2) {
+        std::pair<std::map<std::pair<const Array *, unsigned>,
+                           unsigned>::iterator,
+                  bool> res = elementOwner.insert(
+            std::make_pair(std::make_pair(it->first, *it2), i));
+        if (!res.second)
+          unite(parents, i, res.first->second);
       }
-      done->push_back(current);
-      delete factors;
-      factors = keep;
     }
-    delete factors;
-    factors = done;
-  } while (!doneLoop);
+  }
+
+  // Merge each component into the set of its first member, keeping the
+  // order of the expressions in the factors and of the factors
+  std::list<IndependentElementSet> *done = new std::list<IndependentElementSet>;
+  std::map<unsigned, IndependentElementSet *> components;
+  for (unsigned i = 0; i < sets.size(); ++i) {
+    unsigned root = find(parents, i);
+    std::map<unsigned, IndependentElementSet *>::iterator it =
+        components.find(root);
+    if (it == components.end()) {
+      done->push_back(*sets[i]);
+      components[root] = &done->back();
+    } else {
+      it->second->add(*sets[i]);
+    }
+  }
+  delete factors;
+  factors = done;
 
   return factors;
 }
 
-static 
-IndependentElementSet getIndependentConstraints(const Query& query,
-                                                std::vector< ref<Expr> > &result) {
+/// The indices of the constraints that access each array
+typedef std::map<const Array *, std::vector<unsigned> > ArrayIndex;
+
+static IndependentElementSet getIndependentConstraints(
+    const Query &query,
+    const std::vector<IndependentElementSet> &constraintSets,
+    const ArrayIndex &arrayIndex, std::vector<ref<Expr> > &result) {
   IndependentElementSet eltsClosure(query.expr);
-  std::vector< std::pair<ref<Expr>, IndependentElementSet> > worklist;
-
-  for (ConstraintManager::const_iterator it = query.constraints.begin(), 
-         ie = query.constraints.end(); it != ie; ++it)
-    worklist.push_back(std::make_pair(*it, IndependentElementSet(*it)));
-
-  // XXX This should be more efficient (in terms of low level copy stuff).
-  bool done = false;
-  do {
-    done = true;
-    std::vector< std::pair<ref<Expr>, IndependentElementSet> > newWorklist;
-    for (std::vector< std::pair<ref<Expr>, IndependentElementSet> >::iterator
-           it = worklist.begin(), ie = worklist.end(); it != ie; ++it) {
-      if (it->second.intersects(eltsClosure)) {
-        if (eltsClosure.add(it->second))
-          done = false;
-        result.push_back(it->first);
-        // Means that we have added (z=y)added to (x=y)
-        // Now need to see if there are any (z=?)'s
-      } else {
-        newWorklist.push_back(*it);
-      }
+
+  // Only the constraints on the arrays of the closure may join it, and those
+  // on an array need to be looked at again only when a constraint on the
+  // array joins
+  std::vector<bool> required(constraintSets.size(), false);
+  std::vector<const Array *> worklist;
+  std::set<const Array *> queued;
+  eltsClosure.getArrays(worklist);
+  queued.insert(worklist.begin(), worklist.end());
+  while (!worklist.empty()) {
+    const Array *array = worklist.back();
+    worklist.pop_back();
+    queued.erase(array);
+
+    ArrayIndex::const_iterator it = arrayIndex.find(array);
+    if (it == arrayIndex.end())
+      continue;
+    for (std::vector<unsigned>::const_iterator it2 = it->second.begin(),
+                                               ie2 = it->second.end();
+         it2 != ie2; ++it2) {
+      const IndependentElementSet &set = constraintSets[*it2];
+      if (required[*it2] || !set.intersects(eltsClosure))
+        continue;
+      required[*it2] = true;
+      eltsClosure.add(set);
+      std::vector<const Array *> arrays;
+      set.getArrays(arrays);
+      for (std::vector<const Array *>::iterator it3 = arrays.begin(),
+                                                ie3 = arrays.end();
+           it3 != ie3; ++it3)
+        if (queued.insert(*it3).second)
+          worklist.push_back(*it3);
     }
-    worklist.swap(newWorklist);
-  } while (!done);
+  }
+
+  // The required constraints are kept in the order of the query
+  ConstraintManager::const_iterator constraintIt = query.constraints.begin();
+  for (unsigned i = 0; i < required.size(); ++i, ++constraintIt)
+    if (required[i])
+      result.push_back(*constraintIt);
 
   KLEE_DEBUG(
     std::set< ref<Expr> > reqset(result.begin(), result.end());
@@ -394,6 +564,23 @@ class IndependentSolver : public SolverImpl {
 private:
   Solver *solver;
 
+  /// \brief The constraints of the last query
+  std::vector<ref<Expr> > cachedConstraints;
+
+  /// \brief The element sets of cachedConstraints, in the same order
+  std::vector<IndependentElementSet> cachedConstraintSets;
+
+  /// \brief The constraints of cachedConstraints that access each array
+  ArrayIndex cachedArrayIndex;
+
+  /// \brief Compute the element sets of the constraints of the query.
+  ///
+  /// Consecutive queries on the same path share the constraints of the
+  /// path condition as a prefix, hence only the element sets of the
+  /// constraints not in the prefix of the last query are built.
+  const std::vector<IndependentElementSet> &
+  getConstraintSets(const Query &query);
+
 public:
   IndependentSolver(Solver *_solver) 
     : solver(_solver) {}
@@ -412,15 +599,61 @@ public:
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query&);
   void setCoreSolverTimeout(double timeout);
+  void releaseMemory();
 };
 
-  
+const std::vector<IndependentElementSet> &
+IndependentSolver::getConstraintSets(const Query &query) {
+  size_t common = 0;
+  if (IndependentFactorCache) {
+    std::vector<ref<Expr> >::iterator cachedIt = cachedConstraints.begin(),
+                                      cachedIe = cachedConstraints.end();
+    for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                           ie = query.constraints.end();
+         it != ie && cachedIt != cachedIe && it->get() == cachedIt->get();
+         ++it, ++cachedIt)
+      ++common;
+  }
+
+  if (common < cachedConstraints.size()) {
+    for (ArrayIndex::iterator it = cachedArrayIndex.begin(),
+                              ie = cachedArrayIndex.end();
+         it != ie;) {
+      std::vector<unsigned> &indices = it->second;
+      while (!indices.empty() && indices.back() >= common)
+        indices.pop_back();
+      if (indices.empty())
+        cachedArrayIndex.erase(it++);
+      else
+        ++it;
+    }
+  }
+  cachedConstraints.resize(common);
+  cachedConstraintSets.resize(common);
+  for (ConstraintManager::const_iterator it = query.constraints.begin() + common,
+                                         ie = query.constraints.end();
+       it != ie; ++it) {
+    cachedConstraints.push_back(*it);
+    cachedConstraintSets.push_back(IndependentElementSet(*it));
+
+    std::vector<const Array *> arrays;
+    cachedConstraintSets.back().getArrays(arrays);
+    for (std::vector<const Array *>::iterator it2 = arrays.begin(),
+                                              ie2 = arrays.end();
+         it2 != ie2; ++it2)
+      cachedArrayIndex[*it2].push_back(cachedConstraintSets.size() - 1);
+  }
+  return cachedConstraintSets;
+}
+
 bool IndependentSolver::computeValidity(const Query &query,
                                         Solver::Validity &result,
                                         std::vector<ref<Expr> > &unsatCore) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure =
-    getIndependentConstraints(query, required);
+  const std::vector<IndependentElementSet> &constraintSets =
+      getConstraintSets(query);
+  IndependentElementSet eltsClosure = getIndependentConstraints(
+      query, constraintSets, cachedArrayIndex, required);
   ConstraintManager tmp(required);
   return solver->impl->computeValidity(Query(tmp, query.expr), result,
                                        unsatCore);
@@ -429,16 +662,20 @@ bool IndependentSolver::computeValidity(const Query &query,
 bool IndependentSolver::computeTruth(const Query &query, bool &isValid,
                                      std::vector<ref<Expr> > &unsatCore) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure = 
-    getIndependentConstraints(query, required);
+  const std::vector<IndependentElementSet> &constraintSets =
+      getConstraintSets(query);
+  IndependentElementSet eltsClosure = getIndependentConstraints(
+      query, constraintSets, cachedArrayIndex, required);
   ConstraintManager tmp(required);
   return solver->impl->computeTruth(Query(tmp, query.expr), isValid, unsatCore);
 }
 
 bool IndependentSolver::computeValue(const Query& query, ref<Expr> &result) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure = 
-    getIndependentConstraints(query, required);
+  const std::vector<IndependentElementSet> &constraintSets =
+      getConstraintSets(query);
+  IndependentElementSet eltsClosure = getIndependentConstraints(
+      query, constraintSets, cachedArrayIndex, required);
   ConstraintManager tmp(required);
   return solver->impl->computeValue(Query(tmp, query.expr), result);
 }
@@ -480,6 +717,100 @@ bool assertCreatedPointEvaluatesToTrue(
   return cast<ConstantExpr>(q)->isTrue();
 }
 
+/// Solve the factors in child processes, each taking every so many factors,
+/// and store the solutions of the satisfiable ones. The others are left to
+/// be solved in this process, which also computes the unsatisfiability core.
+static void
+solveInProcesses(SolverImpl *solver,
+                 const std::vector<IndependentElementSet *> &factors,
+                 const std::vector<std::vector<const Array *> > &arrays,
+                 std::vector<std::vector<std::vector<unsigned char> > > &values,
+                 std::vector<bool> &solved) {
+  std::vector<size_t> offsets;
+  size_t regionSize = 0;
+  for (unsigned i = 0; i < factors.size(); ++i) {
+    offsets.push_back(regionSize);
+    regionSize += sizeof(FactorSlot);
+    for (unsigned j = 0; j < arrays[i].size(); ++j)
+      regionSize += arrays[i][j]->size;
+    regionSize = (regionSize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+  }
+
+  void *region = mmap(NULL, regionSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED) {
+    klee_warning("unable to map shared memory for the independent solver");
+    return;
+  }
+  for (unsigned i = 0; i < factors.size(); ++i)
+    reinterpret_cast<FactorSlot *>(static_cast<char *>(region) + offsets[i])
+        ->state = FactorSlot::FAILED;
+
+  unsigned processes =
+      std::min((unsigned)factors.size(), (unsigned)IndependentSolverProcesses);
+  fflush(stdout);
+  fflush(stderr);
+  std::vector<pid_t> pids;
+  for (unsigned k = 0; k < processes; ++k) {
+    pid_t pid = fork();
+    if (pid == -1) {
+      klee_warning("fork failed (for the independent solver)");
+      break;
+    }
+    if (pid != 0) {
+      pids.push_back(pid);
+      continue;
+    }
+
+    for (unsigned i = k; i < factors.size(); i += processes) {
+      FactorSlot *slot = reinterpret_cast<FactorSlot *>(
+          static_cast<char *>(region) + offsets[i]);
+      ConstraintManager tmp(factors[i]->exprs);
+      std::vector<std::vector<unsigned char> > factorValues;
+      std::vector<ref<Expr> > unsatCore;
+      bool hasSolution;
+      if (!solver->computeInitialValues(
+              Query(tmp, ConstantExpr::alloc(0, Expr::Bool)), arrays[i],
+              factorValues, hasSolution, unsatCore))
+        continue;
+      if (!hasSolution) {
+        slot->state = FactorSlot::UNSOLVABLE;
+        continue;
+      }
+      unsigned char *pos = reinterpret_cast<unsigned char *>(slot + 1);
+      for (unsigned j = 0; j < factorValues.size(); ++j) {
+        std::copy(factorValues[j].begin(), factorValues[j].end(), pos);
+        pos += factorValues[j].size();
+      }
+      slot->state = FactorSlot::SOLVABLE;
+    }
+    _exit(0);
+  }
+
+  for (std::vector<pid_t>::iterator it = pids.begin(), ie = pids.end();
+       it != ie; ++it) {
+    int status;
+    while (waitpid(*it, &status, 0) < 0 && errno == EINTR)
+      ;
+  }
+
+  for (unsigned i = 0; i < factors.size(); ++i) {
+    FactorSlot *slot = reinterpret_cast<FactorSlot *>(
+        static_cast<char *>(region) + offsets[i]);
+    if (slot->state != FactorSlot::SOLVABLE)
+      continue;
+    unsigned char *pos = reinterpret_cast<unsigned char *>(slot + 1);
+    values[i].clear();
+    for (unsigned j = 0; j < arrays[i].size(); ++j) {
+      values[i].push_back(
+          std::vector<unsigned char>(pos, pos + arrays[i][j]->size));
+      pos += arrays[i][j]->size;
+    }
+    solved[i] = true;
+  }
+  munmap(region, regionSize);
+}
+
 bool IndependentSolver::computeInitialValues(
     const Query &query, const std::vector<const Array *> &objects,
     std::vector<std::vector<unsigned char> > &values, bool &hasSolution,
@@ -490,10 +821,11 @@ bool IndependentSolver::computeInitialValues(
   hasSolution = true;
   // FIXME: When we switch to C++11 this should be a std::unique_ptr so we don't need
   // to remember to manually call delete
-  std::list<IndependentElementSet> *factors = getAllIndependentConstraintsSets(query);
+  std::list<IndependentElementSet> *factors =
+      getAllIndependentConstraintsSets(query, getConstraintSets(query));
 
-  //Used to rearrange all of the answers into the correct order
-  std::map<const Array*, std::vector<unsigned char> > retMap;
+  std::vector<IndependentElementSet *> solvedFactors;
+  std::vector<std::vector<const Array *> > factorArrays;
   for (std::list<IndependentElementSet>::iterator it = factors->begin();
        it != factors->end(); ++it) {
     std::vector<const Array*> arraysInFactor;
@@ -503,15 +835,39 @@ bool IndependentSolver::computeInitialValues(
     if (arraysInFactor.size() == 0){
       continue;
     }
+    solvedFactors.push_back(&*it);
+    factorArrays.push_back(arraysInFactor);
+  }
+
+  std::vector<std::vector<std::vector<unsigned char> > > factorValues(
+      solvedFactors.size());
+  std::vector<bool> solved(solvedFactors.size(), false);
+  if (IndependentSolverProcesses > 1 && solvedFactors.size() > 1)
+    solveInProcesses(solver->impl, solvedFactors, factorArrays, factorValues,
+                     solved);
+
+  //Used to rearrange all of the answers into the correct order
+  std::map<const Array*, std::vector<unsigned char> > retMap;
+  for (unsigned f = 0; f < solvedFactors.size(); ++f) {
+    IndependentElementSet *it = solvedFactors[f];
+    std::vector<const Array *> &arraysInFactor = factorArrays[f];
+    std::vector<std::vector<unsigned char> > &tempValues = factorValues[f];
     ConstraintManager tmp(it->exprs);
-    std::vector<std::vector<unsigned char> > tempValues;
-    if (!solver->impl->computeInitialValues(
+    if (!solved[f] &&
+        !solver->impl->computeInitialValues(
              Query(tmp, ConstantExpr::alloc(0, Expr::Bool)), arraysInFactor,
              tempValues, hasSolution, unsatCore)) {
       values.clear();
       delete factors;
       return false;
-    } else if (!hasSolution){
+    } else if (!solved[f] && !hasSolution){
+      // The core is that of the unsatisfiable factor alone. The negation of
+      // the query expression is not a constraint of the query.
+      if (!unsatCore.empty() && !isa<ConstantExpr>(query.expr)) {
+        ref<Expr> neg = Expr::createIsZero(query.expr);
+        unsatCore.erase(std::remove(unsatCore.begin(), unsatCore.end(), neg),
+                        unsatCore.end());
+      }
       values.clear();
       delete factors;
       return true;
@@ -526,8 +882,10 @@ bool IndependentSolver::computeInitialValues(
           std::vector<unsigned char> * tempPtr = &retMap[arraysInFactor[i]];
           assert(tempPtr->size() == tempValues[i].size() &&
                  "we're talking about the same array here");
-          ::DenseSet<unsigned> * ds = &(it->elements[arraysInFactor[i]]);
-          for (std::set<unsigned>::iterator it2 = ds->begin(); it2 != ds->end(); it2++){
+          std::vector<unsigned> indices;
+          it->elements[arraysInFactor[i]].getElements(indices);
+          for (std::vector<unsigned>::iterator it2 = indices.begin();
+               it2 != indices.end(); it2++){
             unsigned index = * it2;
             (* tempPtr)[index] = tempValues[i][index];
           }
@@ -569,6 +927,13 @@ void IndependentSolver::setCoreSolverTimeout(double timeout) {
   solver->impl->setCoreSolverTimeout(timeout);
 }
 
+void IndependentSolver::releaseMemory() {
+  cachedConstraints.clear();
+  cachedConstraintSets.clear();
+  cachedArrayIndex.clear();
+  solver->impl->releaseMemory();
+}
+
 Solver *klee::createIndependentSolver(Solver *s) {
   return new Solver(new IndependentSolver(s));
 }
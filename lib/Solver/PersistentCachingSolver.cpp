@@ -0,0 +1,770 @@
+//===-- PersistentCachingSolver.cpp - On-disk query cache -----------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A solver layer caching the results of the queries in a file, such that they
+// can be reused by later runs, and by the other runs sharing the file.
+//
+// The queries are keyed by a 128-bit digest of their structure, in which the
+// arrays are numbered in the order of their first occurrence, such that the
+// same query made of differently named arrays, in another run, has the same
+// key. The file is a sequence of records, each holding a key, the kind of the
+// query and its result, and is only ever appended to. The file is mapped at
+// startup, and the last record of each key wins. The appends are atomic
+// writes under an exclusive lock, such that several runs can share the file.
+//
+// The size of the file is bounded: when it exceeds its limit at startup, it is
+// compacted into its most recently used records. The records that are hit in
+// the older half of the file are appended again, such that the compaction
+// approximates an LRU policy.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SolverImpl.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <map>
+#include <sstream>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// A 128-bit digest, in two independently mixed lanes
+struct Digest {
+  uint64_t a, b;
+
+  Digest() : a(0xcbf29ce484222325ULL), b(0x6a09e667f3bcc909ULL) {}
+
+  void add(uint64_t v) {
+    a = (a ^ v) * 0x100000001b3ULL;
+    a ^= a >> 29;
+    b = (b + v) * 0x9e3779b97f4a7c15ULL;
+    b ^= b >> 32;
+  }
+
+  void add(const Digest &d) {
+    add(d.a);
+    add(d.b);
+  }
+
+  bool operator<(const Digest &d) const {
+    return a < d.a || (a == d.a && b < d.b);
+  }
+};
+
+/// The kinds of the cached queries
+enum QueryKind {
+  ValidityQuery = 1,
+  TruthQuery,
+  ValueQuery,
+  InitialValuesQuery
+};
+
+/// Computes the digest of a query, independent of the names of its arrays
+/// and of the sharing of its subexpressions.
+class QueryHasher {
+  llvm::DenseMap<const Array *, unsigned> arrayIds;
+  llvm::DenseMap<const Expr *, Digest> exprs;
+  llvm::DenseMap<const UpdateNode *, Digest> updates;
+
+  /// Set when the query holds expressions that are not meaningful across
+  /// runs, such as those of the weakest precondition
+  bool failed;
+
+  Digest visitArray(const Array *array) {
+    Digest d;
+    std::pair<llvm::DenseMap<const Array *, unsigned>::iterator, bool> res =
+        arrayIds.insert(std::make_pair(array, arrayIds.size()));
+    d.add(res.first->second);
+    if (!res.second)
+      return d;
+    d.add(array->size);
+    d.add(array->domain);
+    d.add(array->range);
+    for (std::vector<ref<ConstantExpr> >::const_iterator
+             it = array->constantValues.begin(),
+             ie = array->constantValues.end();
+         it != ie; ++it)
+      d.add((*it)->getZExtValue());
+    return d;
+  }
+
+  Digest visitUpdates(const UpdateNode *head) {
+    // Walk down to the first node already visited, then hash back up, as the
+    // update lists can be too long to recurse on
+    std::vector<const UpdateNode *> pending;
+    Digest d;
+    for (const UpdateNode *un = head; un; un = un->next) {
+      llvm::DenseMap<const UpdateNode *, Digest>::iterator it =
+          updates.find(un);
+      if (it != updates.end()) {
+        d = it->second;
+        break;
+      }
+      pending.push_back(un);
+    }
+    for (std::vector<const UpdateNode *>::reverse_iterator
+             it = pending.rbegin(),
+             ie = pending.rend();
+         it != ie; ++it) {
+      Digest node;
+      node.add(d);
+      node.add(visit((*it)->index));
+      node.add(visit((*it)->value));
+      updates[*it] = node;
+      d = node;
+    }
+    return d;
+  }
+
+public:
+  QueryHasher() : failed(false) {}
+
+  bool hasFailed() const { return failed; }
+
+  Digest visit(const ref<Expr> &e) {
+    llvm::DenseMap<const Expr *, Digest>::iterator it = exprs.find(e.get());
+    if (it != exprs.end())
+      return it->second;
+
+    Digest d;
+    Expr::Kind kind = e->getKind();
+    d.add(kind);
+    d.add(e->getWidth());
+
+    if (kind > Expr::LastKind) {
+      failed = true;
+    } else if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(e)) {
+      const llvm::APInt &value = ce->getAPValue();
+      for (unsigned i = 0, n = value.getNumWords(); i != n; ++i)
+        d.add(value.getRawData()[i]);
+    } else if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+      d.add(visitArray(re->updates.root));
+      d.add(visitUpdates(re->updates.head));
+    } else if (const ExtractExpr *ee = dyn_cast<ExtractExpr>(e)) {
+      d.add(ee->offset);
+    }
+
+    if (const ExistsExpr *xe = dyn_cast<ExistsExpr>(e)) {
+      // The bound arrays are identified by their occurrences in the body
+      d.add(visit(xe->body));
+      std::vector<unsigned> ids;
+      unsigned unused = 0;
+      for (std::set<const Array *>::const_iterator
+               it = xe->variables.begin(),
+               ie = xe->variables.end();
+           it != ie; ++it) {
+        llvm::DenseMap<const Array *, unsigned>::iterator id =
+            arrayIds.find(*it);
+        if (id == arrayIds.end())
+          ++unused;
+        else
+          ids.push_back(id->second);
+      }
+      std::sort(ids.begin(), ids.end());
+      for (std::vector<unsigned>::iterator it = ids.begin(), ie = ids.end();
+           it != ie; ++it)
+        d.add(*it);
+      d.add(unused);
+    } else {
+      for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+        d.add(visit(e->getKid(i)));
+    }
+
+    exprs[e.get()] = d;
+    return d;
+  }
+
+  /// The digest of the query, its kind, and the arrays whose values are
+  /// asked for
+  Digest visit(const Query &query, QueryKind kind,
+               const std::vector<const Array *> &objects) {
+    Digest d;
+    d.add(kind);
+    d.add(query.constraints.size());
+    for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                           ie = query.constraints.end();
+         it != ie; ++it)
+      d.add(visit(*it));
+    d.add(visit(query.expr));
+    d.add(objects.size());
+    for (std::vector<const Array *>::const_iterator it = objects.begin(),
+                                                    ie = objects.end();
+         it != ie; ++it)
+      d.add(visitArray(*it));
+    return d;
+  }
+};
+
+/// Serializes the payload of a record
+class RecordWriter {
+  std::vector<unsigned char> &bytes;
+
+public:
+  RecordWriter(std::vector<unsigned char> &_bytes) : bytes(_bytes) {}
+
+  void put(uint64_t v) {
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(&v);
+    bytes.insert(bytes.end(), p, p + sizeof(v));
+  }
+
+  void put(const std::vector<unsigned char> &v) {
+    put(v.size());
+    bytes.insert(bytes.end(), v.begin(), v.end());
+  }
+};
+
+/// Deserializes the payload of a record, failing on truncated ones
+class RecordReader {
+  const unsigned char *pos, *end;
+  bool failed;
+
+public:
+  RecordReader(const unsigned char *begin, uint64_t size)
+      : pos(begin), end(begin + size), failed(false) {}
+
+  bool hasFailed() const { return failed; }
+
+  uint64_t get() {
+    uint64_t v = 0;
+    if (end - pos < (ptrdiff_t)sizeof(v)) {
+      failed = true;
+      return v;
+    }
+    memcpy(&v, pos, sizeof(v));
+    pos += sizeof(v);
+    return v;
+  }
+
+  void get(std::vector<unsigned char> &v) {
+    uint64_t size = get();
+    if (failed || (uint64_t)(end - pos) < size) {
+      failed = true;
+      return;
+    }
+    v.assign(pos, pos + size);
+    pos += size;
+  }
+};
+
+/// The header of a record in the cache file, followed by its payload
+struct RecordHeader {
+  uint32_t magic;
+  uint32_t size;
+  uint64_t keyA, keyB;
+  /// The digest of the payload, to detect the records torn by a crash
+  uint64_t check;
+};
+
+const uint32_t RecordMagic = 0x4b514331; // "KQC1"
+
+uint64_t checkPayload(const unsigned char *data, uint64_t size) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (uint64_t i = 0; i != size; ++i)
+    h = (h ^ data[i]) * 0x100000001b3ULL;
+  return h;
+}
+
+/// The file of the cache, mapped at startup and appended to afterwards
+class CacheFile {
+  struct Record {
+    /// The offset of the record, to tell the older records apart
+    uint64_t offset;
+    /// The payload, in the mapping of the file or in owned
+    const unsigned char *data;
+    uint64_t size;
+    std::vector<unsigned char> owned;
+  };
+
+  std::string path;
+  uint64_t maxSize;
+  int fd;
+  void *mapping;
+  uint64_t mappedSize;
+  uint64_t appendedSize;
+  std::map<Digest, Record> records;
+
+  void scan(const unsigned char *data, uint64_t size);
+  void compact();
+  bool reopenIfReplaced();
+
+public:
+  CacheFile(const std::string &_path, uint64_t _maxSize);
+  ~CacheFile();
+
+  bool isOpen() const { return fd >= 0; }
+
+  /// Find the payload of a key. Returns false on a miss.
+  bool lookup(const Digest &key, const unsigned char *&data, uint64_t &size);
+
+  void append(const Digest &key, const std::vector<unsigned char> &payload);
+};
+
+CacheFile::CacheFile(const std::string &_path, uint64_t _maxSize)
+    : path(_path), maxSize(_maxSize), fd(-1), mapping(0), mappedSize(0),
+      appendedSize(0) {
+  fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    klee_warning("unable to open the solver cache file %s: %s", path.c_str(),
+                 strerror(errno));
+    return;
+  }
+
+  struct stat st;
+  if (maxSize && fstat(fd, &st) == 0 && (uint64_t)st.st_size > maxSize)
+    compact();
+  if (fd < 0)
+    return;
+
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    mapping = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+      mapping = 0;
+      klee_warning("unable to map the solver cache file %s", path.c_str());
+    } else {
+      mappedSize = st.st_size;
+      scan(static_cast<const unsigned char *>(mapping), mappedSize);
+    }
+  }
+  klee_message("Using the solver cache file %s (%lu entries)", path.c_str(),
+               (unsigned long)records.size());
+}
+
+CacheFile::~CacheFile() {
+  if (mapping)
+    munmap(mapping, mappedSize);
+  if (fd >= 0)
+    close(fd);
+}
+
+void CacheFile::scan(const unsigned char *data, uint64_t size) {
+  uint64_t offset = 0;
+  while (size - offset >= sizeof(RecordHeader)) {
+    RecordHeader header;
+    memcpy(&header, data + offset, sizeof(header));
+    const unsigned char *payload = data + offset + sizeof(header);
+    // A torn record ends the usable part of the file; the later appends are
+    // still written after it, and ignored until the next compaction.
+    if (header.magic != RecordMagic ||
+        size - offset - sizeof(header) < header.size ||
+        checkPayload(payload, header.size) != header.check)
+      break;
+
+    Digest key;
+    key.a = header.keyA;
+    key.b = header.keyB;
+    Record &record = records[key];
+    record.offset = offset;
+    record.data = payload;
+    record.size = header.size;
+    offset += sizeof(header) + header.size;
+  }
+}
+
+/// Orders the records from the most recent one
+struct RecordOrder {
+  bool operator()(const std::pair<uint64_t, const unsigned char *> &a,
+                  const std::pair<uint64_t, const unsigned char *> &b) const {
+    return a.first > b.first;
+  }
+};
+
+void CacheFile::compact() {
+  if (flock(fd, LOCK_EX) < 0)
+    return;
+  // Another run may have compacted the file while this one was waiting
+  struct stat st;
+  if (reopenIfReplaced() || fstat(fd, &st) < 0 ||
+      (uint64_t)st.st_size <= maxSize) {
+    flock(fd, LOCK_UN);
+    return;
+  }
+
+  void *old = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (old == MAP_FAILED) {
+    flock(fd, LOCK_UN);
+    return;
+  }
+  scan(static_cast<const unsigned char *>(old), st.st_size);
+
+  // Keep the most recent records, up to three quarters of the limit, such
+  // that the file is not compacted again by the next run
+  std::vector<std::pair<uint64_t, const unsigned char *> > order;
+  for (std::map<Digest, Record>::iterator it = records.begin(),
+                                          ie = records.end();
+       it != ie; ++it)
+    order.push_back(std::make_pair(it->second.offset,
+                                   it->second.data - sizeof(RecordHeader)));
+  std::sort(order.begin(), order.end(), RecordOrder());
+
+  std::vector<unsigned char> kept;
+  uint64_t budget = maxSize / 4 * 3;
+  for (std::vector<std::pair<uint64_t, const unsigned char *> >::iterator
+           it = order.begin(),
+           ie = order.end();
+       it != ie; ++it) {
+    RecordHeader header;
+    memcpy(&header, it->second, sizeof(header));
+    uint64_t size = sizeof(header) + header.size;
+    if (kept.size() + size > budget)
+      break;
+    kept.insert(kept.end(), it->second, it->second + size);
+  }
+  records.clear();
+  munmap(old, st.st_size);
+
+  std::ostringstream tmp;
+  tmp << path << ".tmp." << getpid();
+  int tmpFd = open(tmp.str().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool written = tmpFd >= 0 && (kept.empty() ||
+                                write(tmpFd, &kept[0], kept.size()) ==
+                                    (ssize_t)kept.size());
+  if (tmpFd >= 0)
+    close(tmpFd);
+  if (!written || rename(tmp.str().c_str(), path.c_str()) < 0) {
+    klee_warning("unable to compact the solver cache file %s", path.c_str());
+    unlink(tmp.str().c_str());
+    flock(fd, LOCK_UN);
+    return;
+  }
+
+  // The runs appending to the old file reopen it under the lock
+  flock(fd, LOCK_UN);
+  reopenIfReplaced();
+}
+
+bool CacheFile::reopenIfReplaced() {
+  struct stat current, opened;
+  if (stat(path.c_str(), &current) < 0 || fstat(fd, &opened) < 0 ||
+      (current.st_dev == opened.st_dev && current.st_ino == opened.st_ino))
+    return false;
+
+  int newFd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (newFd < 0)
+    return false;
+  close(fd);
+  fd = newFd;
+  return true;
+}
+
+bool CacheFile::lookup(const Digest &key, const unsigned char *&data,
+                       uint64_t &size) {
+  std::map<Digest, Record>::iterator it = records.find(key);
+  if (it == records.end())
+    return false;
+
+  Record &record = it->second;
+  data = record.data;
+  size = record.size;
+  if (record.offset < mappedSize / 2) {
+    // Move the record to the younger part of the file, which survives the
+    // compaction
+    std::vector<unsigned char> payload(data, data + size);
+    append(key, payload);
+    data = record.data;
+    size = record.size;
+  }
+  return true;
+}
+
+void CacheFile::append(const Digest &key,
+                       const std::vector<unsigned char> &payload) {
+  Record &record = records[key];
+  record.offset = mappedSize + appendedSize;
+  record.owned = payload;
+  record.data = record.owned.empty() ? 0 : &record.owned[0];
+  record.size = record.owned.size();
+
+  RecordHeader header;
+  header.magic = RecordMagic;
+  header.size = payload.size();
+  header.keyA = key.a;
+  header.keyB = key.b;
+  header.check = checkPayload(record.data, record.size);
+
+  std::vector<unsigned char> bytes(
+      reinterpret_cast<const unsigned char *>(&header),
+      reinterpret_cast<const unsigned char *>(&header) + sizeof(header));
+  bytes.insert(bytes.end(), payload.begin(), payload.end());
+  appendedSize += bytes.size();
+
+  // A single write to a file opened for appending is not interleaved with
+  // those of the other runs holding the lock
+  if (fd < 0 || flock(fd, LOCK_EX) < 0)
+    return;
+  reopenIfReplaced();
+  if (write(fd, &bytes[0], bytes.size()) != (ssize_t)bytes.size())
+    klee_warning_once(this, "unable to write to the solver cache file %s",
+                      path.c_str());
+  flock(fd, LOCK_UN);
+}
+
+class PersistentCachingSolver : public SolverImpl {
+  Solver *solver;
+  CacheFile file;
+
+  bool lookup(const Query &query, QueryKind kind,
+              const std::vector<const Array *> &objects, Digest &key,
+              RecordReader *&reader);
+
+  /// Append the unsatisfiability core, as the positions of its elements in
+  /// the constraints of the query
+  static void putCore(RecordWriter &writer, const Query &query,
+                      const std::vector<ref<Expr> > &core);
+  static bool getCore(RecordReader &reader, const Query &query,
+                      std::vector<ref<Expr> > &core);
+
+public:
+  PersistentCachingSolver(Solver *s, const std::string &path,
+                          uint64_t maxSize)
+      : solver(s), file(path, maxSize) {}
+  ~PersistentCachingSolver() { delete solver; }
+
+  bool computeValidity(const Query &, Solver::Validity &result,
+                       std::vector<ref<Expr> > &unsatCore);
+  bool computeTruth(const Query &, bool &isValid,
+                    std::vector<ref<Expr> > &unsatCore);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution,
+                            std::vector<ref<Expr> > &unsatCore);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(double timeout);
+  void releaseMemory();
+};
+}
+
+/// Computes the key of the query, and looks it up. Returns false when the
+/// query cannot be cached; reader is null on a miss.
+bool PersistentCachingSolver::lookup(const Query &query, QueryKind kind,
+                                     const std::vector<const Array *> &objects,
+                                     Digest &key, RecordReader *&reader) {
+  reader = 0;
+  if (!file.isOpen())
+    return false;
+  QueryHasher hasher;
+  key = hasher.visit(query, kind, objects);
+  if (hasher.hasFailed())
+    return false;
+
+  const unsigned char *data;
+  uint64_t size;
+  if (file.lookup(key, data, size))
+    reader = new RecordReader(data, size);
+  return true;
+}
+
+void PersistentCachingSolver::putCore(RecordWriter &writer, const Query &query,
+                                      const std::vector<ref<Expr> > &core) {
+  std::vector<uint64_t> indices;
+  for (std::vector<ref<Expr> >::const_iterator it = core.begin(),
+                                               ie = core.end();
+       it != ie; ++it) {
+    uint64_t index = 0;
+    ConstraintManager::const_iterator constraintIt = query.constraints.begin(),
+                                      constraintIe = query.constraints.end();
+    for (; constraintIt != constraintIe; ++constraintIt, ++index)
+      if (*constraintIt == *it)
+        break;
+    if (constraintIt != constraintIe)
+      indices.push_back(index);
+  }
+  writer.put(indices.size());
+  for (std::vector<uint64_t>::iterator it = indices.begin(),
+                                       ie = indices.end();
+       it != ie; ++it)
+    writer.put(*it);
+}
+
+bool PersistentCachingSolver::getCore(RecordReader &reader, const Query &query,
+                                      std::vector<ref<Expr> > &core) {
+  core.clear();
+  uint64_t n = reader.get();
+  for (uint64_t i = 0; i != n && !reader.hasFailed(); ++i) {
+    uint64_t index = reader.get();
+    if (index >= query.constraints.size())
+      break;
+    core.push_back(*(query.constraints.begin() + index));
+  }
+  if (core.size() == n && !reader.hasFailed())
+    return true;
+  core.clear();
+  return false;
+}
+
+bool PersistentCachingSolver::computeValidity(
+    const Query &query, Solver::Validity &result,
+    std::vector<ref<Expr> > &unsatCore) {
+  Digest key;
+  RecordReader *reader;
+  bool cacheable = lookup(query, ValidityQuery,
+                          std::vector<const Array *>(), key, reader);
+  if (reader) {
+    result = (Solver::Validity)(int64_t)reader->get();
+    bool hit = getCore(*reader, query, unsatCore);
+    delete reader;
+    if (hit)
+      return true;
+  }
+
+  if (!solver->impl->computeValidity(query, result, unsatCore))
+    return false;
+
+  if (cacheable) {
+    std::vector<unsigned char> payload;
+    RecordWriter writer(payload);
+    writer.put((int64_t)result);
+    putCore(writer, query, unsatCore);
+    file.append(key, payload);
+  }
+  return true;
+}
+
+bool PersistentCachingSolver::computeTruth(const Query &query, bool &isValid,
+                                           std::vector<ref<Expr> > &unsatCore) {
+  Digest key;
+  RecordReader *reader;
+  bool cacheable =
+      lookup(query, TruthQuery, std::vector<const Array *>(), key, reader);
+  if (reader) {
+    isValid = reader->get();
+    bool hit = getCore(*reader, query, unsatCore);
+    delete reader;
+    if (hit)
+      return true;
+  }
+
+  if (!solver->impl->computeTruth(query, isValid, unsatCore))
+    return false;
+
+  if (cacheable) {
+    std::vector<unsigned char> payload;
+    RecordWriter writer(payload);
+    writer.put(isValid);
+    putCore(writer, query, unsatCore);
+    file.append(key, payload);
+  }
+  return true;
+}
+
+bool PersistentCachingSolver::computeValue(const Query &query,
+                                           ref<Expr> &result) {
+  Digest key;
+  RecordReader *reader;
+  bool cacheable =
+      lookup(query, ValueQuery, std::vector<const Array *>(), key, reader);
+  if (reader) {
+    Expr::Width width = reader->get();
+    uint64_t value = reader->get();
+    bool hit = !reader->hasFailed() && width && width <= 64;
+    delete reader;
+    if (hit) {
+      result = ConstantExpr::create(value, width);
+      return true;
+    }
+  }
+
+  if (!solver->impl->computeValue(query, result))
+    return false;
+
+  // Only the values that fit in a word are cached
+  ConstantExpr *ce = dyn_cast<ConstantExpr>(result);
+  if (cacheable && ce && ce->getWidth() <= 64) {
+    std::vector<unsigned char> payload;
+    RecordWriter writer(payload);
+    writer.put(ce->getWidth());
+    writer.put(ce->getZExtValue());
+    file.append(key, payload);
+  }
+  return true;
+}
+
+bool PersistentCachingSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution,
+    std::vector<ref<Expr> > &unsatCore) {
+  Digest key;
+  RecordReader *reader;
+  bool cacheable = lookup(query, InitialValuesQuery, objects, key, reader);
+  if (reader) {
+    hasSolution = reader->get();
+    values.clear();
+    if (hasSolution) {
+      values.resize(objects.size());
+      for (unsigned i = 0, n = objects.size(); i != n; ++i)
+        reader->get(values[i]);
+    }
+    bool hit = getCore(*reader, query, unsatCore);
+    delete reader;
+    if (hit)
+      return true;
+  }
+
+  if (!solver->impl->computeInitialValues(query, objects, values, hasSolution,
+                                          unsatCore))
+    return false;
+
+  if (cacheable) {
+    std::vector<unsigned char> payload;
+    RecordWriter writer(payload);
+    writer.put(hasSolution);
+    if (hasSolution)
+      for (std::vector<std::vector<unsigned char> >::iterator
+               it = values.begin(),
+               ie = values.end();
+           it != ie; ++it)
+        writer.put(*it);
+    putCore(writer, query, unsatCore);
+    file.append(key, payload);
+  }
+  return true;
+}
+
+SolverImpl::SolverRunStatus PersistentCachingSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *PersistentCachingSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void PersistentCachingSolver::setCoreSolverTimeout(double timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+void PersistentCachingSolver::releaseMemory() {
+  solver->impl->releaseMemory();
+}
+
+///
+
+Solver *klee::createPersistentCachingSolver(Solver *_solver,
+                                            std::string path,
+                                            unsigned maxSizeMB) {
+  return new Solver(new PersistentCachingSolver(
+      _solver, path, (uint64_t)maxSizeMB * 1024 * 1024));
+}
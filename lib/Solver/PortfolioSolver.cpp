@@ -0,0 +1,336 @@
+//===-- PortfolioSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A core solver that runs several backends on the same query in forked
+// processes, and takes the answer of the first one to finish.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/CommandLine.h"
+#include "klee/Constraints.h"
+#include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprUtil.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// \brief The header of the shared memory region of a backend process,
+/// followed by the bytes of the assignment and the indices of the
+/// unsatisfiability core constraints
+struct PortfolioSlot {
+  enum { RUNNING, FAILED, SOLVABLE, UNSOLVABLE };
+  int state;
+  /// \brief Whether the backend has provided an unsatisfiability core
+  int hasCore;
+  unsigned coreSize;
+};
+
+class PortfolioSolver : public SolverImpl {
+private:
+  /// \brief The solvers to run; the first one provides the unsatisfiability
+  /// cores when they are required
+  std::vector<Solver *> solvers;
+
+  SolverRunStatus runStatusCode;
+
+  /// \brief Run all backends on the query in forked processes, and return
+  /// the result of the first one to succeed.
+  bool race(const Query &query, const std::vector<const Array *> &objects,
+            std::vector<std::vector<unsigned char> > &values,
+            bool &hasSolution, std::vector<ref<Expr> > &unsatCore);
+
+  /// \brief Run the backend at the given index in the current (child)
+  /// process, storing its result into the slot, and exit.
+  void runBackend(unsigned index, const Query &query,
+                  const std::vector<const Array *> &objects,
+                  PortfolioSlot *slot, int notifyFd) __attribute__((noreturn));
+
+public:
+  PortfolioSolver(Solver *primary, Solver *secondary)
+      : runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+    solvers.push_back(primary);
+    solvers.push_back(secondary);
+  }
+  ~PortfolioSolver() {
+    for (std::vector<Solver *>::iterator it = solvers.begin(),
+                                         ie = solvers.end();
+         it != ie; ++it)
+      delete *it;
+  }
+
+  bool computeTruth(const Query &, bool &isValid,
+                    std::vector<ref<Expr> > &unsatCore);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution,
+                            std::vector<ref<Expr> > &unsatCore);
+  SolverRunStatus getOperationStatusCode() { return runStatusCode; }
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(double timeout);
+  void releaseMemory();
+};
+
+static unsigned getAssignmentSize(const std::vector<const Array *> &objects) {
+  unsigned size = 0;
+  for (std::vector<const Array *>::const_iterator it = objects.begin(),
+                                                  ie = objects.end();
+       it != ie; ++it)
+    size += (*it)->size;
+  return size;
+}
+
+void PortfolioSolver::runBackend(unsigned index, const Query &query,
+                                 const std::vector<const Array *> &objects,
+                                 PortfolioSlot *slot, int notifyFd) {
+  std::vector<std::vector<unsigned char> > values;
+  std::vector<ref<Expr> > core;
+  bool hasSolution;
+
+  if (!solvers[index]->impl->computeInitialValues(query, objects, values,
+                                                  hasSolution, core)) {
+    slot->state = PortfolioSlot::FAILED;
+  } else {
+    unsigned char *pos = reinterpret_cast<unsigned char *>(slot + 1);
+    if (hasSolution) {
+      for (std::vector<std::vector<unsigned char> >::iterator
+               it = values.begin(),
+               ie = values.end();
+           it != ie; ++it) {
+        std::copy(it->begin(), it->end(), pos);
+        pos += it->size();
+      }
+    } else {
+      // Record the core as the positions of its elements in the constraints
+      // of the query, which the parent maps back onto its own expressions.
+      pos += getAssignmentSize(objects);
+      unsigned *coreIndices = reinterpret_cast<unsigned *>(
+          pos + (sizeof(unsigned) - (uintptr_t)pos % sizeof(unsigned)) %
+                    sizeof(unsigned));
+      unsigned coreSize = 0;
+      for (std::vector<ref<Expr> >::iterator it = core.begin(),
+                                             ie = core.end();
+           it != ie; ++it) {
+        unsigned i = 0;
+        for (ConstraintManager::const_iterator
+                 constraintIt = query.constraints.begin(),
+                 constraintIe = query.constraints.end();
+             constraintIt != constraintIe; ++constraintIt, ++i) {
+          if (*constraintIt == *it) {
+            coreIndices[coreSize++] = i;
+            break;
+          }
+        }
+      }
+      slot->coreSize = coreSize;
+      slot->hasCore = (index == 0);
+    }
+    slot->state =
+        hasSolution ? PortfolioSlot::SOLVABLE : PortfolioSlot::UNSOLVABLE;
+  }
+
+  char done = index;
+  while (write(notifyFd, &done, 1) < 0 && errno == EINTR)
+    ;
+  _exit(0);
+}
+
+bool PortfolioSolver::race(const Query &query,
+                           const std::vector<const Array *> &objects,
+                           std::vector<std::vector<unsigned char> > &values,
+                           bool &hasSolution,
+                           std::vector<ref<Expr> > &unsatCore) {
+  unsigned assignmentSize = getAssignmentSize(objects);
+  size_t slotSize = sizeof(PortfolioSlot) + assignmentSize + sizeof(unsigned) +
+                    query.constraints.size() * sizeof(unsigned);
+  slotSize = (slotSize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+  void *region = mmap(NULL, slotSize * solvers.size(), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED) {
+    klee_warning("unable to map shared memory for the portfolio solver");
+    runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+    return false;
+  }
+
+  int notifyPipe[2];
+  if (pipe(notifyPipe) < 0) {
+    munmap(region, slotSize * solvers.size());
+    klee_warning("unable to create pipe for the portfolio solver");
+    runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+    return false;
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+  std::vector<pid_t> pids;
+  for (unsigned i = 0; i < solvers.size(); ++i) {
+    PortfolioSlot *slot = reinterpret_cast<PortfolioSlot *>(
+        static_cast<char *>(region) + i * slotSize);
+    slot->state = PortfolioSlot::RUNNING;
+    slot->hasCore = 0;
+    slot->coreSize = 0;
+
+    pid_t pid = fork();
+    if (pid == -1) {
+      klee_warning("fork failed (for the portfolio solver)");
+      slot->state = PortfolioSlot::FAILED;
+      continue;
+    }
+    if (pid == 0) {
+      close(notifyPipe[0]);
+      runBackend(i, query, objects, slot, notifyPipe[1]);
+    }
+    pids.push_back(pid);
+  }
+  close(notifyPipe[1]);
+
+  // Wait for the first backend to succeed, or for all of them to fail
+  PortfolioSlot *winner = 0;
+  for (unsigned finished = 0; !winner && finished < pids.size();) {
+    char done;
+    ssize_t res = read(notifyPipe[0], &done, 1);
+    if (res < 0 && errno == EINTR)
+      continue;
+    if (res <= 0)
+      break; // All backends have exited, some without notifying
+    ++finished;
+    PortfolioSlot *slot = reinterpret_cast<PortfolioSlot *>(
+        static_cast<char *>(region) + (unsigned char)done * slotSize);
+    if (slot->state == PortfolioSlot::SOLVABLE ||
+        slot->state == PortfolioSlot::UNSOLVABLE)
+      winner = slot;
+  }
+  close(notifyPipe[0]);
+
+  for (std::vector<pid_t>::iterator it = pids.begin(), ie = pids.end();
+       it != ie; ++it) {
+    kill(*it, SIGKILL);
+    int status;
+    while (waitpid(*it, &status, 0) < 0 && errno == EINTR)
+      ;
+  }
+
+  bool success = (winner != 0);
+  bool coreMissing = false;
+  if (winner) {
+    hasSolution = (winner->state == PortfolioSlot::SOLVABLE);
+    unsigned char *pos = reinterpret_cast<unsigned char *>(winner + 1);
+    values.clear();
+    unsatCore.clear();
+    if (hasSolution) {
+      values.reserve(objects.size());
+      for (std::vector<const Array *>::const_iterator it = objects.begin(),
+                                                      ie = objects.end();
+           it != ie; ++it) {
+        values.push_back(std::vector<unsigned char>(pos, pos + (*it)->size));
+        pos += (*it)->size;
+      }
+    } else if (winner->hasCore) {
+      pos += assignmentSize;
+      unsigned *coreIndices = reinterpret_cast<unsigned *>(
+          pos + (sizeof(unsigned) - (uintptr_t)pos % sizeof(unsigned)) %
+                    sizeof(unsigned));
+      for (unsigned i = 0; i < winner->coreSize; ++i)
+        unsatCore.push_back(
+            *(query.constraints.begin() + coreIndices[i]));
+    } else {
+      coreMissing = INTERPOLATION_ENABLED;
+    }
+    runStatusCode = hasSolution ? SOLVER_RUN_STATUS_SUCCESS_SOLVABLE
+                                : SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+  } else {
+    runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+  }
+  munmap(region, slotSize * solvers.size());
+
+  if (coreMissing) {
+    // Only the primary backend computes the unsatisfiability cores needed by
+    // interpolation: ask it again in this process.
+    success = solvers[0]->impl->computeInitialValues(query, objects, values,
+                                                     hasSolution, unsatCore);
+    runStatusCode = solvers[0]->impl->getOperationStatusCode();
+  }
+  return success;
+}
+
+bool PortfolioSolver::computeTruth(const Query &query, bool &isValid,
+                                   std::vector<ref<Expr> > &unsatCore) {
+  std::vector<const Array *> objects;
+  std::vector<std::vector<unsigned char> > values;
+  bool hasSolution;
+
+  if (!race(query, objects, values, hasSolution, unsatCore))
+    return false;
+
+  isValid = !hasSolution;
+  return true;
+}
+
+bool PortfolioSolver::computeValue(const Query &query, ref<Expr> &result) {
+  std::vector<const Array *> objects;
+  std::vector<std::vector<unsigned char> > values;
+  std::vector<ref<Expr> > unsatCore;
+  bool hasSolution;
+
+  findSymbolicObjects(query.expr, objects);
+  if (!race(query.withFalse(), objects, values, hasSolution, unsatCore))
+    return false;
+  assert(hasSolution && "state has invalid constraint set");
+
+  Assignment a(objects, values);
+  result = a.evaluate(query.expr);
+  return true;
+}
+
+bool PortfolioSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution,
+    std::vector<ref<Expr> > &unsatCore) {
+  return race(query, objects, values, hasSolution, unsatCore);
+}
+
+char *PortfolioSolver::getConstraintLog(const Query &query) {
+  return solvers[0]->impl->getConstraintLog(query);
+}
+
+void PortfolioSolver::setCoreSolverTimeout(double timeout) {
+  for (std::vector<Solver *>::iterator it = solvers.begin(),
+                                       ie = solvers.end();
+       it != ie; ++it)
+    (*it)->impl->setCoreSolverTimeout(timeout);
+}
+
+void PortfolioSolver::releaseMemory() {
+  for (std::vector<Solver *>::iterator it = solvers.begin(),
+                                       ie = solvers.end();
+       it != ie; ++it)
+    (*it)->impl->releaseMemory();
+}
+}
+
+Solver *klee::createPortfolioSolver(Solver *primary, Solver *secondary) {
+  return new Solver(new PortfolioSolver(primary, secondary));
+}
@@ -35,7 +35,7 @@ llvm::cl::opt<bool> CreateCompressedQueryLog(
 
 QueryLoggingSolver::QueryLoggingSolver(Solver *_solver, std::string path,
                                        const std::string &commentSign,
-                                       int queryTimeToLog)
+                                       int queryTimeToLog, bool binary)
     : solver(_solver), os(0), BufferString(""), logBuffer(BufferString),
       queryCount(0), minQueryTimeToLog(queryTimeToLog), startTime(0.0f),
       lastQueryTime(0.0f), queryCommentSign(commentSign) {
@@ -44,7 +44,8 @@ QueryLoggingSolver::QueryLoggingSolver(Solver *_solver, std::string path,
 #endif
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 5)
     os = new llvm::raw_fd_ostream(path.c_str(), ErrorInfo,
-                                  llvm::sys::fs::OpenFlags::F_Text);
+                                  binary ? llvm::sys::fs::OpenFlags::F_None
+                                         : llvm::sys::fs::OpenFlags::F_Text);
 #else
   os = new llvm::raw_fd_ostream(path.c_str(), ErrorInfo);
 #endif
@@ -234,3 +235,5 @@ char *QueryLoggingSolver::getConstraintLog(const Query &query) {
 void QueryLoggingSolver::setCoreSolverTimeout(double timeout) {
   solver->impl->setCoreSolverTimeout(timeout);
 }
+
+void QueryLoggingSolver::releaseMemory() { solver->impl->releaseMemory(); }
@@ -55,11 +55,12 @@ protected:
 
   virtual void printQuery(const Query &query, const Query *falseQuery = 0,
                           const std::vector<const Array *> *objects = 0) = 0;
-  void flushBufferConditionally(bool writeToFile);
+  virtual void flushBufferConditionally(bool writeToFile);
 
 public:
   QueryLoggingSolver(Solver *_solver, std::string path,
-                     const std::string &commentSign, int queryTimeToLog);
+                     const std::string &commentSign, int queryTimeToLog,
+                     bool binary = false);
 
   virtual ~QueryLoggingSolver();
 
@@ -77,6 +78,7 @@ public:
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query &);
   void setCoreSolverTimeout(double timeout);
+  void releaseMemory();
 };
 
 #endif /* KLEE_QUERYLOGGINGSOLVER_H */
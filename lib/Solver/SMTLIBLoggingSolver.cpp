@@ -38,6 +38,15 @@ class SMTLIBLoggingSolver : public QueryLoggingSolver
                                 printer.setArrayValuesToGet(*objects);
                         }
 
+                        // When all the queries are logged, the query is
+                        // written to the file directly behind the comments
+                        // buffered so far, rather than through the buffer,
+                        // where large queries are copied once more.
+                        if (0 == minQueryTimeToLog)
+                        {
+                                flushBufferConditionally(true);
+                        }
+
                         printer.generateOutput();
                 }    
         
@@ -48,7 +57,10 @@ class SMTLIBLoggingSolver : public QueryLoggingSolver
 		: QueryLoggingSolver(_solver, path, ";", queryTimeToLog)
 		{
 		  //Setup the printer
-		  printer.setOutput(logBuffer);
+		  if (0 == minQueryTimeToLog)
+		    printer.setOutput(*os);
+		  else
+		    printer.setOutput(logBuffer);
 		}
 };
 
@@ -12,16 +12,25 @@
 #include "klee/Solver.h"
 #include "klee/SolverImpl.h"
 #include "klee/Constraints.h"
+#include "klee/ExprBuilder.h"
+#include "klee/Config/Version.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/Time.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/ExprPPrinter.h"
 #include "klee/util/ExprUtil.h"
+#include "expr/Parser.h"
 
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include <errno.h>
+#include <poll.h>
 #include <unistd.h>
 #include <signal.h>
+#include <string.h>
 #include <sys/wait.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
@@ -35,6 +44,12 @@ llvm::cl::opt<bool> DebugDumpSTPQueries(
 llvm::cl::opt<bool> IgnoreSolverFailures(
     "ignore-solver-failures", llvm::cl::init(false),
     llvm::cl::desc("Ignore any solver failures (default=off)"));
+
+llvm::cl::opt<bool> STPWorker(
+    "stp-worker", llvm::cl::init(false),
+    llvm::cl::desc("With --use-forked-solver, solve the queries in a "
+                   "persistent worker process, restarted only on a timeout "
+                   "or a crash, instead of forking per query (default=off)"));
 }
 
 #define vc_bvBoolExtract IAMTHESPAWNOFSATAN
@@ -65,9 +80,25 @@ private:
   STPBuilder *builder;
   double timeout;
   bool useForkedSTP;
+  bool optimizeDivides;
   SolverRunStatus runStatusCode;
   std::vector<ref<Expr> > emptyUnsatCore;
 
+  /// The process id of the STP worker, or zero when it is not running
+  pid_t workerPid;
+
+  /// The pipes to send the queries to the worker, and to read its replies
+  int toWorker;
+  int fromWorker;
+
+  bool startWorker();
+  void stopWorker(bool kill);
+  SolverRunStatus
+  runAndGetCexInWorker(const Query &query,
+                       const std::vector<const Array *> &objects,
+                       std::vector<std::vector<unsigned char> > &values,
+                       bool &hasSolution);
+
 public:
   STPSolverImpl(bool _useForkedSTP, bool _optimizeDivides = true);
   ~STPSolverImpl();
@@ -89,7 +120,9 @@ public:
 STPSolverImpl::STPSolverImpl(bool _useForkedSTP, bool _optimizeDivides)
     : vc(vc_createValidityChecker()),
       builder(new STPBuilder(vc, _optimizeDivides)), timeout(0.0),
-      useForkedSTP(_useForkedSTP), runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+      useForkedSTP(_useForkedSTP), optimizeDivides(_optimizeDivides),
+      runStatusCode(SOLVER_RUN_STATUS_FAILURE), workerPid(0), toWorker(-1),
+      fromWorker(-1) {
   assert(vc && "unable to create validity checker");
   assert(builder && "unable to create STPBuilder");
 
@@ -119,6 +152,8 @@ STPSolverImpl::STPSolverImpl(bool _useForkedSTP, bool _optimizeDivides)
 }
 
 STPSolverImpl::~STPSolverImpl() {
+  stopWorker(false);
+
   // Detach the memory region.
   shmdt(shared_memory_ptr);
   shared_memory_ptr = 0;
@@ -326,6 +361,288 @@ runAndGetCexForked(::VC vc, STPBuilder *builder, ::VCExpr q,
     }
   }
 }
+
+/// The replies of the STP worker
+enum STPWorkerReply {
+  STPWorkerSolvable = 0,
+  STPWorkerUnsolvable = 1,
+  STPWorkerParseError = 2
+};
+
+static bool readAll(int fd, void *buffer, size_t size) {
+  char *pos = (char *)buffer;
+  while (size) {
+    ssize_t n = ::read(fd, pos, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    pos += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool writeAll(int fd, const void *buffer, size_t size) {
+  const char *pos = (const char *)buffer;
+  while (size) {
+    ssize_t n = ::write(fd, pos, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    pos += n;
+    size -= n;
+  }
+  return true;
+}
+
+/// Solve a query of the worker, given in the .pc language, and write the
+/// initial values of its objects into the shared memory when it has a
+/// solution. Each query is solved with a new validity checker, as the arrays
+/// of the parser do not outlive the query.
+static STPWorkerReply solveWorkerQuery(const std::string &text,
+                                       bool optimizeDivides) {
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 6)
+  std::unique_ptr<llvm::MemoryBuffer> MB =
+      llvm::MemoryBuffer::getMemBuffer(text, "STP worker query");
+#else
+  llvm::OwningPtr<llvm::MemoryBuffer> MB(
+      llvm::MemoryBuffer::getMemBuffer(text, "STP worker query"));
+#endif
+  ExprBuilder *exprBuilder = createDefaultExprBuilder();
+  expr::Parser *parser = expr::Parser::Create("STP worker query", MB.get(),
+                                              exprBuilder, false);
+  parser->SetMaxErrors(1);
+
+  std::vector<expr::Decl *> decls;
+  expr::QueryCommand *command = 0;
+  while (expr::Decl *decl = parser->ParseTopLevelDecl()) {
+    decls.push_back(decl);
+    if (expr::QueryCommand *qc = llvm::dyn_cast<expr::QueryCommand>(decl))
+      command = qc;
+  }
+
+  STPWorkerReply reply = STPWorkerParseError;
+  if (command && !parser->GetNumErrors()) {
+    ::VC vc = vc_createValidityChecker();
+    vc_setInterfaceFlags(vc, EXPRDELETE, 0);
+    make_division_total(vc);
+    STPBuilder *builder = new STPBuilder(vc, optimizeDivides);
+    {
+      for (std::vector<ref<Expr> >::const_iterator
+               it = command->Constraints.begin(),
+               ie = command->Constraints.end();
+           it != ie; ++it)
+        vc_assertFormula(vc, builder->construct(*it));
+
+      if (vc_query(vc, builder->construct(command->Query))) {
+        reply = STPWorkerUnsolvable;
+      } else {
+        unsigned char *pos = shared_memory_ptr;
+        for (std::vector<const Array *>::const_iterator
+                 it = command->Objects.begin(),
+                 ie = command->Objects.end();
+             it != ie; ++it) {
+          const Array *array = *it;
+          for (unsigned offset = 0; offset < array->size; offset++) {
+            ExprHandle counter = vc_getCounterExample(
+                vc, builder->getInitialRead(array, offset));
+            *pos++ = getBVUnsigned(counter);
+          }
+        }
+        reply = STPWorkerSolvable;
+      }
+    }
+    delete builder;
+    vc_Destroy(vc);
+  }
+
+  for (std::vector<expr::Decl *>::iterator it = decls.begin(),
+                                           ie = decls.end();
+       it != ie; ++it)
+    delete *it;
+  delete parser;
+  delete exprBuilder;
+
+  return reply;
+}
+
+/// The main loop of the STP worker: each query is sent as its length and its
+/// text, and answered with a reply byte. The worker exits when the pipe of
+/// the queries is closed.
+static void runSTPWorker(int in, int out, bool optimizeDivides) {
+  for (;;) {
+    uint32_t length;
+    if (!readAll(in, &length, sizeof(length)))
+      _exit(0);
+    std::string text(length, '\0');
+    if (length && !readAll(in, &text[0], length))
+      _exit(0);
+
+    unsigned char reply = solveWorkerQuery(text, optimizeDivides);
+    if (!writeAll(out, &reply, sizeof(reply)))
+      _exit(0);
+  }
+}
+
+bool STPSolverImpl::startWorker() {
+  int queries[2], replies[2];
+  if (::pipe(queries) < 0)
+    return false;
+  if (::pipe(replies) < 0) {
+    ::close(queries[0]);
+    ::close(queries[1]);
+    return false;
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid == -1) {
+    ::close(queries[0]);
+    ::close(queries[1]);
+    ::close(replies[0]);
+    ::close(replies[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    ::close(queries[1]);
+    ::close(replies[0]);
+    ::alarm(0);
+    ::signal(SIGALRM, SIG_DFL);
+    runSTPWorker(queries[0], replies[1], optimizeDivides);
+    _exit(0);
+  }
+
+  ::close(queries[0]);
+  ::close(replies[1]);
+  workerPid = pid;
+  toWorker = queries[1];
+  fromWorker = replies[0];
+  return true;
+}
+
+void STPSolverImpl::stopWorker(bool kill) {
+  if (!workerPid)
+    return;
+
+  // Closing the pipe of the queries makes the worker exit
+  ::close(toWorker);
+  ::close(fromWorker);
+  if (kill)
+    ::kill(workerPid, SIGKILL);
+
+  int status;
+  while (waitpid(workerPid, &status, 0) < 0 && errno == EINTR)
+    ;
+
+  workerPid = 0;
+  toWorker = -1;
+  fromWorker = -1;
+}
+
+SolverImpl::SolverRunStatus STPSolverImpl::runAndGetCexInWorker(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  unsigned sum = 0;
+  for (std::vector<const Array *>::const_iterator it = objects.begin(),
+                                                  ie = objects.end();
+       it != ie; ++it)
+    sum += (*it)->size;
+  if (sum >= shared_memory_size)
+    llvm::report_fatal_error("not enough shared memory for counterexample");
+
+  if (!workerPid && !startWorker()) {
+    klee_warning("unable to start the STP worker");
+    if (!IgnoreSolverFailures)
+      exit(1);
+    return SolverImpl::SOLVER_RUN_STATUS_FORK_FAILED;
+  }
+
+  std::string text;
+  llvm::raw_string_ostream os(text);
+  ExprPPrinter::printQuery(os, query.constraints, query.expr, 0, 0,
+                           objects.empty() ? 0 : &objects[0],
+                           objects.empty() ? 0 : &objects[0] + objects.size());
+  os.flush();
+
+  if (DebugDumpSTPQueries)
+    klee_warning("STP query:\n%s\n", text.c_str());
+
+  // A worker which died makes the write fail instead of raising SIGPIPE
+  struct sigaction ignore, saved;
+  memset(&ignore, 0, sizeof(ignore));
+  ignore.sa_handler = SIG_IGN;
+  sigemptyset(&ignore.sa_mask);
+  ::sigaction(SIGPIPE, &ignore, &saved);
+  uint32_t length = text.size();
+  bool sent = writeAll(toWorker, &length, sizeof(length)) &&
+              writeAll(toWorker, text.data(), length);
+  ::sigaction(SIGPIPE, &saved, 0);
+
+  unsigned char reply;
+  bool received = false;
+  if (sent) {
+    double deadline = util::getWallTime() + timeout;
+    struct pollfd fd;
+    fd.fd = fromWorker;
+    fd.events = POLLIN;
+    for (;;) {
+      int wait = -1;
+      if (timeout) {
+        double remaining = deadline - util::getWallTime();
+        wait = remaining > 0 ? (int)(remaining * 1000) : 0;
+      }
+      int res = ::poll(&fd, 1, wait);
+      if (res < 0 && errno == EINTR)
+        continue;
+      if (res == 0) {
+        klee_warning("STP timed out");
+        stopWorker(true);
+        return SolverImpl::SOLVER_RUN_STATUS_TIMEOUT;
+      }
+      received = res > 0 && readAll(fromWorker, &reply, sizeof(reply));
+      break;
+    }
+  }
+
+  if (!received) {
+    // The worker is restarted at the next query
+    stopWorker(true);
+    klee_warning("STP did not return successfully.  Most likely you forgot "
+                 "to run 'ulimit -s unlimited'");
+    if (!IgnoreSolverFailures)
+      exit(1);
+    return SolverImpl::SOLVER_RUN_STATUS_INTERRUPTED;
+  }
+
+  if (reply == STPWorkerParseError) {
+    klee_warning("the STP worker could not parse the query");
+    if (!IgnoreSolverFailures)
+      exit(1);
+    return SolverImpl::SOLVER_RUN_STATUS_UNEXPECTED_EXIT_CODE;
+  }
+
+  hasSolution = reply == STPWorkerSolvable;
+  if (hasSolution) {
+    unsigned char *pos = shared_memory_ptr;
+    values = std::vector<std::vector<unsigned char> >(objects.size());
+    unsigned i = 0;
+    for (std::vector<const Array *>::const_iterator it = objects.begin(),
+                                                    ie = objects.end();
+         it != ie; ++it) {
+      const Array *array = *it;
+      std::vector<unsigned char> &data = values[i++];
+      data.insert(data.begin(), pos, pos + array->size);
+      pos += array->size;
+    }
+    return SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+  return SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+}
+
 bool STPSolverImpl::computeInitialValues(
     const Query &query, const std::vector<const Array *> &objects,
     std::vector<std::vector<unsigned char> > &values, bool &hasSolution,
@@ -334,6 +651,23 @@ bool STPSolverImpl::computeInitialValues(
 
   TimerStatIncrementer t(stats::queryTime);
 
+  if (useForkedSTP && STPWorker) {
+    ++stats::queries;
+    ++stats::queryCounterexamples;
+
+    runStatusCode =
+        runAndGetCexInWorker(query, objects, values, hasSolution);
+    bool success = ((SOLVER_RUN_STATUS_SUCCESS_SOLVABLE == runStatusCode) ||
+                    (SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE == runStatusCode));
+    if (success) {
+      if (hasSolution)
+        ++stats::queriesInvalid;
+      else
+        ++stats::queriesValid;
+    }
+    return success;
+  }
+
   vc_push(vc);
 
   for (ConstraintManager::const_iterator it = query.constraints.begin(),
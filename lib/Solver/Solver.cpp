@@ -33,6 +33,8 @@ void Solver::setCoreSolverTimeout(double timeout) {
     impl->setCoreSolverTimeout(timeout);
 }
 
+void Solver::releaseMemory() { impl->releaseMemory(); }
+
 bool Solver::evaluate(const Query& query, Validity &result,
                       std::vector<ref<Expr> > &unsatCore) {
   assert(query.expr->getWidth() == Expr::Bool && "Invalid expression type!");
@@ -109,6 +111,15 @@ bool Solver::getInitialValues(const Query &query,
   return success;
 }
 
+bool Solver::getInitialValues(const Query &query,
+                              const std::vector<const Array *> &objects,
+                              std::vector<std::vector<unsigned char> > &values,
+                              bool &hasSolution,
+                              std::vector<ref<Expr> > &unsatCore) {
+  return impl->computeInitialValues(query, objects, values, hasSolution,
+                                    unsatCore);
+}
+
 std::pair< ref<Expr>, ref<Expr> > Solver::getRange(const Query& query) {
   ref<Expr> e = query.expr;
   Expr::Width width = e->getWidth();
@@ -35,6 +35,7 @@ public:
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query &);
   void setCoreSolverTimeout(double timeout);
+  void releaseMemory();
 };
 
 bool ValidatingSolver::computeTruth(const Query &query, bool &isValid,
@@ -145,6 +146,11 @@ void ValidatingSolver::setCoreSolverTimeout(double timeout) {
   solver->impl->setCoreSolverTimeout(timeout);
 }
 
+void ValidatingSolver::releaseMemory() {
+  solver->impl->releaseMemory();
+  oracle->impl->releaseMemory();
+}
+
 Solver *createValidatingSolver(Solver *s, Solver *oracle) {
   return new Solver(new ValidatingSolver(s, oracle));
 }
@@ -26,6 +26,22 @@ llvm::cl::opt<bool> UseConstructHashZ3(
     "use-construct-hash-z3",
     llvm::cl::desc("Use hash-consing during Z3 query construction."),
     llvm::cl::init(true));
+
+llvm::cl::opt<unsigned> Z3ParallelThreads(
+    "z3-parallel-threads",
+    llvm::cl::desc("Maximum number of threads Z3 may use to solve a single "
+                   "query with its parallel mode, for example the "
+                   "subsumption check queries. Values below 2 disable the "
+                   "parallel mode (default=0)."),
+    llvm::cl::init(0));
+
+llvm::cl::opt<unsigned> Z3ConstructCacheSize(
+    "z3-construct-cache-size",
+    llvm::cl::desc("Maximum number of Z3 ASTs kept in the construct cache "
+                   "across queries, evicting the least recently used ones "
+                   "beyond it. A value of 0 clears the cache after every "
+                   "query (default=100000)."),
+    llvm::cl::init(100000));
 }
 
 void custom_z3_error_handler(Z3_context ctx, Z3_error_code ec) {
@@ -56,10 +72,22 @@ Z3ArrayExprHash::~Z3ArrayExprHash() {}
 void Z3ArrayExprHash::clear() {
   _update_node_hash.clear();
   _array_hash.clear();
+  updateNodeGenerations.clear();
 }
 
 Z3Builder::Z3Builder(bool autoClearConstructCache)
-    : autoClearConstructCache(autoClearConstructCache) {
+    : constructCacheGeneration(1),
+      autoClearConstructCache(autoClearConstructCache),
+      quantificationContext(0) {
+  // Z3's parallel mode is configured through global parameters, which have to
+  // be set before the context is created. Unsupported parameters only cause a
+  // warning from Z3.
+  if (Z3ParallelThreads > 1) {
+    Z3_global_param_set("parallel.enable", "true");
+    Z3_global_param_set("parallel.threads.max",
+                        llvm::utostr(Z3ParallelThreads).c_str());
+  }
+
   // FIXME: Should probably let the client pass in a Z3_config instead
   Z3_config cfg = Z3_mk_config();
   // It is very important that we ask Z3 to let us manage memory so that
@@ -77,9 +105,92 @@ Z3Builder::~Z3Builder() {
   // they aren associated with.
   clearConstructCache();
   _arr_hash.clear();
+  boundArrays.clear();
   Z3_del_context(ctx);
 }
 
+void Z3Builder::clearConstructCache() {
+  for (std::vector<const UpdateNode *>::iterator
+           it = transientUpdateNodes.begin(),
+           ie = transientUpdateNodes.end();
+       it != ie; ++it)
+    _arr_hash._update_node_hash.erase(*it);
+  transientUpdateNodes.clear();
+  transientConstructed.clear();
+  constructed.clear();
+}
+
+void Z3Builder::endConstructCacheGeneration() {
+  if (!Z3ConstructCacheSize) {
+    clearConstructCache();
+    ++constructCacheGeneration;
+    return;
+  }
+
+  for (std::vector<ref<Expr> >::iterator it = transientConstructed.begin(),
+                                         ie = transientConstructed.end();
+       it != ie; ++it)
+    constructed.erase(*it);
+  transientConstructed.clear();
+  for (std::vector<const UpdateNode *>::iterator
+           it = transientUpdateNodes.begin(),
+           ie = transientUpdateNodes.end();
+       it != ie; ++it) {
+    _arr_hash._update_node_hash.erase(*it);
+    _arr_hash.updateNodeGenerations.erase(*it);
+  }
+  transientUpdateNodes.clear();
+
+  if (constructed.size() + _arr_hash.updateNodeGenerations.size() >
+      Z3ConstructCacheSize) {
+    // Keep the most recent generations that fit in half of the bound, so that
+    // the eviction cost is amortized over the following queries.
+    std::map<unsigned, size_t> generationSizes;
+    for (ExprHashMap<ConstructedAST>::iterator it = constructed.begin(),
+                                               ie = constructed.end();
+         it != ie; ++it)
+      ++generationSizes[it->second.generation];
+    for (std::map<const UpdateNode *, unsigned>::iterator
+             it = _arr_hash.updateNodeGenerations.begin(),
+             ie = _arr_hash.updateNodeGenerations.end();
+         it != ie; ++it)
+      ++generationSizes[it->second];
+
+    unsigned oldestKept = constructCacheGeneration;
+    size_t kept = 0;
+    for (std::map<unsigned, size_t>::reverse_iterator
+             it = generationSizes.rbegin(),
+             ie = generationSizes.rend();
+         it != ie; ++it) {
+      if (it->first != constructCacheGeneration &&
+          kept + it->second > Z3ConstructCacheSize / 2)
+        break;
+      kept += it->second;
+      oldestKept = it->first;
+    }
+
+    for (ExprHashMap<ConstructedAST>::iterator it = constructed.begin();
+         it != constructed.end();) {
+      if (it->second.generation < oldestKept)
+        it = constructed.erase(it);
+      else
+        ++it;
+    }
+    for (std::map<const UpdateNode *, unsigned>::iterator
+             it = _arr_hash.updateNodeGenerations.begin();
+         it != _arr_hash.updateNodeGenerations.end();) {
+      if (it->second < oldestKept) {
+        _arr_hash._update_node_hash.erase(it->first);
+        _arr_hash.updateNodeGenerations.erase(it++);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  ++constructCacheGeneration;
+}
+
 Z3SortHandle Z3Builder::getBvSort(unsigned width) {
   // FIXME: cache these
   return Z3SortHandle(Z3_mk_bv_sort(ctx, width), ctx);
@@ -372,8 +483,8 @@ Z3ASTHandle Z3Builder::getInitialArray(const Array *root) {
       QuantificationContext *qc = quantificationContext;
 
       while (qc) {
-        std::map<std::string, Z3ASTHandle>::iterator it =
-            qc->existentials.find(root->name);
+        llvm::DenseMap<const Array *, Z3ASTHandle>::iterator it =
+            qc->existentials.find(root);
         if (it != qc->existentials.end())
           return it->second;
         qc = qc->parent;
@@ -428,7 +539,11 @@ Z3ASTHandle Z3Builder::getArrayForUpdate(const Array *root,
                           construct(un->index, 0), construct(un->value, 0));
 
       _arr_hash.hashUpdateNodeExpr(un, un_expr);
+      if (quantificationContext)
+        transientUpdateNodes.push_back(un);
     }
+    if (!quantificationContext)
+      _arr_hash.updateNodeGenerations[un] = constructCacheGeneration;
 
     return (un_expr);
   }
@@ -442,18 +557,26 @@ Z3ASTHandle Z3Builder::construct(ref<Expr> e, int *width_out) {
   if (!UseConstructHashZ3 || isa<ConstantExpr>(e)) {
     return constructActual(e, width_out);
   } else {
-    ExprHashMap<std::pair<Z3ASTHandle, unsigned> >::iterator it =
-        constructed.find(e);
+    ExprHashMap<ConstructedAST>::iterator it = constructed.find(e);
     if (it != constructed.end()) {
       if (width_out)
-        *width_out = it->second.second;
-      return it->second.first;
+        *width_out = it->second.width;
+      // A generation of 0 marks the transient ASTs
+      if (it->second.generation)
+        it->second.generation = constructCacheGeneration;
+      return it->second.ast;
     } else {
       int width;
       if (!width_out)
         width_out = &width;
       Z3ASTHandle res = constructActual(e, width_out);
-      constructed.insert(std::make_pair(e, std::make_pair(res, *width_out)));
+      unsigned generation = constructCacheGeneration;
+      if (quantificationContext) {
+        generation = 0;
+        transientConstructed.push_back(e);
+      }
+      constructed.insert(
+          std::make_pair(e, ConstructedAST(res, *width_out, generation)));
       return res;
     }
   }
@@ -852,28 +975,37 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 /***/
 
 Z3Builder::QuantificationContext::QuantificationContext(
-    Z3Builder *builder, Z3_context _ctx, std::set<const Array *> _existentials,
+    Z3Builder *builder, Z3_context _ctx,
+    const std::set<const Array *> &_existentials,
     QuantificationContext *_parent)
     : ctx(_ctx), parent(_parent) {
-  unsigned index = _existentials.size();
-  for (std::set<const Array *>::iterator it = _existentials.begin(),
-                                         itEnd = _existentials.end();
+  for (std::set<const Array *>::const_iterator it = _existentials.begin(),
+                                               itEnd = _existentials.end();
        it != itEnd; ++it) {
-    --index;
-
-    Z3SortHandle domainSort = builder->getBvSort((*it)->domain);
-    Z3SortHandle rangeSort = builder->getBvSort((*it)->range);
-    Z3SortHandle t = builder->getArraySort(domainSort, rangeSort);
-    Z3_symbol s =
-        Z3_mk_string_symbol(ctx, const_cast<char *>((*it)->name.c_str()));
-    Z3_ast bound = Z3_mk_const(ctx, s, t);
-    existentials[(*it)->name] = Z3ASTHandle(bound, ctx);
-    boundVariables.push_back((Z3_app)bound);
+    Z3ASTHandle bound = builder->getBoundArray(*it);
+    existentials[*it] = bound;
+    boundVariables.push_back((Z3_app)(Z3_ast)bound);
   }
 }
 
-void
-Z3Builder::pushQuantificationContext(std::set<const Array *> existentials) {
+Z3ASTHandle Z3Builder::getBoundArray(const Array *array) {
+  llvm::DenseMap<const Array *, Z3ASTHandle>::iterator it =
+      boundArrays.find(array);
+  if (it != boundArrays.end())
+    return it->second;
+
+  Z3SortHandle domainSort = getBvSort(array->domain);
+  Z3SortHandle rangeSort = getBvSort(array->range);
+  Z3SortHandle t = getArraySort(domainSort, rangeSort);
+  Z3_symbol s =
+      Z3_mk_string_symbol(ctx, const_cast<char *>(array->name.c_str()));
+  Z3ASTHandle bound(Z3_mk_const(ctx, s, t), ctx);
+  boundArrays[array] = bound;
+  return bound;
+}
+
+void Z3Builder::pushQuantificationContext(
+    const std::set<const Array *> &existentials) {
   quantificationContext =
       new QuantificationContext(this, ctx, existentials, quantificationContext);
 }
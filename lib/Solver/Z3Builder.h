@@ -14,6 +14,9 @@
 #include "klee/util/ArrayExprHash.h"
 #include "klee/Config/config.h"
 
+#include "llvm/ADT/DenseMap.h"
+
+#include <map>
 #include <vector>
 #include <z3.h>
 
@@ -101,6 +104,10 @@ class Z3ArrayExprHash : public ArrayExprHash<Z3ASTHandle> {
 
   friend class Z3Builder;
 
+  /// \brief The construct cache generation of the last use of each hashed
+  /// update node
+  std::map<const UpdateNode *, unsigned> updateNodeGenerations;
+
 public:
   Z3ArrayExprHash() {};
   virtual ~Z3ArrayExprHash();
@@ -111,14 +118,14 @@ class Z3Builder {
 
   struct QuantificationContext {
 
-    std::map<std::string, Z3ASTHandle> existentials;
+    llvm::DenseMap<const Array *, Z3ASTHandle> existentials;
     std::vector<Z3_app> boundVariables;
     Z3_context ctx;
 
     QuantificationContext *parent;
 
     QuantificationContext(Z3Builder *builder, Z3_context _ctx,
-                          std::set<const Array *> _existentials,
+                          const std::set<const Array *> &_existentials,
                           QuantificationContext *_parent);
 
     ~QuantificationContext() {}
@@ -130,9 +137,29 @@ class Z3Builder {
     QuantificationContext *getParent() { return parent; }
   };
 
-  ExprHashMap<std::pair<Z3ASTHandle, unsigned> > constructed;
+  struct ConstructedAST {
+    Z3ASTHandle ast;
+    unsigned width;
+    /// \brief The construct cache generation of the last use of the AST
+    unsigned generation;
+
+    ConstructedAST(Z3ASTHandle _ast, unsigned _width, unsigned _generation)
+        : ast(_ast), width(_width), generation(_generation) {}
+  };
+
+  ExprHashMap<ConstructedAST> constructed;
   Z3ArrayExprHash _arr_hash;
 
+  /// \brief The current generation of the construct cache, which ends with
+  /// every query
+  unsigned constructCacheGeneration;
+
+  /// \brief The expressions and update nodes constructed within a
+  /// quantifier, whose ASTs may refer to its bound variables and are hence
+  /// only cached until the end of the generation
+  std::vector<ref<Expr> > transientConstructed;
+  std::vector<const UpdateNode *> transientUpdateNodes;
+
 private:
   Z3ASTHandle bvOne(unsigned width);
   Z3ASTHandle bvZero(unsigned width);
@@ -201,7 +228,14 @@ private:
   // Handling of quantification contexts
   QuantificationContext *quantificationContext;
 
-  void pushQuantificationContext(std::set<const Array *> existentials);
+  /// \brief The bound variables of the existentially-quantified arrays,
+  /// which are the same constants in all the subsumption queries quantifying
+  /// the array, built once
+  llvm::DenseMap<const Array *, Z3ASTHandle> boundArrays;
+
+  Z3ASTHandle getBoundArray(const Array *array);
+
+  void pushQuantificationContext(const std::set<const Array *> &existentials);
 
   void popQuantificationContext();
 
@@ -228,7 +262,17 @@ public:
     return res;
   }
 
-  void clearConstructCache() { constructed.clear(); }
+  void clearConstructCache();
+
+  /// \brief End the current generation of the construct cache
+  ///
+  /// The ASTs that may refer to bound variables are dropped, and when the
+  /// cache holds more ASTs than its bound, the least recently used ones are
+  /// evicted, so that the translation of a query mostly reuses the ASTs of
+  /// the constraints shared with the previous queries.
+  void endConstructCacheGeneration();
+
+  unsigned getConstructCacheSize() const { return constructed.size(); }
 };
 }
 
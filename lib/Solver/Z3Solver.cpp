@@ -13,13 +13,60 @@
 #include "klee/Constraints.h"
 #include "klee/Solver.h"
 #include "klee/SolverImpl.h"
+#include "klee/Internal/System/Time.h"
 #include "klee/util/Assignment.h"
 #include "klee/util/ExprUtil.h"
 
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 
+#include <set>
+#include <sstream>
+
+namespace {
+llvm::cl::opt<bool> Z3IncrementalSolving(
+    "z3-incremental",
+    llvm::cl::desc("Keep a single Z3 solver across queries, and only push or "
+                   "pop the constraints that differ from the previous query "
+                   "instead of creating a fresh solver for each query "
+                   "(default=off)."),
+    llvm::cl::init(false));
+
+llvm::cl::opt<unsigned> Z3MinimizeUnsatCore(
+    "z3-minimize-unsat-core",
+    llvm::cl::desc("Minimize the unsatisfiability cores of at least this "
+                   "many constraints, by deleting their constraints in turn, "
+                   "for smaller interpolants (default=0 (off))."),
+    llvm::cl::init(0));
+
+llvm::cl::opt<double> Z3MinimizeUnsatCoreTime(
+    "z3-minimize-unsat-core-time",
+    llvm::cl::desc("Time budget of the minimization of an unsatisfiability "
+                   "core, after which the core left is returned "
+                   "(default=0.5s)."),
+    llvm::cl::init(0.5), llvm::cl::value_desc("seconds"));
+
+llvm::cl::opt<std::string> Z3QuantifierFreeLogic(
+    "z3-qf-logic",
+    llvm::cl::desc("Solve the quantifier-free queries with the Z3 solver "
+                   "for the given logic, such as QF_ABV, instead of the "
+                   "simple solver (default=none)."),
+    llvm::cl::init(""));
+
+llvm::cl::opt<bool> Z3QueryClassStats(
+    "z3-query-class-stats",
+    llvm::cl::desc("Report the number and the time of the queries of each "
+                   "class of pooled Z3 solver at exit, to tune the solvers "
+                   "of the classes (default=off)."),
+    llvm::cl::init(false));
+}
+
 namespace klee {
 
+/// \brief The number of cached Z3 expressions above which the incremental
+/// solver session is restarted to bound memory usage.
+static const unsigned MaxIncrementalConstructCacheSize = 1 << 16;
+
 class Z3SolverImpl : public SolverImpl {
 private:
   Z3Builder *builder;
@@ -29,11 +76,102 @@ private:
   // Parameter symbols
   ::Z3_symbol timeoutParamStrSymbol;
 
+  /// \brief The persistent solver used in incremental mode, or NULL when it
+  /// has not been created yet.
+  ::Z3_solver incrementalSolver;
+
+  /// \brief The constraints currently asserted in incrementalSolver. The
+  /// i-th constraint is asserted in the i-th solver scope, tracked by the
+  /// Boolean constant named i + 1, so that the unsatisfiability core can be
+  /// mapped back exactly as in the non-incremental case.
+  std::vector<ref<Expr> > assertedConstraints;
+
+  /// \brief The Boolean constants used to track the constraints for the
+  /// unsatisfiability core. The i-th element tracks the constraint with id
+  /// i + 1. The constants are named by integer symbols, created once, and
+  /// shared by all queries, as they do not depend on the constraints.
+  std::vector<Z3ASTHandle> trackingLiterals;
+
+  /// \brief Retrieve the tracking literal of the given constraint id,
+  /// creating the literals up to the id as needed.
+  Z3ASTHandle getTrackingLiteral(unsigned constraintId);
+
+  /// \brief Tests if the query is an existentially-quantified subsumption
+  /// check query, which requires a solver for the ABV logic.
+  static bool isQuantified(const Query &query) {
+    return INTERPOLATION_ENABLED &&
+           (llvm::isa<ExistsExpr>(query.expr) ||
+            (llvm::isa<EqExpr>(query.expr) &&
+             llvm::isa<ExistsExpr>(query.expr->getKid(1))));
+  }
+
+  /// \brief The classes of the queries, each solved by its own pooled
+  /// solver
+  enum QueryClass {
+    /// \brief The validity and truth queries, whose unsatisfiability cores
+    /// are taken for the interpolants
+    CoreQuery,
+
+    /// \brief The queries for the values of arrays
+    ModelQuery,
+
+    /// \brief The existentially-quantified queries of the subsumption
+    /// checks, solved in the ABV logic
+    QuantifiedQuery,
+
+    QueryClassCount
+  };
+
+  /// \brief A solver kept for the queries of its class, created on first use
+  /// and reset after each query, with the number and the time of its queries
+  struct PooledSolver {
+    ::Z3_solver solver;
+
+    uint64_t queryCount;
+
+    double time;
+
+    PooledSolver() : solver(NULL), queryCount(0), time(0.0) {}
+  };
+
+  PooledSolver pool[QueryClassCount];
+
+  static QueryClass getQueryClass(const Query &query, bool model) {
+    return isQuantified(query) ? QuantifiedQuery
+                               : model ? ModelQuery : CoreQuery;
+  }
+
+  /// \brief Get the pooled solver of the class, set up with the current
+  /// parameters. The solver has to be given back using releaseSolver.
+  ::Z3_solver acquireSolver(QueryClass queryClass);
+
+  /// \brief Reset the pooled solver of the class for its next query, and
+  /// account for the query that started at the given time.
+  void releaseSolver(QueryClass queryClass, double startTime);
+
+  /// \brief Assert and track a path-condition constraint, using the constant
+  /// named by constraintId as the tracking literal.
+  void assertConstraint(::Z3_solver theSolver, ref<Expr> constraint,
+                        unsigned constraintId);
+
+  /// \brief Pop the constraints of the previous query that are not a prefix
+  /// of the constraints of the given query, and push the remaining ones.
+  void synchronizeIncrementalSolver(const Query &query);
+
+  /// \brief Forget all constraints asserted in the incremental solver.
+  void resetIncrementalSolver();
+
   bool internalRunSolver(const Query &,
                          const std::vector<const Array *> *objects,
                          std::vector<std::vector<unsigned char> > *values,
                          bool &hasSolution, std::vector<ref<Expr> > &unsatCore);
 
+  /// \brief Remove the constraints of the unsatisfiability core of the goal
+  /// that are not needed for its unsatisfiability, within the time budget
+  /// of -z3-minimize-unsat-core-time. The result is minimal when the budget
+  /// is not exhausted: removing any of its constraints makes it satisfiable.
+  void minimizeUnsatCore(::Z3_ast goal, std::vector<ref<Expr> > &unsatCore);
+
   /// getUnsatCoreVector - Declare the routine to extract the unsatisfiability
   /// core vector. The resulting vector is the fourth argument.
   static void getUnsatCoreVector(const Query &query, const Z3Builder *builder,
@@ -56,6 +194,8 @@ public:
                        timeoutInMilliSeconds);
   }
 
+  bool computeValidity(const Query &, Solver::Validity &result,
+                       std::vector<ref<Expr> > &unsatCore);
   bool computeTruth(const Query &, bool &isValid,
                     std::vector<ref<Expr> > &unsatCore);
   bool computeValue(const Query &, ref<Expr> &result);
@@ -70,11 +210,13 @@ public:
                        std::vector<std::vector<unsigned char> > *values,
                        bool &hasSolution);
   SolverRunStatus getOperationStatusCode();
+
+  void releaseMemory() { builder->clearConstructCache(); }
 };
 
 Z3SolverImpl::Z3SolverImpl()
     : builder(new Z3Builder(/*autoClearConstructCache=*/false)), timeout(0.0),
-      runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+      runStatusCode(SOLVER_RUN_STATUS_FAILURE), incrementalSolver(NULL) {
   assert(builder && "unable to create Z3Builder");
   solverParameters = Z3_mk_params(builder->ctx);
   Z3_params_inc_ref(builder->ctx, solverParameters);
@@ -83,6 +225,20 @@ Z3SolverImpl::Z3SolverImpl()
 }
 
 Z3SolverImpl::~Z3SolverImpl() {
+  if (Z3QueryClassStats) {
+    klee_message("Z3 queries: %lu core in %.2fs, %lu model in %.2fs, "
+                 "%lu quantified in %.2fs",
+                 pool[CoreQuery].queryCount, pool[CoreQuery].time,
+                 pool[ModelQuery].queryCount, pool[ModelQuery].time,
+                 pool[QuantifiedQuery].queryCount, pool[QuantifiedQuery].time);
+  }
+  for (unsigned i = 0; i != QueryClassCount; ++i)
+    if (pool[i].solver)
+      Z3_solver_dec_ref(builder->ctx, pool[i].solver);
+  if (incrementalSolver)
+    Z3_solver_dec_ref(builder->ctx, incrementalSolver);
+  // The handles have to be released while the context is still alive
+  trackingLiterals.clear();
   Z3_params_dec_ref(builder->ctx, solverParameters);
   delete builder;
 }
@@ -149,6 +305,108 @@ char *Z3SolverImpl::getConstraintLog(const Query &query) {
   return strdup(result);
 }
 
+bool Z3SolverImpl::computeValidity(const Query &query,
+                                   Solver::Validity &result,
+                                   std::vector<ref<Expr> > &unsatCore) {
+  // The subsumption checks are accounted for per truth query, and the
+  // quantified queries are not branch conditions
+  if (Z3Solver::subsumptionCheck || isQuantified(query))
+    return SolverImpl::computeValidity(query, result, unsatCore);
+  TimerStatIncrementer t(stats::queryTime);
+
+  bool incremental = Z3IncrementalSolving;
+  double startTime = util::getWallTime();
+  Z3_solver theSolver;
+  if (incremental) {
+    synchronizeIncrementalSolver(query);
+    theSolver = incrementalSolver;
+    Z3_solver_push(builder->ctx, theSolver);
+  } else {
+    theSolver = acquireSolver(CoreQuery);
+    unsigned constraintIdCtr = 1;
+    for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                           ie = query.constraints.end();
+         it != ie; ++it) {
+      assertConstraint(theSolver, *it, constraintIdCtr++);
+    }
+  }
+
+  // Both sides of the query are asserted under an assumption each, such that
+  // they are checked in turn in the same session, where the constraints and
+  // the query expression are constructed and asserted only once. The
+  // assumptions are named by strings, hence they are not mistaken for the
+  // tracking literals in the unsatisfiability core.
+  Z3ASTHandle z3QueryExpr =
+      Z3ASTHandle(builder->construct(query.expr), builder->ctx);
+  Z3_sort boolSort = Z3_mk_bool_sort(builder->ctx);
+  Z3ASTHandle mayBeFalse(
+      Z3_mk_const(builder->ctx,
+                  Z3_mk_string_symbol(builder->ctx, "klee_may_be_false"),
+                  boolSort),
+      builder->ctx);
+  Z3ASTHandle mayBeTrue(
+      Z3_mk_const(builder->ctx,
+                  Z3_mk_string_symbol(builder->ctx, "klee_may_be_true"),
+                  boolSort),
+      builder->ctx);
+  Z3_solver_assert(
+      builder->ctx, theSolver,
+      Z3ASTHandle(Z3_mk_implies(builder->ctx, mayBeFalse,
+                                Z3ASTHandle(Z3_mk_not(builder->ctx,
+                                                      z3QueryExpr),
+                                            builder->ctx)),
+                  builder->ctx));
+  Z3_solver_assert(
+      builder->ctx, theSolver,
+      Z3ASTHandle(Z3_mk_implies(builder->ctx, mayBeTrue, z3QueryExpr),
+                  builder->ctx));
+
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+  bool hasSolution;
+  ::Z3_ast assumption = mayBeFalse;
+  ++stats::queries;
+  runStatusCode = handleSolverResponse(
+      theSolver,
+      Z3_solver_check_assumptions(builder->ctx, theSolver, 1, &assumption),
+      /*objects=*/NULL, /*values=*/NULL, hasSolution);
+  if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
+    ++stats::queriesValid;
+    result = Solver::True;
+    getUnsatCoreVector(query, builder, theSolver, unsatCore);
+    minimizeUnsatCore(Z3ASTHandle(Z3_mk_not(builder->ctx, z3QueryExpr),
+                                  builder->ctx),
+                      unsatCore);
+  } else if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE) {
+    ++stats::queriesInvalid;
+    assumption = mayBeTrue;
+    ++stats::queries;
+    runStatusCode = handleSolverResponse(
+        theSolver,
+        Z3_solver_check_assumptions(builder->ctx, theSolver, 1, &assumption),
+        /*objects=*/NULL, /*values=*/NULL, hasSolution);
+    if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
+      ++stats::queriesValid;
+      result = Solver::False;
+      getUnsatCoreVector(query, builder, theSolver, unsatCore);
+      minimizeUnsatCore(z3QueryExpr, unsatCore);
+    } else if (runStatusCode ==
+               SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE) {
+      ++stats::queriesInvalid;
+      result = Solver::Unknown;
+    }
+  }
+
+  if (incremental) {
+    Z3_solver_pop(builder->ctx, theSolver, 1);
+  } else {
+    releaseSolver(CoreQuery, startTime);
+  }
+  builder->endConstructCacheGeneration();
+
+  return runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
+         runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+}
+
 bool Z3SolverImpl::computeTruth(const Query &query, bool &isValid,
                                 std::vector<ref<Expr> > &unsatCore) {
   bool hasSolution;
@@ -203,42 +461,31 @@ bool Z3SolverImpl::internalRunSolver(
     return result;
   }
   TimerStatIncrementer t(stats::queryTime);
-  // TODO: Does making a new solver for each query have a performance
-  // impact vs making one global solver and using push and pop?
-  // TODO: is the "simple_solver" the right solver to use for
-  // best performance?
-  Z3_solver theSolver = Z3_mk_simple_solver(builder->ctx);
-  if (INTERPOLATION_ENABLED) {
-    if (llvm::isa<ExistsExpr>(query.expr) ||
-        (llvm::isa<EqExpr>(query.expr) &&
-         llvm::isa<ExistsExpr>(query.expr->getKid(1)))) {
-      Z3_symbol abv = Z3_mk_string_symbol(builder->ctx, "ABV");
-      theSolver = Z3_mk_solver_for_logic(builder->ctx, abv);
+
+  // Quantified queries of the subsumption check need a solver for the ABV
+  // logic, hence they are never solved incrementally.
+  bool incremental = Z3IncrementalSolving && !isQuantified(query);
+  QueryClass queryClass = getQueryClass(query, objects);
+  double startTime = util::getWallTime();
+
+  Z3_solver theSolver;
+  if (incremental) {
+    synchronizeIncrementalSolver(query);
+    theSolver = incrementalSolver;
+    // The query expression lives in its own scope that is popped below
+    Z3_solver_push(builder->ctx, theSolver);
+  } else {
+    theSolver = acquireSolver(queryClass);
+    unsigned constraintIdCtr = 1;
+    for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                           ie = query.constraints.end();
+         it != ie; ++it) {
+      assertConstraint(theSolver, *it, constraintIdCtr++);
     }
   }
-  Z3_solver_inc_ref(builder->ctx, theSolver);
-  Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
 
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
 
-  Z3_sort sort = Z3_mk_bool_sort(builder->ctx);
-  unsigned constraintIdCtr = 1;
-  for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                         ie = query.constraints.end();
-       it != ie; ++it) {
-    std::ostringstream stringStream;
-    stringStream << constraintIdCtr;
-
-    Z3_symbol symbol =
-        Z3_mk_string_symbol(builder->ctx, stringStream.str().c_str());
-    Z3ASTHandle constraintId(Z3_mk_const(builder->ctx, symbol, sort),
-                             builder->ctx);
-
-    Z3_solver_assert_and_track(builder->ctx, theSolver, builder->construct(*it),
-                               constraintId);
-
-    constraintIdCtr++;
-  }
   ++stats::queries;
   if (objects)
     ++stats::queryCounterexamples;
@@ -261,15 +508,22 @@ bool Z3SolverImpl::internalRunSolver(
 
   if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
     getUnsatCoreVector(query, builder, theSolver, unsatCore);
+    if (!isQuantified(query))
+      minimizeUnsatCore(Z3ASTHandle(Z3_mk_not(builder->ctx, z3QueryExpr),
+                                    builder->ctx),
+                        unsatCore);
   }
 
-  Z3_solver_dec_ref(builder->ctx, theSolver);
-  // Clear the builder's cache to prevent memory usage exploding.
-  // By using ``autoClearConstructCache=false`` and clearning now
-  // we allow Z3_ast expressions to be shared from an entire
-  // ``Query`` rather than only sharing within a single call to
-  // ``builder->construct()``.
-  builder->clearConstructCache();
+  if (incremental) {
+    Z3_solver_pop(builder->ctx, theSolver, 1);
+  } else {
+    releaseSolver(queryClass, startTime);
+  }
+  // By using ``autoClearConstructCache=false`` the Z3_ast expressions are
+  // shared across queries rather than only within a single call to
+  // ``builder->construct()``. Ending the cache generation now bounds the
+  // memory usage of the cache.
+  builder->endConstructCacheGeneration();
 
   if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
       runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
@@ -283,6 +537,102 @@ bool Z3SolverImpl::internalRunSolver(
   return false; // failed
 }
 
+::Z3_solver Z3SolverImpl::acquireSolver(QueryClass queryClass) {
+  Z3_solver &theSolver = pool[queryClass].solver;
+  if (!theSolver) {
+    if (queryClass == QuantifiedQuery) {
+      Z3_symbol abv = Z3_mk_string_symbol(builder->ctx, "ABV");
+      theSolver = Z3_mk_solver_for_logic(builder->ctx, abv);
+    } else if (!Z3QuantifierFreeLogic.empty()) {
+      Z3_symbol logic =
+          Z3_mk_string_symbol(builder->ctx, Z3QuantifierFreeLogic.c_str());
+      theSolver = Z3_mk_solver_for_logic(builder->ctx, logic);
+    } else {
+      theSolver = Z3_mk_simple_solver(builder->ctx);
+    }
+    Z3_solver_inc_ref(builder->ctx, theSolver);
+  }
+  // The timeout may have changed since the last query
+  Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+  return theSolver;
+}
+
+void Z3SolverImpl::releaseSolver(QueryClass queryClass, double startTime) {
+  PooledSolver &pooled = pool[queryClass];
+  Z3_solver_reset(builder->ctx, pooled.solver);
+  ++pooled.queryCount;
+  pooled.time += util::getWallTime() - startTime;
+}
+
+Z3ASTHandle Z3SolverImpl::getTrackingLiteral(unsigned constraintId) {
+  assert(constraintId > 0 && "constraint ids start from 1");
+  if (constraintId > trackingLiterals.size()) {
+    Z3_sort boolSort = Z3_mk_bool_sort(builder->ctx);
+    trackingLiterals.reserve(constraintId);
+    for (unsigned id = trackingLiterals.size() + 1; id <= constraintId; ++id) {
+      Z3_symbol symbol = Z3_mk_int_symbol(builder->ctx, id);
+      trackingLiterals.push_back(Z3ASTHandle(
+          Z3_mk_const(builder->ctx, symbol, boolSort), builder->ctx));
+    }
+  }
+  return trackingLiterals[constraintId - 1];
+}
+
+void Z3SolverImpl::assertConstraint(::Z3_solver theSolver,
+                                    ref<Expr> constraint,
+                                    unsigned constraintId) {
+  Z3_solver_assert_and_track(builder->ctx, theSolver,
+                             builder->construct(constraint),
+                             getTrackingLiteral(constraintId));
+}
+
+void Z3SolverImpl::synchronizeIncrementalSolver(const Query &query) {
+  if (!incrementalSolver) {
+    incrementalSolver = Z3_mk_simple_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, incrementalSolver);
+  }
+  // The timeout may have changed since the last query
+  Z3_solver_set_params(builder->ctx, incrementalSolver, solverParameters);
+
+  // Find the longest prefix of the query constraints that is already
+  // asserted.
+  unsigned common = 0;
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                         ie = query.constraints.end();
+       it != ie && common < assertedConstraints.size(); ++it, ++common) {
+    if (assertedConstraints[common] != *it)
+      break;
+  }
+
+  if ((common == 0 && !assertedConstraints.empty()) ||
+      builder->getConstructCacheSize() > MaxIncrementalConstructCacheSize) {
+    // Nothing is shared with the previous query, or the cached Z3
+    // expressions of the shared prefix have grown too large: start afresh.
+    resetIncrementalSolver();
+    common = 0;
+  } else if (common < assertedConstraints.size()) {
+    Z3_solver_pop(builder->ctx, incrementalSolver,
+                  assertedConstraints.size() - common);
+    assertedConstraints.resize(common);
+  }
+
+  ConstraintManager::const_iterator it = query.constraints.begin();
+  std::advance(it, common);
+  for (ConstraintManager::const_iterator ie = query.constraints.end();
+       it != ie; ++it) {
+    Z3_solver_push(builder->ctx, incrementalSolver);
+    assertedConstraints.push_back(*it);
+    assertConstraint(incrementalSolver, *it, assertedConstraints.size());
+  }
+}
+
+void Z3SolverImpl::resetIncrementalSolver() {
+  if (!incrementalSolver)
+    return;
+  Z3_solver_reset(builder->ctx, incrementalSolver);
+  assertedConstraints.clear();
+}
+
 SolverImpl::SolverRunStatus Z3SolverImpl::handleSolverResponse(
     ::Z3_solver theSolver, ::Z3_lbool satisfiable,
     const std::vector<const Array *> *objects,
@@ -363,27 +713,103 @@ SolverImpl::SolverRunStatus Z3SolverImpl::getOperationStatusCode() {
   return runStatusCode;
 }
 
+void Z3SolverImpl::minimizeUnsatCore(::Z3_ast goal,
+                                     std::vector<ref<Expr> > &unsatCore) {
+  if (!Z3MinimizeUnsatCore || unsatCore.size() < Z3MinimizeUnsatCore)
+    return;
+  double deadline = util::getWallTime() + Z3MinimizeUnsatCoreTime;
+
+  // The constraints of the core are asserted under selector literals, such
+  // that each check assumes a subset of them
+  ::Z3_solver theSolver = Z3_mk_simple_solver(builder->ctx);
+  Z3_solver_inc_ref(builder->ctx, theSolver);
+  ::Z3_params parameters = Z3_mk_params(builder->ctx);
+  Z3_params_inc_ref(builder->ctx, parameters);
+  Z3_params_set_uint(builder->ctx, parameters, timeoutParamStrSymbol,
+                     (unsigned)(Z3MinimizeUnsatCoreTime * 1000 + 0.5) + 1);
+  Z3_solver_set_params(builder->ctx, theSolver, parameters);
+  Z3_solver_assert(builder->ctx, theSolver, goal);
+
+  Z3_sort boolSort = Z3_mk_bool_sort(builder->ctx);
+  std::vector<Z3ASTHandle> selectors;
+  for (unsigned i = 0, n = unsatCore.size(); i != n; ++i) {
+    std::ostringstream name;
+    name << "klee_core_" << i;
+    selectors.push_back(Z3ASTHandle(
+        Z3_mk_const(builder->ctx,
+                    Z3_mk_string_symbol(builder->ctx, name.str().c_str()),
+                    boolSort),
+        builder->ctx));
+    Z3_solver_assert(
+        builder->ctx, theSolver,
+        Z3ASTHandle(Z3_mk_implies(builder->ctx, selectors.back(),
+                                  builder->construct(unsatCore[i])),
+                    builder->ctx));
+  }
+
+  // Drop each constraint in turn, and keep it only when the others are
+  // satisfiable without it. The core of an unsatisfiable check drops the
+  // other unneeded constraints at once.
+  std::vector<bool> kept(unsatCore.size(), true);
+  for (unsigned i = 0, n = unsatCore.size(); i != n; ++i) {
+    if (!kept[i])
+      continue;
+    if (util::getWallTime() > deadline)
+      break;
+
+    std::vector< ::Z3_ast> assumptions;
+    for (unsigned j = 0; j != n; ++j)
+      if (kept[j] && j != i)
+        assumptions.push_back(selectors[j]);
+    ::Z3_lbool satisfiable = Z3_solver_check_assumptions(
+        builder->ctx, theSolver, assumptions.size(),
+        assumptions.empty() ? NULL : &assumptions[0]);
+    if (satisfiable != Z3_L_FALSE)
+      continue;
+
+    std::set< ::Z3_ast> needed;
+    Z3_ast_vector core = Z3_solver_get_unsat_core(builder->ctx, theSolver);
+    Z3_ast_vector_inc_ref(builder->ctx, core);
+    for (unsigned j = 0, m = Z3_ast_vector_size(builder->ctx, core); j != m;
+         ++j)
+      needed.insert(Z3_ast_vector_get(builder->ctx, core, j));
+    Z3_ast_vector_dec_ref(builder->ctx, core);
+    for (unsigned j = 0; j != n; ++j)
+      if (kept[j] && !needed.count(selectors[j]))
+        kept[j] = false;
+  }
+
+  Z3_params_dec_ref(builder->ctx, parameters);
+  Z3_solver_dec_ref(builder->ctx, theSolver);
+
+  std::vector<ref<Expr> > minimal;
+  for (unsigned i = 0, n = unsatCore.size(); i != n; ++i)
+    if (kept[i])
+      minimal.push_back(unsatCore[i]);
+  unsatCore.swap(minimal);
+}
+
 void Z3SolverImpl::getUnsatCoreVector(const Query &query,
                                       const Z3Builder *builder,
                                       const Z3_solver solver,
                                       std::vector<ref<Expr> > &unsatCore) {
   Z3_ast_vector r = Z3_solver_get_unsat_core(builder->ctx, solver);
+  Z3_ast_vector_inc_ref(builder->ctx, r);
+  unsigned constraintCount = query.constraints.size();
   for (unsigned int i = 0; i < Z3_ast_vector_size(builder->ctx, r); i++) {
     Z3_ast temp = Z3_ast_vector_get(builder->ctx, r, i);
-    size_t constraintIdCtr = 1;
-    for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                           ie = query.constraints.end();
-         it != ie; ++it) {
-      std::ostringstream stringStream;
-      stringStream << constraintIdCtr;
-      std::string comparisonString = "|" + stringStream.str() + "|";
-      if (Z3_ast_to_string(builder->ctx, temp) == comparisonString) {
-        unsatCore.push_back(*it);
-        break;
-      }
-      constraintIdCtr++;
-    }
+    // The tracking literals are constants named by the integer symbol of
+    // the constraint id, see getTrackingLiteral.
+    Z3_symbol symbol = Z3_get_decl_name(
+        builder->ctx, Z3_get_app_decl(builder->ctx, Z3_to_app(builder->ctx, temp)));
+    if (Z3_get_symbol_kind(builder->ctx, symbol) != Z3_INT_SYMBOL)
+      continue;
+    int constraintId = Z3_get_symbol_int(builder->ctx, symbol);
+    if (constraintId < 1 || (unsigned)constraintId > constraintCount)
+      continue;
+    unsatCore.push_back(*(query.constraints.begin() + (constraintId - 1)));
   }
+  Z3_ast_vector_dec_ref(builder->ctx, r);
 }
 
 }
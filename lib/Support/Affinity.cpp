@@ -0,0 +1,111 @@
+//===-- Affinity.cpp ------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/System/Affinity.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+using namespace klee;
+
+#ifdef __linux__
+/// Read the CPUs of each NUMA node from sysfs, as lists such as "0-3,8-11".
+static void readNodeCPUs(std::vector<std::vector<unsigned> > &nodes) {
+  for (unsigned node = 0;; ++node) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist",
+             node);
+    FILE *f = fopen(path, "r");
+    if (!f)
+      break;
+
+    char line[4096];
+    nodes.push_back(std::vector<unsigned>());
+    if (fgets(line, sizeof(line), f)) {
+      char *pos = line;
+      for (;;) {
+        char *end;
+        unsigned long first = strtoul(pos, &end, 10);
+        if (end == pos)
+          break;
+        unsigned long last = first;
+        if (*end == '-') {
+          pos = end + 1;
+          last = strtoul(pos, &end, 10);
+        }
+        for (unsigned long cpu = first; cpu <= last; ++cpu)
+          nodes.back().push_back(cpu);
+        if (*end != ',')
+          break;
+        pos = end + 1;
+      }
+    }
+    fclose(f);
+  }
+}
+
+/// The CPUs this process may run on, one from each NUMA node in turn
+static const std::vector<unsigned> &getWorkerCPUs() {
+  static std::vector<unsigned> cpus;
+  static bool initialized = false;
+  if (initialized)
+    return cpus;
+  initialized = true;
+
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+    return cpus;
+
+  std::vector<std::vector<unsigned> > nodes;
+  readNodeCPUs(nodes);
+  if (nodes.empty()) {
+    nodes.push_back(std::vector<unsigned>());
+    for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+      nodes.back().push_back(cpu);
+  }
+
+  for (unsigned i = 0;; ++i) {
+    bool more = false;
+    for (std::vector<std::vector<unsigned> >::iterator it = nodes.begin(),
+                                                       ie = nodes.end();
+         it != ie; ++it) {
+      if (i >= it->size())
+        continue;
+      more = true;
+      unsigned cpu = (*it)[i];
+      if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+        cpus.push_back(cpu);
+    }
+    if (!more)
+      break;
+  }
+  return cpus;
+}
+#endif
+
+bool util::pinToWorkerCPU(unsigned worker) {
+#ifdef __linux__
+  const std::vector<unsigned> &cpus = getWorkerCPUs();
+  if (cpus.empty())
+    return false;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpus[worker % cpus.size()], &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
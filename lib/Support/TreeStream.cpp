@@ -8,10 +8,12 @@
 //===----------------------------------------------------------------------===//
 
 #define DEBUG_TYPE "TreeStreamWriter"
+#include "klee/Config/config.h"
 #include "klee/Internal/ADT/TreeStream.h"
 
 #include "klee/Internal/Support/Debug.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iomanip>
 #include <fstream>
@@ -20,9 +22,35 @@
 
 #include "llvm/Support/raw_ostream.h"
 #include <string.h>
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
 
 using namespace klee;
 
+namespace {
+const uint32_t TreeStreamMagic = 0x3253544b; // "KTS2"
+
+const uint32_t TreeStreamVersion = 2;
+
+const uint32_t TreeStreamIndexMagic = 0x4953544b; // "KTSI"
+
+/// The offset of the stream a stream is opened from, when there is none
+const uint64_t NoRecord = ~0ULL;
+
+/// A record is its size and the offset of the previous record of the stream,
+/// followed by its contents
+const unsigned RecordHeaderSize = 12;
+}
+
+static void writeUInt32(std::ofstream &os, uint32_t value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void writeUInt64(std::ofstream &os, uint64_t value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
 ///
 
 TreeStreamWriter::TreeStreamWriter(const std::string &_path) 
@@ -31,17 +59,26 @@ TreeStreamWriter::TreeStreamWriter(const std::string &_path)
     path(_path),
     output(new std::ofstream(path.c_str(), 
                              std::ios::out | std::ios::binary)),
-    ids(1) {
+    ids(1),
+    lastRecords(1, NoRecord),
+    blockStart(0),
+    cachedBlock(~0u) {
   if (!output->good()) {
     delete output;
     output = 0;
+    return;
   }
+  block.reserve(blockSize);
+  writeUInt32(*output, TreeStreamMagic);
+  writeUInt32(*output, TreeStreamVersion);
+  writeUInt32(*output, blockSize);
 }
 
 TreeStreamWriter::~TreeStreamWriter() {
-  flush();
-  if (output)
+  if (output) {
+    close();
     delete output;
+  }
 }
 
 bool TreeStreamWriter::good() {
@@ -54,16 +91,15 @@ TreeOStream TreeStreamWriter::open() {
 
 TreeOStream TreeStreamWriter::open(const TreeOStream &os) {
   assert(output && os.writer==this);
-  flushBuffer();
+  // The new stream starts with the contents of the stream so far
+  if (bufferCount && lastID == os.id)
+    flushBuffer();
   unsigned id = ids++;
-  output->write(reinterpret_cast<const char*>(&os.id), 4);
-  unsigned tag = id | (1<<31);
-  output->write(reinterpret_cast<const char*>(&tag), 4);
+  lastRecords.push_back(lastRecords[os.id]);
   return TreeOStream(*this, id);
 }
 
 void TreeStreamWriter::write(TreeOStream &os, const char *s, unsigned size) {
-#if 1
   if (bufferCount && 
       (os.id!=lastID || size+bufferCount>bufferSize))
     flushBuffer();
@@ -75,96 +111,189 @@ void TreeStreamWriter::write(TreeOStream &os, const char *s, unsigned size) {
     memcpy(buffer, s, size);
     bufferCount = size;
   } else {
-    output->write(reinterpret_cast<const char*>(&os.id), 4);
-    output->write(reinterpret_cast<const char*>(&size), 4);
-    output->write(buffer, size);
+    writeRecord(os.id, s, size);
+  }
+}
+
+void TreeStreamWriter::writeRecord(unsigned id, const char *s,
+                                   unsigned size) {
+  char header[RecordHeaderSize];
+  memcpy(header, &size, 4);
+  memcpy(header + 4, &lastRecords[id], 8);
+  lastRecords[id] = blockStart + block.size();
+  append(header, RecordHeaderSize);
+  append(s, size);
+}
+
+void TreeStreamWriter::append(const char *s, unsigned size) {
+  while (size) {
+    unsigned n = std::min(size, (unsigned)(blockSize - block.size()));
+    block.insert(block.end(), s, s + n);
+    s += n;
+    size -= n;
+    if (block.size() == blockSize)
+      flushBlock();
   }
-#else
-  output->write(reinterpret_cast<const char*>(&os.id), 4);
-  output->write(reinterpret_cast<const char*>(&size), 4);
-  output->write(s, size);
-#endif
 }
 
 void TreeStreamWriter::flushBuffer() {
   if (bufferCount) {    
-    output->write(reinterpret_cast<const char*>(&lastID), 4);
-    output->write(reinterpret_cast<const char*>(&bufferCount), 4);
-    output->write(buffer, bufferCount);
+    writeRecord(lastID, buffer, bufferCount);
     bufferCount = 0;
   }
 }
 
+void TreeStreamWriter::flushBlock() {
+  if (block.empty())
+    return;
+
+  const char *data = &block[0];
+  uint32_t rawSize = block.size(), storedSize = rawSize;
+#ifdef HAVE_ZLIB_H
+  std::vector<char> compressed(compressBound(rawSize));
+  uLongf compressedSize = compressed.size();
+  // A block that does not shrink is stored as is, which is also how the
+  // reader tells the stored blocks apart
+  if (compress2(reinterpret_cast<Bytef *>(&compressed[0]), &compressedSize,
+                reinterpret_cast<const Bytef *>(data), rawSize,
+                Z_DEFAULT_COMPRESSION) == Z_OK &&
+      compressedSize < rawSize) {
+    data = &compressed[0];
+    storedSize = compressedSize;
+  }
+#endif
+
+  blockStarts.push_back(blockStart);
+  blockOffsets.push_back(output->tellp());
+  writeUInt32(*output, storedSize);
+  writeUInt32(*output, rawSize);
+  output->write(data, storedSize);
+
+  blockStart += rawSize;
+  block.clear();
+}
+
+void TreeStreamWriter::close() {
+  flushBuffer();
+  flushBlock();
+
+  // The index of the blocks, with its offset at the very end of the file
+  uint64_t indexOffset = output->tellp();
+  writeUInt64(*output, blockStarts.size());
+  for (unsigned i = 0; i < blockStarts.size(); ++i) {
+    writeUInt64(*output, blockStarts[i]);
+    writeUInt64(*output, blockOffsets[i]);
+  }
+  writeUInt64(*output, indexOffset);
+  writeUInt32(*output, TreeStreamIndexMagic);
+  output->flush();
+}
+
 void TreeStreamWriter::flush() {
   flushBuffer();
+  flushBlock();
   output->flush();
 }
 
+bool TreeStreamWriter::readBlock(std::ifstream &is, unsigned index) {
+  if (index == cachedBlock)
+    return true;
+
+  uint32_t storedSize, rawSize;
+  is.clear();
+  is.seekg(blockOffsets[index]);
+  is.read(reinterpret_cast<char *>(&storedSize), 4);
+  is.read(reinterpret_cast<char *>(&rawSize), 4);
+  std::vector<char> stored(storedSize);
+  is.read(&stored[0], storedSize);
+  if (!is.good())
+    return false;
+
+  if (storedSize == rawSize) {
+    cachedData.swap(stored);
+  } else {
+#ifdef HAVE_ZLIB_H
+    cachedData.resize(rawSize);
+    uLongf size = rawSize;
+    if (uncompress(reinterpret_cast<Bytef *>(&cachedData[0]), &size,
+                   reinterpret_cast<const Bytef *>(&stored[0]),
+                   storedSize) != Z_OK ||
+        size != rawSize)
+      return false;
+#else
+    return false;
+#endif
+  }
+  cachedBlock = index;
+  return true;
+}
+
+bool TreeStreamWriter::readLogical(std::ifstream &is, uint64_t offset,
+                                   char *s, unsigned size) {
+  while (size) {
+    const char *data;
+    uint64_t available;
+    if (offset >= blockStart) {
+      // The block being filled is still in memory
+      data = &block[offset - blockStart];
+      available = blockStart + block.size() - offset;
+    } else {
+      unsigned index =
+          std::upper_bound(blockStarts.begin(), blockStarts.end(), offset) -
+          blockStarts.begin() - 1;
+      if (!readBlock(is, index))
+        return false;
+      data = &cachedData[offset - blockStarts[index]];
+      available = blockStarts[index] + cachedData.size() - offset;
+    }
+    unsigned n = (unsigned)std::min((uint64_t)size, available);
+    memcpy(s, data, n);
+    s += n;
+    offset += n;
+    size -= n;
+  }
+  return true;
+}
+
 void TreeStreamWriter::readStream(TreeStreamID streamID,
                                   std::vector<unsigned char> &out) {
   assert(streamID>0 && streamID<ids);
-  flush();
+  flushBuffer();
+  output->flush();
   
   std::ifstream is(path.c_str(),
                    std::ios::in | std::ios::binary);
   assert(is.good());
   KLEE_DEBUG(llvm::errs() << "finding chain for: " << streamID << "\n");
 
-  std::map<unsigned,unsigned> parents;
-  std::vector<unsigned> roots;
-  for (;;) {
-    assert(is.good());
-    unsigned id;
-    unsigned tag;
-    is.read(reinterpret_cast<char*>(&id), 4);
-    is.read(reinterpret_cast<char*>(&tag), 4);
-    if (tag&(1<<31)) { // fork
-      unsigned child = tag ^ (1<<31);
-
-      if (child==streamID) {
-        roots.push_back(child);
-        while (id) {
-          roots.push_back(id);
-          std::map<unsigned, unsigned>::iterator it = parents.find(id);
-          assert(it!=parents.end());
-          id = it->second;
-        } 
-        break;
-      } else {
-        parents.insert(std::make_pair(child,id));
-      }
-    } else {
-      unsigned size = tag;
-      while (size--) is.get();
-    }
+  // Follow the chain of records back to the first, then read them forward
+  std::vector<std::pair<uint64_t, unsigned> > records;
+  for (uint64_t offset = lastRecords[streamID]; offset != NoRecord;) {
+    char header[RecordHeaderSize];
+    bool success = readLogical(is, offset, header, RecordHeaderSize);
+    assert(success && "corrupt tree stream");
+    (void)success;
+    unsigned size;
+    memcpy(&size, header, 4);
+    records.push_back(std::make_pair(offset + RecordHeaderSize, size));
+    memcpy(&offset, header + 4, 8);
+  }
+  KLEE_DEBUG(llvm::errs() << "records: " << records.size() << "\n");
+
+  for (std::vector<std::pair<uint64_t, unsigned> >::reverse_iterator
+           it = records.rbegin(),
+           ie = records.rend();
+       it != ie; ++it) {
+    size_t start = out.size();
+    out.resize(start + it->second);
+    if (!it->second)
+      continue;
+    bool success = readLogical(is, it->first,
+                               reinterpret_cast<char *>(&out[start]),
+                               it->second);
+    assert(success && "corrupt tree stream");
+    (void)success;
   }
-  KLEE_DEBUG({
-      llvm::errs() << "roots: ";
-      for (size_t i = 0, e = roots.size(); i < e; ++i) {
-        llvm::errs() << roots[i] << " ";
-      }
-      llvm::errs() << "\n";
-    });
-  is.seekg(0, std::ios::beg);
-  for (;;) {
-    unsigned id;
-    unsigned tag;
-    is.read(reinterpret_cast<char*>(&id), 4);
-    is.read(reinterpret_cast<char*>(&tag), 4);
-    if (!is.good()) break;
-    if (tag&(1<<31)) { // fork
-      unsigned child = tag ^ (1<<31);
-      if (id==roots.back() && roots.size()>1 && child==roots[roots.size()-2])
-        roots.pop_back();
-    } else {
-      unsigned size = tag;
-      if (id==roots.back()) {
-        while (size--) out.push_back(is.get());
-      } else {
-        while (size--) is.get();
-      }
-    }
-  }  
 }
 
 ///
@@ -392,7 +392,10 @@ ssize_t read(int fd, void *buf, size_t count) {
       count = f->dfile->size - f->off;
     }
     
-    memcpy(buf, f->dfile->contents + f->off, count);
+    /* The executor copies the bytes when it can, which is much cheaper than
+       executing the copy loop */
+    if (!klee_copy_bytes(buf, f->dfile->contents + f->off, count))
+      memcpy(buf, f->dfile->contents + f->off, count);
     f->off += count;
     
     return count;
@@ -457,7 +460,8 @@ ssize_t write(int fd, const void *buf, size_t count) {
       }
     }
     
-    if (actual_count)
+    if (actual_count &&
+        !klee_copy_bytes(f->dfile->contents + f->off, buf, actual_count))
       memcpy(f->dfile->contents + f->off, buf, actual_count);
     
     if (count != actual_count)
@@ -144,6 +144,11 @@ usage: (klee_init_env) [options] [program arguments]\n\
       max_argvs = __str_to_int(argv[k++], msg);
       max_len = __str_to_int(argv[k++], msg);
 
+      /* The arguments are only made on the paths that have them, and the
+         bytes of an argument that are never read only reach the queries
+         through their counterexample preferences. They are not made when
+         first read, as the objects of a path must all be made in the same
+         order during the replay of its test. */
       n_args = klee_range(min_argvs, max_argvs+1, "n_args");
       for (i=0; i < n_args; i++) {
         sym_arg_name[3] = '0' + sym_arg_num++;
@@ -0,0 +1,46 @@
+; RUN: %kleaver -evaluate %s > %t.log
+
+(set-logic QF_ABV)
+(set-option :produce-models true)
+(declare-fun a () (Array (_ BitVec 32) (_ BitVec 8)))
+(declare-fun x () (_ BitVec 32))
+(declare-const b Bool)
+
+; RUN: grep "Query 0:	INVALID" %t.log
+(push 1)
+(assert (bvult x #x00000010))
+(check-sat)
+(get-value (x))
+(pop 1)
+
+; RUN: grep "Query 1:	VALID" %t.log
+(push 1)
+(define-fun lo () (_ BitVec 16) ((_ extract 15 0) x))
+(assert (= lo #x1234))
+(assert (! (not (= ((_ zero_extend 16) lo) (bvand x (_ bv65535 32))))
+           :named mask))
+(check-sat)
+(pop 1)
+
+; RUN: grep "Query 2:	VALID" %t.log
+(push 1)
+(assert (let ((v (concat (select a (_ bv1 32)) (select a (_ bv0 32)))))
+          (and (= v #x0a14) (distinct (bvadd ((_ extract 7 0) v) #x0a) #x1e))))
+(check-sat)
+(pop 1)
+
+; RUN: grep "Query 3:	INVALID" %t.log
+(check-sat-assuming (b (= (select (store a x #x05) x) #x05)))
+
+; RUN: grep "Query 4:	VALID" %t.log
+(assert (=> b (bvslt x #x00000000)))
+(assert b)
+(assert (bvsge x (bvneg #x00000000)))
+(check-sat)
+(exit)
+
+; The assertions are cleared by the exit
+; RUN: grep "Query 5:	INVALID" %t.log
+(declare-fun x () (_ BitVec 8))
+(assert (= (bvsmod x #xfd) #xff))
+(check-sat)
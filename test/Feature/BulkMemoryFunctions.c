@@ -0,0 +1,40 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -no-interpolation --exit-on-error %t.bc | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -no-interpolation -bulk-memory-functions=false --exit-on-error %t.bc | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+int main() {
+  char src[8], dest[8];
+  unsigned char c;
+  klee_make_symbolic(src, sizeof(src), "src");
+  klee_make_symbolic(&c, sizeof(c), "c");
+
+  assert(memcpy(dest, src, sizeof(src)) == dest);
+  assert(memcmp(dest, src, sizeof(src)) == 0);
+
+  // Overlapping ranges of the same object
+  memcpy(dest, "abcdefgh", 8);
+  memmove(dest + 2, dest, 5);
+  assert(memcmp(dest, "ababcdeh", 8) == 0);
+
+  memset(dest, c, 4);
+  assert(dest[3] == (char)c);
+  memset(dest + 4, 0, 4);
+  assert(dest[4] == 0 && dest[7] == 0);
+
+  if (dest[0] == src[0])
+    printf("same\n");
+  else
+    printf("different\n");
+
+  // CHECK-DAG: same
+  // CHECK-DAG: different
+  return 0;
+}
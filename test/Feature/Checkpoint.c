@@ -0,0 +1,27 @@
+// Check that a run resumed from a checkpoint explores the paths left by the
+// interrupted run, and only them.
+//
+// RUN: %llvmgcc %s -emit-llvm -g -c -o %t.bc
+// RUN: rm -rf %t.checkpoint %t1.klee-out %t2.klee-out
+// RUN: %klee --output-dir=%t1.klee-out --no-interpolation --search=dfs --checkpoint-dir=%t.checkpoint --stop-after-n-tests=3 --dump-states-on-halt=false %t.bc 2>&1 | FileCheck --check-prefix=CHECK-FIRST %s
+// RUN: %klee --output-dir=%t2.klee-out --no-interpolation --search=dfs --resume-from=%t.checkpoint %t.bc 2>&1 | FileCheck --check-prefix=CHECK-RESUMED %s
+
+// CHECK-FIRST: KLEE: done: generated tests = 3
+// CHECK-RESUMED: resuming {{[0-9]+}} states of checkpoint
+// CHECK-RESUMED: KLEE: done: generated tests = 5
+
+#include "klee/klee.h"
+
+int main() {
+  int a, b, c, n = 0;
+  klee_make_symbolic(&a, sizeof(a), "a");
+  klee_make_symbolic(&b, sizeof(b), "b");
+  klee_make_symbolic(&c, sizeof(c), "c");
+  if (a > 0)
+    ++n;
+  if (b > 0)
+    ++n;
+  if (c > 0)
+    ++n;
+  return n;
+}
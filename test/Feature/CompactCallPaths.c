@@ -0,0 +1,21 @@
+// Check that the calls are still written to run.istats with the compact and
+// bounded call paths.
+//
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --compact-call-paths --max-call-path-depth=2 %t1.bc
+// RUN: FileCheck < %t.klee-out/run.istats %s
+
+// CHECK: fn=main
+// CHECK: cfn=f
+// CHECK-NEXT: calls=1
+// CHECK: fn=f
+// CHECK: cfn=g
+
+int g(int n) { return n ? g(n - 1) + 1 : 0; }
+
+int f(int n) { return g(n) + g(n + 1); }
+
+int main() {
+  return f(8) != 17;
+}
@@ -0,0 +1,22 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out %t.klee-replay %t.klee-error
+// RUN: %klee --output-dir=%t.klee-out %t1.bc
+// RUN: %klee --output-dir=%t.klee-replay --concrete-replay --replay-ktest-dir=%t.klee-out %t1.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-replay | grep .ptr.err | wc -l | grep 1
+// RUN: not %klee --output-dir=%t.klee-error --concrete-replay %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-OPTION %s
+
+// CHECK: KLEE: ERROR: {{.*}}memory error: out of bound pointer
+// CHECK-OPTION: -concrete-replay requires -replay-ktest-file or -replay-ktest-dir
+
+int main() {
+  char buf[4];
+  unsigned i;
+  klee_make_symbolic(&i, sizeof(i), "i");
+  if (i < 4)
+    buf[i] = 1;
+  else if (i < 100)
+    return 1;
+  else
+    buf[i % 8] = 2;
+  return 0;
+}
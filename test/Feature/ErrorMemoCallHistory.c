@@ -0,0 +1,29 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -no-interpolation %t.bc 2>&1 | FileCheck %s --check-prefix=CHECK-SITE
+// RUN: ls %t.klee-out | grep -c assert.err | FileCheck %s --check-prefix=CHECK-ONE
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -no-interpolation -error-memo=call-history %t.bc 2>&1 | FileCheck %s --check-prefix=CHECK-CALL
+// RUN: ls %t.klee-out | grep -c assert.err | FileCheck %s --check-prefix=CHECK-TWO
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+void check(int x) { assert(x != 0); }
+
+int main() {
+  int a, b;
+  klee_make_symbolic(&a, sizeof(a), "a");
+  klee_make_symbolic(&b, sizeof(b), "b");
+
+  // The same assertion fails under two call stacks
+  check(a);
+  check(b);
+  return 0;
+}
+
+// CHECK-SITE: NOTE: now ignoring this error at this location
+// CHECK-CALL: NOTE: now ignoring this error at this location under this call stack
+// CHECK-ONE: 1
+// CHECK-TWO: 2
@@ -0,0 +1,23 @@
+// Check that the bytes implied by an equality with a constant are written
+// back, such that their later reads are concrete.
+//
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --no-interpolation --implied-value-concretization %t.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+#include <stdio.h>
+
+int main() {
+  unsigned char a[4];
+  klee_make_symbolic(a, sizeof(a), "a");
+  if (a[1] == 42) {
+    // CHECK: a[1] is concrete
+    if (!klee_is_symbolic(a[1]))
+      printf("a[1] is concrete\n");
+    // CHECK-NOT: a[0] is concrete
+    if (!klee_is_symbolic(a[0]))
+      printf("a[0] is concrete\n");
+  }
+  return 0;
+}
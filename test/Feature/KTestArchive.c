@@ -0,0 +1,18 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --write-ktest-archive --compress-ktest-archive %t1.bc
+// RUN: not ls %t.klee-out/test000001.ktest
+// RUN: ktest-tool %t.klee-out/tests.ktar | FileCheck %s
+
+// CHECK: ktest file : '{{.*}}tests.ktar:test000001'
+// CHECK: name: {{b?}}'x'
+// CHECK: ktest file : '{{.*}}tests.ktar:test000002'
+// CHECK: name: {{b?}}'x'
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x > 10)
+    return 1;
+  return 0;
+}
@@ -0,0 +1,18 @@
+// Check that the live statistics file is created and left with the magic
+// number of its layout.
+//
+// RUN: %llvmgcc %s -emit-llvm -g -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.live
+// RUN: %klee --output-dir=%t.klee-out --live-stats-file=%t.live %t.bc
+// RUN: test -s %t.live
+// RUN: head -c 4 %t.live | grep KLST
+
+#include "klee/klee.h"
+
+int main() {
+  int a;
+  klee_make_symbolic(&a, sizeof(a), "a");
+  if (a > 0)
+    return 1;
+  return 0;
+}
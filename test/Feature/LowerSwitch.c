@@ -7,6 +7,11 @@
 // RUN: %klee --no-interpolation --output-dir=%t.klee-out --exit-on-error --allow-external-sym-calls --switch-type=simple %t.bc
 // RUN: test -f %t.klee-out/test000010.ktest
 
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error --allow-external-sym-calls --switch-type=internal --switch-enumeration %t.bc
+// RUN: test -f %t.klee-out/test000008.ktest
+// RUN: not test -f %t.klee-out/test000009.ktest
+
 #include <stdio.h>
 
 int main(int argc, char **argv) {
@@ -0,0 +1,22 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.memo
+// RUN: %klee --output-dir=%t.klee-out --memo-table-file=%t.memo %t.bc > %t1.log
+// RUN: grep "reached" %t1.log
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --memo-table-file=%t.memo %t.bc > %t2.log
+// RUN: not grep "reached" %t2.log
+
+#include "klee/klee.h"
+#include <stdio.h>
+
+int main() {
+  char c = 2;
+  long long l = 3;
+
+  // The tuples of the same values at other widths are distinct
+  tracerx_memo(3, 1, (short)c, (int)l);
+  tracerx_memo_check(3, 1, c, l);
+  printf("reached\n");
+  tracerx_memo(3, 1, c, l);
+  return 0;
+}
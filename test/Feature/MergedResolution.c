@@ -0,0 +1,38 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -no-interpolation -max-merged-resolutions=4 %t1.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -no-interpolation %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-FORK %s
+
+#include <assert.h>
+#include <stdlib.h>
+
+int *make_int(int i) {
+  int *x = malloc(sizeof(*x));
+  *x = i;
+  return x;
+}
+
+int main() {
+  int *buf[4];
+  int i;
+  unsigned s;
+
+  for (i = 0; i < 4; i++)
+    buf[i] = make_int((i + 1) * 2);
+
+  klee_make_symbolic(&s, sizeof s, "s");
+  klee_assume(s < 4);
+
+  // The write and the read through the pointer to any of the four objects
+  // are done in a single state
+  *buf[s] += 1;
+  assert(*buf[s] == (int)(s + 1) * 2 + 1);
+  assert(*buf[(s + 1) % 4] == (int)((s + 1) % 4 + 1) * 2);
+
+  return 0;
+}
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 1
+// CHECK-FORK-NOT: ASSERTION FAIL
+// CHECK-FORK: KLEE: done: completed paths = 4
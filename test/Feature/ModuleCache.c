@@ -0,0 +1,22 @@
+// Check that the second run on the same program loads the linked module from
+// the cache instead of linking it again.
+//
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t.bc
+// RUN: rm -rf %t.cache %t1.klee-out %t2.klee-out
+// RUN: %klee --output-dir=%t1.klee-out --libc=klee --module-cache-dir=%t.cache %t.bc 2>&1 | FileCheck --check-prefix=CHECK-FIRST %s
+// RUN: ls %t.cache | grep module-
+// RUN: %klee --output-dir=%t2.klee-out --libc=klee --module-cache-dir=%t.cache %t.bc 2>&1 | FileCheck --check-prefix=CHECK-SECOND %s
+// RUN: ls %t2.klee-out | grep .ktest
+
+// CHECK-FIRST-NOT: Using the linked module cached
+// CHECK-SECOND: Using the linked module cached in {{.*}}module-{{[0-9a-f]+}}.bc
+
+#include <string.h>
+
+int main() {
+  char s[4];
+  klee_make_symbolic(s, sizeof(s), "s");
+  if (strlen(s) == 2)
+    return 1;
+  return 0;
+}
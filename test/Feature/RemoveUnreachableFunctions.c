@@ -0,0 +1,26 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error %t.bc
+// RUN: FileCheck %s --input-file=%t.klee-out/assembly.ll
+// RUN: rm -rf %t.klee-out2
+// RUN: %klee --output-dir=%t.klee-out2 --exit-on-error --remove-unreachable-functions=false %t.bc
+// RUN: grep "define.*@unreachable" %t.klee-out2/assembly.ll
+
+// CHECK-NOT: define{{.*}}@unreachable
+// CHECK-DAG: define{{.*}}@called
+// CHECK-DAG: define{{.*}}@pointed
+// CHECK-DAG: define{{.*}}@stored
+
+int pointed(int x) { return x + 1; }
+
+int stored(int x) { return x + 2; }
+
+int (*table[])(int) = { stored };
+
+int unreachable(int x) { return pointed(x) * 2; }
+
+int called(int (*f)(int), int x) { return f(x); }
+
+int main() {
+  return called(pointed, 1) + table[0](1) != 5;
+}
@@ -0,0 +1,27 @@
+// Check that the coverage of a previous run is resumed, such that no state
+// covers new instructions when the program did not change.
+//
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t.bc
+// RUN: rm -rf %t1.klee-out %t2.klee-out
+// RUN: %klee --output-dir=%t1.klee-out --only-output-states-covering-new %t.bc
+// RUN: ls %t1.klee-out | grep .ktest
+// RUN: %klee --output-dir=%t2.klee-out --only-output-states-covering-new --resume-coverage=%t1.klee-out/run.istats %t.bc 2>&1 | FileCheck %s
+// RUN: not ls %t2.klee-out | grep .ktest
+
+// CHECK: resuming the coverage of {{[1-9][0-9]*}} instructions from {{.*}}run.istats, 0 functions changed
+
+#include "klee/klee.h"
+
+void f0(void) {}
+void f1(void) {}
+
+int main() {
+  int x = klee_range(0, 256, "x");
+
+  if (x == 17)
+    f0();
+  else
+    f1();
+
+  return 0;
+}
@@ -0,0 +1,22 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --solver-backend=stp --stp-worker --max-solver-time=10 %t1.bc 2>&1 | FileCheck %s
+// RUN: test -f %t.klee-out/test000004.ktest
+// REQUIRES: stp
+
+int main() {
+  int x, y;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&y, sizeof(y), "y");
+
+  if (x > 10) {
+    if (y == x * 3)
+      return 1;
+    return 2;
+  }
+  if (x + y == 7)
+    return 3;
+
+  // CHECK: KLEE: done: completed paths = 4
+  return 0;
+}
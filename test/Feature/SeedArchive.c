@@ -0,0 +1,17 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --write-ktest-archive %t1.bc
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --only-replay-seeds --seed-out %t.klee-out/tests.ktar --seed-out-dir %t.klee-out %t1.bc 2>&1 | FileCheck %s
+
+// The seeds of the archive are given twice, the second time from its directory
+// CHECK: dropped 2 duplicate seeds
+// CHECK: using 2 seeds
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x > 10)
+    return 1;
+  return 0;
+}
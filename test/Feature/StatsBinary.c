@@ -0,0 +1,19 @@
+// Check that the binary statistics replace run.stats and start with the
+// magic number of their format.
+//
+// RUN: %llvmgcc %s -emit-llvm -g -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --stats-binary %t.bc
+// RUN: test -s %t.klee-out/run.stats.bin
+// RUN: not test -f %t.klee-out/run.stats
+// RUN: head -c 4 %t.klee-out/run.stats.bin | grep KRST
+
+#include "klee/klee.h"
+
+int main() {
+  int a;
+  klee_make_symbolic(&a, sizeof(a), "a");
+  if (a > 0)
+    return 1;
+  return 0;
+}
@@ -0,0 +1,35 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -no-interpolation -string-function-summaries --exit-on-error %t.bc 2>&1 | FileCheck %s --check-prefix=CHECK-SUMMARY
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -no-interpolation --exit-on-error %t.bc 2>&1 | FileCheck %s --check-prefix=CHECK-LOOP
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+int main() {
+  char s[4];
+  klee_make_symbolic(s, sizeof(s), "s");
+  s[3] = 0;
+
+  assert(strlen("abc") == 3);
+  assert(strcmp("abc", "abd") < 0);
+  assert(strncmp("abc", "abd", 2) == 0);
+  assert(memcmp("abc", "abd", 3) < 0);
+  assert(memchr("abc", 'b', 3) != 0);
+  assert(memchr("abc", 'd', 3) == 0);
+
+  // The length is a single expression with the summaries, the loop of strlen
+  // forking at each byte otherwise
+  if (strlen(s) == 2)
+    printf("two\n");
+  else
+    printf("other\n");
+
+  // CHECK-SUMMARY: KLEE: done: completed paths = 2
+  // CHECK-LOOP: KLEE: done: completed paths = 4
+  return 0;
+}
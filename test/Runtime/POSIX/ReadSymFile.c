@@ -0,0 +1,38 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error --posix-runtime %t.bc --sym-files 1 8 2>&1 | FileCheck %s
+// RUN: test -f %t.klee-out/test000002.ktest
+// RUN: not test -f %t.klee-out/test000003.ktest
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+  char buf[8], again[8];
+  int fd = open("A", O_RDWR);
+  assert(fd != -1);
+
+  assert(read(fd, buf, sizeof(buf)) == 8);
+  assert(lseek(fd, 2, SEEK_SET) == 2);
+  assert(read(fd, again, 4) == 4);
+  assert(memcmp(buf + 2, again, 4) == 0);
+
+  // The bytes written over the file are read back
+  assert(lseek(fd, 0, SEEK_SET) == 0);
+  assert(write(fd, "ab", 2) == 2);
+  assert(lseek(fd, 0, SEEK_SET) == 0);
+  assert(read(fd, again, 3) == 3);
+  assert(again[0] == 'a' && again[1] == 'b' && again[2] == buf[2]);
+
+  if (buf[7] == 'x')
+    printf("x\n");
+  else
+    printf("not x\n");
+
+  // CHECK-DAG: {{^}}x
+  // CHECK-DAG: not x
+  return 0;
+}
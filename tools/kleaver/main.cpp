@@ -23,14 +23,23 @@
 #include "klee/util/ExprVisitor.h"
 #include "klee/util/ExprSMTLIBPrinter.h"
 #include "klee/Internal/Support/PrintVersion.h"
+#include "klee/Internal/System/Affinity.h"
+#include "klee/Internal/System/Time.h"
 
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 
@@ -54,7 +63,8 @@ namespace {
     PrintTokens,
     PrintAST,
     PrintSMTLIBv2,
-    Evaluate
+    Evaluate,
+    BatchEvaluate
   };
 
   static llvm::cl::opt<ToolActions> 
@@ -69,13 +79,23 @@ namespace {
                         "Print parsed AST nodes from the input file."),
              clEnumValN(Evaluate, "evaluate",
                         "Print parsed AST nodes from the input file."),
+             clEnumValN(BatchEvaluate, "batch",
+                        "Evaluate the queries in parallel processes, and "
+                        "print their timings as CSV."),
              clEnumValEnd));
 
+  llvm::cl::opt<unsigned>
+  BatchJobs("jobs",
+            llvm::cl::desc("Number of worker processes of -batch "
+                           "(default=1)"),
+            llvm::cl::init(1));
+
 
   enum BuilderKinds {
     DefaultBuilder,
     ConstantFoldingBuilder,
-    SimplifyingBuilder
+    SimplifyingBuilder,
+    HashConsingBuilder
   };
 
   static llvm::cl::opt<BuilderKinds> 
@@ -89,6 +109,8 @@ namespace {
                          "Fold constant expressions."),
               clEnumValN(SimplifyingBuilder, "simplify",
                          "Fold constants and simplify expressions."),
+              clEnumValN(HashConsingBuilder, "hash-consing",
+                         "Simplify expressions and share equal nodes."),
               clEnumValEnd));
 
 
@@ -194,39 +216,119 @@ static bool PrintInputAST(const char *Filename,
   return success;
 }
 
-static bool EvaluateInputAST(const char *Filename,
-                             const MemoryBuffer *MB,
-                             ExprBuilder *Builder) {
-	llvm::outs() << "EvaluateInputAST\n";
-  std::vector<Decl*> Decls;
-  Parser *P = Parser::Create(Filename, MB, Builder, ClearArrayAfterQuery);
+static Solver *createSolverChain(const std::string &suffix) {
+  Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
+
+  if (CoreSolverToUse != DUMMY_SOLVER) {
+    if (0 != MaxCoreSolverTime) {
+      coreSolver->setCoreSolverTimeout(MaxCoreSolverTime);
+    }
+  }
+
+  return constructSolverChain(
+      coreSolver,
+      getQueryLogPath(ALL_QUERIES_SMT2_FILE_NAME) + suffix,
+      getQueryLogPath(SOLVER_QUERIES_SMT2_FILE_NAME) + suffix,
+      getQueryLogPath(ALL_QUERIES_PC_FILE_NAME) + suffix,
+      getQueryLogPath(SOLVER_QUERIES_PC_FILE_NAME) + suffix,
+      getQueryLogPath(ALL_QUERIES_BINARY_FILE_NAME) + suffix,
+      getQueryLogPath(SOLVER_QUERIES_BINARY_FILE_NAME) + suffix);
+}
+
+/// Evaluate a query command, and print its result.
+static void evaluateQuery(Solver *S, QueryCommand *QC, llvm::raw_ostream &os) {
+  assert("FIXME: Support counterexample query commands!");
+  if (QC->Values.empty() && QC->Objects.empty()) {
+    bool result;
+    if (S->mustBeTrue(Query(ConstraintManager(QC->Constraints), QC->Query),
+                      result)) {
+      os << (result ? "VALID" : "INVALID");
+    } else {
+      os << "FAIL (reason: "
+         << SolverImpl::getOperationStatusString(
+                S->impl->getOperationStatusCode()) << ")";
+    }
+  } else if (!QC->Values.empty()) {
+    assert(QC->Objects.empty() &&
+           "FIXME: Support counterexamples for values and objects!");
+    assert(QC->Values.size() == 1 &&
+           "FIXME: Support counterexamples for multiple values!");
+    assert(QC->Query->isFalse() &&
+           "FIXME: Support counterexamples with non-trivial query!");
+    ref<ConstantExpr> result;
+    if (S->getValue(Query(ConstraintManager(QC->Constraints), QC->Values[0]),
+                    result)) {
+      os << "INVALID\n";
+      os << "\tExpr 0:\t" << result;
+    } else {
+      os << "FAIL (reason: "
+         << SolverImpl::getOperationStatusString(
+                S->impl->getOperationStatusCode()) << ")";
+    }
+  } else {
+    std::vector<std::vector<unsigned char> > result;
+    std::vector<ref<Expr> > unsatCore;
+    if (S->getInitialValues(
+            Query(ConstraintManager(QC->Constraints), QC->Query), QC->Objects,
+            result, unsatCore)) {
+      os << "INVALID\n";
+
+      for (unsigned i = 0, e = result.size(); i != e; ++i) {
+        os << "\tArray " << i << ":\t" << QC->Objects[i]->name << "[";
+        for (unsigned j = 0; j != QC->Objects[i]->size; ++j) {
+          os << (unsigned)result[i][j];
+          if (j + 1 != QC->Objects[i]->size)
+            os << ", ";
+        }
+        os << "]";
+        if (i + 1 != e)
+          os << "\n";
+      }
+    } else {
+      SolverImpl::SolverRunStatus retCode = S->impl->getOperationStatusCode();
+      if (SolverImpl::SOLVER_RUN_STATUS_TIMEOUT == retCode) {
+        os << " FAIL (reason: "
+           << SolverImpl::getOperationStatusString(retCode) << ")";
+      } else {
+        os << "VALID (counterexample request ignored)";
+      }
+    }
+  }
+}
+
+static bool parseQueries(const char *Filename, const MemoryBuffer *MB,
+                         ExprBuilder *Builder, std::vector<Decl *> &Decls,
+                         Parser *&P) {
+  P = Parser::Create(Filename, MB, Builder, ClearArrayAfterQuery);
   P->SetMaxErrors(20);
   while (Decl *D = P->ParseTopLevelDecl()) {
     Decls.push_back(D);
   }
 
-  bool success = true;
   if (unsigned N = P->GetNumErrors()) {
     llvm::errs() << Filename << ": parse failure: " << N << " errors.\n";
-    success = false;
-  }  
-
-  if (!success)
     return false;
+  }
+  return true;
+}
 
-  Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
+static void deleteQueries(std::vector<Decl *> &Decls, Parser *P) {
+  for (std::vector<Decl*>::iterator it = Decls.begin(),
+         ie = Decls.end(); it != ie; ++it)
+    delete *it;
+  delete P;
+}
 
-  if (CoreSolverToUse != DUMMY_SOLVER) {
-    if (0 != MaxCoreSolverTime) {
-      coreSolver->setCoreSolverTimeout(MaxCoreSolverTime);
-    }
-  }
+static bool EvaluateInputAST(const char *Filename,
+                             const MemoryBuffer *MB,
+                             ExprBuilder *Builder) {
+	llvm::outs() << "EvaluateInputAST\n";
+  std::vector<Decl*> Decls;
+  Parser *P;
+  if (!parseQueries(Filename, MB, Builder, Decls, P))
+    return false;
 
-  Solver *S = constructSolverChain(coreSolver,
-                                   getQueryLogPath(ALL_QUERIES_SMT2_FILE_NAME),
-                                   getQueryLogPath(SOLVER_QUERIES_SMT2_FILE_NAME),
-                                   getQueryLogPath(ALL_QUERIES_PC_FILE_NAME),
-                                   getQueryLogPath(SOLVER_QUERIES_PC_FILE_NAME));
+  Solver *S = createSolverChain("");
 
   unsigned Index = 0;
   for (std::vector<Decl*>::iterator it = Decls.begin(),
@@ -234,79 +336,13 @@ static bool EvaluateInputAST(const char *Filename,
     Decl *D = *it;
     if (QueryCommand *QC = dyn_cast<QueryCommand>(D)) {
       llvm::outs() << "Query " << Index << ":\t";
-
-      assert("FIXME: Support counterexample query commands!");
-      if (QC->Values.empty() && QC->Objects.empty()) {
-        bool result;
-        if (S->mustBeTrue(Query(ConstraintManager(QC->Constraints), QC->Query),
-                          result)) {
-          llvm::outs() << (result ? "VALID" : "INVALID");
-        } else {
-          llvm::outs() << "FAIL (reason: "
-                    << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
-                    << ")";
-        }
-      } else if (!QC->Values.empty()) {
-        assert(QC->Objects.empty() && 
-               "FIXME: Support counterexamples for values and objects!");
-        assert(QC->Values.size() == 1 &&
-               "FIXME: Support counterexamples for multiple values!");
-        assert(QC->Query->isFalse() &&
-               "FIXME: Support counterexamples with non-trivial query!");
-        ref<ConstantExpr> result;
-        if (S->getValue(Query(ConstraintManager(QC->Constraints), 
-                              QC->Values[0]),
-                        result)) {
-          llvm::outs() << "INVALID\n";
-          llvm::outs() << "\tExpr 0:\t" << result;
-        } else {
-          llvm::outs() << "FAIL (reason: "
-                    << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
-                    << ")";
-        }
-      } else {
-        std::vector< std::vector<unsigned char> > result;
-        std::vector<ref<Expr> > unsatCore;
-        if (S->getInitialValues(
-                Query(ConstraintManager(QC->Constraints), QC->Query),
-                QC->Objects, result, unsatCore)) {
-          llvm::outs() << "INVALID\n";
-
-          for (unsigned i = 0, e = result.size(); i != e; ++i) {
-            llvm::outs() << "\tArray " << i << ":\t"
-                       << QC->Objects[i]->name
-                       << "[";
-            for (unsigned j = 0; j != QC->Objects[i]->size; ++j) {
-              llvm::outs() << (unsigned) result[i][j];
-              if (j + 1 != QC->Objects[i]->size)
-                llvm::outs() << ", ";
-            }
-            llvm::outs() << "]";
-            if (i + 1 != e)
-              llvm::outs() << "\n";
-          }
-        } else {
-          SolverImpl::SolverRunStatus retCode = S->impl->getOperationStatusCode();
-          if (SolverImpl::SOLVER_RUN_STATUS_TIMEOUT == retCode) {
-            llvm::outs() << " FAIL (reason: "
-                      << SolverImpl::getOperationStatusString(retCode)
-                      << ")";
-          }           
-          else {
-            llvm::outs() << "VALID (counterexample request ignored)";
-          }
-        }
-      }
-
+      evaluateQuery(S, QC, llvm::outs());
       llvm::outs() << "\n";
       ++Index;
     }
   }
 
-  for (std::vector<Decl*>::iterator it = Decls.begin(),
-         ie = Decls.end(); it != ie; ++it)
-    delete *it;
-  delete P;
+  deleteQueries(Decls, P);
 
   delete S;
 
@@ -324,6 +360,145 @@ static bool EvaluateInputAST(const char *Filename,
       << *theStatisticManager->getStatisticByName("QueriesCEX") << "\n";
   }
 
+  return true;
+}
+
+/// Evaluate the queries in worker processes, each with its own solver chain,
+/// taking the next query from a shared counter, and print the result and
+/// time of each query as CSV to stdout, and their percentiles as CSV to
+/// stderr. The workers have their own query logs, suffixed with their number.
+static bool evaluateInputBatch(const char *Filename, const MemoryBuffer *MB,
+                               ExprBuilder *Builder) {
+  std::vector<Decl*> Decls;
+  Parser *P;
+  if (!parseQueries(Filename, MB, Builder, Decls, P))
+    return false;
+
+  std::vector<QueryCommand *> Queries;
+  for (std::vector<Decl*>::iterator it = Decls.begin(),
+         ie = Decls.end(); it != ie; ++it)
+    if (QueryCommand *QC = dyn_cast<QueryCommand>(*it))
+      Queries.push_back(QC);
+
+  unsigned Jobs = std::max(1U, BatchJobs.getValue());
+  volatile unsigned *Next = (volatile unsigned *)mmap(
+      0, sizeof(unsigned), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+      -1, 0);
+  if (Next == MAP_FAILED) {
+    llvm::errs() << "error: unable to allocate the shared query counter\n";
+    deleteQueries(Decls, P);
+    return false;
+  }
+  *Next = 0;
+
+  // The results of each worker, as lines of the query index, its time and
+  // its result
+  std::vector<FILE *> Results(Jobs);
+  std::vector<pid_t> Workers;
+  bool success = true;
+  llvm::outs().flush();
+  llvm::errs().flush();
+  for (unsigned k = 0; k < Jobs; ++k) {
+    Results[k] = tmpfile();
+    pid_t pid = Results[k] ? fork() : -1;
+    if (pid < 0) {
+      llvm::errs() << "error: unable to start batch worker " << k << "\n";
+      success = false;
+      break;
+    }
+    if (pid == 0) {
+      if (PinWorkers && !util::pinToWorkerCPU(k))
+        llvm::errs() << "warning: unable to pin batch worker " << k << "\n";
+      Solver *S = createSolverChain(Jobs > 1 ? "." + llvm::utostr(k) : "");
+      for (;;) {
+        unsigned Index = __sync_fetch_and_add(Next, 1);
+        if (Index >= Queries.size())
+          break;
+        std::string Output;
+        llvm::raw_string_ostream os(Output);
+        double Start = util::getWallTime();
+        evaluateQuery(S, Queries[Index], os);
+        double Elapsed = util::getWallTime() - Start;
+        os.flush();
+
+        // The result is the first word of the output
+        size_t Begin = Output.find_first_not_of(" ");
+        size_t End = Output.find_first_of(" \n", Begin);
+        std::string Result = Begin == std::string::npos
+                                 ? ""
+                                 : Output.substr(Begin, End - Begin);
+        fprintf(Results[k], "%u %.6f %s\n", Index, Elapsed, Result.c_str());
+      }
+      fflush(Results[k]);
+      delete S;
+      _exit(0);
+    }
+    Workers.push_back(pid);
+  }
+
+  for (std::vector<pid_t>::iterator it = Workers.begin(), ie = Workers.end();
+       it != ie; ++it) {
+    int status;
+    while (waitpid(*it, &status, 0) < 0 && errno == EINTR)
+      ;
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+      llvm::errs() << "error: a batch worker did not finish successfully\n";
+      success = false;
+    }
+  }
+
+  // The queries which a crashed worker did not finish are reported as such
+  std::vector<double> Times(Queries.size(), -1.0);
+  std::vector<std::string> Outcomes(Queries.size(), "CRASH");
+  for (unsigned k = 0; k < Results.size(); ++k) {
+    if (!Results[k])
+      continue;
+    rewind(Results[k]);
+    unsigned Index;
+    double Elapsed;
+    char Result[64];
+    while (fscanf(Results[k], "%u %lf %63s", &Index, &Elapsed, Result) == 3) {
+      if (Index < Queries.size()) {
+        Times[Index] = Elapsed;
+        Outcomes[Index] = Result;
+      }
+    }
+    fclose(Results[k]);
+  }
+
+  llvm::outs() << "query,result,time\n";
+  std::vector<double> Finished;
+  for (unsigned i = 0; i < Queries.size(); ++i) {
+    llvm::outs() << i << "," << Outcomes[i] << ",";
+    if (Times[i] >= 0) {
+      llvm::outs() << llvm::format("%.6f", Times[i]);
+      Finished.push_back(Times[i]);
+    }
+    llvm::outs() << "\n";
+  }
+
+  std::sort(Finished.begin(), Finished.end());
+  double Total = 0;
+  for (std::vector<double>::iterator it = Finished.begin(),
+                                     ie = Finished.end();
+       it != ie; ++it)
+    Total += *it;
+  llvm::errs() << "queries,total,mean,p50,p90,p99,max\n" << Finished.size();
+  if (Finished.empty()) {
+    llvm::errs() << ",0,,,,,\n";
+  } else {
+    // The percentiles by the nearest rank
+    const double Ranks[] = { 0.5, 0.9, 0.99, 1.0 };
+    llvm::errs() << llvm::format(",%.6f,%.6f", Total, Total / Finished.size());
+    for (unsigned i = 0; i < sizeof(Ranks) / sizeof(Ranks[0]); ++i) {
+      size_t Rank = (size_t)ceil(Ranks[i] * Finished.size());
+      llvm::errs() << llvm::format(",%.6f", Finished[Rank ? Rank - 1 : 0]);
+    }
+    llvm::errs() << "\n";
+  }
+
+  munmap((void *)Next, sizeof(unsigned));
+  deleteQueries(Decls, P);
   return success;
 }
 
@@ -435,6 +610,12 @@ int main(int argc, char **argv) {
     Builder = createConstantFoldingExprBuilder(Builder);
     Builder = createSimplifyingExprBuilder(Builder);
     break;
+  case HashConsingBuilder:
+    Builder = createDefaultExprBuilder();
+    Builder = createConstantFoldingExprBuilder(Builder);
+    Builder = createSimplifyingExprBuilder(Builder);
+    Builder = createHashConsingExprBuilder(Builder);
+    break;
   }
 
   switch (ToolAction) {
@@ -450,6 +631,11 @@ int main(int argc, char **argv) {
     success = EvaluateInputAST(InputFile=="-" ? "<stdin>" : InputFile.c_str(),
                                MB.get(), Builder);
     break;
+  case BatchEvaluate:
+    success = evaluateInputBatch(InputFile == "-" ? "<stdin>"
+                                                  : InputFile.c_str(),
+                                 MB.get(), Builder);
+    break;
   case PrintSMTLIBv2:
     success = printInputAsSMTLIBv2(InputFile=="-"? "<stdin>" : InputFile.c_str(), MB.get(),Builder);
     break;
@@ -20,9 +20,11 @@
 #include <getopt.h>
 
 #include <errno.h>
+#include <limits.h>
 #include <time.h>
 #include <unistd.h>
 #include <sys/signal.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 
 #ifdef HAVE_SYS_CAPABILITY_H
@@ -42,10 +44,50 @@ static char *rootdir = NULL;
 static struct option long_options[] = {
   {"create-files-only", required_argument, 0, 'f'},
   {"chroot-to-dir", required_argument, 0, 'r'},
+  {"jobs", required_argument, 0, 'j'},
+  {"sandbox-dir", required_argument, 0, 's'},
+  {"coverage-tests", required_argument, 0, 'c'},
+  {"fuzz", required_argument, 0, 'z'},
+  {"fuzz-out-dir", required_argument, 0, 'o'},
   {"help", no_argument, 0, 'h'},
   {0, 0, 0, 0},
 };
 
+/* The number of tests replayed concurrently */
+static unsigned max_jobs = 1;
+
+/* The directory holding the sandbox directories of the tests, where each
+   replay creates its files and, with --coverage-tests, its .gcda files */
+static char *sandbox_root = NULL;
+
+/* The file listing the tests that add coverage, with --coverage-tests */
+static FILE *coverage_tests = NULL;
+
+/* The seconds of fuzzing of --fuzz, and the directory of the inputs that it
+   finds to add coverage */
+static unsigned fuzz_seconds = 0;
+static char *fuzz_out_dir = NULL;
+static unsigned fuzz_count, fuzz_kept_count;
+
+/* Whether the .gcda files of the replays are collected */
+static int collect_coverage = 0;
+
+/* A replay started in its sandbox directory. The replays are reported in the
+   order they were started, such that the output and the tests kept for their
+   coverage do not depend on the order they finish in. */
+struct replay_job {
+  int pid;
+  int done;
+  /* The input replayed, for the fuzzing */
+  KTest *fuzz_input;
+  char name[1024];
+  char dir[PATH_MAX];
+};
+
+static struct replay_job *jobs;
+static unsigned job_head, job_count;
+static unsigned test_count, covering_test_count;
+
 static void stop_monitored(int process) {
   fprintf(stderr, "TIMEOUT: ATTEMPTING GDB EXIT\n");
   int pid = fork();
@@ -244,11 +286,239 @@ void ensure_capsyschroot(const char *executable) {
 }
 #endif
 
+/* Replay the test in input, named name, on the executable */
+static void replay_test(char *executable, char *argv0, const char *name,
+                        int first) {
+  int prg_argc;
+  char ** prg_argv;
+  unsigned i;
+  char *arg0 = input->numArgs ? input->args[0] : 0;
+
+  obj_index = 0;
+  prg_argc = input->numArgs;
+  prg_argv = input->args;
+  prg_argv[0] = argv0;
+  klee_init_env(&prg_argc, &prg_argv);
+
+  if (!first)
+    fprintf(stderr, "\n");
+  fprintf(stderr, "%s: TEST CASE: %s\n", progname, name);
+  fprintf(stderr, "%s: ARGS: ", progname);
+  for (i=0; i != (unsigned) prg_argc; ++i) {
+    char *s = prg_argv[i];
+    if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
+    fprintf(stderr, "\"%s\" ", prg_argv[i]); 
+  }
+  fprintf(stderr, "\n");
+
+  /* Run the test case machinery in a subprocess, eventually this parent
+     process should be a script or something which shells out to the actual
+     execution tool. */
+  int pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    _exit(66);
+  } else if (pid == 0) {
+    /* Create the input files, pipes, etc., and run the process. */
+    replay_create_files(&__exe_fs);
+    run_monitored(executable, prg_argc, prg_argv);
+    _exit(0);
+  } else {
+    /* Wait for the test case. */
+    int res, status;
+
+    do {
+      res = waitpid(pid, &status, 0);
+    } while (res < 0 && errno == EINTR);
+    
+    if (res < 0) {
+      perror("waitpid");
+      _exit(66);
+    }
+  }
+
+  /* Let kTest_free release the original argument */
+  if (input->numArgs)
+    input->args[0] = arg0;
+}
+
+/* Copy the output of a replay run in a sandbox to stderr */
+static void copy_log(const char *dir) {
+  char path[PATH_MAX + 16], buf[4096];
+  size_t n;
+  FILE *f;
+
+  snprintf(path, sizeof(path), "%s/replay.log", dir);
+  f = fopen(path, "r");
+  if (!f)
+    return;
+  while ((n = fread(buf, 1, sizeof(buf), f)) != 0)
+    fwrite(buf, 1, n, stderr);
+  fclose(f);
+}
+
+static void report_job(struct replay_job *job) {
+  if (job->fuzz_input) {
+    /* The inputs that cover new arc counters are kept, those that only run
+       the covered ones in a new combination are not */
+    unsigned covered = coverage_covered_count();
+    coverage_merge_dir(job->dir);
+    if (coverage_covered_count() > covered) {
+      char path[PATH_MAX];
+      snprintf(path, sizeof(path), "%s/fuzz%06u.ktest", fuzz_out_dir,
+               ++fuzz_kept_count);
+      if (!kTest_toFile(job->fuzz_input, path)) {
+        perror(path);
+        exit(1);
+      }
+      fuzz_add_test(job->fuzz_input);
+    } else {
+      kTest_free(job->fuzz_input);
+    }
+    job->fuzz_input = NULL;
+    fuzz_remove_dir(job->dir);
+    return;
+  }
+
+  if (max_jobs > 1)
+    copy_log(job->dir);
+
+  if (collect_coverage && coverage_merge_dir(job->dir) && coverage_tests) {
+    fprintf(coverage_tests, "%s\n", job->name);
+    ++covering_test_count;
+  }
+}
+
+/* Wait for a replay to finish, and report the finished replays that all the
+   earlier ones have been reported before */
+static void wait_job(void) {
+  int res, status;
+  unsigned i;
+
+  do {
+    res = waitpid(-1, &status, 0);
+  } while (res < 0 && errno == EINTR);
+
+  if (res < 0) {
+    perror("waitpid");
+    _exit(66);
+  }
+
+  for (i = 0; i != job_count; ++i) {
+    struct replay_job *job = &jobs[(job_head + i) % max_jobs];
+    if (job->pid == res)
+      job->done = 1;
+  }
+
+  while (job_count && jobs[job_head].done) {
+    report_job(&jobs[job_head]);
+    job_head = (job_head + 1) % max_jobs;
+    --job_count;
+  }
+}
+
+/* Replay the test in input in a child process running in a new sandbox
+   directory, once fewer than max_jobs replays are running. The input is
+   owned by the job when it is one of the fuzzing. */
+static void start_job(char *executable, char *argv0, const char *name,
+                      KTest *fuzz_input) {
+  struct replay_job *job;
+  int pid;
+
+  while (job_count == max_jobs)
+    wait_job();
+
+  job = &jobs[(job_head + job_count) % max_jobs];
+  snprintf(job->dir, sizeof(job->dir), "%s/test%06u", sandbox_root,
+           ++test_count);
+  if (mkdir(job->dir, 0755) < 0 && errno != EEXIST) {
+    perror(job->dir);
+    exit(1);
+  }
+  snprintf(job->name, sizeof(job->name), "%s", name);
+  job->done = 0;
+  job->fuzz_input = fuzz_input;
+
+  fflush(stderr);
+  pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    _exit(66);
+  } else if (pid == 0) {
+    if (chdir(job->dir) < 0) {
+      perror("chdir");
+      _exit(66);
+    }
+    /* gcov writes the .gcda files under GCOV_PREFIX, such that the counters
+       of each test are kept apart */
+    if (collect_coverage)
+      setenv("GCOV_PREFIX", job->dir, 1);
+    if (max_jobs > 1 || fuzz_input) {
+      if (!freopen("replay.log", "w", stderr))
+        _exit(66);
+      /* The replay exits its processes without flushing */
+      setvbuf(stderr, NULL, _IONBF, 0);
+    }
+    replay_test(executable, argv0, name, test_count == 1);
+    _exit(0);
+  }
+
+  job->pid = pid;
+  ++job_count;
+}
+
+static void run_test(char *executable, char *argv0, const char *name,
+                     int *first) {
+  if (sandbox_root)
+    start_job(executable, argv0, name, NULL);
+  else
+    replay_test(executable, argv0, name, *first);
+  *first = 0;
+}
+
+/* Replay inputs mutated from the tests of the corpus for fuzz_seconds, and
+   write those that add coverage to fuzz_out_dir */
+static void fuzz(char *executable, char *argv0) {
+  time_t end = time(0) + fuzz_seconds;
+
+  /* The coverage of the tests of the corpus comes first */
+  while (job_count)
+    wait_job();
+
+  while (time(0) < end) {
+    char name[64];
+    KTest *test = fuzz_next_test();
+    if (!test)
+      break;
+    snprintf(name, sizeof(name), "fuzz input %u", ++fuzz_count);
+    input = test;
+    start_job(executable, argv0, name, test);
+  }
+  while (job_count)
+    wait_job();
+
+  fprintf(stderr, "%s: %u of %u fuzzing inputs add coverage, written to %s\n",
+          progname, fuzz_kept_count, fuzz_count, fuzz_out_dir);
+}
+
 static void usage(void) {
-  fprintf(stderr, "Usage: %s [option]... <executable> <ktest-file>...\n", progname);
+  fprintf(stderr, "Usage: %s [option]... <executable> <ktest-file or ktar-archive>...\n", progname);
   fprintf(stderr, "   or: %s --create-files-only <ktest-file>\n", progname);
   fprintf(stderr, "\n");
   fprintf(stderr, "-r, --chroot-to-dir=DIR  use chroot jail, requires CAP_SYS_CHROOT\n");
+  fprintf(stderr, "-j, --jobs=N             replay N tests concurrently, each in its own\n");
+  fprintf(stderr, "                         sandbox directory\n");
+  fprintf(stderr, "-s, --sandbox-dir=DIR    create the sandbox directories of the tests in DIR\n");
+  fprintf(stderr, "                         (default: a new klee-replay-XXXXXX directory)\n");
+  fprintf(stderr, "-c, --coverage-tests=FILE\n");
+  fprintf(stderr, "                         list in FILE the tests that add to the gcov\n");
+  fprintf(stderr, "                         coverage of the earlier tests, for an executable\n");
+  fprintf(stderr, "                         built with --coverage\n");
+  fprintf(stderr, "-z, --fuzz=SECONDS       after the tests, replay for SECONDS inputs made by\n");
+  fprintf(stderr, "                         mutating the object bytes of the tests, and write\n");
+  fprintf(stderr, "                         those that add to the gcov coverage to the\n");
+  fprintf(stderr, "                         --fuzz-out-dir directory, as seeds for klee\n");
+  fprintf(stderr, "-o, --fuzz-out-dir=DIR   the directory of the inputs kept by --fuzz\n");
   fprintf(stderr, "-h, --help               display this help and exit\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "Use KLEE_REPLAY_TIMEOUT environment variable to set a timeout (in seconds).\n");
@@ -265,7 +535,8 @@ int main(int argc, char** argv) {
     usage();
 
   int c, opt_index;
-  while ((c = getopt_long(argc, argv, "f:r:", long_options, &opt_index)) != -1) {
+  while ((c = getopt_long(argc, argv, "f:r:j:s:c:z:o:", long_options,
+                          &opt_index)) != -1) {
     switch (c) {
       case 'f': {
         /* Special case hack for only creating files and not actually executing
@@ -294,9 +565,48 @@ int main(int argc, char** argv) {
       case 'r':
         rootdir = optarg;
         break;
+      case 'j':
+        max_jobs = atoi(optarg);
+        if (max_jobs == 0) {
+          fprintf(stderr, "Error: invalid number of jobs (%s)\n", optarg);
+          exit(1);
+        }
+        break;
+      case 's':
+        sandbox_root = optarg;
+        break;
+      case 'c':
+        coverage_tests = fopen(optarg, "w");
+        if (!coverage_tests) {
+          perror(optarg);
+          exit(1);
+        }
+        break;
+      case 'z':
+        fuzz_seconds = atoi(optarg);
+        if (fuzz_seconds == 0) {
+          fprintf(stderr, "Error: invalid fuzzing time (%s)\n", optarg);
+          exit(1);
+        }
+        break;
+      case 'o':
+        fuzz_out_dir = optarg;
+        break;
+      case 'h':
+        usage();
     }
   }
 
+  if (fuzz_seconds && !fuzz_out_dir) {
+    fprintf(stderr, "Error: --fuzz requires --fuzz-out-dir\n");
+    exit(1);
+  }
+  if (fuzz_out_dir && mkdir(fuzz_out_dir, 0755) < 0 && errno != EEXIST) {
+    perror(fuzz_out_dir);
+    exit(1);
+  }
+  collect_coverage = coverage_tests || fuzz_seconds;
+
   /* Normal execution path ... */
 
   char* executable = argv[optind];
@@ -321,60 +631,98 @@ int main(int argc, char** argv) {
   }
   fclose(f);
 
+  /* The tests are replayed in sandbox directories when they run concurrently
+     or their coverage is collected */
+  if (max_jobs > 1 || sandbox_root || collect_coverage) {
+    static char sandbox_template[] = "klee-replay-XXXXXX";
+    static char sandbox_path[PATH_MAX], executable_path[PATH_MAX];
+
+    if (rootdir) {
+      fprintf(stderr, "Error: chroot: sandbox directories are not supported.\n");
+      exit(1);
+    }
+    if (!sandbox_root) {
+      sandbox_root = mkdtemp(sandbox_template);
+      if (!sandbox_root) {
+        perror("mkdtemp");
+        exit(1);
+      }
+    } else if (mkdir(sandbox_root, 0755) < 0 && errno != EEXIST) {
+      perror(sandbox_root);
+      exit(1);
+    }
+
+    /* The replays run in the sandbox directories */
+    if (!realpath(sandbox_root, sandbox_path) ||
+        !realpath(executable, executable_path)) {
+      perror("realpath");
+      exit(1);
+    }
+    sandbox_root = sandbox_path;
+    executable = executable_path;
+    jobs = calloc(max_jobs, sizeof(*jobs));
+  }
+
   int idx = 0;
+  int first = 1;
   for (idx = optind + 1; idx != argc; ++idx) {
     char* input_fname = argv[idx];
-    unsigned i;
-    
+
+    if (kTest_isKTestArchive(input_fname)) {
+      /* Replay all the tests of the archive */
+      KTestArchive *archive = kTest_openArchive(input_fname);
+      unsigned i;
+      if (!archive) {
+        fprintf(stderr, "%s: error: input archive %s not valid.\n", progname,
+                input_fname);
+        exit(1);
+      }
+      for (i = 0; i != kTest_archiveNumTests(archive); ++i) {
+        char name[1024];
+        snprintf(name, sizeof(name), "%s:test%06d", input_fname,
+                 kTest_archiveTestId(archive, i));
+        input = kTest_fromArchive(archive, i);
+        if (!input) {
+          fprintf(stderr, "%s: error: input %s not valid.\n", progname, name);
+          exit(1);
+        }
+        run_test(executable, argv[optind], name, &first);
+        if (fuzz_seconds)
+          fuzz_add_test(input);
+        else
+          kTest_free(input);
+      }
+      kTest_closeArchive(archive);
+      continue;
+    }
+
     input = kTest_fromFile(input_fname);
     if (!input) {
       fprintf(stderr, "%s: error: input file %s not valid.\n", progname, 
               input_fname);
       exit(1);
     }
-    
-    obj_index = 0;
-    prg_argc = input->numArgs;
-    prg_argv = input->args;
-    prg_argv[0] = argv[optind];
-    klee_init_env(&prg_argc, &prg_argv);
-
-    if (idx > 2)
-      fprintf(stderr, "\n");
-    fprintf(stderr, "%s: TEST CASE: %s\n", progname, input_fname);
-    fprintf(stderr, "%s: ARGS: ", progname);
-    for (i=0; i != (unsigned) prg_argc; ++i) {
-      char *s = prg_argv[i];
-      if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
-      fprintf(stderr, "\"%s\" ", prg_argv[i]); 
-    }
-    fprintf(stderr, "\n");
 
-    /* Run the test case machinery in a subprocess, eventually this parent
-       process should be a script or something which shells out to the actual
-       execution tool. */
-    int pid = fork();
-    if (pid < 0) {
-      perror("fork");
-      _exit(66);
-    } else if (pid == 0) {
-      /* Create the input files, pipes, etc., and run the process. */
-      replay_create_files(&__exe_fs);
-      run_monitored(executable, prg_argc, prg_argv);
-      _exit(0);
-    } else {
-      /* Wait for the test case. */
-      int res, status;
-
-      do {
-        res = waitpid(pid, &status, 0);
-      } while (res < 0 && errno == EINTR);
-      
-      if (res < 0) {
-        perror("waitpid");
-        _exit(66);
-      }
-    }
+    run_test(executable, argv[optind], input_fname, &first);
+    if (fuzz_seconds)
+      fuzz_add_test(input);
+  }
+
+  if (fuzz_seconds)
+    fuzz(executable, argv[optind]);
+
+  if (sandbox_root) {
+    while (job_count)
+      wait_job();
+    fprintf(stderr, "%s: replayed %u tests in %s\n", progname, test_count,
+            sandbox_root);
+  }
+
+  if (coverage_tests) {
+    fclose(coverage_tests);
+    fprintf(stderr, "%s: %u of %u tests add coverage (%u arc counters covered)\n",
+            progname, covering_test_count, test_count,
+            coverage_covered_count());
   }
 
   return 0;
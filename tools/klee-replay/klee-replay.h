@@ -24,5 +24,28 @@ void process_status(int status,
 		    const char *pfx)
   __attribute__((noreturn));
 
+/* Merge the arc counters of the .gcda files under dir into the coverage of
+   the earlier tests. Returns nonzero when they add coverage, see
+   replay-coverage.c. */
+int coverage_merge_dir(const char *dir);
+
+/* The number of arc counters covered by the merged tests */
+unsigned coverage_covered_count(void);
+
+struct KTest;
+
+/* Add a test to the corpus of --fuzz, which then owns it, see
+   replay-fuzz.c */
+void fuzz_add_test(struct KTest *test);
+
+unsigned fuzz_corpus_size(void);
+
+/* A new input, mutated from a test of the corpus, to be released with
+   kTest_free or added to the corpus */
+struct KTest *fuzz_next_test(void);
+
+/* Remove the sandbox directory of an input, with the files of its replay */
+void fuzz_remove_dir(const char *dir);
+
 #endif
 
@@ -0,0 +1,242 @@
+//===-- replay-coverage.c -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The coverage of the replayed tests, read from the .gcda files that the
+// executables compiled with --coverage write at exit. Each test writes its own
+// files under its sandbox directory, through GCOV_PREFIX, and its arc
+// counters are merged into the coverage of the tests replayed before it.
+//
+// gcov only has counters for the arcs off a spanning tree of each function,
+// and computes the counts of the other arcs from them, such that a test can
+// run a new arc while only running instrumented arcs that earlier tests ran.
+// A test therefore adds coverage when the set of the arc counters it runs in
+// some function differs from the ones of all the earlier tests.
+//
+// Only the layout of the records is relied upon, such that the files of the
+// gcov versions of both GCC and Clang can be read: the counters are identified
+// by their file, the position of their record in the file and their index in
+// the record, which do not change between the runs of the same executable.
+//
+//===----------------------------------------------------------------------===//
+
+/* For nftw */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "klee-replay.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ftw.h>
+
+#define GCOV_DATA_MAGIC 0x67636461 /* "gcda" */
+#define GCOV_TAG_FUNCTION 0x01000000
+#define GCOV_TAG_ARCS 0x01a10000
+#define GCOV_TAG_OBJECT_SUMMARY 0xa1000000
+#define GCOV_TAG_PROGRAM_SUMMARY 0xa3000000
+
+#define BUCKET_COUNT 4096
+
+/* The arc counters of a record, whether some test covered each of them, and
+   the hashes of the sets of counters covered by each test */
+struct counter_set {
+  char *key;
+  unsigned size;
+  unsigned char *covered;
+  uint64_t *patterns;
+  unsigned pattern_count;
+  struct counter_set *next;
+};
+
+static struct counter_set *buckets[BUCKET_COUNT];
+static unsigned covered_count;
+
+/* The directory of the test whose files are merged, and whether they add
+   coverage */
+static const char *merged_dir;
+static int merged_new;
+
+static unsigned hash_key(const char *key) {
+  unsigned h = 2166136261u;
+  for (; *key; ++key)
+    h = (h ^ (unsigned char) *key) * 16777619u;
+  return h % BUCKET_COUNT;
+}
+
+static struct counter_set *get_counter_set(const char *key, unsigned size) {
+  unsigned h = hash_key(key);
+  struct counter_set *set;
+
+  for (set = buckets[h]; set; set = set->next) {
+    if (strcmp(set->key, key) == 0)
+      break;
+  }
+
+  if (!set) {
+    set = calloc(1, sizeof(*set));
+    set->key = strdup(key);
+    set->next = buckets[h];
+    buckets[h] = set;
+  }
+
+  if (set->size < size) {
+    set->covered = realloc(set->covered, size);
+    memset(set->covered + set->size, 0, size - set->size);
+    set->size = size;
+  }
+  return set;
+}
+
+/* Record the set of counters covered by a test in a record, given by its
+   hash */
+static void add_pattern(struct counter_set *set, uint64_t pattern) {
+  unsigned i;
+
+  for (i = 0; i != set->pattern_count; ++i) {
+    if (set->patterns[i] == pattern)
+      return;
+  }
+  set->patterns = realloc(set->patterns,
+                          (set->pattern_count + 1) * sizeof(uint64_t));
+  set->patterns[set->pattern_count++] = pattern;
+  merged_new = 1;
+}
+
+static uint32_t read_word(const unsigned char *data) {
+  uint32_t word;
+  memcpy(&word, data, sizeof(word));
+  return word;
+}
+
+static int is_known_tag(uint32_t tag) {
+  return tag == GCOV_TAG_FUNCTION || tag == GCOV_TAG_OBJECT_SUMMARY ||
+         tag == GCOV_TAG_PROGRAM_SUMMARY ||
+         (tag >= GCOV_TAG_ARCS && tag <= 0x01af0000 &&
+          (tag & 0x1ffff) == 0x10000);
+}
+
+/* Walk the records of a file, whose header has the given number of words and
+   whose record lengths are in the given unit of bytes. The arc counters are
+   merged when key is given, or else the layout is only validated. Returns
+   zero when the file does not have that layout. */
+static int walk_records(const unsigned char *data, size_t size,
+                        unsigned header_words, unsigned unit,
+                        const char *key) {
+  size_t pos = header_words * 4;
+  unsigned ordinal = 0;
+
+  while (pos + 4 <= size) {
+    uint32_t tag = read_word(data + pos);
+    int32_t length;
+    size_t bytes;
+
+    /* Some versions end the file with an empty tag */
+    if (tag == 0)
+      return 1;
+    if (!is_known_tag(tag) || pos + 8 > size)
+      return 0;
+    length = (int32_t) read_word(data + pos + 4);
+    bytes = length < 0 ? 0 : (size_t) length * unit;
+    if (bytes > size - pos - 8)
+      return 0;
+    pos += 8;
+
+    /* A negative length stands for counters that are all zero */
+    if (key && tag == GCOV_TAG_ARCS && bytes) {
+      char set_key[PATH_MAX + 16];
+      unsigned n = bytes / 8, i;
+      uint64_t pattern = 14695981039346656037ull;
+      struct counter_set *set;
+
+      snprintf(set_key, sizeof(set_key), "%s#%u", key, ordinal);
+      set = get_counter_set(set_key, n);
+      for (i = 0; i != n; ++i) {
+        uint64_t count = read_word(data + pos + i * 8) |
+                         ((uint64_t) read_word(data + pos + i * 8 + 4) << 32);
+        pattern = (pattern ^ (count != 0)) * 1099511628211ull;
+        if (count && !set->covered[i]) {
+          set->covered[i] = 1;
+          ++covered_count;
+        }
+      }
+      add_pattern(set, pattern);
+    }
+    if (tag == GCOV_TAG_ARCS)
+      ++ordinal;
+    pos += bytes;
+  }
+  return pos == size;
+}
+
+static void merge_file(const char *path, const char *key) {
+  static const unsigned header_words[] = { 3, 4 };
+  static const unsigned units[] = { 4, 1 };
+  unsigned char *data;
+  unsigned i, j;
+  long size;
+  FILE *f = fopen(path, "rb");
+
+  if (!f) {
+    perror(path);
+    return;
+  }
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  data = malloc(size > 0 ? size : 1);
+  if (size < 12 || fread(data, 1, size, f) != (size_t) size ||
+      read_word(data) != GCOV_DATA_MAGIC) {
+    fprintf(stderr, "WARNING: %s is not a gcov data file\n", path);
+    free(data);
+    fclose(f);
+    return;
+  }
+  fclose(f);
+
+  for (i = 0; i != 2; ++i) {
+    for (j = 0; j != 2; ++j) {
+      if (walk_records(data, size, header_words[i], units[j], 0)) {
+        walk_records(data, size, header_words[i], units[j], key);
+        free(data);
+        return;
+      }
+    }
+  }
+  fprintf(stderr, "WARNING: unsupported gcov data format in %s\n", path);
+  free(data);
+}
+
+static int merge_entry(const char *path, const struct stat *s, int type,
+                       struct FTW *ftw) {
+  size_t length = strlen(path);
+  (void) s;
+  (void) ftw;
+
+  /* The files are identified by their path without the sandbox directory,
+     which is the path they have in the runs without GCOV_PREFIX */
+  if (type == FTW_F && length > 5 && strcmp(path + length - 5, ".gcda") == 0)
+    merge_file(path, path + strlen(merged_dir));
+  return 0;
+}
+
+int coverage_merge_dir(const char *dir) {
+  merged_dir = dir;
+  merged_new = 0;
+  if (nftw(dir, merge_entry, 16, FTW_PHYS) < 0)
+    perror(dir);
+  return merged_new;
+}
+
+unsigned coverage_covered_count(void) {
+  return covered_count;
+}
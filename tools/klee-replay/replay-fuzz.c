@@ -0,0 +1,173 @@
+//===-- replay-fuzz.c -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The inputs of the fuzzing of --fuzz. The tests given on the command line
+// fix the names and sizes of the objects, and the arguments, of the inputs:
+// each input is a copy of a test of the corpus, initially those tests, with
+// a few of the bytes of its data objects mutated. The inputs whose replay
+// covers new arc counters join the corpus, and are written as .ktest files
+// for KLEE to use as seeds.
+//
+//===----------------------------------------------------------------------===//
+
+/* For nftw */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "klee-replay.h"
+
+#include "klee/Internal/ADT/KTest.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ftw.h>
+
+#define MAX_MUTATIONS 8
+
+static KTest **corpus;
+static unsigned corpus_size, corpus_capacity;
+
+/* The state of the xorshift generator of the mutations, fixed such that the
+   fuzzing of the same tests tries the same inputs */
+static uint64_t random_state = 88172645463325252ull;
+
+static uint64_t next_random(void) {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 7;
+  random_state ^= random_state << 17;
+  return random_state;
+}
+
+static char *copy_string(const char *s) {
+  char *res = malloc(strlen(s) + 1);
+  strcpy(res, s);
+  return res;
+}
+
+/* A copy of the test, to be released with kTest_free */
+static KTest *copy_test(const KTest *test) {
+  KTest *res = calloc(1, sizeof(*res));
+  unsigned i;
+
+  res->version = test->version;
+  res->numArgs = test->numArgs;
+  res->args = calloc(test->numArgs ? test->numArgs : 1, sizeof(char *));
+  for (i = 0; i != test->numArgs; ++i)
+    res->args[i] = copy_string(test->args[i]);
+  res->symArgvs = test->symArgvs;
+  res->symArgvLen = test->symArgvLen;
+  res->numObjects = test->numObjects;
+  res->objects = calloc(test->numObjects ? test->numObjects : 1,
+                        sizeof(KTestObject));
+  for (i = 0; i != test->numObjects; ++i) {
+    const KTestObject *o = &test->objects[i];
+    res->objects[i].name = copy_string(o->name);
+    res->objects[i].numBytes = o->numBytes;
+    res->objects[i].bytes = malloc(o->numBytes ? o->numBytes : 1);
+    memcpy(res->objects[i].bytes, o->bytes, o->numBytes);
+  }
+  return res;
+}
+
+/* Whether the object holds input data, rather than the stat structure of a
+   symbolic file or the version of the model, which the replay expects to be
+   those KLEE wrote */
+static int is_mutable(const KTestObject *o) {
+  size_t length = strlen(o->name);
+  return strcmp(o->name, "model_version") != 0 &&
+         !(length >= 5 && strcmp(o->name + length - 5, "-stat") == 0);
+}
+
+static unsigned mutable_bytes(const KTest *test) {
+  unsigned i, res = 0;
+  for (i = 0; i != test->numObjects; ++i)
+    if (is_mutable(&test->objects[i]))
+      res += test->objects[i].numBytes;
+  return res;
+}
+
+/* Mutate a byte of the test, at an offset over its mutable object bytes */
+static void mutate_byte(KTest *test, unsigned offset) {
+  static const unsigned char interesting[] = { 0, 1, 0x7f, 0x80, 0xff };
+  unsigned i;
+  unsigned char *byte;
+
+  for (i = 0; !is_mutable(&test->objects[i]) ||
+              offset >= test->objects[i].numBytes;
+       ++i) {
+    if (is_mutable(&test->objects[i]))
+      offset -= test->objects[i].numBytes;
+  }
+  byte = &test->objects[i].bytes[offset];
+
+  switch (next_random() % 4) {
+  case 0:
+    *byte ^= 1 << (next_random() % 8);
+    break;
+  case 1:
+    *byte = interesting[next_random() % sizeof(interesting)];
+    break;
+  case 2:
+    *byte += 1 + next_random() % 16;
+    break;
+  default:
+    *byte = next_random();
+    break;
+  }
+}
+
+void fuzz_add_test(KTest *test) {
+  if (corpus_size == corpus_capacity) {
+    corpus_capacity = corpus_capacity ? 2 * corpus_capacity : 64;
+    corpus = realloc(corpus, corpus_capacity * sizeof(KTest *));
+  }
+  corpus[corpus_size++] = test;
+}
+
+unsigned fuzz_corpus_size(void) {
+  return corpus_size;
+}
+
+KTest *fuzz_next_test(void) {
+  KTest *test;
+  unsigned bytes, n, i;
+
+  if (!corpus_size)
+    return NULL;
+  test = copy_test(corpus[next_random() % corpus_size]);
+  bytes = mutable_bytes(test);
+  if (bytes) {
+    n = 1 + next_random() % MAX_MUTATIONS;
+    for (i = 0; i != n; ++i)
+      mutate_byte(test, next_random() % bytes);
+  }
+  return test;
+}
+
+static int remove_entry(const char *path, const struct stat *s, int type,
+                        struct FTW *ftw) {
+  (void) s;
+  (void) type;
+  (void) ftw;
+  remove(path);
+  return 0;
+}
+
+void fuzz_remove_dir(const char *dir) {
+  char temps[PATH_MAX + 8];
+
+  /* The files of the replay are created in the .temps directory beside */
+  snprintf(temps, sizeof(temps), "%s.temps", dir);
+  nftw(dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+  nftw(temps, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
@@ -67,10 +67,12 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <fstream>
 #include <iomanip>
 #include <iterator>
+#include <map>
 #include <sstream>
 
 
@@ -120,6 +122,19 @@ namespace {
   WriteCov("write-cov",
            cl::desc("Write coverage information for each test case"));
 
+  cl::opt<bool>
+  WriteKTestArchive("write-ktest-archive",
+                    cl::desc("Append the tests to the single archive "
+                             "tests.ktar instead of writing a .ktest file "
+                             "per test (default=off)"),
+                    cl::init(false));
+
+  cl::opt<bool>
+  CompressKTestArchive("compress-ktest-archive",
+                       cl::desc("Compress the tests of the archive written "
+                                "with --write-ktest-archive (default=off)"),
+                       cl::init(false));
+
   cl::opt<bool>
   WriteTestInfo("write-test-info",
                 cl::desc("Write additional test case information"));
@@ -156,6 +171,15 @@ namespace {
 		cl::desc("Link with POSIX runtime.  Options that can be passed as arguments to the programs are: --sym-arg <max-len>  --sym-args <min-argvs> <max-argvs> <max-len> + file model options"),
 		cl::init(false));
 
+  cl::opt<std::string>
+  ModuleCacheDir("module-cache-dir",
+                 cl::desc("Keep the programs linked with their libraries in "
+                          "this directory, named after the hash of the "
+                          "program, the libraries and the linking options, "
+                          "such that the later runs on the same program load "
+                          "them instead of linking them again (default=off)."),
+                 cl::init(""));
+
   cl::opt<bool>
   OptimizeModule("optimize",
                  cl::desc("Optimize before execution"),
@@ -202,6 +226,18 @@ namespace {
   cl::list<std::string>
   SeedOutDir("seed-out-dir");
 
+  cl::opt<bool>
+  DedupSeeds("dedup-seeds",
+             cl::desc("Drop the seeds with the same arguments and objects as "
+                      "an earlier seed (default=on)"),
+             cl::init(true));
+
+  cl::opt<bool>
+  SortSeedsBySize("sort-seeds-by-size",
+                  cl::desc("Run the seeds with the fewest object bytes "
+                           "first (default=off)"),
+                  cl::init(false));
+
   cl::list<std::string>
   LinkLibraries("link-llvm-lib",
                 cl::desc("Link the given libraries before execution"),
@@ -219,6 +255,14 @@ namespace {
 	     cl::desc("Stop execution after generating the given number of tests.  Extra tests corresponding to partially explored paths will also be dumped."),
 	     cl::init(0));
 
+  cl::opt<unsigned>
+  AsyncTestCaseJobs("async-test-case-jobs",
+                    cl::desc("Solve for and write the test cases of "
+                             "terminated states in up to the given number of "
+                             "forked processes, while exploration goes on "
+                             "(default=0 (off))"),
+                    cl::init(0));
+
   cl::opt<bool>
   Watchdog("watchdog",
            cl::desc("Use a watchdog process to enforce --max-time."),
@@ -275,6 +319,18 @@ private:
   int m_argc;
   char **m_argv;
 
+  // the processes writing test cases asynchronously
+  std::set<pid_t> m_testCaseWriters;
+
+  void writeTestCase(const ExecutionState &state, const char *errorMessage,
+                     const char *errorSuffix, unsigned id,
+                     const std::vector<unsigned char> &concreteBranches,
+                     const std::vector<unsigned char> &symbolicBranches);
+
+  // reap the finished test case writers, waiting until fewer than
+  // maxRunning are left
+  void reapTestCaseWriters(unsigned maxRunning);
+
 public:
   KleeHandler(int argc, char **argv);
   ~KleeHandler();
@@ -383,6 +439,9 @@ public:
                        const char *errorMessage,
                        const char *errorSuffix);
 
+  // wait for all test cases being written asynchronously
+  void waitForTestCases() { reapTestCaseWriters(1); }
+
   std::string getOutputFilename(const std::string &filename);
   llvm::raw_fd_ostream *openOutputFile(const std::string &filename);
   std::string getTestFilename(const std::string &suffix, unsigned id);
@@ -483,6 +542,7 @@ KleeHandler::KleeHandler(int argc, char **argv)
 }
 
 KleeHandler::~KleeHandler() {
+  waitForTestCases();
   if (m_pathWriter) delete m_pathWriter;
   if (m_symPathWriter) delete m_symPathWriter;
   fclose(klee_warning_file);
@@ -562,124 +622,189 @@ void KleeHandler::processTestCase(const ExecutionState &state,
   }
 
   if (!NoOutput) {
-    std::vector< std::pair<std::string, std::vector<unsigned char> > > out;
-    bool success = m_interpreter->getSymbolicSolution(state, out);
-
-    if (!success)
-      klee_warning("unable to get symbolic solution, losing test case");
-
-    double start_time = util::getWallTime();
-
     unsigned id = ++m_testIndex;
 
-    if (success) {
-      KTest b;
-      b.numArgs = m_argc;
-      b.args = m_argv;
-      b.symArgvs = 0;
-      b.symArgvLen = 0;
-      b.numObjects = out.size();
-      b.objects = new KTestObject[b.numObjects];
-      assert(b.objects);
-      for (unsigned i=0; i<b.numObjects; i++) {
-        KTestObject *o = &b.objects[i];
-        o->name = const_cast<char*>(out[i].first.c_str());
-        o->numBytes = out[i].second.size();
-        o->bytes = new unsigned char[o->numBytes];
-        assert(o->bytes);
-        std::copy(out[i].second.begin(), out[i].second.end(), o->bytes);
-      }
+    // The path streams are read here, as the writer buffers them in this
+    // process.
+    std::vector<unsigned char> concreteBranches, symbolicBranches;
+    if (m_pathWriter)
+      m_pathWriter->readStream(m_interpreter->getPathStreamID(state),
+                               concreteBranches);
+    if (m_symPathWriter)
+      m_symPathWriter->readStream(m_interpreter->getSymbolicPathStreamID(state),
+                                  symbolicBranches);
 
-      if (!kTest_toFile(&b, getOutputFilename(getTestFilename("ktest", id)).c_str())) {
-        klee_warning("unable to write output test case, losing it");
+    bool written = false;
+    if (AsyncTestCaseJobs) {
+      reapTestCaseWriters(AsyncTestCaseJobs);
+      // Do not let the child flush the buffered output of this process
+      fflush(NULL);
+      pid_t pid = fork();
+      if (pid == 0) {
+        writeTestCase(state, errorMessage, errorSuffix, id, concreteBranches,
+                      symbolicBranches);
+        fflush(NULL);
+        _exit(0);
+      } else if (pid > 0) {
+        m_testCaseWriters.insert(pid);
+        written = true;
+      } else {
+        klee_warning("fork failed (for test case %u), writing it in place", id);
       }
-
-      for (unsigned i=0; i<b.numObjects; i++)
-        delete[] b.objects[i].bytes;
-      delete[] b.objects;
     }
+    if (!written)
+      writeTestCase(state, errorMessage, errorSuffix, id, concreteBranches,
+                    symbolicBranches);
 
-    if (errorMessage) {
-      llvm::raw_ostream *f = openTestFile(errorSuffix, id);
-      *f << errorMessage;
-      delete f;
-    }
+    if (m_testIndex == StopAfterNTests)
+      m_interpreter->setHaltExecution(true);
+  }
+}
 
-    if (m_pathWriter) {
-      std::vector<unsigned char> concreteBranches;
-      m_pathWriter->readStream(m_interpreter->getPathStreamID(state),
-                               concreteBranches);
-      llvm::raw_fd_ostream *f = openTestFile("path", id);
-      for (std::vector<unsigned char>::iterator I = concreteBranches.begin(),
-                                                E = concreteBranches.end();
-           I != E; ++I) {
-        *f << *I << "\n";
-      }
-      delete f;
+void KleeHandler::reapTestCaseWriters(unsigned maxRunning) {
+  std::set<pid_t>::iterator it = m_testCaseWriters.begin();
+  while (it != m_testCaseWriters.end()) {
+    int status;
+    pid_t res = waitpid(*it, &status, WNOHANG);
+    if (res < 0 && errno == EINTR)
+      continue;
+    if (res != 0) {
+      if (res > 0 && (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
+        klee_warning("test case writer process did not exit successfully");
+      m_testCaseWriters.erase(it++);
+    } else {
+      ++it;
     }
+  }
 
-    if (errorMessage || WritePCs) {
-      std::string constraints;
-      m_interpreter->getConstraintLog(state, constraints,Interpreter::KQUERY);
-      llvm::raw_ostream *f = openTestFile("pc", id);
-      *f << constraints;
-      delete f;
-    }
+  while (!m_testCaseWriters.empty() && m_testCaseWriters.size() >= maxRunning) {
+    int status;
+    pid_t pid = *m_testCaseWriters.begin();
+    pid_t res = waitpid(pid, &status, 0);
+    if (res < 0 && errno == EINTR)
+      continue;
+    if (res > 0 && (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
+      klee_warning("test case writer process did not exit successfully");
+    m_testCaseWriters.erase(pid);
+  }
+}
 
-    if (WriteCVCs) {
-      // FIXME: If using Z3 as the core solver the emitted file is actually
-      // SMT-LIBv2 not CVC which is a bit confusing
-      std::string constraints;
-      m_interpreter->getConstraintLog(state, constraints, Interpreter::STP);
-      llvm::raw_ostream *f = openTestFile("cvc", id);
-      *f << constraints;
-      delete f;
+void KleeHandler::writeTestCase(
+    const ExecutionState &state, const char *errorMessage,
+    const char *errorSuffix, unsigned id,
+    const std::vector<unsigned char> &concreteBranches,
+    const std::vector<unsigned char> &symbolicBranches) {
+  std::vector< std::pair<std::string, std::vector<unsigned char> > > out;
+  bool success = m_interpreter->getSymbolicSolution(state, out);
+
+  if (!success)
+    klee_warning("unable to get symbolic solution, losing test case");
+
+  double start_time = util::getWallTime();
+
+  if (success) {
+    KTest b;
+    b.numArgs = m_argc;
+    b.args = m_argv;
+    b.symArgvs = 0;
+    b.symArgvLen = 0;
+    b.numObjects = out.size();
+    b.objects = new KTestObject[b.numObjects];
+    assert(b.objects);
+    for (unsigned i=0; i<b.numObjects; i++) {
+      KTestObject *o = &b.objects[i];
+      o->name = const_cast<char*>(out[i].first.c_str());
+      o->numBytes = out[i].second.size();
+      o->bytes = new unsigned char[o->numBytes];
+      assert(o->bytes);
+      std::copy(out[i].second.begin(), out[i].second.end(), o->bytes);
     }
 
-    if(WriteSMT2s) {
-      std::string constraints;
-        m_interpreter->getConstraintLog(state, constraints, Interpreter::SMTLIB2);
-        llvm::raw_ostream *f = openTestFile("smt2", id);
-        *f << constraints;
-        delete f;
+    if (WriteKTestArchive) {
+      if (!kTest_appendToArchive(&b, getOutputFilename("tests.ktar").c_str(),
+                                 id, CompressKTestArchive))
+        klee_warning("unable to append test case to archive, losing it");
+    } else if (!kTest_toFile(&b, getOutputFilename(getTestFilename("ktest", id)).c_str())) {
+      klee_warning("unable to write output test case, losing it");
     }
 
-    if (m_symPathWriter) {
-      std::vector<unsigned char> symbolicBranches;
-      m_symPathWriter->readStream(m_interpreter->getSymbolicPathStreamID(state),
-                                  symbolicBranches);
-      llvm::raw_fd_ostream *f = openTestFile("sym.path", id);
-      for (std::vector<unsigned char>::iterator I = symbolicBranches.begin(), E = symbolicBranches.end(); I!=E; ++I) {
-        *f << *I << "\n";
-      }
-      delete f;
-    }
+    for (unsigned i=0; i<b.numObjects; i++)
+      delete[] b.objects[i].bytes;
+    delete[] b.objects;
+  }
 
-    if (WriteCov) {
-      std::map<const std::string*, std::set<unsigned> > cov;
-      m_interpreter->getCoveredLines(state, cov);
-      llvm::raw_ostream *f = openTestFile("cov", id);
-      for (std::map<const std::string*, std::set<unsigned> >::iterator
-             it = cov.begin(), ie = cov.end();
-           it != ie; ++it) {
-        for (std::set<unsigned>::iterator
-               it2 = it->second.begin(), ie = it->second.end();
-             it2 != ie; ++it2)
-          *f << *it->first << ":" << *it2 << "\n";
-      }
-      delete f;
+  if (errorMessage) {
+    llvm::raw_ostream *f = openTestFile(errorSuffix, id);
+    *f << errorMessage;
+    delete f;
+  }
+
+  if (m_pathWriter) {
+    llvm::raw_fd_ostream *f = openTestFile("path", id);
+    for (std::vector<unsigned char>::const_iterator
+             I = concreteBranches.begin(),
+             E = concreteBranches.end();
+         I != E; ++I) {
+      *f << *I << "\n";
     }
+    delete f;
+  }
 
-    if (m_testIndex == StopAfterNTests)
-      m_interpreter->setHaltExecution(true);
+  if (errorMessage || WritePCs) {
+    std::string constraints;
+    m_interpreter->getConstraintLog(state, constraints,Interpreter::KQUERY);
+    llvm::raw_ostream *f = openTestFile("pc", id);
+    *f << constraints;
+    delete f;
+  }
 
-    if (WriteTestInfo) {
-      double elapsed_time = util::getWallTime() - start_time;
-      llvm::raw_ostream *f = openTestFile("info", id);
-      *f << "Time to generate test case: "
-         << elapsed_time << "s\n";
+  if (WriteCVCs) {
+    // FIXME: If using Z3 as the core solver the emitted file is actually
+    // SMT-LIBv2 not CVC which is a bit confusing
+    std::string constraints;
+    m_interpreter->getConstraintLog(state, constraints, Interpreter::STP);
+    llvm::raw_ostream *f = openTestFile("cvc", id);
+    *f << constraints;
+    delete f;
+  }
+
+  if(WriteSMT2s) {
+    std::string constraints;
+      m_interpreter->getConstraintLog(state, constraints, Interpreter::SMTLIB2);
+      llvm::raw_ostream *f = openTestFile("smt2", id);
+      *f << constraints;
       delete f;
+  }
+
+  if (m_symPathWriter) {
+    llvm::raw_fd_ostream *f = openTestFile("sym.path", id);
+    for (std::vector<unsigned char>::const_iterator I = symbolicBranches.begin(), E = symbolicBranches.end(); I!=E; ++I) {
+      *f << *I << "\n";
+    }
+    delete f;
+  }
+
+  if (WriteCov) {
+    std::map<const std::string*, std::set<unsigned> > cov;
+    m_interpreter->getCoveredLines(state, cov);
+    llvm::raw_ostream *f = openTestFile("cov", id);
+    for (std::map<const std::string*, std::set<unsigned> >::iterator
+           it = cov.begin(), ie = cov.end();
+         it != ie; ++it) {
+      for (std::set<unsigned>::iterator
+             it2 = it->second.begin(), ie = it->second.end();
+           it2 != ie; ++it2)
+        *f << *it->first << ":" << *it2 << "\n";
     }
+    delete f;
+  }
+
+  if (WriteTestInfo) {
+    double elapsed_time = util::getWallTime() - start_time;
+    llvm::raw_ostream *f = openTestFile("info", id);
+    *f << "Time to generate test case: "
+       << elapsed_time << "s\n";
+    delete f;
   }
 }
 
@@ -709,7 +834,8 @@ void KleeHandler::getKTestFilesInDir(std::string directoryPath,
   for (llvm::sys::fs::directory_iterator i(directoryPath, ec), e; i != e && !ec;
        i.increment(ec)) {
     std::string f = (*i).path();
-    if (f.substr(f.size()-6,f.size()) == ".ktest") {
+    if (f.substr(f.size()-6,f.size()) == ".ktest" ||
+        f.substr(f.size()-5,f.size()) == ".ktar") {
           results.push_back(f);
     }
   }
@@ -769,6 +895,100 @@ std::string KleeHandler::getRunTimeLibraryPath(const char *argv0) {
 //===----------------------------------------------------------------------===//
 // main Driver function
 //
+/// Load the test of a .ktest file, or the tests of a test archive, which
+/// are decoded one at a time from the mapping of the archive. Returns false
+/// when the file or one of the tests cannot be read.
+static bool loadKTests(const std::string &path, std::vector<KTest *> &results) {
+  if (!kTest_isKTestArchive(path.c_str())) {
+    KTest *out = kTest_fromFile(path.c_str());
+    if (!out)
+      return false;
+    results.push_back(out);
+    return true;
+  }
+
+  KTestArchive *archive = kTest_openArchive(path.c_str());
+  if (!archive)
+    return false;
+  bool success = true;
+  for (unsigned i = 0, e = kTest_archiveNumTests(archive); i != e; ++i) {
+    KTest *out = kTest_fromArchive(archive, i);
+    if (!out) {
+      success = false;
+      break;
+    }
+    results.push_back(out);
+  }
+  kTest_closeArchive(archive);
+  return success;
+}
+
+static uint64_t hashBytes(uint64_t hash, const void *data, unsigned size) {
+  const unsigned char *bytes = (const unsigned char *) data;
+  for (unsigned i = 0; i != size; ++i)
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  return hash;
+}
+
+static uint64_t hashKTest(const KTest *test) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned i = 0; i != test->numArgs; ++i)
+    hash = hashBytes(hash, test->args[i], strlen(test->args[i]) + 1);
+  for (unsigned i = 0; i != test->numObjects; ++i) {
+    const KTestObject &o = test->objects[i];
+    hash = hashBytes(hash, o.name, strlen(o.name) + 1);
+    hash = hashBytes(hash, &o.numBytes, sizeof(o.numBytes));
+    hash = hashBytes(hash, o.bytes, o.numBytes);
+  }
+  return hash;
+}
+
+static bool equalKTests(const KTest *a, const KTest *b) {
+  if (a->numArgs != b->numArgs || a->numObjects != b->numObjects ||
+      a->symArgvs != b->symArgvs || a->symArgvLen != b->symArgvLen)
+    return false;
+  for (unsigned i = 0; i != a->numArgs; ++i)
+    if (strcmp(a->args[i], b->args[i]))
+      return false;
+  for (unsigned i = 0; i != a->numObjects; ++i) {
+    const KTestObject &x = a->objects[i], &y = b->objects[i];
+    if (x.numBytes != y.numBytes || strcmp(x.name, y.name) ||
+        memcmp(x.bytes, y.bytes, x.numBytes))
+      return false;
+  }
+  return true;
+}
+
+/// Free the seeds equal to an earlier one, keeping the order of the others.
+static void dedupSeeds(std::vector<KTest *> &seeds) {
+  std::multimap<uint64_t, KTest *> seen;
+  unsigned kept = 0;
+  for (unsigned i = 0; i != seeds.size(); ++i) {
+    uint64_t hash = hashKTest(seeds[i]);
+    bool duplicate = false;
+    std::pair<std::multimap<uint64_t, KTest *>::iterator,
+              std::multimap<uint64_t, KTest *>::iterator> range =
+        seen.equal_range(hash);
+    for (std::multimap<uint64_t, KTest *>::iterator it = range.first;
+         it != range.second && !duplicate; ++it)
+      duplicate = equalKTests(it->second, seeds[i]);
+    if (duplicate) {
+      kTest_free(seeds[i]);
+      continue;
+    }
+    seen.insert(std::make_pair(hash, seeds[i]));
+    seeds[kept++] = seeds[i];
+  }
+  if (kept != seeds.size())
+    klee_message("dropped %lu duplicate seeds",
+                 (unsigned long) (seeds.size() - kept));
+  seeds.resize(kept);
+}
+
+static bool hasFewerBytes(KTest *a, KTest *b) {
+  return kTest_numBytes(a) < kTest_numBytes(b);
+}
+
 static std::string strip(std::string &in) {
   unsigned len = in.size();
   unsigned lead = 0, trail = len;
@@ -878,6 +1098,7 @@ static const char *modelledExternals[] = {
   "klee_abort",
   "klee_assume",
   "klee_check_memory_access",
+  "klee_copy_bytes",
   "klee_define_fixed_object",
   "klee_get_errno",
   "klee_get_valuef",
@@ -1298,6 +1519,172 @@ static llvm::Module *linkWithUclibc(llvm::Module *mainModule, StringRef libDir)
 }
 #endif
 
+/// Load a bitcode file, exiting on failure
+static Module *loadModule(const std::string &fileName) {
+  std::string ErrorMsg;
+  Module *module = 0;
+#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+  OwningPtr<MemoryBuffer> BufferPtr;
+  error_code ec=MemoryBuffer::getFileOrSTDIN(fileName.c_str(), BufferPtr);
+  if (ec) {
+    klee_error("error loading program '%s': %s", fileName.c_str(),
+               ec.message().c_str());
+  }
+
+  module = getLazyBitcodeModule(BufferPtr.get(), getGlobalContext(), &ErrorMsg);
+
+  if (module) {
+    if (module->MaterializeAllPermanently(&ErrorMsg)) {
+      delete module;
+      module = 0;
+    }
+  }
+  if (!module)
+    klee_error("error loading program '%s': %s", fileName.c_str(),
+               ErrorMsg.c_str());
+#else
+  auto Buffer = MemoryBuffer::getFileOrSTDIN(fileName.c_str());
+  if (!Buffer)
+    klee_error("error loading program '%s': %s", fileName.c_str(),
+               Buffer.getError().message().c_str());
+
+  auto moduleOrError = getLazyBitcodeModule(Buffer->get(), getGlobalContext());
+
+  if (!moduleOrError) {
+    klee_error("error loading program '%s': %s", fileName.c_str(),
+               moduleOrError.getError().message().c_str());
+  }
+  else {
+    // The module has taken ownership of the MemoryBuffer so release it
+    // from the std::unique_ptr
+    Buffer->release();
+  }
+
+  module = *moduleOrError;
+  if (auto ec = module->materializeAllPermanently()) {
+    klee_error("error loading program '%s': %s", fileName.c_str(),
+               ec.message().c_str());
+  }
+#endif
+
+
+  return module;
+}
+
+/// Hash bytes into a 64-bit FNV-1a hash, which is stable across runs
+static uint64_t hashBytes(uint64_t hash, const char *bytes, size_t size) {
+  for (size_t i = 0; i != size; ++i) {
+    hash ^= (unsigned char)bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static uint64_t hashString(uint64_t hash, const std::string &str) {
+  // Include the terminator to separate the strings
+  return hashBytes(hash, str.c_str(), str.size() + 1);
+}
+
+/// Hash the name and the contents of a file
+static uint64_t hashFile(uint64_t hash, const std::string &fileName) {
+  hash = hashString(hash, fileName);
+  std::ifstream f(fileName.c_str(), std::ios::in | std::ios::binary);
+  char buffer[65536];
+  while (f.good()) {
+    f.read(buffer, sizeof(buffer));
+    hash = hashBytes(hash, buffer, f.gcount());
+  }
+  return hash;
+}
+
+/// Get the path of the cached linked module of the program in
+/// -module-cache-dir, or the empty string when the modules are not cached
+static std::string getCachedModulePath(const std::string &libraryDir) {
+  if (ModuleCacheDir.empty() || InputFile == "-")
+    return "";
+
+  uint64_t hash = 14695981039346656037ULL;
+  hash = hashString(hash, PACKAGE_STRING);
+  hash = hashFile(hash, InputFile);
+  hash = hashString(hash, EntryPoint);
+  hash = hashBytes(hash, (const char *)&Libc.getValue(), sizeof(LibcType));
+  hash = hashString(hash, WithPOSIXRuntime ? "posix" : "");
+
+  SmallString<128> path(libraryDir);
+  switch (Libc) {
+  case NoLibc:
+    break;
+  case KleeLibc:
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3,3)
+    llvm::sys::path::append(path, "klee-libc.bc");
+#else
+    llvm::sys::path::append(path, "libklee-libc.bca");
+#endif
+    hash = hashFile(hash, path.c_str());
+    break;
+  case UcLibc:
+#ifdef SUPPORT_KLEE_UCLIBC
+    llvm::sys::path::append(path, KLEE_UCLIBC_BCA_NAME);
+    hash = hashFile(hash, path.c_str());
+#endif
+    break;
+  }
+  if (WithPOSIXRuntime) {
+    SmallString<128> posixPath(libraryDir);
+    llvm::sys::path::append(posixPath, "libkleeRuntimePOSIX.bca");
+    hash = hashFile(hash, posixPath.c_str());
+  }
+  for (std::vector<std::string>::iterator it = LinkLibraries.begin(),
+                                          ie = LinkLibraries.end();
+       it != ie; ++it)
+    hash = hashFile(hash, *it);
+
+  std::stringstream name;
+  name << "module-" << std::hex << std::setfill('0') << std::setw(16) << hash
+       << ".bc";
+  SmallString<128> cachedPath(ModuleCacheDir);
+  llvm::sys::path::append(cachedPath, name.str());
+  return cachedPath.c_str();
+}
+
+/// Write the linked module into the cache, through a temporary file renamed
+/// into place such that concurrent runs never load a partial module
+static void writeCachedModule(Module *module, const std::string &path) {
+  if (mkdir(ModuleCacheDir.c_str(), 0775) < 0 && errno != EEXIST) {
+    klee_warning("unable to create the module cache directory %s: %s",
+                 ModuleCacheDir.c_str(), strerror(errno));
+    return;
+  }
+
+  std::stringstream tmpPath;
+  tmpPath << path << ".tmp" << getpid();
+  {
+    std::string Error;
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3,5)
+    llvm::raw_fd_ostream f(tmpPath.str().c_str(), Error,
+                           llvm::sys::fs::F_None);
+#elif LLVM_VERSION_CODE >= LLVM_VERSION(3,4)
+    llvm::raw_fd_ostream f(tmpPath.str().c_str(), Error,
+                           llvm::sys::fs::F_Binary);
+#else
+    llvm::raw_fd_ostream f(tmpPath.str().c_str(), Error,
+                           llvm::raw_fd_ostream::F_Binary);
+#endif
+    if (!Error.empty()) {
+      klee_warning("unable to write the cached module %s: %s",
+                   tmpPath.str().c_str(), Error.c_str());
+      return;
+    }
+    WriteBitcodeToFile(module, f);
+  }
+
+  if (rename(tmpPath.str().c_str(), path.c_str()) < 0) {
+    klee_warning("unable to write the cached module %s: %s", path.c_str(),
+                 strerror(errno));
+    unlink(tmpPath.str().c_str());
+  }
+}
+
 int main(int argc, char **argv, char **envp) {
   atexit(llvm_shutdown);  // Call llvm_shutdown() on exit.
 
@@ -1375,102 +1762,74 @@ int main(int argc, char **argv, char **envp) {
   sys::SetInterruptFunction(interrupt_handle);
 
   // Load the bytecode...
-  std::string ErrorMsg;
-  Module *mainModule = 0;
-#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
-  OwningPtr<MemoryBuffer> BufferPtr;
-  error_code ec=MemoryBuffer::getFileOrSTDIN(InputFile.c_str(), BufferPtr);
-  if (ec) {
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               ec.message().c_str());
-  }
-
-  mainModule = getLazyBitcodeModule(BufferPtr.get(), getGlobalContext(), &ErrorMsg);
-
-  if (mainModule) {
-    if (mainModule->MaterializeAllPermanently(&ErrorMsg)) {
-      delete mainModule;
-      mainModule = 0;
-    }
-  }
-  if (!mainModule)
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               ErrorMsg.c_str());
-#else
-  auto Buffer = MemoryBuffer::getFileOrSTDIN(InputFile.c_str());
-  if (!Buffer)
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               Buffer.getError().message().c_str());
-
-  auto mainModuleOrError = getLazyBitcodeModule(Buffer->get(), getGlobalContext());
-
-  if (!mainModuleOrError) {
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               mainModuleOrError.getError().message().c_str());
-  }
-  else {
-    // The module has taken ownership of the MemoryBuffer so release it
-    // from the std::unique_ptr
-    Buffer->release();
-  }
-
-  mainModule = *mainModuleOrError;
-  if (auto ec = mainModule->materializeAllPermanently()) {
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               ec.message().c_str());
-  }
-#endif
-
-  if (WithPOSIXRuntime) {
-    int r = initEnv(mainModule);
-    if (r != 0)
-      return r;
-  }
-
   std::string LibraryDir = KleeHandler::getRunTimeLibraryPath(argv[0]);
   Interpreter::ModuleOptions Opts(LibraryDir.c_str(), EntryPoint,
                                   /*Optimize=*/OptimizeModule,
                                   /*CheckDivZero=*/CheckDivZero,
                                   /*CheckOvershift=*/CheckOvershift);
 
-  switch (Libc) {
-  case NoLibc: /* silence compiler warning */
-    break;
+  Module *mainModule = 0;
+  std::string cachedModule = getCachedModulePath(LibraryDir);
+  bool cachedModuleExists = false;
+  if (!cachedModule.empty())
+    llvm::sys::fs::exists(cachedModule.c_str(), cachedModuleExists);
+
+  if (cachedModuleExists) {
+    klee_message("NOTE: Using the linked module cached in %s",
+                 cachedModule.c_str());
+    mainModule = loadModule(cachedModule);
+  } else {
+    mainModule = loadModule(InputFile);
+
+    if (WithPOSIXRuntime) {
+      int r = initEnv(mainModule);
+      if (r != 0)
+        return r;
+    }
+
+    switch (Libc) {
+    case NoLibc: /* silence compiler warning */
+      break;
 
-  case KleeLibc: {
-    // FIXME: Find a reasonable solution for this.
-    SmallString<128> Path(Opts.LibraryDir);
+    case KleeLibc: {
+      // FIXME: Find a reasonable solution for this.
+      SmallString<128> Path(Opts.LibraryDir);
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3,3)
-    llvm::sys::path::append(Path, "klee-libc.bc");
+      llvm::sys::path::append(Path, "klee-libc.bc");
 #else
-    llvm::sys::path::append(Path, "libklee-libc.bca");
+      llvm::sys::path::append(Path, "libklee-libc.bca");
 #endif
-    mainModule = klee::linkWithLibrary(mainModule, Path.c_str());
-    assert(mainModule && "unable to link with klee-libc");
-    break;
-  }
+      mainModule = klee::linkWithLibrary(mainModule, Path.c_str());
+      assert(mainModule && "unable to link with klee-libc");
+      break;
+    }
 
-  case UcLibc:
-    mainModule = linkWithUclibc(mainModule, LibraryDir);
-    break;
-  }
+    case UcLibc:
+      mainModule = linkWithUclibc(mainModule, LibraryDir);
+      break;
+    }
 
-  if (WithPOSIXRuntime) {
-    SmallString<128> Path(Opts.LibraryDir);
-    llvm::sys::path::append(Path, "libkleeRuntimePOSIX.bca");
-    klee_message("NOTE: Using model: %s", Path.c_str());
-    mainModule = klee::linkWithLibrary(mainModule, Path.c_str());
-    assert(mainModule && "unable to link with simple model");
-  }
+    if (WithPOSIXRuntime) {
+      SmallString<128> Path(Opts.LibraryDir);
+      llvm::sys::path::append(Path, "libkleeRuntimePOSIX.bca");
+      klee_message("NOTE: Using model: %s", Path.c_str());
+      mainModule = klee::linkWithLibrary(mainModule, Path.c_str());
+      assert(mainModule && "unable to link with simple model");
+    }
+
+    std::vector<std::string>::iterator libs_it;
+    std::vector<std::string>::iterator libs_ie;
+    for (libs_it = LinkLibraries.begin(), libs_ie = LinkLibraries.end();
+         libs_it != libs_ie; ++libs_it) {
+      const char *libFilename = libs_it->c_str();
+      klee_message("Linking in library: %s.\n", libFilename);
+      mainModule = klee::linkWithLibrary(mainModule, libFilename);
+    }
 
-  std::vector<std::string>::iterator libs_it;
-  std::vector<std::string>::iterator libs_ie;
-  for (libs_it = LinkLibraries.begin(), libs_ie = LinkLibraries.end();
-       libs_it != libs_ie; ++libs_it) {
-    const char *libFilename = libs_it->c_str();
-    klee_message("Linking in library: %s.\n", libFilename);
-    mainModule = klee::linkWithLibrary(mainModule, libFilename);
+    if (!cachedModule.empty())
+      writeCachedModule(mainModule, cachedModule);
   }
+
   // Get the desired main function.  klee_main initializes uClibc
   // locale and other data and then calls main.
   Function *mainFn = mainModule->getFunction(EntryPoint);
@@ -1519,6 +1878,10 @@ int main(int argc, char **argv, char **envp) {
 
   std::vector<bool> replayPath;
 
+  if (ConcreteReplay && ReplayKTestFile.empty() && ReplayKTestDir.empty())
+    klee_error("-concrete-replay requires -replay-ktest-file or "
+               "-replay-ktest-dir");
+
   if (ReplayPathFile != "") {
     KleeHandler::loadPathFile(ReplayPathFile, replayPath);
   }
@@ -1563,12 +1926,8 @@ int main(int argc, char **argv, char **envp) {
     for (std::vector<std::string>::iterator it = kTestFiles.begin(),
                                             ie = kTestFiles.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (out) {
-        kTests.push_back(out);
-      } else {
+      if (!loadKTests(*it, kTests))
         klee_warning("unable to open: %s\n", (*it).c_str());
-      }
     }
 
     if (RunInDir != "") {
@@ -1587,7 +1946,7 @@ int main(int argc, char **argv, char **envp) {
       interpreter->setReplayKTest(out);
       llvm::errs() << "KLEE: replaying: " << *it << " (" << kTest_numBytes(out)
                    << " bytes)"
-                   << " (" << ++i << "/" << kTestFiles.size() << ")\n";
+                   << " (" << ++i << "/" << kTests.size() << ")\n";
       // XXX should put envp in .ktest ?
       interpreter->runFunctionAsMain(mainFn, out->numArgs, out->args, pEnvp);
       if (interrupted) break;
@@ -1602,11 +1961,9 @@ int main(int argc, char **argv, char **envp) {
     for (std::vector<std::string>::iterator
            it = SeedOutFile.begin(), ie = SeedOutFile.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (!out) {
+      if (!loadKTests(*it, seeds)) {
         klee_error("unable to open: %s\n", (*it).c_str());
       }
-      seeds.push_back(out);
     }
     for (std::vector<std::string>::iterator
            it = SeedOutDir.begin(), ie = SeedOutDir.end();
@@ -1616,17 +1973,20 @@ int main(int argc, char **argv, char **envp) {
       for (std::vector<std::string>::iterator it2 = kTestFiles.begin(),
                                               ie = kTestFiles.end();
            it2 != ie; ++it2) {
-        KTest *out = kTest_fromFile(it2->c_str());
-        if (!out) {
+        if (!loadKTests(*it2, seeds)) {
           klee_error("unable to open: %s\n", (*it2).c_str());
         }
-        seeds.push_back(out);
       }
       if (kTestFiles.empty()) {
         klee_error("seeds directory is empty: %s\n", (*it).c_str());
       }
     }
 
+    if (DedupSeeds)
+      dedupSeeds(seeds);
+    if (SortSeedsBySize)
+      std::stable_sort(seeds.begin(), seeds.end(), hasFewerBytes);
+
     if (!seeds.empty()) {
       klee_message("KLEE: using %lu seeds\n", seeds.size());
       interpreter->useSeeds(&seeds);
@@ -1648,6 +2008,8 @@ int main(int argc, char **argv, char **envp) {
     }
   }
 
+  handler->waitForTestCases();
+
   t[1] = time(NULL);
   strftime(buf, sizeof(buf), "Finished: %Y-%m-%d %H:%M:%S\n", localtime(&t[1]));
   handler->getInfoStream() << buf;
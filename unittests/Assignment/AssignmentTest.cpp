@@ -1,5 +1,6 @@
 #include "klee/util/ArrayCache.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/CompiledExpr.h"
 #include "gtest/gtest.h"
 #include <iostream>
 #include <vector>
@@ -33,3 +34,67 @@ TEST(AssignmentTest, FoldNotOptimized)
   ASSERT_TRUE(asConstant != NULL);
   ASSERT_EQ(asConstant->getZExtValue(), (unsigned) 128);
 }
+
+TEST(AssignmentTest, CompiledExprMatchesEvaluate)
+{
+  ArrayCache ac;
+  const Array* array = ac.CreateArray("compiled_array", /*size=*/ 4);
+  std::vector<const Array*> objects;
+  std::vector<unsigned char> value;
+  std::vector< std::vector<unsigned char> > values;
+  objects.push_back(array);
+  value.push_back(0xf0);
+  value.push_back(3);
+  value.push_back(0);
+  value.push_back(0x81);
+  values.push_back(value);
+  Assignment assignment(objects, values);
+
+  UpdateList ul(array, 0);
+  ul.extend(ConstantExpr::alloc(2, Expr::Int32),
+            ConstantExpr::alloc(7, Expr::Int8));
+  ref<Expr> byte0 = ReadExpr::create(ul, ConstantExpr::alloc(0, Expr::Int32));
+  ref<Expr> byte1 = ReadExpr::create(ul, ConstantExpr::alloc(1, Expr::Int32));
+  ref<Expr> byte2 = ReadExpr::create(ul, ConstantExpr::alloc(2, Expr::Int32));
+  ref<Expr> byte3 = ReadExpr::create(ul, ConstantExpr::alloc(3, Expr::Int32));
+  ref<Expr> word = ConcatExpr::create4(byte3, byte2, byte1, byte0);
+
+  std::vector< ref<Expr> > exprs;
+  exprs.push_back(word);
+  exprs.push_back(SExtExpr::create(byte0, Expr::Int64));
+  exprs.push_back(AShrExpr::create(word, ZExtExpr::create(byte1,
+                                                          Expr::Int32)));
+  exprs.push_back(SDivExpr::create(word, SExtExpr::create(byte1,
+                                                          Expr::Int32)));
+  exprs.push_back(SRemExpr::create(word, ZExtExpr::create(byte2,
+                                                          Expr::Int32)));
+  exprs.push_back(ShlExpr::create(byte1, byte0));
+  exprs.push_back(SltExpr::create(word, ConstantExpr::alloc(0, Expr::Int32)));
+  exprs.push_back(SelectExpr::create(UltExpr::create(byte1, byte2), byte0,
+                                     byte3));
+  exprs.push_back(ExtractExpr::create(MulExpr::create(word, word), 12,
+                                      Expr::Int16));
+
+  for (std::vector< ref<Expr> >::iterator it = exprs.begin(),
+         ie = exprs.end(); it != ie; ++it) {
+    CompiledExpr *compiled = CompiledExpr::compile(*it);
+    ASSERT_TRUE(compiled != NULL);
+    uint64_t result;
+    ASSERT_TRUE(compiled->evaluate(assignment, result));
+    ref<Expr> evaluated = assignment.evaluate(*it);
+    const ConstantExpr* asConstant = dyn_cast<ConstantExpr>(evaluated);
+    ASSERT_TRUE(asConstant != NULL);
+    ASSERT_EQ(asConstant->getZExtValue(), result);
+    delete compiled;
+  }
+
+  // The value of a division by zero is unknown
+  uint64_t result;
+  UpdateList plain(array, 0);
+  CompiledExpr *compiled = CompiledExpr::compile(
+      UDivExpr::create(byte1, ReadExpr::create(plain, ConstantExpr::alloc(
+                                                          2, Expr::Int32))));
+  ASSERT_TRUE(compiled != NULL);
+  ASSERT_FALSE(compiled->evaluate(assignment, result));
+  delete compiled;
+}
@@ -0,0 +1,78 @@
+//===-- BitArrayTest.cpp ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/util/BitArray.h"
+
+#include <stdlib.h>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+const unsigned Size = 300;
+
+// The range operations agree with the single bit ones on random ranges,
+// across and within the words.
+TEST(BitArrayTest, RangesMatchBits) {
+  srand(1);
+  BitArray bits(Size);
+  std::vector<bool> model(Size, false);
+
+  for (unsigned round = 0; round < 2000; ++round) {
+    unsigned idx = rand() % (Size + 1);
+    unsigned count = rand() % (Size - idx + 1);
+    unsigned end = idx + count;
+
+    switch (rand() % 3) {
+    case 0:
+      bits.setRange(idx, count);
+      for (unsigned i = idx; i < end; ++i)
+        model[i] = true;
+      break;
+    case 1:
+      bits.unsetRange(idx, count);
+      for (unsigned i = idx; i < end; ++i)
+        model[i] = false;
+      break;
+    default:
+      if (count) {
+        unsigned i = idx + rand() % count;
+        bits.set(i, !model[i]);
+        model[i] = !model[i];
+      }
+      break;
+    }
+
+    bool allSet = true, allUnset = true;
+    unsigned firstSet = end, firstUnset = end;
+    for (unsigned i = idx; i < end; ++i) {
+      if (model[i]) {
+        allUnset = false;
+        if (firstSet == end)
+          firstSet = i;
+      } else {
+        allSet = false;
+        if (firstUnset == end)
+          firstUnset = i;
+      }
+    }
+    ASSERT_EQ(allSet, bits.isAllSet(idx, count));
+    ASSERT_EQ(allUnset, bits.isAllUnset(idx, count));
+    ASSERT_EQ(firstSet, bits.findFirstSet(idx, count));
+    ASSERT_EQ(firstUnset, bits.findFirstUnset(idx, count));
+  }
+
+  for (unsigned i = 0; i < Size; ++i)
+    ASSERT_EQ(model[i], bits.get(i));
+}
+
+}
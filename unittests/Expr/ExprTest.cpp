@@ -113,4 +113,39 @@ TEST(ExprTest, ExtractConcat) {
   EXPECT_EQ(Expr::Extract, concat2->getKid(1)->getKind());
 }
 
+TEST(ExprTest, ArrayIds) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr0", 256);
+  const Array *array2 = ac.CreateArray("arr1", 256);
+  const Array *array3 = ac.CreateArray("arr0", 128);
+
+  // The cached array keeps its id, and each new array takes the next one
+  EXPECT_EQ(array, ac.CreateArray("arr0", 256));
+  EXPECT_EQ(array->getId() + 1, array2->getId());
+  EXPECT_EQ(array2->getId() + 1, array3->getId());
+
+  // The arrays of the same name share the string
+  EXPECT_EQ(&array->name, &array3->name);
+  EXPECT_NE(&array->name, &array2->name);
+}
+
+TEST(ExprTest, SmallConstants) {
+  // The small values and the ones just below the maximum are shared
+  EXPECT_EQ(ConstantExpr::alloc(255, Expr::Int32).get(),
+            ConstantExpr::alloc(255, Expr::Int32).get());
+  EXPECT_EQ(ConstantExpr::alloc(UINT64_C(0xFFFFFFFF), Expr::Int32).get(),
+            ConstantExpr::alloc(llvm::APInt(32, -1, true)).get());
+  EXPECT_EQ(ConstantExpr::alloc(UINT64_C(-16), Expr::Int64).get(),
+            ConstantExpr::alloc(UINT64_C(-16), Expr::Int64).get());
+  EXPECT_TRUE(ConstantExpr::alloc(UINT64_C(-1), Expr::Int64)->isAllOnes());
+  EXPECT_EQ(UINT64_C(0xFFF0),
+            ConstantExpr::alloc(UINT64_C(0xFFF0), Expr::Int16)->getZExtValue());
+
+  // The others are not
+  EXPECT_NE(ConstantExpr::alloc(256, Expr::Int32).get(),
+            ConstantExpr::alloc(256, Expr::Int32).get());
+  EXPECT_NE(ConstantExpr::alloc(UINT64_C(-17), Expr::Int64).get(),
+            ConstantExpr::alloc(UINT64_C(-17), Expr::Int64).get());
+}
+
 }
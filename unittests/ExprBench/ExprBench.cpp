@@ -0,0 +1,227 @@
+//===-- ExprBench.cpp -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Microbenchmarks of the expression primitives: construction by the
+// expression builders, hashing, structural comparison, evaluation on deep
+// update lists, and SMT-LIBv2 printing. Each benchmark is run for doubling
+// numbers of iterations until it takes the minimum time, and the results are
+// written as JSON in the format of Google Benchmark, such that its comparison
+// tools apply.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/ExprBuilder.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/Solver.h"
+#include "klee/util/ArrayCache.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprSMTLIBPrinter.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+llvm::cl::opt<double>
+    MinTime("min-time",
+            llvm::cl::desc("Minimum time of each benchmark in seconds "
+                           "(default=0.5)."),
+            llvm::cl::init(0.5));
+
+llvm::cl::opt<std::string>
+    Filter("filter",
+           llvm::cl::desc("Only run the benchmarks whose names contain the "
+                          "given string."),
+           llvm::cl::init(""));
+
+/// The size of the expressions and update lists of the benchmarks
+const unsigned Depth = 1000;
+
+/// Accumulates the results of the benchmarks, so that they are not optimized
+/// away
+volatile unsigned sink = 0;
+
+ArrayCache arrayCache;
+
+const Array *getArray() {
+  static const Array *array = arrayCache.CreateArray("arr", 256);
+  return array;
+}
+
+/// Build a chain of additions and multiplications of reads of the array.
+ref<Expr> buildChain(ExprBuilder *builder, unsigned depth) {
+  const Array *array = getArray();
+  ref<Expr> e = builder->Constant(1, Expr::Int8);
+  for (unsigned i = 0; i < depth; ++i) {
+    ref<Expr> read = builder->Read(UpdateList(array, 0),
+                                   builder->Constant(i % 256, Expr::Int32));
+    e = (i % 2) ? builder->Add(e, read) : builder->Mul(e, read);
+  }
+  return e;
+}
+
+/// Build an update list of symbolic-index writes to the array, at the
+/// indices from 256 on when the array is all zeros.
+UpdateList buildUpdates(unsigned depth) {
+  UpdateList updates(getArray(), 0);
+  for (unsigned i = 0; i < depth; ++i) {
+    ref<Expr> index = ZExtExpr::create(
+        Expr::createTempRead(getArray(), Expr::Int8), Expr::Int32);
+    updates.extend(AddExpr::create(index, ConstantExpr::create(256 + i, 32)),
+                   ConstantExpr::create(i % 256, Expr::Int8));
+  }
+  return updates;
+}
+
+// Each benchmark returns the time of its iterations, without its setup
+
+double runBuilder(ExprBuilder *builder, unsigned iterations) {
+  double start = util::getWallTime();
+  for (unsigned i = 0; i < iterations; ++i)
+    sink += buildChain(builder, Depth)->getWidth();
+  return util::getWallTime() - start;
+}
+
+double benchDefaultBuilder(unsigned iterations) {
+  ExprBuilder *builder = createDefaultExprBuilder();
+  double elapsed = runBuilder(builder, iterations);
+  delete builder;
+  return elapsed;
+}
+
+double benchSimplifyingBuilder(unsigned iterations) {
+  ExprBuilder *builder = createSimplifyingExprBuilder(
+      createConstantFoldingExprBuilder(createDefaultExprBuilder()));
+  double elapsed = runBuilder(builder, iterations);
+  delete builder;
+  return elapsed;
+}
+
+double benchComputeHash(unsigned iterations) {
+  ExprBuilder *builder = createDefaultExprBuilder();
+  std::vector<ref<Expr> > nodes;
+  for (ref<Expr> e = buildChain(builder, Depth); e->getNumKids();
+       e = e->getKid(0))
+    nodes.push_back(e);
+  delete builder;
+
+  double start = util::getWallTime();
+  for (unsigned i = 0; i < iterations; ++i)
+    for (std::vector<ref<Expr> >::iterator it = nodes.begin(),
+                                           ie = nodes.end();
+         it != ie; ++it)
+      sink += (*it)->computeHash();
+  return util::getWallTime() - start;
+}
+
+double benchCompare(unsigned iterations) {
+  // Two structurally-equal expressions that share no nodes, such that the
+  // comparison visits them entirely
+  ExprBuilder *builder = createDefaultExprBuilder();
+  ref<Expr> a = buildChain(builder, Depth);
+  ref<Expr> b = buildChain(builder, Depth);
+  delete builder;
+
+  double start = util::getWallTime();
+  for (unsigned i = 0; i < iterations; ++i)
+    sink += a->compare(*b);
+  return util::getWallTime() - start;
+}
+
+double benchEvaluate(unsigned iterations) {
+  // The read misses all the updates, such that it evaluates all of them
+  UpdateList updates = buildUpdates(Depth);
+  ref<Expr> read = ReadExpr::create(updates, ConstantExpr::create(255, 32));
+
+  std::vector<const Array *> objects(1, getArray());
+  std::vector<std::vector<unsigned char> > values(
+      1, std::vector<unsigned char>(256, 0));
+  Assignment assignment(objects, values);
+
+  double start = util::getWallTime();
+  for (unsigned i = 0; i < iterations; ++i)
+    sink += assignment.evaluate(read)->getWidth();
+  return util::getWallTime() - start;
+}
+
+double benchSMTLIBPrinter(unsigned iterations) {
+  ExprBuilder *builder = createDefaultExprBuilder();
+  ref<Expr> chain = buildChain(builder, Depth);
+  delete builder;
+
+  ConstraintManager constraints;
+  Query query(constraints,
+              EqExpr::create(chain, ConstantExpr::create(0, Expr::Int8)));
+
+  double start = util::getWallTime();
+  for (unsigned i = 0; i < iterations; ++i) {
+    std::string text;
+    llvm::raw_string_ostream os(text);
+    ExprSMTLIBPrinter printer;
+    printer.setOutput(os);
+    printer.setQuery(query);
+    printer.generateOutput();
+    sink += os.str().size();
+  }
+  return util::getWallTime() - start;
+}
+
+struct Benchmark {
+  const char *name;
+  double (*run)(unsigned iterations);
+};
+
+const Benchmark benchmarks[] = {
+  { "ExprBuilder/Default/1000", benchDefaultBuilder },
+  { "ExprBuilder/Simplifying/1000", benchSimplifyingBuilder },
+  { "Expr/computeHash/1000", benchComputeHash },
+  { "Expr/compare/1000", benchCompare },
+  { "Assignment/evaluate/1000", benchEvaluate },
+  { "ExprSMTLIBPrinter/generateOutput/1000", benchSMTLIBPrinter }
+};
+}
+
+int main(int argc, char **argv) {
+  llvm::cl::ParseCommandLineOptions(argc, argv,
+                                    " expression microbenchmarks\n");
+
+  llvm::outs() << "{\n  \"benchmarks\": [";
+  bool first = true;
+  for (unsigned i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i) {
+    const Benchmark &benchmark = benchmarks[i];
+    if (std::string(benchmark.name).find(Filter) == std::string::npos)
+      continue;
+
+    unsigned iterations = 1;
+    double elapsed;
+    for (;;) {
+      elapsed = benchmark.run(iterations);
+      if (elapsed >= MinTime || iterations >= (1U << 30))
+        break;
+      iterations *= 2;
+    }
+
+    llvm::outs() << (first ? "\n" : ",\n") << "    {\n"
+                 << "      \"name\": \"" << benchmark.name << "\",\n"
+                 << "      \"iterations\": " << iterations << ",\n"
+                 << "      \"real_time\": " << elapsed * 1e9 / iterations
+                 << ",\n"
+                 << "      \"time_unit\": \"ns\"\n"
+                 << "    }";
+    first = false;
+  }
+  llvm::outs() << "\n  ]\n}\n";
+  return 0;
+}